@@ -26,6 +26,7 @@
 #define TARGET_REQ_DEBUGMSG_ASCII			0x01
 #define TARGET_REQ_DEBUGMSG_HEXMSG(size)	(0x01 | ((size & 0xff) << 8))
 #define TARGET_REQ_DEBUGCHAR				0x02
+#define TARGET_REQ_DEBUGBUF					0x04
 
 #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_6SM__)
 
@@ -153,3 +154,11 @@ void dbg_write_char(char msg)
 {
 	dbg_write(TARGET_REQ_DEBUGCHAR | ((msg & 0xff) << 16));
 }
+
+void dbg_write_buf(volatile unsigned long *buf)
+{
+	/* buf[0] holds the length of the text that follows it, openocd
+	 * reads the whole text at once and clears buf[0] once done */
+	dbg_write(TARGET_REQ_DEBUGBUF);
+	dbg_write((unsigned long)buf);
+}
@@ -30,4 +30,8 @@ void dbg_write_u8(const unsigned char *val, long len);
 void dbg_write_str(const char *msg);
 void dbg_write_char(char msg);
 
+/* buf[0] is the length in bytes of the text following it. The buffer must
+ * not be changed until openocd has cleared buf[0]. */
+void dbg_write_buf(volatile unsigned long *buf);
+
 #endif	/* DCC_STDIO_H */
@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+	CRC32 of several memory regions in one run, same CRC as armv7m_crc.s
+
+	parameters:
+	r0 - pointer to struct { uint32_t size_in_crc_out, uint32_t addr },
+	     terminated by a zero size
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+BLOCK_SIZE_CRC		= 0
+BLOCK_ADDRESS		= 4
+SIZEOF_STRUCT_BLOCK	= 8
+
+start:
+	ldr		r6, CRC32XOR
+block_loop:
+	ldr		r3, [r0, #BLOCK_SIZE_CRC]	/* get size */
+	cmp		r3, #0
+	beq		done
+	ldr		r2, [r0, #BLOCK_ADDRESS]	/* get address */
+	movs	r7, #0
+	mvns	r7, r7
+	movs	r4, #0
+	b		ncomp
+nbyte:
+	ldrb	r1, [r2, r4]
+	lsls	r1, r1, #24
+	eors	r7, r7, r1
+	movs	r5, #0
+loop:
+	cmp		r7, #0
+	bge		notset
+	lsls	r7, r7, #1
+	eors	r7, r7, r6
+	b		cont
+notset:
+	lsls	r7, r7, #1
+cont:
+	adds	r5, r5, #1
+	cmp		r5, #8
+	bne		loop
+	adds	r4, r4, #1
+ncomp:
+	cmp		r4, r3
+	bne		nbyte
+	str		r7, [r0, #BLOCK_SIZE_CRC]	/* save crc */
+	adds	r0, r0, #SIZEOF_STRUCT_BLOCK
+	b		block_loop
+
+done:
+	bkpt	#0
+
+	.align	2
+
+CRC32XOR:	.word	0x04c11db7
+
+	.end
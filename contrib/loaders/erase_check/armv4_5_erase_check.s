@@ -20,20 +20,63 @@
 
 /*
 	parameters:
-	r0 - address in
-	r1 - byte count
-	r2 - mask - result out
+	r0 - pointer to struct { uint32_t size_in_result_out, uint32_t addr },
+	     terminated by a zero size, sizes in words
+	r1 - value to check
 */
 
 	.text
 	.arm
 
-loop:
-	ldrb r3, [r0], #1
-	and r2, r2, r3
-	subs r1, r1, #1
-	bne loop
-end:
+BLOCK_SIZE_RESULT	= 0
+BLOCK_ADDRESS		= 4
+SIZEOF_STRUCT_BLOCK	= 8
+
+block_loop:
+	ldr	r2, [r0, #BLOCK_SIZE_RESULT]	/* get size */
+	cmp	r2, #0
+	beq	done
+
+	ldr	r3, [r0, #BLOCK_ADDRESS]	/* get address */
+
+quad_loop:
+	cmp	r2, #4
+	blo	word_loop
+
+	ldmia	r3!, {r4-r7}			/* read four words */
+	eor	r4, r4, r1
+	eor	r5, r5, r1
+	eor	r6, r6, r1
+	eor	r7, r7, r1
+	orr	r4, r4, r5
+	orr	r4, r4, r6
+	orrs	r4, r4, r7
+	bne	not_erased
+
+	subs	r2, r2, #4
+	bne	quad_loop
+	b	erased
+
+word_loop:
+	ldr	r4, [r3], #4			/* read word */
+	cmp	r4, r1
+	bne	not_erased
+
+	subs	r2, r2, #1
+	bne	word_loop
+
+erased:
+	mov	r4, #1				/* block is erased */
+	b	save_result
+
+not_erased:
+	mov	r4, #0
+save_result:
+	str	r4, [r0], #SIZEOF_STRUCT_BLOCK
+	b	block_loop
+
+/* armv4 exits at the last instruction */
+done:
 	bkpt	#0
 
 	.end
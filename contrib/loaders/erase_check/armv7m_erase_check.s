@@ -44,6 +44,24 @@ block_loop:
 
 	ldr	r3, [r0, #BLOCK_ADDRESS]	/* get address */
 
+quad_loop:
+	cmp	r2, #4
+	blo	word_loop
+
+	ldmia	r3!, {r4-r7}	/* read four words */
+	eors	r4, r1
+	eors	r5, r1
+	eors	r6, r1
+	eors	r7, r1
+	orrs	r4, r5
+	orrs	r4, r6
+	orrs	r4, r7
+	bne	not_erased
+
+	subs	r2, #4
+	bne	quad_loop
+	b	erased
+
 word_loop:
 	ldr	r4, [r3]	/* read word */
 	adds	r3, #4
@@ -54,6 +72,7 @@ word_loop:
 	subs	r2, #1
 	bne	word_loop
 
+erased:
 	movs	r4, #1		/* block is erased */
 save_result:
 	str	r4, [r0, #BLOCK_SIZE_RESULT]
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+	Generic flash write loop for one block in the working area, the
+	ARM7/9 counterpart of armv7m_fifo_write.s.
+
+	r0 source address
+	r2 target address
+	r3 count of units
+	r4 parameter block, as for armv7m_fifo_write.s
+	Returns r0 = 0, or the status on error. Ends at the last instruction.
+*/
+
+	.text
+	.arm
+	.arch armv4t
+
+	.section .init
+write:
+	ldr	r5, [r4, #0]
+	cmp	r5, #0
+	beq	data
+	ldr	r7, [r4, #4]
+	ldr	r5, [r4, #8]
+	mov	lr, pc		/* return after the branch */
+	b	command
+	ldr	r5, [r4, #0]
+	cmp	r5, #1
+	beq	data
+	ldr	r7, [r4, #12]
+	ldr	r5, [r4, #16]
+	mov	lr, pc		/* return after the branch */
+	b	command
+
+data:
+	ldr	r5, [r4, #32]
+	cmp	r5, #2
+	ldrheq	r5, [r0], #2
+	strheq	r5, [r2], #2
+	ldrne	r5, [r0], #4
+	strne	r5, [r2], #4
+
+busy:
+	ldr	r5, [r4, #20]
+	ldr	r7, [r5]		/* status */
+	ldr	r5, [r4, #24]
+	tst	r7, r5
+	bne	busy
+	ldr	r5, [r4, #28]
+	tst	r7, r5
+	movne	r0, r7
+	bne	exit
+
+	subs	r3, r3, #1
+	bne	write
+	mov	r0, #0
+	b	exit
+
+/* store r5 to register r7, or in unit width to the unit's address */
+command:
+	cmp	r7, #0
+	strne	r5, [r7]
+	bxne	lr
+	ldr	r6, [r4, #32]
+	cmp	r6, #2
+	strheq	r5, [r2]
+	strne	r5, [r2]
+	bx	lr
+
+exit:
+	b	exit
+
+	.end
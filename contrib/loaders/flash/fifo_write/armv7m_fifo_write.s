@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+	Generic flash write loop, fed through the fifo of
+	target_run_flash_async_algorithm(). See src/flash/nor/fifo_write.c.
+
+	r0 fifo start (write pointer, read pointer, data)
+	r1 fifo end
+	r2 target address
+	r3 count of units
+	r4 parameter block:
+		[0]	number of commands before each unit, 0..2
+		[4]	first command register, 0 for the unit's address
+		[8]	first command value
+		[12]	second command register, 0 for the unit's address
+		[16]	second command value
+		[20]	status register
+		[24]	busy mask
+		[28]	error mask
+		[32]	unit width, 2 or 4
+	On error the read pointer is set to 0 and r0 holds the status.
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.global write
+write:
+wait_fifo:
+	ldr	r5, [r0, #0]		/* write pointer */
+	cmp	r5, #0
+	beq	exit			/* aborted by the host */
+	ldr	r6, [r0, #4]		/* read pointer */
+	cmp	r5, r6
+	beq	wait_fifo
+
+	ldr	r5, [r4, #0]
+	cmp	r5, #0
+	beq	data
+	ldr	r7, [r4, #4]
+	ldr	r5, [r4, #8]
+	bl	command
+	ldr	r5, [r4, #0]
+	cmp	r5, #1
+	beq	data
+	ldr	r7, [r4, #12]
+	ldr	r5, [r4, #16]
+	bl	command
+
+data:
+	ldr	r5, [r4, #32]
+	cmp	r5, #2
+	beq	data16
+	ldr	r5, [r6]
+	str	r5, [r2]
+	adds	r6, #4
+	adds	r2, #4
+	b	busy
+data16:
+	ldrh	r5, [r6]
+	strh	r5, [r2]
+	adds	r6, #2
+	adds	r2, #2
+
+busy:
+	ldr	r5, [r4, #20]
+	ldr	r7, [r5]		/* status */
+	ldr	r5, [r4, #24]
+	tst	r7, r5
+	bne	busy
+	ldr	r5, [r4, #28]
+	tst	r7, r5
+	bne	error
+
+	cmp	r6, r1
+	bcc	no_wrap
+	mov	r6, r0
+	adds	r6, #8
+no_wrap:
+	str	r6, [r0, #4]		/* read pointer */
+	subs	r3, #1
+	bne	wait_fifo
+exit:
+	bkpt	#0
+
+error:
+	movs	r5, #0
+	str	r5, [r0, #4]		/* read pointer = 0 */
+	mov	r0, r7
+	bkpt	#0
+
+/* store r5 to register r7, or in unit width to the unit's address */
+command:
+	cmp	r7, #0
+	beq	command_unit
+	str	r5, [r7]
+	bx	lr
+command_unit:
+	ldr	r7, [r4, #32]
+	cmp	r7, #2
+	beq	command16
+	str	r5, [r2]
+	bx	lr
+command16:
+	strh	r5, [r2]
+	bx	lr
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+	Fill a memory region with a pattern, and for the test patterns read
+	it back and compare. The patterns match target_mem_pattern_value().
+
+	parameters:
+	r0 - word aligned address in - failing address out
+	r1 - word count in - expected value out
+	r2 - pattern: 0 fill, 1 walking ones, 2 address, 3 xorshift32
+	     in - read value out
+	r3 - fill value or random seed in - 0 passed, 1 failed out
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+FILL		= 0
+WALKING_ONES	= 1
+ADDRESS		= 2
+RANDOM		= 3
+
+start:
+	mov		r8, r3		/* save value / seed */
+	mov		r9, r0		/* save address */
+	mov		r10, r1		/* save count */
+	movs	r7, #0		/* pass 0 writes, pass 1 verifies */
+pass:
+	mov		r0, r9
+	mov		r1, r10
+	mov		r3, r8
+	movs	r4, #0		/* word index */
+word_loop:
+	cmp		r4, r1
+	beq		pass_done
+	cmp		r2, #WALKING_ONES
+	beq		walking_ones
+	cmp		r2, #ADDRESS
+	beq		address
+	cmp		r2, #RANDOM
+	beq		random
+	mov		r5, r3
+	b		have_value
+walking_ones:
+	movs	r5, #1
+	movs	r6, #31
+	ands	r6, r6, r4
+	lsls	r5, r5, r6
+	b		have_value
+address:
+	mov		r5, r0
+	b		have_value
+random:
+	lsls	r6, r3, #13
+	eors	r3, r3, r6
+	lsrs	r6, r3, #17
+	eors	r3, r3, r6
+	lsls	r6, r3, #5
+	eors	r3, r3, r6
+	mov		r5, r3
+have_value:
+	cmp		r7, #0
+	bne		verify
+	str		r5, [r0]
+	b		next
+verify:
+	ldr		r6, [r0]
+	cmp		r6, r5
+	bne		failed
+next:
+	adds	r0, r0, #4
+	adds	r4, r4, #1
+	b		word_loop
+pass_done:
+	cmp		r7, #0
+	bne		passed
+	cmp		r2, #FILL	/* nothing to verify */
+	beq		passed
+	movs	r7, #1
+	b		pass
+passed:
+	movs	r3, #0
+	b		done
+failed:
+	mov		r1, r5
+	mov		r2, r6
+	movs	r3, #1
+done:
+	bkpt	#0
+
+	.end
@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/*
+	Counts the words at the bottom of each block which still hold the
+	fill value, i.e. the stack a thread never used.
+
+	parameters:
+	r0 - pointer to struct { uint32_t size_in_words_unused_out, uint32_t addr }
+	     array, terminated by a size of 0
+	r1 - fill value
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+BLOCK_SIZE_RESULT	= 0
+BLOCK_ADDRESS		= 4
+SIZEOF_STRUCT_BLOCK	= 8
+
+start:
+block_loop:
+	ldr	r2, [r0, #BLOCK_SIZE_RESULT]	/* get size */
+	tst	r2, r2
+	beq	done
+
+	ldr	r3, [r0, #BLOCK_ADDRESS]	/* get address */
+	movs	r4, #0			/* unused words */
+
+word_loop:
+	ldr	r5, [r3]	/* read word */
+	cmp	r5, r1
+	bne	save_result
+
+	adds	r3, #4
+	adds	r4, #1
+	cmp	r4, r2
+	bne	word_loop
+
+save_result:
+	str	r4, [r0, #BLOCK_SIZE_RESULT]
+	adds	r0, #SIZEOF_STRUCT_BLOCK
+	b	block_loop
+
+/* Avoid padding at .text segment end. Otherwise exit point check fails. */
+	.skip	( . - start + 2) & 2, 0
+
+done:
+	bkpt	#0
+
+	.end
@@ -291,6 +291,56 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/*
+ * Scan extension message: bit count (32 bits little endian), then TMS, TDI
+ * and capture mask vectors of (count + 7) / 8 bytes each. Answered with the
+ * captured TDO bits, packed.
+ */
+static void process_scan(void)
+{
+	static unsigned char *buf;
+	static size_t buf_size;
+	unsigned char hdr[4];
+
+	if (fread(hdr, sizeof(hdr), 1, stdin) != 1)
+		return;
+	unsigned int bits = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (unsigned int)hdr[3] << 24;
+	size_t len = (bits + 7) / 8;
+
+	if (buf_size < 4 * len) {
+		unsigned char *p = realloc(buf, 4 * len);
+		if (!p) {
+			LOG_ERROR("Out of memory");
+			exit(1);
+		}
+		buf = p;
+		buf_size = 4 * len;
+	}
+	if (len && fread(buf, 3 * len, 1, stdin) != 1)
+		return;
+
+	const unsigned char *tms = buf, *tdi = buf + len, *capture = buf + 2 * len;
+	unsigned char *tdo = buf + 3 * len;
+	unsigned int captured = 0;
+
+	memset(tdo, 0, len);
+	for (unsigned int i = 0; i < bits; i++) {
+		int s_tms = (tms[i / 8] >> (i % 8)) & 1;
+		int s_tdi = (tdi[i / 8] >> (i % 8)) & 1;
+
+		sysfsgpio_write(0, s_tms, s_tdi);
+		if ((capture[i / 8] >> (i % 8)) & 1) {
+			if (sysfsgpio_read() == '1')
+				tdo[captured / 8] |= 1 << (captured % 8);
+			captured++;
+		}
+		sysfsgpio_write(1, s_tms, s_tdi);
+	}
+
+	if (captured)
+		fwrite(tdo, (captured + 7) / 8, 1, stdout);
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -311,6 +361,11 @@ static void process_remote_protocol(void)
 					(d & 1));
 		} else if (c == 'R')
 			putchar(sysfsgpio_read());
+		else if (c == 'X') { /* Scan extension query */
+			putchar('X');
+			putchar('1');
+		} else if (c == 'x')
+			process_scan();
 		else
 			LOG_ERROR("Unknown command '%c' received", c);
 	}
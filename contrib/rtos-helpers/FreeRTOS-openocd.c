@@ -18,3 +18,58 @@
 #endif
 
 const int USED uxTopUsedPriority = configMAX_PRIORITIES - 1;
+
+#ifdef OPENOCD_THREAD_TABLE_SIZE
+/*
+ * Optional table of the tasks for OpenOCD, see openocd-thread-table.h: it
+ * saves walking the task lists at every halt. Define
+ * OPENOCD_THREAD_TABLE_SIZE to the maximum number of tasks, and call the
+ * functions below from the trace hooks in FreeRTOSConfig.h:
+ *
+ *   #define traceTASK_CREATE(pxNewTCB) \
+ *     openocd_task_created(pxNewTCB, pxNewTCB->pcTaskName, pxNewTCB->uxPriority)
+ *   #define traceTASK_DELETE(pxTCB) openocd_task_deleted(pxTCB)
+ *   #define traceTASK_SWITCHED_IN() openocd_task_switched_in(pxCurrentTCB)
+ *   #define traceTASK_PRIORITY_SET(pxTCB, uxNewPriority) \
+ *     openocd_task_priority(pxTCB, uxNewPriority)
+ *   #define traceMOVED_TASK_TO_READY_STATE(pxTCB) openocd_task_state(pxTCB, eReady)
+ *   #define traceTASK_DELAY() openocd_task_state(pxCurrentTCB, eBlocked)
+ *   #define traceTASK_DELAY_UNTIL(xTimeToWake) openocd_task_state(pxCurrentTCB, eBlocked)
+ *   #define traceTASK_SUSPEND(pxTCB) openocd_task_state(pxTCB, eSuspended)
+ *
+ * with the prototypes of these functions. All of them are called with the
+ * scheduler locked. Add ``--undefined=openocd_thread_table'' to LDFLAGS
+ * with --gc-sections.
+ */
+
+#include "task.h"
+#include "openocd-thread-table.h"
+
+OPENOCD_THREAD_TABLE_DEFINE(OPENOCD_THREAD_TABLE_SIZE);
+
+void openocd_task_created(void *tcb, const char *name, unsigned int priority)
+{
+	openocd_thread_add(&openocd_thread_table.header, tcb, name, priority);
+	openocd_thread_set_state(&openocd_thread_table.header, tcb, eReady);
+}
+
+void openocd_task_deleted(void *tcb)
+{
+	openocd_thread_remove(&openocd_thread_table.header, tcb);
+}
+
+void openocd_task_switched_in(void *tcb)
+{
+	openocd_thread_switched_in(&openocd_thread_table.header, tcb);
+}
+
+void openocd_task_priority(void *tcb, unsigned int priority)
+{
+	openocd_thread_set_priority(&openocd_thread_table.header, tcb, priority);
+}
+
+void openocd_task_state(void *tcb, unsigned int state)
+{
+	openocd_thread_set_state(&openocd_thread_table.header, tcb, state);
+}
+#endif
@@ -0,0 +1,133 @@
+/*
+ * A table of the threads of the system, kept up to date by the RTOS or the
+ * application, which OpenOCD reads in one access at every halt instead of
+ * walking the RTOS' own lists. Export it under the name
+ * ``openocd_thread_table'', e.g. with OPENOCD_THREAD_TABLE_DEFINE(32) in one
+ * source file, and call the functions below from the hooks of the RTOS;
+ * FreeRTOS-openocd.c shows how for FreeRTOS.
+ *
+ * Threads are added and removed between two increments of generation, with
+ * the scheduler locked: OpenOCD does not use the table while generation is
+ * odd, and only reads the thread names again when it changed.
+ *
+ * Only targets with 32-bit pointers are supported.
+ */
+
+#ifndef OPENOCD_THREAD_TABLE_H
+#define OPENOCD_THREAD_TABLE_H
+
+#include <stdint.h>
+
+#ifdef __GNUC__
+#define OPENOCD_USED __attribute__((used))
+#else
+#define OPENOCD_USED
+#endif
+
+#define OPENOCD_THREAD_TABLE_MAGIC		0x5454434f	/* "OCTT" */
+#define OPENOCD_THREAD_TABLE_VERSION	1
+
+/* followed by capacity struct openocd_thread_entry */
+struct openocd_thread_table {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t entry_size;
+	uint32_t count;
+	uint32_t capacity;
+	volatile uint32_t generation;
+	/* TCB of the running thread */
+	volatile uint32_t current;
+};
+
+struct openocd_thread_entry {
+	uint32_t tcb;
+	/* NUL terminated name, or 0 */
+	uint32_t name;
+	/* RTOS specific, e.g. eTaskState for FreeRTOS */
+	uint8_t state;
+	uint8_t priority;
+	uint16_t reserved;
+};
+
+#define OPENOCD_THREAD_TABLE_DEFINE(n) \
+	struct { \
+		struct openocd_thread_table header; \
+		struct openocd_thread_entry entries[n]; \
+	} openocd_thread_table OPENOCD_USED = { { \
+		OPENOCD_THREAD_TABLE_MAGIC, OPENOCD_THREAD_TABLE_VERSION, \
+		sizeof(struct openocd_thread_entry), 0, (n), 0, 0 }, { { 0 } } }
+
+static inline struct openocd_thread_entry *openocd_thread_entries(struct openocd_thread_table *t)
+{
+	return (struct openocd_thread_entry *)(t + 1);
+}
+
+static inline struct openocd_thread_entry *openocd_thread_find(struct openocd_thread_table *t,
+		const void *tcb)
+{
+	struct openocd_thread_entry *e = openocd_thread_entries(t);
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		if (e[i].tcb == (uint32_t)(uintptr_t)tcb)
+			return &e[i];
+	}
+	return 0;
+}
+
+/* call with the scheduler locked */
+static inline void openocd_thread_add(struct openocd_thread_table *t, const void *tcb,
+		const char *name, unsigned int priority)
+{
+	if (t->count == t->capacity)
+		return;
+
+	struct openocd_thread_entry *e = &openocd_thread_entries(t)[t->count];
+
+	t->generation++;
+	e->tcb = (uint32_t)(uintptr_t)tcb;
+	e->name = (uint32_t)(uintptr_t)name;
+	e->state = 0;
+	e->priority = priority;
+	e->reserved = 0;
+	t->count++;
+	t->generation++;
+}
+
+/* call with the scheduler locked */
+static inline void openocd_thread_remove(struct openocd_thread_table *t, const void *tcb)
+{
+	struct openocd_thread_entry *e = openocd_thread_find(t, tcb);
+
+	if (!e)
+		return;
+
+	t->generation++;
+	*e = openocd_thread_entries(t)[t->count - 1];
+	t->count--;
+	t->generation++;
+}
+
+static inline void openocd_thread_set_state(struct openocd_thread_table *t, const void *tcb,
+		unsigned int state)
+{
+	struct openocd_thread_entry *e = openocd_thread_find(t, tcb);
+
+	if (e)
+		e->state = state;
+}
+
+static inline void openocd_thread_set_priority(struct openocd_thread_table *t, const void *tcb,
+		unsigned int priority)
+{
+	struct openocd_thread_entry *e = openocd_thread_find(t, tcb);
+
+	if (e)
+		e->priority = priority;
+}
+
+static inline void openocd_thread_switched_in(struct openocd_thread_table *t, const void *tcb)
+{
+	t->current = (uint32_t)(uintptr_t)tcb;
+}
+
+#endif /* OPENOCD_THREAD_TABLE_H */
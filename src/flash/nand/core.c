@@ -839,22 +839,38 @@ int nand_write_finish(struct nand_device *nand)
 {
 	int retval;
 	uint8_t status;
+	bool cached = nand->use_cache_program && nand->cache_next
+		&& (nand->device->options & NAND_CACHEPRG);
 
-	nand->controller->command(nand, NAND_CMD_PAGEPROG);
+	/* A cache program returns as soon as the page is in the cache
+	 * register, so the next page is loaded while this one programs. */
+	nand->controller->command(nand, cached ? NAND_CMD_CACHEDPROG : NAND_CMD_PAGEPROG);
 
 	retval = nand->controller->nand_ready ?
 		nand->controller->nand_ready(nand, 100) :
 		nand_poll_ready(nand, 100);
-	if (!retval)
+	if (!retval) {
+		nand->cache_pending = false;
 		return ERROR_NAND_OPERATION_TIMEOUT;
+	}
 
 	retval = nand_read_status(nand, &status);
 	if (ERROR_OK != retval) {
+		nand->cache_pending = false;
 		LOG_ERROR("couldn't read status");
 		return ERROR_NAND_OPERATION_FAILED;
 	}
 
-	if (status & NAND_STATUS_FAIL) {
+	/* after a cache program, the result of the page before the last one */
+	uint8_t fail = 0;
+	if (nand->cache_pending)
+		fail |= status & NAND_STATUS_FAIL_N1;
+	if (!cached)
+		fail |= status & NAND_STATUS_FAIL;
+	nand->cache_pending = cached;
+
+	if (fail) {
+		nand->cache_pending = false;
 		LOG_ERROR("write operation didn't pass, status: 0x%2.2x",
 			status);
 		return ERROR_NAND_OPERATION_FAILED;
@@ -67,6 +67,12 @@ struct nand_device {
 	int page_size;
 	int erase_size;
 	bool use_raw;
+	/** Program with the cache program command where the device has it. */
+	bool use_cache_program;
+	/** Set by the caller while the next page of the same block follows. */
+	bool cache_next;
+	/** A cache program was issued, its status is still to be checked. */
+	bool cache_pending;
 	int num_blocks;
 	struct nand_block *blocks;
 	struct nand_device *next;
@@ -250,18 +250,25 @@ COMMAND_HANDLER(handle_nand_write_command)
 		return retval;
 
 	uint32_t total_bytes = s.size;
+	uint32_t pages_per_block = nand->erase_size / nand->page_size;
 	while (s.size > 0) {
 		int bytes_read = nand_fileio_read(nand, &s);
 		if (bytes_read <= 0) {
 			command_print(CMD, "error while reading file");
+			nand->cache_next = false;
 			nand_fileio_cleanup(&s);
 			return ERROR_FAIL;
 		}
 		s.size -= bytes_read;
 
-		retval = nand_write_page(nand, s.address / nand->page_size,
+		/* pipeline pages within a block, finish the last one normally */
+		uint32_t page = s.address / nand->page_size;
+		nand->cache_next = s.size > 0 && (page + 1) % pages_per_block != 0;
+
+		retval = nand_write_page(nand, page,
 				s.page, s.page_size, s.oob, s.oob_size);
 		if (ERROR_OK != retval) {
+			nand->cache_next = false;
 			command_print(CMD, "failed writing file %s "
 				"to NAND flash %s at offset 0x%8.8" PRIx32,
 				CMD_ARGV[1], CMD_ARGV[0], s.address);
@@ -270,6 +277,7 @@ COMMAND_HANDLER(handle_nand_write_command)
 		}
 		s.address += s.page_size;
 	}
+	nand->cache_next = false;
 
 	if (nand_fileio_finish(&s) == ERROR_OK) {
 		command_print(CMD, "wrote file %s to NAND flash %s up to "
@@ -405,6 +413,33 @@ COMMAND_HANDLER(handle_nand_raw_access_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_nand_cache_program_command)
+{
+	if ((CMD_ARGC < 1) || (CMD_ARGC > 2))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	if (NULL == p->device) {
+		command_print(CMD, "#%s: not probed", CMD_ARGV[0]);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[1], p->use_cache_program);
+
+	if (p->use_cache_program && !(p->device->options & NAND_CACHEPRG))
+		command_print(CMD, "%s has no cache program command", p->device->name);
+
+	const char *msg = p->use_cache_program ? "enabled" : "disabled";
+	command_print(CMD, "cache program is %s", msg);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration nand_exec_command_handlers[] = {
 	{
 		.name = "list",
@@ -472,6 +507,13 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.usage = "bank_id ['enable'|'disable']",
 		.help = "raw access to NAND flash device",
 	},
+	{
+		.name = "cache_program",
+		.handler = handle_nand_cache_program_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['enable'|'disable']",
+		.help = "pipeline page writes with the cache program command",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -549,6 +591,9 @@ static COMMAND_HELPER(create_nand_device, const char *bank_name,
 	c->address_cycles = 0;
 	c->page_size = 0;
 	c->use_raw = false;
+	c->use_cache_program = false;
+	c->cache_next = false;
+	c->cache_pending = false;
 	c->next = NULL;
 
 	retval = CALL_COMMAND_HANDLER(controller->nand_device_command, c);
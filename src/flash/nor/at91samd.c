@@ -21,6 +21,7 @@
 #endif
 
 #include "imp.h"
+#include "fifo_write.h"
 #include "helper/binarybuffer.h"
 
 #include <target/cortex_m.h>
@@ -64,6 +65,7 @@
 
 /* NVMCTRL bits */
 #define SAMD_NVM_CTRLB_MANW 0x80
+#define SAMD_NVM_STATUS_ERRORS	0x1c	/* NVME, LOCKE, PROGE */
 
 /* Known identifiers */
 #define SAMD_PROCESSOR_M0	0x01
@@ -845,6 +847,41 @@ static int samd_write(struct flash_bank *bank, const uint8_t *buffer,
 		return res;
 	}
 
+	/* With automatic page write, storing the last word of a page starts
+	 * programming it, so whole pages can be streamed by the generic loader.
+	 * AHB accesses stall until the page is written, the loader then only
+	 * has to check for errors. */
+	if (!manual_wp && offset % chip->page_size == 0 && count >= chip->page_size) {
+		const struct flash_fifo_write_params params = {
+			.width = 4,
+			.num_cmds = 0,
+			.status_addr = SAMD_NVMCTRL + SAMD_NVMCTRL_STATUS,
+			.busy_mask = 0,
+			.error_mask = SAMD_NVM_STATUS_ERRORS,
+		};
+		uint32_t nb_pages = count - count % chip->page_size;
+		uint32_t status;
+
+		res = flash_fifo_write(bank, &params, buffer, offset, nb_pages, &status);
+		if (res == ERROR_OK || res == ERROR_FLASH_OPERATION_FAILED) {
+			/* wait for the last page, report and clear the errors */
+			usleep(200);
+			int res2 = samd_check_error(bank->target);
+			if (res == ERROR_OK)
+				res = res2;
+			if (res != ERROR_OK) {
+				LOG_ERROR("%s: write failed, status 0x%04" PRIx32, __func__, status);
+				return res;
+			}
+			count -= nb_pages;
+			offset += nb_pages;
+			buffer += nb_pages;
+		} else if (res != ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			return res;
+		}
+		/* without a loader all pages are written from the host */
+	}
+
 	while (count) {
 		nb = chip->page_size - offset % chip->page_size;
 		if (count < nb)
@@ -1240,7 +1240,7 @@ static int cfi_intel_write_block(struct flash_bank *bank, const uint8_t *buffer,
 		arm_algo.core_mode = ARM_MODE_SVC;
 		arm_algo.core_state = ARM_STATE_ARM;
 	} else {
-		LOG_ERROR("Unknown architecture");
+		LOG_INFO("No write loader for this architecture, using buffered writes from the host");
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
@@ -1835,7 +1835,7 @@ static int cfi_spansion_write_block(struct flash_bank *bank, const uint8_t *buff
 		armv4_5_algo.core_state = ARM_STATE_ARM;
 		arm_algo = &armv4_5_algo;
 	} else {
-		LOG_ERROR("Unknown architecture");
+		LOG_INFO("No write loader for this architecture, using buffered writes from the host");
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
@@ -2042,20 +2042,16 @@ static int cfi_intel_write_words(struct flash_bank *bank, const uint8_t *word,
 	uint32_t buffermask = buffersize-1;
 	uint32_t bufferwsize = buffersize / bank->bus_width;
 
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base " TARGET_ADDR_FMT ", address 0x%"
-				PRIx32 " not aligned to 2^%d boundary",
-				bank->base, address, cfi_info->max_buf_write_size);
+	/* Check for valid range, a partial buffer must not cross a 2^n boundary */
+	if (wordcount > bufferwsize - (address & buffermask) / bank->bus_width) {
+		LOG_ERROR("Write of %" PRIu32 " words at base " TARGET_ADDR_FMT ", address 0x%"
+				PRIx32 " crosses a 2^%d boundary",
+				wordcount, bank->base, address, cfi_info->max_buf_write_size);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRIu32 " exceeds available buffersize %" PRIu32,
-			wordcount, buffersize);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
+	if (wordcount == 0)
+		return ERROR_OK;
 
 	/* Write to flash buffer */
 	cfi_intel_clear_status_register(bank);
@@ -2082,11 +2078,11 @@ static int cfi_intel_write_words(struct flash_bank *bank, const uint8_t *word,
 	}
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_command(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cfi_target_write_memory(bank, address, bufferwsize, word);
+	retval = cfi_target_write_memory(bank, address, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2157,20 +2153,16 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 	uint32_t buffermask = buffersize-1;
 	uint32_t bufferwsize = buffersize / bank->bus_width;
 
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base " TARGET_ADDR_FMT
-			", address 0x%" PRIx32 " not aligned to 2^%d boundary",
-			bank->base, address, cfi_info->max_buf_write_size);
+	/* Check for valid range, a partial buffer must not cross a 2^n boundary */
+	if (wordcount > bufferwsize - (address & buffermask) / bank->bus_width) {
+		LOG_ERROR("Write of %" PRIu32 " words at base " TARGET_ADDR_FMT
+			", address 0x%" PRIx32 " crosses a 2^%d boundary",
+			wordcount, bank->base, address, cfi_info->max_buf_write_size);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRIu32 " exceeds available buffersize %"
-			PRIu32, wordcount, buffersize);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
+	if (wordcount == 0)
+		return ERROR_OK;
 
 	/* Unlock */
 	retval = cfi_spansion_unlock_seq(bank);
@@ -2183,11 +2175,11 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 		return retval;
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_command(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cfi_target_write_memory(bank, address, bufferwsize, word);
+	retval = cfi_target_write_memory(bank, address, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2203,7 +2195,7 @@ static int cfi_spansion_write_words(struct flash_bank *bank, const uint8_t *word
 
 		LOG_ERROR("couldn't write block at base " TARGET_ADDR_FMT
 			", address 0x%" PRIx32 ", size 0x%" PRIx32, bank->base, address,
-			bufferwsize);
+			wordcount);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
@@ -2427,13 +2419,17 @@ static int cfi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t of
 						PRIx32 " bytes remaining", write_p, count);
 				}
 				fallback = true;
-				if ((bufferwsize > 0) && (count >= buffersize) &&
-						!(write_p & buffermask)) {
-					retval = cfi_write_words(bank, buffer, bufferwsize, write_p);
+				if (bufferwsize > 0) {
+					/* up to the next buffer boundary: partial buffers
+					 * also cover unaligned heads and short tails */
+					uint32_t chunk = buffersize - (write_p & buffermask);
+					if (chunk > (count & ~(bank->bus_width - 1)))
+						chunk = count & ~(bank->bus_width - 1);
+					retval = cfi_write_words(bank, buffer, chunk / bank->bus_width, write_p);
 					if (retval == ERROR_OK) {
-						buffer += buffersize;
-						write_p += buffersize;
-						count -= buffersize;
+						buffer += chunk;
+						write_p += chunk;
+						count -= chunk;
 						fallback = false;
 					} else if (retval != ERROR_FLASH_OPER_UNSUPPORTED)
 						return retval;
@@ -27,6 +27,8 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <helper/time_support.h>
+#include <helper/perf.h>
 
 /**
  * @file
@@ -37,15 +39,74 @@
 
 static struct flash_bank *flash_banks;
 
+struct flash_stats flash_stats;
+
+/* granularity of the flash content cache */
+#define FLASH_CACHE_BLOCK_SIZE	1024
+
+bool flash_read_cache = true;
+
+static void flash_cache_invalidate(struct flash_bank *bank)
+{
+	if (bank->cache_valid)
+		memset(bank->cache_valid, 0, DIV_ROUND_UP(
+				DIV_ROUND_UP(bank->cache_size, FLASH_CACHE_BLOCK_SIZE), 32) * 4);
+}
+
+void flash_cache_flush(void)
+{
+	for (struct flash_bank *bank = flash_banks; bank; bank = bank->next)
+		flash_cache_invalidate(bank);
+}
+
+static void flash_cache_free(struct flash_bank *bank)
+{
+	if (bank->cache) {
+		uint32_t blocks = DIV_ROUND_UP(bank->cache_size, FLASH_CACHE_BLOCK_SIZE);
+		for (uint32_t block = 0; block < blocks; block++)
+			free(bank->cache[block]);
+	}
+	free(bank->cache);
+	free(bank->cache_valid);
+	bank->cache = NULL;
+	bank->cache_valid = NULL;
+	bank->cache_size = 0;
+}
+
 int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
 	int retval;
+	int64_t start = timeval_us();
 
 	retval = bank->driver->erase(bank, first, last);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
 
+	/* the bank may be aliased by virtual banks */
+	flash_cache_flush();
+
+	perf_end(PERF_FLASH_ERASE, start);
+	flash_stats.erase_sectors += last - first + 1;
+	flash_stats.erase_us += timeval_us() - start;
+	return retval;
+}
+
+static int flash_driver_erase_start(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	int retval;
+	int64_t start = timeval_us();
+
+	retval = bank->driver->erase_start(bank, first, last);
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed erasing sectors %u to %u", first, last);
+
+	flash_cache_flush();
+
+	/* the erase itself is accounted while flash_erase_wait() blocks on it */
+	flash_stats.erase_sectors += last - first + 1;
+	flash_stats.erase_us += timeval_us() - start;
 	return retval;
 }
 
@@ -97,6 +158,7 @@ int flash_driver_write(struct flash_bank *bank,
 	uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	int retval;
+	int64_t start = timeval_us();
 
 	retval = bank->driver->write(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
@@ -107,9 +169,132 @@ int flash_driver_write(struct flash_bank *bank,
 			offset);
 	}
 
+	flash_cache_flush();
+
+	perf_end(PERF_FLASH_WRITE, start);
+	flash_stats.write_bytes += count;
+	flash_stats.write_us += timeval_us() - start;
+	return retval;
+}
+
+static int flash_driver_read_uncached(struct flash_bank *bank,
+	uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	int64_t start = timeval_us();
+	int retval = bank->driver->read(bank, buffer, offset, count);
+
+	perf_end(PERF_FLASH_READ, start);
+	flash_stats.read_bytes += count;
+	flash_stats.read_us += timeval_us() - start;
 	return retval;
 }
 
+static bool flash_cache_is_valid(struct flash_bank *bank, uint32_t block)
+{
+	return bank->cache_valid[block / 32] & (1u << (block % 32));
+}
+
+static int flash_cache_read(struct flash_bank *bank,
+	uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	unsigned int generation = target_memory_write_generation();
+
+	if (!bank->cache || bank->cache_size != bank->size) {
+		/* first read, or the bank was probed again */
+		uint32_t blocks = DIV_ROUND_UP(bank->size, FLASH_CACHE_BLOCK_SIZE);
+
+		flash_cache_free(bank);
+		/* the blocks themselves are allocated as they are read */
+		bank->cache = calloc(blocks, sizeof(*bank->cache));
+		bank->cache_valid = calloc(DIV_ROUND_UP(blocks, 32), 4);
+		if (!bank->cache || !bank->cache_valid) {
+			flash_cache_free(bank);
+			return flash_driver_read_uncached(bank, buffer, offset, count);
+		}
+		bank->cache_size = bank->size;
+		bank->cache_generation = generation;
+	}
+
+	if (bank->cache_generation != generation) {
+		flash_cache_invalidate(bank);
+		bank->cache_generation = generation;
+	}
+
+	uint32_t last = (offset + count - 1) / FLASH_CACHE_BLOCK_SIZE;
+	for (uint32_t block = offset / FLASH_CACHE_BLOCK_SIZE; block <= last; block++) {
+		if (flash_cache_is_valid(bank, block))
+			continue;
+
+		/* one driver read for each run of missing blocks */
+		uint32_t end = block + 1;
+		while (end <= last && !flash_cache_is_valid(bank, end))
+			end++;
+
+		for (uint32_t b = block; b < end; b++) {
+			if (bank->cache[b])
+				continue;
+			bank->cache[b] = malloc(FLASH_CACHE_BLOCK_SIZE);
+			if (!bank->cache[b])
+				return flash_driver_read_uncached(bank, buffer, offset, count);
+		}
+
+		uint32_t from = block * FLASH_CACHE_BLOCK_SIZE;
+		uint32_t to = MIN(end * FLASH_CACHE_BLOCK_SIZE, bank->size);
+		/* a run of several blocks is read in one piece and split up */
+		bool single = end - block == 1;
+		uint8_t *run = single ? bank->cache[block] : malloc(to - from);
+		if (!run)
+			return flash_driver_read_uncached(bank, buffer, offset, count);
+
+		int retval = flash_driver_read_uncached(bank, run, from, to - from);
+		if (!single) {
+			for (uint32_t b = block; retval == ERROR_OK && b < end; b++)
+				memcpy(bank->cache[b], run + (b - block) * FLASH_CACHE_BLOCK_SIZE,
+						MIN(FLASH_CACHE_BLOCK_SIZE, to - b * FLASH_CACHE_BLOCK_SIZE));
+			free(run);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (; block < end; block++)
+			bank->cache_valid[block / 32] |= 1u << (block % 32);
+
+		/* a driver reading by an algorithm bumps the generation itself */
+		bank->cache_generation = target_memory_write_generation();
+	}
+
+	while (count > 0) {
+		uint32_t in_block = offset % FLASH_CACHE_BLOCK_SIZE;
+		uint32_t n = MIN(count, FLASH_CACHE_BLOCK_SIZE - in_block);
+
+		memcpy(buffer, bank->cache[offset / FLASH_CACHE_BLOCK_SIZE] + in_block, n);
+		buffer += n;
+		offset += n;
+		count -= n;
+	}
+	return ERROR_OK;
+}
+
+int flash_cache_read_memory(struct target *target, target_addr_t addr,
+		uint32_t count, uint8_t *buffer)
+{
+	if (!flash_read_cache || target->state != TARGET_HALTED || count == 0)
+		return ERROR_FLASH_DST_OUT_OF_BANK;
+
+	for (struct flash_bank *bank = flash_banks; bank; bank = bank->next) {
+		/* only banks read like memory and already probed */
+		if (bank->target != target || bank->driver->read != default_flash_read
+				|| bank->num_sectors == 0)
+			continue;
+
+		if (addr >= bank->base && addr - bank->base < bank->size
+				&& count <= bank->size - (addr - bank->base))
+			return flash_driver_read(bank, buffer, addr - bank->base, count);
+	}
+
+	return ERROR_FLASH_DST_OUT_OF_BANK;
+}
+
 int flash_driver_read(struct flash_bank *bank,
 	uint8_t *buffer, uint32_t offset, uint32_t count)
 {
@@ -117,7 +302,13 @@ int flash_driver_read(struct flash_bank *bank,
 
 	LOG_DEBUG("call flash_driver_read()");
 
-	retval = bank->driver->read(bank, buffer, offset, count);
+	/* the content of a running target's flash may change any time */
+	if (flash_read_cache && bank->target->state == TARGET_HALTED
+			&& count > 0 && offset < bank->size
+			&& count <= bank->size - offset)
+		retval = flash_cache_read(bank, buffer, offset, count);
+	else
+		retval = flash_driver_read_uncached(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error reading to flash at address " TARGET_ADDR_FMT
@@ -206,6 +397,7 @@ void flash_free_all_banks(void)
 			free(bank->sectors);
 			free(bank->prot_blocks);
 		}
+		flash_cache_free(bank);
 
 		free(bank->name);
 		free(bank);
@@ -696,9 +888,392 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 	return aligned1 + bank->minimal_write_gap < aligned2;
 }
 
+/* granularity at which erased parts of a run are found and skipped */
+#define FLASH_WRITE_SKIP_SIZE	256
+
+static bool flash_buffer_is_erased(struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++)
+		if (buffer[i] != bank->erased_value)
+			return false;
+	return true;
+}
+
+/**
+ * Writes a run to freshly erased flash, leaving out the parts of
+ * @a buffer which only hold the erased value wherever the write alignment
+ * and the minimal write gap of the bank allow the write to be split.
+ * Adds the number of bytes actually written to @a written.
+ */
+static int flash_write_skip_erased(struct flash_bank *bank, uint8_t *buffer,
+	target_addr_t address, uint32_t size, uint32_t *written)
+{
+	uint32_t start = 0;	/* of the part not written yet */
+	uint32_t pos = 0;
+	uint32_t skipped = 0;
+	int retval;
+
+	while (pos < size) {
+		uint32_t unit = MIN(FLASH_WRITE_SKIP_SIZE, size - pos);
+		if (!flash_buffer_is_erased(bank, buffer + pos, unit)) {
+			pos += unit;
+			continue;
+		}
+
+		/* find the end of the erased stretch starting at skip_start */
+		uint32_t skip_start = pos;
+		for (pos += unit; pos < size; pos += unit) {
+			unit = MIN(FLASH_WRITE_SKIP_SIZE, size - pos);
+			if (!flash_buffer_is_erased(bank, buffer + pos, unit))
+				break;
+		}
+
+		/* where the written parts around the stretch have to end and begin */
+		target_addr_t end_before = address + skip_start;
+		if (skip_start > start)
+			end_before = flash_write_align_end(bank, end_before - 1) + 1;
+		target_addr_t start_after = address + pos;
+		if (pos < size)
+			start_after = flash_write_align_start(bank, start_after);
+
+		if (start_after <= end_before || start_after < address + start)
+			continue;
+		if (skip_start > start && pos < size
+				&& !flash_write_check_gap(bank, address + skip_start - 1, address + pos))
+			continue;
+
+		uint32_t count = end_before - (address + start);
+		if (count) {
+			retval = flash_driver_write(bank, buffer + start,
+					address + start - bank->base, count);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += count;
+		}
+		skipped += start_after - end_before;
+		start = start_after - address;
+	}
+
+	if (start < size) {
+		retval = flash_driver_write(bank, buffer + start,
+				address + start - bank->base, size - start);
+		if (retval != ERROR_OK)
+			return retval;
+		*written += size - start;
+	}
+
+	if (skipped)
+		LOG_INFO("skipped %" PRIu32 " erased bytes of the run at " TARGET_ADDR_FMT,
+				skipped, address);
+
+	return ERROR_OK;
+}
+
+static int flash_write_region(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, target_addr_t address, uint32_t size, bool erase, bool unlock,
+	uint32_t *written)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, address, size);
+	if (retval == ERROR_OK) {
+		if (erase) {
+			/* calculate and erase sectors */
+			retval = flash_erase_address_range(target,
+					true, address, size);
+		}
+	}
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* no need to program what the erase left behind */
+	if (erase)
+		return flash_write_skip_erased(c, buffer, address, size, written);
+
+	/* write flash sectors */
+	retval = flash_driver_write(c, buffer, address - c->base, size);
+	if (retval == ERROR_OK)
+		*written += size;
+
+	return retval;
+}
+
+int flash_compare_sectors(struct flash_bank *bank, const uint8_t *buffer,
+	uint32_t offset, uint32_t count,
+	struct target_memory_check_block **blocks_out, int *num_blocks_out)
+{
+	uint32_t end_offset = offset + count;
+	int retval;
+
+	/* the parts of the range in each sector */
+	struct target_memory_check_block *blocks = calloc(MAX(bank->num_sectors, 1u),
+			sizeof(*blocks));
+	if (!blocks)
+		return ERROR_FAIL;
+
+	int num_blocks = 0;
+	for (unsigned int sector = 0; sector < bank->num_sectors; sector++) {
+		uint32_t start = MAX(offset, bank->sectors[sector].offset);
+		uint32_t end = MIN(end_offset, bank->sectors[sector].offset + bank->sectors[sector].size);
+		if (start >= end)
+			continue;
+
+		blocks[num_blocks].address = bank->base + start;
+		blocks[num_blocks].size = end - start;
+		num_blocks++;
+	}
+	/* a bank without a sector list, or a range outside of it */
+	if (num_blocks == 0) {
+		blocks[0].address = bank->base + offset;
+		blocks[0].size = count;
+		num_blocks = 1;
+	}
+
+	int64_t start = timeval_us();
+	retval = target_checksum_memory_blocks(bank->target, blocks, num_blocks);
+	flash_stats.checksum_bytes += count;
+	flash_stats.checksum_us += timeval_us() - start;
+	if (retval != ERROR_OK) {
+		free(blocks);
+		return retval;
+	}
+
+	for (int i = 0; i < num_blocks; i++) {
+		uint32_t crc;
+		retval = image_calculate_checksum((uint8_t *)buffer
+				+ (blocks[i].address - bank->base - offset), blocks[i].size, &crc);
+		if (retval != ERROR_OK) {
+			free(blocks);
+			return retval;
+		}
+		blocks[i].result = crc == blocks[i].result;
+	}
+
+	*blocks_out = blocks;
+	*num_blocks_out = num_blocks;
+	return ERROR_OK;
+}
+
+/**
+ * Writes only those sectors of a run whose contents differ from @a buffer.
+ * The sector CRCs are all computed in one go on the target.
+ */
+static int flash_write_diff(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, target_addr_t run_address, uint32_t run_size,
+	bool erase, bool unlock, uint32_t *written)
+{
+	struct target_memory_check_block *blocks;
+	int num_blocks;
+	int retval;
+
+	*written = 0;
+
+	retval = flash_compare_sectors(c, buffer, run_address - c->base, run_size,
+			&blocks, &num_blocks);
+	if (retval != ERROR_OK) {
+		LOG_WARNING("checksum of flash failed, writing the whole run");
+		return flash_write_region(target, c, buffer, run_address, run_size,
+				erase, unlock, written);
+	}
+
+	int unchanged = 0;
+	for (int i = 0; i < num_blocks && retval == ERROR_OK; ) {
+		uint32_t offset = blocks[i].address - run_address;
+
+		if (blocks[i].result) {
+			unchanged++;
+			i++;
+			continue;
+		}
+
+		/* write consecutive differing sectors at once */
+		uint32_t size = blocks[i].size;
+		for (i++; i < num_blocks && !blocks[i].result; i++)
+			size += blocks[i].size;
+
+		retval = flash_write_region(target, c, buffer + offset,
+				run_address + offset, size, erase, unlock, written);
+	}
+
+	LOG_INFO("%d of %d sectors at " TARGET_ADDR_FMT " unchanged, skipped",
+			unchanged, num_blocks, run_address);
+
+	free(blocks);
+	return retval;
+}
+
+/* upper limit for an erase started by flash_driver_erase_start() */
+#define FLASH_ERASE_POLL_TIMEOUT	120000
+
+/* a run of flash_write_unlock(), to be erased and written */
+struct flash_write_job {
+	struct flash_bank *bank;
+	uint8_t *buffer;
+	target_addr_t address;
+	uint32_t size;
+	/* bytes of the run not taken from the image */
+	uint32_t padding;
+	/* erase started by flash_driver_erase_start() and not finished */
+	bool erasing;
+	bool erased;
+};
+
+static int flash_erase_wait(struct flash_write_job *job)
+{
+	int64_t start = timeval_us();
+	int64_t then = timeval_ms();
+	bool done = false;
+	int retval;
+
+	for (;;) {
+		retval = job->bank->driver->erase_poll(job->bank, &done);
+		if (retval != ERROR_OK || done)
+			break;
+
+		if (timeval_ms() - then > FLASH_ERASE_POLL_TIMEOUT) {
+			LOG_ERROR("timeout erasing flash bank %s", job->bank->name);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+		alive_sleep(1);
+	}
+
+	job->erasing = false;
+	job->erased = retval == ERROR_OK;
+	flash_cache_flush();
+	flash_stats.erase_us += timeval_us() - start;
+	return retval;
+}
+
+/**
+ * Erases and writes the runs in order. Before a run is written, the erase
+ * of the next run in every other bank which supports it is started, so it
+ * proceeds in the flash controller while this run is programmed.
+ */
+static int flash_write_jobs(struct target *target, struct flash_write_job *jobs,
+	int num_jobs, uint32_t *written)
+{
+	int retval = ERROR_OK;
+
+	for (int i = 0; i < num_jobs && retval == ERROR_OK; i++) {
+		struct flash_write_job *job = &jobs[i];
+
+		if (job->erasing) {
+			retval = flash_erase_wait(job);
+		} else if (!job->erased) {
+			retval = flash_erase_address_range(target, true, job->address, job->size);
+			job->erased = true;
+		}
+		if (retval != ERROR_OK)
+			break;
+
+		for (int j = i + 1; j < num_jobs; j++) {
+			struct flash_write_job *next = &jobs[j];
+			if (next->bank == job->bank || next->erasing || next->erased
+					|| !next->bank->driver->erase_start)
+				continue;
+
+			/* one erase at a time per bank, the earliest run first */
+			bool busy = false;
+			for (int k = i + 1; k < j; k++)
+				if (jobs[k].bank == next->bank && !jobs[k].erased)
+					busy = true;
+			if (busy)
+				continue;
+
+			retval = flash_iterate_address_range(target, "erase",
+					next->address, next->size, false, &flash_driver_erase_start);
+			if (retval != ERROR_OK)
+				break;
+			LOG_DEBUG("erasing " TARGET_ADDR_FMT " in bank %s while writing bank %s",
+					next->address, next->bank->name, job->bank->name);
+			next->erasing = true;
+		}
+		if (retval != ERROR_OK)
+			break;
+
+		uint32_t job_written = 0;
+		retval = flash_write_skip_erased(job->bank, job->buffer,
+				job->address, job->size, &job_written);
+		if (written)
+			*written += job_written;
+	}
+
+	/* do not leave erases running after a failure */
+	for (int i = 0; i < num_jobs; i++)
+		if (jobs[i].erasing)
+			flash_erase_wait(&jobs[i]);
+
+	return retval;
+}
+
+/* the sectors of @a bank touched by a run, @returns their number */
+static unsigned int flash_run_sectors(struct flash_bank *bank, target_addr_t address,
+	uint32_t size, unsigned int *first, unsigned int *last)
+{
+	uint32_t offset = address - bank->base;
+	unsigned int count = 0;
+
+	for (unsigned int sector = 0; sector < bank->num_sectors; sector++) {
+		if (bank->sectors[sector].offset + bank->sectors[sector].size <= offset
+				|| bank->sectors[sector].offset >= offset + size)
+			continue;
+		if (!count)
+			*first = sector;
+		*last = sector;
+		count++;
+	}
+	return count;
+}
+
+static void flash_write_plan_report(struct flash_write_job *jobs, int num_jobs,
+	bool erase, bool unlock, bool diff_only)
+{
+	uint32_t total = 0, padding = 0;
+	unsigned int total_sectors = 0;
+	int num_banks = 0;
+
+	for (int i = 0; i < num_jobs; i++) {
+		struct flash_write_job *job = &jobs[i];
+		unsigned int first = 0, last = 0;
+		unsigned int sectors = flash_run_sectors(job->bank, job->address,
+				job->size, &first, &last);
+
+		bool new_bank = true;
+		for (int j = 0; j < i; j++)
+			if (jobs[j].bank == job->bank)
+				new_bank = false;
+		if (new_bank)
+			num_banks++;
+
+		LOG_INFO("run %d: bank %s, " TARGET_ADDR_FMT " - " TARGET_ADDR_FMT
+				", %" PRIu32 " bytes, %" PRIu32 " of them padding",
+				i, job->bank->name, job->address, job->address + job->size - 1,
+				job->size, job->padding);
+		if (sectors && (erase || unlock))
+			LOG_INFO("run %d: %s%s%s sectors %u - %u%s", i,
+					unlock ? "unlock" : "",
+					unlock && erase ? " and " : "",
+					erase ? "erase" : "",
+					first, last,
+					erase && job->bank->driver->erase_start && !diff_only
+						? ", erase overlapped with other banks" : "");
+		total += job->size;
+		padding += job->padding;
+		total_sectors += sectors;
+	}
+
+	LOG_INFO("write plan: %d runs in %d banks, %" PRIu32 " bytes (%" PRIu32
+			" padding), %u sectors", num_jobs, num_banks, total, padding, total_sectors);
+	if (erase && diff_only)
+		LOG_INFO("write plan: only the sectors found to differ are erased");
+}
 
 int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock)
+	uint32_t *written, bool erase, bool unlock, bool diff_only, bool dry_run)
 {
 	int retval = ERROR_OK;
 
@@ -706,6 +1281,9 @@ int flash_write_unlock(struct target *target, struct image *image,
 	uint32_t section_offset;
 	struct flash_bank *c;
 	int *padding;
+	/* the whole write plan is built before the flash is touched */
+	struct flash_write_job *jobs = NULL;
+	int num_jobs = 0;
 
 	section = 0;
 	section_offset = 0;
@@ -713,13 +1291,6 @@ int flash_write_unlock(struct target *target, struct image *image,
 	if (written)
 		*written = 0;
 
-	if (erase) {
-		/* assume all sectors need erasing - stops any problems
-		 * when flash_write is called multiple times */
-
-		flash_set_dirty();
-	}
-
 	/* allocate padding array */
 	padding = calloc(image->num_sections, sizeof(*padding));
 
@@ -844,7 +1415,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 				run_size += pad_bytes;
 			}
 
-		} else if (unlock || erase) {
+		} else if (unlock || erase || diff_only) {
 			/* If we're applying any sector automagic, then pad this
 			 * (maybe-combined) segment to the end of its last sector.
 			 */
@@ -876,6 +1447,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 			memset(buffer, c->default_padded_value, padding_at_start);
 
 		buffer_idx = padding_at_start;
+		uint32_t run_padding = run_size;
 
 		/* read sections to the buffer */
 		while (buffer_idx < run_size) {
@@ -906,6 +1478,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 
 			buffer_idx += size_read;
 			section_offset += size_read;
+			run_padding -= size_read;
 
 			/* see if we need to pad the section */
 			if (padding[section]) {
@@ -919,24 +1492,57 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+		struct flash_write_job *new_jobs = realloc(jobs,
+				(num_jobs + 1) * sizeof(*jobs));
+		if (!new_jobs) {
+			free(buffer);
+			retval = ERROR_FAIL;
+			goto done;
 		}
+		jobs = new_jobs;
+		jobs[num_jobs++] = (struct flash_write_job) {
+			.bank = c,
+			.buffer = buffer,
+			.address = run_address,
+			.size = run_size,
+			.padding = run_padding,
+		};
+	}
 
-		if (retval == ERROR_OK) {
-			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-		}
+	if (dry_run) {
+		flash_write_plan_report(jobs, num_jobs, erase, unlock, diff_only);
+		goto done;
+	}
 
-		free(buffer);
+	if (erase) {
+		/* assume all sectors need erasing - stops any problems
+		 * when flash_write is called multiple times */
+
+		flash_set_dirty();
+	}
+
+	/* all protection is removed before the first erase */
+	for (i = 0; i < num_jobs && unlock; i++) {
+		retval = flash_unlock_address_range(target, jobs[i].address, jobs[i].size);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+
+	if (erase && !diff_only) {
+		/* erases are overlapped with the writes of other banks */
+		retval = flash_write_jobs(target, jobs, num_jobs, written);
+		goto done;
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		struct flash_write_job *job = &jobs[i];
+		uint32_t run_written = 0;
+		if (diff_only)
+			retval = flash_write_diff(target, job->bank, job->buffer, job->address,
+					job->size, erase, false, &run_written);
+		else
+			retval = flash_write_region(target, job->bank, job->buffer, job->address,
+					job->size, erase, false, &run_written);
 
 		if (retval != ERROR_OK) {
 			/* abort operation */
@@ -944,10 +1550,13 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 
 		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_written;	/* add run size to total written counter */
 	}
 
 done:
+	for (i = 0; i < num_jobs; i++)
+		free(jobs[i].buffer);
+	free(jobs);
 	free(sections);
 	free(padding);
 
@@ -957,7 +1566,7 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
-	return flash_write_unlock(target, image, written, erase, false);
+	return flash_write_unlock(target, image, written, erase, false, false, false);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size,
@@ -138,12 +138,62 @@ struct flash_bank {
 	/** Array of protection blocks, allocated and initialized by the flash driver */
 	struct flash_sector *prot_blocks;
 
+	/** FLASH_CACHE_BLOCK_SIZE blocks of the content read through
+	 * flash_driver_read(), allocated once read, see flash_read_cache */
+	uint8_t **cache;
+	/** Bitmap of the valid FLASH_CACHE_BLOCK_SIZE blocks of @c cache */
+	uint32_t *cache_valid;
+	uint32_t cache_size;
+	/** target_memory_write_generation() the valid blocks were read at */
+	unsigned int cache_generation;
+
 	struct flash_bank *next; /**< The next flash bank on this chip */
 };
 
 /** Registers the 'flash' subsystem commands */
 int flash_register_commands(struct command_context *cmd_ctx);
 
+/**
+ * Time spent in the phases of flash programming, shown and reset by
+ * "flash stats". Times are in microseconds.
+ */
+struct flash_stats {
+	/** sectors erased, and time blocked on erases */
+	uint64_t erase_sectors;
+	uint64_t erase_us;
+	/** bytes programmed by the drivers, including their loader download */
+	uint64_t write_bytes;
+	uint64_t write_us;
+	/** bytes read back, e.g. to verify */
+	uint64_t read_bytes;
+	uint64_t read_us;
+	/** bytes checksummed on the target */
+	uint64_t checksum_bytes;
+	uint64_t checksum_us;
+};
+
+extern struct flash_stats flash_stats;
+
+/**
+ * Serve flash_driver_read() and GDB reads of memory mapped banks from a copy
+ * of the flash content, enabled by default and set by "flash cache". The
+ * copy stays valid until a flash erase or write through OpenOCD, a memory
+ * write or algorithm run, a resume or a reset. Single steps keep it.
+ */
+extern bool flash_read_cache;
+
+/** Invalidates the cached content of all banks. */
+void flash_cache_flush(void);
+
+/**
+ * Reads @a count bytes at @a addr from the cache of the memory mapped flash
+ * bank of the halted @a target holding them.
+ * @returns ERROR_FLASH_DST_OUT_OF_BANK if the range is not in such a bank
+ * or the cache is disabled, the caller then reads the target memory.
+ */
+int flash_cache_read_memory(struct target *target, target_addr_t addr,
+		uint32_t count, uint8_t *buffer);
+
 /**
  * Erases @a length bytes in the @a target flash, starting at @a addr.
  * The range @a addr to @a addr + @a length - 1 must be strictly
@@ -107,6 +107,31 @@ struct flash_driver {
 	int (*erase)(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 
+	/**
+	 * Start erasing sectors without waiting for the erase to finish
+	 * (optional).  Drivers of banks with their own flash controller
+	 * provide this and erase_poll() so that the core can erase one
+	 * bank while it programs another one.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param first The number of the first sector to erase.
+	 * @param last The number of the last sector to erase.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, unsigned int first,
+		unsigned int last);
+
+	/**
+	 * Continue an erase begun by erase_start(), must be provided
+	 * together with it.  Called repeatedly until @a done is set.
+	 *
+	 * @param bank The bank being erased.
+	 * @param done Set once all sectors are erased.
+	 * @returns ERROR_OK if successful; otherwise, an error code,
+	 * which ends the erase.
+	 */
+	int (*erase_poll)(struct flash_bank *bank, bool *done);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
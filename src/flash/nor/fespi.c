@@ -39,6 +39,7 @@
 
 #include "imp.h"
 #include "spi.h"
+#include "sfdp.h"
 #include <jtag/jtag.h>
 #include <helper/time_support.h>
 #include <target/algorithm.h>
@@ -125,6 +126,12 @@ struct fespi_flash_bank {
 	bool probed;
 	target_addr_t ctrl_base;
 	const struct flash_device *dev;
+	/* filled from SFDP for devices missing in flash_devices */
+	struct flash_device sfdp_dev;
+	/* address bytes sent to the device, 3 or 4 */
+	unsigned int addr_len;
+	/* program pages with the quad input page program command */
+	bool quad_program;
 };
 
 struct fespi_target {
@@ -159,6 +166,8 @@ FLASH_BANK_COMMAND_HANDLER(fespi_flash_bank_command)
 	bank->driver_priv = fespi_info;
 	fespi_info->probed = false;
 	fespi_info->ctrl_base = 0;
+	fespi_info->addr_len = 3;
+	fespi_info->quad_program = false;
 	if (CMD_ARGC >= 7) {
 		COMMAND_PARSE_ADDRESS(CMD_ARGV[6], fespi_info->ctrl_base);
 		LOG_DEBUG("ASSUMING FESPI device at ctrl_base = " TARGET_ADDR_FMT,
@@ -206,7 +215,20 @@ static int fespi_disable_hw_mode(struct flash_bank *bank)
 
 static int fespi_enable_hw_mode(struct flash_bank *bank)
 {
+	struct fespi_flash_bank *fespi_info = bank->driver_priv;
 	uint32_t fctrl;
+
+	/* memory mapped reads beyond 16 MiB need the 4-byte read command */
+	if (fespi_info->probed && fespi_info->addr_len == 4) {
+		uint32_t ffmt = FESPI_INSN_CMD_EN | FESPI_INSN_ADDR_LEN(4)
+			| FESPI_INSN_CMD_PROTO(FESPI_PROTO_S)
+			| FESPI_INSN_ADDR_PROTO(FESPI_PROTO_S)
+			| FESPI_INSN_DATA_PROTO(FESPI_PROTO_S)
+			| FESPI_INSN_CMD_CODE(fespi_info->dev->read_cmd);
+		if (fespi_write_reg(bank, FESPI_REG_FFMT, ffmt) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
 	if (fespi_read_reg(bank, &fctrl, FESPI_REG_FCTRL) != ERROR_OK)
 		return ERROR_FAIL;
 	return fespi_write_reg(bank, FESPI_REG_FCTRL, fctrl | FESPI_FCTRL_EN);
@@ -222,6 +244,36 @@ static int fespi_set_dir(struct flash_bank *bank, bool dir)
 			(fmt & ~(FESPI_FMT_DIR(0xFFFFFFFF))) | FESPI_FMT_DIR(dir));
 }
 
+static int fespi_set_proto(struct flash_bank *bank, unsigned int proto)
+{
+	uint32_t fmt;
+	if (fespi_read_reg(bank, &fmt, FESPI_REG_FMT) != ERROR_OK)
+		return ERROR_FAIL;
+
+	return fespi_write_reg(bank, FESPI_REG_FMT,
+			(fmt & ~(FESPI_FMT_PROTO(0xFFFFFFFF))) | FESPI_FMT_PROTO(proto));
+}
+
+/* Fills @a cmd with the page program command for @a offset, returns its length */
+static unsigned int fespi_program_cmd(struct fespi_flash_bank *fespi_info,
+		uint32_t offset, uint8_t *cmd)
+{
+	unsigned int n = 0;
+
+	if (fespi_info->quad_program)
+		cmd[n++] = fespi_info->addr_len == 4 ?
+			SPIFLASH_QPAGE_PROGRAM_4B : SPIFLASH_QPAGE_PROGRAM;
+	else
+		cmd[n++] = fespi_info->dev->pprog_cmd;
+	if (fespi_info->addr_len == 4)
+		cmd[n++] = offset >> 24;
+	cmd[n++] = offset >> 16;
+	cmd[n++] = offset >> 8;
+	cmd[n++] = offset;
+
+	return n;
+}
+
 static int fespi_txwm_wait(struct flash_bank *bank)
 {
 	int64_t start = timeval_ms();
@@ -319,7 +371,7 @@ static int fespi_wip(struct flash_bank *bank, int timeout)
 	return ERROR_FAIL;
 }
 
-static int fespi_erase_sector(struct flash_bank *bank, int sector)
+static int fespi_erase_block(struct flash_bank *bank, uint32_t offset, uint8_t cmd)
 {
 	struct fespi_flash_bank *fespi_info = bank->driver_priv;
 	int retval;
@@ -333,17 +385,21 @@ static int fespi_erase_sector(struct flash_bank *bank, int sector)
 
 	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_HOLD) != ERROR_OK)
 		return ERROR_FAIL;
-	retval = fespi_tx(bank, fespi_info->dev->erase_cmd);
+	retval = fespi_tx(bank, cmd);
 	if (retval != ERROR_OK)
 		return retval;
-	sector = bank->sectors[sector].offset;
-	retval = fespi_tx(bank, sector >> 16);
+	if (fespi_info->addr_len == 4) {
+		retval = fespi_tx(bank, offset >> 24);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	retval = fespi_tx(bank, offset >> 16);
 	if (retval != ERROR_OK)
 		return retval;
-	retval = fespi_tx(bank, sector >> 8);
+	retval = fespi_tx(bank, offset >> 8);
 	if (retval != ERROR_OK)
 		return retval;
-	retval = fespi_tx(bank, sector);
+	retval = fespi_tx(bank, offset);
 	if (retval != ERROR_OK)
 		return retval;
 	retval = fespi_txwm_wait(bank);
@@ -410,10 +466,16 @@ static int fespi_erase(struct flash_bank *bank, unsigned int first,
 	if (retval != ERROR_OK)
 		goto done;
 
-	for (unsigned int sector = first; sector <= last; sector++) {
-		retval = fespi_erase_sector(bank, sector);
+	/* use the largest erase blocks the range allows */
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t end = bank->sectors[last].offset + bank->sectors[last].size;
+	while (offset < end) {
+		uint8_t cmd;
+		uint32_t size = spi_flash_erase_type(fespi_info->dev, offset, end, &cmd);
+		retval = fespi_erase_block(bank, offset, cmd);
 		if (retval != ERROR_OK)
 			goto done;
+		offset += size;
 		keep_alive();
 	}
 
@@ -435,9 +497,11 @@ static int fespi_protect(struct flash_bank *bank, int set,
 static int slow_fespi_write_buffer(struct flash_bank *bank,
 		const uint8_t *buffer, uint32_t offset, uint32_t len)
 {
+	struct fespi_flash_bank *fespi_info = bank->driver_priv;
+	uint8_t cmd[5];
 	uint32_t ii;
 
-	if (offset & 0xFF000000) {
+	if (fespi_info->addr_len == 3 && (offset & 0xFF000000)) {
 		LOG_ERROR("FESPI interface does not support greater than 3B addressing, can't write to offset 0x%" PRIx32,
 				offset);
 		return ERROR_FAIL;
@@ -451,17 +515,23 @@ static int slow_fespi_write_buffer(struct flash_bank *bank,
 	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_HOLD) != ERROR_OK)
 		return ERROR_FAIL;
 
-	fespi_tx(bank, SPIFLASH_PAGE_PROGRAM);
+	unsigned int cmd_len = fespi_program_cmd(fespi_info, offset, cmd);
+	for (ii = 0; ii < cmd_len; ii++)
+		fespi_tx(bank, cmd[ii]);
 
-	fespi_tx(bank, offset >> 16);
-	fespi_tx(bank, offset >> 8);
-	fespi_tx(bank, offset);
+	if (fespi_info->quad_program) {
+		fespi_txwm_wait(bank);
+		fespi_set_proto(bank, FESPI_PROTO_Q);
+	}
 
 	for (ii = 0; ii < len; ii++)
 		fespi_tx(bank, buffer[ii]);
 
 	fespi_txwm_wait(bank);
 
+	if (fespi_info->quad_program)
+		fespi_set_proto(bank, FESPI_PROTO_S);
+
 	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO) != ERROR_OK)
 		return ERROR_FAIL;
 
@@ -479,6 +549,7 @@ static const uint8_t algorithm_bin[] = {
 #define STEP_WRITE_REG		16
 #define STEP_WIP_WAIT		20
 #define STEP_SET_DIR		24
+#define STEP_SET_PROTO		28
 #define STEP_NOP			0xff
 
 struct algorithm_steps {
@@ -646,11 +717,20 @@ static void as_add_set_dir(struct algorithm_steps *as, bool dir)
 	as_add_step(as, step);
 }
 
+static void as_add_set_proto(struct algorithm_steps *as, unsigned int proto)
+{
+	uint8_t *step = malloc(2);
+	step[0] = STEP_SET_PROTO;
+	step[1] = FESPI_FMT_PROTO(proto);
+	as_add_step(as, step);
+}
+
 /* This should write something less than or equal to a page.*/
 static int steps_add_buffer_write(struct algorithm_steps *as,
+		struct fespi_flash_bank *fespi_info,
 		const uint8_t *buffer, uint32_t chip_offset, uint32_t len)
 {
-	if (chip_offset & 0xFF000000) {
+	if (fespi_info->addr_len == 3 && (chip_offset & 0xFF000000)) {
 		LOG_ERROR("FESPI interface does not support greater than 3B addressing, can't write to offset 0x%" PRIx32,
 				chip_offset);
 		return ERROR_FAIL;
@@ -660,16 +740,19 @@ static int steps_add_buffer_write(struct algorithm_steps *as,
 	as_add_txwm_wait(as);
 	as_add_write_reg(as, FESPI_REG_CSMODE, FESPI_CSMODE_HOLD);
 
-	uint8_t setup[] = {
-		SPIFLASH_PAGE_PROGRAM,
-		chip_offset >> 16,
-		chip_offset >> 8,
-		chip_offset,
-	};
-	as_add_tx(as, sizeof(setup), setup);
+	uint8_t setup[5];
+	as_add_tx(as, fespi_program_cmd(fespi_info, chip_offset, setup), setup);
+
+	/* data phase on all four lines */
+	if (fespi_info->quad_program) {
+		as_add_txwm_wait(as);
+		as_add_set_proto(as, FESPI_PROTO_Q);
+	}
 
 	as_add_tx(as, len, buffer);
 	as_add_txwm_wait(as);
+	if (fespi_info->quad_program)
+		as_add_set_proto(as, FESPI_PROTO_S);
 	as_add_write_reg(as, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO);
 
 	/* fespi_wip() */
@@ -821,7 +904,7 @@ static int fespi_write(struct flash_bank *bank, const uint8_t *buffer,
 			cur_count = count;
 
 		if (algorithm_wa)
-			retval = steps_add_buffer_write(as, buffer, offset, cur_count);
+			retval = steps_add_buffer_write(as, fespi_info, buffer, offset, cur_count);
 		else
 			retval = slow_fespi_write_buffer(bank, buffer, offset, cur_count);
 		if (retval != ERROR_OK)
@@ -904,6 +987,45 @@ static int fespi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 	return ERROR_OK;
 }
 
+static int fespi_read_sfdp_block(struct flash_bank *bank, uint32_t addr,
+		unsigned int words, uint32_t *buffer)
+{
+	int retval;
+
+	fespi_txwm_wait(bank);
+	fespi_set_dir(bank, FESPI_DIR_RX);
+
+	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_HOLD) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* command, 3 address bytes and a dummy byte, discard what comes back */
+	uint8_t setup[] = { SPIFLASH_READ_SFDP, addr >> 16, addr >> 8, addr, 0 };
+	for (unsigned int i = 0; i < sizeof(setup); i++) {
+		fespi_tx(bank, setup[i]);
+		retval = fespi_rx(bank, NULL);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < words; i++) {
+		uint8_t word[4];
+		for (unsigned int j = 0; j < 4; j++) {
+			fespi_tx(bank, 0);
+			retval = fespi_rx(bank, &word[j]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		buffer[i] = le_to_h_u32(word);
+	}
+
+	if (fespi_write_reg(bank, FESPI_REG_CSMODE, FESPI_CSMODE_AUTO) != ERROR_OK)
+		return ERROR_FAIL;
+
+	fespi_set_dir(bank, FESPI_DIR_TX);
+
+	return ERROR_OK;
+}
+
 static int fespi_probe(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
@@ -951,22 +1073,29 @@ static int fespi_probe(struct flash_bank *bank)
 
 	retval = fespi_read_flash_id(bank, &id);
 
-	if (fespi_enable_hw_mode(bank) != ERROR_OK)
-		return ERROR_FAIL;
-	if (retval != ERROR_OK)
-		return retval;
-
 	fespi_info->dev = NULL;
-	for (const struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			fespi_info->dev = p;
-			break;
+	if (retval == ERROR_OK) {
+		for (const struct flash_device *p = flash_devices; p->name ; p++)
+			if (p->device_id == id) {
+				fespi_info->dev = p;
+				break;
+			}
+
+		if (!fespi_info->dev) {
+			if (spi_sfdp(bank, &fespi_info->sfdp_dev, fespi_read_sfdp_block) != ERROR_OK) {
+				LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
+				retval = ERROR_FAIL;
+			} else {
+				fespi_info->sfdp_dev.device_id = id;
+				fespi_info->dev = &fespi_info->sfdp_dev;
+			}
 		}
+	}
 
-	if (!fespi_info->dev) {
-		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
+	if (fespi_enable_hw_mode(bank) != ERROR_OK)
 		return ERROR_FAIL;
-	}
+	if (retval != ERROR_OK)
+		return retval;
 
 	LOG_INFO("Found flash device \'%s\' (ID 0x%08" PRIx32 ")",
 			fespi_info->dev->name, fespi_info->dev->device_id);
@@ -976,8 +1105,9 @@ static int fespi_probe(struct flash_bank *bank)
 
 	if (bank->size <= (1UL << 16))
 		LOG_WARNING("device needs 2-byte addresses - not implemented");
-	if (bank->size > (1UL << 24))
-		LOG_WARNING("device needs paging or 4-byte addresses - not implemented");
+	fespi_info->addr_len = spi_flash_addr_len(fespi_info->dev);
+	if (bank->size > (1UL << 24) && fespi_info->addr_len == 3)
+		LOG_WARNING("device needs paging - not implemented");
 
 	/* if no sectors, treat whole bank as single sector */
 	sectorsize = fespi_info->dev->sectorsize ?
@@ -1028,14 +1158,60 @@ static int get_fespi_info(struct flash_bank *bank, char *buf, int buf_size)
 	}
 
 	snprintf(buf, buf_size, "\nFESPI flash information:\n"
-			"  Device \'%s\' (ID 0x%08" PRIx32 ")\n",
-			fespi_info->dev->name, fespi_info->dev->device_id);
+			"  Device \'%s\' (ID 0x%08" PRIx32 ")\n"
+			"  %u-byte addresses, %s page program\n",
+			fespi_info->dev->name, fespi_info->dev->device_id,
+			fespi_info->addr_len, fespi_info->quad_program ? "quad" : "single");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(fespi_handle_quad_program_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *bank;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct fespi_flash_bank *fespi_info = bank->driver_priv;
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[1], fespi_info->quad_program);
 
+	command_print(CMD, "quad page program %s",
+			fespi_info->quad_program ? "on" : "off");
 	return ERROR_OK;
 }
 
+static const struct command_registration fespi_exec_command_handlers[] = {
+	{
+		.name = "quad_program",
+		.handler = fespi_handle_quad_program_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['on'|'off']",
+		.help = "Program pages with the quad input page program command "
+			"(0x32, 0x34 with 4-byte addresses). The flash must have "
+			"quad mode (QE) enabled.",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration fespi_command_handlers[] = {
+	{
+		.name = "fespi",
+		.mode = COMMAND_ANY,
+		.help = "fespi flash command group",
+		.usage = "",
+		.chain = fespi_exec_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 const struct flash_driver fespi_flash = {
 	.name = "fespi",
+	.commands = fespi_command_handlers,
 	.flash_bank_command = fespi_flash_bank_command,
 	.erase = fespi_erase,
 	.protect = fespi_protect,
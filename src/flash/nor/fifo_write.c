@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Generic flash programming from the working area, for drivers whose
+ * controller programs one unit at a time with a status register to poll.
+ * The driver describes the register sequence, the loaders are shared.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "fifo_write.h"
+#include <helper/binarybuffer.h>
+#include <target/algorithm.h>
+#include <target/arm.h>
+#include <target/armv7m.h>
+
+/* words of the parameter block following the loader code */
+#define FIFO_WRITE_PARAMS	9
+
+static const uint8_t armv7m_fifo_write_code[] = {
+#include "../../../contrib/loaders/flash/fifo_write/armv7m_fifo_write.inc"
+};
+
+static const uint8_t armv4_5_block_write_code[] = {
+#include "../../../contrib/loaders/flash/fifo_write/armv4_5_block_write.inc"
+};
+
+static void fifo_write_set_params(struct target *target, uint8_t *dst,
+		const struct flash_fifo_write_params *params)
+{
+	const uint32_t words[FIFO_WRITE_PARAMS] = {
+		params->num_cmds,
+		params->cmds[0].addr, params->cmds[0].value,
+		params->cmds[1].addr, params->cmds[1].value,
+		params->status_addr, params->busy_mask, params->error_mask,
+		params->width,
+	};
+
+	target_buffer_set_u32_array(target, dst, FIFO_WRITE_PARAMS, words);
+}
+
+static int fifo_write_armv7m(struct target *target, struct working_area *algorithm,
+		uint32_t params_offset, const struct flash_fifo_write_params *params, const uint8_t *buffer,
+		target_addr_t address, uint32_t count, uint32_t *status)
+{
+	struct working_area *source;
+	struct reg_param reg_params[5];
+	struct armv7m_algorithm armv7m_info;
+	int retval;
+
+	if (target_alloc_async_fifo(target, count / params->width, params->width,
+			512, &source) != ERROR_OK) {
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* fifo start (in), status (out) */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* fifo end */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* target address */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* count of units */
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);	/* parameter block */
+
+	buf_set_u32(reg_params[0].value, 0, 32, source->address);
+	buf_set_u32(reg_params[1].value, 0, 32, source->address + source->size);
+	buf_set_u32(reg_params[2].value, 0, 32, address);
+	buf_set_u32(reg_params[3].value, 0, 32, count / params->width);
+	buf_set_u32(reg_params[4].value, 0, 32, algorithm->address + params_offset);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	retval = target_run_flash_async_algorithm(target, buffer, count / params->width,
+			params->width,
+			0, NULL,
+			5, reg_params,
+			source->address, source->size,
+			algorithm->address, 0,
+			&armv7m_info);
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		*status = buf_get_u32(reg_params[0].value, 0, 32);
+
+	target_free_working_area(target, source);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
+static int fifo_write_armv4_5(struct target *target, struct working_area *algorithm,
+		uint32_t params_offset, const struct flash_fifo_write_params *params,
+		const uint8_t *buffer, target_addr_t address, uint32_t count, uint32_t *status)
+{
+	uint32_t buffer_size = 16384;
+	struct working_area *source;
+	struct reg_param reg_params[4];
+	struct arm_algorithm arm_algo;
+	int retval = ERROR_OK;
+
+	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
+		buffer_size /= 2;
+		if (buffer_size <= 256) {
+			LOG_WARNING("no large enough working area available, can't do block memory writes");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* source (in), status (out) */
+	init_reg_param(&reg_params[1], "r2", 32, PARAM_OUT);	/* target address */
+	init_reg_param(&reg_params[2], "r3", 32, PARAM_OUT);	/* count of units */
+	init_reg_param(&reg_params[3], "r4", 32, PARAM_OUT);	/* parameter block */
+
+	arm_algo.common_magic = ARM_COMMON_MAGIC;
+	arm_algo.core_mode = ARM_MODE_SVC;
+	arm_algo.core_state = ARM_STATE_ARM;
+
+	while (count > 0) {
+		uint32_t thisrun_count = MIN(count, buffer_size);
+
+		retval = target_write_buffer(target, source->address, thisrun_count, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, source->address);
+		buf_set_u32(reg_params[1].value, 0, 32, address);
+		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count / params->width);
+		buf_set_u32(reg_params[3].value, 0, 32, algorithm->address + params_offset);
+
+		/* the loader ends with its exit loop */
+		retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
+				algorithm->address, algorithm->address + params_offset - 4,
+				10000, &arm_algo);
+		if (retval != ERROR_OK)
+			break;
+
+		*status = buf_get_u32(reg_params[0].value, 0, 32);
+		if (*status) {
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		buffer += thisrun_count;
+		address += thisrun_count;
+		count -= thisrun_count;
+	}
+
+	target_free_working_area(target, source);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
+int flash_fifo_write(struct flash_bank *bank,
+		const struct flash_fifo_write_params *params,
+		const uint8_t *buffer, uint32_t offset, uint32_t count,
+		uint32_t *status)
+{
+	struct target *target = bank->target;
+	struct working_area *algorithm;
+	bool armv7m = is_armv7m(target_to_armv7m(target));
+	uint8_t *code;
+	uint32_t code_size;
+	int retval;
+
+	assert(params->width == 2 || params->width == 4);
+	assert(params->num_cmds <= ARRAY_SIZE(params->cmds));
+
+	*status = 0;
+	if (count % params->width)
+		return ERROR_FLASH_DST_BREAKS_ALIGNMENT;
+
+	if (armv7m) {
+		code_size = sizeof(armv7m_fifo_write_code);
+	} else if (is_arm(target_to_arm(target))) {
+		code_size = sizeof(armv4_5_block_write_code);
+	} else {
+		LOG_DEBUG("no generic flash loader for %s", target_type_name(target));
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* loader followed by the word aligned parameter block */
+	uint32_t params_offset = (code_size + 3) & ~3u;
+	uint32_t algorithm_size = params_offset + FIFO_WRITE_PARAMS * 4;
+	code = calloc(1, algorithm_size);
+	if (!code)
+		return ERROR_FAIL;
+
+	if (armv7m) {
+		memcpy(code, armv7m_fifo_write_code, code_size);
+	} else {
+		/* ARM instructions in target endianness */
+		for (uint32_t i = 0; i < code_size; i += 4)
+			target_buffer_set_u32(target, code + i, le_to_h_u32(armv4_5_block_write_code + i));
+	}
+	fifo_write_set_params(target, code + params_offset, params);
+
+	if (target_alloc_working_area(target, algorithm_size, &algorithm) != ERROR_OK) {
+		free(code);
+		LOG_WARNING("no working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	retval = target_write_buffer(target, algorithm->address, algorithm_size, code);
+	free(code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, algorithm);
+		return retval;
+	}
+
+	if (armv7m)
+		retval = fifo_write_armv7m(target, algorithm, params_offset, params, buffer,
+				bank->base + offset, count, status);
+	else
+		retval = fifo_write_armv4_5(target, algorithm, params_offset, params, buffer,
+				bank->base + offset, count, status);
+
+	target_free_working_area(target, algorithm);
+
+	return retval;
+}
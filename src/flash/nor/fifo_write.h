@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_FLASH_NOR_FIFO_WRITE_H
+#define OPENOCD_FLASH_NOR_FIFO_WRITE_H
+
+#include <helper/types.h>
+
+struct flash_bank;
+
+/**
+ * How a flash controller programs one unit, for the generic write loaders
+ * in contrib/loaders/flash/fifo_write. For each unit up to two command
+ * words are stored, then the unit itself, then the status register is
+ * polled until none of the busy bits is set and checked for errors.
+ */
+struct flash_fifo_write_params {
+	/** bytes programmed at once, 2 or 4 */
+	unsigned int width;
+	unsigned int num_cmds;
+	struct {
+		/** register address, 0 to store in unit width to the unit's address */
+		uint32_t addr;
+		uint32_t value;
+	} cmds[2];
+	uint32_t status_addr;
+	uint32_t busy_mask;
+	uint32_t error_mask;
+};
+
+/**
+ * Programs @a count bytes at @a offset of @a bank as described by
+ * @a params. On Cortex-M the data is streamed through a fifo in the working
+ * area, on other ARM cores it is written block by block.
+ *
+ * @param status On ERROR_FLASH_OPERATION_FAILED, the status register value
+ * reported by the loader.
+ * @returns ERROR_TARGET_RESOURCE_NOT_AVAILABLE if there is no working area
+ * or no loader for the target, the driver then has to write from the host.
+ */
+int flash_fifo_write(struct flash_bank *bank,
+		const struct flash_fifo_write_params *params,
+		const uint8_t *buffer, uint32_t offset, uint32_t count,
+		uint32_t *status);
+
+#endif /* OPENOCD_FLASH_NOR_FIFO_WRITE_H */
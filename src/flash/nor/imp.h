@@ -46,8 +46,20 @@ int flash_driver_write(struct flash_bank *bank,
 int flash_driver_read(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t count);
 
-/* write (optional verify) an image to flash memory of the given target */
+/**
+ * Compares the sectors of @a bank overlapping @a count bytes at @a offset
+ * with @a buffer, using CRCs computed on the target in one algorithm run
+ * where possible.  On success @a blocks is a newly allocated array of the
+ * parts of the range in each sector, each result set to 1 if it matches.
+ */
+int flash_compare_sectors(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count,
+		struct target_memory_check_block **blocks, int *num_blocks);
+
+/* write (optional verify) an image to flash memory of the given target,
+ * with @a diff_only only the sectors whose contents differ from the image,
+ * with @a dry_run only log the runs, erases and padding which would be done */
 int flash_write_unlock(struct target *target, struct image *image,
-		uint32_t *written, bool erase, bool unlock);
+		uint32_t *written, bool erase, bool unlock, bool diff_only, bool dry_run);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
@@ -22,16 +22,27 @@
 #include "imp.h"
 #include <jtag/jtag.h>
 #include <flash/nor/spi.h>
+#include <flash/nor/sfdp.h>
 #include <helper/time_support.h>
 
 #define JTAGSPI_MAX_TIMEOUT 3000
 
+/* pages queued in one JTAG flush by jtagspi_write() */
+#define JTAGSPI_BATCH_PAGES 16
+/* bounds of the estimated page program time, in us */
+#define JTAGSPI_PROGRAM_US_MIN 50
+#define JTAGSPI_PROGRAM_US_DEF 1000
+#define JTAGSPI_PROGRAM_US_MAX 10000
 
 struct jtagspi_flash_bank {
 	struct jtag_tap *tap;
 	const struct flash_device *dev;
+	/* filled from SFDP for devices missing in flash_devices */
+	struct flash_device sfdp_dev;
 	bool probed;
 	uint32_t ir;
+	/* estimated page program time, tuned by jtagspi_write() */
+	uint32_t program_us;
 };
 
 FLASH_BANK_COMMAND_HANDLER(jtagspi_flash_bank_command)
@@ -50,6 +61,7 @@ FLASH_BANK_COMMAND_HANDLER(jtagspi_flash_bank_command)
 
 	info->tap = NULL;
 	info->probed = false;
+	info->program_us = JTAGSPI_PROGRAM_US_DEF;
 	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[6], info->ir);
 
 	return ERROR_OK;
@@ -75,15 +87,20 @@ static void flip_u8(uint8_t *in, uint8_t *out, int len)
 		out[i] = flip_u32(in[i], 8);
 }
 
-static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
-		uint32_t *addr, uint8_t *data, int len)
+/**
+ * Queue a command without executing the JTAG queue. The data of a read
+ * (negative @a len) is captured bit reversed in @a in_buf, which must stay
+ * valid until the queue is executed, see jtagspi_cmd().
+ */
+static int jtagspi_queue_cmd(struct flash_bank *bank, uint8_t cmd,
+		uint32_t *addr, const uint8_t *data, int len, uint8_t *in_buf)
 {
 	struct jtagspi_flash_bank *info = bank->driver_priv;
 	struct scan_field fields[6];
 	uint8_t marker = 1;
 	uint8_t xfer_bits_buf[4];
 	uint8_t addr_buf[3];
-	uint8_t *data_buf;
+	uint8_t *data_buf = NULL;
 	uint32_t xfer_bits;
 	int is_read, lenb, n;
 
@@ -127,12 +144,7 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 	}
 
 	lenb = DIV_ROUND_UP(len, 8);
-	data_buf = malloc(lenb);
 	if (lenb > 0) {
-		if (data_buf == NULL) {
-			LOG_ERROR("no memory for spi buffer");
-			return ERROR_FAIL;
-		}
 		if (is_read) {
 			fields[n].num_bits = jtag_tap_count_enabled();
 			fields[n].out_value = NULL;
@@ -140,9 +152,14 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 			n++;
 
 			fields[n].out_value = NULL;
-			fields[n].in_value = data_buf;
+			fields[n].in_value = in_buf;
 		} else {
-			flip_u8(data, data_buf, lenb);
+			data_buf = malloc(lenb);
+			if (data_buf == NULL) {
+				LOG_ERROR("no memory for spi buffer");
+				return ERROR_FAIL;
+			}
+			flip_u8((uint8_t *)data, data_buf, lenb);
 			fields[n].out_value = data_buf;
 			fields[n].in_value = NULL;
 		}
@@ -153,11 +170,54 @@ static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
 	jtagspi_set_ir(bank);
 	/* passing from an IR scan to SHIFT-DR clears BYPASS registers */
 	jtag_add_dr_scan(info->tap, n, fields, TAP_IDLE);
-	int retval = jtag_execute_queue();
-
-	if (is_read)
-		flip_u8(data_buf, data, lenb);
+	/* the out data has been copied to the JTAG queue */
 	free(data_buf);
+	return ERROR_OK;
+}
+
+static int jtagspi_cmd(struct flash_bank *bank, uint8_t cmd,
+		uint32_t *addr, uint8_t *data, int len)
+{
+	uint8_t *in_buf = NULL;
+	int lenb = DIV_ROUND_UP(len < 0 ? -len : len, 8);
+
+	if (len < 0 && lenb > 0) {
+		in_buf = malloc(lenb);
+		if (in_buf == NULL) {
+			LOG_ERROR("no memory for spi buffer");
+			return ERROR_FAIL;
+		}
+	}
+
+	int retval = jtagspi_queue_cmd(bank, cmd, addr, data, len, in_buf);
+	if (retval == ERROR_OK)
+		retval = jtag_execute_queue();
+
+	if (in_buf) {
+		if (retval == ERROR_OK)
+			flip_u8(in_buf, data, lenb);
+		free(in_buf);
+	}
+	return retval;
+}
+
+static int jtagspi_read_sfdp_block(struct flash_bank *bank, uint32_t addr,
+		unsigned int words, uint32_t *buffer)
+{
+	/* one dummy byte follows the address */
+	unsigned int len = 1 + 4 * words;
+	uint8_t *buf = malloc(len);
+	if (buf == NULL) {
+		LOG_ERROR("no memory for spi buffer");
+		return ERROR_FAIL;
+	}
+
+	int retval = jtagspi_cmd(bank, SPIFLASH_READ_SFDP, &addr, buf, -8 * len);
+	if (retval == ERROR_OK)
+		for (unsigned int i = 0; i < words; i++)
+			buffer[i] = le_to_h_u32(buf + 1 + 4 * i);
+
+	free(buf);
 	return retval;
 }
 
@@ -190,8 +250,12 @@ static int jtagspi_probe(struct flash_bank *bank)
 		}
 
 	if (!(info->dev)) {
-		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
-		return ERROR_FAIL;
+		if (spi_sfdp(bank, &info->sfdp_dev, jtagspi_read_sfdp_block) != ERROR_OK) {
+			LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
+			return ERROR_FAIL;
+		}
+		info->sfdp_dev.device_id = id;
+		info->dev = &info->sfdp_dev;
 	}
 
 	LOG_INFO("Found flash device \'%s\' (ID 0x%08" PRIx32 ")",
@@ -299,18 +363,17 @@ static int jtagspi_bulk_erase(struct flash_bank *bank)
 	return retval;
 }
 
-static int jtagspi_sector_erase(struct flash_bank *bank, unsigned int sector)
+static int jtagspi_block_erase(struct flash_bank *bank, uint32_t offset, uint8_t cmd)
 {
-	struct jtagspi_flash_bank *info = bank->driver_priv;
 	int retval;
 	int64_t t0 = timeval_ms();
 
 	retval = jtagspi_write_enable(bank);
 	if (retval != ERROR_OK)
 		return retval;
-	jtagspi_cmd(bank, info->dev->erase_cmd, &bank->sectors[sector].offset, NULL, 0);
+	jtagspi_cmd(bank, cmd, &offset, NULL, 0);
 	retval = jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
-	LOG_INFO("sector %u took %" PRId64 " ms", sector, timeval_ms() - t0);
+	LOG_INFO("block at 0x%08" PRIx32 " took %" PRId64 " ms", offset, timeval_ms() - t0);
 	return retval;
 }
 
@@ -352,12 +415,18 @@ static int jtagspi_erase(struct flash_bank *bank, unsigned int first,
 	if (info->dev->erase_cmd == 0x00)
 		return ERROR_FLASH_OPER_UNSUPPORTED;
 
-	for (unsigned int sector = first; sector <= last; sector++) {
-		retval = jtagspi_sector_erase(bank, sector);
+	/* use the largest erase blocks the range allows */
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t end = bank->sectors[last].offset + bank->sectors[last].size;
+	while (offset < end) {
+		uint8_t cmd;
+		uint32_t size = spi_flash_erase_type(info->dev, offset, end, &cmd);
+		retval = jtagspi_block_erase(bank, offset, cmd);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Sector erase failed.");
 			break;
 		}
+		offset += size;
 	}
 
 	return retval;
@@ -380,8 +449,8 @@ static int jtagspi_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offse
 		return ERROR_FLASH_BANK_NOT_PROBED;
 	}
 
-	jtagspi_cmd(bank, SPIFLASH_READ, &offset, buffer, -count*8);
-	return ERROR_OK;
+	/* a single DR scan shifts the whole range */
+	return jtagspi_cmd(bank, SPIFLASH_READ, &offset, buffer, -count*8);
 }
 
 static int jtagspi_page_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
@@ -409,16 +478,79 @@ static int jtagspi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_
 	/* if no write pagesize, use reasonable default */
 	pagesize = info->dev->pagesize ? info->dev->pagesize : SPIFLASH_DEF_PAGESIZE;
 
-	for (n = 0; n < count; n += pagesize) {
-		retval = jtagspi_page_write(bank, buffer + n, offset + n,
-				MIN(count - n, pagesize));
+	/* Queue write enable, page program and status reads of a batch of
+	 * pages in one JTAG flush. The status read after the write enable
+	 * checks WEL; the one after a sleep of the estimated program time
+	 * checks that the page is done before the next one. Pages whose
+	 * checks fail are written again the slow way. */
+	n = 0;
+	while (n < count) {
+		uint8_t wel[JTAGSPI_BATCH_PAGES];
+		uint8_t done[JTAGSPI_BATCH_PAGES];
+		uint32_t start[JTAGSPI_BATCH_PAGES];
+		unsigned int pages = 0;
+
+		while (n < count && pages < JTAGSPI_BATCH_PAGES) {
+			uint32_t addr = offset + n;
+			uint32_t len = MIN(count - n, pagesize - (addr % pagesize));
+
+			start[pages] = n;
+			jtagspi_queue_cmd(bank, SPIFLASH_WRITE_ENABLE, NULL, NULL, 0, NULL);
+			jtagspi_queue_cmd(bank, SPIFLASH_READ_STATUS, NULL, NULL, -8, &wel[pages]);
+			retval = jtagspi_queue_cmd(bank, SPIFLASH_PAGE_PROGRAM, &addr,
+					buffer + n, len * 8, NULL);
+			if (retval != ERROR_OK)
+				return retval;
+			jtag_add_sleep(info->program_us);
+			jtagspi_queue_cmd(bank, SPIFLASH_READ_STATUS, NULL, NULL, -8, &done[pages]);
+
+			pages++;
+			n += len;
+		}
+
+		retval = jtag_execute_queue();
 		if (retval != ERROR_OK) {
 			LOG_ERROR("page write error");
 			return retval;
 		}
-		LOG_DEBUG("wrote page at 0x%08" PRIx32, offset + n);
+
+		bool slow = false;
+		for (unsigned int p = 0; p < pages; p++) {
+			uint8_t wel_status = flip_u32(wel[p], 8);
+			uint8_t done_status = flip_u32(done[p], 8);
+
+			if (done_status & SPIFLASH_BSY_BIT)
+				slow = true;
+
+			/* a page queued while the previous one was still busy
+			 * was ignored by the flash */
+			if ((wel_status & (SPIFLASH_WE_BIT | SPIFLASH_BSY_BIT)) == SPIFLASH_WE_BIT)
+				continue;
+
+			uint32_t end = (p + 1 < pages) ? start[p + 1] : n;
+			LOG_DEBUG("rewriting page at 0x%08" PRIx32, offset + start[p]);
+			retval = jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
+			if (retval == ERROR_OK)
+				retval = jtagspi_page_write(bank, buffer + start[p],
+						offset + start[p], end - start[p]);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("page write error");
+				return retval;
+			}
+		}
+
+		if (slow)
+			info->program_us = MIN(info->program_us + info->program_us / 2,
+					JTAGSPI_PROGRAM_US_MAX);
+		else
+			info->program_us = MAX(info->program_us - info->program_us / 16,
+					JTAGSPI_PROGRAM_US_MIN);
+		LOG_DEBUG("wrote %u pages up to 0x%08" PRIx32 ", program time %" PRIu32 " us",
+				pages, offset + n, info->program_us);
 	}
-	return ERROR_OK;
+
+	/* the last page is checked in any case */
+	return jtagspi_wait(bank, JTAGSPI_MAX_TIMEOUT);
 }
 
 static int jtagspi_info(struct flash_bank *bank, char *buf, int buf_size)
@@ -127,6 +127,7 @@
 #define FTFx_CMD_BLOCKSTAT  0x00
 #define FTFx_CMD_SECTSTAT   0x01
 #define FTFx_CMD_LWORDPROG  0x06
+#define FTFx_CMD_PHRASEPROG 0x07
 #define FTFx_CMD_SECTERASE  0x09
 #define FTFx_CMD_SECTWRITE  0x0b
 #define FTFx_CMD_MASSERASE  0x44
@@ -283,7 +284,7 @@ struct kinetis_chip {
 	enum {
 		FS_PROGRAM_SECTOR = 1,
 		FS_PROGRAM_LONGWORD = 2,
-		FS_PROGRAM_PHRASE = 4,		/* Unsupported */
+		FS_PROGRAM_PHRASE = 4,
 
 		FS_NO_CMD_BLOCKSTAT = 0x40,
 		FS_WIDTH_256BIT = 0x80,
@@ -1801,6 +1802,50 @@ static int kinetis_write_sections(struct flash_bank *bank, const uint8_t *buffer
 }
 
 
+/* Program phrase (8 bytes) per FTFx command, used when FlexRAM is not available */
+static int kinetis_write_phrases(struct flash_bank *bank, const uint8_t *buffer,
+			 uint32_t offset, uint32_t count)
+{
+	int result = ERROR_OK;
+	struct kinetis_flash_bank *k_bank = bank->driver_priv;
+
+	while (count > 0) {
+		uint8_t phrase[8];
+		uint32_t align_begin = offset % sizeof(phrase);
+		uint32_t size = MIN(count, sizeof(phrase) - align_begin);
+		uint8_t ftfx_fstat;
+
+		memset(phrase, 0xff, sizeof(phrase));
+		memcpy(phrase + align_begin, buffer, size);
+
+		LOG_DEBUG("write phrase @ %08" PRIx32, (uint32_t)(bank->base + offset - align_begin));
+
+		result = kinetis_ftfx_command(bank->target, FTFx_CMD_PHRASEPROG,
+				k_bank->prog_base + offset - align_begin,
+				phrase[3], phrase[2], phrase[1], phrase[0],
+				phrase[7], phrase[6], phrase[5], phrase[4],  &ftfx_fstat);
+
+		if (result != ERROR_OK) {
+			LOG_ERROR("Error writing phrase at " TARGET_ADDR_FMT,
+					bank->base + offset);
+			break;
+		}
+
+		if (ftfx_fstat & 0x01)
+			LOG_ERROR("Flash write error at " TARGET_ADDR_FMT,
+					bank->base + offset);
+
+		buffer += size;
+		offset += size;
+		count -= size;
+
+		keep_alive();
+	}
+
+	return result;
+}
+
+
 static int kinetis_write_inner(struct flash_bank *bank, const uint8_t *buffer,
 			 uint32_t offset, uint32_t count)
 {
@@ -1825,7 +1870,7 @@ static int kinetis_write_inner(struct flash_bank *bank, const uint8_t *buffer,
 
 	if (!fallback) {
 		/* program section command */
-		kinetis_write_sections(bank, buffer, offset, count);
+		result = kinetis_write_sections(bank, buffer, offset, count);
 	} else if (k_chip->flash_support & FS_PROGRAM_LONGWORD) {
 		/* program longword command, not supported in FTFE */
 		uint8_t *new_buffer = NULL;
@@ -1891,6 +1936,9 @@ static int kinetis_write_inner(struct flash_bank *bank, const uint8_t *buffer,
 			}
 		}
 		free(new_buffer);
+	} else if (k_chip->flash_support & FS_PROGRAM_PHRASE) {
+		/* program phrase command, e.g. FlexRAM used as EEPROM */
+		result = kinetis_write_phrases(bank, buffer, offset, count);
 	} else {
 		LOG_ERROR("Flash write strategy not implemented");
 		return ERROR_FLASH_OPERATION_FAILED;
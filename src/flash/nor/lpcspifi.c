@@ -22,6 +22,7 @@
 
 #include "imp.h"
 #include "spi.h"
+#include "sfdp.h"
 #include <jtag/jtag.h>
 #include <helper/time_support.h>
 #include <target/algorithm.h>
@@ -54,6 +55,8 @@ struct lpcspifi_flash_bank {
 	uint32_t bank_num;
 	uint32_t max_spi_clock_mhz;
 	const struct flash_device *dev;
+	/* filled from SFDP for devices missing in flash_devices */
+	struct flash_device sfdp_dev;
 };
 
 /* flash_bank lpcspifi <base> <size> <chip_width> <bus_width> <target>
@@ -544,19 +547,36 @@ static int lpcspifi_erase(struct flash_bank *bank, unsigned int first,
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* Erase command */
 	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* Sector size */
 
-	buf_set_u32(reg_params[0].value, 0, 32, bank->sectors[first].offset);
-	buf_set_u32(reg_params[1].value, 0, 32, last - first + 1);
-	buf_set_u32(reg_params[2].value, 0, 32, lpcspifi_info->dev->erase_cmd);
-	buf_set_u32(reg_params[3].value, 0, 32, bank->sectors[first].size);
-
-	/* Run the algorithm */
-	retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
-		erase_algorithm->address,
-		erase_algorithm->address + sizeof(lpcspifi_flash_erase_code) - 4,
-		3000*(last - first + 1), &armv7m_info);
-
-	if (retval != ERROR_OK)
-		LOG_ERROR("Error executing flash erase algorithm");
+	/* one run of the algorithm per stretch of equally sized erase blocks,
+	 * the largest the range allows */
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t end = bank->sectors[last].offset + bank->sectors[last].size;
+	while (offset < end) {
+		uint8_t cmd, next_cmd;
+		uint32_t size = spi_flash_erase_type(lpcspifi_info->dev, offset, end, &cmd);
+		uint32_t count = 1;
+		while (offset + count * size < end
+				&& spi_flash_erase_type(lpcspifi_info->dev, offset + count * size,
+					end, &next_cmd) == size)
+			count++;
+
+		buf_set_u32(reg_params[0].value, 0, 32, offset);
+		buf_set_u32(reg_params[1].value, 0, 32, count);
+		buf_set_u32(reg_params[2].value, 0, 32, cmd);
+		buf_set_u32(reg_params[3].value, 0, 32, size);
+
+		/* Run the algorithm */
+		retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
+			erase_algorithm->address,
+			erase_algorithm->address + sizeof(lpcspifi_flash_erase_code) - 4,
+			3000 * count, &armv7m_info);
+
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Error executing flash erase algorithm");
+			break;
+		}
+		offset += count * size;
+	}
 
 	target_free_working_area(target, erase_algorithm);
 
@@ -838,6 +858,49 @@ static int lpcspifi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 	return retval;
 }
 
+static int lpcspifi_read_sfdp_block(struct flash_bank *bank, uint32_t addr,
+		unsigned int words, uint32_t *buffer)
+{
+	struct target *target = bank->target;
+	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+	uint32_t ssp_base = lpcspifi_info->ssp_base;
+	uint32_t io_base = lpcspifi_info->io_base;
+	uint8_t setup[] = { SPIFLASH_READ_SFDP, addr >> 16, addr >> 8, addr, 0 };
+	uint8_t word[4];
+	uint32_t value;
+	int retval;
+
+	retval = ssp_setcs(target, io_base, 0);
+
+	/* command, 3 address bytes and a dummy byte */
+	for (unsigned int i = 0; i < sizeof(setup) && retval == ERROR_OK; i++) {
+		retval = ssp_write_reg(target, ssp_base, SSP_DATA, setup[i]);
+		if (retval == ERROR_OK)
+			retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
+		if (retval == ERROR_OK)
+			retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
+	}
+
+	/* Dummy writes to clock in data */
+	for (unsigned int i = 0; i < 4 * words && retval == ERROR_OK; i++) {
+		retval = ssp_write_reg(target, ssp_base, SSP_DATA, 0x00);
+		if (retval == ERROR_OK)
+			retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
+		if (retval == ERROR_OK)
+			retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
+		if (retval == ERROR_OK) {
+			word[i % 4] = value;
+			if (i % 4 == 3)
+				buffer[i / 4] = le_to_h_u32(word);
+		}
+	}
+
+	if (retval == ERROR_OK)
+		retval = ssp_setcs(target, io_base, 1);
+
+	return retval;
+}
+
 static int lpcspifi_probe(struct flash_bank *bank)
 {
 	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
@@ -861,10 +924,6 @@ static int lpcspifi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = lpcspifi_set_hw_mode(bank);
-	if (retval != ERROR_OK)
-		return retval;
-
 	lpcspifi_info->dev = NULL;
 	for (const struct flash_device *p = flash_devices; p->name ; p++)
 		if (p->device_id == id) {
@@ -872,6 +931,17 @@ static int lpcspifi_probe(struct flash_bank *bank)
 			break;
 		}
 
+	/* still in SW mode, ask the device itself */
+	if (!lpcspifi_info->dev
+			&& spi_sfdp(bank, &lpcspifi_info->sfdp_dev, lpcspifi_read_sfdp_block) == ERROR_OK) {
+		lpcspifi_info->sfdp_dev.device_id = id;
+		lpcspifi_info->dev = &lpcspifi_info->sfdp_dev;
+	}
+
+	retval = lpcspifi_set_hw_mode(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if (!lpcspifi_info->dev) {
 		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
 		return ERROR_FAIL;
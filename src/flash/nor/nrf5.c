@@ -32,6 +32,9 @@
 #define WATCHDOG_REFRESH_REGISTER       0x40010600
 #define WATCHDOG_REFRESH_VALUE          0x6e524635
 
+/* worst case page erase time of the families plus some margin */
+#define NRF5_PAGE_ERASE_TIMEOUT_MS      100
+
 enum {
 	NRF5_FLASH_BASE = 0x00000000,
 };
@@ -905,6 +908,62 @@ static int nrf5_erase_page(struct flash_bank *bank,
 	return res;
 }
 
+/* Erase @a pages contiguous code pages by a loader polling NVMC READY */
+static int nrf5_ll_flash_erase(struct nrf5_info *chip, uint32_t address,
+		unsigned int pages, uint32_t page_size)
+{
+	struct target *target = chip->target;
+	struct working_area *erase_algorithm;
+	struct reg_param reg_params[5];
+	struct armv7m_algorithm armv7m_info;
+	int retval;
+
+	static const uint8_t nrf5_flash_erase_code[] = {
+#include "../../../contrib/loaders/flash/nrf5/nrf5_erase.inc"
+	};
+
+	LOG_DEBUG("Erasing %u pages from address=0x%" PRIx32, pages, address);
+
+	if (target_alloc_working_area(target, sizeof(nrf5_flash_erase_code),
+			&erase_algorithm) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	retval = target_write_buffer(target, erase_algorithm->address,
+				sizeof(nrf5_flash_erase_code),
+				nrf5_flash_erase_code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, erase_algorithm);
+		return retval;
+	}
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);	/* first page address */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* page count */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* page size */
+	init_reg_param(&reg_params[3], "r6", 32, PARAM_OUT);	/* watchdog refresh value */
+	init_reg_param(&reg_params[4], "r7", 32, PARAM_OUT);	/* watchdog refresh register address */
+
+	buf_set_u32(reg_params[0].value, 0, 32, address);
+	buf_set_u32(reg_params[1].value, 0, 32, pages);
+	buf_set_u32(reg_params[2].value, 0, 32, page_size);
+	buf_set_u32(reg_params[3].value, 0, 32, WATCHDOG_REFRESH_VALUE);
+	buf_set_u32(reg_params[4].value, 0, 32, WATCHDOG_REFRESH_REGISTER);
+
+	retval = target_run_algorithm(target, 0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			erase_algorithm->address, 0,
+			pages * NRF5_PAGE_ERASE_TIMEOUT_MS, &armv7m_info);
+
+	target_free_working_area(target, erase_algorithm);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
 /* Start a low level flash write for the specified region */
 static int nrf5_ll_flash_write(struct nrf5_info *chip, uint32_t address, const uint8_t *buffer, uint32_t bytes)
 {
@@ -1038,6 +1097,27 @@ static int nrf5_erase(struct flash_bank *bank, unsigned int first,
 	if (res != ERROR_OK)
 		return res;
 
+	/* The code pages are erased by one loader run, the UICR and targets
+	 * without a working area fall back to the per sector erase */
+	if (bank->base != NRF5_UICR_BASE) {
+		res = nrf5_nvmc_erase_enable(chip);
+		if (res != ERROR_OK)
+			return res;
+
+		res = nrf5_ll_flash_erase(chip, bank->base + bank->sectors[first].offset,
+				last - first + 1, bank->sectors[first].size);
+
+		int res2 = nrf5_nvmc_read_only(chip);
+		if (res == ERROR_OK)
+			return res2;
+		if (res != ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			LOG_ERROR("Failed to erase nrf5 flash");
+			return res;
+		}
+		LOG_WARNING("no working area available, falling back to slow page erase");
+		res = ERROR_OK;
+	}
+
 	/* For each sector to be erased */
 	for (unsigned int s = first; s <= last && res == ERROR_OK; s++)
 		res = nrf5_erase_page(bank, chip, &bank->sectors[s]);
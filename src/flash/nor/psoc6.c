@@ -775,58 +775,36 @@ exit:
 /** ***********************************************************************************************
  * @brief Programs single Flash Row
  * @param bank current flash bank
+ * @param wa working area for SROM API parameters and row data
  * @param addr address of the flash row
- * @param buffer pointer to the buffer with data
+ * @param row_buf parameter block followed by the row data, see psoc6_program()
  * @param is_sflash true if current flash bank belongs to Supervisory Flash
  * @return ERROR_OK in case of success, ERROR_XXX code otherwise
  *************************************************************************************************/
 static int psoc6_program_row(struct flash_bank *bank,
+	struct working_area *wa,
 	uint32_t addr,
-	const uint8_t *buffer,
+	uint8_t *row_buf,
 	bool is_sflash)
 {
 	struct target *target = bank->target;
 	struct psoc6_target_info *psoc6_info = bank->driver_priv;
-	struct working_area *wa;
 	const uint32_t sromapi_req = is_sflash ? SROMAPI_WRITEROW_REQ : SROMAPI_PROGRAMROW_REQ;
 	uint32_t data_out;
-	int hr = ERROR_OK;
 
 	LOG_DEBUG("Programming ROW @%08" PRIX32, addr);
 
-	hr = target_alloc_working_area(target, psoc6_info->row_sz + 32, &wa);
-	if (hr != ERROR_OK)
-		goto exit;
-
-	hr = target_write_u32(target, wa->address, sromapi_req);
-	if (hr != ERROR_OK)
-		goto exit_free_wa;
-
-	hr = target_write_u32(target,
-			wa->address + 0x04,
-			0x106);
-	if (hr != ERROR_OK)
-		goto exit_free_wa;
-
-	hr = target_write_u32(target, wa->address + 0x08, addr);
-	if (hr != ERROR_OK)
-		goto exit_free_wa;
-
-	hr = target_write_u32(target, wa->address + 0x0C, wa->address + 0x10);
-	if (hr != ERROR_OK)
-		goto exit_free_wa;
+	/* Parameters and data go to the target in a single transfer */
+	target_buffer_set_u32(target, row_buf + 0x00, sromapi_req);
+	target_buffer_set_u32(target, row_buf + 0x04, 0x106);
+	target_buffer_set_u32(target, row_buf + 0x08, addr);
+	target_buffer_set_u32(target, row_buf + 0x0C, wa->address + 0x10);
 
-	hr = target_write_buffer(target, wa->address + 0x10, psoc6_info->row_sz, buffer);
+	int hr = target_write_buffer(target, wa->address, psoc6_info->row_sz + 0x10, row_buf);
 	if (hr != ERROR_OK)
-		goto exit_free_wa;
-
-	hr = call_sromapi(target, sromapi_req, wa->address, &data_out);
-
-exit_free_wa:
-	target_free_working_area(target, wa);
+		return hr;
 
-exit:
-	return hr;
+	return call_sromapi(target, sromapi_req, wa->address, &data_out);
 }
 
 /** ***********************************************************************************************
@@ -845,26 +823,33 @@ static int psoc6_program(struct flash_bank *bank,
 	struct target *target = bank->target;
 	struct psoc6_target_info *psoc6_info = bank->driver_priv;
 	const bool is_sflash = is_sflash_bank(bank);
+	struct working_area *wa;
 	int hr;
 
-	uint8_t page_buf[psoc6_info->row_sz];
+	/* SROM API parameter block followed by the row data */
+	uint8_t row_buf[0x10 + psoc6_info->row_sz];
+	uint8_t *page_buf = row_buf + 0x10;
 
 	hr = sromalgo_prepare(target);
 	if (hr != ERROR_OK)
 		goto exit;
 
+	hr = target_alloc_working_area(target, psoc6_info->row_sz + 32, &wa);
+	if (hr != ERROR_OK)
+		goto exit;
+
 	while (count) {
 		uint32_t row_offset = offset % psoc6_info->row_sz;
 		uint32_t aligned_addr = bank->base + offset - row_offset;
 		uint32_t row_bytes = MIN(psoc6_info->row_sz - row_offset, count);
 
-		memset(page_buf, 0, sizeof(page_buf));
+		memset(page_buf, 0, psoc6_info->row_sz);
 		memcpy(&page_buf[row_offset], buffer, row_bytes);
 
-		hr = psoc6_program_row(bank, aligned_addr, page_buf, is_sflash);
+		hr = psoc6_program_row(bank, wa, aligned_addr, row_buf, is_sflash);
 		if (hr != ERROR_OK) {
 			LOG_ERROR("Failed to program Flash at address 0x%08" PRIX32, aligned_addr);
-			goto exit;
+			goto exit_free_wa;
 		}
 
 		buffer += row_bytes;
@@ -872,6 +857,9 @@ static int psoc6_program(struct flash_bank *bank,
 		count -= row_bytes;
 	}
 
+exit_free_wa:
+	target_free_working_area(target, wa);
+
 exit:
 	sromalgo_release(target);
 	return hr;
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * A NOR flash bank backed by target RAM. Erase, write, read and blank
+ * check go through the same target accesses and loaders as the drivers
+ * of real flash, so the flash write pipeline can be measured on any
+ * board without wearing flash.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "fifo_write.h"
+#include <helper/time_support.h>
+#include <target/target.h>
+
+#define RAMFLASH_DEFAULT_SECTOR_SIZE	4096
+
+struct ramflash_bank {
+	uint32_t sector_size;
+	bool probed;
+};
+
+/* flash bank <name> ramflash <base> <size> 0 0 <target#> [sector_size]
+ */
+FLASH_BANK_COMMAND_HANDLER(ramflash_flash_bank_command)
+{
+	struct ramflash_bank *info;
+	uint32_t sector_size = RAMFLASH_DEFAULT_SECTOR_SIZE;
+
+	if (CMD_ARGC < 6)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 6)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[6], sector_size);
+
+	if (sector_size == 0 || sector_size % 4 || bank->size % sector_size) {
+		LOG_ERROR("bank size must be a multiple of the sector size, a multiple of 4");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	info = malloc(sizeof(struct ramflash_bank));
+	if (info == NULL) {
+		LOG_ERROR("no memory for flash bank info");
+		return ERROR_FAIL;
+	}
+	info->sector_size = sector_size;
+	info->probed = false;
+	bank->driver_priv = info;
+
+	return ERROR_OK;
+}
+
+static int ramflash_probe(struct flash_bank *bank)
+{
+	struct ramflash_bank *info = bank->driver_priv;
+
+	if (info->probed)
+		return ERROR_OK;
+
+	bank->num_sectors = bank->size / info->sector_size;
+	bank->sectors = alloc_block_array(0, info->sector_size, bank->num_sectors);
+	if (bank->sectors == NULL)
+		return ERROR_FAIL;
+
+	info->probed = true;
+	return ERROR_OK;
+}
+
+static int ramflash_erase(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct ramflash_bank *info = bank->driver_priv;
+	struct target *target = bank->target;
+	int retval = ERROR_OK;
+
+	if (target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	uint8_t *erased = malloc(info->sector_size);
+	if (erased == NULL) {
+		LOG_ERROR("no memory for erase buffer");
+		return ERROR_FAIL;
+	}
+	memset(erased, bank->erased_value, info->sector_size);
+
+	for (unsigned int i = first; i <= last; i++) {
+		if (bank->sectors[i].is_protected == 1) {
+			LOG_ERROR("sector %u is protected", i);
+			retval = ERROR_FLASH_PROTECTED;
+			break;
+		}
+
+		retval = target_write_buffer(target, bank->base + bank->sectors[i].offset,
+				bank->sectors[i].size, erased);
+		if (retval != ERROR_OK)
+			break;
+		bank->sectors[i].is_erased = 1;
+	}
+
+	free(erased);
+	return retval;
+}
+
+static int ramflash_protect(struct flash_bank *bank, int set, unsigned int first,
+		unsigned int last)
+{
+	for (unsigned int i = first; i <= last; i++)
+		bank->sectors[i].is_protected = set;
+	return ERROR_OK;
+}
+
+static int ramflash_protect_check(struct flash_bank *bank)
+{
+	/* the protection is kept in bank->sectors only */
+	return ERROR_OK;
+}
+
+static int ramflash_write(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct target *target = bank->target;
+	uint32_t status;
+	int64_t start = timeval_ms();
+
+	if (target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	/* a plain store of each word, the "status register" is the bank
+	 * itself and never busy */
+	const struct flash_fifo_write_params params = {
+		.width = 4,
+		.num_cmds = 0,
+		.status_addr = bank->base,
+		.busy_mask = 0,
+		.error_mask = 0,
+	};
+
+	uint32_t aligned = count & ~3u;
+	int retval = ERROR_OK;
+	if (aligned > 0 && offset % 4 == 0)
+		retval = flash_fifo_write(bank, &params, buffer, offset, aligned, &status);
+	else
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+		/* no loader for this target, write from the host */
+		retval = target_write_buffer(target, bank->base + offset, count, buffer);
+	} else if (retval == ERROR_OK && aligned < count) {
+		retval = target_write_buffer(target, bank->base + offset + aligned,
+				count - aligned, buffer + aligned);
+	}
+
+	LOG_DEBUG("wrote %" PRIu32 " bytes in %" PRId64 " ms", count, timeval_ms() - start);
+	return retval;
+}
+
+static int ramflash_info(struct flash_bank *bank, char *buf, int buf_size)
+{
+	struct ramflash_bank *info = bank->driver_priv;
+
+	snprintf(buf, buf_size, "RAM backed flash bank, %" PRIu32 " byte sectors",
+			info->sector_size);
+	return ERROR_OK;
+}
+
+const struct flash_driver ramflash_flash = {
+	.name = "ramflash",
+	.usage = "<base> <size> 0 0 <target> [sector_size]",
+	.flash_bank_command = ramflash_flash_bank_command,
+	.erase = ramflash_erase,
+	.protect = ramflash_protect,
+	.write = ramflash_write,
+	.read = default_flash_read,
+	.probe = ramflash_probe,
+	.auto_probe = ramflash_probe,
+	.erase_check = default_flash_blank_check,
+	.protect_check = ramflash_protect_check,
+	.info = ramflash_info,
+	.free_driver_priv = default_flash_free_driver_priv,
+};
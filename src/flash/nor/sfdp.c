@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "spi.h"
+#include "sfdp.h"
+#include <helper/bits.h>
+
+#define SFDP_MAGIC			0x50444653	/* "SFDP" */
+#define SFDP_BASIC_FLASH	0xFF00		/* basic flash parameter table */
+#define SFDP_4BYTE_ADDR		0xFF84		/* 4-byte address instruction table */
+
+/* words of the basic flash parameter table used below */
+#define SFDP_BFPT_WORDS		11
+
+/* basic flash parameter table, first word */
+#define SFDP_BFPT_ERASE_4K(w)		((w) & 0x3)
+#define SFDP_BFPT_ERASE_4K_CMD(w)	(((w) >> 8) & 0xFF)
+#define SFDP_BFPT_ADDR_BYTES(w)		(((w) >> 17) & 0x3)
+#define SFDP_BFPT_ADDR_4_ONLY		2
+#define SFDP_BFPT_FAST_144			BIT(21)
+#define SFDP_BFPT_FAST_114			BIT(22)
+
+/* 4-byte address instruction table, first word */
+#define SFDP_4BAIT_READ				BIT(0)
+#define SFDP_4BAIT_FAST_114			BIT(4)
+#define SFDP_4BAIT_FAST_144			BIT(5)
+#define SFDP_4BAIT_PP				BIT(6)
+#define SFDP_4BAIT_ERASE(i)			BIT(9 + (i))
+
+/* 4-byte address commands */
+#define SPIFLASH_READ_4B			0x13
+#define SPIFLASH_PAGE_PROGRAM_4B	0x12
+#define SPIFLASH_FAST_READ_114_4B	0x6C
+#define SPIFLASH_FAST_READ_144_4B	0xEC
+
+int spi_sfdp(struct flash_bank *bank, struct flash_device *dev,
+		read_sfdp_block_t read_sfdp_block)
+{
+	uint32_t header[2], bfpt[SFDP_BFPT_WORDS], fbait[2];
+	unsigned int bfpt_len = 0;
+	bool have_fbait = false;
+	int retval;
+
+	retval = read_sfdp_block(bank, 0x0, ARRAY_SIZE(header), header);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (header[0] != SFDP_MAGIC) {
+		LOG_DEBUG("no SFDP signature, got 0x%08" PRIx32, header[0]);
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	unsigned int num_headers = ((header[1] >> 16) & 0xFF) + 1;
+	LOG_DEBUG("SFDP revision %" PRIu32 ".%" PRIu32 ", %u parameter headers",
+			(header[1] >> 8) & 0xFF, header[1] & 0xFF, num_headers);
+
+	/* later tables of the same kind supersede the earlier ones */
+	for (unsigned int i = 0; i < num_headers; i++) {
+		uint32_t phdr[2];
+		retval = read_sfdp_block(bank, 0x8 + 8 * i, ARRAY_SIZE(phdr), phdr);
+		if (retval != ERROR_OK)
+			return retval;
+
+		unsigned int id = ((phdr[1] >> 16) & 0xFF00) | (phdr[0] & 0xFF);
+		unsigned int len = phdr[0] >> 24;
+		uint32_t ptr = phdr[1] & 0x00FFFFFF;
+
+		LOG_DEBUG("SFDP table 0x%04x, %u words at 0x%06" PRIx32, id, len, ptr);
+
+		if (id == SFDP_BASIC_FLASH) {
+			bfpt_len = MIN(len, ARRAY_SIZE(bfpt));
+			memset(bfpt, 0, sizeof(bfpt));
+			retval = read_sfdp_block(bank, ptr, bfpt_len, bfpt);
+		} else if (id == SFDP_4BYTE_ADDR && len >= ARRAY_SIZE(fbait)) {
+			have_fbait = true;
+			retval = read_sfdp_block(bank, ptr, ARRAY_SIZE(fbait), fbait);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	/* JESD216 has 9 words, later revisions add more */
+	if (bfpt_len < 9) {
+		LOG_ERROR("SFDP basic flash parameter table missing or too short");
+		return ERROR_FAIL;
+	}
+
+	uint32_t density = bfpt[1];
+	uint64_t size_bits;
+	if (density & BIT(31)) {
+		if ((density & 0x7FFFFFFF) > 35) {
+			LOG_ERROR("SFDP density 0x%08" PRIx32 " not supported", density);
+			return ERROR_FAIL;
+		}
+		size_bits = 1ULL << (density & 0x7FFFFFFF);
+	} else {
+		size_bits = (uint64_t)density + 1;
+	}
+
+	dev->name = "SFDP device";
+	dev->size_in_bytes = size_bits / 8;
+	dev->read_cmd = SPIFLASH_READ;
+	dev->pprog_cmd = SPIFLASH_PAGE_PROGRAM;
+	dev->chip_erase_cmd = SPIFLASH_MASS_ERASE;
+	dev->pagesize = SPIFLASH_DEF_PAGESIZE;
+	if (bfpt_len >= 11)
+		dev->pagesize = 1UL << ((bfpt[10] >> 4) & 0xF);
+
+	/* fastest single-line-command read, for the drivers that use it */
+	dev->qread_cmd = 0x00;
+	if (bfpt[0] & SFDP_BFPT_FAST_114)
+		dev->qread_cmd = bfpt[2] >> 24;
+	else if (bfpt[0] & SFDP_BFPT_FAST_144)
+		dev->qread_cmd = (bfpt[2] >> 8) & 0xFF;
+
+	/* erase types 1-4, in table order */
+	struct spi_erase_type types[SPIFLASH_MAX_ERASE_TYPES];
+	for (unsigned int i = 0; i < SPIFLASH_MAX_ERASE_TYPES; i++) {
+		uint32_t w = bfpt[7 + i / 2] >> (16 * (i % 2));
+		types[i].size = (w & 0xFF) ? 1UL << (w & 0xFF) : 0;
+		types[i].cmd = (w >> 8) & 0xFF;
+	}
+	if (!types[0].size && SFDP_BFPT_ERASE_4K(bfpt[0]) == 1) {
+		types[0].size = 4096;
+		types[0].cmd = SFDP_BFPT_ERASE_4K_CMD(bfpt[0]);
+	}
+
+	if (dev->size_in_bytes > (1UL << 24)) {
+		if (have_fbait) {
+			if (!(fbait[0] & SFDP_4BAIT_READ) || !(fbait[0] & SFDP_4BAIT_PP)) {
+				LOG_ERROR("SFDP device lacks 4-byte address read or page program");
+				return ERROR_FAIL;
+			}
+			dev->read_cmd = SPIFLASH_READ_4B;
+			dev->pprog_cmd = SPIFLASH_PAGE_PROGRAM_4B;
+			if (fbait[0] & SFDP_4BAIT_FAST_114)
+				dev->qread_cmd = SPIFLASH_FAST_READ_114_4B;
+			else if (fbait[0] & SFDP_4BAIT_FAST_144)
+				dev->qread_cmd = SPIFLASH_FAST_READ_144_4B;
+			else
+				dev->qread_cmd = 0x00;
+			for (unsigned int i = 0; i < SPIFLASH_MAX_ERASE_TYPES; i++) {
+				if (fbait[0] & SFDP_4BAIT_ERASE(i))
+					types[i].cmd = fbait[1] >> (8 * i);
+				else
+					types[i].size = 0;
+			}
+		} else if (SFDP_BFPT_ADDR_BYTES(bfpt[0]) == SFDP_BFPT_ADDR_4_ONLY) {
+			LOG_ERROR("SFDP device needs 4-byte addresses but has no 4-byte instruction table");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* sort the erase types by ascending size, drop the unused ones */
+	memset(dev->erase_types, 0, sizeof(dev->erase_types));
+	unsigned int num_types = 0;
+	for (unsigned int i = 0; i < SPIFLASH_MAX_ERASE_TYPES; i++) {
+		if (!types[i].size)
+			continue;
+		unsigned int j = num_types++;
+		while (j > 0 && dev->erase_types[j - 1].size > types[i].size) {
+			dev->erase_types[j] = dev->erase_types[j - 1];
+			j--;
+		}
+		dev->erase_types[j] = types[i];
+	}
+
+	/* sectors are the smallest erase blocks, larger ones are combined */
+	if (num_types) {
+		dev->sectorsize = dev->erase_types[0].size;
+		dev->erase_cmd = dev->erase_types[0].cmd;
+	} else {
+		dev->sectorsize = 0;
+		dev->erase_cmd = 0x00;
+	}
+
+	for (unsigned int i = 0; i < num_types; i++)
+		LOG_DEBUG("SFDP erase type: 0x%02x, %" PRIu32 " bytes",
+				dev->erase_types[i].cmd, dev->erase_types[i].size);
+
+	return ERROR_OK;
+}
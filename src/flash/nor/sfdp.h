@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_FLASH_NOR_SFDP_H
+#define OPENOCD_FLASH_NOR_SFDP_H
+
+struct flash_bank;
+struct flash_device;
+
+/**
+ * Reads @a words 32-bit words of the SFDP area starting at @a addr into
+ * @a buffer, converted to host byte order.
+ */
+typedef int (*read_sfdp_block_t)(struct flash_bank *bank, uint32_t addr,
+		unsigned int words, uint32_t *buffer);
+
+/**
+ * Fills @a dev from the Serial Flash Discoverable Parameters (JESD216):
+ * size, page size, erase types, read and program commands, using 4-byte
+ * address commands for devices larger than 16 MiB.
+ * @returns ERROR_FLASH_BANK_NOT_PROBED if the device has no SFDP tables.
+ */
+int spi_sfdp(struct flash_bank *bank, struct flash_device *dev,
+		read_sfdp_block_t read_sfdp_block);
+
+#endif /* OPENOCD_FLASH_NOR_SFDP_H */
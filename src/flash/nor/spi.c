@@ -150,3 +150,36 @@ const struct flash_device flash_devices[] = {
 
 	FLASH_ID(NULL,                  0,    0,    0,    0,    0,    0,          0,     0,       0)
 };
+
+unsigned int spi_flash_addr_len(const struct flash_device *dev)
+{
+	/* Devices beyond 16 MiB are listed with their 4-byte address opcodes,
+	 * those still listed with the 3-byte ones need a bank register. */
+	if (dev->size_in_bytes > (1UL << 24) && dev->pprog_cmd != SPIFLASH_PAGE_PROGRAM)
+		return 4;
+	return 3;
+}
+
+uint32_t spi_flash_erase_type(const struct flash_device *dev, uint32_t offset,
+		uint32_t end, uint8_t *cmd)
+{
+	uint32_t size = 0;
+
+	for (unsigned int i = 0; i < SPIFLASH_MAX_ERASE_TYPES; i++) {
+		uint32_t type_size = dev->erase_types[i].size;
+		if (type_size == 0)
+			break;
+		if (offset % type_size == 0 && end - offset >= type_size) {
+			size = type_size;
+			*cmd = dev->erase_types[i].cmd;
+		}
+	}
+
+	/* no SFDP erase types, one sector at a time */
+	if (size == 0) {
+		size = dev->sectorsize;
+		*cmd = dev->erase_cmd;
+	}
+
+	return size;
+}
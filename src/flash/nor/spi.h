@@ -27,6 +27,14 @@
 
 #ifndef __ASSEMBLER__
 
+#define SPIFLASH_MAX_ERASE_TYPES	4
+
+/* an erase command and the size of the block it erases */
+struct spi_erase_type {
+	uint8_t cmd;
+	uint32_t size;
+};
+
 /* data structure to maintain flash ids from different vendors */
 struct flash_device {
 	char *name;
@@ -39,6 +47,8 @@ struct flash_device {
 	uint32_t pagesize;
 	uint32_t sectorsize;
 	uint32_t size_in_bytes;
+	/* only known from SFDP, ascending sizes, unused entries have size 0 */
+	struct spi_erase_type erase_types[SPIFLASH_MAX_ERASE_TYPES];
 };
 
 #define FLASH_ID(n, re, qr, pp, es, ces, id, psize, ssize, size) \
@@ -71,6 +81,14 @@ struct flash_device {
 
 extern const struct flash_device flash_devices[];
 
+/* @returns the number of address bytes to send to @a dev, 3 or 4 */
+unsigned int spi_flash_addr_len(const struct flash_device *dev);
+
+/* @returns the size of the largest erase block of @a dev starting at
+ * @a offset and ending at or before @a end, its command in @a cmd */
+uint32_t spi_flash_erase_type(const struct flash_device *dev, uint32_t offset,
+		uint32_t end, uint8_t *cmd);
+
 #endif
 
 /* fields in SPI flash status register */
@@ -85,8 +103,12 @@ extern const struct flash_device flash_devices[];
 #define SPIFLASH_READ_STATUS	0x05 /* Read Status Register */
 #define SPIFLASH_WRITE_ENABLE	0x06 /* Write Enable */
 #define SPIFLASH_PAGE_PROGRAM	0x02 /* Page Program */
+#define SPIFLASH_QPAGE_PROGRAM	0x32 /* Quad Input Page Program */
+#define SPIFLASH_QPAGE_PROGRAM_4B	0x34 /* Quad Input Page Program, 4-byte address */
 #define SPIFLASH_FAST_READ		0x0B /* Fast Read */
 #define SPIFLASH_READ			0x03 /* Normal Read */
+#define SPIFLASH_READ_SFDP		0x5A /* Read Serial Flash Discoverable Parameters */
+#define SPIFLASH_MASS_ERASE		0xC7 /* Mass Erase */
 
 #define SPIFLASH_DEF_PAGESIZE	256  /* default for non-page-oriented devices (FRAMs) */
 
@@ -172,20 +172,16 @@ static int stm32x_wait_status_busy(struct flash_bank *bank, int timeout)
 	uint32_t status;
 	int retval = ERROR_OK;
 
-	/* wait for busy to clear */
-	for (;;) {
-		retval = stm32x_get_flash_status(bank, &status);
-		if (retval != ERROR_OK)
-			return retval;
-		LOG_DEBUG("status: 0x%" PRIx32 "", status);
-		if ((status & FLASH_BSY) == 0)
-			break;
-		if (timeout-- <= 0) {
-			LOG_ERROR("timed out waiting for flash");
-			return ERROR_FAIL;
-		}
-		alive_sleep(1);
+	/* wait for busy to clear, the adapter may poll on its own */
+	retval = target_poll_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR),
+			FLASH_BSY, 0, &status, timeout);
+	if (retval == ERROR_TIMEOUT_REACHED) {
+		LOG_ERROR("timed out waiting for flash");
+		return ERROR_FAIL;
 	}
+	if (retval != ERROR_OK)
+		return retval;
+	LOG_DEBUG("status: 0x%" PRIx32 "", status);
 
 	if (status & FLASH_WRPRTERR) {
 		LOG_ERROR("stm32x device protected");
@@ -449,7 +445,6 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 {
 	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
 	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
 	struct working_area *write_algorithm;
 	struct working_area *source;
 	struct reg_param reg_params[5];
@@ -475,17 +470,13 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	}
 
 	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		buffer_size &= ~3UL; /* Make sure it's 4 byte aligned */
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	if (target_alloc_async_fifo(target, count, 2, 512, &source) != ERROR_OK) {
+		/* we already allocated the writing code, but failed to get a
+		 * buffer, free the algorithm */
+		target_free_working_area(target, write_algorithm);
+
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* flash base (in), status (out) */
@@ -28,6 +28,11 @@
 #define FLASH_ERASE_TIMEOUT 10000
 #define FLASH_WRITE_TIMEOUT 5
 
+/* largest fifo used by the write algorithm */
+#define FLASH_WRITE_FIFO_MAX (64 * 1024)
+/* runs of erased flash words at least this long are not programmed */
+#define FLASH_SKIP_ERASED_WORDS 64
+
 /* RM 433 */
 /* Same Flash registers for both banks, */
 /* access depends on Flash Base address */
@@ -131,6 +136,10 @@ struct stm32h7x_flash_bank {
 	uint32_t user_bank_size;
 	uint32_t flash_regs_base;    /* Address of flash reg controller */
 	const struct stm32h7x_part_info *part_info;
+	/* state of an erase started by stm32x_erase_start() */
+	bool erase_bank;
+	unsigned int erase_next;
+	unsigned int erase_last;
 };
 
 enum stm32h7x_opt_rdp {
@@ -523,6 +532,99 @@ flash_lock:
 	return (retval == ERROR_OK) ? retval2 : retval;
 }
 
+static int stm32x_erase_sector_start(struct flash_bank *bank, unsigned int sector)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+
+	LOG_DEBUG("erase sector %u", sector);
+	int retval = stm32x_write_flash_reg(bank, FLASH_CR,
+			stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, sector));
+	if (retval != ERROR_OK)
+		return retval;
+	return stm32x_write_flash_reg(bank, FLASH_CR,
+			stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START, sector));
+}
+
+/* Both banks have their own controller, so one can be erased while the
+ * other one is programmed. A whole bank is erased with one bank erase. */
+static int stm32x_erase_start(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	int retval;
+
+	assert(first < bank->num_sectors);
+	assert(last < bank->num_sectors);
+
+	if (bank->target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	retval = stm32x_unlock_reg(bank);
+	if (retval != ERROR_OK)
+		goto flash_lock;
+
+	stm32x_info->erase_bank = first == 0 && last == bank->num_sectors - 1;
+	stm32x_info->erase_next = first + 1;
+	stm32x_info->erase_last = last;
+
+	if (stm32x_info->erase_bank) {
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_BER | FLASH_PSIZE_64, 0));
+		if (retval == ERROR_OK)
+			retval = stm32x_write_flash_reg(bank, FLASH_CR,
+					stm32x_info->part_info->compute_flash_cr(FLASH_BER | FLASH_PSIZE_64 | FLASH_START, 0));
+	} else {
+		retval = stm32x_erase_sector_start(bank, first);
+	}
+	if (retval == ERROR_OK)
+		return ERROR_OK;
+
+flash_lock:
+	stm32x_lock_reg(bank);
+	return retval;
+}
+
+static int stm32x_erase_poll(struct flash_bank *bank, bool *done)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	uint32_t status;
+	int retval, retval2;
+
+	*done = false;
+
+	retval = stm32x_get_flash_status(bank, &status);
+	if (retval != ERROR_OK)
+		goto flash_lock;
+	if (status & FLASH_QW)
+		return ERROR_OK;
+
+	/* check and clear the errors of the finished operation */
+	retval = stm32x_wait_flash_op_queue(bank, 0);
+	if (retval != ERROR_OK)
+		goto flash_lock;
+
+	if (stm32x_info->erase_bank) {
+		for (unsigned int i = 0; i < bank->num_sectors; i++)
+			bank->sectors[i].is_erased = 1;
+	} else {
+		bank->sectors[stm32x_info->erase_next - 1].is_erased = 1;
+		if (stm32x_info->erase_next <= stm32x_info->erase_last) {
+			retval = stm32x_erase_sector_start(bank, stm32x_info->erase_next++);
+			if (retval == ERROR_OK)
+				return ERROR_OK;
+			goto flash_lock;
+		}
+	}
+
+flash_lock:
+	*done = true;
+	retval2 = stm32x_lock_reg(bank);
+	if (retval2 != ERROR_OK)
+		LOG_ERROR("error during the lock of flash");
+
+	return (retval == ERROR_OK) ? retval2 : retval;
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, unsigned int first,
 		unsigned int last)
 {
@@ -566,8 +668,9 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	 * If the size of the data part of the buffer is not a multiple of .block_size, we get
 	 * "corrupted fifo read" pointer in target_run_flash_async_algorithm()
 	 */
-	uint32_t data_size = 512 * stm32x_info->part_info->block_size;
-	uint32_t buffer_size = 8 + data_size;
+	uint32_t block_size = stm32x_info->part_info->block_size;
+	uint32_t data_size;
+	uint32_t buffer_size;
 	struct working_area *write_algorithm;
 	struct working_area *source;
 	uint32_t address = bank->base + offset;
@@ -593,9 +696,13 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 		return retval;
 	}
 
-	/* memory buffer */
+	/* memory buffer, as large as the working area and the data allow */
+	data_size = MIN(target_get_working_area_avail(target), FLASH_WRITE_FIFO_MAX + 8);
+	data_size = MIN((data_size - MIN(data_size, 8)) / block_size, count) * block_size;
+	data_size = MAX(data_size, 2 * block_size);
+	buffer_size = 8 + data_size;
 	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		data_size /= 2;
+		data_size = (data_size / 2) / block_size * block_size;
 		buffer_size = 8 + data_size;
 		if (data_size <= 256) {
 			/* we already allocated the writing code, but failed to get a
@@ -664,6 +771,65 @@ static int stm32x_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	return retval;
 }
 
+static bool stm32x_is_erased_word(const uint8_t *buffer, uint32_t block_size)
+{
+	for (uint32_t i = 0; i < block_size; i++)
+		if (buffer[i] != 0xff)
+			return false;
+	return true;
+}
+
+/*
+ * Flash words of all 0xFF are already in the erased state; programming
+ * them only costs time (and breaks the ECC of a programmed word).
+ * Program @a count flash words in runs which skip long erased runs.
+ */
+static int stm32x_write_blocks(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	uint32_t block_size = stm32x_info->part_info->block_size;
+	uint32_t start = 0;
+	bool first = true;
+
+	while (start < count) {
+		/* skip the erased words in front of the run */
+		uint32_t end = start;
+		while (end < count && stm32x_is_erased_word(buffer + end * block_size, block_size))
+			end++;
+		if (end - start >= FLASH_SKIP_ERASED_WORDS || end == count)
+			start = end;
+		if (start == count)
+			break;
+
+		/* extend the run until a long enough erased run */
+		uint32_t erased = 0;
+		for (end = start; end < count && erased < FLASH_SKIP_ERASED_WORDS; end++) {
+			if (stm32x_is_erased_word(buffer + end * block_size, block_size))
+				erased++;
+			else
+				erased = 0;
+		}
+		if (erased >= FLASH_SKIP_ERASED_WORDS)
+			end -= erased;
+
+		LOG_DEBUG("programming flash words 0x%" PRIx32 "..0x%" PRIx32,
+				offset + start * block_size, offset + end * block_size);
+		int retval = stm32x_write_block(bank, buffer + start * block_size,
+				offset + start * block_size, end - start);
+		/* after a first run, the slow fallback would program words twice */
+		if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE && !first)
+			retval = ERROR_FAIL;
+		if (retval != ERROR_OK)
+			return retval;
+
+		first = false;
+		start = end;
+	}
+
+	return ERROR_OK;
+}
+
 static int stm32x_write(struct flash_bank *bank, const uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
@@ -691,7 +857,7 @@ static int stm32x_write(struct flash_bank *bank, const uint8_t *buffer,
 
 	/* multiple words (n * .block_size) to be programmed in block */
 	if (blocks_remaining) {
-		retval = stm32x_write_block(bank, buffer, offset, blocks_remaining);
+		retval = stm32x_write_blocks(bank, buffer, offset, blocks_remaining);
 		if (retval != ERROR_OK) {
 			if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 				/* if block write failed (no sufficient working area),
@@ -1202,6 +1368,8 @@ const struct flash_driver stm32h7x_flash = {
 	.commands = stm32x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_poll = stm32x_erase_poll,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
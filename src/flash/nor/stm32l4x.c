@@ -688,7 +688,6 @@ static int stm32l4_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	uint32_t offset, uint32_t count)
 {
 	struct target *target = bank->target;
-	uint32_t buffer_size;
 	struct working_area *write_algorithm;
 	struct working_area *source;
 	uint32_t address = bank->base + offset;
@@ -715,18 +714,10 @@ static int stm32l4_write_block(struct flash_bank *bank, const uint8_t *buffer,
 	}
 
 	/* memory buffer, size *must* be multiple of dword plus one dword for rp and one for wp */
-	buffer_size = target_get_working_area_avail(target) & ~(2 * sizeof(uint32_t) - 1);
-	if (buffer_size < 256) {
+	if (target_alloc_async_fifo(target, count, 8, 256, &source) != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
 		LOG_WARNING("large enough working area not available, can't do block memory writes");
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	} else if (buffer_size > 16384) {
-		/* probably won't benefit from more than 16k ... */
-		buffer_size = 16384;
-	}
-
-	if (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		LOG_ERROR("allocating working area failed");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
@@ -413,6 +413,8 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool diff = false;
+	bool dry_run = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -425,6 +427,15 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "diff") == 0) {
+			diff = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD, "writing changed sectors only");
+		} else if (strcmp(CMD_ARGV[0], "dry-run") == 0) {
+			dry_run = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
 		} else
 			break;
 	}
@@ -454,8 +465,9 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
-	if (retval != ERROR_OK) {
+	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock,
+			diff, dry_run);
+	if (retval != ERROR_OK || dry_run) {
 		image_close(&image);
 		return retval;
 	}
@@ -965,7 +977,31 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer_flash, offset, length);
+	/* Memory mapped flash is compared by CRCs computed on the target,
+	 * only sectors which differ are read back for the report */
+	struct target_memory_check_block *blocks = NULL;
+	int num_blocks = 0;
+	size_t covered = 0;
+	if (p->driver->read == default_flash_read
+			&& flash_compare_sectors(p, buffer_file, offset, length,
+				&blocks, &num_blocks) == ERROR_OK) {
+		for (int i = 0; i < num_blocks; i++)
+			covered += blocks[i].size;
+	}
+	if (covered == length) {
+		for (int i = 0; i < num_blocks && retval == ERROR_OK; i++) {
+			uint32_t pos = blocks[i].address - p->base - offset;
+			if (blocks[i].result)
+				memcpy(buffer_flash + pos, buffer_file + pos, blocks[i].size);
+			else
+				retval = flash_driver_read(p, buffer_flash + pos,
+						offset + pos, blocks[i].size);
+		}
+	} else {
+		/* no target checksum, or sectors with gaps */
+		retval = flash_driver_read(p, buffer_flash, offset, length);
+	}
+	free(blocks);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Flash read error");
 		free(buffer_flash);
@@ -1011,6 +1047,26 @@ void flash_set_dirty(void)
 		for (unsigned int i = 0; i < c->num_sectors; i++)
 			c->sectors[i].is_erased = 0;
 	}
+
+	flash_cache_flush();
+}
+
+COMMAND_HANDLER(handle_flash_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "flush") == 0) {
+			flash_cache_flush();
+			return ERROR_OK;
+		}
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], flash_read_cache);
+		flash_cache_flush();
+	}
+
+	command_print(CMD, "flash read cache %s", flash_read_cache ? "on" : "off");
+	return ERROR_OK;
 }
 
 COMMAND_HANDLER(handle_flash_padded_value_command)
@@ -1031,6 +1087,47 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+static void flash_print_phase(struct command_invocation *cmd, const char *phase,
+		uint64_t bytes, uint64_t us)
+{
+	command_print(cmd, "%-9s %10" PRIu64 " bytes in %8" PRIu64 " ms (%0.3f KiB/s)",
+			phase, bytes, us / 1000, us ? bytes * 1e6 / 1024 / us : 0.0);
+}
+
+COMMAND_HANDLER(handle_flash_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&flash_stats, 0, sizeof(flash_stats));
+		memset(&async_algorithm_stats, 0, sizeof(async_algorithm_stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%-9s %10" PRIu64 " sectors in %6" PRIu64 " ms", "erase:",
+			flash_stats.erase_sectors, flash_stats.erase_us / 1000);
+	flash_print_phase(CMD, "write:", flash_stats.write_bytes, flash_stats.write_us);
+	flash_print_phase(CMD, "read:", flash_stats.read_bytes, flash_stats.read_us);
+	flash_print_phase(CMD, "checksum:", flash_stats.checksum_bytes,
+			flash_stats.checksum_us);
+
+	const struct async_algorithm_stats *a = &async_algorithm_stats;
+	command_print(CMD, "async algorithm: %" PRIu64 " runs, %" PRIu64
+			" bytes in %" PRIu64 " fifo writes (%" PRIu64 " bytes per write), "
+			"fifo drained before %" PRIu64 " writes",
+			a->runs, a->bytes, a->rounds, a->rounds ? a->bytes / a->rounds : 0,
+			a->empty);
+	command_print(CMD, "  start %" PRIu64 " ms, transfer %" PRIu64
+			" ms, blocked on full fifo %" PRIu64 " ms, final wait %" PRIu64 " ms",
+			a->start_us / 1000, a->transfer_us / 1000, a->full_us / 1000,
+			a->drain_us / 1000);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1140,9 +1237,10 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [diff] [dry-run] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used.  Allow optional "
+			"and/or erase the region to be used, optionally only "
+			"the sectors whose contents differ.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
 	{
@@ -1179,6 +1277,23 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "cache",
+		.handler = handle_flash_cache_command,
+		.mode = COMMAND_ANY,
+		.usage = "['on'|'off'|'flush']",
+		.help = "Display or set whether flash reads are served from a copy "
+			"of the flash content, or invalidate the copy.",
+	},
+	{
+		.name = "stats",
+		.handler = handle_flash_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "Display the time spent erasing, writing, reading and "
+			"checksumming flash and streaming data to flash algorithms, "
+			"or reset it.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -21,6 +21,7 @@
 #endif
 
 #include "imp.h"
+#include "fifo_write.h"
 
 /* ----------------------------------------------------------------------
  *                      Internal Support, Helpers
@@ -929,7 +930,21 @@ static int tms470_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t
 	/* read MAXPP */
 	target_read_u32(target, 0xFFE8A07C, &fmmaxpp);
 
-	for (i = 0; i < count; i += 2) {
+	/* clear status, program command and the word, then monitor FMMSTAT */
+	const struct flash_fifo_write_params params = {
+		.width = 2,
+		.num_cmds = 2,
+		.cmds = { { .addr = 0, .value = 0x0040 }, { .addr = 0, .value = 0x0010 } },
+		.status_addr = 0xFFE8BC0C,
+		.busy_mask = 0x0100,
+		.error_mask = 0x3ff,
+	};
+	result = flash_fifo_write(bank, &params, buffer, offset, count, &fmmstat);
+	if (result == ERROR_FLASH_OPERATION_FAILED)
+		LOG_ERROR("fmstat = 0x%04" PRIx32 "", fmmstat);
+
+	/* no working area, write from the host */
+	for (i = 0; result == ERROR_TARGET_RESOURCE_NOT_AVAILABLE && i < count; i += 2) {
 		uint32_t addr = bank->base + offset + i;
 		uint16_t word = (((uint16_t) buffer[i]) << 8) | (uint16_t) buffer[i + 1];
 
@@ -965,6 +980,8 @@ static int tms470_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t
 		} else
 			LOG_INFO("skipping 0xffff at 0x%08" PRIx32 "", addr);
 	}
+	if (result == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		result = ERROR_OK;
 
 	/* restore */
 	target_write_u32(target, 0xFFE88008, fmbsea);
@@ -26,25 +26,6 @@
 #include "log.h"
 #include "binarybuffer.h"
 
-static const unsigned char bit_reverse_table256[] = {
-	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
-	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
-	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
-	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
-	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
-	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
-	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
-	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
-	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
-	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
-	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
-	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
-	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
-	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
-	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
-	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
-};
-
 static const char hex_digits[] = {
 	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
 	'a', 'b', 'c', 'd', 'e', 'f'
@@ -102,7 +83,18 @@ bool buf_cmp_mask(const void *_buf1, const void *_buf2,
 
 	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
 	unsigned last = size / 8;
-	for (unsigned i = 0; i < last; i++) {
+	unsigned i = 0;
+
+	/* eight bytes at a time, then the rest byte by byte */
+	for (; i + 8 <= last; i += 8) {
+		uint64_t a, b, m;
+		memcpy(&a, buf1 + i, sizeof(a));
+		memcpy(&b, buf2 + i, sizeof(b));
+		memcpy(&m, mask + i, sizeof(m));
+		if ((a ^ b) & m)
+			return true;
+	}
+	for (; i < last; i++) {
 		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
 			return true;
 	}
@@ -133,52 +125,57 @@ void *buf_set_buf(const void *_src, unsigned src_start,
 {
 	const uint8_t *src = _src;
 	uint8_t *dst = _dst;
-	unsigned i, sb, db, sq, dq, lb, lq;
+	unsigned sq, dq, n;
 
-	sb = src_start / 8;
-	db = dst_start / 8;
+	src += src_start / 8;
+	dst += dst_start / 8;
 	sq = src_start % 8;
 	dq = dst_start % 8;
-	lb = len / 8;
-	lq = len % 8;
-
-	src += sb;
-	dst += db;
-
-	/* check if both buffers are on byte boundary and
-	 * len is a multiple of 8bit so we can simple copy
-	 * the buffer */
-	if ((sq == 0) && (dq == 0) &&  (lq == 0)) {
-		for (i = 0; i < lb; i++)
-			*dst++ = *src++;
+
+	/* bring the destination to a byte boundary */
+	if (dq) {
+		n = MIN(8 - dq, len);
+		buf_set_u32(dst, dq, n, buf_get_u32(src, sq, n));
+		dst++;
+		len -= n;
+		src += (sq + n) / 8;
+		sq = (sq + n) % 8;
+	}
+
+	if (sq == 0) {
+		/* same alignment: whole bytes, then the trailing bits */
+		memcpy(dst, src, len / 8);
+		if (len % 8)
+			buf_set_u32(dst, len & ~7u, len % 8, src[len / 8]);
 		return _dst;
 	}
 
-	/* fallback to slow bit copy */
-	for (i = 0; i < len; i++) {
-		if (((*src >> (sq&7)) & 1) == 1)
-			*dst |= 1 << (dq&7);
-		else
-			*dst &= ~(1 << (dq&7));
-		if (sq++ == 7) {
-			sq = 0;
-			src++;
-		}
-		if (dq++ == 7) {
-			dq = 0;
-			dst++;
-		}
+	/* shifted copy, 64 bits per step; the source word needs a ninth byte */
+	for (; len >= 64; len -= 64) {
+		uint64_t w = le_to_h_u64(src) >> sq;
+		w |= (uint64_t)src[8] << (64 - sq);
+		h_u64_to_le(dst, w);
+		src += 8;
+		dst += 8;
+	}
+	for (; len >= 8; len -= 8) {
+		*dst++ = (src[0] >> sq) | (src[1] << (8 - sq));
+		src++;
 	}
+	if (len)
+		buf_set_u32(dst, 0, len, buf_get_u32(src, sq, len));
 
 	return _dst;
 }
 
 uint32_t flip_u32(uint32_t value, unsigned int num)
 {
-	uint32_t c = (bit_reverse_table256[value & 0xff] << 24) |
-		(bit_reverse_table256[(value >> 8) & 0xff] << 16) |
-		(bit_reverse_table256[(value >> 16) & 0xff] << 8) |
-		(bit_reverse_table256[(value >> 24) & 0xff]);
+	/* swap ever smaller groups of bits, without table lookups */
+	uint32_t c = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+	c = ((c >> 2) & 0x33333333) | ((c & 0x33333333) << 2);
+	c = ((c >> 4) & 0x0f0f0f0f) | ((c & 0x0f0f0f0f) << 4);
+	c = ((c >> 8) & 0x00ff00ff) | ((c & 0x00ff00ff) << 8);
+	c = (c >> 16) | (c << 16);
 
 	if (num < 32)
 		c = c >> (32 - num);
@@ -361,30 +358,38 @@ void bit_copy_discard(struct bit_copy_queue *q)
  *
  * @return The number of converted hexadecimal pairs.
  */
+static inline int hex_digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;	/* lower case */
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
 size_t unhexify(uint8_t *bin, const char *hex, size_t count)
 {
 	size_t i;
-	char tmp;
 
 	if (!bin || !hex)
 		return 0;
 
 	memset(bin, 0, count);
 
-	for (i = 0; i < 2 * count; i++) {
-		if (hex[i] >= 'a' && hex[i] <= 'f')
-			tmp = hex[i] - 'a' + 10;
-		else if (hex[i] >= 'A' && hex[i] <= 'F')
-			tmp = hex[i] - 'A' + 10;
-		else if (hex[i] >= '0' && hex[i] <= '9')
-			tmp = hex[i] - '0';
-		else
-			return i / 2;
-
-		bin[i / 2] |= tmp << (4 * ((i + 1) % 2));
+	/* a pair at a time, an invalid digit (or the terminating null) stops */
+	for (i = 0; i < count; i++) {
+		int high = hex_digit_value(hex[2 * i]);
+		if (high < 0)
+			break;
+		bin[i] = high << 4;
+		int low = hex_digit_value(hex[2 * i + 1]);
+		if (low < 0)
+			break;
+		bin[i] |= low;
 	}
 
-	return i / 2;
+	return i;
 }
 
 /**
@@ -401,20 +406,63 @@ size_t unhexify(uint8_t *bin, const char *hex, size_t count)
  */
 size_t hexify(char *hex, const uint8_t *bin, size_t count, size_t length)
 {
-	size_t i;
-	uint8_t tmp;
-
 	if (!length)
 		return 0;
 
-	for (i = 0; i < length - 1 && i < 2 * count; i++) {
-		tmp = (bin[i / 2] >> (4 * ((i + 1) % 2))) & 0x0f;
-		hex[i] = hex_digits[tmp];
+	size_t chars = MIN(length - 1, 2 * count);
+	size_t bytes = chars / 2;
+	char *p = hex;
+
+	for (size_t i = 0; i < bytes; i++) {
+		*p++ = hex_digits[bin[i] >> 4];
+		*p++ = hex_digits[bin[i] & 0x0f];
 	}
+	if (chars % 2)
+		*p++ = hex_digits[bin[bytes] >> 4];
 
-	hex[i] = 0;
+	*p = 0;
 
-	return i;
+	return chars;
+}
+
+/**
+ * Compute the sum modulo 256 of the bytes of a buffer, the checksum of the
+ * GDB remote protocol. Eight bytes at a time are added in 16 bit lanes of
+ * a 64 bit word.
+ *
+ * @param[in] buf Buffer to sum up.
+ * @param[in] size Number of bytes.
+ *
+ * @returns The sum of the bytes modulo 256.
+ */
+uint8_t buf_checksum8(const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	uint8_t sum = 0;
+
+	while (size >= 8) {
+		/* a lane gets at most 255 per word, 256 words fit into 16 bits */
+		size_t words = MIN(size / 8, 256u);
+		uint64_t even = 0, odd = 0;
+
+		for (size_t i = 0; i < words; i++) {
+			uint64_t w;
+			memcpy(&w, p, sizeof(w));
+			even += w & 0x00ff00ff00ff00ffULL;
+			odd += (w >> 8) & 0x00ff00ff00ff00ffULL;
+			p += 8;
+		}
+		size -= words * 8;
+
+		/* the low byte of a lane is its sum modulo 256 */
+		sum += even + (even >> 16) + (even >> 32) + (even >> 48);
+		sum += odd + (odd >> 16) + (odd >> 32) + (odd >> 48);
+	}
+
+	while (size--)
+		sum += *p++;
+
+	return sum;
 }
 
 void buffer_shr(void *_buf, unsigned buf_len, unsigned count)
@@ -49,11 +49,25 @@ static inline void buf_set_u32(uint8_t *_buffer,
 		buffer[1] = (value >> 8) & 0xff;
 		buffer[0] = (value >> 0) & 0xff;
 	} else {
-		for (unsigned i = first; i < first + num; i++) {
-			if (((value >> (i - first)) & 1) == 1)
-				buffer[i / 8] |= 1 << (i % 8);
-			else
-				buffer[i / 8] &= ~(1 << (i % 8));
+		buffer += first / 8;
+		first %= 8;
+
+		/* partial first byte, whole bytes, partial last byte */
+		if (first && num) {
+			unsigned n = num < 8 - first ? num : 8 - first;
+			uint8_t mask = ((1u << n) - 1) << first;
+			*buffer = (*buffer & ~mask) | ((value << first) & mask);
+			buffer++;
+			value >>= n;
+			num -= n;
+		}
+		for (; num >= 8; num -= 8) {
+			*buffer++ = value;
+			value >>= 8;
+		}
+		if (num) {
+			uint8_t mask = (1u << num) - 1;
+			*buffer = (*buffer & ~mask) | (value & mask);
 		}
 	}
 }
@@ -88,11 +102,25 @@ static inline void buf_set_u64(uint8_t *_buffer,
 		buffer[1] = (value >> 8) & 0xff;
 		buffer[0] = (value >> 0) & 0xff;
 	} else {
-		for (unsigned i = first; i < first + num; i++) {
-			if (((value >> (i - first)) & 1) == 1)
-				buffer[i / 8] |= 1 << (i % 8);
-			else
-				buffer[i / 8] &= ~(1 << (i % 8));
+		buffer += first / 8;
+		first %= 8;
+
+		/* partial first byte, whole bytes, partial last byte */
+		if (first && num) {
+			unsigned n = num < 8 - first ? num : 8 - first;
+			uint8_t mask = ((1u << n) - 1) << first;
+			*buffer = (*buffer & ~mask) | ((value << first) & mask);
+			buffer++;
+			value >>= n;
+			num -= n;
+		}
+		for (; num >= 8; num -= 8) {
+			*buffer++ = value;
+			value >>= 8;
+		}
+		if (num) {
+			uint8_t mask = (1u << num) - 1;
+			*buffer = (*buffer & ~mask) | (value & mask);
 		}
 	}
 }
@@ -116,12 +144,18 @@ static inline uint32_t buf_get_u32(const uint8_t *_buffer,
 				(((uint32_t)buffer[2]) << 16) |
 				(((uint32_t)buffer[1]) << 8) |
 				(((uint32_t)buffer[0]) << 0);
+	} else if (num == 0) {
+		return 0;
 	} else {
-		uint32_t result = 0;
-		for (unsigned i = first; i < first + num; i++) {
-			if (((buffer[i / 8] >> (i % 8)) & 1) == 1)
-				result |= 1U << (i - first);
-		}
+		buffer += first / 8;
+		first %= 8;
+
+		/* a byte at a time, from the byte holding the first bit */
+		uint32_t result = *buffer >> first;
+		for (unsigned i = 8 - first; i < num; i += 8)
+			result |= (uint32_t)*++buffer << i;
+		if (num < 32)
+			result &= (1U << num) - 1;
 		return result;
 	}
 }
@@ -154,12 +188,18 @@ static inline uint64_t buf_get_u64(const uint8_t *_buffer,
 				(((uint64_t)buffer[2]) << 16) |
 				(((uint64_t)buffer[1]) << 8)  |
 				(((uint64_t)buffer[0]) << 0));
+	} else if (num == 0) {
+		return 0;
 	} else {
-		uint64_t result = 0;
-		for (unsigned i = first; i < first + num; i++) {
-			if (((buffer[i / 8] >> (i % 8)) & 1) == 1)
-				result = result | ((uint64_t)1 << (uint64_t)(i - first));
-		}
+		buffer += first / 8;
+		first %= 8;
+
+		/* a byte at a time, from the byte holding the first bit */
+		uint64_t result = *buffer >> first;
+		for (unsigned i = 8 - first; i < num; i += 8)
+			result |= (uint64_t)*++buffer << i;
+		if (num < 64)
+			result &= ((uint64_t)1 << num) - 1;
 		return result;
 	}
 }
@@ -238,6 +278,7 @@ void bit_copy_discard(struct bit_copy_queue *q);
  * used in ti-icdi driver and gdb server */
 size_t unhexify(uint8_t *bin, const char *hex, size_t count);
 size_t hexify(char *hex, const uint8_t *bin, size_t count, size_t out_maxlen);
+uint8_t buf_checksum8(const void *buf, size_t size);
 void buffer_shr(void *_buf, unsigned buf_len, unsigned count);
 
 #endif /* OPENOCD_HELPER_BINARYBUFFER_H */
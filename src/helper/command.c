@@ -227,6 +227,44 @@ static struct command *command_root(struct command *c)
 	return c;
 }
 
+/*
+ * Every command is also kept in a hash table keyed by its parent and its
+ * name, so that resolving a (sub)command does not walk the sorted lists;
+ * the root list alone holds several hundred commands. Root commands are
+ * keyed by the Jim interpreter of their context instead, which the
+ * copies of a context share with it.
+ */
+#define COMMAND_HASH_SIZE	1024
+
+static struct command *command_hash[COMMAND_HASH_SIZE];
+
+static unsigned int command_hash_index(const void *key, const char *name)
+{
+	/* FNV-1a over the name, seeded with the parent */
+	uint32_t h = 2166136261u ^ (uint32_t)((uintptr_t)key >> 4);
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 16777619u;
+	}
+	return h & (COMMAND_HASH_SIZE - 1);
+}
+
+static void command_hash_add(struct command *c)
+{
+	struct command **bucket = &command_hash[command_hash_index(c->hash_key, c->name)];
+	c->hash_next = *bucket;
+	*bucket = c;
+}
+
+static void command_hash_remove(struct command *c)
+{
+	struct command **p = &command_hash[command_hash_index(c->hash_key, c->name)];
+	while (*p && *p != c)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = c->hash_next;
+}
+
 /**
  * Find a command by name from a list of commands.
  * @returns Returns the named command if it exists in the list.
@@ -234,8 +272,14 @@ static struct command *command_root(struct command *c)
  */
 static struct command *command_find(struct command *head, const char *name)
 {
-	for (struct command *cc = head; cc; cc = cc->next) {
-		if (strcmp(cc->name, name) == 0)
+	if (!head)
+		return NULL;
+
+	/* all the commands of a list share the key */
+	const void *key = head->hash_key;
+	struct command *cc = command_hash[command_hash_index(key, name)];
+	for (; cc; cc = cc->hash_next) {
+		if (cc->hash_key == key && strcmp(cc->name, name) == 0)
 			return cc;
 	}
 	return NULL;
@@ -273,22 +317,127 @@ static void command_add_child(struct command **head, struct command *c)
 	}
 }
 
+/*
+ * The subcommands of a group are registered the first time the group is
+ * looked into. Most groups, above all those of the adapter and target
+ * drivers, are never used in a run, and setting up their command nodes
+ * was most of the cost of registration. Until then the group keeps a
+ * copy of the registration records, as some callers pass arrays on
+ * their stack.
+ */
+static void command_registration_free(struct command_registration *cmds)
+{
+	if (!cmds)
+		return;
+
+	for (unsigned int i = 0; cmds[i].name || cmds[i].chain; i++)
+		command_registration_free((struct command_registration *)cmds[i].chain);
+	free(cmds);
+}
+
+static struct command_registration *command_registration_dup(
+	const struct command_registration *cmds)
+{
+	unsigned int n = 0;
+	while (cmds[n].name || cmds[n].chain)
+		n++;
+
+	struct command_registration *copy = calloc(n + 1, sizeof(*copy));
+	if (!copy)
+		return NULL;
+
+	for (unsigned int i = 0; i < n; i++) {
+		if (cmds[i].chain) {
+			struct command_registration *chain = command_registration_dup(cmds[i].chain);
+			if (!chain) {
+				command_registration_free(copy);
+				return NULL;
+			}
+			copy[i].chain = chain;
+		}
+		copy[i].name = cmds[i].name;
+		copy[i].handler = cmds[i].handler;
+		copy[i].jim_handler = cmds[i].jim_handler;
+		copy[i].mode = cmds[i].mode;
+		copy[i].help = cmds[i].help;
+		copy[i].usage = cmds[i].usage;
+	}
+	return copy;
+}
+
+static int command_defer(struct command *c, const struct command_registration *cmds)
+{
+	struct command_registration *copy = command_registration_dup(cmds);
+	if (!copy)
+		return ERROR_FAIL;
+
+	if (c->deferred) {
+		/* registered twice, e.g. flash banks of one driver */
+		struct command_registration *both = calloc(3, sizeof(*both));
+		if (!both) {
+			command_registration_free(copy);
+			return ERROR_FAIL;
+		}
+		both[0].chain = c->deferred;
+		both[1].chain = copy;
+		copy = both;
+	}
+	c->deferred = copy;
+	return ERROR_OK;
+}
+
+static void command_expand(struct command_context *cmd_ctx, struct command *c)
+{
+	if (!c || !c->deferred)
+		return;
+
+	struct command_registration *cmds = c->deferred;
+	c->deferred = NULL;
+
+	LOG_DEBUG("registering the subcommands of '%s'", c->name);
+	if (register_commands(cmd_ctx, c, cmds) != ERROR_OK)
+		LOG_ERROR("failed to register the subcommands of '%s'", c->name);
+	command_registration_free(cmds);
+
+	if (c->deferred_data_set) {
+		c->deferred_data_set = false;
+		for (struct command *cc = c->children; cc; cc = cc->next)
+			command_set_handler_data(cc, c->deferred_data);
+	}
+}
+
+/* the subcommands of @a c, registered first if they were deferred */
+static struct command *command_children(struct command_context *cmd_ctx,
+	struct command *c)
+{
+	command_expand(cmd_ctx, c);
+	return c->children;
+}
+
 static struct command **command_list_for_parent(
 	struct command_context *cmd_ctx, struct command *parent)
 {
-	return parent ? &parent->children : &cmd_ctx->commands;
+	if (!parent)
+		return &cmd_ctx->commands;
+
+	command_expand(cmd_ctx, parent);
+	return &parent->children;
 }
 
 static void command_free(struct command *c)
 {
 	/** @todo if command has a handler, unregister its jim command! */
 
+	command_registration_free(c->deferred);
+
 	while (NULL != c->children) {
 		struct command *tmp = c->children;
 		c->children = tmp->next;
 		command_free(tmp);
 	}
 
+	if (c->name)
+		command_hash_remove(c);
 	free(c->name);
 	free(c->help);
 	free(c->usage);
@@ -329,11 +478,13 @@ static struct command *command_new(struct command_context *cmd_ctx,
 		goto command_new_error;
 
 	c->parent = parent;
+	c->hash_key = parent ? (const void *)parent : (const void *)cmd_ctx->interp;
 	c->handler = cr->handler;
 	c->jim_handler = cr->jim_handler;
 	c->mode = cr->mode;
 
 	command_add_child(command_list_for_parent(cmd_ctx, parent), c);
+	command_hash_add(c);
 
 	return c;
 
@@ -349,10 +500,17 @@ static int register_command_handler(struct command_context *cmd_ctx,
 {
 	Jim_Interp *interp = cmd_ctx->interp;
 
+	/* the handler is picked at run time from the whole subtree, so there
+	 * is no need to create the Jim command again for every subcommand */
+	if (c->jim_registered)
+		return JIM_OK;
+
 	LOG_DEBUG("registering '%s'...", c->name);
 
 	Jim_CmdProc *func = c->handler ? &script_command : &command_unknown;
 	int retval = Jim_CreateCommand(interp, c->name, func, c, NULL);
+	if (retval == JIM_OK)
+		c->jim_registered = true;
 
 	return retval;
 }
@@ -409,9 +567,16 @@ int register_commands(struct command_context *cmd_ctx, struct command *parent,
 				break;
 			}
 		}
-		if (NULL != cr->chain) {
-			struct command *p = c ? : parent;
-			retval = register_commands(cmd_ctx, p, cr->chain);
+		if (NULL != cr->chain && c) {
+			/* the group dispatches to its subcommands at run time */
+			retval = command_defer(c, cr->chain);
+			if (ERROR_OK == retval && register_command_handler(cmd_ctx,
+					command_root(c)) != JIM_OK)
+				retval = ERROR_FAIL;
+			if (ERROR_OK != retval)
+				break;
+		} else if (NULL != cr->chain) {
+			retval = register_commands(cmd_ctx, parent, cr->chain);
 			if (ERROR_OK != retval)
 				break;
 		}
@@ -467,6 +632,10 @@ void command_set_handler_data(struct command *c, void *p)
 {
 	if (NULL != c->handler || NULL != c->jim_handler)
 		c->jim_handler_data = p;
+	if (c->deferred) {
+		c->deferred_data = p;
+		c->deferred_data_set = true;
+	}
 	for (struct command *cc = c->children; NULL != cc; cc = cc->next)
 		command_set_handler_data(cc, p);
 }
@@ -809,7 +978,8 @@ static COMMAND_HELPER(command_help_find, struct command *head,
 	if (--CMD_ARGC == 0)
 		return ERROR_OK;
 	CMD_ARGV++;
-	return CALL_COMMAND_HANDLER(command_help_find, (*out)->children, out);
+	return CALL_COMMAND_HANDLER(command_help_find,
+		command_children(CMD_CTX, *out), out);
 }
 
 static COMMAND_HELPER(command_help_show, struct command *c, unsigned n,
@@ -912,7 +1082,7 @@ static COMMAND_HELPER(command_help_show, struct command *c, unsigned n,
 	}
 
 	return CALL_COMMAND_HANDLER(command_help_show_list,
-		c->children, n, show_help, cmd_match);
+		command_children(CMD_CTX, c), n, show_help, cmd_match);
 }
 
 COMMAND_HANDLER(handle_help_command)
@@ -956,7 +1126,8 @@ COMMAND_HANDLER(handle_help_command)
 	return retval;
 }
 
-static int command_unknown_find(unsigned argc, Jim_Obj *const *argv,
+static int command_unknown_find(struct command_context *cmd_ctx,
+	unsigned argc, Jim_Obj *const *argv,
 	struct command *head, struct command **out)
 {
 	if (0 == argc)
@@ -966,7 +1137,8 @@ static int command_unknown_find(unsigned argc, Jim_Obj *const *argv,
 	if (NULL == c)
 		return argc;
 	*out = c;
-	return command_unknown_find(--argc, ++argv, (*out)->children, out);
+	return command_unknown_find(cmd_ctx, --argc, ++argv,
+		command_children(cmd_ctx, *out), out);
 }
 
 static char *alloc_concatenate_strings(int argc, Jim_Obj * const *argv)
@@ -1034,7 +1206,7 @@ static int command_unknown(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 
 	struct command_context *cmd_ctx = current_command_context(interp);
 	struct command *c = cmd_ctx->commands;
-	int remaining = command_unknown_find(argc, argv, c, &c);
+	int remaining = command_unknown_find(cmd_ctx, argc, argv, c, &c);
 	/* if nothing could be consumed, then it's really an unknown command */
 	if (remaining == argc) {
 		const char *cmd = Jim_GetString(argv[0], NULL);
@@ -1073,7 +1245,7 @@ static int jim_command_mode(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 
 	if (argc > 1) {
 		struct command *c = cmd_ctx->commands;
-		int remaining = command_unknown_find(argc - 1, argv + 1, c, &c);
+		int remaining = command_unknown_find(cmd_ctx, argc - 1, argv + 1, c, &c);
 		/* if nothing could be consumed, then it's an unknown command */
 		if (remaining == argc - 1) {
 			Jim_SetResultString(interp, "unknown", -1);
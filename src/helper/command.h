@@ -193,6 +193,13 @@ struct command {
 		 * jim_handler_data for any handler specific data */
 	enum command_mode mode;
 	struct command *next;
+	struct command *hash_next;	/* bucket chain of command_find() */
+	const void *hash_key;	/* the parent, or the Jim interpreter of a root */
+	bool jim_registered;	/* the Jim command of this root dispatches to it */
+	/* copy of the subcommand registrations, registered on first use */
+	struct command_registration *deferred;
+	void *deferred_data;	/* handler data set while they were deferred */
+	bool deferred_data_set;
 };
 
 /*
@@ -239,6 +246,9 @@ struct command_registration {
  * record contains a non-NULL @c chain member and name is NULL, the
  * commands on the chain will be registered in the same context.
  * Otherwise, the chained commands are added as children of the command.
+ * Those children are only registered when the command tree below it is
+ * first looked into, e.g. to run or to list a subcommand. The records are
+ * copied for that, the strings they point to must stay valid.
  *
  * @param cmd_ctx The command_context in which to register the command.
  * @param parent Register this command as a child of this, or NULL to
@@ -30,16 +30,33 @@
 #include "configuration.h"
 #include "fileio.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	void *map;		/* read-only mapping of the whole file, or NULL */
+#if HAVE_ZLIB
+	gzFile gz;		/* decompressing reader of a gzip file, or NULL */
+#endif
 };
 
 static inline int fileio_close_local(struct fileio *fileio)
 {
+#if HAVE_ZLIB
+	if (fileio->gz)
+		gzclose(fileio->gz);
+#endif
+
 	int retval = fclose(fileio->file);
 	if (retval != 0) {
 		if (retval == EBADF)
@@ -53,6 +70,44 @@ static inline int fileio_close_local(struct fileio *fileio)
 	return ERROR_OK;
 }
 
+#if HAVE_ZLIB
+/* read a gzip compressed file through zlib, decompressing as it is read;
+ * seeking backwards restarts the decompression */
+static int fileio_open_gzip(struct fileio *fileio)
+{
+	uint8_t magic[2], isize[4];
+
+	/* header, empty deflate stream and trailer take at least 20 bytes */
+	if (fileio->size < 20 || fread(magic, 1, 2, fileio->file) != 2
+			|| magic[0] != 0x1f || magic[1] != 0x8b)
+		return fseek(fileio->file, 0, SEEK_SET) == 0 ? ERROR_OK : ERROR_FILEIO_OPERATION_FAILED;
+
+	/* the trailer of the last member ends with the uncompressed size
+	 * modulo 2^32, which is what images are sized by */
+	if (fseek(fileio->file, -4, SEEK_END) != 0
+			|| fread(isize, 1, 4, fileio->file) != 4)
+		return ERROR_FILEIO_OPERATION_FAILED;
+
+	int fd = dup(fileno(fileio->file));
+	if (fd < 0 || lseek(fd, 0, SEEK_SET) != 0) {
+		if (fd >= 0)
+			close(fd);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+	fileio->gz = gzdopen(fd, "rb");
+	if (!fileio->gz) {
+		close(fd);
+		LOG_ERROR("couldn't read gzip file %s", fileio->url);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+	gzbuffer(fileio->gz, 128 * 1024);
+
+	LOG_DEBUG("decompressing %s", fileio->url);
+	fileio->size = le_to_h_u32(isize);
+	return ERROR_OK;
+}
+#endif
+
 static inline int fileio_open_local(struct fileio *fileio)
 {
 	char file_access[4];
@@ -113,6 +168,16 @@ static inline int fileio_open_local(struct fileio *fileio)
 
 	fileio->size = file_size;
 
+#if HAVE_ZLIB
+	if (fileio->access == FILEIO_READ) {
+		int retval = fileio_open_gzip(fileio);
+		if (retval != ERROR_OK) {
+			fileio_close_local(fileio);
+			return retval;
+		}
+	}
+#endif
+
 	return ERROR_OK;
 }
 
@@ -124,6 +189,10 @@ int fileio_open(struct fileio **fileio, const char *url,
 
 	tmp = malloc(sizeof(struct fileio));
 
+	tmp->map = NULL;
+#if HAVE_ZLIB
+	tmp->gz = NULL;
+#endif
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
@@ -145,6 +214,11 @@ int fileio_close(struct fileio *fileio)
 {
 	int retval;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -155,6 +229,10 @@ int fileio_close(struct fileio *fileio)
 
 int fileio_feof(struct fileio *fileio)
 {
+#if HAVE_ZLIB
+	if (fileio->gz)
+		return gzeof(fileio->gz);
+#endif
 	return feof(fileio->file);
 }
 
@@ -162,6 +240,16 @@ int fileio_seek(struct fileio *fileio, size_t position)
 {
 	int retval;
 
+#if HAVE_ZLIB
+	if (fileio->gz) {
+		if (gzseek(fileio->gz, position, SEEK_SET) < 0) {
+			LOG_ERROR("couldn't seek file %s", fileio->url);
+			return ERROR_FILEIO_OPERATION_FAILED;
+		}
+		return ERROR_OK;
+	}
+#endif
+
 	retval = fseek(fileio->file, position, SEEK_SET);
 
 	if (retval != 0) {
@@ -177,6 +265,27 @@ static int fileio_local_read(struct fileio *fileio, size_t size, void *buffer,
 {
 	ssize_t retval;
 
+#if HAVE_ZLIB
+	if (fileio->gz) {
+		/* gzread() takes an unsigned int */
+		*size_read = 0;
+		while (size > 0) {
+			unsigned int chunk = MIN(size, 1u << 30);
+			int n = gzread(fileio->gz, (uint8_t *)buffer + *size_read, chunk);
+			if (n < 0) {
+				int err;
+				LOG_ERROR("couldn't decompress %s: %s", fileio->url, gzerror(fileio->gz, &err));
+				return ERROR_FILEIO_OPERATION_FAILED;
+			}
+			*size_read += n;
+			size -= n;
+			if ((unsigned int)n < chunk)
+				break;
+		}
+		return ERROR_OK;
+	}
+#endif
+
 	retval = fread(buffer, 1, size, fileio->file);
 	*size_read = (retval >= 0) ? retval : 0;
 
@@ -189,6 +298,34 @@ int fileio_read(struct fileio *fileio, size_t size, void *buffer,
 	return fileio_local_read(fileio, size, buffer, size_read);
 }
 
+int fileio_map(struct fileio *fileio, const uint8_t **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || fileio->type != FILEIO_BINARY
+				|| fileio->size == 0)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#if HAVE_ZLIB
+		if (fileio->gz)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE,
+				fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
 int fileio_read_u32(struct fileio *fileio, uint32_t *data)
 {
 	int retval;
@@ -207,6 +344,11 @@ int fileio_read_u32(struct fileio *fileio, uint32_t *data)
 
 static int fileio_local_fgets(struct fileio *fileio, size_t size, void *buffer)
 {
+#if HAVE_ZLIB
+	if (fileio->gz)
+		return gzgets(fileio->gz, buffer, size) ? ERROR_OK : ERROR_FILEIO_OPERATION_FAILED;
+#endif
+
 	if (fgets(buffer, size, fileio->file) == NULL)
 		return ERROR_FILEIO_OPERATION_FAILED;
 
@@ -56,6 +56,13 @@ int fileio_read(struct fileio *fileio,
 int fileio_write(struct fileio *fileio,
 		size_t size, const void *buffer, size_t *size_written);
 
+/**
+ * Map the whole file read-only into memory; the mapping lives until
+ * fileio_close(). Fails with ERROR_FILEIO_OPERATION_NOT_SUPPORTED where
+ * mapping is not available, callers then use fileio_read().
+ */
+int fileio_map(struct fileio *fileio, const uint8_t **data);
+
 int fileio_read_u32(struct fileio *fileio, uint32_t *data);
 int fileio_write_u32(struct fileio *fileio, uint32_t data);
 int fileio_size(struct fileio *fileio, size_t *size);
@@ -61,6 +61,223 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+/* Debug output is neither flushed nor written synchronously: it is queued
+ * and written in batches, at most every LOG_FLUSH_MS unless the queue fills
+ * up. Messages at LOG_LVL_INFO and above are written and flushed right
+ * away, after everything queued before them. */
+#define LOG_FLUSH_MS	50
+
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define LOG_ASYNC
+#endif
+
+#ifdef LOG_ASYNC
+#include <pthread.h>
+
+/* single producer (the main thread), single consumer (the writer thread) */
+#define LOG_RING_SIZE	(1024 * 1024)
+
+static char *log_ring;
+static size_t log_ring_head;	/* only written by the main thread */
+static size_t log_ring_tail;	/* only written by the writer thread */
+
+static pthread_t log_writer_thread;
+static pthread_mutex_t log_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t log_writer_drained = PTHREAD_COND_INITIALIZER;
+static bool log_writer_running;
+static bool log_writer_idle;	/* waits for data without timeout */
+static bool log_writer_urgent;	/* write without waiting for LOG_FLUSH_MS */
+static bool log_writer_stop;
+
+static void log_writer_write(size_t tail, size_t head)
+{
+	while (tail != head) {
+		size_t offset = tail % LOG_RING_SIZE;
+		size_t len = MIN(head - tail, LOG_RING_SIZE - offset);
+		fwrite(log_ring + offset, 1, len, log_output);
+		tail += len;
+	}
+	fflush(log_output);
+}
+
+static void *log_writer(void *arg)
+{
+	pthread_mutex_lock(&log_writer_lock);
+	while (true) {
+		size_t head = __atomic_load_n(&log_ring_head, __ATOMIC_SEQ_CST);
+
+		if (head == log_ring_tail) {
+			pthread_cond_broadcast(&log_writer_drained);
+			if (log_writer_stop)
+				break;
+
+			/* nothing to write, sleep until the main thread queues more */
+			__atomic_store_n(&log_writer_idle, true, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&log_ring_head, __ATOMIC_SEQ_CST) == log_ring_tail
+					&& !log_writer_urgent)
+				pthread_cond_wait(&log_writer_wake, &log_writer_lock);
+			__atomic_store_n(&log_writer_idle, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		/* rate limit the writes while nobody waits for them */
+		if (!log_writer_urgent && !log_writer_stop) {
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_nsec += LOG_FLUSH_MS * 1000000L;
+			if (until.tv_nsec >= 1000000000L) {
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000L;
+			}
+			while (!log_writer_urgent && !log_writer_stop
+					&& pthread_cond_timedwait(&log_writer_wake, &log_writer_lock, &until) == 0)
+				;
+			head = __atomic_load_n(&log_ring_head, __ATOMIC_SEQ_CST);
+		}
+		log_writer_urgent = false;
+
+		pthread_mutex_unlock(&log_writer_lock);
+		log_writer_write(log_ring_tail, head);
+		__atomic_store_n(&log_ring_tail, head, __ATOMIC_SEQ_CST);
+		pthread_mutex_lock(&log_writer_lock);
+	}
+	pthread_mutex_unlock(&log_writer_lock);
+
+	return NULL;
+}
+
+static void log_writer_kick(void)
+{
+	pthread_mutex_lock(&log_writer_lock);
+	log_writer_urgent = true;
+	pthread_cond_signal(&log_writer_wake);
+	pthread_mutex_unlock(&log_writer_lock);
+}
+
+/* wait until everything queued has been written */
+static void log_async_drain(void)
+{
+	if (!log_writer_running)
+		return;
+
+	if (__atomic_load_n(&log_ring_tail, __ATOMIC_SEQ_CST) == log_ring_head)
+		return;
+
+	pthread_mutex_lock(&log_writer_lock);
+	log_writer_urgent = true;
+	pthread_cond_signal(&log_writer_wake);
+	while (__atomic_load_n(&log_ring_tail, __ATOMIC_SEQ_CST) != log_ring_head)
+		pthread_cond_wait(&log_writer_drained, &log_writer_lock);
+	pthread_mutex_unlock(&log_writer_lock);
+}
+
+static void log_async_exit(void)
+{
+	if (!log_writer_running)
+		return;
+
+	pthread_mutex_lock(&log_writer_lock);
+	log_writer_stop = true;
+	pthread_cond_signal(&log_writer_wake);
+	pthread_mutex_unlock(&log_writer_lock);
+	pthread_join(log_writer_thread, NULL);
+	log_writer_running = false;
+}
+
+static bool log_async_start(void)
+{
+	log_ring = malloc(LOG_RING_SIZE);
+	if (!log_ring)
+		return false;
+
+	if (pthread_create(&log_writer_thread, NULL, log_writer, NULL) != 0) {
+		free(log_ring);
+		log_ring = NULL;
+		return false;
+	}
+
+	log_writer_running = true;
+	atexit(log_async_exit);
+	return true;
+}
+
+static void log_ring_put(size_t head, const char *data, size_t len)
+{
+	size_t offset = head % LOG_RING_SIZE;
+	size_t first = MIN(len, LOG_RING_SIZE - offset);
+
+	memcpy(log_ring + offset, data, first);
+	memcpy(log_ring, data + first, len - first);
+}
+
+/* queue @a prefix and @a string for the writer thread, false if they must
+ * be written synchronously instead */
+static bool log_async_queue(const char *prefix, const char *string)
+{
+	size_t prefix_len = strlen(prefix);
+	size_t len = prefix_len + strlen(string);
+
+	/* a failed start is not retried */
+	if (!log_writer_running && (log_ring || !log_async_start()))
+		return false;
+	if (len > LOG_RING_SIZE / 2)
+		return false;
+
+	size_t head = log_ring_head;
+	while (head + len - __atomic_load_n(&log_ring_tail, __ATOMIC_SEQ_CST) > LOG_RING_SIZE) {
+		/* full, wait for the writer rather than dropping output */
+		log_writer_kick();
+		pthread_mutex_lock(&log_writer_lock);
+		if (head + len - __atomic_load_n(&log_ring_tail, __ATOMIC_SEQ_CST) > LOG_RING_SIZE)
+			pthread_cond_wait(&log_writer_drained, &log_writer_lock);
+		pthread_mutex_unlock(&log_writer_lock);
+	}
+
+	log_ring_put(head, prefix, prefix_len);
+	log_ring_put(head + prefix_len, string, len - prefix_len);
+	__atomic_store_n(&log_ring_head, head + len, __ATOMIC_SEQ_CST);
+
+	size_t used = head + len - __atomic_load_n(&log_ring_tail, __ATOMIC_SEQ_CST);
+	if (used > LOG_RING_SIZE / 2) {
+		log_writer_kick();
+	} else if (__atomic_load_n(&log_writer_idle, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&log_writer_lock);
+		pthread_cond_signal(&log_writer_wake);
+		pthread_mutex_unlock(&log_writer_lock);
+	}
+
+	return true;
+}
+#else
+static void log_async_drain(void)
+{
+}
+
+static bool log_async_queue(const char *prefix, const char *string)
+{
+	return false;
+}
+#endif
+
+static int64_t log_last_flush;
+
+/* write debug output, flushing it at most every LOG_FLUSH_MS */
+static void log_write_deferred(const char *prefix, const char *string)
+{
+	if (log_async_queue(prefix, string))
+		return;
+
+	log_async_drain();
+	fprintf(log_output, "%s%s", prefix, string);
+
+	int64_t now = timeval_ms();
+	if (now - log_last_flush >= LOG_FLUSH_MS) {
+		fflush(log_output);
+		log_last_flush = now;
+	}
+}
+
 /* forward the log to the listeners */
 static void log_forward(const char *file, unsigned line, const char *function, const char *string)
 {
@@ -101,6 +318,7 @@ static void log_puts(enum log_levels level,
 
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
+		log_async_drain();
 		fputs(string, log_output);
 		fflush(log_output);
 		return;
@@ -113,33 +331,41 @@ static void log_puts(enum log_levels level,
 	if (strlen(string) > 0) {
 		if (debug_level >= LOG_LVL_DEBUG) {
 			/* print with count and time information */
+			char prefix[256];
 			int64_t t = timeval_ms() - start;
 #ifdef _DEBUG_FREE_SPACE_
 			struct mallinfo info;
 			info = mallinfo();
 #endif
-			fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
+			snprintf(prefix, sizeof(prefix), "%s%d %" PRId64 " %s:%d %s()"
 #ifdef _DEBUG_FREE_SPACE_
 				" %d"
 #endif
-				": %s", log_strings[level + 1], count, t, file, line, function,
+				": ", log_strings[level + 1], count, t, file, line, function
 #ifdef _DEBUG_FREE_SPACE_
-				info.fordblks,
+				, info.fordblks
 #endif
-				string);
+				);
+			if (level > LOG_LVL_INFO) {
+				log_write_deferred(prefix, string);
+			} else {
+				log_async_drain();
+				fprintf(log_output, "%s%s", prefix, string);
+				fflush(log_output);
+			}
 		} else {
 			/* if we are using gdb through pipes then we do not want any output
 			 * to the pipe otherwise we get repeated strings */
+			log_async_drain();
 			fprintf(log_output, "%s%s",
 				(level > LOG_LVL_USER) ? log_strings[level + 1] : "", string);
+			fflush(log_output);
 		}
 	} else {
 		/* Empty strings are sent to log callbacks to keep e.g. gdbserver alive, here we do
 		 *nothing. */
 	}
 
-	fflush(log_output);
-
 	/* Never forward LOG_LVL_DEBUG, too verbose and they can be found in the log if need be */
 	if (level <= LOG_LVL_INFO)
 		log_forward(file, line, function, string);
@@ -208,6 +434,154 @@ void log_printf_lf(enum log_levels level,
 	va_end(ap);
 }
 
+bool log_trace_enabled;
+
+/* one recorded LOG_TRACE() event */
+struct log_trace_record {
+	int64_t time_us;
+	const struct log_trace_point *point;
+	uint32_t args[4];
+};
+
+#define LOG_TRACE_DEFAULT_ENTRIES	65536
+
+static struct log_trace_record *log_trace_records;
+static size_t log_trace_size;
+static size_t log_trace_next;
+static uint64_t log_trace_count;	/* events since the trace was cleared */
+static int64_t log_trace_start_us;
+
+void log_trace_event(const struct log_trace_point *point,
+		uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+	if (!log_trace_enabled) {
+		log_printf_lf(LOG_LVL_DEBUG, point->file, point->line, point->function,
+				point->format, a0, a1, a2, a3);
+		return;
+	}
+
+	/* the oldest events are overwritten */
+	struct log_trace_record *record = &log_trace_records[log_trace_next];
+	if (++log_trace_next == log_trace_size)
+		log_trace_next = 0;
+	log_trace_count++;
+
+	record->time_us = timeval_us();
+	record->point = point;
+	record->args[0] = a0;
+	record->args[1] = a1;
+	record->args[2] = a2;
+	record->args[3] = a3;
+}
+
+static void log_trace_clear(void)
+{
+	log_trace_next = 0;
+	log_trace_count = 0;
+	log_trace_start_us = timeval_us();
+}
+
+COMMAND_HANDLER(handle_log_trace_start_command)
+{
+	size_t entries = log_trace_size ? log_trace_size : LOG_TRACE_DEFAULT_ENTRIES;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1) {
+		unsigned int n;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], n);
+		if (n == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		entries = n;
+	}
+
+	if (entries != log_trace_size) {
+		struct log_trace_record *records = calloc(entries, sizeof(*records));
+		if (!records) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		free(log_trace_records);
+		log_trace_records = records;
+		log_trace_size = entries;
+	}
+
+	log_trace_clear();
+	log_trace_enabled = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_trace_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	log_trace_enabled = false;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_trace_clear_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	log_trace_clear();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_trace_dump_command)
+{
+	FILE *file = NULL;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1) {
+		file = fopen(CMD_ARGV[0], "w");
+		if (!file) {
+			LOG_ERROR("failed to open trace dump '%s'", CMD_ARGV[0]);
+			return ERROR_FAIL;
+		}
+	}
+
+	size_t kept = MIN(log_trace_count, log_trace_size);
+	size_t index = log_trace_count > log_trace_size ? log_trace_next : 0;
+
+	if (log_trace_count > kept)
+		command_print(CMD, "%" PRIu64 " events, oldest %" PRIu64 " overwritten",
+				log_trace_count, log_trace_count - kept);
+
+	for (size_t i = 0; i < kept; i++) {
+		const struct log_trace_record *record = &log_trace_records[index];
+		const struct log_trace_point *point = record->point;
+		char text[256];
+
+		if (++index == log_trace_size)
+			index = 0;
+
+		snprintf(text, sizeof(text), point->format, record->args[0],
+				record->args[1], record->args[2], record->args[3]);
+
+		const char *f = strrchr(point->file, '/');
+		f = f ? f + 1 : point->file;
+
+		if (file)
+			fprintf(file, "%" PRId64 " %s:%u %s(): %s\n",
+					record->time_us - log_trace_start_us, f, point->line,
+					point->function, text);
+		else
+			command_print(CMD, "%" PRId64 " %s:%u %s(): %s",
+					record->time_us - log_trace_start_us, f, point->line,
+					point->function, text);
+	}
+
+	if (file) {
+		fclose(file);
+		command_print(CMD, "%zu events written to %s", kept, CMD_ARGV[0]);
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_debug_level_command)
 {
 	if (CMD_ARGC == 1) {
@@ -228,6 +602,10 @@ COMMAND_HANDLER(handle_debug_level_command)
 
 COMMAND_HANDLER(handle_log_output_command)
 {
+	/* the writer thread must be done with the old file */
+	log_async_drain();
+	fflush(log_output);
+
 	if (CMD_ARGC == 0 || (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "default") == 0)) {
 		if (log_output != stderr && log_output != NULL) {
 			/* Close previous log file, if it was open and wasn't stderr. */
@@ -255,7 +633,58 @@ COMMAND_HANDLER(handle_log_output_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+static const struct command_registration log_trace_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_log_trace_start_command,
+		.mode = COMMAND_ANY,
+		.help = "record LOG_TRACE() events into a ring of the given number "
+			"of entries (default 65536), instead of logging them",
+		.usage = "[entries]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_log_trace_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "stop recording, keeping the recorded events",
+		.usage = "",
+	},
+	{
+		.name = "clear",
+		.handler = handle_log_trace_clear_command,
+		.mode = COMMAND_ANY,
+		.help = "forget the recorded events",
+		.usage = "",
+	},
+	{
+		.name = "dump",
+		.handler = handle_log_trace_dump_command,
+		.mode = COMMAND_ANY,
+		.help = "render the recorded events as text, oldest first",
+		.usage = "[file_name]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration log_subcommand_handlers[] = {
+	{
+		.name = "trace",
+		.mode = COMMAND_ANY,
+		.help = "binary event trace of I/O hot paths",
+		.usage = "",
+		.chain = log_trace_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration log_command_handlers[] = {
+	{
+		.name = "log",
+		.mode = COMMAND_ANY,
+		.help = "logging commands",
+		.usage = "",
+		.chain = log_subcommand_handlers,
+	},
 	{
 		.name = "log_output",
 		.handler = handle_log_output_command,
@@ -303,6 +732,7 @@ void log_init(void)
 
 int set_log_output(struct command_context *cmd_ctx, FILE *output)
 {
+	log_async_drain();
 	log_output = output;
 	return ERROR_OK;
 }
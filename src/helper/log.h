@@ -96,6 +96,25 @@ struct log_callback {
 int log_add_callback(log_callback_fn fn, void *priv);
 int log_remove_callback(log_callback_fn fn, void *priv);
 
+/* one LOG_TRACE() statement */
+struct log_trace_point {
+	const char *file;
+	unsigned line;
+	const char *function;
+	const char *format;
+};
+
+extern bool log_trace_enabled;
+
+void log_trace_event(const struct log_trace_point *point,
+		uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/* never called, lets the compiler check LOG_TRACE() formats */
+static inline __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 1, 2)))
+void log_trace_check_format(const char *format, ...)
+{
+}
+
 char *alloc_vprintf(const char *fmt, va_list ap);
 char *alloc_printf(const char *fmt, ...)
 	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 1, 2)));
@@ -123,6 +142,24 @@ extern int debug_level;
 				expr); \
 	} while (0)
 
+/* Binary event trace for hot I/O paths, see "log trace". Up to four
+ * integer arguments (no strings or pointers) are recorded with a timestamp
+ * and formatted only when the trace is dumped. While no trace runs the
+ * message is logged like LOG_DEBUG_IO(). */
+#define LOG_TRACE(fmt, ...) \
+	do { \
+		if (log_trace_enabled || debug_level >= LOG_LVL_DEBUG_IO) { \
+			static const struct log_trace_point log_trace_point = { \
+				__FILE__, __LINE__, __func__, fmt }; \
+			LOG_TRACE_ARGS(&log_trace_point, ##__VA_ARGS__, 0, 0, 0, 0); \
+		} \
+		if (0) \
+			log_trace_check_format(fmt, ##__VA_ARGS__); \
+	} while (0)
+
+#define LOG_TRACE_ARGS(point, a0, a1, a2, a3, ...) \
+	log_trace_event(point, (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3))
+
 #define LOG_INFO(expr ...) \
 	log_printf_lf(LOG_LVL_INFO, __FILE__, __LINE__, __func__, expr)
 
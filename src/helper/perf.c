@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "perf.h"
+#include "command.h"
+#include "log.h"
+#include "time_support.h"
+
+struct perf_counter {
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+};
+
+struct perf_op_info {
+	const char *name;
+	const char *category;
+};
+
+static const struct perf_op_info perf_ops[PERF_NUM_OPS] = {
+	[PERF_TARGET_READ_MEMORY] = { "target_read_memory", "target" },
+	[PERF_TARGET_WRITE_MEMORY] = { "target_write_memory", "target" },
+	[PERF_DAP_RUN] = { "dap_run", "dap" },
+	[PERF_JTAG_EXECUTE_QUEUE] = { "jtag_execute_queue", "adapter" },
+	[PERF_FLASH_ERASE] = { "flash_erase", "flash" },
+	[PERF_FLASH_WRITE] = { "flash_write", "flash" },
+	[PERF_FLASH_READ] = { "flash_read", "flash" },
+	[PERF_GDB_PACKET] = { "gdb_packet", "gdb" },
+	[PERF_RTOS_UPDATE_THREADS] = { "rtos_update_threads", "rtos" },
+	[PERF_USB_WRITE] = { "usb_write", "usb" },
+	[PERF_USB_READ] = { "usb_read", "usb" },
+};
+
+static struct perf_counter perf_counters[PERF_NUM_OPS];
+
+/* trace file in Chrome trace event format, NULL when not tracing */
+static FILE *perf_trace_file;
+static char *perf_trace_name;
+static uint64_t perf_trace_events;
+static int64_t perf_trace_start_us;
+
+int64_t perf_start(void)
+{
+	return timeval_us();
+}
+
+void perf_end(enum perf_op op, int64_t start)
+{
+	struct perf_counter *c = &perf_counters[op];
+	int64_t us = timeval_us() - start;
+
+	if (us < 0)
+		us = 0;
+	c->count++;
+	c->total_us += us;
+	if ((uint64_t)us > c->max_us)
+		c->max_us = us;
+
+	if (perf_trace_file) {
+		/* a complete event, the viewer nests them by time; one
+		 * thread as OpenOCD runs the operations one after another */
+		fprintf(perf_trace_file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				"\"ts\":%" PRId64 ",\"dur\":%" PRId64 ",\"pid\":1,\"tid\":1}",
+				perf_trace_events ? ",\n" : "", perf_ops[op].name,
+				perf_ops[op].category, start - perf_trace_start_us, us);
+		perf_trace_events++;
+	}
+}
+
+static void perf_trace_close(struct command_invocation *cmd)
+{
+	fprintf(perf_trace_file, "\n]\n");
+	if (fclose(perf_trace_file) != 0)
+		LOG_ERROR("failed to write trace '%s'", perf_trace_name);
+	else
+		command_print(CMD, "%" PRIu64 " events written to %s",
+				perf_trace_events, perf_trace_name);
+	perf_trace_file = NULL;
+	free(perf_trace_name);
+	perf_trace_name = NULL;
+}
+
+COMMAND_HANDLER(handle_perf_trace_start_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	FILE *file = fopen(CMD_ARGV[0], "w");
+	if (!file) {
+		LOG_ERROR("failed to open trace '%s'", CMD_ARGV[0]);
+		return ERROR_FAIL;
+	}
+	char *name = strdup(CMD_ARGV[0]);
+	if (!name) {
+		fclose(file);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (perf_trace_file)
+		perf_trace_close(CMD);
+
+	fprintf(file, "[\n");
+	perf_trace_file = file;
+	perf_trace_name = name;
+	perf_trace_events = 0;
+	perf_trace_start_us = timeval_us();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_perf_trace_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!perf_trace_file) {
+		LOG_ERROR("not tracing");
+		return ERROR_FAIL;
+	}
+
+	perf_trace_close(CMD);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_perf_command)
+{
+	bool json = false;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") == 0) {
+			memset(perf_counters, 0, sizeof(perf_counters));
+			return ERROR_OK;
+		}
+		if (strcmp(CMD_ARGV[0], "json") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		json = true;
+	}
+
+	if (!json)
+		command_print(CMD, "%-20s %10s %12s %10s %10s", "operation", "count",
+				"total ms", "mean us", "max us");
+
+	char *text = NULL;
+	if (json) {
+		text = strdup("{");
+		if (!text) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+	for (unsigned int i = 0; i < PERF_NUM_OPS; i++) {
+		const struct perf_counter *c = &perf_counters[i];
+		uint64_t mean = c->count ? c->total_us / c->count : 0;
+
+		if (!json) {
+			command_print(CMD, "%-20s %10" PRIu64 " %12.3f %10" PRIu64 " %10" PRIu64,
+					perf_ops[i].name, c->count, c->total_us / 1000.0, mean, c->max_us);
+			continue;
+		}
+
+		char *prev = text;
+		text = alloc_printf("%s%s\"%s\": {\"count\": %" PRIu64 ", \"total_us\": %" PRIu64
+				", \"max_us\": %" PRIu64 "}", prev, i ? ", " : "", perf_ops[i].name,
+				c->count, c->total_us, c->max_us);
+		free(prev);
+		if (!text) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	if (json) {
+		command_print(CMD, "%s}", text);
+		free(text);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration perf_trace_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_perf_trace_start_command,
+		.mode = COMMAND_ANY,
+		.usage = "filename",
+		.help = "Start writing the timed internal operations to a file "
+			"in Chrome trace event format.",
+	},
+	{
+		.name = "stop",
+		.handler = handle_perf_trace_stop_command,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Stop tracing and close the trace file.",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration perf_command_handlers[] = {
+	{
+		.name = "perf",
+		.handler = handle_perf_command,
+		.mode = COMMAND_ANY,
+		.usage = "['reset'|'json']",
+		.help = "Display the count, total and maximum time of the timed "
+			"internal operations, as a table or JSON, or reset them.",
+		.chain = perf_trace_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int perf_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, perf_command_handlers);
+}
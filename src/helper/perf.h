@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * Aggregated timing of OpenOCD's internal operations, see "perf".
+ * Timed operations may nest, e.g. a memory read includes its dap_run,
+ * so the totals of the layers overlap. "perf trace" also records each
+ * operation as a Chrome trace event, to see them on a timeline.
+ */
+
+#ifndef OPENOCD_HELPER_PERF_H
+#define OPENOCD_HELPER_PERF_H
+
+#include <helper/types.h>
+
+struct command_context;
+
+enum perf_op {
+	PERF_TARGET_READ_MEMORY,
+	PERF_TARGET_WRITE_MEMORY,
+	PERF_DAP_RUN,
+	PERF_JTAG_EXECUTE_QUEUE,
+	PERF_FLASH_ERASE,
+	PERF_FLASH_WRITE,
+	PERF_FLASH_READ,
+	PERF_GDB_PACKET,
+	PERF_RTOS_UPDATE_THREADS,
+	PERF_USB_WRITE,
+	PERF_USB_READ,
+	PERF_NUM_OPS
+};
+
+/** @returns the start time of an operation, to pass to perf_end(). */
+int64_t perf_start(void);
+
+/**
+ * Accounts the operation @a op which started at @a start, and while
+ * tracing writes it to the trace file.
+ */
+void perf_end(enum perf_op op, int64_t start);
+
+int perf_register_commands(struct command_context *cmd_ctx);
+
+#endif /* OPENOCD_HELPER_PERF_H */
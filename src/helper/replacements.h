@@ -246,6 +246,14 @@ typedef uint32_t Elf32_Word;
 typedef uint32_t Elf32_Size;
 typedef Elf32_Off Elf32_Hashelt;
 
+typedef uint64_t Elf64_Addr;
+typedef uint16_t Elf64_Half;
+typedef uint64_t Elf64_Off;
+typedef uint32_t Elf64_Word;
+typedef uint64_t Elf64_Xword;
+
+#define EI_NIDENT		16		/* Size of e_ident[] */
+
 typedef struct {
 	unsigned char e_ident[16];	/* Magic number and other info */
 	Elf32_Half e_type;			/* Object file type */
@@ -263,6 +271,23 @@ typedef struct {
 	Elf32_Half e_shstrndx;			/* Section header string table index */
 } Elf32_Ehdr;
 
+typedef struct {
+	unsigned char e_ident[16];	/* Magic number and other info */
+	Elf64_Half e_type;			/* Object file type */
+	Elf64_Half e_machine;			/* Architecture */
+	Elf64_Word e_version;			/* Object file version */
+	Elf64_Addr e_entry;			/* Entry point virtual address */
+	Elf64_Off e_phoff;			/* Program header table file offset */
+	Elf64_Off e_shoff;			/* Section header table file offset */
+	Elf64_Word e_flags;			/* Processor-specific flags */
+	Elf64_Half e_ehsize;			/* ELF header size in bytes */
+	Elf64_Half e_phentsize;		/* Program header table entry size */
+	Elf64_Half e_phnum;			/* Program header table entry count */
+	Elf64_Half e_shentsize;		/* Section header table entry size */
+	Elf64_Half e_shnum;			/* Section header table entry count */
+	Elf64_Half e_shstrndx;			/* Section header string table index */
+} Elf64_Ehdr;
+
 #define ELFMAG			"\177ELF"
 #define SELFMAG			4
 
@@ -285,6 +310,17 @@ typedef struct {
 	Elf32_Size p_align;		/* Segment alignment */
 } Elf32_Phdr;
 
+typedef struct {
+	Elf64_Word p_type;		/* Segment type */
+	Elf64_Word p_flags;		/* Segment flags */
+	Elf64_Off p_offset;		/* Segment file offset */
+	Elf64_Addr p_vaddr;		/* Segment virtual address */
+	Elf64_Addr p_paddr;		/* Segment physical address */
+	Elf64_Xword p_filesz;	/* Segment size in file */
+	Elf64_Xword p_memsz;	/* Segment size in memory */
+	Elf64_Xword p_align;	/* Segment alignment */
+} Elf64_Phdr;
+
 #define PT_LOAD			1		/* Loadable program segment */
 
 #endif	/* HAVE_ELF_H */
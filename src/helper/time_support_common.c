@@ -39,3 +39,12 @@ int64_t timeval_ms(void)
 		return retval;
 	return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
 }
+
+int64_t timeval_us(void)
+{
+	struct timeval now;
+	int retval = gettimeofday(&now, NULL);
+	if (retval < 0)
+		return retval;
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
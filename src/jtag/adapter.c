@@ -34,8 +34,10 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "record.h"
 #include <transport/transport.h>
 #include <jtag/drivers/jtag_usb_common.h>
+#include <helper/time_support.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -49,6 +51,25 @@
 struct adapter_driver *adapter_driver;
 const char * const jtag_only[] = { "jtag", NULL };
 
+struct adapter_stats adapter_stats;
+/* start of the current statistics period, 0 until the first queue run */
+static int64_t adapter_stats_since_us;
+
+int64_t adapter_stats_queue_start(void)
+{
+	int64_t now = timeval_us();
+
+	if (!adapter_stats_since_us)
+		adapter_stats_since_us = now;
+	return now;
+}
+
+void adapter_stats_queue_done(int64_t start)
+{
+	adapter_stats.flushes++;
+	adapter_stats.queue_us += timeval_us() - start;
+}
+
 static int jim_adapter_name(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 {
 	Jim_GetOptInfo goi;
@@ -383,8 +404,26 @@ COMMAND_HANDLER(handle_adapter_srst_pulse_width_command)
 	return ERROR_OK;
 }
 
+/* default upper limit for "adapter speed auto" */
+#define ADAPTER_SPEED_AUTO_MAX_KHZ	50000
+
 COMMAND_HANDLER(handle_adapter_speed_command)
 {
+	if (CMD_ARGC >= 1 && !strcmp(CMD_ARGV[0], "auto")) {
+		if (CMD_ARGC > 2)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		unsigned max_khz = ADAPTER_SPEED_AUTO_MAX_KHZ;
+		if (CMD_ARGC == 2)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max_khz);
+		if (!max_khz)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+
+		jtag_config_speed_auto(max_khz);
+		command_print(CMD, "adapter speed: auto, up to %u kHz", max_khz);
+		return ERROR_OK;
+	}
+
 	if (CMD_ARGC > 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
@@ -407,6 +446,8 @@ COMMAND_HANDLER(handle_adapter_speed_command)
 		command_print(CMD, "adapter speed: %d kHz", cur_speed);
 	else
 		command_print(CMD, "adapter speed: RCLK - adaptive");
+	if (jtag_get_speed_auto_max_khz())
+		command_print(CMD, "adapter speed auto: up to %u kHz", jtag_get_speed_auto_max_khz());
 
 	return retval;
 }
@@ -497,6 +538,35 @@ COMMAND_HANDLER(handle_adapter_reset_de_assert)
 						  (srst == VALUE_DEASSERT) ? SRST_DEASSERT : SRST_ASSERT);
 }
 
+COMMAND_HANDLER(handle_adapter_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&adapter_stats, 0, sizeof(adapter_stats));
+		adapter_stats_since_us = 0;
+		return ERROR_OK;
+	}
+
+	uint64_t elapsed_us = 0;
+	if (adapter_stats_since_us)
+		elapsed_us = timeval_us() - adapter_stats_since_us;
+
+	command_print(CMD, "scans: %" PRIu64 ", bits shifted: %" PRIu64,
+			adapter_stats.scans, adapter_stats.bits);
+	command_print(CMD, "queue runs: %" PRIu64, adapter_stats.flushes);
+	command_print(CMD, "usb transfers: %" PRIu64 ", bytes: %" PRIu64,
+			adapter_stats.usb_transfers, adapter_stats.usb_bytes);
+	command_print(CMD, "queue time: %" PRIu64 " ms of %" PRIu64 " ms (%u%% active)",
+			adapter_stats.queue_us / 1000, elapsed_us / 1000,
+			elapsed_us ? (unsigned int)(adapter_stats.queue_us * 100 / elapsed_us) : 0);
+
+	return ERROR_OK;
+}
+
 #ifndef HAVE_JTAG_MINIDRIVER_H
 #ifdef HAVE_LIBUSB_GET_PORT_NUMBERS
 COMMAND_HANDLER(handle_usb_location_command)
@@ -556,9 +626,10 @@ static const struct command_registration adapter_command_handlers[] = {
 		.mode = COMMAND_ANY,
 		.help = "With an argument, change to the specified maximum "
 			"jtag speed.  For JTAG, 0 KHz signifies adaptive "
-			"clocking. "
+			"clocking. With 'auto', step the speed up at SWD "
+			"connect to the fastest reliable one not above max_khz. "
 			"With or without argument, display current setting.",
-		.usage = "[khz]",
+		.usage = "[khz | auto [max_khz]]",
 	},
 	{
 		.name = "list",
@@ -597,6 +668,16 @@ static const struct command_registration adapter_command_handlers[] = {
 		.chain = adapter_usb_command_handlers,
 	},
 #endif /* MINIDRIVER */
+	{
+		.name = "stats",
+		.handler = handle_adapter_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Display the adapter transfer statistics, or reset them.",
+		.usage = "[reset]",
+	},
+	{
+		.chain = adapter_record_command_handlers,
+	},
 	{
 		.name = "assert",
 		.handler = handle_adapter_reset_de_assert,
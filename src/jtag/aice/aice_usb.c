@@ -435,9 +435,87 @@ static uint32_t usb_out_packets_buffer_length;
 static uint32_t usb_in_packets_buffer_length;
 static enum aice_command_mode aice_command_mode;
 
+/* Commands in usb_out_packets_buffer, to check their responses */
+static struct aice_usb_packet {
+	uint8_t cmd_code;
+	uint16_t out_offset;
+	uint16_t out_length;
+	uint16_t in_offset;
+	uint16_t in_length;
+} usb_packets[AICE_OUT_PACKETS_BUFFER_SIZE / AICE_FORMAT_HTDA];
+static uint32_t usb_packets_count;
+
+static int aice_reset_box(void);
 static int aice_batch_buffer_write(uint8_t buf_index, const uint8_t *word,
 		uint32_t num_of_words);
 
+/* Send the packed commands from @a first on again one at a time, with the
+ * same timeout handling as in normal mode. */
+static int aice_usb_packet_resend(uint32_t first)
+{
+	int retval = ERROR_OK;
+
+	aice_command_mode = AICE_COMMAND_MODE_NORMAL;
+
+	for (uint32_t i = first; i < usb_packets_count; i++) {
+		struct aice_usb_packet *packet = &usb_packets[i];
+		int retry_times = 0;
+
+		while (1) {
+			/* clear timeout of the failed command and retry */
+			if (aice_reset_box() != ERROR_OK) {
+				retval = ERROR_FAIL;
+				goto exit;
+			}
+
+			aice_usb_write(usb_out_packets_buffer + packet->out_offset,
+					packet->out_length);
+			int result = aice_usb_read(usb_in_packets_buffer + packet->in_offset,
+					packet->in_length);
+			if (result != packet->in_length) {
+				LOG_ERROR("aice_usb_read failed (requested=%d, result=%d)",
+						packet->in_length, result);
+				retval = ERROR_FAIL;
+				goto exit;
+			}
+
+			if (usb_in_packets_buffer[packet->in_offset] == packet->cmd_code)
+				break;
+
+			if (retry_times > aice_max_retry_times) {
+				LOG_ERROR("aice command timeout (command=0x%" PRIx8 ", response=0x%" PRIx8 ")",
+						packet->cmd_code, usb_in_packets_buffer[packet->in_offset]);
+				retval = ERROR_FAIL;
+				goto exit;
+			}
+
+			retry_times++;
+		}
+	}
+
+exit:
+	aice_command_mode = AICE_COMMAND_MODE_PACK;
+
+	return retval;
+}
+
+/* Check the response of every packed command. */
+static int aice_usb_packet_check(int received)
+{
+	for (uint32_t i = 0; i < usb_packets_count; i++) {
+		struct aice_usb_packet *packet = &usb_packets[i];
+
+		if (packet->in_offset + packet->in_length > received ||
+				usb_in_packets_buffer[packet->in_offset] != packet->cmd_code) {
+			LOG_DEBUG("packed command 0x%02" PRIx8 " failed, sending the rest again",
+					packet->cmd_code);
+			return aice_usb_packet_resend(i);
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int aice_usb_packet_flush(void)
 {
 	if (usb_out_packets_buffer_length == 0)
@@ -446,16 +524,20 @@ static int aice_usb_packet_flush(void)
 	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
 		LOG_DEBUG("Flush usb packets (AICE_COMMAND_MODE_PACK)");
 
+		int retval = ERROR_FAIL;
 		if (aice_usb_write(usb_out_packets_buffer,
-					usb_out_packets_buffer_length) < 0)
-			return ERROR_FAIL;
-
-		if (aice_usb_read(usb_in_packets_buffer,
-					usb_in_packets_buffer_length) < 0)
-			return ERROR_FAIL;
+					usb_out_packets_buffer_length) >= 0) {
+			int result = aice_usb_read(usb_in_packets_buffer,
+					usb_in_packets_buffer_length);
+			if (result >= 0)
+				retval = aice_usb_packet_check(result);
+		}
 
 		usb_out_packets_buffer_length = 0;
 		usb_in_packets_buffer_length = 0;
+		usb_packets_count = 0;
+
+		return retval;
 
 	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
 		LOG_DEBUG("Flush usb packets (AICE_COMMAND_MODE_BATCH)");
@@ -468,6 +550,7 @@ static int aice_usb_packet_flush(void)
 
 		usb_out_packets_buffer_length = 0;
 		usb_in_packets_buffer_length = 0;
+		usb_packets_count = 0;
 
 		/* enable BATCH command */
 		aice_command_mode = AICE_COMMAND_MODE_NORMAL;
@@ -517,7 +600,9 @@ static int aice_usb_packet_append(uint8_t *out_buffer, int out_length, int in_le
 			return ERROR_FAIL;
 	}
 
-	if (usb_out_packets_buffer_length + out_length > max_packet_size)
+	if (usb_out_packets_buffer_length + out_length > max_packet_size ||
+			usb_in_packets_buffer_length + in_length > AICE_IN_PACKETS_BUFFER_SIZE ||
+			usb_packets_count == ARRAY_SIZE(usb_packets))
 		if (aice_usb_packet_flush() != ERROR_OK) {
 			LOG_DEBUG("Flush usb packets failed");
 			return ERROR_FAIL;
@@ -525,6 +610,13 @@ static int aice_usb_packet_append(uint8_t *out_buffer, int out_length, int in_le
 
 	LOG_DEBUG("Append usb packets 0x%02x", out_buffer[0]);
 
+	struct aice_usb_packet *packet = &usb_packets[usb_packets_count++];
+	packet->cmd_code = out_buffer[0];
+	packet->out_offset = usb_out_packets_buffer_length;
+	packet->out_length = out_length;
+	packet->in_offset = usb_in_packets_buffer_length;
+	packet->in_length = in_length;
+
 	memcpy(usb_out_packets_buffer + usb_out_packets_buffer_length, out_buffer, out_length);
 	usb_out_packets_buffer_length += out_length;
 	usb_in_packets_buffer_length += in_length;
@@ -532,6 +624,28 @@ static int aice_usb_packet_append(uint8_t *out_buffer, int out_length, int in_le
 	return ERROR_OK;
 }
 
+/* Pack the following write commands into one USB transfer, unless the user
+ * already selected pack or batch mode. */
+static bool aice_usb_pack_begin(void)
+{
+	if (AICE_COMMAND_MODE_NORMAL != aice_command_mode)
+		return false;
+
+	aice_command_mode = AICE_COMMAND_MODE_PACK;
+	return true;
+}
+
+static int aice_usb_pack_end(bool packed)
+{
+	if (!packed)
+		return ERROR_OK;
+
+	int retval = aice_usb_packet_flush();
+	aice_command_mode = AICE_COMMAND_MODE_NORMAL;
+
+	return retval;
+}
+
 /***************************************************************************/
 /* AICE commands */
 static int aice_reset_box(void)
@@ -788,9 +902,8 @@ int aice_write_dtr(uint8_t target_id, uint32_t data)
 {
 	int retry_times = 0;
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmc(AICE_CMD_T_WRITE_DTR, target_id, 0, 0, data, AICE_LITTLE_ENDIAN);
 		return aice_usb_packet_append(usb_out_buffer, AICE_FORMAT_HTDMC,
 				AICE_FORMAT_DTHMB);
@@ -940,9 +1053,8 @@ int aice_write_misc(uint8_t target_id, uint32_t address, uint32_t data)
 {
 	int retry_times = 0;
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmc(AICE_CMD_T_WRITE_MISC, target_id, 0, address, data,
 				AICE_LITTLE_ENDIAN);
 		return aice_usb_packet_append(usb_out_buffer, AICE_FORMAT_HTDMC,
@@ -1046,9 +1158,8 @@ int aice_write_edmsr(uint8_t target_id, uint32_t address, uint32_t data)
 {
 	int retry_times = 0;
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmc(AICE_CMD_T_WRITE_EDMSR, target_id, 0, address, data,
 				AICE_LITTLE_ENDIAN);
 		return aice_usb_packet_append(usb_out_buffer, AICE_FORMAT_HTDMC,
@@ -1122,9 +1233,8 @@ static int aice_write_dim(uint8_t target_id, uint32_t *word, uint8_t num_of_word
 	memcpy(big_endian_word, word, sizeof(big_endian_word));
 	aice_switch_to_big_endian(big_endian_word, num_of_words);
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmc_multiple_data(AICE_CMD_T_WRITE_DIM, target_id,
 				num_of_words - 1, 0, big_endian_word, num_of_words,
 				AICE_LITTLE_ENDIAN);
@@ -1186,9 +1296,8 @@ static int aice_do_execute(uint8_t target_id)
 {
 	int retry_times = 0;
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmc(AICE_CMD_T_EXECUTE, target_id, 0, 0, 0, AICE_LITTLE_ENDIAN);
 		return aice_usb_packet_append(usb_out_buffer,
 				AICE_FORMAT_HTDMC,
@@ -1454,9 +1563,8 @@ int aice_fastwrite_mem(uint8_t target_id, const uint8_t *word, uint32_t num_of_w
 {
 	int retry_times = 0;
 
-	if (AICE_COMMAND_MODE_PACK == aice_command_mode) {
-		aice_usb_packet_flush();
-	} else if (AICE_COMMAND_MODE_BATCH == aice_command_mode) {
+	if ((AICE_COMMAND_MODE_PACK == aice_command_mode) ||
+		(AICE_COMMAND_MODE_BATCH == aice_command_mode)) {
 		aice_pack_htdmd_multiple_data(AICE_CMD_T_FASTWRITE_MEM, target_id,
 				num_of_words - 1, 0, word, data_endian);
 		return aice_usb_packet_append(usb_out_buffer,
@@ -1862,16 +1970,17 @@ static int aice_check_dbger(uint32_t coreid, uint32_t expect_status)
 
 static int aice_execute_dim(uint32_t coreid, uint32_t *insts, uint8_t n_inst)
 {
-	/** fill DIM */
-	if (aice_write_dim(coreid, insts, n_inst) != ERROR_OK)
-		return ERROR_FAIL;
+	/** fill DIM, clear DBGER.DPED and execute DIM in one USB transfer */
+	bool packed = aice_usb_pack_begin();
 
-	/** clear DBGER.DPED */
-	if (aice_write_misc(coreid, NDS_EDM_MISC_DBGER, NDS_DBGER_DPED) != ERROR_OK)
+	if (aice_write_dim(coreid, insts, n_inst) != ERROR_OK ||
+			aice_write_misc(coreid, NDS_EDM_MISC_DBGER, NDS_DBGER_DPED) != ERROR_OK ||
+			aice_do_execute(coreid) != ERROR_OK) {
+		aice_usb_pack_end(packed);
 		return ERROR_FAIL;
+	}
 
-	/** execute DIM */
-	if (aice_do_execute(coreid) != ERROR_OK)
+	if (aice_usb_pack_end(packed) != ERROR_OK)
 		return ERROR_FAIL;
 
 	/** read DBGER.DPED */
@@ -3272,14 +3381,37 @@ static int aice_bulk_read_mem(uint32_t coreid, uint32_t addr, uint32_t count,
 	while (count > 0) {
 		packet_size = (count >= 0x100) ? 0x100 : count;
 
-		/** set address */
+		/** set address and read in one USB transfer */
+		bool packed = aice_usb_pack_begin();
+
 		addr &= 0xFFFFFFFC;
-		if (aice_write_misc(coreid, NDS_EDM_MISC_SBAR, addr) != ERROR_OK)
+		if (aice_write_misc(coreid, NDS_EDM_MISC_SBAR, addr) != ERROR_OK) {
+			aice_usb_pack_end(packed);
 			return ERROR_FAIL;
+		}
+
+		if (packed) {
+			const uint32_t in_length = AICE_FORMAT_DTHMA + (packet_size - 1) * 4;
+			aice_pack_htdmb(AICE_CMD_T_FASTREAD_MEM, coreid, packet_size - 1, 0);
+			if (aice_usb_packet_append(usb_out_buffer, AICE_FORMAT_HTDMB,
+						in_length) != ERROR_OK) {
+				aice_usb_pack_end(packed);
+				return ERROR_FAIL;
+			}
+			const uint32_t in_offset = usb_in_packets_buffer_length - in_length;
+			if (aice_usb_pack_end(packed) != ERROR_OK)
+				return ERROR_FAIL;
 
-		if (aice_fastread_mem(coreid, buffer,
-					packet_size) != ERROR_OK)
+			uint8_t cmd_ack_code;
+			uint8_t extra_length;
+			uint8_t res_target_id;
+			memcpy(usb_in_buffer, usb_in_packets_buffer + in_offset, in_length);
+			aice_unpack_dthma_multiple_data(&cmd_ack_code, &res_target_id,
+					&extra_length, buffer, data_endian);
+		} else if (aice_fastread_mem(coreid, buffer,
+					packet_size) != ERROR_OK) {
 			return ERROR_FAIL;
+		}
 
 		buffer += (packet_size * 4);
 		addr += (packet_size * 4);
@@ -3297,13 +3429,17 @@ static int aice_bulk_write_mem(uint32_t coreid, uint32_t addr, uint32_t count,
 	while (count > 0) {
 		packet_size = (count >= 0x100) ? 0x100 : count;
 
-		/** set address */
+		/** set address and write in one USB transfer */
+		bool packed = aice_usb_pack_begin();
+
 		addr &= 0xFFFFFFFC;
-		if (aice_write_misc(coreid, NDS_EDM_MISC_SBAR, addr | 1) != ERROR_OK)
+		if (aice_write_misc(coreid, NDS_EDM_MISC_SBAR, addr | 1) != ERROR_OK ||
+				aice_fastwrite_mem(coreid, buffer, packet_size) != ERROR_OK) {
+			aice_usb_pack_end(packed);
 			return ERROR_FAIL;
+		}
 
-		if (aice_fastwrite_mem(coreid, buffer,
-					packet_size) != ERROR_OK)
+		if (aice_usb_pack_end(packed) != ERROR_OK)
 			return ERROR_FAIL;
 
 		buffer += (packet_size * 4);
@@ -37,12 +37,20 @@
 struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
+	size_t size;
 	size_t used;
 };
 
+/*
+ * The pages are an arena kept across queue resets: a reset rewinds them,
+ * only pages bigger than CMD_QUEUE_PAGE_SIZE are given back.
+ */
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
 static struct cmd_queue_page *cmd_queue_pages;
 static struct cmd_queue_page *cmd_queue_pages_tail;
+/* page allocations are currently carved from */
+static struct cmd_queue_page *cmd_queue_page_cur;
+static struct cmd_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -76,8 +84,7 @@ void jtag_queue_command(struct jtag_command *cmd)
 
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
+	struct cmd_queue_page *page;
 	uint8_t *t;
 
 	/*
@@ -112,47 +119,72 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
-	}
+	/* move on to the next retained page while this one is too full */
+	page = cmd_queue_page_cur;
+	while (page && page->size - page->used < size)
+		page = page->next;
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
+	if (!page) {
+		page = malloc(sizeof(struct cmd_queue_page));
+		page->used = 0;
+		page->size = (size < CMD_QUEUE_PAGE_SIZE) ?
 					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+		page->address = malloc(page->size);
+		page->next = NULL;
+		if (cmd_queue_pages_tail)
+			cmd_queue_pages_tail->next = page;
+		else
+			cmd_queue_pages = page;
+		cmd_queue_pages_tail = page;
+		cmd_queue_stats.retained += page->size;
 	}
+	cmd_queue_page_cur = page;
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	t = page->address;
+	t += page->used;
+	page->used += size;
+	cmd_queue_stats.used += size;
 
-	t = (*p_page)->address;
-	return t + offset;
+	return t;
 }
 
-static void cmd_queue_free(void)
+/* Rewind the arena, keeping its standard size pages for the next queue */
+static void cmd_queue_rewind(void)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
 
-	while (page) {
-		struct cmd_queue_page *last = page;
-		free(page->address);
-		page = page->next;
-		free(last);
+	cmd_queue_pages_tail = NULL;
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
+		if (page->size > CMD_QUEUE_PAGE_SIZE) {
+			*p_page = page->next;
+			cmd_queue_stats.retained -= page->size;
+			free(page->address);
+			free(page);
+			continue;
+		}
+		page->used = 0;
+		cmd_queue_pages_tail = page;
+		p_page = &page->next;
 	}
+	cmd_queue_page_cur = cmd_queue_pages;
 
-	cmd_queue_pages = NULL;
-	cmd_queue_pages_tail = NULL;
+	if (cmd_queue_stats.used > cmd_queue_stats.high_water)
+		cmd_queue_stats.high_water = cmd_queue_stats.used;
+	cmd_queue_stats.used = 0;
+	cmd_queue_stats.resets++;
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
+	if (stats->used > stats->high_water)
+		stats->high_water = stats->used;
 }
 
 void jtag_command_queue_reset(void)
 {
-	cmd_queue_free();
+	cmd_queue_rewind();
 
 	jtag_command_queue = NULL;
 	next_command_pointer = &jtag_command_queue;
@@ -165,6 +165,20 @@ extern struct jtag_command *jtag_command_queue;
 
 void *cmd_queue_alloc(size_t size);
 
+/** Usage of the memory arena behind cmd_queue_alloc() */
+struct cmd_queue_stats {
+	/** bytes handed out since the last queue reset */
+	size_t used;
+	/** most bytes handed out between two queue resets */
+	size_t high_water;
+	/** bytes of the pages kept across queue resets */
+	size_t retained;
+	/** number of queue resets */
+	uint64_t resets;
+};
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
+
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
 
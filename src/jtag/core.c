@@ -33,8 +33,10 @@
 #include "jtag.h"
 #include "swd.h"
 #include "interface.h"
+#include "record.h"
 #include <transport/transport.h>
 #include <helper/jep106.h>
+#include <helper/perf.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -96,6 +98,10 @@ tap_state_t cmd_queue_cur_state = TAP_RESET;
 static bool jtag_verify_capture_ir = true;
 static int jtag_verify = 1;
 
+/* optimisation pass over the command queue, and the commands it removed */
+static bool jtag_optimize;
+static uint64_t jtag_optimized_commands;
+
 /* how long the OpenOCD should wait before attempting JTAG communication after reset lines
  *deasserted (in ms) */
 static int adapter_nsrst_delay;	/* default to no nSRST delay */
@@ -123,6 +129,8 @@ static struct jtag_event_callback *jtag_event_callbacks;
 static int speed_khz;
 /* speed to fallback to when RCLK is requested but not supported */
 static int rclk_fallback_speed_khz;
+/* upper limit for "adapter speed auto", 0 when it is not enabled */
+static unsigned speed_auto_max_khz;
 static enum {CLOCK_MODE_UNSELECTED, CLOCK_MODE_KHZ, CLOCK_MODE_RCLK} clock_mode;
 static int jtag_speed;
 
@@ -929,6 +937,127 @@ void jtag_check_value_mask(struct scan_field *field, uint8_t *value, uint8_t *ma
 	jtag_set_error(retval);
 }
 
+#if !BUILD_ZY1000
+/* Same instruction for every TAP, and nothing to capture */
+static bool jtag_ir_scan_repeats(const struct scan_command *last, const struct scan_command *scan)
+{
+	if (last->num_fields != scan->num_fields)
+		return false;
+
+	for (int i = 0; i < scan->num_fields; i++) {
+		const struct scan_field *a = last->fields + i, *b = scan->fields + i;
+		int bytes = a->num_bits / 8, trailing = a->num_bits % 8;
+
+		if (a->num_bits != b->num_bits || !a->out_value || !b->out_value || b->in_value)
+			return false;
+		if (memcmp(a->out_value, b->out_value, bytes))
+			return false;
+		if (trailing && ((a->out_value[bytes] ^ b->out_value[bytes]) & ((1 << trailing) - 1)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Optional pass over the queue before the driver sees it. It only removes
+ * or merges commands in ways no TAP can tell apart:
+ * - an IR scan loading the instructions of the previous IR scan again, with
+ *   nothing captured, starting and ending in the same stable state;
+ * - a RUNTEST of 0 cycles from Run-Test/Idle back to Run-Test/Idle;
+ * - consecutive PATHMOVEs, joined into one.
+ * DR scans are never merged: each of them ends with an Update-DR.
+ */
+static void jtag_optimize_queue(void)
+{
+	struct jtag_command **p = &jtag_command_queue;
+	const struct scan_command *last_ir = NULL;
+	struct jtag_command *last_pathmove = NULL;
+	tap_state_t state = tap_get_state();
+
+	while (*p) {
+		struct jtag_command *cmd = *p;
+		bool drop = false;
+
+		switch (cmd->type) {
+		case JTAG_SCAN: {
+			struct scan_command *scan = cmd->cmd.scan;
+			if (scan->ir_scan) {
+				drop = last_ir && state == scan->end_state && tap_is_state_stable(state)
+					&& jtag_ir_scan_repeats(last_ir, scan);
+				if (!drop)
+					last_ir = scan;
+			}
+			state = scan->end_state;
+			break;
+		}
+		case JTAG_RUNTEST: {
+			struct runtest_command *runtest = cmd->cmd.runtest;
+			drop = runtest->num_cycles == 0 && state == TAP_IDLE
+				&& runtest->end_state == TAP_IDLE;
+			state = runtest->end_state;
+			break;
+		}
+		case JTAG_PATHMOVE: {
+			struct pathmove_command *move = cmd->cmd.pathmove;
+			if (last_pathmove) {
+				struct pathmove_command *prev = last_pathmove->cmd.pathmove;
+				tap_state_t *path = cmd_queue_alloc((prev->num_states + move->num_states)
+						* sizeof(tap_state_t));
+				memcpy(path, prev->path, prev->num_states * sizeof(tap_state_t));
+				memcpy(path + prev->num_states, move->path,
+						move->num_states * sizeof(tap_state_t));
+				prev->path = path;
+				prev->num_states += move->num_states;
+				drop = true;
+			}
+			/* the path may have shifted through Shift-IR */
+			last_ir = NULL;
+			state = move->path[move->num_states - 1];
+			break;
+		}
+		case JTAG_SLEEP:
+			break;
+		case JTAG_STABLECLOCKS:
+			if (state == TAP_RESET)
+				last_ir = NULL;
+			break;
+		default:
+			/* TAP reset, TRST, raw TMS: IR and state are no longer known */
+			last_ir = NULL;
+			state = cmd->type == JTAG_TLR_RESET ? TAP_RESET : TAP_INVALID;
+			break;
+		}
+
+		if (cmd->type != JTAG_PATHMOVE)
+			last_pathmove = NULL;
+		else if (!drop)
+			last_pathmove = cmd;
+
+		if (drop) {
+			*p = cmd->next;
+			jtag_optimized_commands++;
+		} else
+			p = &cmd->next;
+	}
+}
+#endif
+
+void jtag_set_optimize_queue(bool enable)
+{
+	jtag_optimize = enable;
+}
+
+bool jtag_will_optimize_queue(void)
+{
+	return jtag_optimize;
+}
+
+uint64_t jtag_get_optimized_commands(void)
+{
+	return jtag_optimized_commands;
+}
+
 int default_interface_jtag_execute_queue(void)
 {
 	if (NULL == jtag) {
@@ -951,7 +1080,28 @@ int default_interface_jtag_execute_queue(void)
 			return ERROR_OK;
 	}
 
+#if !BUILD_ZY1000
+	if (jtag_optimize)
+		jtag_optimize_queue();
+#endif
+
+#if !BUILD_ZY1000
+	for (struct jtag_command *scan = jtag_command_queue; scan; scan = scan->next)
+		if (scan->type == JTAG_SCAN)
+			adapter_stats_scan(jtag_scan_size(scan->cmd.scan));
+#endif
+
+#if !BUILD_ZY1000
+	if (adapter_record_enabled())
+		adapter_record_jtag_queue(jtag_command_queue);
+#endif
+
+	int64_t stats_start = adapter_stats_queue_start();
 	int result = jtag->jtag_ops->execute_queue();
+	adapter_stats_queue_done(stats_start);
+
+	if (adapter_record_enabled())
+		adapter_record_jtag_flush(stats_start, result);
 
 #if !BUILD_ZY1000
 	/* Only build this if we use a regular driver with a command queue.
@@ -1043,7 +1193,9 @@ int jtag_get_flush_queue_count(void)
 
 int jtag_execute_queue(void)
 {
+	int64_t start = perf_start();
 	jtag_execute_queue_noclear();
+	perf_end(PERF_JTAG_EXECUTE_QUEUE, start);
 	return jtag_error_clear();
 }
 
@@ -1090,7 +1242,7 @@ void jtag_sleep(uint32_t us)
 /* a larger IR length than we ever expect to autoprobe */
 #define JTAG_IRLEN_MAX          60
 
-static int jtag_examine_chain_execute(uint8_t *idcode_buffer, unsigned num_idcode)
+static void jtag_examine_chain_queue(uint8_t *idcode_buffer, unsigned num_idcode)
 {
 	struct scan_field field = {
 		.num_bits = num_idcode * 32,
@@ -1104,7 +1256,6 @@ static int jtag_examine_chain_execute(uint8_t *idcode_buffer, unsigned num_idcod
 
 	jtag_add_plain_dr_scan(field.num_bits, field.out_value, field.in_value, TAP_DRPAUSE);
 	jtag_add_tlr();
-	return jtag_execute_queue();
 }
 
 static bool jtag_examine_chain_check(uint8_t *idcodes, unsigned count)
@@ -1218,12 +1369,9 @@ static bool jtag_examine_chain_match_tap(const struct jtag_tap *tap)
 	return false;
 }
 
-/* Try to examine chain layout according to IEEE 1149.1 §12
- * This is called a "blind interrogation" of the scan chain.
- */
-static int jtag_examine_chain(void)
+/* Number of IDCODE/BYPASS registers collected by the DR scan */
+static unsigned jtag_examine_chain_max_taps(void)
 {
-	int retval;
 	unsigned max_taps = jtag_tap_count();
 
 	/* Autoprobe up to this many. */
@@ -1231,23 +1379,21 @@ static int jtag_examine_chain(void)
 		max_taps = JTAG_MAX_AUTO_TAPS;
 
 	/* Add room for end-of-chain marker. */
-	max_taps++;
+	return max_taps + 1;
+}
 
-	uint8_t *idcode_buffer = calloc(4, max_taps);
-	if (idcode_buffer == NULL)
-		return ERROR_JTAG_INIT_FAILED;
+/* Try to examine chain layout according to IEEE 1149.1 §12
+ * This is called a "blind interrogation" of the scan chain.
+ *
+ * @a idcode_buffer holds the result of jtag_examine_chain_queue().
+ */
+static int jtag_examine_chain(uint8_t *idcode_buffer, unsigned max_taps)
+{
+	int retval = ERROR_OK;
 
-	/* DR scan to collect BYPASS or IDCODE register contents.
-	 * Then make sure the scan data has both ones and zeroes.
-	 */
-	LOG_DEBUG("DR scan interrogation for IDCODE/BYPASS");
-	retval = jtag_examine_chain_execute(idcode_buffer, max_taps);
-	if (retval != ERROR_OK)
-		goto out;
-	if (!jtag_examine_chain_check(idcode_buffer, max_taps)) {
-		retval = ERROR_JTAG_INIT_FAILED;
-		goto out;
-	}
+	/* Make sure the scan data has both ones and zeroes. */
+	if (!jtag_examine_chain_check(idcode_buffer, max_taps))
+		return ERROR_JTAG_INIT_FAILED;
 
 	/* Point at the 1st predefined tap, if any */
 	struct jtag_tap *tap = jtag_tap_next_enabled(NULL);
@@ -1270,10 +1416,8 @@ static int jtag_examine_chain(void)
 			 * share it with jim_newtap_cmd().
 			 */
 			tap = calloc(1, sizeof(*tap));
-			if (!tap) {
-				retval = ERROR_FAIL;
-				goto out;
-			}
+			if (!tap)
+				return ERROR_FAIL;
 
 			tap->chip = alloc_printf("auto%u", autocount++);
 			tap->tapname = strdup("tap");
@@ -1317,35 +1461,20 @@ static int jtag_examine_chain(void)
 	 */
 	if (jtag_examine_chain_end(idcode_buffer, bit_count, max_taps * 32)) {
 		LOG_ERROR("double-check your JTAG setup (interface, speed, ...)");
-		retval = ERROR_JTAG_INIT_FAILED;
-		goto out;
+		return ERROR_JTAG_INIT_FAILED;
 	}
 
 	/* Return success or, for backwards compatibility if only
 	 * some IDCODE values mismatched, a soft/continuable fault.
 	 */
-out:
-	free(idcode_buffer);
 	return retval;
 }
 
-/*
- * Validate the date loaded by entry to the Capture-IR state, to help
- * find errors related to scan chain configuration (wrong IR lengths)
- * or communication.
- *
- * Entry state can be anything.  On non-error exit, all TAPs are in
- * bypass mode.  On error exits, the scan chain is reset.
- */
-static int jtag_validate_ircapture(void)
+/* Number of bits of the IR capture validation scan of the enabled TAPs */
+static int jtag_validate_ircapture_length(void)
 {
 	struct jtag_tap *tap;
-	int total_ir_length = 0;
-	uint8_t *ir_test = NULL;
-	struct scan_field field;
-	uint64_t val;
-	int chain_pos = 0;
-	int retval;
+	int total_ir_length;
 
 	/* when autoprobing, accomodate huge IR lengths */
 	for (tap = NULL, total_ir_length = 0;
@@ -1356,25 +1485,27 @@ static int jtag_validate_ircapture(void)
 	}
 
 	/* increase length to add 2 bit sentinel after scan */
-	total_ir_length += 2;
-
-	ir_test = malloc(DIV_ROUND_UP(total_ir_length, 8));
-	if (ir_test == NULL)
-		return ERROR_FAIL;
+	return total_ir_length + 2;
+}
 
+static void jtag_validate_ircapture_queue(uint8_t *ir_test, int total_ir_length)
+{
 	/* after this scan, all TAPs will capture BYPASS instructions */
 	buf_set_ones(ir_test, total_ir_length);
 
-	field.num_bits = total_ir_length;
-	field.out_value = ir_test;
-	field.in_value = ir_test;
-
-	jtag_add_plain_ir_scan(field.num_bits, field.out_value, field.in_value, TAP_IDLE);
+	jtag_add_plain_ir_scan(total_ir_length, ir_test, ir_test, TAP_IDLE);
+}
 
-	LOG_DEBUG("IR capture validation scan");
-	retval = jtag_execute_queue();
-	if (retval != ERROR_OK)
-		goto done;
+/*
+ * Check the result of jtag_validate_ircapture_queue() in @a ir_test,
+ * and free it.  On error, the scan chain is reset.
+ */
+static int jtag_validate_ircapture_check(uint8_t *ir_test, int total_ir_length)
+{
+	struct jtag_tap *tap;
+	uint64_t val;
+	int chain_pos = 0;
+	int retval = ERROR_OK;
 
 	tap = NULL;
 	chain_pos = 0;
@@ -1453,6 +1584,37 @@ done:
 	return retval;
 }
 
+/*
+ * Validate the date loaded by entry to the Capture-IR state, to help
+ * find errors related to scan chain configuration (wrong IR lengths)
+ * or communication.
+ *
+ * Entry state can be anything.  On non-error exit, all TAPs are in
+ * bypass mode.  On error exits, the scan chain is reset.
+ */
+static int jtag_validate_ircapture(void)
+{
+	int total_ir_length = jtag_validate_ircapture_length();
+	int retval;
+
+	uint8_t *ir_test = malloc(DIV_ROUND_UP(total_ir_length, 8));
+	if (ir_test == NULL)
+		return ERROR_FAIL;
+
+	jtag_validate_ircapture_queue(ir_test, total_ir_length);
+
+	LOG_DEBUG("IR capture validation scan");
+	retval = jtag_execute_queue();
+	if (retval != ERROR_OK) {
+		free(ir_test);
+		jtag_add_tlr();
+		jtag_execute_queue();
+		return retval;
+	}
+
+	return jtag_validate_ircapture_check(ir_test, total_ir_length);
+}
+
 void jtag_tap_init(struct jtag_tap *tap)
 {
 	unsigned ir_len_bits;
@@ -1532,6 +1694,10 @@ int adapter_init(struct command_context *cmd_ctx)
 		return retval;
 	jtag = adapter_driver;
 
+	/* SWD transactions go through the recorder of "adapter record" */
+	if (adapter_driver->swd_ops)
+		adapter_driver->swd_ops = adapter_record_swd_driver(adapter_driver->swd_ops);
+
 	if (jtag->speed == NULL) {
 		LOG_INFO("This adapter doesn't support configurable speed");
 		return ERROR_OK;
@@ -1596,16 +1762,36 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 		/* REVISIT default clock will often be too fast ... */
 	}
 
+	/* The reset and the DR and IR interrogation scans are queued and
+	 * executed together.  The IR scan is sized for the enabled TAPs;
+	 * it is repeated below when the DR scan autoprobes more of them.
+	 */
+	unsigned max_taps = jtag_examine_chain_max_taps();
+	int total_ir_length = jtag_validate_ircapture_length();
+	uint8_t *idcode_buffer = calloc(4, max_taps);
+	uint8_t *ir_test = malloc(DIV_ROUND_UP(total_ir_length, 8));
+	if (idcode_buffer == NULL || ir_test == NULL) {
+		free(idcode_buffer);
+		free(ir_test);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
 	jtag_add_tlr();
-	retval = jtag_execute_queue();
-	if (retval != ERROR_OK)
-		return retval;
+	jtag_examine_chain_queue(idcode_buffer, max_taps);
+	jtag_validate_ircapture_queue(ir_test, total_ir_length);
+
+	LOG_DEBUG("DR scan interrogation for IDCODE/BYPASS, IR capture validation scan");
+	int scan_retval = jtag_execute_queue();
 
 	/* Examine DR values first.  This discovers problems which will
 	 * prevent communication ... hardware issues like TDO stuck, or
 	 * configuring the wrong number of (enabled) TAPs.
 	 */
-	retval = jtag_examine_chain();
+	if (scan_retval == ERROR_OK)
+		retval = jtag_examine_chain(idcode_buffer, max_taps);
+	else
+		retval = scan_retval;
+	free(idcode_buffer);
 	switch (retval) {
 		case ERROR_OK:
 			/* complete success */
@@ -1631,7 +1817,12 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 	 * latter is uncommon, but easily worked around:  provide
 	 * ircapture/irmask values during TAP setup.)
 	 */
-	retval = jtag_validate_ircapture();
+	if (scan_retval == ERROR_OK && total_ir_length == jtag_validate_ircapture_length()) {
+		retval = jtag_validate_ircapture_check(ir_test, total_ir_length);
+	} else {
+		free(ir_test);
+		retval = jtag_validate_ircapture();
+	}
 	if (retval != ERROR_OK) {
 		/* The target might be powered down. The user
 		 * can power it up and reset it after firing
@@ -1826,6 +2017,16 @@ int jtag_config_khz(unsigned khz)
 	return (ERROR_OK != retval) ? retval : jtag_set_speed(speed);
 }
 
+void jtag_config_speed_auto(unsigned max_khz)
+{
+	speed_auto_max_khz = max_khz;
+}
+
+unsigned jtag_get_speed_auto_max_khz(void)
+{
+	return speed_auto_max_khz;
+}
+
 int jtag_config_rclk(unsigned fallback_speed_khz)
 {
 	LOG_DEBUG("handle jtag rclk");
@@ -56,6 +56,8 @@ static int bcm2835gpio_write(int tck, int tms, int tdi);
 static int bcm2835_swdio_read(void);
 static void bcm2835_swdio_drive(bool is_output);
 static int bcm2835gpio_swd_write(int swclk, int swdio);
+static int bcm2835gpio_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset);
+static int bcm2835gpio_swd_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset);
 
 static int bcm2835gpio_init(void);
 static int bcm2835gpio_quit(void);
@@ -66,6 +68,8 @@ static struct bitbang_interface bcm2835gpio_bitbang = {
 	.swdio_read = bcm2835_swdio_read,
 	.swdio_drive = bcm2835_swdio_drive,
 	.swd_write = bcm2835gpio_swd_write,
+	.write_many = bcm2835gpio_write_many,
+	.swd_write_many = bcm2835gpio_swd_write_many,
 	.blink = NULL
 };
 
@@ -87,6 +91,12 @@ static int swclk_gpio_mode;
 static int swdio_gpio = -1;
 static int swdio_gpio_mode;
 
+/* GPIO_SET and GPIO_CLR values for each BB_TCK | BB_TMS | BB_TDI state */
+static struct {
+	uint32_t set;
+	uint32_t clear;
+} jtag_pin_states[8], swd_pin_states[8];
+
 /* Transition delay coefficients */
 static int speed_coeff = 113714;
 static int speed_offset = 28;
@@ -125,6 +135,70 @@ static int bcm2835gpio_swd_write(int swclk, int swdio)
 	return ERROR_OK;
 }
 
+static void bcm2835gpio_pin_states_init(void)
+{
+	for (unsigned int s = 0; s < ARRAY_SIZE(jtag_pin_states); s++) {
+		int tck = !!(s & BB_TCK);
+		int tms = !!(s & BB_TMS);
+		int tdi = !!(s & BB_TDI);
+
+		if (transport_is_jtag()) {
+			jtag_pin_states[s].set = tck<<tck_gpio | tms<<tms_gpio | tdi<<tdi_gpio;
+			jtag_pin_states[s].clear = !tck<<tck_gpio | !tms<<tms_gpio | !tdi<<tdi_gpio;
+		}
+		if (transport_is_swd()) {
+			swd_pin_states[s].set = tck << swclk_gpio | tdi << swdio_gpio;
+			swd_pin_states[s].clear = !tck << swclk_gpio | !tdi << swdio_gpio;
+		}
+	}
+}
+
+static int bcm2835gpio_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	for (size_t i = 0; i < count; i++) {
+		unsigned int s = states[i];
+
+		GPIO_SET = jtag_pin_states[s & 7].set;
+		GPIO_CLR = jtag_pin_states[s & 7].clear;
+
+		for (unsigned int j = 0; j < jtag_delay; j++)
+			asm volatile ("");
+
+		if (s & BB_SAMPLE) {
+			if (GPIO_LEV & 1<<tdo_gpio)
+				in[in_offset / 8] |= 1 << (in_offset % 8);
+			else
+				in[in_offset / 8] &= ~(1 << (in_offset % 8));
+			in_offset++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static int bcm2835gpio_swd_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	for (size_t i = 0; i < count; i++) {
+		unsigned int s = states[i];
+
+		GPIO_SET = swd_pin_states[s & 7].set;
+		GPIO_CLR = swd_pin_states[s & 7].clear;
+
+		for (unsigned int j = 0; j < jtag_delay; j++)
+			asm volatile ("");
+
+		if (s & BB_SAMPLE) {
+			if (GPIO_LEV & 1 << swdio_gpio)
+				in[in_offset / 8] |= 1 << (in_offset % 8);
+			else
+				in[in_offset / 8] &= ~(1 << (in_offset % 8));
+			in_offset++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 /* (1) assert or (0) deassert reset lines */
 static int bcm2835gpio_reset(int trst, int srst)
 {
@@ -467,6 +541,8 @@ static int bcm2835gpio_init(void)
 		return ERROR_JTAG_INIT_FAILED;
 	}
 
+	bcm2835gpio_pin_states_init();
+
 	dev_mem_fd = open("/dev/gpiomem", O_RDWR | O_SYNC);
 	if (dev_mem_fd < 0) {
 		LOG_DEBUG("Cannot open /dev/gpiomem, fallback to /dev/mem");
@@ -200,25 +200,86 @@ static int bitbang_stableclocks(int num_cycles)
 	return ERROR_OK;
 }
 
-static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
-		unsigned scan_size)
+/* Pin states for write_many(): TCK low then high for each bit of a byte,
+ * without and with BB_SAMPLE on the TCK low step */
+static uint8_t bitbang_lut[2][256][16];
+static bool bitbang_lut_ready;
+
+/* Bits per write_many() call, a multiple of 8 */
+#define BITBANG_CHUNK_BITS 2048
+static uint8_t bitbang_states[2 * BITBANG_CHUNK_BITS];
+
+static void bitbang_lut_init(void)
 {
-	tap_state_t saved_end_state = tap_get_end_state();
-	unsigned bit_cnt;
+	for (unsigned int sample = 0; sample < 2; sample++) {
+		for (unsigned int v = 0; v < 256; v++) {
+			for (unsigned int i = 0; i < 8; i++) {
+				uint8_t tdi = (v >> i) & 1 ? BB_TDI : 0;
+				bitbang_lut[sample][v][2 * i] = tdi | (sample ? BB_SAMPLE : 0);
+				bitbang_lut[sample][v][2 * i + 1] = tdi | BB_TCK;
+			}
+		}
+	}
+	bitbang_lut_ready = true;
+}
 
-	if (!((!ir_scan &&
-			(tap_get_state() == TAP_DRSHIFT)) ||
-			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
-		if (ir_scan)
-			bitbang_end_state(TAP_IRSHIFT);
-		else
-			bitbang_end_state(TAP_DRSHIFT);
+/**
+ * Fill bitbang_states with two steps for each of @a bits bits of @a out
+ * from bit @a first on, a whole byte at a time where it is aligned.
+ * @param out bits to drive on TDI/SWDIO, or NULL to drive zeros
+ * @param sample sample the input on every bit
+ * @return the number of states
+ */
+static size_t bitbang_fill_states(const uint8_t *out, unsigned int first, unsigned int bits, bool sample)
+{
+	const uint8_t (*lut)[16] = bitbang_lut[sample];
+	uint8_t *p = bitbang_states;
+	unsigned int end = first + bits;
+
+	if (!bitbang_lut_ready)
+		bitbang_lut_init();
+
+	for (unsigned int i = first; i < end; ) {
+		if (i % 8 == 0 && end - i >= 8) {
+			memcpy(p, lut[out ? out[i / 8] : 0], 16);
+			p += 16;
+			i += 8;
+		} else {
+			unsigned int v = out ? (out[i / 8] >> (i % 8)) & 1 : 0;
+			memcpy(p, lut[v], 2);
+			p += 2;
+			i++;
+		}
+	}
 
-		if (bitbang_state_move(0) != ERROR_OK)
+	return p - bitbang_states;
+}
+
+static int bitbang_scan_many(enum scan_type type, uint8_t *buffer, unsigned scan_size)
+{
+	const uint8_t *out = type != SCAN_IN ? buffer : NULL;
+	uint8_t *in = type != SCAN_OUT ? buffer : NULL;
+
+	for (unsigned int first = 0; first < scan_size; first += BITBANG_CHUNK_BITS) {
+		unsigned int bits = MIN(scan_size - first, BITBANG_CHUNK_BITS);
+		size_t count = bitbang_fill_states(out, first, bits, in != NULL);
+
+		/* The last bit leaves the shift state */
+		if (first + bits == scan_size) {
+			bitbang_states[count - 2] |= BB_TMS;
+			bitbang_states[count - 1] |= BB_TMS;
+		}
+
+		if (bitbang_interface->write_many(bitbang_states, count, in, first) != ERROR_OK)
 			return ERROR_FAIL;
-		bitbang_end_state(saved_end_state);
 	}
 
+	return ERROR_OK;
+}
+
+static int bitbang_scan_bits(enum scan_type type, uint8_t *buffer, unsigned scan_size)
+{
+	unsigned bit_cnt;
 	size_t buffered = 0;
 	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
 		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
@@ -278,6 +339,35 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		}
 	}
 
+	return ERROR_OK;
+}
+
+static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
+		unsigned scan_size)
+{
+	tap_state_t saved_end_state = tap_get_end_state();
+	int retval;
+
+	if (!((!ir_scan &&
+			(tap_get_state() == TAP_DRSHIFT)) ||
+			(ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
+		if (ir_scan)
+			bitbang_end_state(TAP_IRSHIFT);
+		else
+			bitbang_end_state(TAP_DRSHIFT);
+
+		if (bitbang_state_move(0) != ERROR_OK)
+			return ERROR_FAIL;
+		bitbang_end_state(saved_end_state);
+	}
+
+	if (bitbang_interface->write_many)
+		retval = bitbang_scan_many(type, buffer, scan_size);
+	else
+		retval = bitbang_scan_bits(type, buffer, scan_size);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if (tap_get_state() != tap_get_end_state()) {
 		/* we *KNOW* the above loop transitioned out of
 		 * the shift state, so we skip the first state
@@ -373,6 +463,10 @@ int bitbang_execute_queue(void)
 		}
 		cmd = cmd->next;
 	}
+	if (bitbang_interface->flush) {
+		if (bitbang_interface->flush() != ERROR_OK)
+			return ERROR_FAIL;
+	}
 	if (bitbang_interface->blink) {
 		if (bitbang_interface->blink(0) != ERROR_OK)
 			return ERROR_FAIL;
@@ -398,21 +492,33 @@ static void bitbang_swd_exchange(bool rnw, uint8_t buf[], unsigned int offset, u
 		bitbang_interface->blink(1);
 	}
 
-	for (unsigned int i = offset; i < bit_cnt + offset; i++) {
-		int bytec = i/8;
-		int bcval = 1 << (i % 8);
-		int swdio = !rnw && (buf[bytec] & bcval);
+	if (bitbang_interface->swd_write_many) {
+		uint8_t *in = rnw ? buf : NULL;
 
-		bitbang_interface->swd_write(0, swdio);
+		for (unsigned int first = offset; first < offset + bit_cnt; first += BITBANG_CHUNK_BITS) {
+			unsigned int bits = MIN(offset + bit_cnt - first, BITBANG_CHUNK_BITS);
+			size_t count = bitbang_fill_states(rnw ? NULL : buf, first, bits, in != NULL);
 
-		if (rnw && buf) {
-			if (bitbang_interface->swdio_read())
-				buf[bytec] |= bcval;
-			else
-				buf[bytec] &= ~bcval;
+			/* FIXME: we should manage errors */
+			bitbang_interface->swd_write_many(bitbang_states, count, in, first);
 		}
+	} else {
+		for (unsigned int i = offset; i < bit_cnt + offset; i++) {
+			int bytec = i/8;
+			int bcval = 1 << (i % 8);
+			int swdio = !rnw && (buf[bytec] & bcval);
+
+			bitbang_interface->swd_write(0, swdio);
+
+			if (rnw && buf) {
+				if (bitbang_interface->swdio_read())
+					buf[bytec] |= bcval;
+				else
+					buf[bytec] &= ~bcval;
+			}
 
-		bitbang_interface->swd_write(1, swdio);
+			bitbang_interface->swd_write(1, swdio);
+		}
 	}
 
 	if (bitbang_interface->blink) {
@@ -461,6 +567,7 @@ static void bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay
 		LOG_DEBUG("Skip bitbang_swd_read_reg because queued_retval=%d", queued_retval);
 		return;
 	}
+	adapter_stats_scan(46 + ap_delay_clk);
 
 	for (;;) {
 		uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
@@ -520,6 +627,7 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 		LOG_DEBUG("Skip bitbang_swd_write_reg because queued_retval=%d", queued_retval);
 		return;
 	}
+	adapter_stats_scan(46 + ap_delay_clk);
 
 	for (;;) {
 		uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
@@ -30,6 +30,12 @@ typedef enum {
 	BB_ERROR
 } bb_value_t;
 
+/** Pin state bits of the steps given to write_many() and swd_write_many() */
+#define BB_TCK		(1 << 0)	/**< TCK, or SWCLK */
+#define BB_TMS		(1 << 1)	/**< TMS, unused for SWD */
+#define BB_TDI		(1 << 2)	/**< TDI, or SWDIO */
+#define BB_SAMPLE	(1 << 3)	/**< sample TDO, or SWDIO, after setting the pins */
+
 /** Low level callbacks (for bitbang).
  *
  * Either read(), or sample() and read_sample() must be implemented.
@@ -65,6 +71,20 @@ struct bitbang_interface {
 
 	/** Set SWCLK and SWDIO to the given value. */
 	int (*swd_write)(int swclk, int swdio);
+
+	/** Set TCK, TMS and TDI to each of @a count pin states in turn (optional).
+	 * At every state with BB_SAMPLE, TDO is sampled into the next bit of
+	 * @a in, starting at bit @a in_offset. Replaces write() and read() during
+	 * scans, so the backend can map the states to its pins with a table. */
+	int (*write_many)(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset);
+
+	/** Same as write_many() for SWCLK and SWDIO (optional). The direction of
+	 * SWDIO is set with swdio_drive() beforehand. */
+	int (*swd_write_many)(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset);
+
+	/** Complete all writes and samples issued so far, at the end of
+	 * a queue (optional). */
+	int (*flush)(void);
 };
 
 extern const struct swd_driver bitbang_swd;
@@ -37,6 +37,9 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 #include <jtag/tcl.h>
+#include <target/cortex_m.h>
+#include <helper/time_support.h>
+#include <helper/perf.h>
 
 #include <hidapi.h>
 
@@ -75,6 +78,7 @@ static bool swd_mode;
 #define CMD_DAP_WRITE_ABORT       0x08
 #define CMD_DAP_DELAY             0x09
 #define CMD_DAP_RESET_TARGET      0x0A
+#define CMD_DAP_EXECUTE_COMMANDS  0x7F
 
 /* CMD_INFO */
 #define INFO_ID_VENDOR            0x01      /* string */
@@ -89,6 +93,11 @@ static bool swd_mode;
 
 #define INFO_CAPS_SWD             0x01
 #define INFO_CAPS_JTAG            0x02
+#define INFO_CAPS_SWO_UART        0x04
+#define INFO_CAPS_SWO_MANCHESTER  0x08
+#define INFO_CAPS_ATOMIC_CMDS     0x10
+#define INFO_CAPS_TEST_DOMAIN_TIMER 0x20
+#define INFO_CAPS_SWO_STREAMING   0x40
 
 /* CMD_LED */
 #define LED_ID_CONNECT            0x00
@@ -148,6 +157,28 @@ static bool swd_mode;
 #define CMD_DAP_TFER_BLOCK        0x06
 #define CMD_DAP_TFER_ABORT        0x07
 
+/* CMSIS-DAP SWO Commands */
+#define CMD_DAP_SWO_TRANSPORT     0x17
+#define CMD_DAP_SWO_MODE          0x18
+#define CMD_DAP_SWO_BAUDRATE      0x19
+#define CMD_DAP_SWO_CONTROL       0x1A
+#define CMD_DAP_SWO_STATUS        0x1B
+#define CMD_DAP_SWO_DATA          0x1C
+
+#define DAP_SWO_TRANSPORT_NONE    0x00
+#define DAP_SWO_TRANSPORT_DATA    0x01      /* read with CMD_DAP_SWO_DATA */
+
+#define DAP_SWO_MODE_OFF          0x00
+#define DAP_SWO_MODE_UART         0x01
+#define DAP_SWO_MODE_MANCHESTER   0x02
+
+#define DAP_SWO_CONTROL_STOP      0x00
+#define DAP_SWO_CONTROL_START     0x01
+
+#define DAP_SWO_STATUS_CAPTURE    0x01
+#define DAP_SWO_STATUS_ERROR      0x40
+#define DAP_SWO_STATUS_OVERRUN    0x80
+
 /* DAP Status Code */
 #define DAP_OK                    0
 #define DAP_ERROR                 0xFF
@@ -157,30 +188,50 @@ static bool swd_mode;
 
 static const char * const info_caps_str[] = {
 	"SWD  Supported",
-	"JTAG Supported"
+	"JTAG Supported",
+	"SWO-UART Supported",
+	"SWO-MANCHESTER Supported",
+	"Atomic commands Supported",
+	"Test domain timer Supported",
+	"SWO streaming trace Supported"
 };
 
 /* max clock speed (kHz) */
 #define DAP_MAX_CLOCK             5000
 
-struct cmsis_dap {
-	hid_device *dev_handle;
-	uint16_t packet_size;
-	int packet_count;
-	uint8_t *packet_buffer;
-	uint8_t caps;
-	uint8_t mode;
-};
-
 struct pending_transfer_result {
 	uint8_t cmd;
 	uint32_t data;
 	void *buffer;
 };
 
+/* latency histogram bucket n counts round trips of 2^n to 2^(n+1) - 1 us,
+ * the last bucket everything slower */
+#define STATS_LATENCY_BUCKETS 20
+
+/* host side counters of the SWD transfer queue, see "cmsis-dap stats" */
+struct cmsis_dap_stats {
+	uint64_t packets;
+	uint64_t request_bytes;
+	/* replies parsed, and their bytes */
+	uint64_t responses;
+	uint64_t response_bytes;
+	uint64_t transfers;
+	uint64_t waits;
+	uint64_t faults;
+	uint64_t errors;
+	uint64_t latency_us_total;
+	uint64_t latency_us_max;
+	uint64_t latency[STATS_LATENCY_BUCKETS];
+};
+
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	int transfer_count;
+	/** All transfers access the same register, send as DAP_TransferBlock */
+	bool block_transfer;
+	/** Time from sending the request until the response arrived */
+	struct duration round_trip;
 };
 
 struct pending_scan_result {
@@ -198,28 +249,66 @@ struct pending_scan_result {
  * until the first response arrives */
 #define MAX_PENDING_REQUESTS 3
 
-/* Pending requests are organized as a FIFO - circular buffer */
-/* Each block in FIFO can contain up to pending_queue_len transfers */
-static int pending_queue_len;
-static struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
-static int pending_fifo_put_idx, pending_fifo_get_idx;
-static int pending_fifo_block_count;
-
-/* pointers to buffers that will receive jtag scan results on the next flush */
-#define MAX_PENDING_SCAN_RESULTS 256
-static int pending_scan_result_count;
-static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS];
+/* DAP_ExecuteCommands carries an 8 bit command count */
+#define MAX_BATCH_COMMANDS 255
 
-/* queued JTAG sequences that will be executed on the next flush */
-#define QUEUED_SEQ_BUF_LEN (cmsis_dap_handle->packet_size - 3)
-static int queued_seq_count;
-static int queued_seq_buf_end;
-static int queued_seq_tdo_ptr;
-static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
+/* One CMSIS-DAP probe: USB handle, packet geometry and all queue state.
+ * Buffers are sized from the packet size and count the probe reports. */
+struct cmsis_dap {
+	hid_device *dev_handle;
+	uint16_t packet_size;
+	int packet_count;
+	uint8_t *packet_buffer;
+	uint8_t caps;
+	uint8_t mode;
 
-static int queued_retval;
+	/* Pending requests are organized as a FIFO - circular buffer */
+	/* Each block in FIFO can contain up to pending_queue_len transfers,
+	 * or up to pending_block_len transfers of the same register */
+	int pending_queue_len;
+	int pending_block_len;
+	struct pending_request_block *pending_fifo;
+	int pending_fifo_put_idx, pending_fifo_get_idx;
+	int pending_fifo_block_count;
+	/* value of the previous read, used to imitate posted AP reads */
+	uint32_t last_read;
+
+	/* pointers to buffers that will receive jtag scan results on the next flush */
+	int pending_scan_result_count;
+	int pending_scan_result_max;
+	struct pending_scan_result *pending_scan_results;
+
+	/* queued JTAG sequences that will be executed on the next flush */
+	int queued_seq_count;
+	int queued_seq_buf_end;
+	int queued_seq_tdo_ptr;
+	uint8_t *queued_seq_buf;
+
+	/* JTAG commands batched for the next flush, sent as one
+	 * DAP_ExecuteCommands request if the adapter supports it */
+	bool execute_commands;
+	uint8_t *batch_buf;
+	int batch_len;
+	int batch_count;
+	int batch_resp_len;
+	uint8_t batch_cmd[MAX_BATCH_COMMANDS];
+	uint16_t batch_resp_offset[MAX_BATCH_COMMANDS];
+	/* scan results from here on belong to the still open sequence */
+	int pending_scan_result_seq_start;
+
+	int queued_retval;
+
+	struct cmsis_dap_stats stats;
+
+	uint8_t output_pins;
+
+	/* SWO trace is read with DAP_SWO_Data, HID has no stream endpoint */
+	bool trace_enabled;
+};
 
-static uint8_t output_pins = SWJ_PIN_SRST | SWJ_PIN_TRST;
+#define QUEUED_SEQ_BUF_LEN(dap) ((dap)->packet_size - 3)
+/* longest request or response without the report number */
+#define BATCH_BUF_LEN(dap) ((dap)->packet_size - 1)
 
 static struct cmsis_dap *cmsis_dap_handle;
 
@@ -318,6 +407,7 @@ static int cmsis_dap_usb_open(void)
 	dap->dev_handle = dev;
 	dap->caps = 0;
 	dap->mode = 0;
+	dap->output_pins = SWJ_PIN_SRST | SWJ_PIN_TRST;
 
 	cmsis_dap_handle = dap;
 
@@ -352,16 +442,19 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	hid_close(dap->dev_handle);
 	hid_exit();
 
-	free(cmsis_dap_handle->packet_buffer);
-	free(cmsis_dap_handle);
+	if (dap->pending_fifo) {
+		for (int i = 0; i < dap->packet_count; i++)
+			free(dap->pending_fifo[i].transfers);
+		free(dap->pending_fifo);
+	}
+	free(dap->pending_scan_results);
+	free(dap->batch_buf);
+	free(dap->queued_seq_buf);
+	free(dap->packet_buffer);
+	free(dap);
 	cmsis_dap_handle = NULL;
 	free(cmsis_dap_serial);
 	cmsis_dap_serial = NULL;
-
-	for (int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(pending_fifo[i].transfers);
-		pending_fifo[i].transfers = NULL;
-	}
 }
 
 static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
@@ -373,11 +466,14 @@ static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
 	memset(dap->packet_buffer + txlen, 0, dap->packet_size - txlen);
 
 	/* write data to device */
+	int64_t start = perf_start();
 	int retval = hid_write(dap->dev_handle, dap->packet_buffer, dap->packet_size);
+	perf_end(PERF_USB_WRITE, start);
 	if (retval == -1) {
 		LOG_ERROR("error writing data: %ls", hid_error(dap->dev_handle));
 		return ERROR_FAIL;
 	}
+	adapter_stats_usb(retval);
 
 	return ERROR_OK;
 }
@@ -385,14 +481,14 @@ static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
 /* Send a message and receive the reply */
 static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 {
-	if (pending_fifo_block_count) {
-		LOG_ERROR("pending %d blocks, flushing", pending_fifo_block_count);
-		while (pending_fifo_block_count) {
+	if (dap->pending_fifo_block_count) {
+		LOG_ERROR("pending %d blocks, flushing", dap->pending_fifo_block_count);
+		while (dap->pending_fifo_block_count) {
 			hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, 10);
-			pending_fifo_block_count--;
+			dap->pending_fifo_block_count--;
 		}
-		pending_fifo_put_idx = 0;
-		pending_fifo_get_idx = 0;
+		dap->pending_fifo_put_idx = 0;
+		dap->pending_fifo_get_idx = 0;
 	}
 
 	int retval = cmsis_dap_usb_write(dap, txlen);
@@ -400,11 +496,14 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 		return retval;
 
 	/* get reply */
+	int64_t start = perf_start();
 	retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
+	perf_end(PERF_USB_READ, start);
 	if (retval == -1 || retval == 0) {
 		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
 		return ERROR_FAIL;
 	}
+	adapter_stats_usb(retval);
 
 	return ERROR_OK;
 }
@@ -604,6 +703,106 @@ static int cmsis_dap_cmd_DAP_SWD_Configure(uint8_t cfg)
 	return ERROR_OK;
 }
 
+static int cmsis_dap_cmd_DAP_SWO_Transport(uint8_t transport)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_SWO_TRANSPORT;
+	buffer[2] = transport;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 3);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Transport failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWO_Mode(uint8_t mode)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_SWO_MODE;
+	buffer[2] = mode;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 3);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Mode failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* Returns in @a actual the baudrate the adapter has set, 0 if the
+ * requested one is not supported */
+static int cmsis_dap_cmd_DAP_SWO_Baudrate(uint32_t baudrate, uint32_t *actual)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_SWO_BAUDRATE;
+	h_u32_to_le(&buffer[2], baudrate);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 6);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Baudrate failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	*actual = le_to_h_u32(&buffer[1]);
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWO_Control(uint8_t control)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_SWO_CONTROL;
+	buffer[2] = control;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 3);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Control failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* Reads up to @a *size bytes of captured trace into @a data */
+static int cmsis_dap_cmd_DAP_SWO_Data(uint8_t *data, size_t *size, uint8_t *status)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	size_t max = MIN(*size, (size_t)(cmsis_dap_handle->packet_size - 5));
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_SWO_DATA;
+	h_u16_to_le(&buffer[2], max);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 4);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Data failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	*status = buffer[1];
+	*size = MIN(le_to_h_u16(&buffer[2]), max);
+	memcpy(data, &buffer[4], *size);
+
+	return ERROR_OK;
+}
+
 #if 0
 static int cmsis_dap_cmd_DAP_Delay(uint16_t delay_us)
 {
@@ -628,12 +827,12 @@ static int cmsis_dap_cmd_DAP_Delay(uint16_t delay_us)
 static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 {
 	uint8_t *buffer = dap->packet_buffer;
-	struct pending_request_block *block = &pending_fifo[pending_fifo_put_idx];
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
 
-	LOG_DEBUG_IO("Executing %d queued transactions from FIFO index %d", block->transfer_count, pending_fifo_put_idx);
+	LOG_TRACE("Executing %d queued transactions from FIFO index %d", block->transfer_count, dap->pending_fifo_put_idx);
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
+	if (dap->queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skipping due to previous errors: %d", dap->queued_retval);
 		goto skip;
 	}
 
@@ -641,20 +840,34 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		goto skip;
 
 	size_t idx = 0;
+	bool block_transfer = block->block_transfer && block->transfer_count > 1;
 	buffer[idx++] = 0;	/* report number */
-	buffer[idx++] = CMD_DAP_TFER;
-	buffer[idx++] = 0x00;	/* DAP Index */
-	buffer[idx++] = block->transfer_count;
+	if (block_transfer) {
+		/* a single request byte for the whole run of transfers */
+		buffer[idx++] = CMD_DAP_TFER_BLOCK;
+		buffer[idx++] = 0x00;	/* DAP Index */
+		buffer[idx++] = block->transfer_count & 0xff;
+		buffer[idx++] = (block->transfer_count >> 8) & 0xff;
+		buffer[idx++] = (block->transfers[0].cmd >> 1) & 0x0f;
+	} else {
+		buffer[idx++] = CMD_DAP_TFER;
+		buffer[idx++] = 0x00;	/* DAP Index */
+		buffer[idx++] = block->transfer_count;
+	}
 
 	for (int i = 0; i < block->transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		uint8_t cmd = transfer->cmd;
 		uint32_t data = transfer->data;
 
-		LOG_DEBUG_IO("%s %s reg %x %"PRIx32,
-				cmd & SWD_CMD_APnDP ? "AP" : "DP",
-				cmd & SWD_CMD_RnW ? "read" : "write",
-			  (cmd & SWD_CMD_A32) >> 1, data);
+		if (block_transfer)
+			LOG_TRACE("APnDP %d RnW %d reg %x %" PRIx32 " (block)",
+					!!(cmd & SWD_CMD_APnDP), !!(cmd & SWD_CMD_RnW),
+					(cmd & SWD_CMD_A32) >> 1, data);
+		else
+			LOG_TRACE("APnDP %d RnW %d reg %x %" PRIx32,
+					!!(cmd & SWD_CMD_APnDP), !!(cmd & SWD_CMD_RnW),
+					(cmd & SWD_CMD_A32) >> 1, data);
 
 		/* When proper WAIT handling is implemented in the
 		 * common SWD framework, this kludge can be
@@ -675,7 +888,8 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 			data &= ~CORUNDETECT;
 		}
 
-		buffer[idx++] = (cmd >> 1) & 0x0f;
+		if (!block_transfer)
+			buffer[idx++] = (cmd >> 1) & 0x0f;
 		if (!(cmd & SWD_CMD_RnW)) {
 			buffer[idx++] = (data) & 0xff;
 			buffer[idx++] = (data >> 8) & 0xff;
@@ -684,14 +898,19 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
-	queued_retval = cmsis_dap_usb_write(dap, idx);
-	if (queued_retval != ERROR_OK)
+	duration_start(&block->round_trip);
+	dap->queued_retval = cmsis_dap_usb_write(dap, idx);
+	if (dap->queued_retval != ERROR_OK)
 		goto skip;
 
-	pending_fifo_put_idx = (pending_fifo_put_idx + 1) % dap->packet_count;
-	pending_fifo_block_count++;
-	if (pending_fifo_block_count > dap->packet_count)
-		LOG_ERROR("too much pending writes %d", pending_fifo_block_count);
+	dap->stats.packets++;
+	dap->stats.request_bytes += idx - 1;	/* without the report number */
+	dap->stats.transfers += block->transfer_count;
+
+	dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % dap->packet_count;
+	dap->pending_fifo_block_count++;
+	if (dap->pending_fifo_block_count > dap->packet_count)
+		LOG_ERROR("too much pending writes %d", dap->pending_fifo_block_count);
 
 	return;
 
@@ -699,108 +918,172 @@ skip:
 	block->transfer_count = 0;
 }
 
+static void cmsis_dap_stats_round_trip(struct cmsis_dap *dap,
+		struct pending_request_block *block)
+{
+	struct cmsis_dap_stats *stats = &dap->stats;
+
+	duration_measure(&block->round_trip);
+	uint64_t us = block->round_trip.elapsed.tv_sec * 1000000ULL + block->round_trip.elapsed.tv_usec;
+
+	int bucket = 0;
+	while (bucket < STATS_LATENCY_BUCKETS - 1 && (us >> (bucket + 1)))
+		bucket++;
+	stats->latency[bucket]++;
+	stats->latency_us_total += us;
+	stats->latency_us_max = MAX(stats->latency_us_max, us);
+}
+
 static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 {
 	uint8_t *buffer = dap->packet_buffer;
-	struct pending_request_block *block = &pending_fifo[pending_fifo_get_idx];
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_get_idx];
 
-	if (pending_fifo_block_count == 0)
+	if (dap->pending_fifo_block_count == 0)
 		LOG_ERROR("no pending write");
 
 	/* get reply */
+	int64_t start = perf_start();
 	int retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, timeout_ms);
 	if (retval == 0 && timeout_ms < USB_TIMEOUT)
 		return;
+	perf_end(PERF_USB_READ, start);
 
 	if (retval == -1 || retval == 0) {
 		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
-		queued_retval = ERROR_FAIL;
+		dap->stats.errors++;
+		dap->queued_retval = ERROR_FAIL;
 		goto skip;
 	}
+	cmsis_dap_stats_round_trip(dap, block);
 
-	if (buffer[2] & 0x08) {
-		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", buffer[1]);
-		queued_retval = ERROR_FAIL;
+	/* DAP_TransferBlock has a 16 bit transfer count */
+	int transfer_count;
+	uint8_t response;
+	size_t idx;
+	if (buffer[0] == CMD_DAP_TFER_BLOCK) {
+		transfer_count = le_to_h_u16(&buffer[1]);
+		response = buffer[3];
+		idx = 4;
+	} else {
+		transfer_count = buffer[1];
+		response = buffer[2];
+		idx = 3;
+	}
+
+	if (response & 0x08) {
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
+		dap->stats.errors++;
+		dap->queued_retval = ERROR_FAIL;
 		goto skip;
 	}
-	uint8_t ack = buffer[2] & 0x07;
+	uint8_t ack = response & 0x07;
 	if (ack != SWD_ACK_OK) {
-		LOG_DEBUG("SWD ack not OK @ %d %s", buffer[1],
+		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
-		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
+		dap->stats.errors++;
+		if (ack == SWD_ACK_WAIT)
+			dap->stats.waits++;
+		else if (ack == SWD_ACK_FAULT)
+			dap->stats.faults++;
+		dap->queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 		goto skip;
 	}
 
-	if (block->transfer_count != buffer[1])
+	if (block->transfer_count != transfer_count)
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  block->transfer_count, buffer[1]);
+			  block->transfer_count, transfer_count);
 
-	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", buffer[1], pending_fifo_get_idx);
-	size_t idx = 3;
-	for (int i = 0; i < buffer[1]; i++) {
+	LOG_TRACE("Received results of %d queued transactions FIFO index %d", transfer_count, dap->pending_fifo_get_idx);
+	for (int i = 0; i < MIN(transfer_count, block->transfer_count); i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RnW) {
-			static uint32_t last_read;
 			uint32_t data = le_to_h_u32(&buffer[idx]);
 			uint32_t tmp = data;
 			idx += 4;
 
-			LOG_DEBUG_IO("Read result: %"PRIx32, data);
+			LOG_TRACE("Read result: %" PRIx32, data);
 
 			/* Imitate posted AP reads */
 			if ((transfer->cmd & SWD_CMD_APnDP) ||
 			    ((transfer->cmd & SWD_CMD_A32) >> 1 == DP_RDBUFF)) {
-				tmp = last_read;
-				last_read = data;
+				tmp = dap->last_read;
+				dap->last_read = data;
 			}
 
 			if (transfer->buffer)
 				*(uint32_t *)(transfer->buffer) = tmp;
 		}
 	}
+	dap->stats.responses++;
+	dap->stats.response_bytes += idx;
 
 skip:
 	block->transfer_count = 0;
-	pending_fifo_get_idx = (pending_fifo_get_idx + 1) % dap->packet_count;
-	pending_fifo_block_count--;
+	dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % dap->packet_count;
+	dap->pending_fifo_block_count--;
 }
 
 static int cmsis_dap_swd_run_queue(void)
 {
-	if (pending_fifo_block_count)
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	if (dap->pending_fifo_block_count)
 		cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
 
 	cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
 
-	while (pending_fifo_block_count)
+	while (dap->pending_fifo_block_count)
 		cmsis_dap_swd_read_process(cmsis_dap_handle, USB_TIMEOUT);
 
-	pending_fifo_put_idx = 0;
-	pending_fifo_get_idx = 0;
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
 
-	int retval = queued_retval;
-	queued_retval = ERROR_OK;
+	int retval = dap->queued_retval;
+	dap->queued_retval = ERROR_OK;
 
 	return retval;
 }
 
+/* Checks whether @a block has room for one more transfer using @a cmd */
+static bool cmsis_dap_swd_block_full(struct cmsis_dap *dap,
+		const struct pending_request_block *block, uint8_t cmd)
+{
+	if (block->transfer_count == 0)
+		return false;
+
+	/* runs of the same request are sent as DAP_TransferBlock, which
+	 * needs only 4 bytes per transfer instead of up to 5 */
+	if (block->block_transfer && block->transfers[0].cmd == cmd)
+		return block->transfer_count >= dap->pending_block_len;
+
+	return block->transfer_count >= dap->pending_queue_len;
+}
+
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
-	if (pending_fifo[pending_fifo_put_idx].transfer_count == pending_queue_len) {
-		if (pending_fifo_block_count)
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	adapter_stats_scan(46);
+	if (cmsis_dap_swd_block_full(dap, &dap->pending_fifo[dap->pending_fifo_put_idx], cmd)) {
+		if (dap->pending_fifo_block_count)
 			cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
 
 		/* Not enough room in the queue. Run the queue. */
 		cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
 
-		if (pending_fifo_block_count >= cmsis_dap_handle->packet_count)
+		if (dap->pending_fifo_block_count >= dap->packet_count)
 			cmsis_dap_swd_read_process(cmsis_dap_handle, USB_TIMEOUT);
 	}
 
-	if (queued_retval != ERROR_OK)
+	if (dap->queued_retval != ERROR_OK)
 		return;
 
-	struct pending_request_block *block = &pending_fifo[pending_fifo_put_idx];
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+	if (block->transfer_count == 0)
+		block->block_transfer = true;
+	else if (block->transfers[0].cmd != cmd)
+		block->block_transfer = false;
+
 	struct pending_transfer_result *transfer = &(block->transfers[block->transfer_count]);
 	transfer->data = data;
 	transfer->cmd = cmd;
@@ -811,9 +1094,50 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 	block->transfer_count++;
 }
 
+/*
+ * TARGETSEL of SWD multi-drop gets no ACK from any DP, which DAP_Transfer
+ * would report as a protocol error. Clock the whole packet out with
+ * DAP_SWJ_Sequence instead: request, turnaround and ACK phase (driven, as
+ * no target drives it), data and parity, then two idle cycles.
+ */
+static void cmsis_dap_swd_targetsel(uint8_t cmd, uint32_t value)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t seq[6];
+
+	/* the queued transfers have to go out before the sequence */
+	if (dap->pending_fifo_block_count)
+		cmsis_dap_swd_read_process(dap, 0);
+	cmsis_dap_swd_write_from_queue(dap);
+	while (dap->pending_fifo_block_count)
+		cmsis_dap_swd_read_process(dap, USB_TIMEOUT);
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
+
+	if (dap->queued_retval != ERROR_OK)
+		return;
+
+	seq[0] = cmd | SWD_CMD_START | SWD_CMD_PARK;
+	memset(&seq[1], 0, sizeof(seq) - 1);
+	/* bits 8..12: turnaround and ACK, left low */
+	buf_set_u32(seq, 13, 32, value);
+	buf_set_u32(seq, 45, 1, parity_u32(value));
+	/* bits 46..47: idle */
+
+	LOG_DEBUG_IO("DP TARGETSEL write %" PRIx32, value);
+	if (cmsis_dap_cmd_DAP_SWJ_Sequence(48, seq) != ERROR_OK)
+		dap->queued_retval = ERROR_FAIL;
+}
+
 static void cmsis_dap_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
 {
 	assert(!(cmd & SWD_CMD_RnW));
+
+	if (cmd == swd_cmd(false, false, DP_TARGETSEL)) {
+		cmsis_dap_swd_targetsel(cmd, value);
+		return;
+	}
+
 	cmsis_dap_swd_queue_cmd(cmd, NULL, value);
 }
 
@@ -852,6 +1176,23 @@ static int cmsis_dap_get_version_info(void)
 	return ERROR_OK;
 }
 
+/* DAP_ExecuteCommands is optional, adapters without it answer DAP_Invalid */
+static bool cmsis_dap_probe_execute_commands(void)
+{
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = 0;	/* report number */
+	buffer[1] = CMD_DAP_EXECUTE_COMMANDS;
+	buffer[2] = 1;
+	buffer[3] = CMD_DAP_INFO;
+	buffer[4] = INFO_ID_CAPS;
+	if (cmsis_dap_usb_xfer(cmsis_dap_handle, 5) != ERROR_OK)
+		return false;
+
+	return buffer[0] == CMD_DAP_EXECUTE_COMMANDS && buffer[1] == 1 &&
+		buffer[2] == CMD_DAP_INFO;
+}
+
 static int cmsis_dap_get_caps_info(void)
 {
 	uint8_t *data;
@@ -866,10 +1207,10 @@ static int cmsis_dap_get_caps_info(void)
 
 		cmsis_dap_handle->caps = caps;
 
-		if (caps & INFO_CAPS_SWD)
-			LOG_INFO("CMSIS-DAP: %s", info_caps_str[0]);
-		if (caps & INFO_CAPS_JTAG)
-			LOG_INFO("CMSIS-DAP: %s", info_caps_str[1]);
+		for (unsigned int i = 0; i < ARRAY_SIZE(info_caps_str); i++) {
+			if (caps & BIT(i))
+				LOG_INFO("CMSIS-DAP: %s", info_caps_str[i]);
+		}
 	}
 
 	return ERROR_OK;
@@ -896,11 +1237,12 @@ static int cmsis_dap_get_status(void)
 
 static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
 {
+	struct cmsis_dap *dap = cmsis_dap_handle;
 	const uint8_t *s;
 	unsigned int s_len;
 	int retval;
 
-	if ((output_pins & (SWJ_PIN_SRST | SWJ_PIN_TRST)) == (SWJ_PIN_SRST | SWJ_PIN_TRST)) {
+	if ((dap->output_pins & (SWJ_PIN_SRST | SWJ_PIN_TRST)) == (SWJ_PIN_SRST | SWJ_PIN_TRST)) {
 		/* Following workaround deasserts reset on most adapters.
 		 * Do not reconnect if a reset line is active!
 		 * Reconnecting would break connecting under reset. */
@@ -966,6 +1308,7 @@ static int cmsis_dap_swd_open(void)
 
 static int cmsis_dap_init(void)
 {
+	struct cmsis_dap *dap;
 	int retval;
 	uint8_t *data;
 
@@ -973,6 +1316,8 @@ static int cmsis_dap_init(void)
 	if (retval != ERROR_OK)
 		return retval;
 
+	dap = cmsis_dap_handle;
+
 	retval = cmsis_dap_get_caps_info();
 	if (retval != ERROR_OK)
 		return retval;
@@ -991,7 +1336,7 @@ static int cmsis_dap_init(void)
 			return retval;
 	} else {
 		/* Connect in JTAG mode */
-		if (!(cmsis_dap_handle->caps & INFO_CAPS_JTAG)) {
+		if (!(dap->caps & INFO_CAPS_JTAG)) {
 			LOG_ERROR("CMSIS-DAP: JTAG not supported");
 			return ERROR_JTAG_DEVICE_ERROR;
 		}
@@ -1005,8 +1350,9 @@ static int cmsis_dap_init(void)
 
 	/* Be conservative and suppress submitting multiple HID requests
 	 * until we get packet count info from the adaptor */
-	cmsis_dap_handle->packet_count = 1;
-	pending_queue_len = 12;
+	dap->packet_count = 1;
+	dap->pending_queue_len = 12;
+	dap->pending_block_len = 12;
 
 	/* INFO_ID_PKT_SZ - short */
 	retval = cmsis_dap_cmd_DAP_Info(INFO_ID_PKT_SZ, &data);
@@ -1019,14 +1365,17 @@ static int cmsis_dap_init(void)
 		/* 4 bytes of command header + 5 bytes per register
 		 * write. For bulk read sequences just 4 bytes are
 		 * needed per transfer, so this is suboptimal. */
-		pending_queue_len = (pkt_sz - 4) / 5;
+		dap->pending_queue_len = (pkt_sz - 4) / 5;
+		/* DAP_TransferBlock: 5 bytes of command header and 4 bytes
+		 * per word in the request or in the response */
+		dap->pending_block_len = (pkt_sz - 5) / 4;
 
-		if (cmsis_dap_handle->packet_size != pkt_sz + 1) {
+		if (dap->packet_size != pkt_sz + 1) {
 			/* reallocate buffer */
-			cmsis_dap_handle->packet_size = pkt_sz + 1;
-			cmsis_dap_handle->packet_buffer = realloc(cmsis_dap_handle->packet_buffer,
-					cmsis_dap_handle->packet_size);
-			if (cmsis_dap_handle->packet_buffer == NULL) {
+			dap->packet_size = pkt_sz + 1;
+			dap->packet_buffer = realloc(dap->packet_buffer,
+					dap->packet_size);
+			if (dap->packet_buffer == NULL) {
 				LOG_ERROR("unable to reallocate memory");
 				return ERROR_FAIL;
 			}
@@ -1043,20 +1392,41 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			dap->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %d", pkt_cnt);
 	}
 
-	LOG_DEBUG("Allocating FIFO for %d pending HID requests", cmsis_dap_handle->packet_count);
-	for (int i = 0; i < cmsis_dap_handle->packet_count; i++) {
-		pending_fifo[i].transfers = malloc(pending_queue_len * sizeof(struct pending_transfer_result));
-		if (!pending_fifo[i].transfers) {
+	LOG_DEBUG("Allocating FIFO for %d pending HID requests", dap->packet_count);
+	dap->pending_fifo = calloc(dap->packet_count, sizeof(struct pending_request_block));
+	if (!dap->pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		return ERROR_FAIL;
+	}
+	for (int i = 0; i < dap->packet_count; i++) {
+		dap->pending_fifo[i].transfers = malloc(MAX(dap->pending_queue_len, dap->pending_block_len) *
+				sizeof(struct pending_transfer_result));
+		if (!dap->pending_fifo[i].transfers) {
 			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
 			return ERROR_FAIL;
 		}
 	}
 
+	/* every TDO capturing sequence takes at least two bytes of the buffer */
+	dap->queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN(dap));
+	dap->batch_buf = malloc(BATCH_BUF_LEN(dap));
+	dap->pending_scan_result_max = QUEUED_SEQ_BUF_LEN(dap) / 2;
+	dap->pending_scan_results = calloc(dap->pending_scan_result_max,
+			sizeof(struct pending_scan_result));
+	if (!dap->queued_seq_buf || !dap->batch_buf || !dap->pending_scan_results) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP JTAG queue");
+		return ERROR_FAIL;
+	}
+
+
+	dap->execute_commands = cmsis_dap_probe_execute_commands();
+	LOG_DEBUG("CMSIS-DAP: DAP_ExecuteCommands %ssupported",
+		dap->execute_commands ? "" : "not ");
 
 	retval = cmsis_dap_get_status();
 	if (retval != ERROR_OK)
@@ -1113,8 +1483,121 @@ static int cmsis_dap_swd_init(void)
 	return ERROR_OK;
 }
 
+static int cmsis_dap_swo_stop(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (!dap->trace_enabled)
+		return ERROR_OK;
+
+	dap->trace_enabled = false;
+
+	int retval = cmsis_dap_cmd_DAP_SWO_Control(DAP_SWO_CONTROL_STOP);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_SWO_Mode(DAP_SWO_MODE_OFF);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_SWO_Transport(DAP_SWO_TRANSPORT_NONE);
+
+	return retval;
+}
+
+static int cmsis_dap_config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
+		uint32_t port_size, unsigned int *trace_freq,
+		unsigned int traceclkin_freq, uint16_t *prescaler)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t mode;
+	uint32_t baudrate;
+	int retval;
+
+	if (!enabled)
+		return cmsis_dap_swo_stop();
+
+	if (pin_protocol == TPIU_PIN_PROTOCOL_ASYNC_UART && (dap->caps & INFO_CAPS_SWO_UART)) {
+		mode = DAP_SWO_MODE_UART;
+	} else if (pin_protocol == TPIU_PIN_PROTOCOL_ASYNC_MANCHESTER &&
+			(dap->caps & INFO_CAPS_SWO_MANCHESTER)) {
+		mode = DAP_SWO_MODE_MANCHESTER;
+	} else {
+		LOG_ERROR("The attached CMSIS-DAP adapter doesn't support this trace mode");
+		return ERROR_FAIL;
+	}
+
+	retval = cmsis_dap_swo_stop();
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_cmd_DAP_SWO_Transport(DAP_SWO_TRANSPORT_DATA);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_cmd_DAP_SWO_Mode(mode);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* without a requested rate ask for TRACECLKIN, the adapter
+	 * answers with the closest rate it can capture */
+	retval = cmsis_dap_cmd_DAP_SWO_Baudrate(*trace_freq ? *trace_freq : traceclkin_freq,
+			&baudrate);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!baudrate) {
+		LOG_ERROR("SWO frequency is not supported by the adapter");
+		return ERROR_FAIL;
+	}
+
+	uint32_t presc = traceclkin_freq / baudrate;
+	if (traceclkin_freq % baudrate > 0)
+		presc++;
+
+	if (presc == 0 || presc > TPIU_ACPR_MAX_SWOSCALER) {
+		LOG_ERROR("SWO frequency is not suitable. Please choose a different "
+			"frequency.");
+		return ERROR_FAIL;
+	}
+
+	if (traceclkin_freq / presc != baudrate)
+		LOG_WARNING("SWO output of %u Hz doesn't match the adapter baudrate of %" PRIu32 " Hz",
+			traceclkin_freq / presc, baudrate);
+
+	*prescaler = presc;
+	*trace_freq = baudrate;
+
+	retval = cmsis_dap_cmd_DAP_SWO_Control(DAP_SWO_CONTROL_START);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dap->trace_enabled = true;
+	return ERROR_OK;
+}
+
+static int cmsis_dap_poll_trace(uint8_t *buf, size_t *size)
+{
+	uint8_t status;
+
+	if (!cmsis_dap_handle->trace_enabled) {
+		*size = 0;
+		return ERROR_OK;
+	}
+
+	int retval = cmsis_dap_cmd_DAP_SWO_Data(buf, size, &status);
+	if (retval != ERROR_OK) {
+		*size = 0;
+		return retval;
+	}
+
+	if (status & DAP_SWO_STATUS_OVERRUN)
+		LOG_WARNING("SWO trace buffer overrun, data lost");
+	if (status & DAP_SWO_STATUS_ERROR)
+		LOG_WARNING("SWO trace capture error");
+
+	return ERROR_OK;
+}
+
 static int cmsis_dap_quit(void)
 {
+	cmsis_dap_swo_stop();
 	cmsis_dap_cmd_DAP_Disconnect();
 	/* Both LEDs off */
 	cmsis_dap_cmd_DAP_LED(LED_ID_RUN, LED_OFF);
@@ -1127,42 +1610,23 @@ static int cmsis_dap_quit(void)
 
 static int cmsis_dap_reset(int trst, int srst)
 {
+	struct cmsis_dap *dap = cmsis_dap_handle;
 	/* Set both TRST and SRST even if they're not enabled as
 	 * there's no way to tristate them */
 
-	output_pins = 0;
+	dap->output_pins = 0;
 	if (!srst)
-		output_pins |= SWJ_PIN_SRST;
+		dap->output_pins |= SWJ_PIN_SRST;
 	if (!trst)
-		output_pins |= SWJ_PIN_TRST;
+		dap->output_pins |= SWJ_PIN_TRST;
 
-	int retval = cmsis_dap_cmd_DAP_SWJ_Pins(output_pins,
+	int retval = cmsis_dap_cmd_DAP_SWJ_Pins(dap->output_pins,
 			SWJ_PIN_TRST | SWJ_PIN_SRST, 0, NULL);
 	if (retval != ERROR_OK)
 		LOG_ERROR("CMSIS-DAP: Interface reset failed");
 	return retval;
 }
 
-static void cmsis_dap_execute_sleep(struct jtag_command *cmd)
-{
-#if 0
-	int retval = cmsis_dap_cmd_DAP_Delay(cmd->cmd.sleep->us);
-	if (retval != ERROR_OK)
-#endif
-		jtag_sleep(cmd->cmd.sleep->us);
-}
-
-/* Set TMS high for five TCK clocks, to move the TAP to the Test-Logic-Reset state */
-static int cmsis_dap_execute_tlr_reset(struct jtag_command *cmd)
-{
-	LOG_INFO("cmsis-dap JTAG TLR_RESET");
-	uint8_t seq = 0xff;
-	int ret = cmsis_dap_cmd_DAP_SWJ_Sequence(8, &seq);
-	if (ret == ERROR_OK)
-		tap_set_state(TAP_RESET);
-	return ret;
-}
-
 /* Set new end state */
 static void cmsis_dap_end_state(tap_state_t state)
 {
@@ -1241,57 +1705,181 @@ static void debug_parse_cmsis_buf(const uint8_t *cmd, int cmdlen)
 }
 #endif
 
-static void cmsis_dap_flush(void)
+/* Send the batched commands, as one DAP_ExecuteCommands request if there
+ * are several, and copy the captured TDO bits into the client buffers */
+static int cmsis_dap_batch_flush(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t *buffer = dap->packet_buffer;
+	const uint8_t *response;
+	int txlen;
+
+	if (!dap->batch_count)
+		return ERROR_OK;
+
+	LOG_DEBUG_IO("Flushing %d batched commands (%d bytes) with %d pending scan results to capture",
+		dap->batch_count, dap->batch_len, dap->pending_scan_result_seq_start);
+
+	if (dap->batch_count > 1) {
+		buffer[0] = 0;	/* report number */
+		buffer[1] = CMD_DAP_EXECUTE_COMMANDS;
+		buffer[2] = dap->batch_count;
+		memcpy(buffer + 3, dap->batch_buf, dap->batch_len);
+		txlen = dap->batch_len + 3;
+		/* responses follow the command byte and count */
+		response = buffer + 2;
+	} else {
+		buffer[0] = 0;	/* report number */
+		memcpy(buffer + 1, dap->batch_buf, dap->batch_len);
+		txlen = dap->batch_len + 1;
+		response = buffer;
+	}
+
+#ifdef CMSIS_DAP_JTAG_DEBUG
+	debug_parse_cmsis_buf(buffer, txlen);
+#endif
+
+	int retval = cmsis_dap_usb_xfer(dap, txlen);
+	if (retval == ERROR_OK && dap->batch_count > 1 &&
+			(buffer[0] != CMD_DAP_EXECUTE_COMMANDS || buffer[1] != dap->batch_count))
+		retval = ERROR_FAIL;
+
+	for (int i = 0; i < dap->batch_count && retval == ERROR_OK; i++) {
+		const uint8_t *r = response + dap->batch_resp_offset[i];
+		if (r[0] != dap->batch_cmd[i] || r[1] != DAP_OK) {
+			LOG_ERROR("CMSIS-DAP command 0x%02" PRIx8 " failed.", dap->batch_cmd[i]);
+			retval = ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		/* copy scan results into client buffers */
+		for (int i = 0; i < dap->pending_scan_result_seq_start; ++i) {
+			struct pending_scan_result *scan = &dap->pending_scan_results[i];
+			LOG_DEBUG_IO("Copying pending_scan_result %d/%d: %d bits from byte %d -> buffer + %d bits",
+				i, dap->pending_scan_result_seq_start, scan->length, scan->first, scan->buffer_offset);
+			bit_copy(scan->buffer, scan->buffer_offset, response + scan->first, 0, scan->length);
+		}
+	} else {
+		LOG_ERROR("CMSIS-DAP JTAG command batch failed.");
+		if (dap->queued_retval == ERROR_OK)
+			dap->queued_retval = retval;
+	}
+
+	/* scan results of the still open sequence move to the front */
+	dap->pending_scan_result_count -= dap->pending_scan_result_seq_start;
+	memmove(dap->pending_scan_results,
+		&dap->pending_scan_results[dap->pending_scan_result_seq_start],
+		dap->pending_scan_result_count * sizeof(struct pending_scan_result));
+	dap->pending_scan_result_seq_start = 0;
+
+	/* reset */
+	dap->batch_count = 0;
+	dap->batch_len = 0;
+	dap->batch_resp_len = 0;
+
+	return retval;
+}
+
+/* Add a command of @a len bytes with a response of @a resp_len bytes to
+ * the batch, flushing it first if there is no room left. Returns where
+ * the command is to be encoded, with the command byte already set. */
+static uint8_t *cmsis_dap_batch_add(uint8_t cmd, int len, int resp_len)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (dap->batch_count && (!dap->execute_commands ||
+			dap->batch_count >= MAX_BATCH_COMMANDS ||
+			dap->batch_len + len + 2 > BATCH_BUF_LEN(dap) ||
+			dap->batch_resp_len + resp_len + 2 > BATCH_BUF_LEN(dap)))
+		cmsis_dap_batch_flush();
+
+	uint8_t *buffer = dap->batch_buf + dap->batch_len;
+	buffer[0] = cmd;
+
+	dap->batch_cmd[dap->batch_count] = cmd;
+	dap->batch_resp_offset[dap->batch_count] = dap->batch_resp_len;
+	dap->batch_count++;
+	dap->batch_len += len;
+	dap->batch_resp_len += resp_len;
+
+	return buffer;
+}
+
+/* Move the queued JTAG sequences into the batch as one CMD_DAP_JTAG_SEQ */
+static void cmsis_dap_jtag_seq_close(void)
 {
-	if (!queued_seq_count)
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (!dap->queued_seq_count)
 		return;
 
-	LOG_DEBUG_IO("Flushing %d queued sequences (%d bytes) with %d pending scan results to capture",
-		queued_seq_count, queued_seq_buf_end, pending_scan_result_count);
+	LOG_DEBUG_IO("Batching %d queued sequences (%d bytes)",
+		dap->queued_seq_count, dap->queued_seq_buf_end);
 
-	/* prep CMSIS-DAP packet */
-	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
-	buffer[0] = 0;	/* report number */
-	buffer[1] = CMD_DAP_JTAG_SEQ;
-	buffer[2] = queued_seq_count;
-	memcpy(buffer + 3, queued_seq_buf, queued_seq_buf_end);
+	uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_JTAG_SEQ,
+			dap->queued_seq_buf_end + 2, dap->queued_seq_tdo_ptr + 2);
+	buffer[1] = dap->queued_seq_count;
+	memcpy(buffer + 2, dap->queued_seq_buf, dap->queued_seq_buf_end);
 
-#ifdef CMSIS_DAP_JTAG_DEBUG
-	debug_parse_cmsis_buf(buffer, queued_seq_buf_end + 3);
-#endif
+	/* TDO data follows the command and status bytes of the response */
+	int tdo_offset = dap->batch_resp_offset[dap->batch_count - 1] + 2;
+	for (int i = dap->pending_scan_result_seq_start; i < dap->pending_scan_result_count; ++i)
+		dap->pending_scan_results[i].first += tdo_offset;
+	dap->pending_scan_result_seq_start = dap->pending_scan_result_count;
 
-	/* send command to USB device */
-	int retval = cmsis_dap_usb_xfer(cmsis_dap_handle, queued_seq_buf_end + 3);
-	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
-		LOG_ERROR("CMSIS-DAP command CMD_DAP_JTAG_SEQ failed.");
-		exit(-1);
+	dap->queued_seq_count = 0;
+	dap->queued_seq_buf_end = 0;
+	dap->queued_seq_tdo_ptr = 0;
+}
+
+/* Batch a CMD_DAP_SWJ_SEQ, split into chunks of at most 256 bits */
+static void cmsis_dap_batch_swj_sequence(int s_len, const uint8_t *sequence)
+{
+	cmsis_dap_jtag_seq_close();
+
+	for (int offset = 0; offset < s_len; offset += 256) {
+		int len = MIN(s_len - offset, 256);
+		uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_SWJ_SEQ, DIV_ROUND_UP(len, 8) + 2, 2);
+		buffer[1] = len & 0xff;	/* 0 means 256 */
+		bit_copy(&buffer[2], 0, sequence, offset, len);
 	}
+}
 
-#ifdef CMSIS_DAP_JTAG_DEBUG
-	LOG_DEBUG_IO("USB response buf:");
-	for (int c = 0; c < queued_seq_buf_end + 3; ++c)
-		printf("%02X ", buffer[c]);
-	printf("\n");
-#endif
+static void cmsis_dap_batch_delay(uint16_t delay_us)
+{
+	cmsis_dap_jtag_seq_close();
 
-	/* copy scan results into client buffers */
-	for (int i = 0; i < pending_scan_result_count; ++i) {
-		struct pending_scan_result *scan = &pending_scan_results[i];
-		LOG_DEBUG_IO("Copying pending_scan_result %d/%d: %d bits from byte %d -> buffer + %d bits",
-			i, pending_scan_result_count, scan->length, scan->first + 2, scan->buffer_offset);
-#ifdef CMSIS_DAP_JTAG_DEBUG
-		for (uint32_t b = 0; b < DIV_ROUND_UP(scan->length, 8); ++b)
-			printf("%02X ", buffer[2+scan->first+b]);
-		printf("\n");
-#endif
-		bit_copy(scan->buffer, scan->buffer_offset, buffer + 2 + scan->first, 0, scan->length);
+	uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_DELAY, 3, 2);
+	h_u16_to_le(&buffer[1], delay_us);
+}
+
+static void cmsis_dap_flush(void)
+{
+	cmsis_dap_jtag_seq_close();
+	cmsis_dap_batch_flush();
+}
+
+static void cmsis_dap_execute_sleep(struct jtag_command *cmd)
+{
+	/* short delays are done by the adapter, within the batch */
+	if (cmsis_dap_handle->execute_commands && cmd->cmd.sleep->us <= 0xffff) {
+		cmsis_dap_batch_delay(cmd->cmd.sleep->us);
+		return;
 	}
 
-	/* reset */
-	queued_seq_count = 0;
-	queued_seq_buf_end = 0;
-	queued_seq_tdo_ptr = 0;
-	pending_scan_result_count = 0;
+	cmsis_dap_flush();
+	jtag_sleep(cmd->cmd.sleep->us);
+}
+
+/* Set TMS high for five TCK clocks, to move the TAP to the Test-Logic-Reset state */
+static int cmsis_dap_execute_tlr_reset(struct jtag_command *cmd)
+{
+	LOG_INFO("cmsis-dap JTAG TLR_RESET");
+	uint8_t seq = 0xff;
+	cmsis_dap_batch_swj_sequence(8, &seq);
+	tap_set_state(TAP_RESET);
+	return ERROR_OK;
 }
 
 /* queue a sequence of bits to clock out TDI / in TDO, executing if the buffer is full.
@@ -1302,8 +1890,9 @@ static void cmsis_dap_flush(void)
 static void cmsis_dap_add_jtag_sequence(int s_len, const uint8_t *sequence, int s_offset,
 					bool tms, uint8_t *tdo_buffer, int tdo_buffer_offset)
 {
+	struct cmsis_dap *dap = cmsis_dap_handle;
 	LOG_DEBUG_IO("[at %d] %d bits, tms %s, seq offset %d, tdo buf %p, tdo offset %d",
-		queued_seq_buf_end,
+		dap->queued_seq_buf_end,
 		s_len, tms ? "HIGH" : "LOW", s_offset, tdo_buffer, tdo_buffer_offset);
 
 	if (s_len == 0)
@@ -1330,29 +1919,32 @@ static void cmsis_dap_add_jtag_sequence(int s_len, const uint8_t *sequence, int
 	}
 
 	int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
-	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
+	if (dap->queued_seq_count >= 255 || dap->queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN(dap))
+		/* the sequence is full, move it into the batch */
+		cmsis_dap_jtag_seq_close();
+	if (dap->pending_scan_result_count >= dap->pending_scan_result_max)
 		/* empty out the buffer */
 		cmsis_dap_flush();
 
-	++queued_seq_count;
+	++dap->queued_seq_count;
 
 	/* control byte */
-	queued_seq_buf[queued_seq_buf_end] =
+	dap->queued_seq_buf[dap->queued_seq_buf_end] =
 		(tms ? DAP_JTAG_SEQ_TMS : 0) |
 		(tdo_buffer != NULL ? DAP_JTAG_SEQ_TDO : 0) |
 		(s_len == 64 ? 0 : s_len);
 
 	if (sequence != NULL)
-		bit_copy(&queued_seq_buf[queued_seq_buf_end + 1], 0, sequence, s_offset, s_len);
+		bit_copy(&dap->queued_seq_buf[dap->queued_seq_buf_end + 1], 0, sequence, s_offset, s_len);
 	else
-		memset(&queued_seq_buf[queued_seq_buf_end + 1], 0, DIV_ROUND_UP(s_len, 8));
+		memset(&dap->queued_seq_buf[dap->queued_seq_buf_end + 1], 0, DIV_ROUND_UP(s_len, 8));
 
-	queued_seq_buf_end += cmd_len;
+	dap->queued_seq_buf_end += cmd_len;
 
 	if (tdo_buffer != NULL) {
-		struct pending_scan_result *scan = &pending_scan_results[pending_scan_result_count++];
-		scan->first = queued_seq_tdo_ptr;
-		queued_seq_tdo_ptr += DIV_ROUND_UP(s_len, 8);
+		struct pending_scan_result *scan = &dap->pending_scan_results[dap->pending_scan_result_count++];
+		scan->first = dap->queued_seq_tdo_ptr;
+		dap->queued_seq_tdo_ptr += DIV_ROUND_UP(s_len, 8);
 		scan->length = s_len;
 		scan->buffer = tdo_buffer;
 		scan->buffer_offset = tdo_buffer_offset;
@@ -1366,11 +1958,15 @@ static void cmsis_dap_add_tms_sequence(const uint8_t *sequence, int s_len)
 	/* we use a series of CMD_DAP_JTAG_SEQ commands to toggle TMS,
 	   because even though it seems ridiculously inefficient, it
 	   allows us to combine TMS and scan sequences into the same
-	   USB packet. */
-	/* TODO: combine runs of the same tms value */
-	for (int i = 0; i < s_len; ++i) {
+	   USB packet. Runs of the same TMS value share one sequence. */
+	for (int i = 0; i < s_len;) {
 		bool bit = (sequence[i / 8] & (1 << (i % 8))) != 0;
-		cmsis_dap_add_jtag_sequence(1, NULL, 0, bit, NULL, 0);
+		int len = 1;
+		while (i + len < s_len && len < 64 &&
+				((sequence[(i + len) / 8] & (1 << ((i + len) % 8))) != 0) == bit)
+			len++;
+		cmsis_dap_add_jtag_sequence(len, NULL, 0, bit, NULL, 0);
+		i += len;
 	}
 }
 
@@ -1573,7 +2169,7 @@ static void cmsis_dap_execute_stableclocks(struct jtag_command *cmd)
 static void cmsis_dap_execute_tms(struct jtag_command *cmd)
 {
 	LOG_DEBUG_IO("TMS: %d bits", cmd->cmd.tms->num_bits);
-	cmsis_dap_cmd_DAP_SWJ_Sequence(cmd->cmd.tms->num_bits, cmd->cmd.tms->bits);
+	cmsis_dap_batch_swj_sequence(cmd->cmd.tms->num_bits, cmd->cmd.tms->bits);
 }
 
 /* TODO: Is there need to call cmsis_dap_flush() for the JTAG_PATHMOVE,
@@ -1582,11 +2178,9 @@ static void cmsis_dap_execute_command(struct jtag_command *cmd)
 {
 	switch (cmd->type) {
 		case JTAG_SLEEP:
-			cmsis_dap_flush();
 			cmsis_dap_execute_sleep(cmd);
 			break;
 		case JTAG_TLR_RESET:
-			cmsis_dap_flush();
 			cmsis_dap_execute_tlr_reset(cmd);
 			break;
 		case JTAG_SCAN:
@@ -1621,12 +2215,15 @@ static int cmsis_dap_execute_queue(void)
 
 	cmsis_dap_flush();
 
-	return ERROR_OK;
+	int retval = cmsis_dap_handle->queued_retval;
+	cmsis_dap_handle->queued_retval = ERROR_OK;
+
+	return retval;
 }
 
 static int cmsis_dap_speed(int speed)
 {
-	if (speed > DAP_MAX_CLOCK)
+	if (speed > DAP_MAX_CLOCK && !jtag_get_speed_auto_max_khz())
 		LOG_INFO("High speed (adapter speed %d) may be limited by adapter firmware.", speed);
 
 	if (speed == 0) {
@@ -1732,6 +2329,62 @@ COMMAND_HANDLER(cmsis_dap_handle_serial_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_stats_command)
+{
+	struct cmsis_dap_stats *stats = &cmsis_dap_handle->stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	uint64_t capacity = stats->packets * BATCH_BUF_LEN(cmsis_dap_handle);
+
+	command_print(CMD, "packets:      %" PRIu64 " of %d bytes", stats->packets,
+			BATCH_BUF_LEN(cmsis_dap_handle));
+	if (!stats->packets)
+		return ERROR_OK;
+
+	command_print(CMD, "transfers:    %" PRIu64 ", %.1f per packet", stats->transfers,
+			(double)stats->transfers / stats->packets);
+	command_print(CMD, "request fill: %.1f%% (%" PRIu64 " bytes)",
+			100.0 * stats->request_bytes / capacity, stats->request_bytes);
+	if (stats->responses)
+		command_print(CMD, "reply fill:   %.1f%% (%" PRIu64 " bytes)",
+				100.0 * stats->response_bytes /
+					(stats->responses * BATCH_BUF_LEN(cmsis_dap_handle)),
+				stats->response_bytes);
+	command_print(CMD, "WAIT:         %" PRIu64, stats->waits);
+	command_print(CMD, "FAULT:        %" PRIu64, stats->faults);
+	command_print(CMD, "other errors: %" PRIu64, stats->errors - stats->waits - stats->faults);
+
+	uint64_t round_trips = 0;
+	for (int i = 0; i < STATS_LATENCY_BUCKETS; i++)
+		round_trips += stats->latency[i];
+	if (!round_trips)
+		return ERROR_OK;
+
+	command_print(CMD, "round trip:   %" PRIu64 " us average, %" PRIu64 " us max",
+			stats->latency_us_total / round_trips, stats->latency_us_max);
+	for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+		if (!stats->latency[i])
+			continue;
+		unsigned long low = i ? 1UL << i : 0;
+		if (i == STATS_LATENCY_BUCKETS - 1)
+			command_print(CMD, "  >= %lu us: %" PRIu64, low, stats->latency[i]);
+		else
+			command_print(CMD, "  %lu - %lu us: %" PRIu64, low, (1UL << (i + 1)) - 1,
+					stats->latency[i]);
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -1747,6 +2400,13 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.usage = "",
 		.help = "issue cmsis-dap command",
 	},
+	{
+		.name = "stats",
+		.handler = &cmsis_dap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "show or reset SWD transfer queue statistics",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1801,6 +2461,8 @@ struct adapter_driver cmsis_dap_adapter_driver = {
 	.speed = cmsis_dap_speed,
 	.khz = cmsis_dap_khz,
 	.speed_div = cmsis_dap_speed_div,
+	.config_trace = cmsis_dap_config_trace,
+	.poll_trace = cmsis_dap_poll_trace,
 
 	.jtag_ops = &cmsis_dap_interface,
 	.swd_ops = &cmsis_dap_swd_driver,
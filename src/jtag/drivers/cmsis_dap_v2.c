@@ -25,220 +25,3736 @@
 #include <jtag/commands.h>
 #include <jtag/swd.h>
 #include <jtag/tcl.h>
-#include <libusb.h>
+#include <target/arm_adi_v5.h>
+#include <target/cortex_m.h>
+#include <helper/time_support.h>
+#include <helper/perf.h>
+
+#include "libusb_helper.h"
+#include "jtag_usb_common.h"
+
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define CMSIS_DAP_USB_THREAD
+#include <pthread.h>
+#endif
+
+/*
+ * See CMSIS-DAP documentation:
+ * Version 2.0 - USB bulk endpoints instead of HID reports.
+ *
+ * A CMSIS-DAP v2 debug unit exposes a vendor specific interface whose
+ * interface string contains "CMSIS-DAP". The first endpoint is a bulk
+ * OUT endpoint carrying commands, the second one is a bulk IN endpoint
+ * carrying responses and an optional third bulk IN endpoint carries SWO
+ * trace data. Unlike the HID transport there is no report number in
+ * front of the command byte.
+ */
+
+#define MAX_USB_IDS 8
+/* vid = pid = 0 marks the end of the list */
+static uint16_t cmsis_dap_vid[MAX_USB_IDS + 1] = { 0 };
+static uint16_t cmsis_dap_pid[MAX_USB_IDS + 1] = { 0 };
+/* A list of serials lets several OpenOCD instances share one
+ * configuration for a gang of probes: each instance uses the first
+ * listed probe which is not claimed by another one already. */
+#define MAX_USB_SERIALS 16
+static char *cmsis_dap_serial[MAX_USB_SERIALS + 1];
+static bool swd_mode;
+static bool cmsis_dap_usb_thread_enabled;
+static bool cmsis_dap_reconnect_enabled = true;
+
+/* default packet size of a high-speed bulk endpoint */
+#define PACKET_SIZE       512
+#define USB_TIMEOUT       1000
+
+/* CMSIS-DAP General Commands */
+#define CMD_DAP_INFO              0x00
+#define CMD_DAP_LED               0x01
+#define CMD_DAP_CONNECT           0x02
+#define CMD_DAP_DISCONNECT        0x03
+#define CMD_DAP_WRITE_ABORT       0x08
+#define CMD_DAP_DELAY             0x09
+#define CMD_DAP_RESET_TARGET      0x0A
+#define CMD_DAP_EXECUTE_COMMANDS  0x7F
+
+/* CMD_INFO */
+#define INFO_ID_VENDOR            0x01      /* string */
+#define INFO_ID_PRODUCT           0x02      /* string */
+#define INFO_ID_SERNUM            0x03      /* string */
+#define INFO_ID_FW_VER            0x04      /* string */
+#define INFO_ID_TD_VEND           0x05      /* string */
+#define INFO_ID_TD_NAME           0x06      /* string */
+#define INFO_ID_CAPS              0xf0      /* byte */
+#define INFO_ID_SWO_BUF_SZ        0xfd      /* word */
+#define INFO_ID_PKT_CNT           0xfe      /* byte */
+#define INFO_ID_PKT_SZ            0xff      /* short */
+
+#define INFO_CAPS_SWD             0x01
+#define INFO_CAPS_JTAG            0x02
+#define INFO_CAPS_SWO_UART        0x04
+#define INFO_CAPS_SWO_MANCHESTER  0x08
+#define INFO_CAPS_ATOMIC_CMDS     0x10
+#define INFO_CAPS_TEST_DOMAIN_TIMER 0x20
+#define INFO_CAPS_SWO_STREAMING   0x40
+
+/* CMD_LED */
+#define LED_ID_CONNECT            0x00
+#define LED_ID_RUN                0x01
+
+#define LED_OFF                   0x00
+#define LED_ON                    0x01
+
+/* CMD_CONNECT */
+#define CONNECT_DEFAULT           0x00
+#define CONNECT_SWD               0x01
+#define CONNECT_JTAG              0x02
+
+/* CMSIS-DAP Common SWD/JTAG Commands */
+#define CMD_DAP_SWJ_PINS          0x10
+#define CMD_DAP_SWJ_CLOCK         0x11
+#define CMD_DAP_SWJ_SEQ           0x12
+
+/*
+ * PINS
+ * Bit 0: SWCLK/TCK
+ * Bit 1: SWDIO/TMS
+ * Bit 2: TDI
+ * Bit 3: TDO
+ * Bit 5: nTRST
+ * Bit 7: nRESET
+ */
+
+#define SWJ_PIN_TCK               (1<<0)
+#define SWJ_PIN_TMS               (1<<1)
+#define SWJ_PIN_TDI               (1<<2)
+#define SWJ_PIN_TDO               (1<<3)
+#define SWJ_PIN_TRST              (1<<5)
+#define SWJ_PIN_SRST              (1<<7)
+
+/* CMSIS-DAP SWD Commands */
+#define CMD_DAP_SWD_CONFIGURE     0x13
+
+/* CMSIS-DAP JTAG Commands */
+#define CMD_DAP_JTAG_SEQ          0x14
+#define CMD_DAP_JTAG_CONFIGURE    0x15
+#define CMD_DAP_JTAG_IDCODE       0x16
+
+/* CMSIS-DAP JTAG sequence info masks */
+/* Number of bits to clock through (0 means 64) */
+#define DAP_JTAG_SEQ_TCK          0x3F
+/* TMS will be set during the sequence if this bit is set */
+#define DAP_JTAG_SEQ_TMS          0x40
+/* TDO output will be captured if this bit is set */
+#define DAP_JTAG_SEQ_TDO          0x80
+
+/* CMSIS-DAP Transfer Commands */
+#define CMD_DAP_TFER_CONFIGURE    0x04
+#define CMD_DAP_TFER              0x05
+#define CMD_DAP_TFER_BLOCK        0x06
+#define CMD_DAP_TFER_ABORT        0x07
+
+/* DAP_Transfer request bits besides APnDP, RnW and A[3:2] */
+#define DAP_TFER_MATCH_VALUE      0x10
+#define DAP_TFER_MATCH_MASK       0x20
+/* DAP_Transfer response bit of a read whose value did not match */
+#define DAP_TFER_MISMATCH         0x10
+
+/* reads of a value match read before the adapter gives up, some ms
+ * at usual SWD clocks, well below USB_TIMEOUT */
+#define MATCH_RETRY               1024
+
+/* The adapter retries a transfer answered with WAIT for about
+ * WAIT_RETRY_MS, a retry takes some WAIT_RETRY_CLOCKS clocks. A WAIT
+ * which remains is sent again from the host up to WAIT_RESUBMIT_MAX
+ * times. */
+#define WAIT_RETRY_MS             20
+#define WAIT_RETRY_CLOCKS         46
+#define WAIT_RETRY_MIN            64
+#define WAIT_RESUBMIT_MAX         8
+
+/* CMSIS-DAP SWO Commands */
+#define CMD_DAP_SWO_TRANSPORT     0x17
+#define CMD_DAP_SWO_MODE          0x18
+#define CMD_DAP_SWO_BAUDRATE      0x19
+#define CMD_DAP_SWO_CONTROL       0x1A
+#define CMD_DAP_SWO_STATUS        0x1B
+#define CMD_DAP_SWO_DATA          0x1C
+
+#define DAP_SWO_TRANSPORT_NONE    0x00
+#define DAP_SWO_TRANSPORT_DATA    0x01      /* read with CMD_DAP_SWO_DATA */
+#define DAP_SWO_TRANSPORT_STREAM  0x02      /* dedicated bulk IN endpoint */
+
+#define DAP_SWO_MODE_OFF          0x00
+#define DAP_SWO_MODE_UART         0x01
+#define DAP_SWO_MODE_MANCHESTER   0x02
+
+#define DAP_SWO_CONTROL_STOP      0x00
+#define DAP_SWO_CONTROL_START     0x01
+
+#define DAP_SWO_STATUS_CAPTURE    0x01
+#define DAP_SWO_STATUS_ERROR      0x40
+#define DAP_SWO_STATUS_OVERRUN    0x80
+
+/* SWO stream: bulk IN transfers kept in flight on the trace endpoint,
+ * and the ring buffer they are copied into until poll_trace() runs */
+#define SWO_TRANSFER_COUNT        4
+#define SWO_TRANSFER_SIZE         (16 * 1024)
+#define SWO_RING_SIZE             (1024 * 1024)
+
+/* events of the USB thread are handled in rounds of at most this long,
+ * so that it notices when it has to stop */
+#define USB_THREAD_POLL_MS        50
+
+/* A lost adapter is looked for again at most every RECONNECT_INTERVAL_MS.
+ * With hotplug events only once one of the adapter's VID:PID arrived,
+ * or every RECONNECT_HOTPLUG_MS in case the event was missed. */
+#define RECONNECT_INTERVAL_MS     100
+#define RECONNECT_HOTPLUG_MS      1000
+
+/* DAP Status Code */
+#define DAP_OK                    0
+#define DAP_ERROR                 0xFF
+
+static const char * const info_caps_str[] = {
+	"SWD  Supported",
+	"JTAG Supported",
+	"SWO-UART Supported",
+	"SWO-MANCHESTER Supported",
+	"Atomic commands Supported",
+	"Test domain timer Supported",
+	"SWO streaming trace Supported"
+};
+
+/* max clock speed (kHz) */
+#define DAP_MAX_CLOCK             10000
+
+struct pending_transfer_result {
+	uint8_t cmd;
+	/** Read with value match, the response carries no data */
+	bool match;
+	void *buffer;
+};
+
+/* latency histogram bucket n counts round trips of 2^n to 2^(n+1) - 1 us,
+ * the last bucket everything slower */
+#define STATS_LATENCY_BUCKETS 20
+
+/* host side counters of the SWD transfer queue, see "cmsis-dap stats" */
+struct cmsis_dap_stats {
+	uint64_t packets;
+	uint64_t request_bytes;
+	/* replies parsed, and their bytes */
+	uint64_t responses;
+	uint64_t response_bytes;
+	uint64_t transfers;
+	uint64_t waits;
+	uint64_t resubmits;
+	uint64_t faults;
+	uint64_t errors;
+	uint64_t reconnects;
+	uint64_t latency_us_total;
+	uint64_t latency_us_max;
+	uint64_t latency[STATS_LATENCY_BUCKETS];
+};
+
+struct pending_request_block {
+	/** Read destinations. While block_transfer is set only transfers[0].cmd
+	 * is valid, the command applies to all transfers of the block. */
+	struct pending_transfer_result *transfers;
+	int transfer_count;
+	/** All transfers access the same register, send as DAP_TransferBlock */
+	bool block_transfer;
+	/** Bytes of the request encoded in command so far */
+	int command_len;
+	/** Time from sending the request until the response arrived */
+	struct duration round_trip;
+	/** DAP_Transfer or DAP_TransferBlock request, encoded as the
+	 * transfers are queued, the count is filled in when it is sent */
+	uint8_t *command;
+	/** DAP_Transfer response filled in by the IN transfer */
+	uint8_t *response;
+	struct libusb_transfer *transfer_out;
+	struct libusb_transfer *transfer_in;
+	int completed_out;
+	int completed_in;
+	/** Times the transfers left after a WAIT were sent again */
+	int wait_resubmits;
+};
+
+struct pending_scan_result {
+	/** Offset in bytes in the CMD_DAP_JTAG_SEQ response buffer. */
+	unsigned first;
+	/** Number of bits to read. */
+	unsigned length;
+	/** Location to store the result */
+	uint8_t *buffer;
+	/** Offset in the destination buffer */
+	unsigned buffer_offset;
+};
+
+/* DAP_ExecuteCommands carries an 8 bit command count */
+#define MAX_BATCH_COMMANDS 255
+
+struct cmsis_dap {
+	struct libusb_context *usb_ctx;
+	struct libusb_device_handle *dev_handle;
+	int interface;
+	unsigned int ep_out;
+	unsigned int ep_in;
+	/* SWO trace endpoint, 0 when the interface has none */
+	unsigned int ep_swo;
+	uint16_t packet_size;
+	int packet_count;
+	uint8_t *packet_buffer;
+	uint8_t caps;
+	uint8_t mode;
+
+	/* Pending requests are organized as a FIFO - circular buffer.
+	 * Up to packet_count requests, as reported by INFO_ID_PKT_CNT, are
+	 * submitted as asynchronous libusb transfers before the first response
+	 * has to be collected, so encoding of the next request overlaps the USB
+	 * round trip of the previous ones. */
+	/* Each block in FIFO can contain up to pending_queue_len transfers,
+	 * or up to pending_block_len transfers of the same register */
+	int pending_queue_len;
+	int pending_block_len;
+	struct pending_request_block *pending_fifo;
+	int pending_fifo_put_idx, pending_fifo_get_idx;
+	int pending_fifo_block_count;
+	/* value of the previous read, used to imitate posted AP reads */
+	uint32_t last_read;
+
+	/* pointers to buffers that will receive jtag scan results on the next flush */
+	int pending_scan_result_count;
+	int pending_scan_result_max;
+	struct pending_scan_result *pending_scan_results;
+
+	/* queued JTAG sequences that will be executed on the next flush */
+	int queued_seq_count;
+	int queued_seq_buf_end;
+	int queued_seq_tdo_ptr;
+	uint8_t *queued_seq_buf;
+
+	/* JTAG commands batched for the next flush, sent as one
+	 * DAP_ExecuteCommands request if the adapter supports it */
+	bool execute_commands;
+	uint8_t *batch_buf;
+	int batch_len;
+	int batch_count;
+	int batch_resp_len;
+	uint8_t batch_cmd[MAX_BATCH_COMMANDS];
+	uint16_t batch_resp_offset[MAX_BATCH_COMMANDS];
+	/* scan results from here on belong to the still open sequence */
+	int pending_scan_result_seq_start;
+
+	int queued_retval;
+
+	struct cmsis_dap_stats stats;
+
+	uint8_t output_pins;
+
+	/* DP/AP transactions are queued by the dap_ops backend, which
+	 * takes the read values as the adapter returns them instead of
+	 * imitating posted AP reads */
+	bool dapdirect;
+	/* position of the DAP in the JTAG chain, sent as DAP Index */
+	uint8_t jtag_index;
+
+	/* SWO trace capture. In DAP_SWO_TRANSPORT_STREAM mode the stream
+	 * transfers are serviced by every libusb event loop run, including
+	 * the ones waiting for DAP_Transfer responses, so capture goes on
+	 * while the SWD queue is busy. */
+	bool trace_enabled;
+	uint8_t trace_transport;
+	struct libusb_transfer *trace_transfers[SWO_TRANSFER_COUNT];
+	int trace_transfers_active;
+	uint8_t *trace_ring;
+	/* single producer (the stream callback), single consumer (poll_trace),
+	 * accessed atomically as the callback may run in the USB thread */
+	size_t trace_ring_head, trace_ring_tail;
+	bool trace_overrun;
+	/* status of a failed stream transfer, reported by poll_trace */
+	int trace_error;
+
+#ifdef CMSIS_DAP_USB_THREAD
+	/* With "cmsis_dap_usb_thread on" the libusb events are handled by a
+	 * thread of its own: transfers complete and the SWO stream is
+	 * resubmitted while the main thread serves GDB and Tcl or encodes
+	 * the next request. The main thread still submits the transfers;
+	 * waiting for them in libusb_handle_events_completed() then defers
+	 * to the event handling of the USB thread. */
+	pthread_t usb_thread;
+	bool usb_thread_running;
+	bool usb_thread_stop;
+#endif
+
+	/* The adapter was unplugged or reset, see cmsis_dap_usb_reconnect().
+	 * dev_handle is NULL until it is found again. */
+	bool device_lost;
+	char *serial;
+	uint16_t vid, pid;
+	int64_t reconnect_last_ms;
+	bool hotplug;
+	/* accessed atomically, set by the hotplug callback */
+	bool device_arrived;
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+	libusb_hotplug_callback_handle hotplug_handle;
+#endif
+};
+
+#define QUEUED_SEQ_BUF_LEN(dap) ((dap)->packet_size - 2)
+/* longest request or response */
+#define BATCH_BUF_LEN(dap) ((dap)->packet_size)
+
+static struct cmsis_dap *cmsis_dap_handle;
+
+static bool cmsis_dap_usb_match_ids(const struct libusb_device_descriptor *desc)
+{
+	/* no ids given, any device may be a CMSIS-DAP v2 unit */
+	if (cmsis_dap_vid[0] == 0 && cmsis_dap_pid[0] == 0)
+		return true;
+
+	for (int i = 0; cmsis_dap_vid[i] || cmsis_dap_pid[i]; i++) {
+		if (cmsis_dap_vid[i] == desc->idVendor && cmsis_dap_pid[i] == desc->idProduct)
+			return true;
+	}
+
+	return false;
+}
+
+#ifdef HAVE_LIBUSB_GET_PORT_NUMBERS
+static bool cmsis_dap_usb_location_equal(struct libusb_device *dev)
+{
+	uint8_t port_path[7];
+
+	int path_len = libusb_get_port_numbers(dev, port_path, sizeof(port_path));
+	if (path_len < 0)
+		return false;
+
+	return jtag_usb_location_equal(libusb_get_bus_number(dev), port_path, path_len);
+}
+
+/* Devices of different libusb contexts are different objects, compare
+ * where they are plugged in */
+static bool cmsis_dap_usb_same_device(struct libusb_device *a, struct libusb_device *b)
+{
+	uint8_t path_a[7], path_b[7];
+
+	if (libusb_get_bus_number(a) != libusb_get_bus_number(b))
+		return false;
+
+	int len_a = libusb_get_port_numbers(a, path_a, sizeof(path_a));
+	int len_b = libusb_get_port_numbers(b, path_b, sizeof(path_b));
+	if (len_a < 0 || len_b < 0)
+		return libusb_get_device_address(a) == libusb_get_device_address(b);
+
+	return len_a == len_b && !memcmp(path_a, path_b, len_a);
+}
+#else
+static bool cmsis_dap_usb_location_equal(struct libusb_device *dev)
+{
+	return true;
+}
+
+static bool cmsis_dap_usb_same_device(struct libusb_device *a, struct libusb_device *b)
+{
+	return libusb_get_bus_number(a) == libusb_get_bus_number(b) &&
+		libusb_get_device_address(a) == libusb_get_device_address(b);
+}
+#endif
+
+/* Read a string descriptor into @a str, returns false if there is none */
+static bool cmsis_dap_usb_get_string(struct libusb_device_handle *dev_handle,
+		uint8_t index, char *str, int len)
+{
+	if (index == 0)
+		return false;
+
+	int retval = libusb_get_string_descriptor_ascii(dev_handle, index,
+			(unsigned char *)str, len - 1);
+	if (retval < 0)
+		return false;
+
+	str[retval] = '\0';
+	return true;
+}
+
+/* Look for the vendor specific CMSIS-DAP interface of an opened device */
+static bool cmsis_dap_usb_find_interface(struct libusb_device_handle *dev_handle,
+		bool product_match, int *interface, unsigned int *ep_out, unsigned int *ep_in,
+		unsigned int *ep_swo, uint16_t *packet_size)
+{
+	struct libusb_config_descriptor *config;
+	bool found = false;
+
+	if (libusb_get_active_config_descriptor(libusb_get_device(dev_handle), &config) != 0)
+		return false;
+
+	for (int i = 0; i < config->bNumInterfaces && !found; i++) {
+		const struct libusb_interface_descriptor *intf = &config->interface[i].altsetting[0];
+
+		if (intf->bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC || intf->bNumEndpoints < 2)
+			continue;
+
+		const struct libusb_endpoint_descriptor *out = &intf->endpoint[0];
+		const struct libusb_endpoint_descriptor *in = &intf->endpoint[1];
+
+		if ((out->bmAttributes & 0x03) != LIBUSB_TRANSFER_TYPE_BULK ||
+				(out->bEndpointAddress & LIBUSB_ENDPOINT_IN))
+			continue;
+		if ((in->bmAttributes & 0x03) != LIBUSB_TRANSFER_TYPE_BULK ||
+				!(in->bEndpointAddress & LIBUSB_ENDPOINT_IN))
+			continue;
+
+		/* The CMSIS-DAP specification stipulates that the interface
+		 * string contains "CMSIS-DAP". Some early v2 firmwares only put
+		 * it into the product string, accept them as well. */
+		char intf_str[256];
+		bool intf_match = cmsis_dap_usb_get_string(dev_handle, intf->iInterface,
+				intf_str, sizeof(intf_str)) && strstr(intf_str, "CMSIS-DAP");
+
+		if (!intf_match && !product_match)
+			continue;
+
+		*interface = intf->bInterfaceNumber;
+		*ep_out = out->bEndpointAddress;
+		*ep_in = in->bEndpointAddress;
+		*packet_size = in->wMaxPacketSize;
+		found = true;
+
+		/* the optional third endpoint streams SWO trace data */
+		*ep_swo = 0;
+		if (intf->bNumEndpoints >= 3) {
+			const struct libusb_endpoint_descriptor *swo = &intf->endpoint[2];
+
+			if ((swo->bmAttributes & 0x03) == LIBUSB_TRANSFER_TYPE_BULK &&
+					(swo->bEndpointAddress & LIBUSB_ENDPOINT_IN))
+				*ep_swo = swo->bEndpointAddress;
+		}
+	}
+
+	libusb_free_config_descriptor(config);
+	return found;
+}
+
+/*
+ * Open @a dev if it is a CMSIS-DAP v2 unit with the @a serial (any when
+ * NULL), returns its serial string, if any, in @a serial_str.
+ */
+static bool cmsis_dap_usb_open_device(struct libusb_device *dev, const char *serial,
+		struct libusb_device_handle **dev_handle, char *serial_str, int len, int *interface,
+		unsigned int *ep_out, unsigned int *ep_in, unsigned int *ep_swo, uint16_t *packet_size)
+{
+	struct libusb_device_descriptor desc;
+	bool ids_given = cmsis_dap_vid[0] || cmsis_dap_pid[0];
+
+	if (libusb_get_device_descriptor(dev, &desc) != LIBUSB_SUCCESS)
+		return false;
+
+	if (!cmsis_dap_usb_match_ids(&desc))
+		return false;
+
+	if (jtag_usb_get_location() && !cmsis_dap_usb_location_equal(dev))
+		return false;
+
+	if (libusb_open(dev, dev_handle) != LIBUSB_SUCCESS) {
+		LOG_DEBUG("unable to open USB device 0x%04x:0x%04x",
+			desc.idVendor, desc.idProduct);
+		*dev_handle = NULL;
+		return false;
+	}
+
+	if (!cmsis_dap_usb_get_string(*dev_handle, desc.iSerialNumber, serial_str, len))
+		serial_str[0] = '\0';
+
+	if (serial != NULL && strcmp(serial, serial_str) != 0)
+		goto close;
+
+	/* if the user has specified VID:PID any vendor interface with
+	 * two bulk endpoints is considered as a CMSIS-DAP v2 one */
+	char str[256];
+	bool product_match = ids_given ||
+		(cmsis_dap_usb_get_string(*dev_handle, desc.iProduct, str, sizeof(str)) &&
+		 strstr(str, "CMSIS-DAP"));
+
+	if (cmsis_dap_usb_find_interface(*dev_handle, product_match,
+			interface, ep_out, ep_in, ep_swo, packet_size)) {
+		LOG_DEBUG("found CMSIS-DAP v2 device 0x%04x:0x%04x interface %d",
+			desc.idVendor, desc.idProduct, *interface);
+		return true;
+	}
+
+close:
+	libusb_close(*dev_handle);
+	*dev_handle = NULL;
+	return false;
+}
+
+/*
+ * Find a free CMSIS-DAP v2 unit with one of the NULL terminated @a serials,
+ * tried in the order given, any serial when serials[0] is NULL, and claim
+ * its interface.
+ */
+static struct libusb_device_handle *cmsis_dap_usb_claim(struct libusb_context *ctx,
+		char * const *serials, char *serial_str, int len, int *interface,
+		unsigned int *ep_out, unsigned int *ep_in, unsigned int *ep_swo, uint16_t *packet_size)
+{
+	struct libusb_device **devs;
+	struct libusb_device_handle *dev_handle = NULL;
+
+	ssize_t num_devs = libusb_get_device_list(ctx, &devs);
+	if (num_devs < 0) {
+		LOG_ERROR("unable to get the list of USB devices");
+		return NULL;
+	}
+
+	/* a probe whose interface is claimed by another instance is skipped */
+	for (int s = 0; dev_handle == NULL && (s == 0 || serials[s] != NULL); s++) {
+		for (ssize_t i = 0; i < num_devs; i++) {
+			if (!cmsis_dap_usb_open_device(devs[i], serials[s], &dev_handle,
+					serial_str, len, interface, ep_out, ep_in, ep_swo, packet_size))
+				continue;
+
+			int err = libusb_claim_interface(dev_handle, *interface);
+			if (err == LIBUSB_SUCCESS)
+				break;
+
+			if (err == LIBUSB_ERROR_BUSY)
+				LOG_DEBUG("CMSIS-DAP v2 device %s is in use", serial_str);
+			else
+				LOG_ERROR("unable to claim interface %d: %s", *interface,
+					libusb_error_name(err));
+			libusb_close(dev_handle);
+			dev_handle = NULL;
+		}
+	}
+
+	libusb_free_device_list(devs, 1);
+	return dev_handle;
+}
+
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+static LIBUSB_CALL int cmsis_dap_hotplug_cb(struct libusb_context *ctx,
+		struct libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+	struct cmsis_dap *dap = user_data;
+
+	/* may run in the USB thread, only flags are set here */
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+		__atomic_store_n(&dap->device_arrived, true, __ATOMIC_SEQ_CST);
+	else if (dap->dev_handle && dev == libusb_get_device(dap->dev_handle))
+		__atomic_store_n(&dap->device_lost, true, __ATOMIC_SEQ_CST);
+
+	return 0;
+}
+
+static void cmsis_dap_hotplug_register(struct cmsis_dap *dap)
+{
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+		return;
+
+	int err = libusb_hotplug_register_callback(dap->usb_ctx,
+			LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+			0, dap->vid, dap->pid, LIBUSB_HOTPLUG_MATCH_ANY,
+			cmsis_dap_hotplug_cb, dap, &dap->hotplug_handle);
+	dap->hotplug = err == LIBUSB_SUCCESS;
+}
+
+static void cmsis_dap_hotplug_deregister(struct cmsis_dap *dap)
+{
+	if (dap->hotplug)
+		libusb_hotplug_deregister_callback(dap->usb_ctx, dap->hotplug_handle);
+	dap->hotplug = false;
+}
+#else
+static void cmsis_dap_hotplug_register(struct cmsis_dap *dap)
+{
+}
+
+static void cmsis_dap_hotplug_deregister(struct cmsis_dap *dap)
+{
+}
+#endif
+
+static int cmsis_dap_usb_open(void)
+{
+	struct libusb_context *ctx;
+	struct libusb_device_handle *dev_handle = NULL;
+	int interface = -1;
+	unsigned int ep_out = 0, ep_in = 0, ep_swo = 0;
+	uint16_t packet_size = PACKET_SIZE;
+	char serial_str[256];
+
+	if (libusb_init(&ctx) != LIBUSB_SUCCESS) {
+		LOG_ERROR("unable to initialize libusb");
+		return ERROR_FAIL;
+	}
+
+	dev_handle = cmsis_dap_usb_claim(ctx, cmsis_dap_serial, serial_str,
+			sizeof(serial_str), &interface, &ep_out, &ep_in, &ep_swo, &packet_size);
+
+	if (dev_handle == NULL) {
+		LOG_ERROR("unable to find a free CMSIS-DAP v2 device");
+		libusb_exit(ctx);
+		return ERROR_FAIL;
+	}
+
+	if (serial_str[0])
+		LOG_INFO("CMSIS-DAP v2: using the device with serial %s", serial_str);
+
+	struct cmsis_dap *dap = calloc(1, sizeof(struct cmsis_dap));
+	if (dap == NULL) {
+		LOG_ERROR("unable to allocate memory");
+		libusb_release_interface(dev_handle, interface);
+		libusb_close(dev_handle);
+		libusb_exit(ctx);
+		return ERROR_FAIL;
+	}
+
+	dap->usb_ctx = ctx;
+	dap->dev_handle = dev_handle;
+	dap->interface = interface;
+	dap->ep_out = ep_out;
+	dap->ep_in = ep_in;
+	dap->ep_swo = ep_swo;
+	dap->output_pins = SWJ_PIN_SRST | SWJ_PIN_TRST;
+	if (serial_str[0])
+		dap->serial = strdup(serial_str);
+
+	struct libusb_device_descriptor desc;
+	if (libusb_get_device_descriptor(libusb_get_device(dev_handle), &desc) == LIBUSB_SUCCESS) {
+		dap->vid = desc.idVendor;
+		dap->pid = desc.idProduct;
+	}
+	cmsis_dap_hotplug_register(dap);
+
+	cmsis_dap_handle = dap;
+
+	/* allocate default packet buffer, changed later to the size
+	 * reported by INFO_ID_PKT_SZ */
+	cmsis_dap_handle->packet_buffer = malloc(packet_size);
+	cmsis_dap_handle->packet_size = packet_size;
+
+	if (cmsis_dap_handle->packet_buffer == NULL) {
+		LOG_ERROR("unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+#ifdef CMSIS_DAP_USB_THREAD
+static void *cmsis_dap_usb_thread(void *arg)
+{
+	struct cmsis_dap *dap = arg;
+
+	/* runs the transfer callbacks only, without logging: the
+	 * log is not thread safe */
+	while (!__atomic_load_n(&dap->usb_thread_stop, __ATOMIC_SEQ_CST)) {
+		struct timeval tv = { 0, USB_THREAD_POLL_MS * 1000 };
+		int err = libusb_handle_events_timeout_completed(dap->usb_ctx, &tv, NULL);
+		if (err < 0 && err != LIBUSB_ERROR_INTERRUPTED && err != LIBUSB_ERROR_TIMEOUT)
+			break;
+	}
+
+	return NULL;
+}
+
+static void cmsis_dap_usb_thread_start(struct cmsis_dap *dap)
+{
+	dap->usb_thread_stop = false;
+	if (pthread_create(&dap->usb_thread, NULL, cmsis_dap_usb_thread, dap) != 0) {
+		LOG_WARNING("unable to start the USB thread, handling USB events inline");
+		return;
+	}
+	dap->usb_thread_running = true;
+	LOG_DEBUG("CMSIS-DAP v2: USB events are handled by a thread");
+}
+
+static void cmsis_dap_usb_thread_stop(struct cmsis_dap *dap)
+{
+	if (!dap->usb_thread_running)
+		return;
+
+	__atomic_store_n(&dap->usb_thread_stop, true, __ATOMIC_SEQ_CST);
+	pthread_join(dap->usb_thread, NULL);
+	dap->usb_thread_running = false;
+}
+
+static bool cmsis_dap_usb_thread_active(struct cmsis_dap *dap)
+{
+	return dap->usb_thread_running;
+}
+#else
+static void cmsis_dap_usb_thread_start(struct cmsis_dap *dap)
+{
+	LOG_WARNING("no USB thread support in this build, handling USB events inline");
+}
+
+static void cmsis_dap_usb_thread_stop(struct cmsis_dap *dap)
+{
+}
+
+static bool cmsis_dap_usb_thread_active(struct cmsis_dap *dap)
+{
+	return false;
+}
+#endif
+
+static void cmsis_dap_free_pending_fifo(struct cmsis_dap *dap)
+{
+	if (dap->pending_fifo == NULL)
+		return;
+
+	for (int i = 0; i < dap->packet_count; i++) {
+		struct pending_request_block *block = &dap->pending_fifo[i];
+
+		free(block->transfers);
+		free(block->command);
+		free(block->response);
+		libusb_free_transfer(block->transfer_out);
+		libusb_free_transfer(block->transfer_in);
+	}
+
+	free(dap->pending_fifo);
+	dap->pending_fifo = NULL;
+}
+
+static int cmsis_dap_alloc_pending_fifo(struct cmsis_dap *dap)
+{
+	LOG_DEBUG("Allocating FIFO for %d pending requests", dap->packet_count);
+
+	dap->pending_fifo = calloc(dap->packet_count, sizeof(struct pending_request_block));
+	if (dap->pending_fifo == NULL)
+		goto fail;
+
+	for (int i = 0; i < dap->packet_count; i++) {
+		struct pending_request_block *block = &dap->pending_fifo[i];
+
+		block->transfers = malloc(MAX(dap->pending_queue_len, dap->pending_block_len) *
+				sizeof(struct pending_transfer_result));
+		block->command = malloc(dap->packet_size);
+		block->response = malloc(dap->packet_size);
+		block->transfer_out = libusb_alloc_transfer(0);
+		block->transfer_in = libusb_alloc_transfer(0);
+		if (!block->transfers || !block->command || !block->response ||
+				!block->transfer_out || !block->transfer_in)
+			goto fail;
+	}
+
+	return ERROR_OK;
+
+fail:
+	LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+	cmsis_dap_free_pending_fifo(dap);
+	return ERROR_FAIL;
+}
+
+static void cmsis_dap_swo_stream_stop(struct cmsis_dap *dap);
+
+static void cmsis_dap_usb_close(struct cmsis_dap *dap)
+{
+	/* the events of the cancelled SWO transfers are handled here */
+	cmsis_dap_usb_thread_stop(dap);
+
+	/* transfers must be released before the USB context goes away */
+	cmsis_dap_free_pending_fifo(dap);
+	cmsis_dap_swo_stream_stop(dap);
+	cmsis_dap_hotplug_deregister(dap);
+
+	if (dap->dev_handle) {
+		libusb_release_interface(dap->dev_handle, dap->interface);
+		libusb_close(dap->dev_handle);
+	}
+	libusb_exit(dap->usb_ctx);
+
+	free(dap->serial);
+	free(dap->trace_ring);
+	free(dap->pending_scan_results);
+	free(dap->batch_buf);
+	free(dap->queued_seq_buf);
+	free(dap->packet_buffer);
+	free(dap);
+	cmsis_dap_handle = NULL;
+	for (int i = 0; cmsis_dap_serial[i] != NULL; i++) {
+		free(cmsis_dap_serial[i]);
+		cmsis_dap_serial[i] = NULL;
+	}
+}
+
+/* After a failed transfer: note whether the adapter is gone, unplugged
+ * or reset, so that the next access looks for it again */
+static void cmsis_dap_usb_check_lost(struct cmsis_dap *dap)
+{
+	int config;
+
+	if (dap->dev_handle &&
+			libusb_get_configuration(dap->dev_handle, &config) == LIBUSB_ERROR_NO_DEVICE) {
+		if (!__atomic_exchange_n(&dap->device_lost, true, __ATOMIC_SEQ_CST))
+			LOG_WARNING("CMSIS-DAP v2 adapter lost");
+	}
+}
+
+static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
+{
+	int transferred = 0;
+
+#ifdef CMSIS_DAP_JTAG_DEBUG
+	LOG_DEBUG("cmsis-dap usb xfer cmd=%02X", dap->packet_buffer[0]);
+#endif
+
+	if (!dap->dev_handle)
+		return ERROR_FAIL;
+
+	/* write data to device */
+	int64_t start = perf_start();
+	int retval = jtag_libusb_bulk_write(dap->dev_handle, dap->ep_out,
+			(char *)dap->packet_buffer, txlen, USB_TIMEOUT, &transferred);
+	perf_end(PERF_USB_WRITE, start);
+	if (retval != ERROR_OK || transferred != txlen) {
+		LOG_ERROR("error writing data");
+		cmsis_dap_usb_check_lost(dap);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_usb_read(struct cmsis_dap *dap, int timeout_ms)
+{
+	int transferred = 0;
+
+	if (!dap->dev_handle)
+		return ERROR_FAIL;
+
+	int64_t start = perf_start();
+	int retval = jtag_libusb_bulk_read(dap->dev_handle, dap->ep_in,
+			(char *)dap->packet_buffer, dap->packet_size, timeout_ms, &transferred);
+	if (retval != ERROR_OK || transferred == 0) {
+		LOG_DEBUG("error reading data");
+		cmsis_dap_usb_check_lost(dap);
+		return ERROR_FAIL;
+	}
+	/* only the reads which got a response, not the polls */
+	perf_end(PERF_USB_READ, start);
+
+	/* responses are shorter than the packet, don't leave stale data behind */
+	memset(dap->packet_buffer + transferred, 0, dap->packet_size - transferred);
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, bool blocking);
+static int cmsis_dap_usb_reconnect(struct cmsis_dap *dap);
+
+/* Send a message and receive the reply */
+static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
+{
+	if (cmsis_dap_usb_reconnect(dap) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (dap->pending_fifo_block_count) {
+		/* responses of asynchronous requests have to be collected
+		 * first, otherwise they would be taken for the reply */
+		LOG_ERROR("pending %d blocks, flushing", dap->pending_fifo_block_count);
+		while (dap->pending_fifo_block_count)
+			cmsis_dap_swd_read_process(dap, true);
+		dap->pending_fifo_put_idx = 0;
+		dap->pending_fifo_get_idx = 0;
+	}
+
+	uint8_t cmd = dap->packet_buffer[0];
+
+	int retval = cmsis_dap_usb_write(dap, txlen);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* get reply */
+	retval = cmsis_dap_usb_read(dap, USB_TIMEOUT);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (dap->packet_buffer[0] != cmd) {
+		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%02" PRIx8
+			" received 0x%02" PRIx8, cmd, dap->packet_buffer[0]);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWJ_Pins(uint8_t pins, uint8_t mask, uint32_t delay, uint8_t *input)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWJ_PINS;
+	buffer[1] = pins;
+	buffer[2] = mask;
+	h_u32_to_le(&buffer[3], delay);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 7);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_DAP_SWJ_PINS failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if (input)
+		*input = buffer[1];
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWJ_Clock(uint32_t swj_clock)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	/* set clock in Hz */
+	swj_clock *= 1000;
+	buffer[0] = CMD_DAP_SWJ_CLOCK;
+	h_u32_to_le(&buffer[1], swj_clock);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 5);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_DAP_SWJ_CLOCK failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* clock a sequence of bits out on TMS, to change JTAG states */
+static int cmsis_dap_cmd_DAP_SWJ_Sequence(uint8_t s_len, const uint8_t *sequence)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+#ifdef CMSIS_DAP_JTAG_DEBUG
+	LOG_DEBUG("cmsis-dap TMS sequence: len=%d", s_len);
+	for (int i = 0; i < DIV_ROUND_UP(s_len, 8); ++i)
+		printf("%02X ", sequence[i]);
+
+	printf("\n");
+#endif
+
+	buffer[0] = CMD_DAP_SWJ_SEQ;
+	buffer[1] = s_len;
+	bit_copy(&buffer[2], 0, sequence, 0, s_len);
+
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, DIV_ROUND_UP(s_len, 8) + 2);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_Info(uint8_t info, uint8_t **data)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_INFO;
+	buffer[1] = info;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_INFO failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	*data = &(buffer[1]);
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_LED(uint8_t led, uint8_t state)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_LED;
+	buffer[1] = led;
+	buffer[2] = state;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 3);
+
+	if (retval != ERROR_OK || buffer[1] != 0x00) {
+		LOG_ERROR("CMSIS-DAP command CMD_LED failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_Connect(uint8_t mode)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_CONNECT;
+	buffer[1] = mode;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_CONNECT failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if (buffer[1] != mode) {
+		LOG_ERROR("CMSIS-DAP failed to connect in mode (%d)", mode);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_Disconnect(void)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_DISCONNECT;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 1);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_DISCONNECT failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_WriteABORT(uint8_t index, uint32_t value)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_WRITE_ABORT;
+	buffer[1] = index;
+	h_u32_to_le(&buffer[2], value);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 6);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_WRITE_ABORT failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_TFER_Configure(uint8_t idle, uint16_t retry_count, uint16_t match_retry)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_TFER_CONFIGURE;
+	buffer[1] = idle;
+	h_u16_to_le(&buffer[2], retry_count);
+	h_u16_to_le(&buffer[4], match_retry);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 6);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_TFER_Configure failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* Size the WAIT retries of the adapter for the clock of @a khz */
+static int cmsis_dap_tfer_configure(int khz)
+{
+	uint32_t retry = (uint32_t)khz * WAIT_RETRY_MS / WAIT_RETRY_CLOCKS;
+
+	retry = MIN(MAX(retry, WAIT_RETRY_MIN), UINT16_MAX);
+	LOG_DEBUG("CMSIS-DAP: %" PRIu32 " WAIT retries at %d kHz", retry, khz);
+
+	return cmsis_dap_cmd_DAP_TFER_Configure(0, retry, MATCH_RETRY);
+}
+
+static int cmsis_dap_cmd_DAP_SWD_Configure(uint8_t cfg)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWD_CONFIGURE;
+	buffer[1] = cfg;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWD_Configure failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_JTAG_Configure(uint8_t count, const uint8_t *ir_lengths)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	if (count + 2 > cmsis_dap_handle->packet_size) {
+		LOG_ERROR("CMSIS-DAP: too many TAPs in the JTAG chain");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	buffer[0] = CMD_DAP_JTAG_CONFIGURE;
+	buffer[1] = count;
+	memcpy(&buffer[2], ir_lengths, count);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2 + count);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_JTAG_Configure failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWO_Transport(uint8_t transport)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWO_TRANSPORT;
+	buffer[1] = transport;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Transport failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWO_Mode(uint8_t mode)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWO_MODE;
+	buffer[1] = mode;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Mode failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* Returns in @a actual the baudrate the adapter has set, 0 if the
+ * requested one is not supported */
+static int cmsis_dap_cmd_DAP_SWO_Baudrate(uint32_t baudrate, uint32_t *actual)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWO_BAUDRATE;
+	h_u32_to_le(&buffer[1], baudrate);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 5);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Baudrate failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	*actual = le_to_h_u32(&buffer[1]);
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_cmd_DAP_SWO_Control(uint8_t control)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_SWO_CONTROL;
+	buffer[1] = control;
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 2);
+
+	if (retval != ERROR_OK || buffer[1] != DAP_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Control failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
+/* Reads up to @a *size bytes of captured trace into @a data */
+static int cmsis_dap_cmd_DAP_SWO_Data(uint8_t *data, size_t *size, uint8_t *status)
+{
+	int retval;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	size_t max = MIN(*size, (size_t)(cmsis_dap_handle->packet_size - 4));
+
+	buffer[0] = CMD_DAP_SWO_DATA;
+	h_u16_to_le(&buffer[1], max);
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, 3);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command CMD_SWO_Data failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	*status = buffer[1];
+	*size = MIN(le_to_h_u16(&buffer[2]), max);
+	memcpy(data, &buffer[4], *size);
+
+	return ERROR_OK;
+}
+
+static LIBUSB_CALL void cmsis_dap_transfer_cb(struct libusb_transfer *transfer)
+{
+	int *completed = transfer->user_data;
+	__atomic_store_n(completed, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Rewrite a block encoded as DAP_TransferBlock into the DAP_Transfer
+ * layout, where each transfer has its own request byte */
+static void cmsis_dap_swd_unblock(struct cmsis_dap *dap, struct pending_request_block *block)
+{
+	uint8_t *buffer = block->command;
+	uint8_t cmd = block->transfers[0].cmd;
+	bool write = !(cmd & SWD_CMD_RnW);
+	int n = block->transfer_count;
+
+	/* DAP_TransferBlock: 5 header bytes, then the write data words.
+	 * DAP_Transfer: 3 header bytes, then request byte and write data
+	 * per transfer. Moving the words from the last one down never
+	 * overwrites a word that has not been moved yet. */
+	if (write) {
+		for (int i = n - 1; i >= 0; i--)
+			memmove(&buffer[3 + 5 * i + 1], &buffer[5 + 4 * i], 4);
+	}
+	for (int i = 0; i < n; i++) {
+		buffer[3 + (write ? 5 : 1) * i] = (cmd >> 1) & 0x0f;
+		block->transfers[i].cmd = cmd;
+		block->transfers[i].match = false;
+	}
+
+	buffer[0] = CMD_DAP_TFER;
+	buffer[1] = dap->jtag_index;	/* DAP Index */
+	block->command_len = 3 + (write ? 5 : 1) * n;
+	block->block_transfer = false;
+}
+
+/* Send the request of @a block and submit the transfer of its response */
+static int cmsis_dap_swd_submit_block(struct cmsis_dap *dap, struct pending_request_block *block)
+{
+	uint8_t *buffer = block->command;
+
+	if (!dap->dev_handle)
+		return ERROR_FAIL;
+
+	if (block->block_transfer)
+		h_u16_to_le(&buffer[2], block->transfer_count);
+	else
+		buffer[2] = block->transfer_count;
+	size_t idx = block->command_len;
+
+	/* The response transfer is submitted together with the request so
+	 * that the adapter can deliver it as soon as it is ready, while the
+	 * next request is being encoded. */
+	block->completed_out = 0;
+	block->completed_in = 0;
+	libusb_fill_bulk_transfer(block->transfer_out, dap->dev_handle, dap->ep_out,
+			buffer, idx, cmsis_dap_transfer_cb, &block->completed_out, USB_TIMEOUT);
+	libusb_fill_bulk_transfer(block->transfer_in, dap->dev_handle, dap->ep_in,
+			block->response, dap->packet_size, cmsis_dap_transfer_cb,
+			&block->completed_in, USB_TIMEOUT);
+
+	duration_start(&block->round_trip);
+	int err = libusb_submit_transfer(block->transfer_out);
+	if (err != LIBUSB_SUCCESS) {
+		LOG_ERROR("error submitting USB write: %s", libusb_error_name(err));
+		cmsis_dap_usb_check_lost(dap);
+		return ERROR_FAIL;
+	}
+
+	err = libusb_submit_transfer(block->transfer_in);
+	if (err != LIBUSB_SUCCESS) {
+		LOG_ERROR("error submitting USB read: %s", libusb_error_name(err));
+		/* the request is on its way, wait for it and drop the response */
+		block->completed_in = 1;
+		block->transfer_in->status = LIBUSB_TRANSFER_ERROR;
+	}
+
+	dap->stats.packets++;
+	dap->stats.request_bytes += idx;
+	dap->stats.transfers += block->transfer_count;
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
+{
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+
+	LOG_TRACE("Executing %d queued transactions from FIFO index %d", block->transfer_count, dap->pending_fifo_put_idx);
+
+	if (dap->queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skipping due to previous errors: %d", dap->queued_retval);
+		goto skip;
+	}
+
+	if (block->transfer_count == 0)
+		goto skip;
+
+	/* a single transfer is sent as plain DAP_Transfer */
+	if (block->block_transfer && block->transfer_count == 1)
+		cmsis_dap_swd_unblock(dap, block);
+
+	block->wait_resubmits = 0;
+	if (cmsis_dap_swd_submit_block(dap, block) != ERROR_OK) {
+		dap->queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+
+	dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % dap->packet_count;
+	dap->pending_fifo_block_count++;
+	if (dap->pending_fifo_block_count > dap->packet_count)
+		LOG_ERROR("too much pending writes %d", dap->pending_fifo_block_count);
+
+	return;
+
+skip:
+	block->transfer_count = 0;
+}
+
+/* Wait until both transfers of a block are finished. With @a blocking
+ * false only already pending events are handled and false is returned
+ * if the block is still in flight. */
+static bool cmsis_dap_wait_block(struct cmsis_dap *dap,
+		struct pending_request_block *block, bool blocking)
+{
+	struct timeval tv = { 0, 0 };
+
+	while (!__atomic_load_n(&block->completed_out, __ATOMIC_SEQ_CST) ||
+			!__atomic_load_n(&block->completed_in, __ATOMIC_SEQ_CST)) {
+		int *completed = block->completed_out ? &block->completed_in : &block->completed_out;
+		int err;
+
+		if (blocking)
+			err = libusb_handle_events_completed(dap->usb_ctx, completed);
+		else
+			err = libusb_handle_events_timeout_completed(dap->usb_ctx, &tv, completed);
+
+		if (!blocking && !*completed)
+			return false;
+
+		if (err < 0 && err != LIBUSB_ERROR_INTERRUPTED) {
+			LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(err));
+			/* the callbacks still fire for cancelled transfers */
+			if (!block->completed_out)
+				libusb_cancel_transfer(block->transfer_out);
+			if (!block->completed_in)
+				libusb_cancel_transfer(block->transfer_in);
+		}
+	}
+
+	return true;
+}
+
+static void cmsis_dap_stats_round_trip(struct cmsis_dap *dap,
+		struct pending_request_block *block)
+{
+	struct cmsis_dap_stats *stats = &dap->stats;
+
+	duration_measure(&block->round_trip);
+	uint64_t us = block->round_trip.elapsed.tv_sec * 1000000ULL + block->round_trip.elapsed.tv_usec;
+
+	int bucket = 0;
+	while (bucket < STATS_LATENCY_BUCKETS - 1 && (us >> (bucket + 1)))
+		bucket++;
+	stats->latency[bucket]++;
+	stats->latency_us_total += us;
+	stats->latency_us_max = MAX(stats->latency_us_max, us);
+}
+
+/*
+ * The adapter ran out of WAIT retries at the transfer after the first
+ * @a done ones of @a block and skipped the rest of the block. Send the
+ * transfers from the failed one on again. This keeps the order of the
+ * transfers only if no later block has been sent yet, else the caller
+ * sees ERROR_WAIT.
+ */
+static bool cmsis_dap_swd_resubmit_tail(struct cmsis_dap *dap,
+		struct pending_request_block *block, int done)
+{
+	uint8_t *buffer = block->command;
+	size_t off, head;
+
+	if (dap->pending_fifo_block_count != 1 || done >= block->transfer_count ||
+			block->wait_resubmits >= WAIT_RESUBMIT_MAX)
+		return false;
+
+	if (block->block_transfer) {
+		/* 5 header bytes, then the data words of writes */
+		uint8_t cmd = block->transfers[0].cmd;
+		head = 5;
+		off = head + (cmd & SWD_CMD_RnW ? 0 : 4 * done);
+		memmove(block->transfers, &block->transfers[done],
+				(block->transfer_count - done) * sizeof(*block->transfers));
+		block->transfers[0].cmd = cmd;
+	} else {
+		/* 3 header bytes, then per transfer the request byte and the
+		 * data of writes and value match reads */
+		head = 3;
+		off = head;
+		for (int i = 0; i < done; i++) {
+			uint8_t request = buffer[off];
+			off += (!(request & 0x02) || (request & DAP_TFER_MATCH_VALUE)) ? 5 : 1;
+		}
+		memmove(block->transfers, &block->transfers[done],
+				(block->transfer_count - done) * sizeof(*block->transfers));
+	}
+	memmove(&buffer[head], &buffer[off], block->command_len - off);
+	block->command_len -= off - head;
+	block->transfer_count -= done;
+	block->wait_resubmits++;
+	dap->stats.resubmits++;
+
+	LOG_DEBUG("CMSIS-DAP: resubmitting %d transfers after WAIT", block->transfer_count);
+	return cmsis_dap_swd_submit_block(dap, block) == ERROR_OK;
+}
+
+static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, bool blocking)
+{
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_get_idx];
+	uint8_t *buffer = block->response;
+
+	if (dap->pending_fifo_block_count == 0) {
+		LOG_ERROR("no pending write");
+		return;
+	}
+
+	/* get reply */
+	if (!cmsis_dap_wait_block(dap, block, blocking))
+		return;
+	cmsis_dap_stats_round_trip(dap, block);
+
+	if (block->transfer_out->status != LIBUSB_TRANSFER_COMPLETED ||
+			block->transfer_in->status != LIBUSB_TRANSFER_COMPLETED ||
+			block->transfer_in->actual_length < 3) {
+		LOG_DEBUG("error transferring data");
+		if (block->transfer_out->status == LIBUSB_TRANSFER_NO_DEVICE ||
+				block->transfer_in->status == LIBUSB_TRANSFER_NO_DEVICE)
+			cmsis_dap_usb_check_lost(dap);
+		dap->stats.errors++;
+		dap->queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+	adapter_stats_usb(block->transfer_out->actual_length);
+	adapter_stats_usb(block->transfer_in->actual_length);
+
+	if (buffer[0] != block->command[0]) {
+		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%02" PRIx8 " received 0x%02" PRIx8,
+			block->command[0], buffer[0]);
+		dap->stats.errors++;
+		dap->queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+
+	/* DAP_TransferBlock has a 16 bit transfer count */
+	int transfer_count;
+	uint8_t response;
+	size_t idx;
+	if (buffer[0] == CMD_DAP_TFER_BLOCK) {
+		transfer_count = le_to_h_u16(&buffer[1]);
+		response = buffer[3];
+		idx = 4;
+	} else {
+		transfer_count = buffer[1];
+		response = buffer[2];
+		idx = 3;
+	}
+
+	if (response & 0x08) {
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
+		dap->stats.errors++;
+		dap->queued_retval = ERROR_FAIL;
+		goto skip;
+	}
+	if (buffer[0] == CMD_DAP_TFER && (response & DAP_TFER_MISMATCH)) {
+		LOG_DEBUG("CMSIS-DAP value mismatch @ %d", transfer_count);
+		dap->queued_retval = ERROR_TIMEOUT_REACHED;
+		goto skip;
+	}
+	uint8_t ack = response & 0x07;
+	if (ack != SWD_ACK_OK) {
+		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
+			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
+		dap->stats.errors++;
+		if (ack == SWD_ACK_WAIT)
+			dap->stats.waits++;
+		else if (ack == SWD_ACK_FAULT)
+			dap->stats.faults++;
+		/* the transfers done before a WAIT have their results */
+		if (ack != SWD_ACK_WAIT) {
+			dap->queued_retval = ERROR_FAIL;
+			goto skip;
+		}
+	} else if (block->transfer_count != transfer_count) {
+		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
+			  block->transfer_count, transfer_count);
+	}
+
+	LOG_TRACE("Received results of %d queued transactions FIFO index %d", transfer_count, dap->pending_fifo_get_idx);
+	for (int i = 0; i < MIN(transfer_count, block->transfer_count); i++) {
+		struct pending_transfer_result *transfer = &(block->transfers[i]);
+		uint8_t cmd = block->block_transfer ? block->transfers[0].cmd : transfer->cmd;
+		if (!block->block_transfer && transfer->match)
+			continue;
+		if (cmd & SWD_CMD_RnW) {
+			uint32_t data = le_to_h_u32(&buffer[idx]);
+			uint32_t tmp = data;
+			idx += 4;
+
+			LOG_TRACE("Read result: %" PRIx32, data);
+
+			/* Imitate posted AP reads. The adapter already returns
+			 * the result of each AP read in its own slot, which is
+			 * what the dap_ops backend hands to its caller. */
+			if (!dap->dapdirect &&
+			    ((cmd & SWD_CMD_APnDP) ||
+			     ((cmd & SWD_CMD_A32) >> 1 == DP_RDBUFF))) {
+				tmp = dap->last_read;
+				dap->last_read = data;
+			}
+
+			if (transfer->buffer)
+				*(uint32_t *)(transfer->buffer) = tmp;
+		}
+	}
+	dap->stats.responses++;
+	dap->stats.response_bytes += idx;
+
+	if (ack == SWD_ACK_WAIT) {
+		/* the block stays at the head of the FIFO until its tail is done */
+		if (cmsis_dap_swd_resubmit_tail(dap, block, transfer_count))
+			return;
+		dap->queued_retval = ERROR_WAIT;
+	}
+
+skip:
+	block->transfer_count = 0;
+	dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % dap->packet_count;
+	dap->pending_fifo_block_count--;
+}
+
+static int cmsis_dap_swd_run_queue(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	/* the transfers queued while the adapter was lost may be part of a
+	 * sequence the adapter never saw, fail them even if it is back: the
+	 * DAP layer then connects to the DP again */
+	if (dap->device_lost) {
+		cmsis_dap_usb_reconnect(dap);
+		dap->queued_retval = ERROR_FAIL;
+	}
+
+	cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
+
+	while (dap->pending_fifo_block_count)
+		cmsis_dap_swd_read_process(cmsis_dap_handle, true);
+
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
+
+	int retval = dap->queued_retval;
+	dap->queued_retval = ERROR_OK;
+
+	return retval;
+}
+
+/* Checks whether @a block has room for one more transfer using @a cmd */
+static bool cmsis_dap_swd_block_full(struct cmsis_dap *dap,
+		const struct pending_request_block *block, uint8_t cmd)
+{
+	if (block->transfer_count == 0)
+		return false;
+
+	/* runs of the same request are sent as DAP_TransferBlock, which
+	 * needs only 4 bytes per transfer instead of up to 5 */
+	if (block->block_transfer && block->transfers[0].cmd == cmd)
+		return block->transfer_count >= dap->pending_block_len;
+
+	return block->transfer_count >= dap->pending_queue_len;
+}
+
+static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	adapter_stats_scan(46);
+	if (cmsis_dap_swd_block_full(dap, &dap->pending_fifo[dap->pending_fifo_put_idx], cmd)) {
+		/* collect an already arrived response without waiting */
+		if (dap->pending_fifo_block_count)
+			cmsis_dap_swd_read_process(cmsis_dap_handle, false);
+
+		/* Not enough room in the queue. Run the queue. */
+		cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
+
+		if (dap->pending_fifo_block_count >= dap->packet_count)
+			cmsis_dap_swd_read_process(cmsis_dap_handle, true);
+	}
+
+	if (dap->queued_retval != ERROR_OK)
+		return;
+
+	LOG_TRACE("APnDP %d RnW %d reg %x %" PRIx32,
+			!!(cmd & SWD_CMD_APnDP), !!(cmd & SWD_CMD_RnW),
+			(cmd & SWD_CMD_A32) >> 1, data);
+
+	/* See the comment in cmsis_dap_usb.c, the adapter is asked
+	 * to retry WAIT responses on its own so sticky overrun
+	 * detection must stay disabled. */
+	if (!(cmd & SWD_CMD_RnW) &&
+	    !(cmd & SWD_CMD_APnDP) &&
+	    (cmd & SWD_CMD_A32) >> 1 == DP_CTRL_STAT &&
+	    (data & CORUNDETECT)) {
+		LOG_DEBUG("refusing to enable sticky overrun detection");
+		data &= ~CORUNDETECT;
+	}
+
+	/* The request is encoded straight into the USB buffer of the block.
+	 * A new block starts out as DAP_TransferBlock, which is rewritten
+	 * once if a transfer with a different request joins it. */
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+	uint8_t *buffer = block->command;
+	if (block->transfer_count == 0) {
+		buffer[0] = CMD_DAP_TFER_BLOCK;
+		buffer[1] = dap->jtag_index;	/* DAP Index */
+		buffer[4] = (cmd >> 1) & 0x0f;
+		block->command_len = 5;
+		block->block_transfer = true;
+		block->transfers[0].cmd = cmd;
+	} else if (block->block_transfer && block->transfers[0].cmd != cmd) {
+		cmsis_dap_swd_unblock(dap, block);
+	}
+
+	if (!block->block_transfer) {
+		block->transfers[block->transfer_count].cmd = cmd;
+		block->transfers[block->transfer_count].match = false;
+		buffer[block->command_len++] = (cmd >> 1) & 0x0f;
+	}
+	if (cmd & SWD_CMD_RnW) {
+		/* Queue a read transaction */
+		block->transfers[block->transfer_count].buffer = dst;
+	} else {
+		h_u32_to_le(&buffer[block->command_len], data);
+		block->command_len += 4;
+	}
+	block->transfer_count++;
+}
+
+/*
+ * Queue a write of the match mask and a value match read, which the
+ * adapter repeats up to MATCH_RETRY times until the masked value equals
+ * @a match. Both go into a DAP_Transfer block, the adapter stops the
+ * block at a mismatch and run() returns ERROR_TIMEOUT_REACHED.
+ */
+static void cmsis_dap_swd_read_reg_match(uint8_t cmd, uint32_t mask, uint32_t match,
+		uint32_t ap_delay_clk)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	struct pending_request_block *block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+
+	assert(cmd & SWD_CMD_RnW);
+
+	adapter_stats_scan(2 * 46);
+	if (block->transfer_count + 2 > dap->pending_queue_len) {
+		if (dap->pending_fifo_block_count)
+			cmsis_dap_swd_read_process(dap, false);
+
+		cmsis_dap_swd_write_from_queue(dap);
+
+		if (dap->pending_fifo_block_count >= dap->packet_count)
+			cmsis_dap_swd_read_process(dap, true);
+	}
+
+	if (dap->queued_retval != ERROR_OK)
+		return;
+
+	LOG_TRACE("APnDP %d reg %x match %" PRIx32 " mask %" PRIx32,
+			!!(cmd & SWD_CMD_APnDP), (cmd & SWD_CMD_A32) >> 1, match, mask);
+
+	block = &dap->pending_fifo[dap->pending_fifo_put_idx];
+	uint8_t *buffer = block->command;
+	if (block->transfer_count == 0) {
+		buffer[0] = CMD_DAP_TFER;
+		buffer[1] = dap->jtag_index;	/* DAP Index */
+		block->command_len = 3;
+		block->block_transfer = false;
+	} else if (block->block_transfer) {
+		cmsis_dap_swd_unblock(dap, block);
+	}
+
+	struct pending_transfer_result *transfer = &block->transfers[block->transfer_count++];
+	transfer->cmd = swd_cmd(false, false, 0);
+	transfer->match = false;
+	transfer->buffer = NULL;
+	buffer[block->command_len++] = DAP_TFER_MATCH_MASK;
+	h_u32_to_le(&buffer[block->command_len], mask);
+	block->command_len += 4;
+
+	transfer = &block->transfers[block->transfer_count++];
+	transfer->cmd = cmd;
+	transfer->match = true;
+	transfer->buffer = NULL;
+	buffer[block->command_len++] = ((cmd >> 1) & 0x0f) | DAP_TFER_MATCH_VALUE;
+	h_u32_to_le(&buffer[block->command_len], match);
+	block->command_len += 4;
+}
+
+/*
+ * TARGETSEL of SWD multi-drop gets no ACK from any DP, which DAP_Transfer
+ * would report as a protocol error. Clock the whole packet out with
+ * DAP_SWJ_Sequence instead: request, turnaround and ACK phase (driven, as
+ * no target drives it), data and parity, then two idle cycles.
+ */
+static void cmsis_dap_swd_targetsel(uint8_t cmd, uint32_t value)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t seq[6];
+
+	/* the queued transfers have to go out before the sequence */
+	cmsis_dap_swd_write_from_queue(dap);
+	while (dap->pending_fifo_block_count)
+		cmsis_dap_swd_read_process(dap, true);
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
+
+	if (dap->queued_retval != ERROR_OK)
+		return;
+
+	seq[0] = cmd | SWD_CMD_START | SWD_CMD_PARK;
+	memset(&seq[1], 0, sizeof(seq) - 1);
+	/* bits 8..12: turnaround and ACK, left low */
+	buf_set_u32(seq, 13, 32, value);
+	buf_set_u32(seq, 45, 1, parity_u32(value));
+	/* bits 46..47: idle */
+
+	LOG_DEBUG_IO("DP TARGETSEL write %" PRIx32, value);
+	if (cmsis_dap_cmd_DAP_SWJ_Sequence(48, seq) != ERROR_OK)
+		dap->queued_retval = ERROR_FAIL;
+}
+
+static void cmsis_dap_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
+{
+	assert(!(cmd & SWD_CMD_RnW));
+
+	if (cmd == swd_cmd(false, false, DP_TARGETSEL)) {
+		cmsis_dap_swd_targetsel(cmd, value);
+		return;
+	}
+
+	cmsis_dap_swd_queue_cmd(cmd, NULL, value);
+}
+
+static void cmsis_dap_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
+{
+	assert(cmd & SWD_CMD_RnW);
+	cmsis_dap_swd_queue_cmd(cmd, value, 0);
+}
+
+static int cmsis_dap_get_serial_info(void)
+{
+	uint8_t *data;
+
+	int retval = cmsis_dap_cmd_DAP_Info(INFO_ID_SERNUM, &data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (data[0]) /* strlen */
+		LOG_INFO("CMSIS-DAP: Serial# = %s", &data[1]);
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_get_version_info(void)
+{
+	uint8_t *data;
+
+	/* INFO_ID_FW_VER - string */
+	int retval = cmsis_dap_cmd_DAP_Info(INFO_ID_FW_VER, &data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (data[0]) /* strlen */
+		LOG_INFO("CMSIS-DAP: FW Version = %s", &data[1]);
+
+	return ERROR_OK;
+}
+
+/* DAP_ExecuteCommands is optional, adapters without it answer DAP_Invalid.
+ * The exchange is done by hand to not log the command mismatch. */
+static bool cmsis_dap_probe_execute_commands(void)
+{
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	buffer[0] = CMD_DAP_EXECUTE_COMMANDS;
+	buffer[1] = 1;
+	buffer[2] = CMD_DAP_INFO;
+	buffer[3] = INFO_ID_CAPS;
+	if (cmsis_dap_usb_write(cmsis_dap_handle, 4) != ERROR_OK ||
+			cmsis_dap_usb_read(cmsis_dap_handle, USB_TIMEOUT) != ERROR_OK)
+		return false;
+
+	return buffer[0] == CMD_DAP_EXECUTE_COMMANDS && buffer[1] == 1 &&
+		buffer[2] == CMD_DAP_INFO;
+}
+
+static int cmsis_dap_get_caps_info(void)
+{
+	uint8_t *data;
+
+	/* INFO_ID_CAPS - byte */
+	int retval = cmsis_dap_cmd_DAP_Info(INFO_ID_CAPS, &data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (data[0] >= 1) {
+		uint8_t caps = data[1];
+
+		cmsis_dap_handle->caps = caps;
+
+		for (unsigned int i = 0; i < ARRAY_SIZE(info_caps_str); i++) {
+			if (caps & BIT(i))
+				LOG_INFO("CMSIS-DAP: %s", info_caps_str[i]);
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_get_status(void)
+{
+	uint8_t d;
+
+	int retval = cmsis_dap_cmd_DAP_SWJ_Pins(0, 0, 0, &d);
+
+	if (retval == ERROR_OK) {
+		LOG_INFO("SWCLK/TCK = %d SWDIO/TMS = %d TDI = %d TDO = %d nTRST = %d nRESET = %d",
+			(d & SWJ_PIN_TCK) ? 1 : 0,
+			(d & SWJ_PIN_TMS) ? 1 : 0,
+			(d & SWJ_PIN_TDI) ? 1 : 0,
+			(d & SWJ_PIN_TDO) ? 1 : 0,
+			(d & SWJ_PIN_TRST) ? 1 : 0,
+			(d & SWJ_PIN_SRST) ? 1 : 0);
+	}
+
+	return retval;
+}
+
+static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	const uint8_t *s;
+	unsigned int s_len;
+	int retval;
+
+	if ((dap->output_pins & (SWJ_PIN_SRST | SWJ_PIN_TRST)) == (SWJ_PIN_SRST | SWJ_PIN_TRST)) {
+		/* Following workaround deasserts reset on most adapters.
+		 * Do not reconnect if a reset line is active!
+		 * Reconnecting would break connecting under reset. */
+
+		/* First disconnect before connecting, Atmel EDBG needs it for SAMD/R/L/C */
+		cmsis_dap_cmd_DAP_Disconnect();
+
+		/* When we are reconnecting, DAP_Connect needs to be rerun, at
+		 * least on Keil ULINK-ME */
+		retval = cmsis_dap_cmd_DAP_Connect(CONNECT_SWD);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	switch (seq) {
+	case LINE_RESET:
+		LOG_DEBUG("SWD line reset");
+		s = swd_seq_line_reset;
+		s_len = swd_seq_line_reset_len;
+		break;
+	case JTAG_TO_SWD:
+		LOG_DEBUG("JTAG-to-SWD");
+		s = swd_seq_jtag_to_swd;
+		s_len = swd_seq_jtag_to_swd_len;
+		break;
+	case SWD_TO_JTAG:
+		LOG_DEBUG("SWD-to-JTAG");
+		s = swd_seq_swd_to_jtag;
+		s_len = swd_seq_swd_to_jtag_len;
+		break;
+	case SWD_TO_DORMANT:
+		LOG_DEBUG("SWD-to-dormant");
+		s = swd_seq_swd_to_dormant;
+		s_len = swd_seq_swd_to_dormant_len;
+		break;
+	case DORMANT_TO_SWD:
+		LOG_DEBUG("dormant-to-SWD");
+		s = swd_seq_dormant_to_swd;
+		s_len = swd_seq_dormant_to_swd_len;
+		break;
+	default:
+		LOG_ERROR("Sequence %d not supported", seq);
+		return ERROR_FAIL;
+	}
+
+	retval = cmsis_dap_cmd_DAP_SWJ_Sequence(s_len, s);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Atmel EDBG needs renew clock setting after SWJ_Sequence
+	 * otherwise default frequency is used */
+	return cmsis_dap_cmd_DAP_SWJ_Clock(jtag_get_speed_khz());
+}
+
+static int cmsis_dap_swd_open(void)
+{
+	int retval;
+
+	if (!(cmsis_dap_handle->caps & INFO_CAPS_SWD)) {
+		LOG_ERROR("CMSIS-DAP: SWD not supported");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	retval = cmsis_dap_cmd_DAP_Connect(CONNECT_SWD);
+	if (retval != ERROR_OK)
+		return retval;
+
+	LOG_INFO("CMSIS-DAP: Interface Initialised (SWD)");
+	return ERROR_OK;
+}
 
 static int cmsis_dap_v2_init(void)
 {
-    // TODO
-    return ERROR_OK;
+	struct cmsis_dap *dap;
+	int retval;
+	uint8_t *data;
+
+	retval = cmsis_dap_usb_open();
+	if (retval != ERROR_OK)
+		return retval;
+
+	dap = cmsis_dap_handle;
+
+	if (cmsis_dap_usb_thread_enabled)
+		cmsis_dap_usb_thread_start(dap);
+
+	retval = cmsis_dap_get_caps_info();
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_get_version_info();
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_get_serial_info();
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the dapdirect transports do not call swd_ops->init() */
+	if (transport_is_dapdirect_swd())
+		swd_mode = true;
+	dap->dapdirect = transport_is_dapdirect_swd() || transport_is_dapdirect_jtag();
+
+	if (swd_mode) {
+		retval = cmsis_dap_swd_open();
+		if (retval != ERROR_OK)
+			return retval;
+	} else {
+		/* Connect in JTAG mode */
+		if (!(dap->caps & INFO_CAPS_JTAG)) {
+			LOG_ERROR("CMSIS-DAP: JTAG not supported");
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+
+		retval = cmsis_dap_cmd_DAP_Connect(CONNECT_JTAG);
+		if (retval != ERROR_OK)
+			return retval;
+
+		LOG_INFO("CMSIS-DAP: Interface Initialised (JTAG)");
+	}
+
+	/* Be conservative and suppress submitting multiple requests
+	 * until we get packet count info from the adaptor */
+	dap->packet_count = 1;
+	dap->pending_queue_len = (dap->packet_size - 3) / 5;
+	dap->pending_block_len = (dap->packet_size - 5) / 4;
+
+	/* INFO_ID_PKT_SZ - short */
+	retval = cmsis_dap_cmd_DAP_Info(INFO_ID_PKT_SZ, &data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (data[0] == 2) {  /* short */
+		uint16_t pkt_sz = data[1] + (data[2] << 8);
+
+		/* 3 bytes of command header + 5 bytes per register
+		 * write. For bulk read sequences just 4 bytes are
+		 * needed per transfer, so this is suboptimal. */
+		dap->pending_queue_len = (pkt_sz - 3) / 5;
+		/* DAP_TransferBlock: 5 bytes of command header and 4 bytes
+		 * per word in the request or in the response */
+		dap->pending_block_len = (pkt_sz - 5) / 4;
+
+		if (dap->packet_size != pkt_sz) {
+			/* reallocate buffer */
+			dap->packet_size = pkt_sz;
+			dap->packet_buffer = realloc(dap->packet_buffer,
+					dap->packet_size);
+			if (dap->packet_buffer == NULL) {
+				LOG_ERROR("unable to reallocate memory");
+				return ERROR_FAIL;
+			}
+		}
+
+		LOG_DEBUG("CMSIS-DAP: Packet Size = %" PRId16, pkt_sz);
+	}
+
+	/* INFO_ID_PKT_CNT - byte */
+	retval = cmsis_dap_cmd_DAP_Info(INFO_ID_PKT_CNT, &data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (data[0] == 1) { /* byte */
+		int pkt_cnt = data[1];
+		if (pkt_cnt > 1)
+			dap->packet_count = pkt_cnt;
+
+		LOG_DEBUG("CMSIS-DAP: Packet Count = %d", pkt_cnt);
+	}
+
+	retval = cmsis_dap_alloc_pending_fifo(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* every TDO capturing sequence takes at least two bytes of the buffer */
+	dap->queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN(dap));
+	dap->batch_buf = malloc(BATCH_BUF_LEN(dap));
+	dap->pending_scan_result_max = QUEUED_SEQ_BUF_LEN(dap) / 2;
+	dap->pending_scan_results = calloc(dap->pending_scan_result_max,
+			sizeof(struct pending_scan_result));
+	if (dap->queued_seq_buf == NULL || dap->batch_buf == NULL ||
+			dap->pending_scan_results == NULL) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP JTAG queue");
+		return ERROR_FAIL;
+	}
+
+	dap->execute_commands = cmsis_dap_probe_execute_commands();
+	LOG_DEBUG("CMSIS-DAP: DAP_ExecuteCommands %ssupported",
+		dap->execute_commands ? "" : "not ");
+
+	retval = cmsis_dap_get_status();
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* Now try to connect to the target
+	 * TODO: This is all SWD only @ present */
+	retval = cmsis_dap_cmd_DAP_SWJ_Clock(jtag_get_speed_khz());
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* Ask CMSIS-DAP to automatically retry on receiving WAIT, as many
+	 * times as fit in WAIT_RETRY_MS at the current clock. This must be
+	 * changed to 0 if sticky overrun detection is enabled. */
+	retval = cmsis_dap_tfer_configure(jtag_get_speed_khz());
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (swd_mode) {
+		/* Data Phase (bit 2) must be set to 1 if sticky overrun
+		 * detection is enabled */
+		retval = cmsis_dap_cmd_DAP_SWD_Configure(0);	/* 1 TRN, no Data Phase */
+		if (retval != ERROR_OK)
+			return ERROR_FAIL;
+	}
+	/* Both LEDs on */
+	retval = cmsis_dap_cmd_DAP_LED(LED_ID_CONNECT, LED_ON);
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	retval = cmsis_dap_cmd_DAP_LED(LED_ID_RUN, LED_ON);
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* support connecting with srst asserted */
+	enum reset_types jtag_reset_config = jtag_get_reset_config();
+
+	if (jtag_reset_config & RESET_CNCT_UNDER_SRST) {
+		if (jtag_reset_config & RESET_SRST_NO_GATING) {
+			retval = cmsis_dap_cmd_DAP_SWJ_Pins(0, SWJ_PIN_SRST, 0, NULL);
+			if (retval != ERROR_OK)
+				return ERROR_FAIL;
+			LOG_INFO("Connecting under reset");
+		}
+	}
+	LOG_INFO("CMSIS-DAP: Interface ready");
+
+	return ERROR_OK;
+}
+
+/*
+ * Look for the lost adapter again, with the serial it had, and set it up
+ * as it was: the same mode, clock and transfer configuration. The state the
+ * target layer keeps (examined targets, breakpoints, RTOS) is left alone,
+ * so a probe which reset or was replugged costs a DP reconnect instead of
+ * a restart of OpenOCD. Only SWO capture has to be configured again.
+ * @returns ERROR_OK when the adapter is usable.
+ */
+static int cmsis_dap_usb_reconnect(struct cmsis_dap *dap)
+{
+	if (!__atomic_load_n(&dap->device_lost, __ATOMIC_SEQ_CST))
+		return ERROR_OK;
+	if (!cmsis_dap_reconnect_enabled)
+		return ERROR_FAIL;
+
+	/* don't enumerate the bus on every access while the adapter is away */
+	int64_t now = timeval_ms();
+	if (!cmsis_dap_usb_thread_active(dap)) {
+		/* run the hotplug callbacks */
+		struct timeval tv = { 0, 0 };
+		libusb_handle_events_timeout_completed(dap->usb_ctx, &tv, NULL);
+	}
+	bool arrived = __atomic_exchange_n(&dap->device_arrived, false, __ATOMIC_SEQ_CST);
+	if (now - dap->reconnect_last_ms < RECONNECT_INTERVAL_MS ||
+			(dap->hotplug && !arrived && now - dap->reconnect_last_ms < RECONNECT_HOTPLUG_MS))
+		return ERROR_FAIL;
+	dap->reconnect_last_ms = now;
+
+	/* nothing may use the old device handle any more */
+	while (dap->pending_fifo_block_count)
+		cmsis_dap_swd_read_process(dap, true);
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
+	cmsis_dap_usb_thread_stop(dap);
+	if (dap->trace_transport == DAP_SWO_TRANSPORT_STREAM) {
+		LOG_WARNING("SWO capture stopped, configure it again");
+		cmsis_dap_swo_stream_stop(dap);
+		dap->trace_transport = DAP_SWO_TRANSPORT_NONE;
+	}
+	if (dap->dev_handle) {
+		libusb_release_interface(dap->dev_handle, dap->interface);
+		libusb_close(dap->dev_handle);
+		dap->dev_handle = NULL;
+	}
+
+	char * const serials[] = { dap->serial, NULL };
+	char serial_str[256];
+	uint16_t packet_size;
+	dap->dev_handle = cmsis_dap_usb_claim(dap->usb_ctx, serials, serial_str,
+			sizeof(serial_str), &dap->interface, &dap->ep_out, &dap->ep_in,
+			&dap->ep_swo, &packet_size);
+	if (!dap->dev_handle) {
+		LOG_DEBUG("CMSIS-DAP v2 adapter not back yet");
+		return ERROR_FAIL;
+	}
+	__atomic_store_n(&dap->device_lost, false, __ATOMIC_SEQ_CST);
+
+	if (cmsis_dap_usb_thread_enabled)
+		cmsis_dap_usb_thread_start(dap);
+
+	int retval = cmsis_dap_cmd_DAP_Connect(swd_mode ? CONNECT_SWD : CONNECT_JTAG);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_SWJ_Clock(jtag_get_speed_khz());
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_tfer_configure(jtag_get_speed_khz());
+	if (retval == ERROR_OK && swd_mode)
+		retval = cmsis_dap_cmd_DAP_SWD_Configure(0);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_LED(LED_ID_CONNECT, LED_ON);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_LED(LED_ID_RUN, LED_ON);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP v2 adapter found again, but unable to set it up");
+		__atomic_store_n(&dap->device_lost, true, __ATOMIC_SEQ_CST);
+		return retval;
+	}
+
+	dap->stats.reconnects++;
+	LOG_INFO("CMSIS-DAP v2 adapter reconnected");
+	return ERROR_OK;
+}
+
+static int cmsis_dap_v2_swd_init(void)
+{
+	swd_mode = true;
+	return ERROR_OK;
+}
+
+static LIBUSB_CALL void cmsis_dap_swo_stream_cb(struct libusb_transfer *transfer)
+{
+	struct cmsis_dap *dap = transfer->user_data;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED ||
+			transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+		size_t head = dap->trace_ring_head;
+		size_t tail = __atomic_load_n(&dap->trace_ring_tail, __ATOMIC_SEQ_CST);
+		for (int i = 0; i < transfer->actual_length; i++) {
+			size_t next = (head + 1) % SWO_RING_SIZE;
+			if (next == tail) {
+				__atomic_store_n(&dap->trace_overrun, true, __ATOMIC_SEQ_CST);
+				break;
+			}
+			dap->trace_ring[head] = transfer->buffer[i];
+			head = next;
+		}
+		__atomic_store_n(&dap->trace_ring_head, head, __ATOMIC_SEQ_CST);
+	} else {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			__atomic_store_n(&dap->trace_error, transfer->status, __ATOMIC_SEQ_CST);
+		__atomic_sub_fetch(&dap->trace_transfers_active, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+
+	if (__atomic_load_n(&dap->trace_enabled, __ATOMIC_SEQ_CST) &&
+			libusb_submit_transfer(transfer) == LIBUSB_SUCCESS)
+		return;
+
+	__atomic_sub_fetch(&dap->trace_transfers_active, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Cancel the stream transfers and wait for their callbacks */
+static void cmsis_dap_swo_stream_stop(struct cmsis_dap *dap)
+{
+	__atomic_store_n(&dap->trace_enabled, false, __ATOMIC_SEQ_CST);
+
+	for (int i = 0; i < SWO_TRANSFER_COUNT; i++) {
+		if (dap->trace_transfers[i])
+			libusb_cancel_transfer(dap->trace_transfers[i]);
+	}
+
+	while (__atomic_load_n(&dap->trace_transfers_active, __ATOMIC_SEQ_CST) > 0) {
+		if (libusb_handle_events(dap->usb_ctx) < 0)
+			break;
+	}
+
+	for (int i = 0; i < SWO_TRANSFER_COUNT; i++) {
+		if (dap->trace_transfers[i]) {
+			free(dap->trace_transfers[i]->buffer);
+			libusb_free_transfer(dap->trace_transfers[i]);
+			dap->trace_transfers[i] = NULL;
+		}
+	}
+	dap->trace_transfers_active = 0;
+}
+
+static int cmsis_dap_swo_stream_start(struct cmsis_dap *dap)
+{
+	if (!dap->trace_ring) {
+		dap->trace_ring = malloc(SWO_RING_SIZE);
+		if (!dap->trace_ring) {
+			LOG_ERROR("unable to allocate memory");
+			return ERROR_FAIL;
+		}
+	}
+	dap->trace_ring_head = 0;
+	dap->trace_ring_tail = 0;
+	dap->trace_overrun = false;
+	dap->trace_error = 0;
+	__atomic_store_n(&dap->trace_enabled, true, __ATOMIC_SEQ_CST);
+
+	for (int i = 0; i < SWO_TRANSFER_COUNT; i++) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		uint8_t *buffer = malloc(SWO_TRANSFER_SIZE);
+		if (!transfer || !buffer) {
+			LOG_ERROR("unable to allocate memory");
+			libusb_free_transfer(transfer);
+			free(buffer);
+			cmsis_dap_swo_stream_stop(dap);
+			return ERROR_FAIL;
+		}
+
+		libusb_fill_bulk_transfer(transfer, dap->dev_handle, dap->ep_swo,
+				buffer, SWO_TRANSFER_SIZE, cmsis_dap_swo_stream_cb, dap, USB_TIMEOUT);
+		dap->trace_transfers[i] = transfer;
+
+		/* counted first, the callback may already run in the USB thread */
+		__atomic_add_fetch(&dap->trace_transfers_active, 1, __ATOMIC_SEQ_CST);
+		int err = libusb_submit_transfer(transfer);
+		if (err != LIBUSB_SUCCESS) {
+			__atomic_sub_fetch(&dap->trace_transfers_active, 1, __ATOMIC_SEQ_CST);
+			LOG_ERROR("error submitting SWO stream transfer: %s", libusb_error_name(err));
+			cmsis_dap_swo_stream_stop(dap);
+			return ERROR_FAIL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_swo_stop(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (dap->trace_transport == DAP_SWO_TRANSPORT_NONE)
+		return ERROR_OK;
+
+	cmsis_dap_swo_stream_stop(dap);
+
+	int retval = cmsis_dap_cmd_DAP_SWO_Control(DAP_SWO_CONTROL_STOP);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_SWO_Mode(DAP_SWO_MODE_OFF);
+	if (retval == ERROR_OK)
+		retval = cmsis_dap_cmd_DAP_SWO_Transport(DAP_SWO_TRANSPORT_NONE);
+	dap->trace_transport = DAP_SWO_TRANSPORT_NONE;
+
+	return retval;
+}
+
+static int cmsis_dap_v2_config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
+		uint32_t port_size, unsigned int *trace_freq,
+		unsigned int traceclkin_freq, uint16_t *prescaler)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t mode;
+	uint32_t baudrate;
+	int retval;
+
+	if (!enabled)
+		return cmsis_dap_swo_stop();
+
+	if (pin_protocol == TPIU_PIN_PROTOCOL_ASYNC_UART && (dap->caps & INFO_CAPS_SWO_UART)) {
+		mode = DAP_SWO_MODE_UART;
+	} else if (pin_protocol == TPIU_PIN_PROTOCOL_ASYNC_MANCHESTER &&
+			(dap->caps & INFO_CAPS_SWO_MANCHESTER)) {
+		mode = DAP_SWO_MODE_MANCHESTER;
+	} else {
+		LOG_ERROR("The attached CMSIS-DAP adapter doesn't support this trace mode");
+		return ERROR_FAIL;
+	}
+
+	retval = cmsis_dap_swo_stop();
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint8_t transport = DAP_SWO_TRANSPORT_DATA;
+	if ((dap->caps & INFO_CAPS_SWO_STREAMING) && dap->ep_swo)
+		transport = DAP_SWO_TRANSPORT_STREAM;
+
+	retval = cmsis_dap_cmd_DAP_SWO_Transport(transport);
+	if (retval != ERROR_OK)
+		return retval;
+	dap->trace_transport = transport;
+
+	retval = cmsis_dap_cmd_DAP_SWO_Mode(mode);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* without a requested rate ask for TRACECLKIN, the adapter
+	 * answers with the closest rate it can capture */
+	retval = cmsis_dap_cmd_DAP_SWO_Baudrate(*trace_freq ? *trace_freq : traceclkin_freq,
+			&baudrate);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (!baudrate) {
+		LOG_ERROR("SWO frequency is not supported by the adapter");
+		return ERROR_FAIL;
+	}
+
+	uint32_t presc = traceclkin_freq / baudrate;
+	if (traceclkin_freq % baudrate > 0)
+		presc++;
+
+	if (presc == 0 || presc > TPIU_ACPR_MAX_SWOSCALER) {
+		LOG_ERROR("SWO frequency is not suitable. Please choose a different "
+			"frequency.");
+		return ERROR_FAIL;
+	}
+
+	if (traceclkin_freq / presc != baudrate)
+		LOG_WARNING("SWO output of %u Hz doesn't match the adapter baudrate of %" PRIu32 " Hz",
+			traceclkin_freq / presc, baudrate);
+
+	LOG_INFO("CMSIS-DAP: SWO capture at %" PRIu32 " Hz (%s)", baudrate,
+		transport == DAP_SWO_TRANSPORT_STREAM ? "streaming" : "polled");
+
+	*prescaler = presc;
+	*trace_freq = baudrate;
+
+	if (transport == DAP_SWO_TRANSPORT_STREAM) {
+		retval = cmsis_dap_swo_stream_start(dap);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return cmsis_dap_cmd_DAP_SWO_Control(DAP_SWO_CONTROL_START);
+}
+
+static int cmsis_dap_v2_poll_trace(uint8_t *buf, size_t *size)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (dap->trace_transport == DAP_SWO_TRANSPORT_DATA) {
+		uint8_t status;
+		int retval = cmsis_dap_cmd_DAP_SWO_Data(buf, size, &status);
+		if (retval != ERROR_OK) {
+			*size = 0;
+			return retval;
+		}
+		if (status & DAP_SWO_STATUS_OVERRUN)
+			LOG_WARNING("SWO trace buffer overrun, data lost");
+		if (status & DAP_SWO_STATUS_ERROR)
+			LOG_WARNING("SWO trace capture error");
+		return ERROR_OK;
+	}
+
+	if (dap->trace_transport != DAP_SWO_TRANSPORT_STREAM) {
+		*size = 0;
+		return ERROR_OK;
+	}
+
+	/* run the callbacks of the stream transfers that completed, unless
+	 * the USB thread does */
+	if (!cmsis_dap_usb_thread_active(dap)) {
+		struct timeval tv = { 0, 0 };
+		libusb_handle_events_timeout_completed(dap->usb_ctx, &tv, NULL);
+	}
+
+	int trace_error = __atomic_exchange_n(&dap->trace_error, 0, __ATOMIC_SEQ_CST);
+	if (trace_error)
+		LOG_ERROR("SWO stream transfer failed with status %d", trace_error);
+
+	if (__atomic_exchange_n(&dap->trace_overrun, false, __ATOMIC_SEQ_CST))
+		LOG_WARNING("SWO trace buffer overrun, data lost");
+
+	size_t count = 0;
+	size_t head = __atomic_load_n(&dap->trace_ring_head, __ATOMIC_SEQ_CST);
+	size_t tail = dap->trace_ring_tail;
+	while (count < *size && tail != head) {
+		buf[count++] = dap->trace_ring[tail];
+		tail = (tail + 1) % SWO_RING_SIZE;
+	}
+	__atomic_store_n(&dap->trace_ring_tail, tail, __ATOMIC_SEQ_CST);
+	*size = count;
+
+	if (!dap->trace_enabled ||
+			__atomic_load_n(&dap->trace_transfers_active, __ATOMIC_SEQ_CST) == 0) {
+		LOG_ERROR("SWO stream stopped");
+		dap->trace_transport = DAP_SWO_TRANSPORT_NONE;
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_quit(void)
 {
-    // TODO
-    return ERROR_OK;
+	cmsis_dap_swo_stop();
+	cmsis_dap_cmd_DAP_Disconnect();
+	/* Both LEDs off */
+	cmsis_dap_cmd_DAP_LED(LED_ID_RUN, LED_OFF);
+	cmsis_dap_cmd_DAP_LED(LED_ID_CONNECT, LED_OFF);
+
+	cmsis_dap_usb_close(cmsis_dap_handle);
+
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_reset(int srst, int trst)
 {
-    // TODO
-    return ERROR_OK;
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	/* Set both TRST and SRST even if they're not enabled as
+	 * there's no way to tristate them */
+
+	dap->output_pins = 0;
+	if (!srst)
+		dap->output_pins |= SWJ_PIN_SRST;
+	if (!trst)
+		dap->output_pins |= SWJ_PIN_TRST;
+
+	int retval = cmsis_dap_cmd_DAP_SWJ_Pins(dap->output_pins,
+			SWJ_PIN_TRST | SWJ_PIN_SRST, 0, NULL);
+	if (retval != ERROR_OK)
+		LOG_ERROR("CMSIS-DAP: Interface reset failed");
+	return retval;
 }
 
-static int cmsis_dap_v2_speed(int speed)
+/* Set new end state */
+static void cmsis_dap_end_state(tap_state_t state)
 {
-    // TODO
-    return ERROR_OK;
+	if (tap_is_state_stable(state))
+		tap_set_end_state(state);
+	else {
+		LOG_ERROR("BUG: %i is not a valid end state", state);
+		exit(-1);
+	}
 }
 
-static int cmsis_dap_v2_khz(int khz, int *jtag_speed)
+/* Send the batched commands, as one DAP_ExecuteCommands request if there
+ * are several, and copy the captured TDO bits into the client buffers */
+static int cmsis_dap_batch_flush(void)
 {
-    // TODO
-    return ERROR_OK;
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	uint8_t *buffer = dap->packet_buffer;
+	const uint8_t *response;
+	int txlen;
+
+	if (!dap->batch_count)
+		return ERROR_OK;
+
+	LOG_DEBUG_IO("Flushing %d batched commands (%d bytes) with %d pending scan results to capture",
+		dap->batch_count, dap->batch_len, dap->pending_scan_result_seq_start);
+
+	if (dap->batch_count > 1) {
+		buffer[0] = CMD_DAP_EXECUTE_COMMANDS;
+		buffer[1] = dap->batch_count;
+		memcpy(buffer + 2, dap->batch_buf, dap->batch_len);
+		txlen = dap->batch_len + 2;
+		/* responses follow the command byte and count */
+		response = buffer + 2;
+	} else {
+		memcpy(buffer, dap->batch_buf, dap->batch_len);
+		txlen = dap->batch_len;
+		response = buffer;
+	}
+
+	int retval = cmsis_dap_usb_xfer(dap, txlen);
+	if (retval == ERROR_OK && dap->batch_count > 1 &&
+			(buffer[0] != CMD_DAP_EXECUTE_COMMANDS || buffer[1] != dap->batch_count))
+		retval = ERROR_FAIL;
+
+	for (int i = 0; i < dap->batch_count && retval == ERROR_OK; i++) {
+		const uint8_t *r = response + dap->batch_resp_offset[i];
+		if (r[0] != dap->batch_cmd[i] || r[1] != DAP_OK) {
+			LOG_ERROR("CMSIS-DAP command 0x%02" PRIx8 " failed.", dap->batch_cmd[i]);
+			retval = ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		/* copy scan results into client buffers */
+		for (int i = 0; i < dap->pending_scan_result_seq_start; ++i) {
+			struct pending_scan_result *scan = &dap->pending_scan_results[i];
+			LOG_DEBUG_IO("Copying pending_scan_result %d/%d: %d bits from byte %d -> buffer + %d bits",
+				i, dap->pending_scan_result_seq_start, scan->length, scan->first, scan->buffer_offset);
+			bit_copy(scan->buffer, scan->buffer_offset, response + scan->first, 0, scan->length);
+		}
+	} else {
+		LOG_ERROR("CMSIS-DAP JTAG command batch failed.");
+		if (dap->queued_retval == ERROR_OK)
+			dap->queued_retval = retval;
+	}
+
+	/* scan results of the still open sequence move to the front */
+	dap->pending_scan_result_count -= dap->pending_scan_result_seq_start;
+	memmove(dap->pending_scan_results,
+		&dap->pending_scan_results[dap->pending_scan_result_seq_start],
+		dap->pending_scan_result_count * sizeof(struct pending_scan_result));
+	dap->pending_scan_result_seq_start = 0;
+
+	/* reset */
+	dap->batch_count = 0;
+	dap->batch_len = 0;
+	dap->batch_resp_len = 0;
+
+	return retval;
 }
 
-static int cmsis_dap_v2_speed_div(int speed, int *khz)
+/* Add a command of @a len bytes with a response of @a resp_len bytes to
+ * the batch, flushing it first if there is no room left. Returns where
+ * the command is to be encoded, with the command byte already set. */
+static uint8_t *cmsis_dap_batch_add(uint8_t cmd, int len, int resp_len)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (dap->batch_count && (!dap->execute_commands ||
+			dap->batch_count >= MAX_BATCH_COMMANDS ||
+			dap->batch_len + len + 2 > BATCH_BUF_LEN(dap) ||
+			dap->batch_resp_len + resp_len + 2 > BATCH_BUF_LEN(dap)))
+		cmsis_dap_batch_flush();
+
+	uint8_t *buffer = dap->batch_buf + dap->batch_len;
+	buffer[0] = cmd;
+
+	dap->batch_cmd[dap->batch_count] = cmd;
+	dap->batch_resp_offset[dap->batch_count] = dap->batch_resp_len;
+	dap->batch_count++;
+	dap->batch_len += len;
+	dap->batch_resp_len += resp_len;
+
+	return buffer;
+}
+
+/* Move the queued JTAG sequences into the batch as one CMD_DAP_JTAG_SEQ */
+static void cmsis_dap_jtag_seq_close(void)
 {
-    // TODO
-    return ERROR_OK;
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	if (!dap->queued_seq_count)
+		return;
+
+	LOG_DEBUG_IO("Batching %d queued sequences (%d bytes)",
+		dap->queued_seq_count, dap->queued_seq_buf_end);
+
+	uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_JTAG_SEQ,
+			dap->queued_seq_buf_end + 2, dap->queued_seq_tdo_ptr + 2);
+	buffer[1] = dap->queued_seq_count;
+	memcpy(buffer + 2, dap->queued_seq_buf, dap->queued_seq_buf_end);
+
+	/* TDO data follows the command and status bytes of the response */
+	int tdo_offset = dap->batch_resp_offset[dap->batch_count - 1] + 2;
+	for (int i = dap->pending_scan_result_seq_start; i < dap->pending_scan_result_count; ++i)
+		dap->pending_scan_results[i].first += tdo_offset;
+	dap->pending_scan_result_seq_start = dap->pending_scan_result_count;
+
+	dap->queued_seq_count = 0;
+	dap->queued_seq_buf_end = 0;
+	dap->queued_seq_tdo_ptr = 0;
 }
 
-static int cmsis_dap_v2_execute_queue(void)
+/* Batch a CMD_DAP_SWJ_SEQ, split into chunks of at most 256 bits */
+static void cmsis_dap_batch_swj_sequence(int s_len, const uint8_t *sequence)
 {
-    // TODO
-    return ERROR_OK;
+	cmsis_dap_jtag_seq_close();
+
+	for (int offset = 0; offset < s_len; offset += 256) {
+		int len = MIN(s_len - offset, 256);
+		uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_SWJ_SEQ, DIV_ROUND_UP(len, 8) + 2, 2);
+		buffer[1] = len & 0xff;	/* 0 means 256 */
+		bit_copy(&buffer[2], 0, sequence, offset, len);
+	}
 }
 
-static int cmsis_dap_v2_swd_init(void)
+static void cmsis_dap_batch_delay(uint16_t delay_us)
+{
+	cmsis_dap_jtag_seq_close();
+
+	uint8_t *buffer = cmsis_dap_batch_add(CMD_DAP_DELAY, 3, 2);
+	h_u16_to_le(&buffer[1], delay_us);
+}
+
+static void cmsis_dap_flush(void)
 {
-    // TODO
-    return ERROR_OK;
+	cmsis_dap_jtag_seq_close();
+	cmsis_dap_batch_flush();
 }
 
-static int cmsis_dap_v2_swd_switch_seq(enum swd_special_seq seq)
+static void cmsis_dap_execute_sleep(struct jtag_command *cmd)
 {
-    // TODO
-    return ERROR_OK;
+	/* short delays are done by the adapter, within the batch */
+	if (cmsis_dap_handle->execute_commands && cmd->cmd.sleep->us <= 0xffff) {
+		cmsis_dap_batch_delay(cmd->cmd.sleep->us);
+		return;
+	}
+
+	cmsis_dap_flush();
+	jtag_sleep(cmd->cmd.sleep->us);
 }
 
-static void cmsis_dap_v2_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+/* Set TMS high for five TCK clocks, to move the TAP to the Test-Logic-Reset state */
+static int cmsis_dap_execute_tlr_reset(struct jtag_command *cmd)
 {
-    // TODO
+	LOG_INFO("cmsis-dap JTAG TLR_RESET");
+	uint8_t seq = 0xff;
+	cmsis_dap_batch_swj_sequence(8, &seq);
+	tap_set_state(TAP_RESET);
+	return ERROR_OK;
 }
 
-static void cmsis_dap_v2_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+/* queue a sequence of bits to clock out TDI / in TDO, executing if the buffer is full.
+ *
+ * sequence=NULL means clock out zeros on TDI
+ * tdo_buffer=NULL means don't capture TDO
+ */
+static void cmsis_dap_add_jtag_sequence(int s_len, const uint8_t *sequence, int s_offset,
+					bool tms, uint8_t *tdo_buffer, int tdo_buffer_offset)
 {
-    // TODO
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	LOG_DEBUG_IO("[at %d] %d bits, tms %s, seq offset %d, tdo buf %p, tdo offset %d",
+		dap->queued_seq_buf_end,
+		s_len, tms ? "HIGH" : "LOW", s_offset, tdo_buffer, tdo_buffer_offset);
+
+	if (s_len == 0)
+		return;
+
+	if (s_len > 64) {
+		LOG_DEBUG_IO("START JTAG SEQ SPLIT");
+		for (int offset = 0; offset < s_len; offset += 64) {
+			int len = s_len - offset;
+			if (len > 64)
+				len = 64;
+			LOG_DEBUG_IO("Splitting long jtag sequence: %d-bit chunk starting at offset %d", len, offset);
+			cmsis_dap_add_jtag_sequence(
+				len,
+				sequence,
+				s_offset + offset,
+				tms,
+				tdo_buffer,
+				tdo_buffer == NULL ? 0 : (tdo_buffer_offset + offset)
+				);
+		}
+		LOG_DEBUG_IO("END JTAG SEQ SPLIT");
+		return;
+	}
+
+	int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
+	if (dap->queued_seq_count >= 255 || dap->queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN(dap))
+		/* the sequence is full, move it into the batch */
+		cmsis_dap_jtag_seq_close();
+	if (dap->pending_scan_result_count >= dap->pending_scan_result_max)
+		/* empty out the buffer */
+		cmsis_dap_flush();
+
+	++dap->queued_seq_count;
+
+	/* control byte */
+	dap->queued_seq_buf[dap->queued_seq_buf_end] =
+		(tms ? DAP_JTAG_SEQ_TMS : 0) |
+		(tdo_buffer != NULL ? DAP_JTAG_SEQ_TDO : 0) |
+		(s_len == 64 ? 0 : s_len);
+
+	if (sequence != NULL)
+		bit_copy(&dap->queued_seq_buf[dap->queued_seq_buf_end + 1], 0, sequence, s_offset, s_len);
+	else
+		memset(&dap->queued_seq_buf[dap->queued_seq_buf_end + 1], 0, DIV_ROUND_UP(s_len, 8));
+
+	dap->queued_seq_buf_end += cmd_len;
+
+	if (tdo_buffer != NULL) {
+		struct pending_scan_result *scan = &dap->pending_scan_results[dap->pending_scan_result_count++];
+		scan->first = dap->queued_seq_tdo_ptr;
+		dap->queued_seq_tdo_ptr += DIV_ROUND_UP(s_len, 8);
+		scan->length = s_len;
+		scan->buffer = tdo_buffer;
+		scan->buffer_offset = tdo_buffer_offset;
+	}
 }
 
-static int cmsis_dap_v2_swd_run_queue(void)
+/* queue a sequence of bits to clock out TMS, executing if the buffer is full */
+static void cmsis_dap_add_tms_sequence(const uint8_t *sequence, int s_len)
 {
-    // TODO
-    return ERROR_OK;
+	LOG_DEBUG_IO("%d bits: %02X", s_len, *sequence);
+	/* we use a series of CMD_DAP_JTAG_SEQ commands to toggle TMS,
+	   because even though it seems ridiculously inefficient, it
+	   allows us to combine TMS and scan sequences into the same
+	   USB packet. Runs of the same TMS value share one sequence. */
+	for (int i = 0; i < s_len;) {
+		bool bit = (sequence[i / 8] & (1 << (i % 8))) != 0;
+		int len = 1;
+		while (i + len < s_len && len < 64 &&
+				((sequence[(i + len) / 8] & (1 << ((i + len) % 8))) != 0) == bit)
+			len++;
+		cmsis_dap_add_jtag_sequence(len, NULL, 0, bit, NULL, 0);
+		i += len;
+	}
 }
 
-#if 0
-static int cmsis_dap_v2_swd_trace(bool swo)
+/* Move to the end state by queuing a sequence to clock into TMS */
+static void cmsis_dap_state_move(void)
 {
-    // TODO
-    return ERROR_OK;
+	uint8_t tms_scan;
+	uint8_t tms_scan_bits;
+
+	tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
+	tms_scan_bits = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
+
+	LOG_DEBUG_IO("state move from %s to %s: %d clocks, %02X on tms",
+		tap_state_name(tap_get_state()), tap_state_name(tap_get_end_state()),
+		tms_scan_bits, tms_scan);
+	cmsis_dap_add_tms_sequence(&tms_scan, tms_scan_bits);
+
+	tap_set_state(tap_get_end_state());
+}
+
+/* Execute a JTAG scan operation by queueing TMS and TDI/TDO sequences */
+static void cmsis_dap_execute_scan(struct jtag_command *cmd)
+{
+	LOG_DEBUG_IO("%s type:%d", cmd->cmd.scan->ir_scan ? "IRSCAN" : "DRSCAN",
+		jtag_scan_type(cmd->cmd.scan));
+
+	/* Make sure there are no trailing fields with num_bits == 0, or the logic below will fail. */
+	while (cmd->cmd.scan->num_fields > 0
+			&& cmd->cmd.scan->fields[cmd->cmd.scan->num_fields - 1].num_bits == 0) {
+		cmd->cmd.scan->num_fields--;
+		LOG_DEBUG("discarding trailing empty field");
+	}
+
+	if (cmd->cmd.scan->num_fields == 0) {
+		LOG_DEBUG("empty scan, doing nothing");
+		return;
+	}
+
+	if (cmd->cmd.scan->ir_scan) {
+		if (tap_get_state() != TAP_IRSHIFT) {
+			cmsis_dap_end_state(TAP_IRSHIFT);
+			cmsis_dap_state_move();
+		}
+	} else {
+		if (tap_get_state() != TAP_DRSHIFT) {
+			cmsis_dap_end_state(TAP_DRSHIFT);
+			cmsis_dap_state_move();
+		}
+	}
+
+	cmsis_dap_end_state(cmd->cmd.scan->end_state);
+
+	struct scan_field *field = cmd->cmd.scan->fields;
+	unsigned scan_size = 0;
+
+	for (int i = 0; i < cmd->cmd.scan->num_fields; i++, field++) {
+		scan_size += field->num_bits;
+		LOG_DEBUG_IO("%s%s field %d/%d %d bits",
+			field->in_value ? "in" : "",
+			field->out_value ? "out" : "",
+			i,
+			cmd->cmd.scan->num_fields,
+			field->num_bits);
+
+		if (i == cmd->cmd.scan->num_fields - 1 && tap_get_state() != tap_get_end_state()) {
+			LOG_DEBUG_IO("Last field and have to move out of SHIFT state");
+			/* Last field, and we're leaving IRSHIFT/DRSHIFT. Clock last bit during tap
+			 * movement. This last field can't have length zero, it was checked above. */
+			cmsis_dap_add_jtag_sequence(
+				field->num_bits - 1, /* number of bits to clock */
+				field->out_value, /* output sequence */
+				0, /* output offset */
+				false, /* TMS low */
+				field->in_value,
+				0);
+
+			/* Clock the last bit out, with TMS high */
+			uint8_t last_bit = 0;
+			if (field->out_value)
+				bit_copy(&last_bit, 0, field->out_value, field->num_bits - 1, 1);
+			cmsis_dap_add_jtag_sequence(
+				1,
+				&last_bit,
+				0,
+				true,
+				field->in_value,
+				field->num_bits - 1);
+			tap_set_state(tap_state_transition(tap_get_state(), 1));
+
+			/* Now clock one more cycle, with TMS low, to get us into a PAUSE state */
+			cmsis_dap_add_jtag_sequence(
+				1,
+				&last_bit,
+				0,
+				false,
+				NULL,
+				0);
+			tap_set_state(tap_state_transition(tap_get_state(), 0));
+		} else {
+			LOG_DEBUG_IO("Internal field, staying in SHIFT state afterwards");
+			/* Clocking part of a sequence into DR or IR with TMS=0,
+			   leaving TMS=0 at the end so we can continue later */
+			cmsis_dap_add_jtag_sequence(
+				field->num_bits,
+				field->out_value,
+				0,
+				false,
+				field->in_value,
+				0);
+		}
+	}
+
+	if (tap_get_state() != tap_get_end_state()) {
+		cmsis_dap_end_state(tap_get_end_state());
+		cmsis_dap_state_move();
+	}
+
+	LOG_DEBUG_IO("%s scan, %i bits, end in %s",
+		(cmd->cmd.scan->ir_scan) ? "IR" : "DR", scan_size,
+		tap_state_name(tap_get_end_state()));
+}
+
+static void cmsis_dap_pathmove(int num_states, tap_state_t *path)
+{
+	int i;
+	uint8_t tms0 = 0x00;
+	uint8_t tms1 = 0xff;
+
+	for (i = 0; i < num_states; i++) {
+		if (path[i] == tap_state_transition(tap_get_state(), false))
+			cmsis_dap_add_tms_sequence(&tms0, 1);
+		else if (path[i] == tap_state_transition(tap_get_state(), true))
+			cmsis_dap_add_tms_sequence(&tms1, 1);
+		else {
+			LOG_ERROR("BUG: %s -> %s isn't a valid TAP transition.",
+				  tap_state_name(tap_get_state()), tap_state_name(path[i]));
+			exit(-1);
+		}
+
+		tap_set_state(path[i]);
+	}
+
+	cmsis_dap_end_state(tap_get_state());
+}
+
+static void cmsis_dap_execute_pathmove(struct jtag_command *cmd)
+{
+	LOG_DEBUG_IO("pathmove: %i states, end in %i",
+		      cmd->cmd.pathmove->num_states,
+	       cmd->cmd.pathmove->path[cmd->cmd.pathmove->num_states - 1]);
+
+	cmsis_dap_pathmove(cmd->cmd.pathmove->num_states, cmd->cmd.pathmove->path);
+}
+
+static void cmsis_dap_stableclocks(int num_cycles)
+{
+	int i;
+
+	uint8_t tms = tap_get_state() == TAP_RESET;
+	/* Execute num_cycles. */
+	for (i = 0; i < num_cycles; i++)
+		cmsis_dap_add_tms_sequence(&tms, 1);
+}
+
+static void cmsis_dap_runtest(int num_cycles)
+{
+	tap_state_t saved_end_state = tap_get_end_state();
+
+	/* Only do a state_move when we're not already in IDLE. */
+	if (tap_get_state() != TAP_IDLE) {
+		cmsis_dap_end_state(TAP_IDLE);
+		cmsis_dap_state_move();
+	}
+	cmsis_dap_stableclocks(num_cycles);
+
+	/* Finish in end_state. */
+	cmsis_dap_end_state(saved_end_state);
+
+	if (tap_get_state() != tap_get_end_state())
+		cmsis_dap_state_move();
+}
+
+static void cmsis_dap_execute_runtest(struct jtag_command *cmd)
+{
+	LOG_DEBUG_IO("runtest %i cycles, end in %i", cmd->cmd.runtest->num_cycles,
+		      cmd->cmd.runtest->end_state);
+
+	cmsis_dap_end_state(cmd->cmd.runtest->end_state);
+	cmsis_dap_runtest(cmd->cmd.runtest->num_cycles);
+}
+
+static void cmsis_dap_execute_stableclocks(struct jtag_command *cmd)
+{
+	LOG_DEBUG_IO("stableclocks %i cycles", cmd->cmd.runtest->num_cycles);
+	cmsis_dap_stableclocks(cmd->cmd.runtest->num_cycles);
+}
+
+static void cmsis_dap_execute_tms(struct jtag_command *cmd)
+{
+	LOG_DEBUG_IO("TMS: %d bits", cmd->cmd.tms->num_bits);
+	cmsis_dap_batch_swj_sequence(cmd->cmd.tms->num_bits, cmd->cmd.tms->bits);
+}
+
+static void cmsis_dap_execute_command(struct jtag_command *cmd)
+{
+	switch (cmd->type) {
+		case JTAG_SLEEP:
+			cmsis_dap_execute_sleep(cmd);
+			break;
+		case JTAG_TLR_RESET:
+			cmsis_dap_execute_tlr_reset(cmd);
+			break;
+		case JTAG_SCAN:
+			cmsis_dap_execute_scan(cmd);
+			break;
+		case JTAG_PATHMOVE:
+			cmsis_dap_execute_pathmove(cmd);
+			break;
+		case JTAG_RUNTEST:
+			cmsis_dap_execute_runtest(cmd);
+			break;
+		case JTAG_STABLECLOCKS:
+			cmsis_dap_execute_stableclocks(cmd);
+			break;
+		case JTAG_TMS:
+			cmsis_dap_execute_tms(cmd);
+			break;
+		default:
+			LOG_ERROR("BUG: unknown JTAG command type 0x%X encountered", cmd->type);
+			exit(-1);
+	}
+}
+
+static int cmsis_dap_v2_execute_queue(void)
+{
+	struct jtag_command *cmd = jtag_command_queue;
+
+	while (cmd != NULL) {
+		cmsis_dap_execute_command(cmd);
+		cmd = cmd->next;
+	}
+
+	cmsis_dap_flush();
+
+	int retval = cmsis_dap_handle->queued_retval;
+	cmsis_dap_handle->queued_retval = ERROR_OK;
+
+	return retval;
+}
+
+static int cmsis_dap_v2_speed(int speed)
+{
+	if (speed > DAP_MAX_CLOCK && !jtag_get_speed_auto_max_khz())
+		LOG_INFO("High speed (adapter speed %d) may be limited by adapter firmware.", speed);
+
+	if (speed == 0) {
+		LOG_ERROR("RTCK not supported. Set nonzero \"adapter speed\".");
+		return ERROR_JTAG_NOT_IMPLEMENTED;
+	}
+
+	int retval = cmsis_dap_cmd_DAP_SWJ_Clock(speed);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the WAIT retries cover a fixed time, not a fixed count */
+	return cmsis_dap_tfer_configure(speed);
+}
+
+static int cmsis_dap_v2_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static int cmsis_dap_v2_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+/*
+ * dap_ops backend: DP and AP accesses go straight into the DAP_Transfer
+ * queue, the SWD request encoding and the posted read bookkeeping of
+ * adi_v5_swd.c are left to the adapter.
+ */
+
+/* Tell the adapter which TAP of the chain is the DAP */
+static int cmsis_dap_v2_jtag_configure(struct adiv5_dap *dap)
+{
+	uint8_t ir_lengths[255];
+	int count = 0;
+
+	cmsis_dap_handle->jtag_index = 0;
+	for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap) {
+		if (count == ARRAY_SIZE(ir_lengths)) {
+			LOG_ERROR("CMSIS-DAP: too many TAPs in the JTAG chain");
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+		if (tap == dap->tap)
+			cmsis_dap_handle->jtag_index = count;
+		ir_lengths[count++] = tap->ir_length;
+	}
+
+	return cmsis_dap_cmd_DAP_JTAG_Configure(count, ir_lengths);
 }
-#endif
 
 static int cmsis_dap_v2_dap_op_connect(struct adiv5_dap *dap)
 {
-    // TODO
-    return ERROR_OK;
+	uint32_t idcode = 0xdeadbeef;
+	int retval;
+
+	/* Check if we should reset srst already when connecting, but not if reconnecting. */
+	if (!dap->do_reconnect) {
+		enum reset_types jtag_reset_config = jtag_get_reset_config();
+
+		if (jtag_reset_config & RESET_CNCT_UNDER_SRST) {
+			if (jtag_reset_config & RESET_SRST_NO_GATING)
+				adapter_assert_reset();
+			else
+				LOG_WARNING("\'srst_nogate\' reset_config option is required");
+		}
+	}
+
+	if (swd_mode)
+		retval = cmsis_dap_swd_switch_seq(JTAG_TO_SWD);
+	else
+		retval = cmsis_dap_v2_jtag_configure(dap);
+	if (retval != ERROR_OK) {
+		dap->do_reconnect = true;
+		return retval;
+	}
+
+	/* Clear link state, including the SELECT cache. */
+	dap->do_reconnect = false;
+	dap_invalidate_cache(dap);
+
+	cmsis_dap_swd_read_reg(swd_cmd(true, false, DP_DPIDR), &idcode, 0);
+
+	/* force clear all sticky faults */
+	if (swd_mode)
+		cmsis_dap_swd_write_reg(swd_cmd(false, false, DP_ABORT),
+				STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
+
+	retval = cmsis_dap_swd_run_queue();
+	if (retval != ERROR_OK) {
+		dap->do_reconnect = true;
+		return retval;
+	}
+
+	LOG_INFO("%s %#8.8" PRIx32, swd_mode ? "SWD DPIDR" : "JTAG IDCODE", idcode);
+
+	retval = dap_dp_init(dap);
+	if (retval != ERROR_OK)
+		dap->do_reconnect = true;
+
+	return retval;
+}
+
+static int cmsis_dap_v2_check_reconnect(struct adiv5_dap *dap)
+{
+	if (dap->do_reconnect)
+		return cmsis_dap_v2_dap_op_connect(dap);
+
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
 {
-    // TODO
-    return ERROR_OK;
+	/* the adapter drives the JTAG state machine on its own */
+	if (!swd_mode)
+		return ERROR_OK;
+
+	return cmsis_dap_swd_switch_seq(seq);
+}
+
+static int cmsis_dap_v2_dap_op_queue_dp_write(struct adiv5_dap *dap, unsigned reg,
+		uint32_t data);
+
+/** Select the DP register bank matching bits 7:4 of reg. */
+static int cmsis_dap_v2_dp_bankselect(struct adiv5_dap *dap, unsigned reg)
+{
+	/* Only register address 4 is banked. */
+	if ((reg & 0xf) != 4)
+		return ERROR_OK;
+
+	uint32_t sel = ((reg & 0x000000F0) >> 4)
+			| (dap->select & (DP_SELECT_APSEL | DP_SELECT_APBANK));
+
+	if (sel == dap->select) {
+		dap->select_writes_skipped++;
+		return ERROR_OK;
+	}
+
+	return cmsis_dap_v2_dap_op_queue_dp_write(dap, DP_SELECT, sel);
+}
+
+/** Select the AP register bank matching bits 7:4 of reg. */
+static int cmsis_dap_v2_ap_bankselect(struct adiv5_ap *ap, unsigned reg)
+{
+	struct adiv5_dap *dap = ap->dap;
+	uint32_t sel = ((uint32_t)ap->ap_num << 24)
+			| (reg & 0x000000F0)
+			| (dap->select & DP_SELECT_DPBANK);
+
+	if (sel == dap->select) {
+		dap->select_writes_skipped++;
+		return ERROR_OK;
+	}
+
+	return cmsis_dap_v2_dap_op_queue_dp_write(dap, DP_SELECT, sel);
 }
 
 static int cmsis_dap_v2_dap_op_queue_dp_read(struct adiv5_dap *dap, unsigned reg,
 		uint32_t *data)
 {
-    // TODO
-    return ERROR_OK;
+	int retval = cmsis_dap_v2_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_v2_dp_bankselect(dap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	cmsis_dap_swd_read_reg(swd_cmd(true, false, reg), data, 0);
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_queue_dp_write(struct adiv5_dap *dap, unsigned reg,
 		uint32_t data)
 {
-    // TODO
-    return ERROR_OK;
+	int retval = cmsis_dap_v2_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (reg == DP_SELECT) {
+		dap->select = data & (DP_SELECT_APSEL | DP_SELECT_APBANK | DP_SELECT_DPBANK);
+	} else {
+		retval = cmsis_dap_v2_dp_bankselect(dap, reg);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	cmsis_dap_swd_write_reg(swd_cmd(false, false, reg), data, 0);
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 		uint32_t *data)
 {
-    // TODO
-    return ERROR_OK;
+	struct adiv5_dap *dap = ap->dap;
+
+	int retval = cmsis_dap_v2_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_v2_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the result lands in data directly, no RDBUFF read is needed */
+	cmsis_dap_swd_read_reg(swd_cmd(true, true, reg), data, ap->memaccess_tck);
+	return ERROR_OK;
+}
+
+static int cmsis_dap_v2_dap_op_queue_ap_read_match(struct adiv5_ap *ap, unsigned reg,
+		uint32_t mask, uint32_t match)
+{
+	struct adiv5_dap *dap = ap->dap;
+
+	int retval = cmsis_dap_v2_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_v2_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	cmsis_dap_swd_read_reg_match(swd_cmd(true, true, reg), mask, match, ap->memaccess_tck);
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_queue_ap_write(struct adiv5_ap *ap, unsigned reg,
 		uint32_t data)
 {
-    // TODO
-    return ERROR_OK;
+	struct adiv5_dap *dap = ap->dap;
+
+	int retval = cmsis_dap_v2_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = cmsis_dap_v2_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	cmsis_dap_swd_write_reg(swd_cmd(false, true, reg), data, ap->memaccess_tck);
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 {
-    // TODO
-    return ERROR_OK;
+	uint32_t abort = DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR;
+
+	if (swd_mode) {
+		cmsis_dap_swd_write_reg(swd_cmd(false, false, DP_ABORT), abort, 0);
+		return ERROR_OK;
+	}
+
+	/* ABORT of a JTAG-DP is behind its own IR instruction, which
+	 * DAP_Transfer can't reach. Send what is queued first so the order
+	 * holds, and keep its result for the next run. */
+	int retval = cmsis_dap_swd_run_queue();
+
+	if (cmsis_dap_cmd_DAP_WriteABORT(cmsis_dap_handle->jtag_index, abort) != ERROR_OK
+			&& retval == ERROR_OK)
+		retval = ERROR_JTAG_DEVICE_ERROR;
+
+	cmsis_dap_handle->queued_retval = retval;
+	return ERROR_OK;
 }
 
 static int cmsis_dap_v2_dap_op_run(struct adiv5_dap *dap)
 {
-    // TODO
-    return ERROR_OK;
+	int retval = cmsis_dap_swd_run_queue();
+
+	/* a value which did not match is no fault */
+	if (retval != ERROR_OK && retval != ERROR_TIMEOUT_REACHED) {
+		/* fault response */
+		dap->do_reconnect = true;
+	}
+
+	return retval;
 }
 
+/* Responses are collected on run(), here only the ones that already
+ * arrived are taken so that the FIFO keeps moving between batches. */
 static int cmsis_dap_v2_dap_op_sync(struct adiv5_dap *dap)
 {
-    // TODO
-    return ERROR_OK;
+	struct cmsis_dap *cmsis_dap = cmsis_dap_handle;
+
+	while (cmsis_dap->pending_fifo_block_count) {
+		int count = cmsis_dap->pending_fifo_block_count;
+		cmsis_dap_swd_read_process(cmsis_dap, false);
+		if (cmsis_dap->pending_fifo_block_count == count)
+			break;
+	}
+
+	return cmsis_dap->queued_retval;
 }
 
+/** Put the SWJ-DP back to JTAG mode */
 static void cmsis_dap_v2_dap_op_quit(struct adiv5_dap *dap)
 {
-    // TODO
+	if (swd_mode)
+		cmsis_dap_swd_switch_seq(SWD_TO_JTAG);
+	/* flush the queue before exit */
+	cmsis_dap_swd_run_queue();
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_info_command)
+{
+	if (cmsis_dap_get_version_info() == ERROR_OK)
+		cmsis_dap_get_status();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_cmd_command)
+{
+	int retval;
+	unsigned i;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > cmsis_dap_handle->packet_size)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (i = 0; i < CMD_ARGC; i++)
+		buffer[i] = strtoul(CMD_ARGV[i], NULL, 16);
+
+	retval = cmsis_dap_usb_xfer(cmsis_dap_handle, CMD_ARGC);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("CMSIS-DAP command failed.");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	LOG_INFO("Returned data %02" PRIx8 " %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
+		buffer[1], buffer[2], buffer[3], buffer[4]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_vid_pid_command)
+{
+	if (CMD_ARGC > MAX_USB_IDS * 2) {
+		LOG_WARNING("ignoring extra IDs in cmsis_dap_vid_pid "
+			"(maximum is %d pairs)", MAX_USB_IDS);
+		CMD_ARGC = MAX_USB_IDS * 2;
+	}
+	if (CMD_ARGC < 2 || (CMD_ARGC & 1)) {
+		LOG_WARNING("incomplete cmsis_dap_vid_pid configuration directive");
+		if (CMD_ARGC < 2)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		/* remove the incomplete trailing id */
+		CMD_ARGC -= 1;
+	}
+
+	unsigned i;
+	for (i = 0; i < CMD_ARGC; i += 2) {
+		COMMAND_PARSE_NUMBER(u16, CMD_ARGV[i], cmsis_dap_vid[i >> 1]);
+		COMMAND_PARSE_NUMBER(u16, CMD_ARGV[i + 1], cmsis_dap_pid[i >> 1]);
+	}
+
+	/*
+	 * Explicitly terminate, in case there are multiples instances of
+	 * cmsis_dap_vid_pid.
+	 */
+	cmsis_dap_vid[i >> 1] = cmsis_dap_pid[i >> 1] = 0;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_usb_thread_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], cmsis_dap_usb_thread_enabled);
+
+	command_print(CMD, "cmsis-dap USB thread is %s",
+			cmsis_dap_usb_thread_enabled ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_reconnect_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], cmsis_dap_reconnect_enabled);
+
+	command_print(CMD, "cmsis-dap reconnect is %s",
+			cmsis_dap_reconnect_enabled ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_serial_command)
+{
+	if (CMD_ARGC < 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > MAX_USB_SERIALS) {
+		LOG_WARNING("ignoring extra serials in cmsis_dap_serial "
+			"(maximum is %d)", MAX_USB_SERIALS);
+		CMD_ARGC = MAX_USB_SERIALS;
+	}
+
+	for (int i = 0; cmsis_dap_serial[i] != NULL; i++) {
+		free(cmsis_dap_serial[i]);
+		cmsis_dap_serial[i] = NULL;
+	}
+
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		cmsis_dap_serial[i] = strdup(CMD_ARGV[i]);
+		if (cmsis_dap_serial[i] == NULL) {
+			LOG_ERROR("unable to allocate memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_probes_command)
+{
+	struct libusb_context *ctx;
+	struct libusb_device **devs;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (libusb_init(&ctx) != LIBUSB_SUCCESS) {
+		LOG_ERROR("unable to initialize libusb");
+		return ERROR_FAIL;
+	}
+
+	ssize_t num_devs = libusb_get_device_list(ctx, &devs);
+	if (num_devs < 0) {
+		LOG_ERROR("unable to get the list of USB devices");
+		libusb_exit(ctx);
+		return ERROR_FAIL;
+	}
+
+	int count = 0;
+	for (ssize_t i = 0; i < num_devs; i++) {
+		struct libusb_device_handle *dev_handle;
+		char serial_str[256];
+		int interface;
+		unsigned int ep_out, ep_in, ep_swo;
+		uint16_t packet_size;
+
+		if (!cmsis_dap_usb_open_device(devs[i], NULL, &dev_handle,
+				serial_str, sizeof(serial_str), &interface,
+				&ep_out, &ep_in, &ep_swo, &packet_size))
+			continue;
+
+		/* the interface is claimed by this instance or by another one */
+		const char *state = "free";
+		if (cmsis_dap_handle != NULL && cmsis_dap_handle->dev_handle != NULL &&
+				cmsis_dap_usb_same_device(libusb_get_device(cmsis_dap_handle->dev_handle),
+					devs[i]))
+			state = "in use here";
+		else if (libusb_claim_interface(dev_handle, interface) != LIBUSB_SUCCESS)
+			state = "in use";
+		else
+			libusb_release_interface(dev_handle, interface);
+
+		command_print(CMD, "%s %s", serial_str[0] ? serial_str : "(no serial)", state);
+		libusb_close(dev_handle);
+		count++;
+	}
+
+	libusb_free_device_list(devs, 1);
+	libusb_exit(ctx);
+
+	if (count == 0)
+		command_print(CMD, "no CMSIS-DAP v2 device found");
+
+	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_stats_command)
+{
+	struct cmsis_dap_stats *stats = &cmsis_dap_handle->stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	uint64_t capacity = stats->packets * BATCH_BUF_LEN(cmsis_dap_handle);
+
+	command_print(CMD, "packets:      %" PRIu64 " of %d bytes", stats->packets,
+			BATCH_BUF_LEN(cmsis_dap_handle));
+	if (!stats->packets)
+		return ERROR_OK;
+
+	command_print(CMD, "transfers:    %" PRIu64 ", %.1f per packet", stats->transfers,
+			(double)stats->transfers / stats->packets);
+	command_print(CMD, "request fill: %.1f%% (%" PRIu64 " bytes)",
+			100.0 * stats->request_bytes / capacity, stats->request_bytes);
+	if (stats->responses)
+		command_print(CMD, "reply fill:   %.1f%% (%" PRIu64 " bytes)",
+				100.0 * stats->response_bytes /
+					(stats->responses * BATCH_BUF_LEN(cmsis_dap_handle)),
+				stats->response_bytes);
+	command_print(CMD, "WAIT:         %" PRIu64 ", %" PRIu64 " resubmitted",
+			stats->waits, stats->resubmits);
+	command_print(CMD, "FAULT:        %" PRIu64, stats->faults);
+	command_print(CMD, "other errors: %" PRIu64, stats->errors - stats->waits - stats->faults);
+	if (stats->reconnects)
+		command_print(CMD, "reconnects:   %" PRIu64, stats->reconnects);
 
-static const char * const cmsis_dap_v2_transport[] = { "swd", "jtag", NULL };
+	uint64_t round_trips = 0;
+	for (int i = 0; i < STATS_LATENCY_BUCKETS; i++)
+		round_trips += stats->latency[i];
+	if (!round_trips)
+		return ERROR_OK;
+
+	command_print(CMD, "round trip:   %" PRIu64 " us average, %" PRIu64 " us max",
+			stats->latency_us_total / round_trips, stats->latency_us_max);
+	for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+		if (!stats->latency[i])
+			continue;
+		unsigned long low = i ? 1UL << i : 0;
+		if (i == STATS_LATENCY_BUCKETS - 1)
+			command_print(CMD, "  >= %lu us: %" PRIu64, low, stats->latency[i]);
+		else
+			command_print(CMD, "  %lu - %lu us: %" PRIu64, low, (1UL << (i + 1)) - 1,
+					stats->latency[i]);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration cmsis_dap_subcommand_handlers[] = {
+	{
+		.name = "info",
+		.handler = &cmsis_dap_handle_info_command,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "show cmsis-dap info",
+	},
+	{
+		.name = "cmd",
+		.handler = &cmsis_dap_handle_cmd_command,
+		.mode = COMMAND_EXEC,
+		.usage = "byte [byte ...]",
+		.help = "issue cmsis-dap command",
+	},
+	{
+		.name = "stats",
+		.handler = &cmsis_dap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "show or reset SWD transfer queue statistics",
+	},
+	{
+		.name = "probes",
+		.handler = &cmsis_dap_handle_probes_command,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "list the serials of the attached CMSIS-DAP v2 devices",
+	},
+	COMMAND_REGISTRATION_DONE
+};
 
 static const struct command_registration cmsis_dap_v2_command_handlers[] = {
-    #if 0
-    {
-        .name = "cmsis-dap",
-        .mode = COMMAND_ANY,
-        .help = "perform CMSIS-DAP management",
-        .usage = "<cmd>",
-        .chain = cmsis_dap_subcommand_handlers,
-    },
-    {
-        .name = "cmsis_dap_vid_pid",
-        .handler = &cmsis_dap_handle_vid_pid_command,
-        .mode = COMMAND_CONFIG,
-        .help = "the vendor ID and product ID of the CMSIS-DAP device",
-        .usage = "(vid pid)* ",
-    },
-    {
-        .name = "cmsis_dap_serial",
-        .handler = &cmsis_dap_handle_serial_command,
-        .mode = COMMAND_CONFIG,
-        .help = "set the serial number of the adapter",
-        .usage = "serial_string",
-    },
-    #endif
-    COMMAND_REGISTRATION_DONE
+	{
+		.name = "cmsis-dap",
+		.mode = COMMAND_ANY,
+		.help = "perform CMSIS-DAP management",
+		.usage = "<cmd>",
+		.chain = cmsis_dap_subcommand_handlers,
+	},
+	{
+		.name = "cmsis_dap_vid_pid",
+		.handler = &cmsis_dap_handle_vid_pid_command,
+		.mode = COMMAND_CONFIG,
+		.help = "the vendor ID and product ID of the CMSIS-DAP device",
+		.usage = "(vid pid)* ",
+	},
+	{
+		.name = "cmsis_dap_serial",
+		.handler = &cmsis_dap_handle_serial_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the serial number of the adapter, or a list of "
+			"serials to use the first free one of",
+		.usage = "serial_string [serial_string ...]",
+	},
+	{
+		.name = "cmsis_dap_usb_thread",
+		.handler = &cmsis_dap_handle_usb_thread_command,
+		.mode = COMMAND_CONFIG,
+		.help = "handle the USB events of the adapter in a thread of their own",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "cmsis_dap_reconnect",
+		.handler = &cmsis_dap_handle_reconnect_command,
+		.mode = COMMAND_ANY,
+		.help = "look for the adapter again when it was unplugged or reset",
+		.usage = "['on'|'off']",
+	},
+	COMMAND_REGISTRATION_DONE
 };
 
+static const char * const cmsis_dap_v2_transport[] = { "swd", "jtag", "dapdirect_swd", "dapdirect_jtag", NULL };
+
 static struct jtag_interface cmsis_dap_v2_jtag_interface = {
-    .supported = DEBUG_CAP_TMS_SEQ,
-    .execute_queue = cmsis_dap_v2_execute_queue,
+	.supported = DEBUG_CAP_TMS_SEQ,
+	.execute_queue = cmsis_dap_v2_execute_queue,
 };
 
 static const struct swd_driver cmsis_dap_v2_swd_driver = {
-    .init = cmsis_dap_v2_swd_init,
-    .switch_seq = cmsis_dap_v2_swd_switch_seq,
-    .read_reg = cmsis_dap_v2_swd_read_reg,
-    .write_reg = cmsis_dap_v2_swd_write_reg,
-    .run = cmsis_dap_v2_swd_run_queue,
-    .trace = NULL,
+	.init = cmsis_dap_v2_swd_init,
+	.switch_seq = cmsis_dap_swd_switch_seq,
+	.read_reg = cmsis_dap_swd_read_reg,
+	.write_reg = cmsis_dap_swd_write_reg,
+	.read_reg_match = cmsis_dap_swd_read_reg_match,
+	.run = cmsis_dap_swd_run_queue,
 };
 
 static struct dap_ops cmsis_dap_v2_dap_ops = {
-    .connect = cmsis_dap_v2_dap_op_connect,
-    .send_sequence = cmsis_dap_v2_dap_op_send_sequence,
-    .queue_dp_read = cmsis_dap_v2_dap_op_queue_dp_read,
-    .queue_dp_write = cmsis_dap_v2_dap_op_queue_dp_write,
-    .queue_ap_read = cmsis_dap_v2_dap_op_queue_ap_read,
-    .queue_ap_write = cmsis_dap_v2_dap_op_queue_ap_write,
-    .queue_ap_abort = cmsis_dap_v2_dap_op_queue_ap_abort,
-    .run = cmsis_dap_v2_dap_op_run,
-    .sync = cmsis_dap_v2_dap_op_sync, /* optional */
-    .quit = cmsis_dap_v2_dap_op_quit, /* optional */
+	.connect = cmsis_dap_v2_dap_op_connect,
+	.send_sequence = cmsis_dap_v2_dap_op_send_sequence,
+	.queue_dp_read = cmsis_dap_v2_dap_op_queue_dp_read,
+	.queue_dp_write = cmsis_dap_v2_dap_op_queue_dp_write,
+	.queue_ap_read = cmsis_dap_v2_dap_op_queue_ap_read,
+	.queue_ap_write = cmsis_dap_v2_dap_op_queue_ap_write,
+	.queue_ap_abort = cmsis_dap_v2_dap_op_queue_ap_abort,
+	.queue_ap_read_match = cmsis_dap_v2_dap_op_queue_ap_read_match,
+	.run = cmsis_dap_v2_dap_op_run,
+	.sync = cmsis_dap_v2_dap_op_sync, /* optional */
+	.quit = cmsis_dap_v2_dap_op_quit, /* optional */
 };
 
 struct adapter_driver cmsis_dap_v2_adapter_driver = {
-    .name = "cmsis-dap-v2",
-    .transports = cmsis_dap_v2_transport,
-    .commands = cmsis_dap_v2_command_handlers,
-
-    .init = cmsis_dap_v2_init,
-    .quit = cmsis_dap_v2_quit,
-    .reset = cmsis_dap_v2_reset,
-    .speed = cmsis_dap_v2_speed,
-    .khz = cmsis_dap_v2_khz,
-    .speed_div = cmsis_dap_v2_speed_div,
-
-    .jtag_ops = &cmsis_dap_v2_jtag_interface,
-    .swd_ops = &cmsis_dap_v2_swd_driver,
+	.name = "cmsis-dap-v2",
+	.transports = cmsis_dap_v2_transport,
+	.commands = cmsis_dap_v2_command_handlers,
+
+	.init = cmsis_dap_v2_init,
+	.quit = cmsis_dap_v2_quit,
+	.reset = cmsis_dap_v2_reset,
+	.speed = cmsis_dap_v2_speed,
+	.khz = cmsis_dap_v2_khz,
+	.speed_div = cmsis_dap_v2_speed_div,
+	.config_trace = cmsis_dap_v2_config_trace,
+	.poll_trace = cmsis_dap_v2_poll_trace,
+
+	.jtag_ops = &cmsis_dap_v2_jtag_interface,
+	.swd_ops = &cmsis_dap_v2_swd_driver,
 	.dap_jtag_ops = &cmsis_dap_v2_dap_ops,
 	.dap_swd_ops = &cmsis_dap_v2_dap_ops,
 };
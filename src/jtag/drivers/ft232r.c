@@ -103,6 +103,185 @@ static size_t ft232r_buf_size = FT232R_BUF_SIZE_EXTRA;
  */
 static uint16_t ft232r_restore_bitmode = 0xFFFF;
 
+/*
+ * The IN endpoint prefixes each USB packet with two bytes of modem and
+ * line status. In sync bitbang mode the chip only clocks out a byte when
+ * its RX FIFO has room for the sampled one, so with a read always pending
+ * the OUT transfers can be much larger than the FIFOs.
+ */
+#define FT232R_PACKET_SIZE	64
+#define FT232R_XFER_SIZE	4096
+#define FT232R_XFER_TIMEOUT	1000
+/* Unsent bytes from which the stream is started while the queue is built. */
+#define FT232R_PUMP_SIZE	FT232R_XFER_SIZE
+/* Buffered bytes from which the stream is completed and the scans read. */
+#define FT232R_FLUSH_SIZE	(64 * 1024)
+
+/* Scan whose TDO bits are still in the stream. */
+struct ft232r_scan {
+	struct scan_command *cmd;
+	uint8_t *buffer;
+	size_t bit0_index;
+	int scan_size;
+};
+
+/* Asynchronous transfers of ft232r_output[] to and from the adapter. */
+static struct {
+	struct libusb_transfer *out[2];
+	bool out_busy[2];
+	uint8_t out_buf[2][FT232R_XFER_SIZE];
+	struct libusb_transfer *in;
+	bool in_busy;
+	uint8_t in_buf[FT232R_XFER_SIZE];
+	size_t total_written;
+	size_t total_read;
+	int retval;
+} ft232r_stream;
+
+static struct ft232r_scan *ft232r_scans;
+static unsigned int ft232r_nb_scans;
+static unsigned int ft232r_max_scans;
+
+/* Output byte for each TCK << 2 | TMS << 1 | TDI, set up by ft232r_init(). */
+static uint8_t ft232r_pattern[8];
+/* Two output bytes per bit of each TDI byte, shifted with TMS low. */
+static uint8_t ft232r_tdi_pattern[256][16];
+
+static void ft232r_init_patterns(void)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(ft232r_pattern); i++) {
+		uint8_t out_value = (1<<ntrst_gpio) | (1<<nsysrst_gpio);
+		if (i & 4)
+			out_value |= (1<<tck_gpio);
+		if (i & 2)
+			out_value |= (1<<tms_gpio);
+		if (i & 1)
+			out_value |= (1<<tdi_gpio);
+		ft232r_pattern[i] = out_value;
+	}
+
+	for (unsigned int tdi = 0; tdi < 256; tdi++)
+		for (unsigned int bit = 0; bit < 8; bit++) {
+			unsigned int tdi_bit = (tdi >> bit) & 1;
+			ft232r_tdi_pattern[tdi][bit * 2] = ft232r_pattern[tdi_bit];
+			ft232r_tdi_pattern[tdi][bit * 2 + 1] = ft232r_pattern[4 | tdi_bit];
+		}
+}
+
+static void ft232r_submit_in(void);
+
+static LIBUSB_CALL void ft232r_out_cb(struct libusb_transfer *transfer)
+{
+	bool *busy = transfer->user_data;
+
+	*busy = false;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED
+			|| transfer->actual_length != transfer->length) {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			LOG_ERROR("usb bulk write failed");
+		ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+		return;
+	}
+	adapter_stats_usb(transfer->actual_length);
+}
+
+static LIBUSB_CALL void ft232r_in_cb(struct libusb_transfer *transfer)
+{
+	ft232r_stream.in_busy = false;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			LOG_ERROR("usb bulk read failed");
+		ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+		return;
+	}
+	adapter_stats_usb(transfer->actual_length);
+
+	for (int i = 0; i < transfer->actual_length; i += FT232R_PACKET_SIZE) {
+		/* Copy data, ignoring first 2 bytes of each packet. */
+		int n = MIN(FT232R_PACKET_SIZE, transfer->actual_length - i) - 2;
+		if (n <= 0)
+			continue;
+		if (ft232r_stream.total_read + n > ft232r_stream.total_written) {
+			LOG_ERROR("read more bytes than wrote");
+			ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+			return;
+		}
+		memcpy(ft232r_output + ft232r_stream.total_read, transfer->buffer + i + 2, n);
+		ft232r_stream.total_read += n;
+	}
+
+	if (ft232r_stream.total_read < ft232r_stream.total_written)
+		ft232r_submit_in();
+}
+
+static void ft232r_submit_in(void)
+{
+	if (ft232r_stream.in_busy || ft232r_stream.retval != ERROR_OK)
+		return;
+
+	libusb_fill_bulk_transfer(ft232r_stream.in, adapter, OUT_EP,
+		ft232r_stream.in_buf, sizeof(ft232r_stream.in_buf),
+		ft232r_in_cb, NULL, FT232R_XFER_TIMEOUT);
+	if (libusb_submit_transfer(ft232r_stream.in) != LIBUSB_SUCCESS) {
+		LOG_ERROR("usb bulk read failed");
+		ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+		return;
+	}
+	ft232r_stream.in_busy = true;
+}
+
+/**
+ * Submit the unsent part of ft232r_output[] to the free OUT transfers,
+ * keeping a read pending while sampled bytes are outstanding.
+ */
+static void ft232r_submit(void)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(ft232r_stream.out); i++) {
+		if (ft232r_stream.out_busy[i])
+			continue;
+		size_t n = ft232r_output_len - ft232r_stream.total_written;
+		if (n == 0 || ft232r_stream.retval != ERROR_OK)
+			break;
+		if (n > FT232R_XFER_SIZE)
+			n = FT232R_XFER_SIZE;
+
+		/* ft232r_output[] may be reallocated while the transfer runs */
+		memcpy(ft232r_stream.out_buf[i], ft232r_output + ft232r_stream.total_written, n);
+		libusb_fill_bulk_transfer(ft232r_stream.out[i], adapter, IN_EP,
+			ft232r_stream.out_buf[i], n, ft232r_out_cb,
+			&ft232r_stream.out_busy[i], FT232R_XFER_TIMEOUT);
+		if (libusb_submit_transfer(ft232r_stream.out[i]) != LIBUSB_SUCCESS) {
+			LOG_ERROR("usb bulk write failed");
+			ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+			break;
+		}
+		ft232r_stream.out_busy[i] = true;
+		ft232r_stream.total_written += n;
+	}
+
+	if (ft232r_stream.total_read < ft232r_stream.total_written)
+		ft232r_submit_in();
+}
+
+static bool ft232r_stream_busy(void)
+{
+	return ft232r_stream.in_busy || ft232r_stream.out_busy[0] || ft232r_stream.out_busy[1];
+}
+
+/* Cancel the transfers in flight and wait for their callbacks. */
+static void ft232r_stream_cancel(void)
+{
+	if (ft232r_stream.in_busy)
+		libusb_cancel_transfer(ft232r_stream.in);
+	for (unsigned int i = 0; i < ARRAY_SIZE(ft232r_stream.out); i++)
+		if (ft232r_stream.out_busy[i])
+			libusb_cancel_transfer(ft232r_stream.out[i]);
+
+	while (ft232r_stream_busy())
+		if (jtag_libusb_handle_events_timeout(FT232R_XFER_TIMEOUT) != ERROR_OK)
+			break;
+}
+
 /**
  * Perform sync bitbang output/input transaction.
  * Before call, an array ft232r_output[] should be filled with data to send.
@@ -111,63 +290,52 @@ static uint16_t ft232r_restore_bitmode = 0xFFFF;
  */
 static int ft232r_send_recv(void)
 {
-	/* FIFO TX buffer has 128 bytes.
-	 * FIFO RX buffer has 256 bytes.
-	 * First two bytes of received packet contain contain modem
-	 * and line status and are ignored.
-	 * Unfortunately, transfer sizes bigger than 64 bytes
-	 * frequently cause hang ups. */
-	assert(ft232r_output_len > 0);
-
-	size_t total_written = 0;
-	size_t total_read = 0;
-	int rxfifo_free = 128;
-
-	while (total_read < ft232r_output_len) {
-		/* Write */
-		int bytes_to_write = ft232r_output_len - total_written;
-		if (bytes_to_write > 64)
-			bytes_to_write = 64;
-		if (bytes_to_write > rxfifo_free)
-			bytes_to_write = rxfifo_free;
-
-		if (bytes_to_write) {
-			int n;
-
-			if (jtag_libusb_bulk_write(adapter, IN_EP,
-						   (char *) ft232r_output + total_written,
-						   bytes_to_write, 1000, &n) != ERROR_OK) {
-				LOG_ERROR("usb bulk write failed");
-				return ERROR_JTAG_DEVICE_ERROR;
-			}
+	int64_t progress = timeval_ms();
 
-			total_written += n;
-			rxfifo_free -= n;
-		}
-
-		/* Read */
-		uint8_t reply[64];
-		int n;
+	while (ft232r_stream.retval == ERROR_OK
+			&& ft232r_stream.total_read < ft232r_output_len) {
+		size_t total_read = ft232r_stream.total_read;
 
-		if (jtag_libusb_bulk_read(adapter, OUT_EP, (char *) reply,
-					  sizeof(reply), 1000, &n) != ERROR_OK) {
-			LOG_ERROR("usb bulk read failed");
-			return ERROR_JTAG_DEVICE_ERROR;
+		ft232r_submit();
+		int retval = jtag_libusb_handle_events_timeout(FT232R_XFER_TIMEOUT);
+		if (retval != ERROR_OK) {
+			ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
+			break;
 		}
-		if (n > 2) {
-			/* Copy data, ignoring first 2 bytes. */
-			memcpy(ft232r_output + total_read, reply + 2, n - 2);
-			int bytes_read = n - 2;
-			total_read += bytes_read;
-			rxfifo_free += bytes_read;
-			if (total_read > total_written) {
-				LOG_ERROR("read more bytes than wrote");
-				return ERROR_JTAG_DEVICE_ERROR;
-			}
+
+		/* the status packets keep the read completing, watch the data */
+		int64_t now = timeval_ms();
+		if (ft232r_stream.total_read != total_read) {
+			progress = now;
+		} else if (now - progress > FT232R_XFER_TIMEOUT) {
+			LOG_ERROR("usb bulk read timed out");
+			ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
 		}
 	}
+
+	int retval = ft232r_stream.retval;
+	if (retval != ERROR_OK)
+		ft232r_stream_cancel();
+
+	ft232r_stream.total_written = 0;
+	ft232r_stream.total_read = 0;
+	ft232r_stream.retval = ERROR_OK;
 	ft232r_output_len = 0;
-	return ERROR_OK;
+	return retval;
+}
+
+/**
+ * Start sending the queue built so far, so that the adapter shifts it
+ * while the next commands are being added.
+ */
+static void ft232r_pump(void)
+{
+	if (ft232r_output_len - ft232r_stream.total_written < FT232R_PUMP_SIZE)
+		return;
+
+	ft232r_submit();
+	if (jtag_libusb_handle_events_timeout(0) != ERROR_OK)
+		ft232r_stream.retval = ERROR_JTAG_DEVICE_ERROR;
 }
 
 void ft232r_increase_buf_size(size_t new_buf_size)
@@ -188,14 +356,6 @@ void ft232r_increase_buf_size(size_t new_buf_size)
  */
 static void ft232r_write(int tck, int tms, int tdi)
 {
-	unsigned out_value = (1<<ntrst_gpio) | (1<<nsysrst_gpio);
-	if (tck)
-		out_value |= (1<<tck_gpio);
-	if (tms)
-		out_value |= (1<<tms_gpio);
-	if (tdi)
-		out_value |= (1<<tdi_gpio);
-
 	ft232r_increase_buf_size(ft232r_output_len);
 
 	if (ft232r_output_len >= ft232r_buf_size) {
@@ -203,14 +363,55 @@ static void ft232r_write(int tck, int tms, int tdi)
 		LOG_ERROR("ft232r_write: buffer overflow");
 		return;
 	}
-	ft232r_output[ft232r_output_len++] = out_value;
+	ft232r_output[ft232r_output_len++] = ft232r_pattern[(tck ? 4 : 0) | (tms ? 2 : 0) | (tdi ? 1 : 0)];
+}
+
+/**
+ * Deliver the TDO bits of the scans completed by ft232r_send_recv().
+ * @returns ERROR_JTAG_QUEUE_FAILED when a check of a scan failed.
+ */
+static int ft232r_read_scans(int retval)
+{
+	for (unsigned int i = 0; i < ft232r_nb_scans; i++) {
+		struct ft232r_scan *scan = &ft232r_scans[i];
+
+		if (retval == ERROR_OK) {
+			for (int bit_cnt = 0; bit_cnt < scan->scan_size; bit_cnt++) {
+				int bytec = bit_cnt/8;
+				int bcval = 1 << (bit_cnt % 8);
+				int val = ft232r_output[scan->bit0_index + bit_cnt*2 + 1];
+
+				if (val & (1<<tdo_gpio))
+					scan->buffer[bytec] |= bcval;
+				else
+					scan->buffer[bytec] &= ~bcval;
+			}
+			if (jtag_read_buffer(scan->buffer, scan->cmd) != ERROR_OK)
+				retval = ERROR_JTAG_QUEUE_FAILED;
+		}
+		free(scan->buffer);
+	}
+	ft232r_nb_scans = 0;
+	return retval;
+}
+
+/**
+ * Complete the stream and the scans waiting for it.
+ */
+static int ft232r_flush(void)
+{
+	int retval = ERROR_OK;
+
+	if (ft232r_output_len > 0)
+		retval = ft232r_send_recv();
+	return ft232r_read_scans(retval);
 }
 
 /**
  * Control /TRST and /SYSRST pins.
  * Perform immediate bitbang transaction.
  */
-static void ft232r_reset(int trst, int srst)
+static int ft232r_reset(int trst, int srst)
 {
 	unsigned out_value = (1<<ntrst_gpio) | (1<<nsysrst_gpio);
 	LOG_DEBUG("ft232r_reset(%d,%d)", trst, srst);
@@ -230,11 +431,11 @@ static void ft232r_reset(int trst, int srst)
 	if (ft232r_output_len >= ft232r_buf_size) {
 		/* FIXME: should we just execute queue here? */
 		LOG_ERROR("ft232r_write: buffer overflow");
-		return;
+		return ERROR_FAIL;
 	}
 
 	ft232r_output[ft232r_output_len++] = out_value;
-	ft232r_send_recv();
+	return ft232r_flush();
 }
 
 static int ft232r_speed(int divisor)
@@ -315,6 +516,16 @@ static int ft232r_init(void)
 		return ERROR_JTAG_INIT_FAILED;
 	}
 
+	ft232r_stream.in = libusb_alloc_transfer(0);
+	ft232r_stream.out[0] = libusb_alloc_transfer(0);
+	ft232r_stream.out[1] = libusb_alloc_transfer(0);
+	if (!ft232r_stream.in || !ft232r_stream.out[0] || !ft232r_stream.out[1]) {
+		LOG_ERROR("Unable to allocate the USB transfers");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	ft232r_init_patterns();
+
 	return ERROR_OK;
 }
 
@@ -330,6 +541,18 @@ static int ft232r_quit(void)
 		}
 	}
 
+	ft232r_stream_cancel();
+	libusb_free_transfer(ft232r_stream.in);
+	libusb_free_transfer(ft232r_stream.out[0]);
+	libusb_free_transfer(ft232r_stream.out[1]);
+	ft232r_stream.in = NULL;
+	ft232r_stream.out[0] = NULL;
+	ft232r_stream.out[1] = NULL;
+
+	free(ft232r_scans);
+	ft232r_scans = NULL;
+	ft232r_max_scans = 0;
+
 	if (libusb_release_interface(adapter, 0) != 0)
 		LOG_ERROR("usb release interface failed");
 
@@ -763,10 +986,15 @@ static void syncbb_stableclocks(int num_cycles)
 	}
 }
 
-static void syncbb_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int scan_size)
+/**
+ * Add a scan of @a scan_size bits to the stream. The TDO bits of a scan
+ * which reads are delivered by ft232r_flush(), which then frees @a buffer.
+ */
+static int syncbb_scan(struct scan_command *cmd, enum scan_type type, uint8_t *buffer, int scan_size)
 {
 	tap_state_t saved_end_state = tap_get_end_state();
-	int bit_cnt, bit0_index;
+	bool ir_scan = cmd->ir_scan;
+	size_t bit0_index;
 
 	if (!((!ir_scan && (tap_get_state() == TAP_DRSHIFT)) || (ir_scan && (tap_get_state() == TAP_IRSHIFT)))) {
 		if (ir_scan)
@@ -779,22 +1007,30 @@ static void syncbb_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 	}
 
 	bit0_index = ft232r_output_len;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
+	ft232r_increase_buf_size(ft232r_output_len + 2 * scan_size);
+	if (ft232r_output_len + 2 * scan_size > ft232r_buf_size) {
+		LOG_ERROR("ft232r_write: buffer overflow");
+		free(buffer);
+		return ERROR_FAIL;
+	}
 
-		ft232r_write(0, tms, tdi);
-		ft232r_write(1, tms, tdi);
+	/* if we're just reading the scan, but don't care about the output
+	 * default to outputting 'low', this also makes valgrind traces more readable,
+	 * as it removes the dependency on an uninitialised value
+	 */
+	uint8_t *out = ft232r_output + ft232r_output_len;
+	for (int bit_cnt = 0; bit_cnt < scan_size; bit_cnt += 8) {
+		uint8_t tdi = (type != SCAN_IN) ? buffer[bit_cnt/8] : 0;
+		int n = MIN(8, scan_size - bit_cnt);
+
+		memcpy(out, ft232r_tdi_pattern[tdi], 2 * n);
+		out += 2 * n;
+	}
+	ft232r_output_len += 2 * scan_size;
+	if (scan_size > 0) {
+		/* TMS high on the last bit leaves the shift state */
+		ft232r_output[ft232r_output_len - 2] |= 1 << tms_gpio;
+		ft232r_output[ft232r_output_len - 1] |= 1 << tms_gpio;
 	}
 
 	if (tap_get_state() != tap_get_end_state()) {
@@ -804,19 +1040,31 @@ static void syncbb_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 		 */
 		syncbb_state_move(1);
 	}
-	ft232r_send_recv();
 
-	if (type != SCAN_OUT)
-		for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-			int bytec = bit_cnt/8;
-			int bcval = 1 << (bit_cnt % 8);
-			int val = ft232r_output[bit0_index + bit_cnt*2 + 1];
+	if (type == SCAN_OUT) {
+		int retval = jtag_read_buffer(buffer, cmd);
+		free(buffer);
+		return (retval == ERROR_OK) ? ERROR_OK : ERROR_JTAG_QUEUE_FAILED;
+	}
 
-			if (val & (1<<tdo_gpio))
-				buffer[bytec] |= bcval;
-			else
-				buffer[bytec] &= ~bcval;
+	if (ft232r_nb_scans == ft232r_max_scans) {
+		unsigned int max_scans = ft232r_max_scans ? 2 * ft232r_max_scans : 64;
+		struct ft232r_scan *scans = realloc(ft232r_scans, max_scans * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Unable to allocate memory for the scans");
+			free(buffer);
+			return ERROR_FAIL;
 		}
+		ft232r_scans = scans;
+		ft232r_max_scans = max_scans;
+	}
+	ft232r_scans[ft232r_nb_scans++] = (struct ft232r_scan) {
+		.cmd = cmd,
+		.buffer = buffer,
+		.bit0_index = bit0_index,
+		.scan_size = scan_size,
+	};
+	return ERROR_OK;
 }
 
 static int syncbb_execute_queue(void)
@@ -844,7 +1092,8 @@ static int syncbb_execute_queue(void)
 					(jtag_get_reset_config() & RESET_SRST_PULLS_TRST))) {
 					tap_set_state(TAP_RESET);
 				}
-				ft232r_reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst);
+				if (ft232r_reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst) != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				break;
 
 			case JTAG_RUNTEST:
@@ -883,29 +1132,36 @@ static int syncbb_execute_queue(void)
 				syncbb_end_state(cmd->cmd.scan->end_state);
 				scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
 				type = jtag_scan_type(cmd->cmd.scan);
-				syncbb_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size);
-				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
+				if (syncbb_scan(cmd->cmd.scan, type, buffer, scan_size) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				free(buffer);
 				break;
 
 			case JTAG_SLEEP:
 				LOG_DEBUG_IO("sleep %" PRIu32, cmd->cmd.sleep->us);
 
+				if (ft232r_flush() != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				jtag_sleep(cmd->cmd.sleep->us);
 				break;
 
 			case JTAG_TMS:
-				retval = syncbb_execute_tms(cmd);
+				if (syncbb_execute_tms(cmd) != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				break;
 			default:
 				LOG_ERROR("BUG: unknown JTAG command type encountered");
 				exit(-1);
 		}
-		if (ft232r_output_len > 0)
-			ft232r_send_recv();
+		if (ft232r_output_len >= FT232R_FLUSH_SIZE) {
+			if (ft232r_flush() != ERROR_OK)
+				retval = ERROR_JTAG_QUEUE_FAILED;
+		} else {
+			ft232r_pump();
+		}
 		cmd = cmd->next;
 	}
+	if (ft232r_flush() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
 /*	ft232r_blink(0);*/
 
 	return retval;
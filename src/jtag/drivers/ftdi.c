@@ -72,6 +72,7 @@
 #include <jtag/drivers/jtag_usb_common.h>
 #include <jtag/interface.h>
 #include <jtag/swd.h>
+#include <target/arm_adi_v5.h>
 #include <transport/transport.h>
 #include <helper/time_support.h>
 
@@ -92,6 +93,7 @@ static char *ftdi_device_desc;
 static char *ftdi_serial;
 static uint8_t ftdi_channel;
 static uint8_t ftdi_jtag_mode = JTAG_MODE;
+static bool ftdi_double_buffer;
 
 static bool swd_mode;
 
@@ -119,10 +121,20 @@ static struct signal *signals;
 static struct swd_cmd_queue_entry {
 	uint8_t cmd;
 	uint32_t *dst;
+	uint32_t data;
+	uint32_t ap_delay_clk;
+	/* overrun detection was on, a WAIT can be replayed */
+	bool replayable;
 	uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
 } *swd_cmd_queue;
 static size_t swd_cmd_queue_length;
 static size_t swd_cmd_queue_alloced;
+/* DP state as left by the queued transactions. With CTRL/STAT.ORUNDETECT
+ * set, WAIT and FAULT responses keep their data phase, so the rest of a
+ * queue stays in sync with the target and can be sent again. */
+static uint8_t swd_dp_bank;
+static bool swd_orundetect;
+#define FTDI_SWD_MAX_WAIT_REPLAYS 100
 static int queued_retval;
 static int freq;
 
@@ -662,6 +674,8 @@ static int ftdi_initialize(void)
 	if (!mpsse_ctx)
 		return ERROR_JTAG_INIT_FAILED;
 
+	mpsse_set_double_buffer(mpsse_ctx, ftdi_double_buffer);
+
 	output = jtag_output_init;
 	direction = jtag_direction_init;
 
@@ -929,6 +943,22 @@ COMMAND_HANDLER(ftdi_handle_tdo_sample_edge_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(ftdi_handle_double_buffer_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], ftdi_double_buffer);
+		if (mpsse_ctx)
+			mpsse_set_double_buffer(mpsse_ctx, ftdi_double_buffer);
+	}
+
+	command_print(CMD, "ftdi double buffering is %s", ftdi_double_buffer ? "on" : "off");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration ftdi_command_handlers[] = {
 	{
 		.name = "ftdi_device_desc",
@@ -997,6 +1027,14 @@ static const struct command_registration ftdi_command_handlers[] = {
 			"allow signalling speed increase)",
 		.usage = "(rising|falling)",
 	},
+	{
+		.name = "ftdi_double_buffer",
+		.handler = &ftdi_handle_double_buffer_command,
+		.mode = COMMAND_ANY,
+		.help = "send a full MPSSE buffer to the adapter while the next "
+			"one is being filled",
+		.usage = "['on'|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1060,36 +1098,62 @@ static void ftdi_swd_swdio_en(bool enable)
 	}
 }
 
-/**
- * Flush the MPSSE queue and process the SWD transaction queue
- * @param dap
- * @return
- */
-static int ftdi_swd_run_queue(void)
+/* Emit the MPSSE clocking of a queued transaction */
+static void ftdi_swd_clock_cmd(struct swd_cmd_queue_entry *e)
 {
-	LOG_DEBUG_IO("Executing %zu queued transactions", swd_cmd_queue_length);
-	int retval;
-	struct signal *led = find_signal_by_name("LED");
+	mpsse_clock_data_out(mpsse_ctx, &e->cmd, 0, 8, SWD_MODE);
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG_IO("Skipping due to previous errors: %d", queued_retval);
-		goto skip;
+	if (e->cmd & SWD_CMD_RnW) {
+		/* Queue a read transaction */
+		ftdi_swd_swdio_en(false);
+		mpsse_clock_data_in(mpsse_ctx, e->trn_ack_data_parity_trn,
+				0, 1 + 3 + 32 + 1 + 1, SWD_MODE);
+		ftdi_swd_swdio_en(true);
+	} else {
+		/* Queue a write transaction */
+		ftdi_swd_swdio_en(false);
+
+		mpsse_clock_data_in(mpsse_ctx, e->trn_ack_data_parity_trn,
+				0, 1 + 3 + 1, SWD_MODE);
+
+		ftdi_swd_swdio_en(true);
+
+		buf_set_u32(e->trn_ack_data_parity_trn, 1 + 3 + 1, 32, e->data);
+		buf_set_u32(e->trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(e->data));
+
+		mpsse_clock_data_out(mpsse_ctx, e->trn_ack_data_parity_trn,
+				1 + 3 + 1, 32 + 1, SWD_MODE);
 	}
 
-	/* A transaction must be followed by another transaction or at least 8 idle cycles to
-	 * ensure that data is clocked through the AP. */
-	mpsse_clock_data_out(mpsse_ctx, NULL, 0, 8, SWD_MODE);
+	/* Insert idle cycles after AP accesses to avoid WAIT */
+	if (e->cmd & SWD_CMD_APnDP)
+		mpsse_clock_data_out(mpsse_ctx, NULL, 0, e->ap_delay_clk, SWD_MODE);
+}
 
-	/* Terminate the "blink", if the current layout has that feature */
-	if (led)
-		ftdi_set_signal(led, '0');
+/* Follow the DP writes that decide whether overrun detection is on */
+static void ftdi_swd_track_dp(uint8_t cmd, uint32_t data)
+{
+	if (cmd & (SWD_CMD_APnDP | SWD_CMD_RnW))
+		return;
 
-	queued_retval = mpsse_flush(mpsse_ctx);
-	if (queued_retval != ERROR_OK) {
-		LOG_ERROR("MPSSE failed");
-		goto skip;
+	switch ((cmd & SWD_CMD_A32) >> 1) {
+	case DP_SELECT:
+		swd_dp_bank = data & DP_SELECT_DPBANK;
+		break;
+	case DP_CTRL_STAT:
+		if (swd_dp_bank == 0)
+			swd_orundetect = data & CORUNDETECT;
+		break;
 	}
+}
 
+/**
+ * Check the ACKs and hand out the read data of the executed queue
+ * @param failed set to the index of the first transaction that did not complete
+ * @return ERROR_OK, ERROR_WAIT, or ERROR_FAIL on FAULT, junk ACK or parity error
+ */
+static int ftdi_swd_process_queue(size_t *failed)
+{
 	for (size_t i = 0; i < swd_cmd_queue_length; i++) {
 		int ack = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1, 3);
 
@@ -1101,9 +1165,10 @@ static int ftdi_swd_run_queue(void)
 				buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn,
 						1 + 3 + (swd_cmd_queue[i].cmd & SWD_CMD_RnW ? 0 : 1), 32));
 
+		*failed = i;
+
 		if (ack != SWD_ACK_OK) {
-			queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
-			goto skip;
+			return ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 
 		} else if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
 			uint32_t data = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3, 32);
@@ -1111,8 +1176,7 @@ static int ftdi_swd_run_queue(void)
 
 			if (parity != parity_u32(data)) {
 				LOG_ERROR("SWD Read data parity mismatch");
-				queued_retval = ERROR_FAIL;
-				goto skip;
+				return ERROR_FAIL;
 			}
 
 			if (swd_cmd_queue[i].dst != NULL)
@@ -1120,6 +1184,93 @@ static int ftdi_swd_run_queue(void)
 		}
 	}
 
+	return ERROR_OK;
+}
+
+/**
+ * Queue again the transactions from @a first on, after a WAIT on it. With
+ * overrun detection these all got WAIT or FAULT and had no effect, but left
+ * STICKYORUN set, so an ABORT write clearing it goes first.
+ */
+static int ftdi_swd_requeue(size_t first)
+{
+	size_t count = swd_cmd_queue_length - first;
+
+	/* No MPSSE command points into the queue anymore, it can move */
+	if (first == 0 && swd_cmd_queue_length == swd_cmd_queue_alloced) {
+		struct swd_cmd_queue_entry *q = realloc(swd_cmd_queue, swd_cmd_queue_alloced * 2 * sizeof(*swd_cmd_queue));
+		if (q == NULL)
+			return ERROR_FAIL;
+		swd_cmd_queue = q;
+		swd_cmd_queue_alloced *= 2;
+	}
+	memmove(&swd_cmd_queue[1], &swd_cmd_queue[first], count * sizeof(*swd_cmd_queue));
+
+	swd_cmd_queue[0].cmd = swd_cmd(false, false, DP_ABORT) | SWD_CMD_START | SWD_CMD_PARK;
+	swd_cmd_queue[0].dst = NULL;
+	swd_cmd_queue[0].data = ORUNERRCLR;
+	swd_cmd_queue[0].ap_delay_clk = 0;
+	swd_cmd_queue[0].replayable = false;
+	swd_cmd_queue_length = count + 1;
+
+	for (size_t i = 0; i < swd_cmd_queue_length; i++)
+		ftdi_swd_clock_cmd(&swd_cmd_queue[i]);
+
+	return ERROR_OK;
+}
+
+/**
+ * Flush the MPSSE queue and process the SWD transaction queue
+ *
+ * The whole queue goes out as one MPSSE program, assuming every ACK is OK.
+ * When a transaction gets WAIT with overrun detection on, the queue is
+ * replayed from there; otherwise the first failure is returned.
+ * @param dap
+ * @return
+ */
+static int ftdi_swd_run_queue(void)
+{
+	LOG_DEBUG_IO("Executing %zu queued transactions", swd_cmd_queue_length);
+	int retval;
+	struct signal *led = find_signal_by_name("LED");
+
+	if (queued_retval != ERROR_OK) {
+		LOG_DEBUG_IO("Skipping due to previous errors: %d", queued_retval);
+		goto skip;
+	}
+
+	/* Terminate the "blink", if the current layout has that feature */
+	if (led)
+		ftdi_set_signal(led, '0');
+
+	for (unsigned int replays = 0; ; replays++) {
+		/* A transaction must be followed by another transaction or at least 8 idle cycles to
+		 * ensure that data is clocked through the AP. */
+		mpsse_clock_data_out(mpsse_ctx, NULL, 0, 8, SWD_MODE);
+
+		queued_retval = mpsse_flush(mpsse_ctx);
+		if (queued_retval != ERROR_OK) {
+			LOG_ERROR("MPSSE failed");
+			goto skip;
+		}
+
+		size_t failed;
+		queued_retval = ftdi_swd_process_queue(&failed);
+		if (queued_retval != ERROR_WAIT || !swd_cmd_queue[failed].replayable)
+			break;
+
+		if (replays == FTDI_SWD_MAX_WAIT_REPLAYS) {
+			LOG_DEBUG("SWD still WAIT after %u replays", replays);
+			break;
+		}
+
+		LOG_DEBUG_IO("SWD WAIT, replaying %zu transactions",
+				swd_cmd_queue_length - failed);
+		queued_retval = ftdi_swd_requeue(failed);
+		if (queued_retval != ERROR_OK)
+			break;
+	}
+
 skip:
 	swd_cmd_queue_length = 0;
 	retval = queued_retval;
@@ -1134,6 +1285,8 @@ skip:
 
 static void ftdi_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk)
 {
+	adapter_stats_scan(46 + ap_delay_clk);
+
 	if (swd_cmd_queue_length >= swd_cmd_queue_alloced) {
 		/* Not enough room in the queue. Run the queue and increase its size for next time.
 		 * Note that it's not possible to avoid running the queue here, because mpsse contains
@@ -1150,39 +1303,15 @@ static void ftdi_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32
 	if (queued_retval != ERROR_OK)
 		return;
 
-	size_t i = swd_cmd_queue_length++;
-	swd_cmd_queue[i].cmd = cmd | SWD_CMD_START | SWD_CMD_PARK;
-
-	mpsse_clock_data_out(mpsse_ctx, &swd_cmd_queue[i].cmd, 0, 8, SWD_MODE);
-
-	if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
-		/* Queue a read transaction */
-		swd_cmd_queue[i].dst = dst;
-
-		ftdi_swd_swdio_en(false);
-		mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				0, 1 + 3 + 32 + 1 + 1, SWD_MODE);
-		ftdi_swd_swdio_en(true);
-	} else {
-		/* Queue a write transaction */
-		ftdi_swd_swdio_en(false);
-
-		mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				0, 1 + 3 + 1, SWD_MODE);
-
-		ftdi_swd_swdio_en(true);
-
-		buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1, 32, data);
-		buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(data));
-
-		mpsse_clock_data_out(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				1 + 3 + 1, 32 + 1, SWD_MODE);
-	}
-
-	/* Insert idle cycles after AP accesses to avoid WAIT */
-	if (cmd & SWD_CMD_APnDP)
-		mpsse_clock_data_out(mpsse_ctx, NULL, 0, ap_delay_clk, SWD_MODE);
+	struct swd_cmd_queue_entry *e = &swd_cmd_queue[swd_cmd_queue_length++];
+	e->cmd = cmd | SWD_CMD_START | SWD_CMD_PARK;
+	e->dst = dst;
+	e->data = data;
+	e->ap_delay_clk = ap_delay_clk;
+	e->replayable = swd_orundetect;
 
+	ftdi_swd_track_dp(cmd, data);
+	ftdi_swd_clock_cmd(e);
 }
 
 static void ftdi_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
@@ -1207,6 +1336,8 @@ static int ftdi_swd_switch_seq(enum swd_special_seq seq)
 		break;
 	case JTAG_TO_SWD:
 		LOG_DEBUG("JTAG-to-SWD");
+		/* the DP may have been reset, wait for CTRL/STAT to be written */
+		swd_orundetect = false;
 		ftdi_swd_swdio_en(true);
 		mpsse_clock_data_out(mpsse_ctx, swd_seq_jtag_to_swd, 0, swd_seq_jtag_to_swd_len, SWD_MODE);
 		break;
@@ -59,9 +59,12 @@ static enum jaylink_target_interface iface = JAYLINK_TIF_JTAG;
 static bool trace_enabled;
 
 #define JLINK_MAX_SPEED			12000
+/* Buffer size used when the device cannot tell its free memory */
 #define JLINK_TAP_BUFFER_SIZE	2048
+/* Transfer lengths are 16-bit bit counts */
+#define JLINK_TAP_BUFFER_MAX	8191
 
-static unsigned int swd_buffer_size = JLINK_TAP_BUFFER_SIZE;
+static unsigned int tap_buffer_size = JLINK_TAP_BUFFER_SIZE;
 
 /* Maximum SWO frequency deviation. */
 #define SWO_MAX_FREQ_DEV	0.03
@@ -459,11 +462,12 @@ static int jlink_register(void)
 }
 
 /*
- * Adjust the SWD transaction buffer size depending on the free device internal
- * memory. This ensures that the SWD transactions sent to the device do not
- * exceed the internal memory of the device.
+ * Adjust the JTAG/SWD transaction buffer size depending on the free device
+ * internal memory. This ensures that the transactions sent to the device do
+ * not exceed the internal memory of the device, and lets devices with more
+ * memory take larger transfers.
  */
-static bool adjust_swd_buffer_size(void)
+static bool adjust_tap_buffer_size(void)
 {
 	int ret;
 	uint32_t tmp;
@@ -484,12 +488,12 @@ static bool adjust_swd_buffer_size(void)
 		return false;
 	}
 
-	tmp = MIN(JLINK_TAP_BUFFER_SIZE, (tmp - 16) / 2);
+	tmp = MIN(JLINK_TAP_BUFFER_MAX, (tmp - 16) / 2);
 
-	if (tmp != swd_buffer_size) {
-		swd_buffer_size = tmp;
-		LOG_DEBUG("Adjusted SWD transaction buffer size to %u bytes.",
-			swd_buffer_size);
+	if (tmp != tap_buffer_size) {
+		tap_buffer_size = tmp;
+		LOG_DEBUG("Adjusted transaction buffer size to %u bytes.",
+			tap_buffer_size);
 	}
 
 	return true;
@@ -740,18 +744,16 @@ static int jlink_init(void)
 			jtag_command_version = JAYLINK_JTAG_VERSION_3;
 	}
 
-	if (iface == JAYLINK_TIF_SWD) {
-		/*
-		 * Adjust the SWD transaction buffer size in case there is already
-		 * allocated memory on the device. This happens for example if the
-		 * memory for SWO capturing is still allocated because the software
-		 * which used the device before has not been shut down properly.
-		 */
-		if (!adjust_swd_buffer_size()) {
-			jaylink_close(devh);
-			jaylink_exit(jayctx);
-			return ERROR_JTAG_INIT_FAILED;
-		}
+	/*
+	 * Size the transaction buffer from the free device memory. This also
+	 * accounts for already allocated memory on the device, for example if
+	 * the memory for SWO capturing is still allocated because the software
+	 * which used the device before has not been shut down properly.
+	 */
+	if (!adjust_tap_buffer_size()) {
+		jaylink_close(devh);
+		jaylink_exit(jayctx);
+		return ERROR_JTAG_INIT_FAILED;
 	}
 
 	if (jaylink_has_cap(caps, JAYLINK_DEV_CAP_READ_CONFIG)) {
@@ -1340,10 +1342,10 @@ static int config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
 
 	if (!enabled) {
 		/*
-		 * Adjust the SWD transaction buffer size as stopping SWO capturing
+		 * Adjust the transaction buffer size as stopping SWO capturing
 		 * deallocates device internal memory.
 		 */
-		if (!adjust_swd_buffer_size())
+		if (!adjust_tap_buffer_size())
 			return ERROR_FAIL;
 
 		return ERROR_OK;
@@ -1421,10 +1423,10 @@ static int config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
 		buffer_size);
 
 	/*
-	 * Adjust the SWD transaction buffer size as starting SWO capturing
+	 * Adjust the transaction buffer size as starting SWO capturing
 	 * allocates device internal memory.
 	 */
-	if (!adjust_swd_buffer_size())
+	if (!adjust_tap_buffer_size())
 		return ERROR_FAIL;
 
 	return ERROR_OK;
@@ -1989,9 +1991,9 @@ static void jlink_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_c
 
 static unsigned tap_length;
 /* In SWD mode use tms buffer for direction control */
-static uint8_t tms_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdi_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdo_buffer[JLINK_TAP_BUFFER_SIZE];
+static uint8_t tms_buffer[JLINK_TAP_BUFFER_MAX];
+static uint8_t tdi_buffer[JLINK_TAP_BUFFER_MAX];
+static uint8_t tdo_buffer[JLINK_TAP_BUFFER_MAX];
 
 struct pending_scan_result {
 	/** First bit position in tdo_buffer to read. */
@@ -2004,7 +2006,8 @@ struct pending_scan_result {
 	unsigned buffer_offset;
 };
 
-#define MAX_PENDING_SCAN_RESULTS 256
+/* Enough for the shortest SWD transactions in a full buffer */
+#define MAX_PENDING_SCAN_RESULTS (JLINK_TAP_BUFFER_MAX * 8 / 46 + 1)
 
 static int pending_scan_results_length;
 static struct pending_scan_result pending_scan_results_buffer[MAX_PENDING_SCAN_RESULTS];
@@ -2023,13 +2026,14 @@ static void jlink_clock_data(const uint8_t *out, unsigned out_offset,
 			     unsigned length)
 {
 	do {
-		unsigned available_length = JLINK_TAP_BUFFER_SIZE - tap_length / 8;
+		unsigned available_length = tap_length < tap_buffer_size * 8 ?
+			tap_buffer_size * 8 - tap_length : 0;
 
 		if (!available_length ||
 		    (in && pending_scan_results_length == MAX_PENDING_SCAN_RESULTS)) {
 			if (jlink_flush() != ERROR_OK)
 				return;
-			available_length = JLINK_TAP_BUFFER_SIZE;
+			available_length = tap_buffer_size * 8;
 		}
 
 		struct pending_scan_result *pending_scan_result =
@@ -2078,6 +2082,8 @@ static int jlink_flush(void)
 		jlink_tap_init();
 		return ERROR_JTAG_QUEUE_FAILED;
 	}
+	/* TMS and TDI out, TDO in */
+	adapter_stats_usb(3 * DIV_ROUND_UP(tap_length, 8));
 
 	for (i = 0; i < pending_scan_results_length; i++) {
 		struct pending_scan_result *p = &pending_scan_results_buffer[i];
@@ -2183,6 +2189,8 @@ static int jlink_swd_run_queue(void)
 		LOG_ERROR("jaylink_swd_io() failed: %s.", jaylink_strerror(ret));
 		goto skip;
 	}
+	/* direction and data out, data in */
+	adapter_stats_usb(3 * DIV_ROUND_UP(tap_length, 8));
 
 	for (i = 0; i < pending_scan_results_length; i++) {
 		int ack = buf_get_u32(tdo_buffer, pending_scan_results_buffer[i].first, 3);
@@ -2218,7 +2226,9 @@ skip:
 static void jlink_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk)
 {
 	uint8_t data_parity_trn[DIV_ROUND_UP(32 + 1, 8)];
-	if (tap_length + 46 + 8 + ap_delay_clk >= swd_buffer_size * 8 ||
+
+	adapter_stats_scan(46 + ap_delay_clk);
+	if (tap_length + 46 + 8 + ap_delay_clk >= tap_buffer_size * 8 ||
 	    pending_scan_results_length == MAX_PENDING_SCAN_RESULTS) {
 		/* Not enough room in the queue. Run the queue. */
 		queued_retval = jlink_swd_run_queue();
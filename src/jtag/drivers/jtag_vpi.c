@@ -77,6 +77,30 @@ struct vpi_cmd {
 	};
 };
 
+/* Commands are sent in batches. Only scans are answered, so up to
+ * JTAG_VPI_MAX_PENDING answers are left waiting before they are read,
+ * few enough to fit in the socket buffers. */
+#define JTAG_VPI_SEND_MAX	64
+#define JTAG_VPI_MAX_PENDING	32
+
+static struct vpi_cmd vpi_send_buf[JTAG_VPI_SEND_MAX];
+static unsigned int vpi_send_count;
+
+/* Where the TDO data of each scan sent goes */
+static struct {
+	uint8_t *bits;
+	int nb_bits;
+} vpi_pending[JTAG_VPI_MAX_PENDING];
+static unsigned int vpi_pending_count;
+
+/* Scan commands of the queue whose buffer is handed back at its end */
+static struct jtag_vpi_scan_result {
+	struct scan_command *cmd;
+	uint8_t *buf;
+} *vpi_scans;
+static size_t vpi_scans_count;
+static size_t vpi_scans_alloced;
+
 static char *jtag_vpi_cmd_to_str(int cmd_num)
 {
 	switch (cmd_num) {
@@ -95,6 +119,8 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 	}
 }
 
+static int jtag_vpi_send_batch(void);
+
 static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 {
 	int retval;
@@ -128,42 +154,67 @@ static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 		}
 	}
 
+	if (vpi_send_count == JTAG_VPI_SEND_MAX) {
+		retval = jtag_vpi_send_batch();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	struct vpi_cmd *out = &vpi_send_buf[vpi_send_count++];
+	memcpy(out, vpi, sizeof(*out));
+
 	/* Use little endian when transmitting/receiving jtag_vpi cmds.
 	   The choice of little endian goes against usual networking conventions
 	   but is intentional to remain compatible with most older OpenOCD builds
 	   (i.e. builds on little-endian platforms). */
-	h_u32_to_le(vpi->cmd_buf, vpi->cmd);
-	h_u32_to_le(vpi->length_buf, vpi->length);
-	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
+	h_u32_to_le(out->cmd_buf, vpi->cmd);
+	h_u32_to_le(out->length_buf, vpi->length);
+	h_u32_to_le(out->nb_bits_buf, vpi->nb_bits);
+
+	return ERROR_OK;
+}
+
+/* Write out the commands queued by jtag_vpi_send_cmd() */
+static int jtag_vpi_send_batch(void)
+{
+	const char *data = (const char *)vpi_send_buf;
+	size_t size = vpi_send_count * sizeof(struct vpi_cmd);
+	int retval;
+
+	vpi_send_count = 0;
 
-retry_write:
-	retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
+	while (size) {
+		retval = write_socket(sockfd, data, size);
 
-	if (retval < 0) {
-		/* Account for the case when socket write is interrupted. */
+		if (retval < 0) {
+			/* Account for the case when socket write is interrupted. */
 #ifdef _WIN32
-		int wsa_err = WSAGetLastError();
-		if (wsa_err == WSAEINTR)
-			goto retry_write;
+			int wsa_err = WSAGetLastError();
+			if (wsa_err == WSAEINTR)
+				continue;
 #else
-		if (errno == EINTR)
-			goto retry_write;
+			if (errno == EINTR)
+				continue;
 #endif
-		/* Otherwise this is an error using the socket, most likely fatal
-		   for the connection. B*/
-		log_socket_error("jtag_vpi xmit");
-		/* TODO: Clean way how adapter drivers can report fatal errors
-		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
-		exit(-1);
-	} else if (retval < (int)sizeof(struct vpi_cmd)) {
-		/* This means we could not send all data, which is most likely fatal
-		   for the jtag_vpi connection (the underlying TCP connection likely not
-		   usable anymore) */
-		LOG_ERROR("Could not send all data through jtag_vpi connection.");
-		exit(-1);
+			/* Otherwise this is an error using the socket, most likely fatal
+			   for the connection. B*/
+			log_socket_error("jtag_vpi xmit");
+			/* TODO: Clean way how adapter drivers can report fatal errors
+			   to upper layers of OpenOCD and let it perform an orderly shutdown? */
+			exit(-1);
+		} else if (retval == 0) {
+			/* This means we could not send all data, which is most likely fatal
+			   for the jtag_vpi connection (the underlying TCP connection likely not
+			   usable anymore) */
+			LOG_ERROR("Could not send all data through jtag_vpi connection.");
+			exit(-1);
+		}
+
+		data += retval;
+		size -= retval;
 	}
 
-	/* Otherwise the packet has been sent successfully. */
+	/* Otherwise the packets have been sent successfully. */
 	return ERROR_OK;
 }
 
@@ -300,6 +351,39 @@ static int jtag_vpi_state_move(tap_state_t state)
 	return ERROR_OK;
 }
 
+/* Send the queued commands and read the answers to all scans sent so far */
+static int jtag_vpi_receive_pending(void)
+{
+	struct vpi_cmd vpi;
+
+	int retval = jtag_vpi_send_batch();
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < vpi_pending_count; i++) {
+		int nb_bits = vpi_pending[i].nb_bits;
+
+		retval = jtag_vpi_receive_cmd(&vpi);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Optional low-level JTAG debug */
+		if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+			char *char_buf = buf_to_hex_str(vpi.buffer_in,
+					(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
+			LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
+				nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
+			free(char_buf);
+		}
+
+		if (vpi_pending[i].bits)
+			memcpy(vpi_pending[i].bits, vpi.buffer_in, DIV_ROUND_UP(nb_bits, 8));
+	}
+	vpi_pending_count = 0;
+
+	return ERROR_OK;
+}
+
 static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 {
 	struct vpi_cmd vpi;
@@ -321,21 +405,11 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = jtag_vpi_receive_cmd(&vpi);
-	if (retval != ERROR_OK)
-		return retval;
-
-	/* Optional low-level JTAG debug */
-	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
-		char *char_buf = buf_to_hex_str(vpi.buffer_in,
-				(nb_bits > DEBUG_JTAG_IOZ) ? DEBUG_JTAG_IOZ : nb_bits);
-		LOG_DEBUG_IO("recvd JTAG VPI data: nb_bits=%d, buf_in=0x%s%s",
-			nb_bits, char_buf, (nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
-		free(char_buf);
-	}
-
-	if (bits)
-		memcpy(bits, vpi.buffer_in, nb_bytes);
+	/* The answer is read later, see jtag_vpi_receive_pending() */
+	vpi_pending[vpi_pending_count].bits = bits;
+	vpi_pending[vpi_pending_count].nb_bits = nb_bits;
+	if (++vpi_pending_count == JTAG_VPI_MAX_PENDING)
+		return jtag_vpi_receive_pending();
 
 	return ERROR_OK;
 }
@@ -435,11 +509,21 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
-
-	free(buf);
+	/* buf gets its TDO data at the latest at the end of the queue */
+	if (vpi_scans_count == vpi_scans_alloced) {
+		size_t alloced = vpi_scans_alloced ? 2 * vpi_scans_alloced : 32;
+		struct jtag_vpi_scan_result *p = realloc(vpi_scans, alloced * sizeof(*p));
+		if (!p) {
+			free(buf);
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		vpi_scans = p;
+		vpi_scans_alloced = alloced;
+	}
+	vpi_scans[vpi_scans_count].cmd = cmd;
+	vpi_scans[vpi_scans_count].buf = buf;
+	vpi_scans_count++;
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -518,6 +602,7 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			retval = jtag_vpi_send_batch();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -531,6 +616,18 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	/* The whole queue is streamed, collect the scan results now */
+	int retval2 = jtag_vpi_receive_pending();
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+	for (size_t i = 0; i < vpi_scans_count; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(vpi_scans[i].buf, vpi_scans[i].cmd);
+		free(vpi_scans[i].buf);
+	}
+	vpi_scans_count = 0;
+
 	return retval;
 }
 
@@ -584,7 +681,10 @@ static int jtag_vpi_stop_simulation(void)
 	cmd.length = 0;
 	cmd.nb_bits = 0;
 	cmd.cmd = CMD_STOP_SIMU;
-	return jtag_vpi_send_cmd(&cmd);
+	int retval = jtag_vpi_send_cmd(&cmd);
+	if (retval != ERROR_OK)
+		return retval;
+	return jtag_vpi_send_batch();
 }
 
 static int jtag_vpi_quit(void)
@@ -598,6 +698,9 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(vpi_scans);
+	vpi_scans = NULL;
+	vpi_scans_alloced = 0;
 	return ERROR_OK;
 }
 
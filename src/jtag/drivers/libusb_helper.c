@@ -21,6 +21,7 @@
 #include "config.h"
 #endif
 #include <jtag/drivers/jtag_usb_common.h>
+#include <jtag/interface.h>
 #include "libusb_helper.h"
 #include "log.h"
 
@@ -250,6 +251,7 @@ int jtag_libusb_bulk_write(struct libusb_device_handle *dev, int ep, char *bytes
 		LOG_ERROR("libusb_bulk_write error: %s", libusb_error_name(ret));
 		return jtag_libusb_error(ret);
 	}
+	adapter_stats_usb(*transferred);
 
 	return ERROR_OK;
 }
@@ -267,6 +269,35 @@ int jtag_libusb_bulk_read(struct libusb_device_handle *dev, int ep, char *bytes,
 		LOG_ERROR("libusb_bulk_read error: %s", libusb_error_name(ret));
 		return jtag_libusb_error(ret);
 	}
+	adapter_stats_usb(*transferred);
+
+	return ERROR_OK;
+}
+
+int jtag_libusb_handle_events_completed(int *completed)
+{
+	int ret = libusb_handle_events_completed(jtag_libusb_context, completed);
+
+	if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED) {
+		LOG_ERROR("libusb_handle_events error: %s", libusb_error_name(ret));
+		return jtag_libusb_error(ret);
+	}
+
+	return ERROR_OK;
+}
+
+int jtag_libusb_handle_events_timeout(unsigned int timeout_ms)
+{
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = (timeout_ms % 1000) * 1000,
+	};
+	int ret = libusb_handle_events_timeout_completed(jtag_libusb_context, &tv, NULL);
+
+	if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED) {
+		LOG_ERROR("libusb_handle_events error: %s", libusb_error_name(ret));
+		return jtag_libusb_error(ret);
+	}
 
 	return ERROR_OK;
 }
@@ -39,6 +39,16 @@ int jtag_libusb_bulk_write(struct libusb_device_handle *dev, int ep,
 		char *bytes, int size, int timeout, int *transferred);
 int jtag_libusb_bulk_read(struct libusb_device_handle *dev, int ep,
 		char *bytes, int size, int timeout, int *transferred);
+/**
+ * Handle the events of the context of jtag_libusb_open() until
+ * @a completed is set by the callback of an asynchronous transfer.
+ */
+int jtag_libusb_handle_events_completed(int *completed);
+/**
+ * Handle the pending events of the context of jtag_libusb_open(),
+ * waiting at most @a timeout_ms for one to arrive (0 does not wait).
+ */
+int jtag_libusb_handle_events_timeout(unsigned int timeout_ms);
 int jtag_libusb_set_configuration(struct libusb_device_handle *devh,
 		int configuration);
 /**
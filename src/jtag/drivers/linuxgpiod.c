@@ -60,51 +60,82 @@ static bb_value_t linuxgpiod_read(void)
 	return retval ? BB_HIGH : BB_LOW;
 }
 
-/*
- * Bitbang interface write of TCK, TMS, TDI
- *
- * Seeing as this is the only function where the outputs are changed,
- * we can cache the old value to avoid needlessly writing it.
- */
-static int linuxgpiod_write(int tck, int tms, int tdi)
+/* TDI, TMS and TCK are requested together, to be set in a single call */
+static struct gpiod_line_bulk jtag_bulk;
+/* Values of jtag_bulk for each BB_TCK | BB_TMS | BB_TDI state */
+static int jtag_values[8][3];
+/* TMS is requested high, TDI and TCK low */
+static unsigned int last_jtag_state = BB_TMS;
+
+static void linuxgpiod_init_jtag_values(void)
 {
-	static int last_tck;
-	static int last_tms;
-	static int last_tdi;
-
-	static int first_time;
+	for (unsigned int state = 0; state < ARRAY_SIZE(jtag_values); state++) {
+		jtag_values[state][0] = !!(state & BB_TDI);
+		jtag_values[state][1] = !!(state & BB_TMS);
+		jtag_values[state][2] = !!(state & BB_TCK);
+	}
+}
 
+static int linuxgpiod_set_jtag_state(unsigned int state)
+{
 	int retval;
 
-	if (!first_time) {
-		last_tck = !tck;
-		last_tms = !tms;
-		last_tdi = !tdi;
-		first_time = 1;
-	}
+	state &= BB_TCK | BB_TMS | BB_TDI;
+	if (state == last_jtag_state)
+		return ERROR_OK;
 
-	if (tdi != last_tdi) {
-		retval = gpiod_line_set_value(gpiod_tdi, tdi);
-		if (retval < 0)
-			LOG_WARNING("writing tdi failed");
+	/* write clk last: settle TMS and TDI before a rising edge */
+	if ((state & BB_TCK) && !(last_jtag_state & BB_TCK)
+			&& ((state ^ last_jtag_state) & (BB_TMS | BB_TDI))) {
+		retval = gpiod_line_set_value_bulk(&jtag_bulk, jtag_values[state & ~BB_TCK]);
+		if (retval < 0) {
+			LOG_WARNING("writing tdi/tms failed");
+			return ERROR_FAIL;
+		}
 	}
 
-	if (tms != last_tms) {
-		retval = gpiod_line_set_value(gpiod_tms, tms);
-		if (retval < 0)
-			LOG_WARNING("writing tms failed");
+	retval = gpiod_line_set_value_bulk(&jtag_bulk, jtag_values[state]);
+	if (retval < 0) {
+		LOG_WARNING("writing tck/tms/tdi failed");
+		return ERROR_FAIL;
 	}
 
-	/* write clk last */
-	if (tck != last_tck) {
-		retval = gpiod_line_set_value(gpiod_tck, tck);
-		if (retval < 0)
-			LOG_WARNING("writing tck failed");
-	}
+	last_jtag_state = state;
+	return ERROR_OK;
+}
+
+/*
+ * Bitbang interface write of TCK, TMS, TDI
+ *
+ * Seeing as this is the only function where the outputs are changed,
+ * we can cache the old value to avoid needlessly writing it.
+ */
+static int linuxgpiod_write(int tck, int tms, int tdi)
+{
+	return linuxgpiod_set_jtag_state((tck ? BB_TCK : 0) | (tms ? BB_TMS : 0) | (tdi ? BB_TDI : 0));
+}
 
-	last_tdi = tdi;
-	last_tms = tms;
-	last_tck = tck;
+static int linuxgpiod_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	for (size_t i = 0; i < count; i++) {
+		unsigned int s = states[i];
+
+		if (linuxgpiod_set_jtag_state(s) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (s & BB_SAMPLE) {
+			int value = gpiod_line_get_value(gpiod_tdo);
+			if (value < 0) {
+				LOG_WARNING("reading tdo failed");
+				return ERROR_FAIL;
+			}
+			if (value)
+				in[in_offset / 8] |= 1 << (in_offset % 8);
+			else
+				in[in_offset / 8] &= ~(1 << (in_offset % 8));
+			in_offset++;
+		}
+	}
 
 	return ERROR_OK;
 }
@@ -173,6 +204,34 @@ static int linuxgpiod_swd_write(int swclk, int swdio)
 	return ERROR_OK;
 }
 
+/*
+ * SWCLK and SWDIO stay separate requests, as changing the direction of
+ * SWDIO releases its line and a shared request would glitch SWCLK.
+ */
+static int linuxgpiod_swd_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	for (size_t i = 0; i < count; i++) {
+		unsigned int s = states[i];
+
+		linuxgpiod_swd_write(!!(s & BB_TCK), !!(s & BB_TDI));
+
+		if (s & BB_SAMPLE) {
+			int value = gpiod_line_get_value(gpiod_swdio);
+			if (value < 0) {
+				LOG_WARNING("Fail read swdio");
+				return ERROR_FAIL;
+			}
+			if (value)
+				in[in_offset / 8] |= 1 << (in_offset % 8);
+			else
+				in[in_offset / 8] &= ~(1 << (in_offset % 8));
+			in_offset++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int linuxgpiod_blink(int on)
 {
 	int retval;
@@ -192,6 +251,8 @@ static struct bitbang_interface linuxgpiod_bitbang = {
 	.swdio_read = linuxgpiod_swdio_read,
 	.swdio_drive = linuxgpiod_swdio_drive,
 	.swd_write = linuxgpiod_swd_write,
+	.write_many = linuxgpiod_write_many,
+	.swd_write_many = linuxgpiod_swd_write_many,
 	.blink = linuxgpiod_blink,
 };
 
@@ -298,6 +359,17 @@ static struct gpiod_line *helper_get_input_line(const char *label, unsigned int
 	return line;
 }
 
+static struct gpiod_line *helper_get_line(const char *label, unsigned int offset)
+{
+	struct gpiod_line *line;
+
+	line = gpiod_chip_get_line(gpiod_chip, offset);
+	if (line == NULL)
+		LOG_ERROR("Error get line %s", label);
+
+	return line;
+}
+
 static struct gpiod_line *helper_get_output_line(const char *label, unsigned int offset, int val)
 {
 	struct gpiod_line *line;
@@ -346,17 +418,27 @@ static int linuxgpiod_init(void)
 		if (gpiod_tdo == NULL)
 			goto out_error;
 
-		gpiod_tdi = helper_get_output_line("tdi", tdi_gpio, 0);
-		if (gpiod_tdi == NULL)
+		struct gpiod_line *tdi = helper_get_line("tdi", tdi_gpio);
+		struct gpiod_line *tms = helper_get_line("tms", tms_gpio);
+		struct gpiod_line *tck = helper_get_line("tck", tck_gpio);
+		if (tdi == NULL || tms == NULL || tck == NULL)
 			goto out_error;
 
-		gpiod_tck = helper_get_output_line("tck", tck_gpio, 0);
-		if (gpiod_tck == NULL)
-			goto out_error;
+		/* same order as jtag_values[] */
+		gpiod_line_bulk_init(&jtag_bulk);
+		gpiod_line_bulk_add(&jtag_bulk, tdi);
+		gpiod_line_bulk_add(&jtag_bulk, tms);
+		gpiod_line_bulk_add(&jtag_bulk, tck);
 
-		gpiod_tms = helper_get_output_line("tms", tms_gpio, 1);
-		if (gpiod_tms == NULL)
+		linuxgpiod_init_jtag_values();
+		last_jtag_state = BB_TMS;
+		if (gpiod_line_request_bulk_output(&jtag_bulk, "OpenOCD", jtag_values[last_jtag_state]) < 0) {
+			LOG_ERROR("Error request_output lines tdi, tms, tck");
 			goto out_error;
+		}
+		gpiod_tdi = tdi;
+		gpiod_tms = tms;
+		gpiod_tck = tck;
 
 		if (is_gpio_valid(trst_gpio)) {
 			gpiod_trst = helper_get_output_line("trst", trst_gpio, 1);
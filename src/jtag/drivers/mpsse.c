@@ -23,6 +23,7 @@
 #include "mpsse.h"
 #include "helper/log.h"
 #include "helper/time_support.h"
+#include <jtag/interface.h>
 #include <libusb.h>
 
 /* Compatibility define for older libusb-1.0 */
@@ -61,6 +62,38 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+struct mpsse_ctx;
+struct mpsse_xfer;
+
+/* Context needed by the callbacks */
+struct transfer_result {
+	struct mpsse_ctx *ctx;
+	struct mpsse_xfer *xfer;
+	bool done;
+	unsigned transferred;
+};
+
+/* A command buffer, the read data it asks for and its USB transfers */
+struct mpsse_xfer {
+	uint8_t *write_buffer;
+	unsigned write_count;
+	uint8_t *read_buffer;
+	unsigned read_count;
+	uint8_t *read_chunk;
+	/* copies of the read data to the callers' buffers */
+	struct bit_copy_queue read_queue;
+	struct libusb_transfer *write_transfer;
+	struct libusb_transfer *read_transfer;
+	struct transfer_result write_result;
+	struct transfer_result read_result;
+	/* submitted and not waited for yet */
+	bool busy;
+	/* read transfer held back until the other buffer's read is done */
+	bool read_deferred;
+	/* libusb error of a submit, or LIBUSB_SUCCESS */
+	int usb_error;
+};
+
 struct mpsse_ctx {
 	libusb_context *usb_ctx;
 	libusb_device_handle *usb_dev;
@@ -80,10 +113,32 @@ struct mpsse_ctx {
 	unsigned read_count;
 	uint8_t *read_chunk;
 	unsigned read_chunk_size;
-	struct bit_copy_queue read_queue;
+	struct bit_copy_queue *read_queue;
 	int retval;
+	/* The buffers above are those of xfer[fill]. With double buffering, a
+	 * flush in the middle of a queue hands them to USB without waiting and
+	 * switches to the other buffer, once its own transfer is done. */
+	struct mpsse_xfer xfer[2];
+	unsigned fill;
+	bool double_buffer;
 };
 
+/* Fill the buffers of xfer[i] from now on */
+static void mpsse_use_xfer(struct mpsse_ctx *ctx, unsigned i)
+{
+	struct mpsse_xfer *x = &ctx->xfer[i];
+
+	ctx->fill = i;
+	ctx->write_buffer = x->write_buffer;
+	ctx->write_count = 0;
+	ctx->read_buffer = x->read_buffer;
+	ctx->read_count = 0;
+	ctx->read_chunk = x->read_chunk;
+	ctx->read_queue = &x->read_queue;
+}
+
+static int mpsse_flush_buffer(struct mpsse_ctx *ctx, bool wait);
+
 /* Returns true if the string descriptor indexed by str_index in device matches string */
 static bool string_descriptor_equal(libusb_device_handle *device, uint8_t str_index,
 	const char *string)
@@ -326,21 +381,28 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 	if (!ctx)
 		return 0;
 
-	bit_copy_queue_init(&ctx->read_queue);
 	ctx->read_chunk_size = 16384;
 	ctx->read_size = 16384;
 	ctx->write_size = 16384;
-	ctx->read_chunk = malloc(ctx->read_chunk_size);
-	ctx->read_buffer = malloc(ctx->read_size);
-
-	/* Use calloc to make valgrind happy: buffer_write() sets payload
-	 * on bit basis, so some bits can be left uninitialized in write_buffer.
-	 * Although this is perfectly ok with MPSSE, valgrind reports
-	 * Syscall param ioctl(USBDEVFS_SUBMITURB).buffer points to uninitialised byte(s) */
-	ctx->write_buffer = calloc(1, ctx->write_size);
-
-	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
-		goto error;
+	for (unsigned i = 0; i < ARRAY_SIZE(ctx->xfer); i++) {
+		struct mpsse_xfer *x = &ctx->xfer[i];
+
+		bit_copy_queue_init(&x->read_queue);
+		x->read_chunk = malloc(ctx->read_chunk_size);
+		x->read_buffer = malloc(ctx->read_size);
+		/* Use calloc to make valgrind happy: buffer_write() sets payload
+		 * on bit basis, so some bits can be left uninitialized in write_buffer.
+		 * Although this is perfectly ok with MPSSE, valgrind reports
+		 * Syscall param ioctl(USBDEVFS_SUBMITURB).buffer points to uninitialised byte(s) */
+		x->write_buffer = calloc(1, ctx->write_size);
+		x->write_transfer = libusb_alloc_transfer(0);
+		x->read_transfer = libusb_alloc_transfer(0);
+
+		if (!x->read_chunk || !x->read_buffer || !x->write_buffer
+				|| !x->write_transfer || !x->read_transfer)
+			goto error;
+	}
+	mpsse_use_xfer(ctx, 0);
 
 	ctx->interface = channel;
 	ctx->index = channel + 1;
@@ -403,11 +465,16 @@ void mpsse_close(struct mpsse_ctx *ctx)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
 		libusb_exit(ctx->usb_ctx);
-	bit_copy_discard(&ctx->read_queue);
-
-	free(ctx->write_buffer);
-	free(ctx->read_buffer);
-	free(ctx->read_chunk);
+	for (unsigned i = 0; i < ARRAY_SIZE(ctx->xfer); i++) {
+		struct mpsse_xfer *x = &ctx->xfer[i];
+
+		bit_copy_discard(&x->read_queue);
+		free(x->write_buffer);
+		free(x->read_buffer);
+		free(x->read_chunk);
+		libusb_free_transfer(x->write_transfer);
+		libusb_free_transfer(x->read_transfer);
+	}
 	free(ctx);
 }
 
@@ -423,7 +490,8 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 	ctx->write_count = 0;
 	ctx->read_count = 0;
 	ctx->retval = ERROR_OK;
-	bit_copy_discard(&ctx->read_queue);
+	for (unsigned i = 0; i < ARRAY_SIZE(ctx->xfer); i++)
+		bit_copy_discard(&ctx->xfer[i].read_queue);
 	err = libusb_control_transfer(ctx->usb_dev, FTDI_DEVICE_OUT_REQTYPE, SIO_RESET_REQUEST,
 			SIO_RESET_PURGE_RX, ctx->index, NULL, 0, ctx->usb_write_timeout);
 	if (err < 0) {
@@ -452,7 +520,7 @@ static unsigned buffer_read_space(struct mpsse_ctx *ctx)
 
 static void buffer_write_byte(struct mpsse_ctx *ctx, uint8_t data)
 {
-	LOG_DEBUG_IO("%02x", data);
+	LOG_TRACE("%02x", data);
 	assert(ctx->write_count < ctx->write_size);
 	ctx->write_buffer[ctx->write_count++] = data;
 }
@@ -460,7 +528,7 @@ static void buffer_write_byte(struct mpsse_ctx *ctx, uint8_t data)
 static unsigned buffer_write(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_offset,
 	unsigned bit_count)
 {
-	LOG_DEBUG_IO("%d bits", bit_count);
+	LOG_TRACE("%d bits", bit_count);
 	assert(ctx->write_count + DIV_ROUND_UP(bit_count, 8) <= ctx->write_size);
 	bit_copy(ctx->write_buffer + ctx->write_count, 0, out, out_offset, bit_count);
 	ctx->write_count += DIV_ROUND_UP(bit_count, 8);
@@ -470,9 +538,9 @@ static unsigned buffer_write(struct mpsse_ctx *ctx, const uint8_t *out, unsigned
 static unsigned buffer_add_read(struct mpsse_ctx *ctx, uint8_t *in, unsigned in_offset,
 	unsigned bit_count, unsigned offset)
 {
-	LOG_DEBUG_IO("%d bits, offset %d", bit_count, offset);
+	LOG_TRACE("%d bits, offset %d", bit_count, offset);
 	assert(ctx->read_count + DIV_ROUND_UP(bit_count, 8) <= ctx->read_size);
-	bit_copy_queued(&ctx->read_queue, in, in_offset, ctx->read_buffer + ctx->read_count, offset,
+	bit_copy_queued(ctx->read_queue, in, in_offset, ctx->read_buffer + ctx->read_count, offset,
 		bit_count);
 	ctx->read_count += DIV_ROUND_UP(bit_count, 8);
 	return bit_count;
@@ -494,7 +562,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 	unsigned in_offset, unsigned length, uint8_t mode)
 {
 	/* TODO: Fix MSB first modes */
-	LOG_DEBUG_IO("%s%s %d bits", in ? "in" : "", out ? "out" : "", length);
+	LOG_TRACE("in %d out %d %d bits", !!in, !!out, length);
 
 	if (ctx->retval != ERROR_OK) {
 		LOG_DEBUG_IO("Ignoring command due to previous error");
@@ -511,7 +579,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
 				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_flush_buffer(ctx, false);
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -570,7 +638,7 @@ void mpsse_clock_tms_cs_out(struct mpsse_ctx *ctx, const uint8_t *out, unsigned
 void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_offset, uint8_t *in,
 	unsigned in_offset, unsigned length, bool tdi, uint8_t mode)
 {
-	LOG_DEBUG_IO("%sout %d bits, tdi=%d", in ? "in" : "", length, tdi);
+	LOG_TRACE("in %d out %d bits, tdi=%d", !!in, length, tdi);
 	assert(out);
 
 	if (ctx->retval != ERROR_OK) {
@@ -585,7 +653,7 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_flush_buffer(ctx, false);
 
 		/* Byte transfer */
 		unsigned this_bits = length;
@@ -628,7 +696,7 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -645,7 +713,7 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -662,7 +730,7 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -678,7 +746,7 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -693,7 +761,7 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -714,7 +782,7 @@ void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_flush_buffer(ctx, false);
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -774,20 +842,15 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
-struct transfer_result {
-	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned transferred;
-};
-
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_xfer *x = res->xfer;
 
 	unsigned packet_size = ctx->max_packet_size;
 
+	adapter_stats_usb(transfer->actual_length);
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
 	/* Strip the two status bytes sent at the beginning of each USB packet
@@ -798,21 +861,21 @@ static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 		unsigned this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
+		if (this_size > x->read_count - res->transferred)
+			this_size = x->read_count - res->transferred;
+		memcpy(x->read_buffer + res->transferred,
+			x->read_chunk + packet_size * i + 2,
 			this_size);
 		res->transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
+		if (res->transferred == x->read_count) {
 			res->done = true;
 			break;
 		}
 	}
 
-	LOG_DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+	LOG_TRACE("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
+		x->read_count);
 
 	if (!res->done)
 		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
@@ -823,72 +886,94 @@ static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 {
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_xfer *x = res->xfer;
+	struct mpsse_xfer *other = &ctx->xfer[x == &ctx->xfer[0]];
 
 	res->transferred += transfer->actual_length;
+	adapter_stats_usb(transfer->actual_length);
 
-	LOG_DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	LOG_TRACE("transferred %d of %d", res->transferred, x->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
+	if (res->transferred == x->write_count)
+		res->done = true;
+	else if (other->busy && !other->write_result.done) {
+		/* the rest would go out after the other buffer, give up */
 		res->done = true;
-	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
+	} else {
+		transfer->length = x->write_count - res->transferred;
+		transfer->buffer = x->write_buffer + res->transferred;
 		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
 			res->done = true;
 	}
 }
 
-int mpsse_flush(struct mpsse_ctx *ctx)
+static void mpsse_xfer_submit_read(struct mpsse_ctx *ctx, struct mpsse_xfer *x)
 {
-	int retval = ctx->retval;
-
-	if (retval != ERROR_OK) {
-		LOG_DEBUG_IO("Ignoring flush due to previous error");
-		assert(ctx->write_count == 0 && ctx->read_count == 0);
-		ctx->retval = ERROR_OK;
-		return retval;
-	}
-
-	LOG_DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
-			ctx->read_count);
-	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
+	x->read_deferred = false;
+	libusb_fill_bulk_transfer(x->read_transfer, ctx->usb_dev, ctx->in_ep, x->read_chunk,
+		ctx->read_chunk_size, read_cb, &x->read_result,
+		ctx->usb_read_timeout);
+	x->usb_error = libusb_submit_transfer(x->read_transfer);
+	if (x->usb_error != LIBUSB_SUCCESS)
+		x->read_result.done = true;
+}
 
-	if (ctx->write_count == 0)
-		return retval;
+/*
+ * Hand the filled buffer to USB. Bulk IN transfers are resubmitted until
+ * all the read data is in, so a read can only be submitted once the read of
+ * the other buffer is done, or the data of both would mix.
+ */
+static void mpsse_xfer_submit(struct mpsse_ctx *ctx)
+{
+	struct mpsse_xfer *x = &ctx->xfer[ctx->fill];
+	struct mpsse_xfer *other = &ctx->xfer[!ctx->fill];
 
-	struct libusb_transfer *read_transfer = 0;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
 	if (ctx->read_count) {
 		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
 		/* delay read transaction to ensure the FTDI chip can support us with data
 		   immediately after processing the MPSSE commands in the write transaction */
 	}
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
-	if (retval != LIBUSB_SUCCESS)
-		goto error_check;
+	x->write_count = ctx->write_count;
+	x->read_count = ctx->read_count;
+	x->write_result = (struct transfer_result){ .ctx = ctx, .xfer = x, .done = false };
+	x->read_result = (struct transfer_result){ .ctx = ctx, .xfer = x, .done = x->read_count == 0 };
+	x->read_deferred = false;
+	x->busy = true;
+
+	libusb_fill_bulk_transfer(x->write_transfer, ctx->usb_dev, ctx->out_ep, x->write_buffer,
+		x->write_count, write_cb, &x->write_result, ctx->usb_write_timeout);
+	x->usb_error = libusb_submit_transfer(x->write_transfer);
+	if (x->usb_error != LIBUSB_SUCCESS) {
+		x->write_result.done = true;
+		x->read_result.done = true;
+		return;
+	}
 
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
-			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
-		if (retval != LIBUSB_SUCCESS)
-			goto error_check;
+	if (x->read_count) {
+		if (other->busy && !other->read_result.done)
+			x->read_deferred = true;
+		else
+			mpsse_xfer_submit_read(ctx, x);
 	}
+}
+
+/* Wait for the transfers of @a x, then copy its read data to the callers */
+static int mpsse_xfer_wait(struct mpsse_ctx *ctx, struct mpsse_xfer *x)
+{
+	struct mpsse_xfer *other = &ctx->xfer[x == &ctx->xfer[0]];
+	int retval = x->usb_error;
+
+	if (retval == LIBUSB_SUCCESS && x->read_deferred)
+		mpsse_xfer_submit_read(ctx, x);
+	retval = x->usb_error;
 
 	/* Polling loop, more or less taken from libftdi */
 	int64_t start = timeval_ms();
 	int64_t warn_after = 2000;
-	while (!write_result.done || !read_result.done) {
+	while (retval == LIBUSB_SUCCESS && (!x->write_result.done || !x->read_result.done)) {
 		struct timeval timeout_usb;
 
 		timeout_usb.tv_sec = 1;
@@ -900,10 +985,10 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 			break;
 
 		if (retval != LIBUSB_SUCCESS) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done) {
+			libusb_cancel_transfer(x->write_transfer);
+			if (x->read_count && !x->read_deferred)
+				libusb_cancel_transfer(x->read_transfer);
+			while (!x->write_result.done || !x->read_result.done) {
 				retval = libusb_handle_events_timeout_completed(ctx->usb_ctx,
 								&timeout_usb, NULL);
 				if (retval != LIBUSB_SUCCESS)
@@ -911,6 +996,10 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 			}
 		}
 
+		/* the next buffer's read may start as soon as this one's is in */
+		if (x->read_result.done && other->busy && other->read_deferred)
+			mpsse_xfer_submit_read(ctx, other);
+
 		int64_t now = timeval_ms();
 		if (now - start > warn_after) {
 			LOG_WARNING("Haven't made progress in mpsse_flush() for %" PRId64
@@ -919,37 +1008,90 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		}
 	}
 
-error_check:
+	x->busy = false;
+
 	if (retval != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
 		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
+	} else if (x->write_result.transferred < x->write_count) {
 		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
-			ctx->write_count);
+			x->write_result.transferred,
+			x->write_count);
 		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
+	} else if (x->read_result.transferred < x->read_count) {
 		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
-			ctx->read_count);
+			x->read_result.transferred,
+			x->read_count);
 		retval = ERROR_FAIL;
-	} else if (ctx->read_count) {
-		ctx->write_count = 0;
-		ctx->read_count = 0;
-		bit_copy_execute(&ctx->read_queue);
-		retval = ERROR_OK;
 	} else {
-		ctx->write_count = 0;
-		bit_copy_discard(&ctx->read_queue);
-		retval = ERROR_OK;
+		if (x->read_count)
+			bit_copy_execute(&x->read_queue);
+		else
+			bit_copy_discard(&x->read_queue);
+		return ERROR_OK;
+	}
+
+	bit_copy_discard(&x->read_queue);
+	return retval;
+}
+
+/*
+ * Send the filled buffer. Unless @a wait is set and with double buffering,
+ * return as soon as the other buffer is free to be filled, instead of when
+ * the data of this one is in.
+ */
+static int mpsse_flush_buffer(struct mpsse_ctx *ctx, bool wait)
+{
+	struct mpsse_xfer *x = &ctx->xfer[ctx->fill];
+	struct mpsse_xfer *other = &ctx->xfer[!ctx->fill];
+	int retval = ERROR_OK;
+
+	LOG_TRACE("write %d+%d, read %d", ctx->write_count, ctx->read_count ? 1 : 0,
+			ctx->read_count);
+	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
+
+	if (ctx->write_count)
+		mpsse_xfer_submit(ctx);
+
+	/* data of the older buffer comes first */
+	if (other->busy)
+		retval = mpsse_xfer_wait(ctx, other);
+
+	if (x->busy && (wait || !ctx->double_buffer || retval != ERROR_OK)) {
+		int retval2 = mpsse_xfer_wait(ctx, x);
+		if (retval == ERROR_OK)
+			retval = retval2;
 	}
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	if (x->busy)
+		mpsse_use_xfer(ctx, !ctx->fill);
+	else
+		mpsse_use_xfer(ctx, ctx->fill);
 
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
 	return retval;
 }
+
+int mpsse_flush(struct mpsse_ctx *ctx)
+{
+	int retval = ctx->retval;
+
+	if (retval != ERROR_OK) {
+		LOG_DEBUG_IO("Ignoring flush due to previous error");
+		assert(ctx->write_count == 0 && ctx->read_count == 0);
+		assert(!ctx->xfer[0].busy && !ctx->xfer[1].busy);
+		ctx->retval = ERROR_OK;
+		return retval;
+	}
+
+	return mpsse_flush_buffer(ctx, true);
+}
+
+void mpsse_set_double_buffer(struct mpsse_ctx *ctx, bool enable)
+{
+	if (!enable && ctx->double_buffer)
+		mpsse_flush(ctx);
+	ctx->double_buffer = enable;
+}
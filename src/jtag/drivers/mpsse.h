@@ -74,5 +74,7 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency);
 /* Queue handling */
 int mpsse_flush(struct mpsse_ctx *ctx);
 void mpsse_purge(struct mpsse_ctx *ctx);
+/* Let a full queue go out while the next part is being filled */
+void mpsse_set_double_buffer(struct mpsse_ctx *ctx, bool enable);
 
 #endif /* OPENOCD_JTAG_DRIVERS_MPSSE_H */
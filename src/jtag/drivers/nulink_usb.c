@@ -42,6 +42,13 @@
 #define NULINK2_USB_PID1  (0x5200)
 #define NULINK2_USB_PID2  (0x5201)
 
+/* Words or registers accessed by one CMD_WRITE_RAM or CMD_WRITE_REG: the
+ * command, 12 bytes a word, has to fit in a Nu-Link HID report, and the
+ * u8ReadOld and u8Verify bit arrays are one byte each */
+#define NULINK_WORDS_PER_CMD   4
+#define NULINK2_WORDS_PER_CMD  8
+#define NULINK_QUEUE_SIZE      32
+
 struct nulink_usb_handle_s {
 	hid_device *dev_handle;
 	uint16_t max_packet_size;
@@ -52,10 +59,19 @@ struct nulink_usb_handle_s {
 	uint8_t tempbuf[NULINK2_HID_MAX_SIZE];
 	uint8_t databuf[NULINK2_HID_MAX_SIZE];
 	uint32_t max_mem_packet;
+	unsigned int words_per_cmd;
 	uint16_t hardware_config; /* bit 0: 1:Nu-Link-Pro, 0:Nu-Link */
 
 	int (*xfer)(void *handle, uint8_t *buf, int size);
 	void (*init_buffer)(void *handle, uint32_t size);
+
+	/* register reads queued for nulink_usb_queue_flush() */
+	struct {
+		int num;
+		uint32_t *val;
+	} queue[NULINK_QUEUE_SIZE];
+	unsigned int queue_len;
+	int queue_retval;
 };
 
 /* ICE Command */
@@ -134,7 +150,7 @@ static int nulink2_usb_xfer(void *handle, uint8_t *buf, int size)
 
 	int err = nulink_usb_xfer_rw(h, h->tempbuf);
 
-	memcpy(buf, h->tempbuf + 3, V7M_MAX_COMMAND_LENGTH);
+	memcpy(buf, h->tempbuf + 3, h->max_packet_size - 3);
 
 	return err;
 }
@@ -450,6 +466,86 @@ static int nulink_usb_read_reg(void *handle, int num, uint32_t *val)
 	return res;
 }
 
+/* Read up to words_per_cmd queued registers with one command */
+static int nulink_usb_read_regs_cmd(void *handle, unsigned int first, unsigned int count)
+{
+	struct nulink_usb_handle_s *h = handle;
+
+	nulink_usb_init_buffer(handle, 8 + 12 * count);
+	/* set command ID */
+	h_u32_to_le(h->cmdbuf + h->cmdidx, CMD_WRITE_REG);
+	h->cmdidx += 4;
+	/* Count of registers */
+	h->cmdbuf[h->cmdidx] = count;
+	h->cmdidx += 1;
+	/* Array of bool value (u8ReadOld) */
+	h->cmdbuf[h->cmdidx] = 0xFF;
+	h->cmdidx += 1;
+	/* Array of bool value (u8Verify) */
+	h->cmdbuf[h->cmdidx] = 0x00;
+	h->cmdidx += 1;
+	/* ignore */
+	h->cmdbuf[h->cmdidx] = 0;
+	h->cmdidx += 1;
+
+	for (unsigned int i = 0; i < count; i++) {
+		/* u32Addr */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, h->queue[first + i].num);
+		h->cmdidx += 4;
+		/* u32Data */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, 0);
+		h->cmdidx += 4;
+		/* u32Mask */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, 0xFFFFFFFFUL);
+		h->cmdidx += 4;
+	}
+
+	int res = nulink_usb_xfer(handle, h->databuf, 4 * count * 2);
+	if (res != ERROR_OK)
+		return res;
+
+	for (unsigned int i = 0; i < count; i++)
+		*h->queue[first + i].val = le_to_h_u32(h->databuf + 4 * (2 * i + 1));
+
+	return ERROR_OK;
+}
+
+static int nulink_usb_queue_flush(void *handle)
+{
+	struct nulink_usb_handle_s *h = handle;
+	unsigned int n = h->queue_len;
+	int res = h->queue_retval;
+
+	assert(handle);
+
+	h->queue_len = 0;
+	h->queue_retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < n && res == ERROR_OK; i += h->words_per_cmd)
+		res = nulink_usb_read_regs_cmd(handle, i, MIN(n - i, h->words_per_cmd));
+
+	return res;
+}
+
+static int nulink_usb_queue_read_reg(void *handle, int num, uint32_t *val)
+{
+	struct nulink_usb_handle_s *h = handle;
+
+	assert(handle);
+
+	if (h->queue_len == NULINK_QUEUE_SIZE) {
+		int res = nulink_usb_queue_flush(handle);
+		if (res != ERROR_OK)
+			h->queue_retval = res;
+	}
+
+	h->queue[h->queue_len].num = num;
+	h->queue[h->queue_len].val = val;
+	h->queue_len++;
+
+	return ERROR_OK;
+}
+
 static int nulink_usb_write_reg(void *handle, int num, uint32_t val)
 {
 	struct nulink_usb_handle_s *h = handle;
@@ -682,8 +778,8 @@ static int nulink_usb_read_mem32(void *handle, uint32_t addr, uint16_t len,
 		uint8_t *buffer)
 {
 	int res = ERROR_OK;
-	uint32_t bytes_remaining = 12;
 	struct nulink_usb_handle_s *h = handle;
+	uint32_t bytes_remaining = 4 * h->words_per_cmd;
 
 	assert(handle);
 
@@ -731,6 +827,8 @@ static int nulink_usb_read_mem32(void *handle, uint32_t addr, uint16_t len,
 		}
 
 		res = nulink_usb_xfer(handle, h->databuf, 4 * count * 2);
+		if (res != ERROR_OK)
+			break;
 
 		/* fill in the output buffer */
 		for (unsigned int i = 0; i < count; i++) {
@@ -751,8 +849,8 @@ static int nulink_usb_write_mem32(void *handle, uint32_t addr, uint16_t len,
 		const uint8_t *buffer)
 {
 	int res = ERROR_OK;
-	uint32_t bytes_remaining = 12;
 	struct nulink_usb_handle_s *h = handle;
+	uint32_t bytes_remaining = 4 * h->words_per_cmd;
 
 	assert(handle);
 
@@ -803,6 +901,8 @@ static int nulink_usb_write_mem32(void *handle, uint32_t addr, uint16_t len,
 		}
 
 		res = nulink_usb_xfer(handle, h->databuf, 4 * count * 2);
+		if (res != ERROR_OK)
+			break;
 
 		if (len >= bytes_remaining)
 			len -= bytes_remaining;
@@ -1117,12 +1217,14 @@ static int nulink_usb_open(struct hl_interface_param_s *param, void **fd)
 	case NULINK2_USB_PID2:
 		h->hardware_config = HARDWARE_CONFIG_NULINK2;
 		h->max_packet_size = NULINK2_HID_MAX_SIZE;
+		h->words_per_cmd = NULINK2_WORDS_PER_CMD;
 		h->init_buffer = nulink2_usb_init_buffer;
 		h->xfer = nulink2_usb_xfer;
 		break;
 	default:
 		h->hardware_config = 0;
 		h->max_packet_size = NULINK_HID_MAX_SIZE;
+		h->words_per_cmd = NULINK_WORDS_PER_CMD;
 		h->init_buffer = nulink1_usb_init_buffer;
 		h->xfer = nulink1_usb_xfer;
 		break;
@@ -1176,6 +1278,8 @@ struct hl_layout_api_s nulink_usb_layout_api = {
 	.read_mem = nulink_usb_read_mem,
 	.write_mem = nulink_usb_write_mem,
 	.write_debug_reg = nulink_usb_write_debug_reg,
+	.queue_read_reg = nulink_usb_queue_read_reg,
+	.queue_flush = nulink_usb_queue_flush,
 	.override_target = nulink_usb_override_target,
 	.speed = nulink_speed,
 };
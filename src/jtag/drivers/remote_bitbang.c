@@ -25,6 +25,7 @@
 #include <netdb.h>
 #endif
 #include <jtag/interface.h>
+#include <helper/binarybuffer.h>
 #include "bitbang.h"
 
 /* arbitrary limit on host name length: */
@@ -36,6 +37,25 @@ static char *remote_bitbang_port;
 static FILE *remote_bitbang_file;
 static int remote_bitbang_fd;
 
+/* Scan extension: negotiate it at init, if asked to by "remote_bitbang_bulk" */
+static bool remote_bitbang_use_bulk;
+
+/* Bits per scan message */
+#define REMOTE_BITBANG_BULK_BITS 2048
+
+/* Scan messages whose TDO data has not been read yet */
+static struct remote_bitbang_pending {
+	uint8_t *in;
+	unsigned int offset;
+	unsigned int bits;
+} *remote_bitbang_pending;
+static size_t remote_bitbang_pending_head;
+static size_t remote_bitbang_pending_count;
+static size_t remote_bitbang_pending_alloced;
+/* TDO data of the oldest pending message received so far */
+static uint8_t remote_bitbang_resp[REMOTE_BITBANG_BULK_BITS / 8];
+static unsigned int remote_bitbang_resp_len;
+
 /* Circular buffer. When start == end, the buffer is empty. */
 static char remote_bitbang_buf[64];
 static unsigned remote_bitbang_start;
@@ -116,6 +136,11 @@ static int remote_bitbang_quit(void)
 
 	free(remote_bitbang_host);
 	free(remote_bitbang_port);
+	free(remote_bitbang_pending);
+	remote_bitbang_pending = NULL;
+	remote_bitbang_pending_alloced = 0;
+	remote_bitbang_pending_head = 0;
+	remote_bitbang_pending_count = 0;
 
 	LOG_INFO("remote_bitbang interface quit");
 	return ERROR_OK;
@@ -135,13 +160,13 @@ static bb_value_t char_to_int(int c)
 	}
 }
 
-/* Get the next read response. */
-static bb_value_t remote_bitbang_rread(void)
+/* Wait for the next character from the remote side. Returns it, or -1 */
+static int remote_bitbang_getc(void)
 {
 	if (EOF == fflush(remote_bitbang_file)) {
 		remote_bitbang_quit();
 		LOG_ERROR("fflush: %s", strerror(errno));
-		return BB_ERROR;
+		return -1;
 	}
 
 	/* Enable blocking access. */
@@ -149,16 +174,79 @@ static bb_value_t remote_bitbang_rread(void)
 	char c;
 	ssize_t count = read(remote_bitbang_fd, &c, 1);
 	if (count == 1) {
-		return char_to_int(c);
+		return (unsigned char)c;
 	} else {
 		remote_bitbang_quit();
 		LOG_ERROR("read: count=%d, error=%s", (int) count, strerror(errno));
+		return -1;
+	}
+}
+
+/* Get the next read response. */
+static bb_value_t remote_bitbang_rread(void)
+{
+	int c = remote_bitbang_getc();
+	if (c < 0)
 		return BB_ERROR;
+	return char_to_int(c);
+}
+
+/*
+ * Read the TDO data of pending scan messages into their buffers. Without
+ * @a block, stop when no more data is there yet, so the remote side is not
+ * held up by a full socket while messages are being sent.
+ */
+static int remote_bitbang_bulk_read(bool block)
+{
+	if (block && remote_bitbang_pending_head < remote_bitbang_pending_count &&
+			EOF == fflush(remote_bitbang_file)) {
+		remote_bitbang_quit();
+		LOG_ERROR("fflush: %s", strerror(errno));
+		return ERROR_FAIL;
 	}
+
+	while (remote_bitbang_pending_head < remote_bitbang_pending_count) {
+		struct remote_bitbang_pending *p = &remote_bitbang_pending[remote_bitbang_pending_head];
+		unsigned int len = DIV_ROUND_UP(p->bits, 8);
+
+		if (block)
+			socket_block(remote_bitbang_fd);
+		else
+			socket_nonblock(remote_bitbang_fd);
+		ssize_t count = read(remote_bitbang_fd, remote_bitbang_resp + remote_bitbang_resp_len,
+				len - remote_bitbang_resp_len);
+		if (count > 0) {
+			remote_bitbang_resp_len += count;
+			if (remote_bitbang_resp_len == len) {
+				buf_set_buf(remote_bitbang_resp, 0, p->in, p->offset, p->bits);
+				remote_bitbang_resp_len = 0;
+				remote_bitbang_pending_head++;
+			}
+		} else if (count < 0 && !block && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return ERROR_OK;
+		} else {
+			remote_bitbang_quit();
+			LOG_ERROR("remote_bitbang: reading scan data: %s",
+					count == 0 ? "connection closed" : strerror(errno));
+			return ERROR_FAIL;
+		}
+	}
+
+	remote_bitbang_pending_head = 0;
+	remote_bitbang_pending_count = 0;
+	return ERROR_OK;
+}
+
+static int remote_bitbang_flush(void)
+{
+	return remote_bitbang_bulk_read(true);
 }
 
 static int remote_bitbang_sample(void)
 {
+	/* the answer must not be taken for scan data */
+	if (remote_bitbang_bulk_read(true) != ERROR_OK)
+		return ERROR_FAIL;
 	if (remote_bitbang_fill_buf() != ERROR_OK)
 		return ERROR_FAIL;
 	assert(!remote_bitbang_buf_full());
@@ -182,6 +270,101 @@ static int remote_bitbang_write(int tck, int tms, int tdi)
 	return remote_bitbang_putc(c);
 }
 
+/* Send states one by one in the classic encoding, reading each sample */
+static int remote_bitbang_write_states(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (remote_bitbang_write(states[i] & BB_TCK, states[i] & BB_TMS, states[i] & BB_TDI) != ERROR_OK)
+			return ERROR_FAIL;
+		if (states[i] & BB_SAMPLE) {
+			if (remote_bitbang_sample() != ERROR_OK)
+				return ERROR_FAIL;
+			bb_value_t v = remote_bitbang_read_sample();
+			if (v == BB_ERROR)
+				return ERROR_FAIL;
+			buf_set_u32(in, in_offset++, 1, v == BB_HIGH);
+		}
+	}
+	return ERROR_OK;
+}
+
+/* States are sent as scan messages for each TCK low/high pair with the same TMS and TDI */
+static bool remote_bitbang_states_are_bits(const uint8_t *states, size_t count)
+{
+	if (count % 2)
+		return false;
+	for (size_t i = 0; i < count; i += 2) {
+		if ((states[i] & BB_TCK) || (states[i + 1] & (BB_TCK | BB_SAMPLE)) != BB_TCK ||
+				(states[i] & (BB_TMS | BB_TDI)) != (states[i + 1] & (BB_TMS | BB_TDI)))
+			return false;
+	}
+	return true;
+}
+
+static int remote_bitbang_write_many(const uint8_t *states, size_t count, uint8_t *in, unsigned int in_offset)
+{
+	if (!remote_bitbang_states_are_bits(states, count)) {
+		if (remote_bitbang_bulk_read(true) != ERROR_OK)
+			return ERROR_FAIL;
+		return remote_bitbang_write_states(states, count, in, in_offset);
+	}
+
+	while (count) {
+		unsigned int bits = MIN(count / 2, REMOTE_BITBANG_BULK_BITS);
+		unsigned int len = DIV_ROUND_UP(bits, 8);
+		uint8_t msg[5 + 3 * REMOTE_BITBANG_BULK_BITS / 8] = { 'x' };
+		uint8_t *tms = msg + 5;
+		uint8_t *tdi = tms + len;
+		uint8_t *capture = tdi + len;
+		unsigned int captured = 0;
+
+		h_u32_to_le(msg + 1, bits);
+		for (unsigned int i = 0; i < bits; i++) {
+			uint8_t s = states[2 * i];
+			if (s & BB_TMS)
+				tms[i / 8] |= 1 << (i % 8);
+			if (s & BB_TDI)
+				tdi[i / 8] |= 1 << (i % 8);
+			if (s & BB_SAMPLE) {
+				capture[i / 8] |= 1 << (i % 8);
+				captured++;
+			}
+		}
+
+		if (captured) {
+			if (remote_bitbang_pending_count == remote_bitbang_pending_alloced) {
+				size_t alloced = remote_bitbang_pending_alloced ? 2 * remote_bitbang_pending_alloced : 16;
+				struct remote_bitbang_pending *p = realloc(remote_bitbang_pending, alloced * sizeof(*p));
+				if (!p) {
+					LOG_ERROR("Out of memory");
+					return ERROR_FAIL;
+				}
+				remote_bitbang_pending = p;
+				remote_bitbang_pending_alloced = alloced;
+			}
+			remote_bitbang_pending[remote_bitbang_pending_count++] = (struct remote_bitbang_pending){
+				.in = in,
+				.offset = in_offset,
+				.bits = captured,
+			};
+			in_offset += captured;
+		}
+
+		if (fwrite(msg, 5 + 3 * len, 1, remote_bitbang_file) != 1) {
+			LOG_ERROR("remote_bitbang_write_many: %s", strerror(errno));
+			return ERROR_FAIL;
+		}
+
+		if (remote_bitbang_bulk_read(false) != ERROR_OK)
+			return ERROR_FAIL;
+
+		states += 2 * bits;
+		count -= 2 * bits;
+	}
+
+	return ERROR_OK;
+}
+
 static int remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
@@ -199,9 +382,37 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
 	.write = &remote_bitbang_write,
+	.flush = &remote_bitbang_flush,
 	.blink = &remote_bitbang_blink,
 };
 
+/*
+ * Ask for the scan extension. A server without it ignores the 'X' and only
+ * answers the read that follows.
+ */
+static int remote_bitbang_negotiate(void)
+{
+	if (EOF == fputs("XR", remote_bitbang_file)) {
+		LOG_ERROR("fputs: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	int c = remote_bitbang_getc();
+	int version = 0;
+	if (c == 'X') {
+		version = remote_bitbang_getc();
+		c = remote_bitbang_getc();
+	}
+	if (c < 0 || version < 0 || char_to_int(c) == BB_ERROR)
+		return ERROR_FAIL;
+
+	if (version >= '1') {
+		LOG_INFO("remote_bitbang: using the scan extension");
+		remote_bitbang_bitbang.write_many = &remote_bitbang_write_many;
+	}
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -278,6 +489,7 @@ static int remote_bitbang_init(void)
 
 	remote_bitbang_start = 0;
 	remote_bitbang_end = 0;
+	remote_bitbang_bitbang.write_many = NULL;
 
 	LOG_INFO("Initializing remote_bitbang driver");
 	if (remote_bitbang_port == NULL)
@@ -295,6 +507,9 @@ static int remote_bitbang_init(void)
 		return ERROR_FAIL;
 	}
 
+	if (remote_bitbang_use_bulk && remote_bitbang_negotiate() != ERROR_OK)
+		return ERROR_FAIL;
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -321,6 +536,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_bulk_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_bulk);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 static const struct command_registration remote_bitbang_command_handlers[] = {
 	{
 		.name = "remote_bitbang_port",
@@ -338,6 +562,13 @@ static const struct command_registration remote_bitbang_command_handlers[] = {
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "remote_bitbang_bulk",
+		.handler = remote_bitbang_handle_remote_bitbang_bulk_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Ask the remote jtag for the binary scan extension at init (default off).",
+		.usage = "('on'|'off')",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -32,6 +32,7 @@
 /* project specific includes */
 #include <helper/binarybuffer.h>
 #include <helper/bits.h>
+#include <helper/time_support.h>
 #include <jtag/interface.h>
 #include <jtag/hla/hla_layout.h>
 #include <jtag/hla/hla_transport.h>
@@ -90,6 +91,16 @@
  */
 #define MAX_WAIT_RETRIES 8
 
+/* A SWIM transfer of a full STLINK_DATA_SIZE buffer takes some 300 ms at
+ * low speed, its status is polled without backoff for up to this long */
+#define SWIM_BUSY_TIMEOUT_MS 1000
+
+/* Number of 32bit memory chunks kept in flight by the asynchronous
+ * memory pipeline; each chunk costs four USB transfers (command, data,
+ * status command, status).
+ */
+#define STLINK_MEM_PIPELINE_DEPTH 8
+
 enum stlink_jtag_api_version {
 	STLINK_JTAG_API_V1 = 1,
 	STLINK_JTAG_API_V2,
@@ -119,6 +130,26 @@ struct stlink_usb_version {
 	uint32_t flags;
 };
 
+/* Number of reads collected by stlink_usb_queue_read_reg() and
+ * stlink_usb_queue_read_mem() before they are flushed
+ */
+#define STLINK_QUEUE_SIZE 16
+
+/** A read waiting for stlink_usb_queue_flush() */
+struct stlink_queued_read {
+	/** core register number, or -1 for a memory read */
+	int reg;
+	uint32_t *val;
+	uint32_t addr;
+	uint32_t size;
+	uint32_t count;
+	uint8_t *buffer;
+	/* USB buffers of the batched command */
+	uint8_t cmd[STLINK_CMD_SIZE_V2];
+	uint8_t status_cmd[STLINK_CMD_SIZE_V2];
+	uint8_t reply[12];
+};
+
 /** */
 struct stlink_usb_handle_s {
 	/** */
@@ -159,6 +190,12 @@ struct stlink_usb_handle_s {
 	/** reconnect is needed next time we try to query the
 	 * status */
 	bool reconnect_pending;
+	/** reads queued for the next stlink_usb_queue_flush() */
+	struct stlink_queued_read queue[STLINK_QUEUE_SIZE];
+	/** */
+	unsigned int queue_len;
+	/** error of a flush forced by a full queue */
+	int queue_retval;
 };
 
 #define STLINK_SWIM_ERR_OK             0x00
@@ -517,6 +554,7 @@ static int jtag_libusb_bulk_transfer_n(
 				/* Assuming actual_length is only valid if there is no transfer error.
 				 */
 				transfers[i].transfer_size = transfers[i].transfer->actual_length;
+				adapter_stats_usb(transfers[i].transfer_size);
 			}
 		}
 
@@ -819,6 +857,7 @@ static int stlink_cmd_allow_retry(void *handle, const uint8_t *buf, int size)
 	int retries = 0;
 	int res;
 	struct stlink_usb_handle_s *h = handle;
+	int64_t swim_deadline = 0;
 
 	while (1) {
 		if ((h->st_mode != STLINK_MODE_DEBUG_SWIM) || !retries) {
@@ -834,6 +873,16 @@ static int stlink_cmd_allow_retry(void *handle, const uint8_t *buf, int size)
 		}
 
 		res = stlink_usb_error_check(handle);
+		if (res == ERROR_WAIT && h->st_mode == STLINK_MODE_DEBUG_SWIM) {
+			/* SWIM busy: the transfer is still in progress, poll again
+			 * right away, the wait for the USB round trip paces the poll.
+			 * A backoff would add up to the duration of the transfer. */
+			if (!retries++)
+				swim_deadline = timeval_ms() + SWIM_BUSY_TIMEOUT_MS;
+			if (timeval_ms() < swim_deadline)
+				continue;
+			return res;
+		}
 		if (res == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
 			unsigned int delay_us = (1<<retries++) * 1000;
 			LOG_DEBUG("stlink_cmd_allow_retry ERROR_WAIT, retry %d, delaying %u microseconds", retries, delay_us);
@@ -2305,6 +2354,106 @@ static uint32_t stlink_max_block_size(uint32_t tar_autoincr_block, uint32_t addr
 	return max_tar_block;
 }
 
+#ifdef USE_LIBUSB_ASYNCIO
+struct stlink_mem_chunk {
+	uint8_t cmd[STLINK_CMD_SIZE_V2];
+	uint8_t status_cmd[STLINK_CMD_SIZE_V2];
+	uint8_t status[12];
+};
+
+/** The pipeline needs a V2+ protocol and a firmware reporting the memory
+ * access status; ST-Link/V1 wraps every command in a mass storage CBW. */
+static bool stlink_usb_mem_pipeline_ok(struct stlink_usb_handle_s *h)
+{
+	return h->version.stlink != 1 && h->version.jtag_api != STLINK_JTAG_API_V1
+		&& h->st_mode != STLINK_MODE_DEBUG_SWIM;
+}
+
+/**
+ * Transfer @a len bytes of word aligned memory with 32bit accesses while
+ * keeping up to STLINK_MEM_PIPELINE_DEPTH chunks in flight. Every chunk is
+ * followed by its own last-rw-status request, so an error is attributed to
+ * the chunk that caused it.
+ *
+ * @a done returns the number of bytes transferred successfully before the
+ * first failing chunk; the caller can retry from there on ERROR_WAIT.
+ */
+static int stlink_usb_mem32_pipeline(struct stlink_usb_handle_s *h, bool write,
+		uint32_t addr, uint32_t len, uint8_t *buffer, uint32_t *done)
+{
+	struct stlink_mem_chunk chunks[STLINK_MEM_PIPELINE_DEPTH];
+	struct jtag_xfer transfers[4 * STLINK_MEM_PIPELINE_DEPTH];
+	uint32_t chunk_len[STLINK_MEM_PIPELINE_DEPTH];
+	bool status2 = h->version.flags & STLINK_F_HAS_GETLASTRWSTATUS2;
+
+	*done = 0;
+
+	while (len) {
+		size_t n_chunks = 0;
+		size_t n_transfers = 0;
+		uint32_t chunk_addr = addr;
+
+		memset(transfers, 0, sizeof(transfers));
+		memset(chunks, 0, sizeof(chunks));
+
+		while (len && n_chunks < STLINK_MEM_PIPELINE_DEPTH) {
+			struct stlink_mem_chunk *c = &chunks[n_chunks];
+			uint32_t n = stlink_max_block_size(h->max_mem_packet, chunk_addr);
+
+			if (n > len)
+				n = len;
+
+			c->cmd[0] = STLINK_DEBUG_COMMAND;
+			c->cmd[1] = write ? STLINK_DEBUG_WRITEMEM_32BIT : STLINK_DEBUG_READMEM_32BIT;
+			h_u32_to_le(c->cmd + 2, chunk_addr);
+			h_u16_to_le(c->cmd + 6, n);
+
+			c->status_cmd[0] = STLINK_DEBUG_COMMAND;
+			c->status_cmd[1] = status2 ? STLINK_DEBUG_APIV2_GETLASTRWSTATUS2 :
+					STLINK_DEBUG_APIV2_GETLASTRWSTATUS;
+
+			transfers[n_transfers].ep = h->tx_ep;
+			transfers[n_transfers].buf = c->cmd;
+			transfers[n_transfers++].size = STLINK_CMD_SIZE_V2;
+
+			transfers[n_transfers].ep = write ? h->tx_ep : h->rx_ep;
+			transfers[n_transfers].buf = buffer + (chunk_addr - addr);
+			transfers[n_transfers++].size = n;
+
+			transfers[n_transfers].ep = h->tx_ep;
+			transfers[n_transfers].buf = c->status_cmd;
+			transfers[n_transfers++].size = STLINK_CMD_SIZE_V2;
+
+			transfers[n_transfers].ep = h->rx_ep;
+			transfers[n_transfers].buf = c->status;
+			transfers[n_transfers++].size = status2 ? 12 : 2;
+
+			chunk_len[n_chunks++] = n;
+			chunk_addr += n;
+			len -= n;
+		}
+
+		int retval = jtag_libusb_bulk_transfer_n(h->fd, transfers, n_transfers,
+				STLINK_WRITE_TIMEOUT);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (size_t i = 0; i < n_chunks; i++) {
+			memcpy(h->databuf, chunks[i].status, sizeof(chunks[i].status));
+			retval = stlink_usb_error_check(h);
+			if (retval != ERROR_OK)
+				return retval;
+
+			buffer += chunk_len[i];
+			addr += chunk_len[i];
+			*done += chunk_len[i];
+		}
+	}
+
+	return ERROR_OK;
+}
+#endif
+
 static int stlink_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
 		uint32_t count, uint8_t *buffer)
 {
@@ -2322,6 +2471,27 @@ static int stlink_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
 
 	while (count) {
 
+#ifdef USE_LIBUSB_ASYNCIO
+		/* stream whole aligned words through the asynchronous pipeline,
+		 * the generic path below handles the unaligned head and tail */
+		if (size == 4 && !(addr & 3) && count >= 4 && stlink_usb_mem_pipeline_ok(h)) {
+			uint32_t done;
+
+			retval = stlink_usb_mem32_pipeline(h, false, addr, count & ~3,
+					buffer, &done);
+			buffer += done;
+			addr += done;
+			count -= done;
+			if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+				usleep((1<<retries++) * 1000);
+				continue;
+			}
+			if (retval != ERROR_OK)
+				return retval;
+			continue;
+		}
+#endif
+
 		bytes_remaining = (size != 1) ?
 				stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
 
@@ -2402,6 +2572,27 @@ static int stlink_usb_write_mem(void *handle, uint32_t addr, uint32_t size,
 
 	while (count) {
 
+#ifdef USE_LIBUSB_ASYNCIO
+		/* stream whole aligned words through the asynchronous pipeline,
+		 * the generic path below handles the unaligned head and tail */
+		if (size == 4 && !(addr & 3) && count >= 4 && stlink_usb_mem_pipeline_ok(h)) {
+			uint32_t done;
+
+			retval = stlink_usb_mem32_pipeline(h, true, addr, count & ~3,
+					(uint8_t *)buffer, &done);
+			buffer += done;
+			addr += done;
+			count -= done;
+			if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+				usleep((1<<retries++) * 1000);
+				continue;
+			}
+			if (retval != ERROR_OK)
+				return retval;
+			continue;
+		}
+#endif
+
 		bytes_remaining = (size != 1) ?
 				stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
 
@@ -2465,6 +2656,173 @@ static int stlink_usb_write_mem(void *handle, uint32_t addr, uint32_t size,
 	return retval;
 }
 
+#ifdef USE_LIBUSB_ASYNCIO
+/** Whether a queued read can be sent as one command in a batch */
+static bool stlink_usb_queue_batchable(struct stlink_usb_handle_s *h,
+		const struct stlink_queued_read *q)
+{
+	if (q->reg >= 0)
+		return true;
+
+	return q->size == 4 && !(q->addr & 3)
+		&& q->count * 4 <= stlink_max_block_size(h->max_mem_packet, q->addr);
+}
+
+/**
+ * Send all queued reads in a single batch of USB transfers: a register
+ * read is a command and its reply, a memory read a command, the data and
+ * the last-rw-status request and reply.
+ */
+static int stlink_usb_queue_xfer(struct stlink_usb_handle_s *h, unsigned int n)
+{
+	struct jtag_xfer transfers[4 * STLINK_QUEUE_SIZE];
+	bool status2 = h->version.flags & STLINK_F_HAS_GETLASTRWSTATUS2;
+	size_t n_transfers = 0;
+
+	memset(transfers, 0, sizeof(transfers));
+
+	for (unsigned int i = 0; i < n; i++) {
+		struct stlink_queued_read *q = &h->queue[i];
+
+		memset(q->cmd, 0, sizeof(q->cmd));
+		q->cmd[0] = STLINK_DEBUG_COMMAND;
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = q->cmd;
+		transfers[n_transfers++].size = STLINK_CMD_SIZE_V2;
+
+		if (q->reg >= 0) {
+			q->cmd[1] = STLINK_DEBUG_APIV2_READREG;
+			q->cmd[2] = q->reg;
+
+			/* status at offset 0, value at offset 4 */
+			transfers[n_transfers].ep = h->rx_ep;
+			transfers[n_transfers].buf = q->reply;
+			transfers[n_transfers++].size = 8;
+			continue;
+		}
+
+		q->cmd[1] = STLINK_DEBUG_READMEM_32BIT;
+		h_u32_to_le(q->cmd + 2, q->addr);
+		h_u16_to_le(q->cmd + 6, q->count * 4);
+
+		memset(q->status_cmd, 0, sizeof(q->status_cmd));
+		q->status_cmd[0] = STLINK_DEBUG_COMMAND;
+		q->status_cmd[1] = status2 ? STLINK_DEBUG_APIV2_GETLASTRWSTATUS2 :
+				STLINK_DEBUG_APIV2_GETLASTRWSTATUS;
+
+		transfers[n_transfers].ep = h->rx_ep;
+		transfers[n_transfers].buf = q->buffer;
+		transfers[n_transfers++].size = q->count * 4;
+
+		transfers[n_transfers].ep = h->tx_ep;
+		transfers[n_transfers].buf = q->status_cmd;
+		transfers[n_transfers++].size = STLINK_CMD_SIZE_V2;
+
+		transfers[n_transfers].ep = h->rx_ep;
+		transfers[n_transfers].buf = q->reply;
+		transfers[n_transfers++].size = status2 ? 12 : 2;
+	}
+
+	int retval = jtag_libusb_bulk_transfer_n(h->fd, transfers, n_transfers,
+			STLINK_WRITE_TIMEOUT);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < n; i++) {
+		struct stlink_queued_read *q = &h->queue[i];
+
+		memcpy(h->databuf, q->reply, sizeof(q->reply));
+		retval = stlink_usb_error_check(h);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (q->reg >= 0)
+			*q->val = le_to_h_u32(q->reply + 4);
+	}
+
+	return ERROR_OK;
+}
+#endif
+
+/** */
+static int stlink_usb_queue_flush(void *handle)
+{
+	struct stlink_usb_handle_s *h = handle;
+	unsigned int n = h->queue_len;
+	int retval = h->queue_retval;
+
+	assert(handle != NULL);
+
+	h->queue_len = 0;
+	h->queue_retval = ERROR_OK;
+	if (retval != ERROR_OK || n == 0)
+		return retval;
+
+#ifdef USE_LIBUSB_ASYNCIO
+	if (stlink_usb_mem_pipeline_ok(h)) {
+		bool batch = true;
+		for (unsigned int i = 0; i < n; i++)
+			batch = batch && stlink_usb_queue_batchable(h, &h->queue[i]);
+
+		if (batch) {
+			retval = stlink_usb_queue_xfer(h, n);
+			/* the reads are repeated one by one below, with retries */
+			if (retval != ERROR_WAIT)
+				return retval;
+		}
+	}
+#endif
+
+	for (unsigned int i = 0; i < n; i++) {
+		struct stlink_queued_read *q = &h->queue[i];
+
+		if (q->reg >= 0)
+			retval = stlink_usb_read_reg(h, q->reg, q->val);
+		else
+			retval = stlink_usb_read_mem(h, q->addr, q->size, q->count, q->buffer);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/** Reserve a queue entry, flushing the queue when it is full */
+static struct stlink_queued_read *stlink_usb_queue_add(struct stlink_usb_handle_s *h)
+{
+	if (h->queue_len == STLINK_QUEUE_SIZE) {
+		int retval = stlink_usb_queue_flush(h);
+		if (retval != ERROR_OK)
+			h->queue_retval = retval;
+	}
+
+	return &h->queue[h->queue_len++];
+}
+
+/** */
+static int stlink_usb_queue_read_reg(void *handle, int num, uint32_t *val)
+{
+	struct stlink_queued_read *q = stlink_usb_queue_add(handle);
+
+	q->reg = num;
+	q->val = val;
+	return ERROR_OK;
+}
+
+/** */
+static int stlink_usb_queue_read_mem(void *handle, uint32_t addr, uint32_t size,
+		uint32_t count, uint8_t *buffer)
+{
+	struct stlink_queued_read *q = stlink_usb_queue_add(handle);
+
+	q->reg = -1;
+	q->addr = addr;
+	q->size = size;
+	q->count = count;
+	q->buffer = buffer;
+	return ERROR_OK;
+}
+
 /** */
 static int stlink_usb_override_target(const char *targetname)
 {
@@ -3150,6 +3508,12 @@ struct hl_layout_api_s stlink_usb_layout_api = {
 	/** */
 	.write_debug_reg = stlink_usb_write_debug_reg,
 	/** */
+	.queue_read_reg = stlink_usb_queue_read_reg,
+	/** */
+	.queue_read_mem = stlink_usb_queue_read_mem,
+	/** */
+	.queue_flush = stlink_usb_queue_flush,
+	/** */
 	.override_target = stlink_usb_override_target,
 	/** */
 	.speed = stlink_speed,
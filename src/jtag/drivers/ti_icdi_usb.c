@@ -51,7 +51,7 @@ struct icdi_usb_handle_s {
 	char *write_buffer;
 	int max_packet;
 	int read_count;
-	uint32_t max_rw_packet; /* max X packet (read/write memory) transfers */
+	uint32_t max_rw_packet; /* max x packet (read memory) transfers */
 };
 
 static int icdi_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
@@ -59,17 +59,23 @@ static int icdi_usb_read_mem(void *handle, uint32_t addr, uint32_t size,
 static int icdi_usb_write_mem(void *handle, uint32_t addr, uint32_t size,
 		uint32_t count, const uint8_t *buffer);
 
+/* bytes which must be escaped in a gdb binary packet */
+static const bool remote_escaped[256] = {
+	['$'] = true, ['#'] = true, ['}'] = true, ['*'] = true,
+};
+
 static int remote_escape_output(const char *buffer, int len, char *out_buf, int *out_len, int out_maxlen)
 {
+	const uint8_t *in = (const uint8_t *)buffer;
 	int input_index, output_index;
 
 	output_index = 0;
 
 	for (input_index = 0; input_index < len; input_index++) {
 
-		char b = buffer[input_index];
+		uint8_t b = in[input_index];
 
-		if (b == '$' || b == '#' || b == '}' || b == '*') {
+		if (remote_escaped[b]) {
 			/* These must be escaped.  */
 			if (output_index + 2 > out_maxlen)
 				break;
@@ -88,30 +94,31 @@ static int remote_escape_output(const char *buffer, int len, char *out_buf, int
 
 static int remote_unescape_input(const char *buffer, int len, char *out_buf, int out_maxlen)
 {
-	int input_index, output_index;
-	int escaped;
-
-	output_index = 0;
-	escaped = 0;
-
-	for (input_index = 0; input_index < len; input_index++) {
+	const char *end = buffer + len;
+	int output_index = 0;
 
-		char b = buffer[input_index];
+	/* copy the runs between escape characters in one go */
+	while (buffer < end) {
+		const char *esc = memchr(buffer, '}', end - buffer);
+		int run = (esc ? esc : end) - buffer;
 
-		if (output_index + 1 > out_maxlen)
+		if (output_index + run + (esc ? 1 : 0) > out_maxlen) {
 			LOG_ERROR("Received too much data from the target.");
+			break;
+		}
 
-		if (escaped) {
-			out_buf[output_index++] = b ^ 0x20;
-			escaped = 0;
-		} else if (b == '}')
-			escaped = 1;
-		else
-			out_buf[output_index++] = b;
-	}
+		memcpy(out_buf + output_index, buffer, run);
+		output_index += run;
+		if (!esc)
+			break;
 
-	if (escaped)
-		LOG_ERROR("Unmatched escape character in target response.");
+		if (esc + 1 == end) {
+			LOG_ERROR("Unmatched escape character in target response.");
+			break;
+		}
+		out_buf[output_index++] = esc[1] ^ 0x20;
+		buffer = esc + 2;
+	}
 
 	return output_index;
 }
@@ -557,21 +564,36 @@ static int icdi_usb_read_mem_int(void *handle, uint32_t addr, uint32_t len, uint
 	return ERROR_OK;
 }
 
-static int icdi_usb_write_mem_int(void *handle, uint32_t addr, uint32_t len, const uint8_t *buffer)
+/* Writes as much of @a len bytes as fits escaped in one packet, @a done
+ * returns how much was written */
+static int icdi_usb_write_mem_int(void *handle, uint32_t addr, uint32_t len,
+		const uint8_t *buffer, uint32_t *done)
 {
 	int result;
 	struct icdi_usb_handle_s *h = handle;
+	size_t cmd_len;
+	int out_len;
 
-	size_t cmd_len = snprintf(h->write_buffer, h->max_packet, PACKET_START "X%" PRIx32 ",%" PRIx32 ":", addr, len);
+	/* room for the "#xx" checksum */
+	int maxlen = h->max_packet - 3;
 
-	int out_len;
-	cmd_len += remote_escape_output((const char *)buffer, len, h->write_buffer + cmd_len,
-			&out_len, h->max_packet - cmd_len);
+	while (1) {
+		cmd_len = snprintf(h->write_buffer, h->max_packet, PACKET_START "X%" PRIx32 ",%" PRIx32 ":",
+				addr, len);
+		cmd_len += remote_escape_output((const char *)buffer, len, h->write_buffer + cmd_len,
+				&out_len, maxlen - cmd_len);
+		if (out_len == (int)len)
+			break;
 
-	if (out_len < (int)len) {
-		/* for now issue a error as we have no way of allocating a larger buffer */
-		LOG_ERROR("memory buffer too small: requires 0x%x actual 0x%" PRIx32, out_len, len);
-		return ERROR_FAIL;
+		/* did not fit, shorten to whole words and encode again
+		 * with the right length in the header */
+		if (out_len >= 4)
+			out_len &= ~3;
+		if (out_len == 0) {
+			LOG_ERROR("memory buffer too small");
+			return ERROR_FAIL;
+		}
+		len = out_len;
 	}
 
 	result = icdi_send_packet(handle, cmd_len);
@@ -585,6 +607,7 @@ static int icdi_usb_write_mem_int(void *handle, uint32_t addr, uint32_t len, con
 		return ERROR_FAIL;
 	}
 
+	*done = len;
 	return ERROR_OK;
 }
 
@@ -628,11 +651,13 @@ static int icdi_usb_write_mem(void *handle, uint32_t addr, uint32_t size,
 
 	while (count) {
 
-		bytes_remaining = h->max_rw_packet;
+		/* the packet takes as much as fits once escaped */
+		bytes_remaining = h->max_packet;
 		if (count < bytes_remaining)
 			bytes_remaining = count;
 
-		retval = icdi_usb_write_mem_int(handle, addr, bytes_remaining, buffer);
+		retval = icdi_usb_write_mem_int(handle, addr, bytes_remaining, buffer,
+				&bytes_remaining);
 		if (retval != ERROR_OK)
 			return retval;
 
@@ -747,10 +772,11 @@ static int icdi_usb_open(struct hl_interface_param_s *param, void **fd)
 
 	*fd = h;
 
-	/* set the max target read/write buffer in bytes
+	/* set the max target read buffer in bytes
 	 * as we are using gdb binary packets to transfer memory we have to
-	 * reserve half the buffer for any possible escape chars plus
-	 * at least 64 bytes for the gdb packet header */
+	 * reserve half the buffer for any possible escape chars in the reply
+	 * plus at least 64 bytes for the gdb packet header; writes are
+	 * escaped here and fill each packet as far as it goes */
 	h->max_rw_packet = (((h->max_packet - 64) / 4) * 4) / 2;
 
 	return ERROR_OK;
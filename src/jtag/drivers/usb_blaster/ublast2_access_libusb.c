@@ -39,6 +39,9 @@
 /** Maximum size of a single firmware section. Entire EZ-USB code space = 16kB */
 #define SECTION_BUFFERSIZE		16384
 
+/** Timeout of the transfers of ublast2_libusb_xfer(), which may be some kB */
+#define XFER_TIMEOUT			1000
+
 static int ublast2_libusb_read(struct ublast_lowlevel *low, uint8_t *buf,
 			      unsigned size, uint32_t *bytes_read)
 {
@@ -72,6 +75,102 @@ static int ublast2_libusb_write(struct ublast_lowlevel *low, uint8_t *buf,
 
 }
 
+static LIBUSB_CALL void ublast2_libusb_xfer_cb(struct libusb_transfer *transfer)
+{
+	int *completed = transfer->user_data;
+	*completed = 1;
+}
+
+/*
+ * Write the bytes and collect the TDO data they produce with bulk
+ * transfers in flight at the same time. The adapter returns the TDO data
+ * in pieces, on each CMD_COPY_TDO_BUFFER, so the IN transfer is
+ * resubmitted for the rest until all of it arrived.
+ */
+static int ublast2_libusb_xfer(struct ublast_lowlevel *low, uint8_t *out,
+			       int out_size, uint8_t *in, unsigned in_size)
+{
+	struct libusb_transfer *transfer_out = libusb_alloc_transfer(0);
+	struct libusb_transfer *transfer_in = libusb_alloc_transfer(0);
+	int out_done = 0, in_done = 0;
+	bool in_pending = false;
+	unsigned received = 0;
+	int ret = ERROR_OK;
+
+	if (!transfer_out || !transfer_in) {
+		LOG_ERROR("unable to allocate USB transfers");
+		libusb_free_transfer(transfer_out);
+		libusb_free_transfer(transfer_in);
+		return ERROR_FAIL;
+	}
+
+	libusb_fill_bulk_transfer(transfer_out, low->libusb_dev,
+				  USBBLASTER_EPOUT | LIBUSB_ENDPOINT_OUT,
+				  out, out_size, ublast2_libusb_xfer_cb,
+				  &out_done, XFER_TIMEOUT);
+	if (libusb_submit_transfer(transfer_out) != LIBUSB_SUCCESS) {
+		LOG_ERROR("error submitting USB write");
+		ret = ERROR_FAIL;
+		out_done = 1;
+	}
+
+	while (ret == ERROR_OK && received < in_size) {
+		libusb_fill_bulk_transfer(transfer_in, low->libusb_dev,
+					  USBBLASTER_EPIN | LIBUSB_ENDPOINT_IN,
+					  in + received, in_size - received,
+					  ublast2_libusb_xfer_cb, &in_done,
+					  XFER_TIMEOUT);
+		in_done = 0;
+		if (libusb_submit_transfer(transfer_in) != LIBUSB_SUCCESS) {
+			LOG_ERROR("error submitting USB read");
+			ret = ERROR_FAIL;
+			break;
+		}
+		in_pending = true;
+
+		while (ret == ERROR_OK && !in_done)
+			ret = jtag_libusb_handle_events_completed(&in_done);
+		if (ret != ERROR_OK)
+			break;
+		in_pending = false;
+
+		if (transfer_in->status != LIBUSB_TRANSFER_COMPLETED) {
+			LOG_ERROR("USB read failed (status %d)", transfer_in->status);
+			ret = ERROR_FAIL;
+			break;
+		}
+		received += transfer_in->actual_length;
+		adapter_stats_usb(transfer_in->actual_length);
+	}
+
+	/* a failed transfer must be finished before it is freed */
+	if (ret != ERROR_OK) {
+		if (in_pending) {
+			libusb_cancel_transfer(transfer_in);
+			while (!in_done && jtag_libusb_handle_events_completed(&in_done) == ERROR_OK)
+				;
+		}
+		if (!out_done)
+			libusb_cancel_transfer(transfer_out);
+	}
+	while (!out_done) {
+		if (jtag_libusb_handle_events_completed(&out_done) != ERROR_OK)
+			ret = ERROR_FAIL;
+	}
+
+	if (ret == ERROR_OK && (transfer_out->status != LIBUSB_TRANSFER_COMPLETED ||
+			transfer_out->actual_length != out_size)) {
+		LOG_ERROR("USB write failed (status %d)", transfer_out->status);
+		ret = ERROR_FAIL;
+	}
+	if (ret == ERROR_OK)
+		adapter_stats_usb(out_size);
+
+	libusb_free_transfer(transfer_out);
+	libusb_free_transfer(transfer_in);
+	return ret;
+}
+
 static int ublast2_write_firmware_section(struct libusb_device_handle *libusb_dev,
 				   struct image *firmware_image, int section_index)
 {
@@ -255,6 +354,7 @@ static struct ublast_lowlevel low = {
 	.close = ublast2_libusb_quit,
 	.read = ublast2_libusb_read,
 	.write = ublast2_libusb_write,
+	.xfer = ublast2_libusb_xfer,
 	.flags = COPY_TDO_BUFFER,
 };
 
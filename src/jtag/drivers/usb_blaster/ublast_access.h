@@ -44,6 +44,13 @@ struct ublast_lowlevel {
 		     uint32_t *bytes_written);
 	int (*read)(struct ublast_lowlevel *low, uint8_t *buf, unsigned size,
 		    uint32_t *bytes_read);
+	/*
+	 * Optional: write out_size bytes and read exactly in_size bytes
+	 * back, with the read already pending while the bytes are written.
+	 * Without it the read back data has to fit in the adapter FIFO.
+	 */
+	int (*xfer)(struct ublast_lowlevel *low, uint8_t *out, int out_size,
+		    uint8_t *in, unsigned in_size);
 	int (*open)(struct ublast_lowlevel *low);
 	int (*close)(struct ublast_lowlevel *low);
 	int (*speed)(struct ublast_lowlevel *low, int speed);
@@ -106,6 +106,19 @@ enum gpio_steer {
 	TRST,
 };
 
+/* TDO data the queued bytes return, stored at dst on the next flush */
+struct ublast_read {
+	uint8_t *dst;
+	int len;	/* bytes, or bits in bitbang mode */
+	bool bitbang;
+};
+
+/* scan waiting for its TDO data before jtag_read_buffer() */
+struct ublast_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
 struct ublast_info {
 	enum gpio_steer pin6;
 	enum gpio_steer pin8;
@@ -116,6 +129,20 @@ struct ublast_info {
 	uint8_t buf[BUF_LEN];
 	int bufidx;
 
+	/*
+	 * TDO reads are not done per byte-shift packet but collected behind
+	 * the output of the whole buffer. Without an xfer() lowlevel the
+	 * data must fit in the adapter FIFO, max_read_len is lower then.
+	 */
+	struct ublast_read reads[BUF_LEN / 2];
+	int nb_reads;
+	int read_len;
+	int max_read_len;
+	uint8_t rbuf[BUF_LEN];
+	struct ublast_scan scans[BUF_LEN / 2];
+	int nb_scans;
+	int retval;
+
 	char *lowlevel_name;
 	struct ublast_lowlevel *drv;
 	char *ublast_device_desc;
@@ -196,18 +223,6 @@ static int nb_buf_remaining(void)
 	return BUF_LEN - info.bufidx;
 }
 
-static void ublast_flush_buffer(void)
-{
-	uint32_t retlen;
-	int nb = info.bufidx, ret = ERROR_OK;
-
-	while (ret == ERROR_OK && nb > 0) {
-		ret = ublast_buf_write(info.buf, nb, &retlen);
-		nb -= retlen;
-	}
-	info.bufidx = 0;
-}
-
 /*
  * Actually, the USB-Blaster offers a byte-shift mode to transmit up to 504 data
  * bits (bidirectional) in a single USB packet. A header byte has to be sent as
@@ -251,6 +266,98 @@ static void ublast_flush_buffer(void)
 #define SHMODE		(1 << 7)
 #define READ_TDO	(1 << 0)
 
+/* Store the TDO data of all queued reads where it belongs */
+static void ublast_parse_reads(void)
+{
+	uint8_t *p = info.rbuf;
+
+	for (int r = 0; r < info.nb_reads; r++) {
+		struct ublast_read *rd = &info.reads[r];
+
+		if (rd->dst && rd->bitbang) {
+			for (int i = 0; i < rd->len; i++) {
+				if (p[i] & READ_TDO)
+					*rd->dst |= (1 << i);
+				else
+					*rd->dst &= ~(1 << i);
+			}
+		} else if (rd->dst) {
+			memcpy(rd->dst, p, rd->len);
+		}
+		p += rd->len;
+	}
+}
+
+/*
+ * Write the buffer, read back the TDO data of the queued reads and hand
+ * the completed scans to jtag_read_buffer(). Errors are kept for
+ * ublast_execute_queue().
+ */
+static int ublast_flush_buffer(void)
+{
+	uint32_t retlen;
+	int nb = info.bufidx, done = 0, ret = ERROR_OK;
+
+	if (info.read_len && info.drv->xfer) {
+		ret = info.drv->xfer(info.drv, info.buf, nb, info.rbuf, info.read_len);
+		LOG_DEBUG_IO("(size=%d, read=%d) -> %d", nb, info.read_len, ret);
+	} else {
+		while (ret == ERROR_OK && done < nb) {
+			ret = ublast_buf_write(info.buf + done, nb - done, &retlen);
+			done += retlen;
+		}
+		for (done = 0; ret == ERROR_OK && done < info.read_len; done += retlen) {
+			ret = ublast_buf_read(info.rbuf + done, info.read_len - done, &retlen);
+			if (ret == ERROR_OK && retlen == 0) {
+				LOG_ERROR("no TDO data from the adapter");
+				ret = ERROR_JTAG_DEVICE_ERROR;
+			}
+		}
+	}
+	info.bufidx = 0;
+
+	if (ret == ERROR_OK)
+		ublast_parse_reads();
+	info.nb_reads = 0;
+	info.read_len = 0;
+
+	for (int i = 0; i < info.nb_scans; i++) {
+		if (ret == ERROR_OK)
+			ret = jtag_read_buffer(info.scans[i].buf, info.scans[i].cmd);
+		free(info.scans[i].buf);
+	}
+	info.nb_scans = 0;
+
+	if (info.retval == ERROR_OK)
+		info.retval = ret;
+	return ret;
+}
+
+/**
+ * ublast_reserve - make room for bytes with TDO reads
+ * @nb_out: number of bytes to be queued
+ * @nb_in: number of TDO bytes they return
+ *
+ * A unit of bytes which returns TDO data must not be split by a flush, else
+ * the TDO data would not match the reads known at the flush.
+ */
+static void ublast_reserve(int nb_out, int nb_in)
+{
+	if (nb_buf_remaining() < nb_out || info.read_len + nb_in > info.max_read_len)
+		ublast_flush_buffer();
+}
+
+/* Expect @len TDO bytes (bits if @bitbang) of the bytes just queued */
+static void ublast_queue_read(uint8_t *dst, int len, bool bitbang)
+{
+	struct ublast_read *rd = &info.reads[info.nb_reads++];
+
+	rd->dst = dst;
+	rd->len = len;
+	rd->bitbang = bitbang;
+	info.read_len += len;
+}
+
 /**
  * ublast_queue_byte - queue one 'bitbang mode' byte for USB Blaster
  * @abyte: the byte to queue
@@ -264,8 +371,6 @@ static void ublast_queue_byte(uint8_t abyte)
 	if (nb_buf_remaining() < 1)
 		ublast_flush_buffer();
 	info.buf[info.bufidx++] = abyte;
-	if (nb_buf_remaining() == 0)
-		ublast_flush_buffer();
 	LOG_DEBUG_IO("(byte=0x%02x)", abyte);
 }
 
@@ -421,7 +526,7 @@ static void ublast_clock_tdi_flip_tms(int tdi, enum scan_type type)
  *
  * Queues bytes to be sent to the USB Blaster. The bytes are not
  * actually sent, but stored in a buffer. The write is performed once
- * the buffer is filled, or if an explicit ublast_flush_buffer() is called.
+ * more bytes need room, or if an explicit ublast_flush_buffer() is called.
  */
 static void ublast_queue_bytes(uint8_t *bytes, int nb_bytes)
 {
@@ -437,8 +542,6 @@ static void ublast_queue_bytes(uint8_t *bytes, int nb_bytes)
 	else
 		memset(&info.buf[info.bufidx], 0, nb_bytes);
 	info.bufidx += nb_bytes;
-	if (nb_buf_remaining() == 0)
-		ublast_flush_buffer();
 }
 
 /**
@@ -522,74 +625,6 @@ static void ublast_state_move(tap_state_t state, int skip)
 	tap_set_state(state);
 }
 
-/**
- * ublast_read_byteshifted_tdos - read TDO of byteshift writes
- * @buf: the buffer to store the bits
- * @nb_bits: the number of bits
- *
- * Reads back from USB Blaster TDO bits, triggered by a 'byteshift write', ie. eight
- * bits per received byte from USB interface, and store them in buffer.
- *
- * As the USB blaster stores the TDO bits in LSB (ie. first bit in (byte0,
- * bit0), second bit in (byte0, bit1), ...), which is what we want to return,
- * simply read bytes from USB interface and store them.
- *
- * Returns ERROR_OK if OK, ERROR_xxx if a read error occurred
- */
-static int ublast_read_byteshifted_tdos(uint8_t *buf, int nb_bytes)
-{
-	uint32_t retlen;
-	int ret = ERROR_OK;
-
-	LOG_DEBUG_IO("%s(buf=%p, num_bits=%d)", __func__, buf, nb_bytes * 8);
-	ublast_flush_buffer();
-	while (ret == ERROR_OK && nb_bytes > 0) {
-		ret = ublast_buf_read(buf, nb_bytes, &retlen);
-		nb_bytes -= retlen;
-	}
-	return ret;
-}
-
-/**
- * ublast_read_bitbang_tdos - read TDO of bitbang writes
- * @buf: the buffer to store the bits
- * @nb_bits: the number of bits
- *
- * Reads back from USB Blaster TDO bits, triggered by a 'bitbang write', ie. one
- * bit per received byte from USB interface, and store them in buffer, where :
- *  - first bit is stored in byte0, bit0 (LSB)
- *  - second bit is stored in byte0, bit 1
- *  ...
- *  - eight bit is sotred in byte0, bit 7
- *  - ninth bit is sotred in byte1, bit 0
- *  - etc ...
- *
- * Returns ERROR_OK if OK, ERROR_xxx if a read error occurred
- */
-static int ublast_read_bitbang_tdos(uint8_t *buf, int nb_bits)
-{
-	int nb1 = nb_bits;
-	int i, ret = ERROR_OK;
-	uint32_t retlen;
-	uint8_t tmp[8];
-
-	LOG_DEBUG_IO("%s(buf=%p, num_bits=%d)", __func__, buf, nb_bits);
-
-	/*
-	 * Ensure all previous bitbang writes were issued to the dongle, so that
-	 * it returns back the read values.
-	 */
-	ublast_flush_buffer();
-
-	ret = ublast_buf_read(tmp, nb1, &retlen);
-	for (i = 0; ret == ERROR_OK && i < nb1; i++)
-		if (tmp[i] & READ_TDO)
-			*buf |= (1 << i);
-		else
-			*buf &= ~(1 << i);
-	return ret;
-}
-
 /**
  * ublast_queue_tdi - short description
  * @bits: bits to be queued on TDI (or NULL if 0 are to be queued)
@@ -600,8 +635,10 @@ static int ublast_read_bitbang_tdos(uint8_t *buf, int nb_bits)
  * As a side effect, the last TDI bit is sent along a TMS=1, and triggers a JTAG
  * TAP state shift if input bits were non NULL.
  *
- * In order to not saturate the USB Blaster queues, this method reads back TDO
- * if the scan type requests it, and stores them back in bits.
+ * If the scan type requests it, the TDO bits are stored back in bits on the
+ * next flush. Each byte-shift packet or bitbang tail returning TDO data is
+ * queued as a whole, so that the adapter queues hold the data until it is
+ * read back.
  *
  * As a side note, the state of TCK when entering this function *must* be
  * low. This is because byteshift mode outputs TDI on rising TCK and reads TDO
@@ -614,7 +651,6 @@ static void ublast_queue_tdi(uint8_t *bits, int nb_bits, enum scan_type scan)
 	int nb8 = nb_bits / 8;
 	int nb1 = nb_bits % 8;
 	int nbfree_in_packet, i, trans = 0, read_tdos;
-	uint8_t *tdos = calloc(1, nb_bits / 8 + 1);
 	static uint8_t byte0[BUF_LEN];
 
 	/*
@@ -633,6 +669,10 @@ static void ublast_queue_tdi(uint8_t *bits, int nb_bits, enum scan_type scan)
 
 	read_tdos = (scan == SCAN_IN || scan == SCAN_IO);
 	for (i = 0; i < nb8; i += trans) {
+		/* header, a packet of data and CMD_COPY_TDO_BUFFER */
+		if (read_tdos)
+			ublast_reserve(MAX_PACKET_SIZE + 1, MIN(MAX_PACKET_SIZE - 1, nb8 - i));
+
 		/*
 		 * Calculate number of bytes to fill USB packet of size MAX_PACKET_SIZE
 		 */
@@ -656,13 +696,15 @@ static void ublast_queue_tdi(uint8_t *bits, int nb_bits, enum scan_type scan)
 		if (read_tdos) {
 			if (info.flags & COPY_TDO_BUFFER)
 				ublast_queue_byte(CMD_COPY_TDO_BUFFER);
-			ublast_read_byteshifted_tdos(&tdos[i], trans);
+			ublast_queue_read(bits ? &bits[i] : NULL, trans, false);
 		}
 	}
 
 	/*
 	 * Queue the remaining TDI bits in bitbang mode.
 	 */
+	if (nb1 && read_tdos)
+		ublast_reserve(2 * nb1 + 2, nb1);
 	for (i = 0; i < nb1; i++) {
 		int tdi = bits ? bits[nb8 + i / 8] & (1 << i) : 0;
 		if (bits && i == nb1 - 1)
@@ -673,13 +715,9 @@ static void ublast_queue_tdi(uint8_t *bits, int nb_bits, enum scan_type scan)
 	if (nb1 && read_tdos) {
 		if (info.flags & COPY_TDO_BUFFER)
 			ublast_queue_byte(CMD_COPY_TDO_BUFFER);
-		ublast_read_bitbang_tdos(&tdos[nb8], nb1);
+		ublast_queue_read(bits ? &bits[nb8] : NULL, nb1, true);
 	}
 
-	if (bits)
-		memcpy(bits, tdos, DIV_ROUND_UP(nb_bits, 8));
-	free(tdos);
-
 	/*
 	 * Ensure clock is in lower state
 	 */
@@ -705,7 +743,8 @@ static void ublast_stableclocks(int cycles)
  * ublast_scan - launches a DR-scan or IR-scan
  * @cmd: the command to launch
  *
- * Launch a JTAG IR-scan or DR-scan
+ * Launch a JTAG IR-scan or DR-scan. The captured bits are handed to
+ * jtag_read_buffer() once they are read back, on a later flush.
  *
  * Returns ERROR_OK if OK, ERROR_xxx if a read/write error occurred.
  */
@@ -735,8 +774,15 @@ static int ublast_scan(struct scan_command *cmd)
 
 	ublast_queue_tdi(buf, scan_bits, type);
 
-	ret = jtag_read_buffer(buf, cmd);
-	free(buf);
+	if (type == SCAN_OUT) {
+		ret = jtag_read_buffer(buf, cmd);
+		free(buf);
+	} else {
+		info.scans[info.nb_scans].cmd = cmd;
+		info.scans[info.nb_scans].buf = buf;
+		if (++info.nb_scans == ARRAY_SIZE(info.scans))
+			ret = ublast_flush_buffer();
+	}
 	/*
 	 * ublast_queue_tdi sends the last bit with TMS=1. We are therefore
 	 * already in Exit1-DR/IR and have to skip the first step on our way
@@ -824,6 +870,9 @@ static int ublast_execute_queue(void)
 	}
 
 	ublast_flush_buffer();
+	if (ret == ERROR_OK)
+		ret = info.retval;
+	info.retval = ERROR_OK;
 	return ret;
 }
 
@@ -877,6 +926,7 @@ static int ublast_init(void)
 	info.drv->firmware_path = info.firmware_path;
 
 	info.flags |= info.drv->flags;
+	info.max_read_len = info.drv->xfer ? (int)sizeof(info.rbuf) : MAX_PACKET_SIZE;
 
 	ret = info.drv->open(info.drv);
 
@@ -32,8 +32,10 @@ uint8_t *versaloon_buf;
 uint8_t *versaloon_cmd_buf;
 uint16_t versaloon_buf_size;
 
-struct versaloon_pending_t versaloon_pending[VERSALOON_MAX_PENDING_NUMBER];
+struct versaloon_pending_t *versaloon_pending;
 uint16_t versaloon_pending_idx;
+/* allocated entries of versaloon_pending */
+static uint16_t versaloon_pending_size;
 
 libusb_device_handle *versaloon_usb_device_handle;
 static uint32_t versaloon_usb_to = VERSALOON_TIMEOUT;
@@ -123,7 +125,7 @@ void versaloon_free_want_pos(void)
 	}
 	versaloon_want_pos = NULL;
 
-	for (i = 0; i < dimof(versaloon_pending); i++) {
+	for (i = 0; i < versaloon_pending_size; i++) {
 		tmp = versaloon_pending[i].pos;
 		while (tmp != NULL) {
 			free_tmp = tmp;
@@ -172,6 +174,29 @@ RESULT versaloon_add_pending(uint8_t type, uint8_t cmd, uint16_t actual_szie,
 	}
 #endif
 
+	if (versaloon_pending_idx >= versaloon_pending_size) {
+		uint16_t size = versaloon_pending_size ?
+			versaloon_pending_size * 2 : VERSALOON_MIN_PENDING_NUMBER;
+		struct versaloon_pending_t *pending;
+
+		if (size > VERSALOON_MAX_PENDING_NUMBER)
+			size = VERSALOON_MAX_PENDING_NUMBER;
+		if (size <= versaloon_pending_idx) {
+			LOG_BUG(ERRMSG_INVALID_INDEX, versaloon_pending_idx,
+				"versaloon pending data");
+			return ERROR_FAIL;
+		}
+		pending = realloc(versaloon_pending, size * sizeof(*pending));
+		if (NULL == pending) {
+			LOG_ERROR(ERRMSG_NOT_ENOUGH_MEMORY);
+			return ERRCODE_NOT_ENOUGH_MEMORY;
+		}
+		memset(pending + versaloon_pending_size, 0,
+			(size - versaloon_pending_size) * sizeof(*pending));
+		versaloon_pending = pending;
+		versaloon_pending_size = size;
+	}
+
 	versaloon_pending[versaloon_pending_idx].type = type;
 	versaloon_pending[versaloon_pending_idx].cmd = cmd;
 	versaloon_pending[versaloon_pending_idx].actual_data_size = actual_szie;
@@ -297,6 +322,11 @@ RESULT versaloon_fini(void)
 		usbtoxxx_fini();
 		versaloon_free_want_pos();
 
+		free(versaloon_pending);
+		versaloon_pending = NULL;
+		versaloon_pending_size = 0;
+		versaloon_pending_idx = 0;
+
 		versaloon_usb_device_handle = NULL;
 
 		free(versaloon_buf);
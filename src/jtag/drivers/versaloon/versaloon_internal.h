@@ -69,8 +69,9 @@
 
 #define MP_ISSP							0x11
 
-/* pending struct */
+/* pending struct, the pool grows on demand up to the maximum */
 #define VERSALOON_MAX_PENDING_NUMBER	4096
+#define VERSALOON_MIN_PENDING_NUMBER	64
 typedef RESULT(*versaloon_callback_t)(void *, uint8_t *, uint8_t *);
 struct versaloon_want_pos_t {
 	uint16_t offset;
@@ -91,8 +92,7 @@ struct versaloon_pending_t {
 	void *extra_data;
 	versaloon_callback_t callback;
 };
-extern struct versaloon_pending_t
-	versaloon_pending[VERSALOON_MAX_PENDING_NUMBER];
+extern struct versaloon_pending_t *versaloon_pending;
 extern uint16_t versaloon_pending_idx;
 void versaloon_set_pending_id(uint32_t id);
 void versaloon_set_callback(versaloon_callback_t callback);
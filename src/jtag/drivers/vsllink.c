@@ -44,11 +44,13 @@ struct pending_scan_result {
 	bool last;	/* indicate the last scan pending */
 };
 
-#define MAX_PENDING_SCAN_RESULTS 256
+/* initial size of the pending scan results, the buffer grows as needed so
+ * that only a full TAP buffer or the end of the queue commits the scans */
+#define MIN_PENDING_SCAN_RESULTS 256
 
 static int pending_scan_results_length;
-static struct pending_scan_result
-	pending_scan_results_buffer[MAX_PENDING_SCAN_RESULTS];
+static int pending_scan_results_size;
+static struct pending_scan_result *pending_scan_results_buffer;
 
 /* Queue command functions */
 static void vsllink_end_state(tap_state_t state);
@@ -253,6 +255,10 @@ static void vsllink_free_buffer(void)
 
 	free(tms_buffer);
 	tms_buffer = NULL;
+
+	free(pending_scan_results_buffer);
+	pending_scan_results_buffer = NULL;
+	pending_scan_results_size = 0;
 }
 
 static int vsllink_quit(void)
@@ -333,7 +339,11 @@ static int vsllink_init(void)
 		tdi_buffer = malloc(tap_buffer_size);
 		tdo_buffer = malloc(tap_buffer_size);
 		tms_buffer = malloc(tap_buffer_size);
-		if ((NULL == tdi_buffer) || (NULL == tdo_buffer) || (NULL == tms_buffer)) {
+		pending_scan_results_size = MIN_PENDING_SCAN_RESULTS;
+		pending_scan_results_buffer = malloc(pending_scan_results_size *
+				sizeof(*pending_scan_results_buffer));
+		if ((NULL == tdi_buffer) || (NULL == tdo_buffer) || (NULL == tms_buffer)
+				|| (NULL == pending_scan_results_buffer)) {
 			vsllink_quit();
 			return ERROR_FAIL;
 		}
@@ -562,10 +572,21 @@ static void vsllink_tap_init(void)
 static void vsllink_tap_ensure_pending(int scans)
 {
 	int available_scans =
-		MAX_PENDING_SCAN_RESULTS - pending_scan_results_length;
+		pending_scan_results_size - pending_scan_results_length;
+
+	if (scans <= available_scans)
+		return;
 
-	if (scans > available_scans)
+	int size = 2 * pending_scan_results_size;
+	struct pending_scan_result *results = realloc(pending_scan_results_buffer,
+			size * sizeof(*results));
+	if (results) {
+		pending_scan_results_buffer = results;
+		pending_scan_results_size = size;
+	} else {
+		/* keep going with the buffer we have */
 		vsllink_tap_execute();
+	}
 }
 
 static void vsllink_tap_append_step(int tms, int tdi)
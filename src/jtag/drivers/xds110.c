@@ -225,6 +225,8 @@ struct xds110_info {
 	uint8_t interface;
 	uint8_t endpoint_in;
 	uint8_t endpoint_out;
+	/* Max packet size reported by the IN endpoint */
+	int max_packet;
 	/* Status flags */
 	bool is_connected;
 	bool is_cmapi_connected;
@@ -252,6 +254,8 @@ struct xds110_info {
 	uint32_t txn_request_size;
 	uint32_t txn_result_size;
 	uint32_t txn_result_count;
+	/* Error of a queue run because the queue filled up */
+	int txn_retval;
 };
 
 static struct xds110_info xds110 = {
@@ -262,6 +266,7 @@ static struct xds110_info xds110 = {
 	.interface = 0,
 	.endpoint_in = 0,
 	.endpoint_out = 0,
+	.max_packet = MAX_PACKET,
 	.is_connected = false,
 	.is_cmapi_connected = false,
 	.is_cmapi_acquired = false,
@@ -275,7 +280,8 @@ static struct xds110_info xds110 = {
 	.hardware = 0,
 	.txn_request_size = 0,
 	.txn_result_size = 0,
-	.txn_result_count = 0
+	.txn_result_count = 0,
+	.txn_retval = ERROR_OK
 };
 
 static inline void xds110_set_u32(uint8_t *buffer, uint32_t value)
@@ -422,6 +428,12 @@ static bool usb_connect(void)
 		/* Set libusb to auto detach kernel */
 		(void)libusb_set_auto_detach_kernel_driver(dev, 1);
 
+		/* Read responses in the packets the firmware sends */
+		xds110.max_packet = libusb_get_max_packet_size(libusb_get_device(dev),
+			xds110.endpoint_in);
+		if (xds110.max_packet <= 0 || xds110.max_packet > MAX_PACKET)
+			xds110.max_packet = MAX_PACKET;
+
 		/* Claim the debug interface on the XDS110 */
 		result = libusb_claim_interface(dev, xds110.interface);
 	} else {
@@ -522,7 +534,7 @@ static bool usb_get_response(uint32_t *total_bytes_read, uint32_t timeout)
 	size = 0;
 	success = true;
 	while (success) {
-		success = usb_read(buffer, sizeof(buffer), &bytes_read, timeout);
+		success = usb_read(buffer, xds110.max_packet, &bytes_read, timeout);
 		if (success) {
 			/*
 			 * Validate that this appears to be a good response packet
@@ -569,20 +581,15 @@ static bool usb_get_response(uint32_t *total_bytes_read, uint32_t timeout)
 	if (timeout > 500)
 		timeout = 500; /* ms */
 
-	/* If there's more data to retrieve, get it now */
+	/*
+	 * If there's more data to retrieve, get it now, straight into
+	 * xds110.read_payload and in as few transfers as the XDS110 allows
+	 */
 	while ((count < size) && success) {
-		success = usb_read(buffer, sizeof(buffer), &bytes_read, timeout);
-		if (success) {
-			if ((count + bytes_read) > size) {
-				/* Read too much data, not a valid packet, abort */
-				success = false;
-			} else {
-				/* Copy this data over to xds110.read_payload */
-				memcpy((void *)&xds110.read_payload[count], (void *)buffer,
-					bytes_read);
-				count += bytes_read;
-			}
-		}
+		success = usb_read(&xds110.read_payload[count], size - count,
+					&bytes_read, timeout);
+		if (success)
+			count += bytes_read;
 	}
 
 	if (!success)
@@ -1323,7 +1330,13 @@ static int xds110_swd_run_queue(void)
 	xds110.txn_result_size = 0;
 	xds110.txn_result_count = 0;
 
-	return (success) ? ERROR_OK : ERROR_FAIL;
+	if (!success)
+		return ERROR_FAIL;
+
+	/* Report the failure of a run made because the queue was full */
+	int retval = xds110.txn_retval;
+	xds110.txn_retval = ERROR_OK;
+	return retval;
 }
 
 static void xds110_swd_queue_cmd(uint8_t cmd, uint32_t *value)
@@ -1338,8 +1351,11 @@ static void xds110_swd_queue_cmd(uint8_t cmd, uint32_t *value)
 
 	/* Check if new request would be too large to fit */
 	if (((xds110.txn_request_size + request_size + 1) > MAX_DATA_BLOCK) ||
-		((xds110.txn_result_count + 1) > MAX_RESULT_QUEUE))
-		xds110_swd_run_queue();
+		((xds110.txn_result_count + 1) > MAX_RESULT_QUEUE)) {
+		int retval = xds110_swd_run_queue();
+		if (xds110.txn_retval == ERROR_OK)
+			xds110.txn_retval = retval;
+	}
 
 	/* Set the START bit in cmd to ensure cmd is not zero */
 	/* (a value of zero is used to terminate the buffer) */
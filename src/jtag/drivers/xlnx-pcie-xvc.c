@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <linux/pci.h>
 
 #include <jtag/interface.h>
@@ -37,6 +38,18 @@
 #define XLNX_XVC_VSEC_ID	0x8
 #define XLNX_XVC_MAX_BITS	0x20
 
+/* Register map of the debug bridge when mapped through a BAR instead of
+ * the configuration space (PG245, AXI-to-JTAG mode) */
+#define XLNX_XVC_BAR_LEN_REG	0x00
+#define XLNX_XVC_BAR_TMS_REG	0x04
+#define XLNX_XVC_BAR_TDI_REG	0x08
+#define XLNX_XVC_BAR_TDO_REG	0x0C
+#define XLNX_XVC_BAR_CTRL_REG	0x10
+#define XLNX_XVC_BAR_SIZE	0x14
+#define XLNX_XVC_BAR_CTRL_START	BIT(0)
+/* polls of the control register before a shift is given up */
+#define XLNX_XVC_BAR_POLL_MAX	100000
+
 #define MASK_ACK(x) (((x) >> 9) & 0x7)
 #define MASK_PAR(x) ((int)((x) & 0x1))
 
@@ -44,9 +57,17 @@ struct xlnx_pcie_xvc {
 	int fd;
 	unsigned offset;
 	char *device;
+	/* BAR mapping, when xlnx_pcie_xvc_bar is set */
+	int bar;
+	uint32_t bar_offset;
+	void *bar_map;
+	size_t bar_map_size;
+	volatile uint32_t *bar_regs;
 };
 
-static struct xlnx_pcie_xvc xlnx_pcie_xvc_state;
+static struct xlnx_pcie_xvc xlnx_pcie_xvc_state = {
+	.bar = -1,
+};
 static struct xlnx_pcie_xvc *xlnx_pcie_xvc = &xlnx_pcie_xvc_state;
 
 static int xlnx_pcie_xvc_read_reg(const int offset, uint32_t *val)
@@ -90,11 +111,39 @@ static int xlnx_pcie_xvc_write_reg(const int offset, const uint32_t val)
 	return ERROR_OK;
 }
 
+/* One shift through the mapped registers, without any syscall */
+static int xlnx_pcie_xvc_bar_transact(size_t num_bits, uint32_t tms, uint32_t tdi,
+				      uint32_t *tdo)
+{
+	volatile uint32_t *regs = xlnx_pcie_xvc->bar_regs;
+	unsigned int polls = 0;
+
+	regs[XLNX_XVC_BAR_LEN_REG / 4] = num_bits;
+	regs[XLNX_XVC_BAR_TMS_REG / 4] = tms;
+	regs[XLNX_XVC_BAR_TDI_REG / 4] = tdi;
+	regs[XLNX_XVC_BAR_CTRL_REG / 4] = XLNX_XVC_BAR_CTRL_START;
+
+	while (regs[XLNX_XVC_BAR_CTRL_REG / 4] & XLNX_XVC_BAR_CTRL_START) {
+		if (++polls == XLNX_XVC_BAR_POLL_MAX) {
+			LOG_ERROR("XVC shift of %zu bits did not complete", num_bits);
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	if (tdo)
+		*tdo = regs[XLNX_XVC_BAR_TDO_REG / 4];
+
+	return ERROR_OK;
+}
+
 static int xlnx_pcie_xvc_transact(size_t num_bits, uint32_t tms, uint32_t tdi,
 				  uint32_t *tdo)
 {
 	int err;
 
+	if (xlnx_pcie_xvc->bar_regs)
+		return xlnx_pcie_xvc_bar_transact(num_bits, tms, tdi, tdo);
+
 	err = xlnx_pcie_xvc_write_reg(XLNX_XVC_LEN_REG, num_bits);
 	if (err != ERROR_OK)
 		return err;
@@ -379,12 +428,46 @@ static int xlnx_pcie_xvc_execute_queue(void)
 }
 
 
+static int xlnx_pcie_xvc_init_bar(void)
+{
+	char filename[PATH_MAX];
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	off_t base = xlnx_pcie_xvc->bar_offset & ~(page_size - 1);
+	size_t skip = xlnx_pcie_xvc->bar_offset - base;
+
+	snprintf(filename, PATH_MAX, "/sys/bus/pci/devices/%s/resource%d",
+		 xlnx_pcie_xvc->device, xlnx_pcie_xvc->bar);
+	xlnx_pcie_xvc->fd = open(filename, O_RDWR | O_SYNC);
+	if (xlnx_pcie_xvc->fd < 0) {
+		LOG_ERROR("Failed to open device: %s", filename);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	xlnx_pcie_xvc->bar_map_size = DIV_ROUND_UP(skip + XLNX_XVC_BAR_SIZE, page_size) * page_size;
+	xlnx_pcie_xvc->bar_map = mmap(NULL, xlnx_pcie_xvc->bar_map_size, PROT_READ | PROT_WRITE,
+				      MAP_SHARED, xlnx_pcie_xvc->fd, base);
+	if (xlnx_pcie_xvc->bar_map == MAP_FAILED) {
+		LOG_ERROR("Failed to map %s: %s", filename, strerror(errno));
+		close(xlnx_pcie_xvc->fd);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+	xlnx_pcie_xvc->bar_regs = (volatile uint32_t *)((uint8_t *)xlnx_pcie_xvc->bar_map + skip);
+
+	LOG_INFO("Using Xilinx XVC/PCIe registers in BAR%d at offset: 0x%" PRIx32,
+		 xlnx_pcie_xvc->bar, xlnx_pcie_xvc->bar_offset);
+
+	return ERROR_OK;
+}
+
 static int xlnx_pcie_xvc_init(void)
 {
 	char filename[PATH_MAX];
 	uint32_t cap, vh;
 	int err;
 
+	if (xlnx_pcie_xvc->bar >= 0)
+		return xlnx_pcie_xvc_init_bar();
+
 	snprintf(filename, PATH_MAX, "/sys/bus/pci/devices/%s/config",
 		 xlnx_pcie_xvc->device);
 	xlnx_pcie_xvc->fd = open(filename, O_RDWR | O_SYNC);
@@ -438,6 +521,11 @@ static int xlnx_pcie_xvc_quit(void)
 {
 	int err;
 
+	if (xlnx_pcie_xvc->bar_regs) {
+		munmap(xlnx_pcie_xvc->bar_map, xlnx_pcie_xvc->bar_map_size);
+		xlnx_pcie_xvc->bar_regs = NULL;
+	}
+
 	err = close(xlnx_pcie_xvc->fd);
 	if (err)
 		return err;
@@ -460,6 +548,32 @@ COMMAND_HANDLER(xlnx_pcie_xvc_handle_config_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(xlnx_pcie_xvc_handle_bar_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int bar;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], bar);
+	if (bar > 5) {
+		command_print(CMD, "BAR index must be 0 to 5");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	uint32_t offset = 0;
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], offset);
+		if (offset % 4) {
+			command_print(CMD, "offset must be 32-bit aligned");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	xlnx_pcie_xvc->bar = bar;
+	xlnx_pcie_xvc->bar_offset = offset;
+	return ERROR_OK;
+}
+
 static const struct command_registration xlnx_pcie_xvc_command_handlers[] = {
 	{
 		.name = "xlnx_pcie_xvc_config",
@@ -468,6 +582,13 @@ static const struct command_registration xlnx_pcie_xvc_command_handlers[] = {
 		.help = "Configure XVC/PCIe JTAG adapter",
 		.usage = "device",
 	},
+	{
+		.name = "xlnx_pcie_xvc_bar",
+		.handler = xlnx_pcie_xvc_handle_bar_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use the XVC registers mapped in a BAR of the device",
+		.usage = "bar_index [offset]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -63,6 +63,28 @@ struct hl_layout_api_s {
 			uint32_t count, const uint8_t *buffer);
 	/** */
 	int (*write_debug_reg)(void *handle, uint32_t addr, uint32_t val);
+	/**
+	 * Queue the read of a core register, for adapters which can send
+	 * several operations in one USB exchange. Optional, as are
+	 * queue_read_mem and queue_flush; without them the target reads
+	 * through read_reg and read_mem.
+	 *
+	 * @param handle A pointer to the device-specific handle
+	 * @param num The core register number, as for read_reg
+	 * @param val Storage for the value, valid after queue_flush returned
+	 * @returns ERROR_OK on success, or an error code on failure.
+	 */
+	int (*queue_read_reg)(void *handle, int num, uint32_t *val);
+	/** Queue a memory read, @a buffer is valid after queue_flush returned. */
+	int (*queue_read_mem)(void *handle, uint32_t addr, uint32_t size,
+			uint32_t count, uint8_t *buffer);
+	/**
+	 * Execute the queued operations. An adapter may execute them earlier
+	 * when its queue is full.
+	 *
+	 * @returns the first error of the queued operations.
+	 */
+	int (*queue_flush)(void *handle);
 	/**
 	 * Read the idcode of the target connected to the adapter
 	 *
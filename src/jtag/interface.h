@@ -375,4 +375,46 @@ int adapter_config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
 		unsigned int traceclkin_freq, uint16_t *prescaler);
 int adapter_poll_trace(uint8_t *buf, size_t *size);
 
+/**
+ * Transfer counters shared by all adapter drivers and reported by
+ * "adapter stats". The JTAG core accounts JTAG scans and queue runs,
+ * the SWD DAP layer accounts SWD queue runs; drivers add their SWD
+ * transactions and the USB traffic they generate.
+ */
+struct adapter_stats {
+	/** JTAG scans and SWD transactions */
+	uint64_t scans;
+	/** bits shifted by those scans and transactions */
+	uint64_t bits;
+	/** number of queue executions */
+	uint64_t flushes;
+	/** USB (or HID) transfers submitted */
+	uint64_t usb_transfers;
+	/** payload bytes moved by those transfers */
+	uint64_t usb_bytes;
+	/** time spent executing queues, in microseconds */
+	uint64_t queue_us;
+};
+
+extern struct adapter_stats adapter_stats;
+
+/** Account one JTAG scan or SWD transaction of @a bits bits. */
+static inline void adapter_stats_scan(unsigned int bits)
+{
+	adapter_stats.scans++;
+	adapter_stats.bits += bits;
+}
+
+/** Account one USB transfer of @a bytes payload bytes. */
+static inline void adapter_stats_usb(size_t bytes)
+{
+	adapter_stats.usb_transfers++;
+	adapter_stats.usb_bytes += bytes;
+}
+
+/** @returns start timestamp for adapter_stats_queue_done(). */
+int64_t adapter_stats_queue_start(void);
+/** Account one queue execution started at @a start. */
+void adapter_stats_queue_done(int64_t start);
+
 #endif /* OPENOCD_JTAG_INTERFACE_H */
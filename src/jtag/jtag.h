@@ -243,6 +243,15 @@ int jtag_get_speed_readable(int *speed);
 /** Attempt to configure the interface for the specified KHz. */
 int jtag_config_khz(unsigned khz);
 
+/**
+ * Enable the search for the fastest reliable adapter speed, starting at the
+ * configured speed and not exceeding @a max_khz.  Zero disables it.
+ */
+void jtag_config_speed_auto(unsigned max_khz);
+
+/** @returns the upper limit of the adapter speed search, 0 if disabled. */
+unsigned jtag_get_speed_auto_max_khz(void);
+
 /**
  * Attempt to enable RTCK/RCLK. If that fails, fallback to the
  * specified frequency.
@@ -295,6 +304,13 @@ void jtag_set_verify_capture_ir(bool enable);
 /** @returns True if IR scan verification will be performed. */
 bool jtag_will_verify_capture_ir(void);
 
+/** Enable or disable the optimisation pass over the command queue. */
+void jtag_set_optimize_queue(bool enable);
+/** @returns True if the command queue is optimised before execution. */
+bool jtag_will_optimize_queue(void);
+/** @returns Number of queued commands the optimisation pass removed. */
+uint64_t jtag_get_optimized_commands(void);
+
 /** Initialize debug adapter upon startup.  */
 int adapter_init(struct command_context *cmd_ctx);
 
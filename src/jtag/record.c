@@ -0,0 +1,617 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Record the traffic handed to the adapter driver and replay it later.
+ *
+ * A capture starts with the magic "OCDREC" and a version byte. Every record
+ * is a type byte followed by the time elapsed since the previous record in
+ * microseconds and a type dependent payload. Numbers are stored as unsigned
+ * LEB128 varints, TAP states as single bytes. JTAG scans are stored with
+ * their fields concatenated, as they appear on the wire.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "jtag.h"
+#include "swd.h"
+#include "commands.h"
+#include "interface.h"
+#include "minidriver.h"
+#include "record.h"
+#include <helper/binarybuffer.h>
+#include <helper/time_support.h>
+#include <transport/transport.h>
+
+extern struct adapter_driver *adapter_driver;
+
+#define RECORD_MAGIC	"OCDREC"
+#define RECORD_VERSION	1
+
+enum record_type {
+	REC_SCAN = 1,		/* flags, end state, bits, out data */
+	REC_TLR_RESET,		/* end state */
+	REC_RUNTEST,		/* cycles, end state */
+	REC_RESET,			/* trst + 1, srst + 1 */
+	REC_PATHMOVE,		/* states, path */
+	REC_SLEEP,			/* us */
+	REC_STABLECLOCKS,	/* cycles */
+	REC_TMS,			/* bits, data */
+	REC_JTAG_FLUSH,		/* duration, failed */
+	REC_SWD_SEQ,		/* sequence */
+	REC_SWD_READ,		/* cmd, ap delay */
+	REC_SWD_WRITE,		/* cmd, data (4 bytes), ap delay */
+	REC_SWD_RUN,		/* duration, failed */
+	REC_MARK,			/* length, text */
+};
+
+#define REC_SCAN_IR		1
+#define REC_SCAN_IN		2
+
+static FILE *record_file;
+static char *record_path;
+static int64_t record_last_us;
+
+static const struct swd_driver *record_swd_target;
+static struct swd_driver record_swd;
+
+bool adapter_record_enabled(void)
+{
+	return record_file != NULL;
+}
+
+static void record_varint(uint64_t v)
+{
+	while (v >= 0x80) {
+		fputc((v & 0x7f) | 0x80, record_file);
+		v >>= 7;
+	}
+	fputc(v, record_file);
+}
+
+static void record_begin(enum record_type type)
+{
+	int64_t now = timeval_us();
+
+	fputc(type, record_file);
+	record_varint(now - record_last_us);
+	record_last_us = now;
+}
+
+static void record_scan(const struct scan_command *scan)
+{
+	unsigned int num_bits = jtag_scan_size(scan);
+	uint8_t flags = scan->ir_scan ? REC_SCAN_IR : 0;
+	uint8_t *out = calloc(DIV_ROUND_UP(num_bits, 8) + 1, 1);
+	unsigned int offset = 0;
+
+	if (!out) {
+		LOG_ERROR("Out of memory, scan not recorded");
+		return;
+	}
+
+	/* fields without out value shift zeros */
+	for (int i = 0; i < scan->num_fields; i++) {
+		const struct scan_field *field = &scan->fields[i];
+
+		if (field->out_value)
+			buf_set_buf(field->out_value, 0, out, offset, field->num_bits);
+		if (field->in_value)
+			flags |= REC_SCAN_IN;
+		offset += field->num_bits;
+	}
+
+	record_begin(REC_SCAN);
+	fputc(flags, record_file);
+	fputc((uint8_t)scan->end_state, record_file);
+	record_varint(num_bits);
+	fwrite(out, 1, DIV_ROUND_UP(num_bits, 8), record_file);
+	free(out);
+}
+
+void adapter_record_jtag_queue(const struct jtag_command *cmd)
+{
+	for (; cmd; cmd = cmd->next) {
+		switch (cmd->type) {
+			case JTAG_SCAN:
+				record_scan(cmd->cmd.scan);
+				break;
+			case JTAG_TLR_RESET:
+				record_begin(REC_TLR_RESET);
+				fputc((uint8_t)cmd->cmd.statemove->end_state, record_file);
+				break;
+			case JTAG_RUNTEST:
+				record_begin(REC_RUNTEST);
+				record_varint(cmd->cmd.runtest->num_cycles);
+				fputc((uint8_t)cmd->cmd.runtest->end_state, record_file);
+				break;
+			case JTAG_RESET:
+				record_begin(REC_RESET);
+				fputc(cmd->cmd.reset->trst + 1, record_file);
+				fputc(cmd->cmd.reset->srst + 1, record_file);
+				break;
+			case JTAG_PATHMOVE:
+				record_begin(REC_PATHMOVE);
+				record_varint(cmd->cmd.pathmove->num_states);
+				for (int i = 0; i < cmd->cmd.pathmove->num_states; i++)
+					fputc((uint8_t)cmd->cmd.pathmove->path[i], record_file);
+				break;
+			case JTAG_SLEEP:
+				record_begin(REC_SLEEP);
+				record_varint(cmd->cmd.sleep->us);
+				break;
+			case JTAG_STABLECLOCKS:
+				record_begin(REC_STABLECLOCKS);
+				record_varint(cmd->cmd.stableclocks->num_cycles);
+				break;
+			case JTAG_TMS:
+				record_begin(REC_TMS);
+				record_varint(cmd->cmd.tms->num_bits);
+				fwrite(cmd->cmd.tms->bits, 1, DIV_ROUND_UP(cmd->cmd.tms->num_bits, 8),
+						record_file);
+				break;
+			default:
+				LOG_WARNING("JTAG command %d not recorded", cmd->type);
+				break;
+		}
+	}
+}
+
+void adapter_record_jtag_flush(int64_t start_us, int result)
+{
+	record_begin(REC_JTAG_FLUSH);
+	record_varint(timeval_us() - start_us);
+	fputc(result != ERROR_OK, record_file);
+}
+
+static int record_swd_switch_seq(enum swd_special_seq seq)
+{
+	if (record_file) {
+		record_begin(REC_SWD_SEQ);
+		fputc(seq, record_file);
+	}
+	return record_swd_target->switch_seq(seq);
+}
+
+static void record_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
+{
+	if (record_file) {
+		record_begin(REC_SWD_READ);
+		fputc(cmd, record_file);
+		record_varint(ap_delay_clk);
+	}
+	record_swd_target->read_reg(cmd, value, ap_delay_clk);
+}
+
+static void record_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
+{
+	if (record_file) {
+		uint8_t data[4];
+
+		h_u32_to_le(data, value);
+		record_begin(REC_SWD_WRITE);
+		fputc(cmd, record_file);
+		fwrite(data, 1, sizeof(data), record_file);
+		record_varint(ap_delay_clk);
+	}
+	record_swd_target->write_reg(cmd, value, ap_delay_clk);
+}
+
+static int record_swd_run(void)
+{
+	int64_t start = timeval_us();
+	int retval = record_swd_target->run();
+
+	if (record_file) {
+		record_begin(REC_SWD_RUN);
+		record_varint(timeval_us() - start);
+		fputc(retval != ERROR_OK, record_file);
+	}
+	return retval;
+}
+
+const struct swd_driver *adapter_record_swd_driver(const struct swd_driver *swd)
+{
+	record_swd_target = swd;
+	record_swd = *swd;
+	record_swd.switch_seq = record_swd_switch_seq;
+	record_swd.read_reg = record_swd_read_reg;
+	record_swd.write_reg = record_swd_write_reg;
+	record_swd.run = record_swd_run;
+
+	return &record_swd;
+}
+
+static void record_stop(void)
+{
+	if (!record_file)
+		return;
+
+	fclose(record_file);
+	record_file = NULL;
+	free(record_path);
+	record_path = NULL;
+}
+
+static int record_start(const char *path)
+{
+	record_stop();
+
+	record_file = fopen(path, "wb");
+	if (!record_file) {
+		LOG_ERROR("Can't create %s: %s", path, strerror(errno));
+		return ERROR_FAIL;
+	}
+	record_path = strdup(path);
+	record_last_us = timeval_us();
+
+	fwrite(RECORD_MAGIC, 1, strlen(RECORD_MAGIC), record_file);
+	fputc(RECORD_VERSION, record_file);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_adapter_record_command)
+{
+	if (CMD_ARGC == 0) {
+		if (record_file)
+			command_print(CMD, "recording to %s", record_path);
+		else
+			command_print(CMD, "not recording");
+		return ERROR_OK;
+	}
+
+	if (strcmp(CMD_ARGV[0], "mark") == 0) {
+		if (CMD_ARGC != 2)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (!record_file) {
+			command_print(CMD, "not recording");
+			return ERROR_FAIL;
+		}
+		record_begin(REC_MARK);
+		record_varint(strlen(CMD_ARGV[1]));
+		fwrite(CMD_ARGV[1], 1, strlen(CMD_ARGV[1]), record_file);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(CMD_ARGV[0], "off") == 0) {
+		record_stop();
+		return ERROR_OK;
+	}
+
+	return record_start(CMD_ARGV[0]);
+}
+
+/* Traffic of the capture between two marks */
+struct replay_segment {
+	char *name;
+	uint64_t flushes;
+	uint64_t scans;
+	uint64_t bits;
+	uint64_t swd_transactions;
+	/* queue time of the recording and of the replay */
+	uint64_t recorded_us;
+	uint64_t replayed_us;
+};
+
+struct replay {
+	FILE *file;
+	bool null_sink;
+	uint8_t *buf;
+	size_t buf_size;
+	struct replay_segment seg;
+};
+
+static bool replay_byte(struct replay *r, uint8_t *value)
+{
+	int c = fgetc(r->file);
+
+	if (c == EOF)
+		return false;
+	*value = c;
+	return true;
+}
+
+static bool replay_varint(struct replay *r, uint64_t *value)
+{
+	uint8_t c;
+
+	*value = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (!replay_byte(r, &c))
+			return false;
+		*value |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static uint8_t *replay_data(struct replay *r, size_t size)
+{
+	if (size > r->buf_size) {
+		uint8_t *buf = realloc(r->buf, size);
+		if (!buf)
+			return NULL;
+		r->buf = buf;
+		r->buf_size = size;
+	}
+
+	if (fread(r->buf, 1, size, r->file) != size)
+		return NULL;
+	return r->buf;
+}
+
+static void replay_print_segment(struct command_invocation *cmd, struct replay_segment *seg)
+{
+	command_print(cmd, "%s: %" PRIu64 " queue runs, %" PRIu64 " scans, %" PRIu64
+			" bits, %" PRIu64 " SWD transactions, queue time %" PRIu64 " us recorded, %"
+			PRIu64 " us replayed", seg->name ? seg->name : "(start)", seg->flushes,
+			seg->scans, seg->bits, seg->swd_transactions, seg->recorded_us,
+			seg->replayed_us);
+}
+
+static int replay_jtag_scan(struct replay *r)
+{
+	uint8_t flags, state;
+	uint64_t num_bits;
+
+	if (!replay_byte(r, &flags) || !replay_byte(r, &state) || !replay_varint(r, &num_bits))
+		return ERROR_FAIL;
+
+	uint8_t *out = replay_data(r, DIV_ROUND_UP(num_bits, 8));
+	if (!out)
+		return ERROR_FAIL;
+
+	r->seg.scans++;
+	r->seg.bits += num_bits;
+	if (r->null_sink)
+		return ERROR_OK;
+
+	uint8_t *in = NULL;
+	if (flags & REC_SCAN_IN)
+		in = cmd_queue_alloc(DIV_ROUND_UP(num_bits, 8));
+
+	if (flags & REC_SCAN_IR)
+		return interface_jtag_add_plain_ir_scan(num_bits, out, in, (int8_t)state);
+	return interface_jtag_add_plain_dr_scan(num_bits, out, in, (int8_t)state);
+}
+
+static int replay_jtag_flush(struct replay *r)
+{
+	uint64_t duration;
+	uint8_t failed;
+
+	if (!replay_varint(r, &duration) || !replay_byte(r, &failed))
+		return ERROR_FAIL;
+
+	r->seg.flushes++;
+	r->seg.recorded_us += duration;
+	if (r->null_sink)
+		return ERROR_OK;
+
+	int64_t start = timeval_us();
+	int retval = jtag_execute_queue();
+	r->seg.replayed_us += timeval_us() - start;
+	if (retval != ERROR_OK && !failed)
+		LOG_WARNING("replayed JTAG queue failed, recorded one succeeded");
+	return ERROR_OK;
+}
+
+static int replay_swd(struct replay *r, enum record_type type)
+{
+	const struct swd_driver *swd = adapter_driver->swd_ops;
+	/* read values are dropped */
+	static uint32_t discard;
+	uint8_t cmd, data[4];
+	uint64_t value;
+
+	switch (type) {
+		case REC_SWD_SEQ:
+			if (!replay_byte(r, &cmd))
+				return ERROR_FAIL;
+			if (!r->null_sink)
+				swd->switch_seq(cmd);
+			return ERROR_OK;
+		case REC_SWD_READ:
+			if (!replay_byte(r, &cmd) || !replay_varint(r, &value))
+				return ERROR_FAIL;
+			r->seg.swd_transactions++;
+			if (!r->null_sink)
+				swd->read_reg(cmd, &discard, value);
+			return ERROR_OK;
+		case REC_SWD_WRITE:
+			if (!replay_byte(r, &cmd) || fread(data, 1, 4, r->file) != 4
+					|| !replay_varint(r, &value))
+				return ERROR_FAIL;
+			r->seg.swd_transactions++;
+			if (!r->null_sink)
+				swd->write_reg(cmd, le_to_h_u32(data), value);
+			return ERROR_OK;
+		default:
+			break;
+	}
+
+	/* REC_SWD_RUN */
+	uint8_t failed;
+	if (!replay_varint(r, &value) || !replay_byte(r, &failed))
+		return ERROR_FAIL;
+	r->seg.flushes++;
+	r->seg.recorded_us += value;
+	if (r->null_sink)
+		return ERROR_OK;
+
+	int64_t start = timeval_us();
+	int retval = swd->run();
+	r->seg.replayed_us += timeval_us() - start;
+	if (retval != ERROR_OK && !failed)
+		LOG_WARNING("replayed SWD queue failed, recorded one succeeded");
+	return ERROR_OK;
+}
+
+static int replay_record(struct replay *r, enum record_type type)
+{
+	uint64_t value;
+	uint8_t a, b;
+
+	switch (type) {
+		case REC_SCAN:
+			return replay_jtag_scan(r);
+		case REC_TLR_RESET:
+			if (!replay_byte(r, &a))
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_jtag_add_tlr();
+		case REC_RUNTEST:
+			if (!replay_varint(r, &value) || !replay_byte(r, &a))
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_jtag_add_runtest(value, (int8_t)a);
+		case REC_RESET:
+			if (!replay_byte(r, &a) || !replay_byte(r, &b))
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_jtag_add_reset(a - 1, b - 1);
+		case REC_PATHMOVE: {
+			if (!replay_varint(r, &value))
+				return ERROR_FAIL;
+			uint8_t *states = replay_data(r, value);
+			if (!states)
+				return ERROR_FAIL;
+			if (r->null_sink)
+				return ERROR_OK;
+			tap_state_t *path = cmd_queue_alloc(value * sizeof(*path));
+			for (uint64_t i = 0; i < value; i++)
+				path[i] = (int8_t)states[i];
+			return interface_jtag_add_pathmove(value, path);
+		}
+		case REC_SLEEP:
+			if (!replay_varint(r, &value))
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_jtag_add_sleep(value);
+		case REC_STABLECLOCKS:
+			if (!replay_varint(r, &value))
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_jtag_add_clocks(value);
+		case REC_TMS: {
+			if (!replay_varint(r, &value))
+				return ERROR_FAIL;
+			uint8_t *bits = replay_data(r, DIV_ROUND_UP(value, 8));
+			if (!bits)
+				return ERROR_FAIL;
+			return r->null_sink ? ERROR_OK : interface_add_tms_seq(value, bits, TAP_INVALID);
+		}
+		case REC_JTAG_FLUSH:
+			return replay_jtag_flush(r);
+		case REC_SWD_SEQ:
+		case REC_SWD_READ:
+		case REC_SWD_WRITE:
+		case REC_SWD_RUN:
+			return replay_swd(r, type);
+		default:
+			LOG_ERROR("unknown record type %d", type);
+			return ERROR_FAIL;
+	}
+}
+
+COMMAND_HANDLER(handle_adapter_replay_command)
+{
+	struct replay r = { 0 };
+	char magic[sizeof(RECORD_MAGIC)];
+	uint8_t version;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 2) {
+		if (strcmp(CMD_ARGV[1], "null") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		r.null_sink = true;
+	}
+
+	if (record_file) {
+		command_print(CMD, "can't replay while recording");
+		return ERROR_FAIL;
+	}
+
+	r.file = fopen(CMD_ARGV[0], "rb");
+	if (!r.file) {
+		command_print(CMD, "can't open %s: %s", CMD_ARGV[0], strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	if (fread(magic, 1, strlen(RECORD_MAGIC), r.file) != strlen(RECORD_MAGIC)
+			|| memcmp(magic, RECORD_MAGIC, strlen(RECORD_MAGIC)) != 0
+			|| !replay_byte(&r, &version) || version != RECORD_VERSION) {
+		command_print(CMD, "%s is not a version %d capture", CMD_ARGV[0], RECORD_VERSION);
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	bool jtag_ok = r.null_sink || transport_is_jtag();
+	bool swd_ok = r.null_sink || (transport_is_swd() && adapter_driver->swd_ops);
+	uint8_t type;
+	uint64_t delta;
+
+	while (replay_byte(&r, &type)) {
+		if (!replay_varint(&r, &delta)) {
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		bool is_swd = type >= REC_SWD_SEQ && type <= REC_SWD_RUN;
+		if (is_swd ? !swd_ok : (type != REC_MARK && !jtag_ok)) {
+			command_print(CMD, "capture doesn't match the current transport");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		if (type == REC_MARK) {
+			uint64_t len;
+			if (!replay_varint(&r, &len) || !replay_data(&r, len)) {
+				retval = ERROR_FAIL;
+				break;
+			}
+			replay_print_segment(CMD, &r.seg);
+			free(r.seg.name);
+			r.seg = (struct replay_segment){ .name = strndup((char *)r.buf, len) };
+			continue;
+		}
+
+		retval = replay_record(&r, type);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	if (retval != ERROR_OK)
+		command_print(CMD, "replay stopped at offset %ld", ftell(r.file));
+	replay_print_segment(CMD, &r.seg);
+	free(r.seg.name);
+
+out:
+	free(r.buf);
+	fclose(r.file);
+	return retval;
+}
+
+const struct command_registration adapter_record_command_handlers[] = {
+	{
+		.name = "record",
+		.handler = handle_adapter_record_command,
+		.mode = COMMAND_ANY,
+		.help = "Record the JTAG commands and SWD transactions passed to the "
+			"adapter driver to a file, stop recording, or add a named mark "
+			"to the capture.",
+		.usage = "[filename | 'off' | 'mark' text]",
+	},
+	{
+		.name = "replay",
+		.handler = handle_adapter_replay_command,
+		.mode = COMMAND_EXEC,
+		.help = "Replay a capture through the adapter, or only parse it with "
+			"'null', and report the traffic between marks.",
+		.usage = "filename ['null']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
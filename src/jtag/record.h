@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * Capture of the JTAG command queue and of the SWD transactions passed to
+ * the adapter driver, and replay of such a capture, see "adapter record"
+ * and "adapter replay".
+ */
+
+#ifndef OPENOCD_JTAG_RECORD_H
+#define OPENOCD_JTAG_RECORD_H
+
+#include <helper/command.h>
+
+struct jtag_command;
+struct swd_driver;
+
+extern const struct command_registration adapter_record_command_handlers[];
+
+/** @returns true while "adapter record" writes to a file. */
+bool adapter_record_enabled(void);
+
+/** Append every command of the JTAG queue about to be executed. */
+void adapter_record_jtag_queue(const struct jtag_command *cmd);
+
+/** Append the end of a JTAG queue run started at @a start_us. */
+void adapter_record_jtag_flush(int64_t start_us, int result);
+
+/**
+ * @returns an SWD driver which forwards everything to @a swd and records
+ * the transactions while recording is enabled.
+ */
+const struct swd_driver *adapter_record_swd_driver(const struct swd_driver *swd);
+
+#endif /* OPENOCD_JTAG_RECORD_H */
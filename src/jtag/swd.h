@@ -253,6 +253,21 @@ struct swd_driver {
 	 */
 	void (*write_reg)(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint);
 
+	/**
+	 * Optional. Queued read of an AP or DP register, repeated by the
+	 * adapter until (value & mask) == match. If the adapter gives up,
+	 * run() returns ERROR_TIMEOUT_REACHED. A read AP register is not
+	 * posted, no result is left in RDBUFF for the next read.
+	 *
+	 * @param Command byte with APnDP/RnW/addr/parity bits
+	 * @param mask Bits of the register to compare
+	 * @param match Value expected in the bits of @a mask
+	 * @param ap_delay_hint Number of idle cycles that may be
+	 * needed after an AP access to avoid WAITs
+	 */
+	void (*read_reg_match)(uint8_t cmd, uint32_t mask, uint32_t match,
+			uint32_t ap_delay_hint);
+
 	/**
 	 * Execute any queued transactions and collect the result.
 	 *
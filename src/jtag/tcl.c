@@ -856,6 +856,39 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats_command)
+{
+	struct cmd_queue_stats stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	cmd_queue_get_stats(&stats);
+	command_print(CMD, "command queue: %zu bytes in use, high-water %zu bytes, "
+			"%zu bytes retained, %" PRIu64 " resets",
+			stats.used, stats.high_water, stats.retained, stats.resets);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_optimize_queue_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_optimize_queue(enable);
+	}
+
+	command_print(CMD, "command queue optimisation is %s, %" PRIu64 " commands removed",
+			jtag_will_optimize_queue() ? "enabled" : "disabled",
+			jtag_get_optimized_commands());
+
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -938,6 +971,21 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.jim_handler = jim_jtag_names,
 		.help = "Returns list of all JTAG tap names.",
 	},
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_queue_stats_command,
+		.help = "display memory use of the JTAG command queue",
+		.usage = "",
+	},
+	{
+		.name = "optimize_queue",
+		.mode = COMMAND_ANY,
+		.handler = handle_jtag_optimize_queue_command,
+		.help = "Display or assign flag controlling whether redundant "
+			"commands are removed from the queue before execution.",
+		.usage = "['enable'|'disable']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
@@ -33,6 +33,7 @@
 #include <helper/ioutil.h>
 #include <helper/util.h>
 #include <helper/configuration.h>
+#include <helper/perf.h>
 #include <flash/nor/core.h>
 #include <flash/nand/core.h>
 #include <pld/pld.h>
@@ -247,6 +248,7 @@ struct command_context *setup_command_handler(Jim_Interp *interp)
 		&server_register_commands,
 		&gdb_register_commands,
 		&log_register_commands,
+		&perf_register_commands,
 		&transport_register_commands,
 		&interface_register_commands,
 		&target_register_commands,
@@ -22,7 +22,9 @@
 
 #include "pld.h"
 #include <helper/log.h>
+#include <helper/fileio.h>
 #include <helper/time_support.h>
+#include <jtag/jtag.h>
 
 
 /* pld drivers
@@ -126,6 +128,65 @@ COMMAND_HANDLER(handle_pld_devices_command)
 	return ERROR_OK;
 }
 
+int pld_stream_file(struct fileio *fileio, size_t length, size_t chunk_size,
+		pld_stream_shift_t shift, void *priv)
+{
+	uint8_t *buffer[2];
+	size_t offset = 0;
+	bool queued = false;
+	int cur = 0;
+	int retval = ERROR_OK;
+
+	if (chunk_size > length)
+		chunk_size = length;
+	if (chunk_size == 0)
+		return ERROR_OK;
+
+	buffer[0] = malloc(chunk_size);
+	buffer[1] = malloc(chunk_size);
+	if (!buffer[0] || !buffer[1]) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	while (offset < length) {
+		size_t size = MIN(chunk_size, length - offset);
+		size_t size_read;
+
+		retval = fileio_read(fileio, size, buffer[cur], &size_read);
+		if (retval == ERROR_OK && size_read != size) {
+			LOG_ERROR("configuration data ends at %zu bytes, %zu expected",
+				offset + size_read, length);
+			retval = ERROR_PLD_FILE_LOAD_FAILED;
+		}
+		if (retval != ERROR_OK)
+			break;
+		offset += size;
+
+		/* shift the previous chunk, its buffer gets free */
+		if (queued) {
+			retval = jtag_execute_queue();
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		retval = shift(priv, buffer[cur], size, offset == length);
+		if (retval != ERROR_OK)
+			break;
+		queued = true;
+		cur ^= 1;
+	}
+
+	if (retval == ERROR_OK && queued)
+		retval = jtag_execute_queue();
+
+out:
+	free(buffer[0]);
+	free(buffer[1]);
+	return retval;
+}
+
 COMMAND_HANDLER(handle_pld_load_command)
 {
 	int retval;
@@ -46,6 +46,28 @@ int pld_register_commands(struct command_context *cmd_ctx);
 
 struct pld_device *get_pld_device_by_num(int num);
 
+struct fileio;
+
+/** Default size of the chunks passed by pld_stream_file(). */
+#define PLD_STREAM_CHUNK_SIZE	(256 * 1024)
+
+/**
+ * Queue the shift of a chunk of configuration data, @a last is set for
+ * the final chunk. The data may be modified and stays valid until the
+ * JTAG queue has run once more.
+ */
+typedef int (*pld_stream_shift_t)(void *priv, uint8_t *data, size_t size,
+		bool last);
+
+/**
+ * Pass @a length bytes from the current position of @a fileio to
+ * @a shift, in chunks of at most @a chunk_size bytes. The next chunk is
+ * read before the JTAG queue holding the previous one runs, so at most
+ * two chunks are held in memory.
+ */
+int pld_stream_file(struct fileio *fileio, size_t length, size_t chunk_size,
+		pld_stream_shift_t shift, void *priv);
+
 #define ERROR_PLD_DEVICE_INVALID        (-1000)
 #define ERROR_PLD_FILE_LOAD_FAILED      (-1001)
 
@@ -24,6 +24,8 @@
 #include "xilinx_bit.h"
 #include "pld.h"
 
+#include <helper/fileio.h>
+
 static int virtex2_set_instr(struct jtag_tap *tap, uint32_t new_instr)
 {
 	if (tap == NULL)
@@ -125,17 +127,33 @@ static int virtex2_read_stat(struct pld_device *pld_device, uint32_t *status)
 	return ERROR_OK;
 }
 
+/* the scans of consecutive chunks only pass through Exit2-DR, so the
+ * configuration logic sees one continuous shift */
+static int virtex2_shift_chunk(void *priv, uint8_t *data, size_t size, bool last)
+{
+	struct virtex2_pld_device *virtex2_info = priv;
+	struct scan_field field;
+
+	for (size_t i = 0; i < size; i++)
+		data[i] = flip_u32(data[i], 8);
+
+	field.num_bits = size * 8;
+	field.out_value = data;
+	field.in_value = NULL;
+
+	jtag_add_dr_scan(virtex2_info->tap, 1, &field, TAP_DRPAUSE);
+
+	return ERROR_OK;
+}
+
 static int virtex2_load(struct pld_device *pld_device, const char *filename)
 {
 	struct virtex2_pld_device *virtex2_info = pld_device->driver_priv;
 	struct xilinx_bit_file bit_file;
+	struct fileio *fileio;
 	int retval;
-	unsigned int i;
-	struct scan_field field;
 
-	field.in_value = NULL;
-
-	retval = xilinx_read_bit_file(&bit_file, filename);
+	retval = xilinx_open_bit_file(&bit_file, filename, &fileio);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -146,14 +164,12 @@ static int virtex2_load(struct pld_device *pld_device, const char *filename)
 	virtex2_set_instr(virtex2_info->tap, 0x5);	/* CFG_IN */
 	jtag_execute_queue();
 
-	for (i = 0; i < bit_file.length; i++)
-		bit_file.data[i] = flip_u32(bit_file.data[i], 8);
-
-	field.num_bits = bit_file.length * 8;
-	field.out_value = bit_file.data;
-
-	jtag_add_dr_scan(virtex2_info->tap, 1, &field, TAP_DRPAUSE);
-	jtag_execute_queue();
+	retval = pld_stream_file(fileio, bit_file.length, PLD_STREAM_CHUNK_SIZE,
+			virtex2_shift_chunk, virtex2_info);
+	fileio_close(fileio);
+	xilinx_free_bit_file(&bit_file);
+	if (retval != ERROR_OK)
+		return retval;
 
 	jtag_add_tlr();
 
@@ -23,32 +23,33 @@
 #include "xilinx_bit.h"
 #include "pld.h"
 #include <helper/log.h>
+#include <helper/fileio.h>
 
 #include <sys/stat.h>
 
 
-static int read_section(FILE *input_file, int length_size, char section,
+static int read_section(struct fileio *fileio, int length_size, char section,
 	uint32_t *buffer_length, uint8_t **buffer)
 {
 	uint8_t length_buffer[4];
-	int length;
+	uint32_t length;
 	char section_char;
-	int read_count;
+	size_t read_count;
 
 	if ((length_size != 2) && (length_size != 4)) {
 		LOG_ERROR("BUG: length_size neither 2 nor 4");
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	read_count = fread(&section_char, 1, 1, input_file);
-	if (read_count != 1)
+	if (fileio_read(fileio, 1, &section_char, &read_count) != ERROR_OK
+			|| read_count != 1)
 		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	if (section_char != section)
 		return ERROR_PLD_FILE_LOAD_FAILED;
 
-	read_count = fread(length_buffer, 1, length_size, input_file);
-	if (read_count != length_size)
+	if (fileio_read(fileio, length_size, length_buffer, &read_count) != ERROR_OK
+			|| read_count != (size_t)length_size)
 		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	if (length_size == 4)
@@ -59,24 +60,33 @@ static int read_section(FILE *input_file, int length_size, char section,
 	if (buffer_length)
 		*buffer_length = length;
 
-	*buffer = malloc(length);
+	/* leave the data in the file when the caller streams it */
+	if (!buffer)
+		return ERROR_OK;
 
-	read_count = fread(*buffer, 1, length, input_file);
-	if (read_count != length)
+	*buffer = malloc(length + 1);
+	if (!*buffer)
+		return ERROR_PLD_FILE_LOAD_FAILED;
+	(*buffer)[length] = 0;
+
+	if (fileio_read(fileio, length, *buffer, &read_count) != ERROR_OK
+			|| read_count != length)
 		return ERROR_PLD_FILE_LOAD_FAILED;
 
 	return ERROR_OK;
 }
 
-int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+int xilinx_open_bit_file(struct xilinx_bit_file *bit_file, const char *filename,
+	struct fileio **fileio)
 {
-	FILE *input_file;
 	struct stat input_stat;
-	int read_count;
+	size_t read_count;
 
 	if (!filename || !bit_file)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
+	memset(bit_file, 0, sizeof(*bit_file));
+
 	if (stat(filename, &input_stat) == -1) {
 		LOG_ERROR("couldn't stat() %s: %s", filename, strerror(errno));
 		return ERROR_PLD_FILE_LOAD_FAILED;
@@ -92,37 +102,73 @@ int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	input_file = fopen(filename, "rb");
-	if (input_file == NULL) {
-		LOG_ERROR("couldn't open %s: %s", filename, strerror(errno));
+	if (fileio_open(fileio, filename, FILEIO_READ, FILEIO_BINARY) != ERROR_OK) {
+		LOG_ERROR("couldn't open %s", filename);
 		return ERROR_PLD_FILE_LOAD_FAILED;
 	}
 
-	read_count = fread(bit_file->unknown_header, 1, 13, input_file);
-	if (read_count != 13) {
+	if (fileio_read(*fileio, 13, bit_file->unknown_header, &read_count) != ERROR_OK
+			|| read_count != 13) {
 		LOG_ERROR("couldn't read unknown_header from file '%s'", filename);
-		return ERROR_PLD_FILE_LOAD_FAILED;
+		goto fail;
 	}
 
-	if (read_section(input_file, 2, 'a', NULL, &bit_file->source_file) != ERROR_OK)
-		return ERROR_PLD_FILE_LOAD_FAILED;
+	if (read_section(*fileio, 2, 'a', NULL, &bit_file->source_file) != ERROR_OK)
+		goto fail;
 
-	if (read_section(input_file, 2, 'b', NULL, &bit_file->part_name) != ERROR_OK)
-		return ERROR_PLD_FILE_LOAD_FAILED;
+	if (read_section(*fileio, 2, 'b', NULL, &bit_file->part_name) != ERROR_OK)
+		goto fail;
 
-	if (read_section(input_file, 2, 'c', NULL, &bit_file->date) != ERROR_OK)
-		return ERROR_PLD_FILE_LOAD_FAILED;
+	if (read_section(*fileio, 2, 'c', NULL, &bit_file->date) != ERROR_OK)
+		goto fail;
 
-	if (read_section(input_file, 2, 'd', NULL, &bit_file->time) != ERROR_OK)
-		return ERROR_PLD_FILE_LOAD_FAILED;
+	if (read_section(*fileio, 2, 'd', NULL, &bit_file->time) != ERROR_OK)
+		goto fail;
 
-	if (read_section(input_file, 4, 'e', &bit_file->length, &bit_file->data) != ERROR_OK)
-		return ERROR_PLD_FILE_LOAD_FAILED;
+	if (read_section(*fileio, 4, 'e', &bit_file->length, NULL) != ERROR_OK)
+		goto fail;
 
 	LOG_DEBUG("bit_file: %s %s %s,%s %" PRIu32 "", bit_file->source_file, bit_file->part_name,
 		bit_file->date, bit_file->time, bit_file->length);
 
-	fclose(input_file);
-
 	return ERROR_OK;
+
+fail:
+	fileio_close(*fileio);
+	*fileio = NULL;
+	xilinx_free_bit_file(bit_file);
+	return ERROR_PLD_FILE_LOAD_FAILED;
+}
+
+int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename)
+{
+	struct fileio *fileio;
+	size_t read_count;
+
+	int retval = xilinx_open_bit_file(bit_file, filename, &fileio);
+	if (retval != ERROR_OK)
+		return retval;
+
+	bit_file->data = malloc(bit_file->length);
+	if (!bit_file->data
+			|| fileio_read(fileio, bit_file->length, bit_file->data, &read_count) != ERROR_OK
+			|| read_count != bit_file->length) {
+		LOG_ERROR("couldn't read the bitstream from file '%s'", filename);
+		xilinx_free_bit_file(bit_file);
+		retval = ERROR_PLD_FILE_LOAD_FAILED;
+	}
+
+	fileio_close(fileio);
+
+	return retval;
+}
+
+void xilinx_free_bit_file(struct xilinx_bit_file *bit_file)
+{
+	free(bit_file->source_file);
+	free(bit_file->part_name);
+	free(bit_file->date);
+	free(bit_file->time);
+	free(bit_file->data);
+	memset(bit_file, 0, sizeof(*bit_file));
 }
@@ -29,6 +29,18 @@ struct xilinx_bit_file {
 	uint8_t *data;
 };
 
+struct fileio;
+
 int xilinx_read_bit_file(struct xilinx_bit_file *bit_file, const char *filename);
 
+/**
+ * Read the header of a bit file and leave @a fileio at the start of the
+ * bitstream, of bit_file->length bytes, for the caller to stream.
+ * bit_file->data stays NULL.
+ */
+int xilinx_open_bit_file(struct xilinx_bit_file *bit_file, const char *filename,
+	struct fileio **fileio);
+
+void xilinx_free_bit_file(struct xilinx_bit_file *bit_file);
+
 #endif /* OPENOCD_PLD_XILINX_BIT_H */
@@ -110,6 +110,8 @@ static int FreeRTOS_update_threads(struct rtos *rtos);
 static int FreeRTOS_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		struct rtos_reg **reg_list, int *num_regs);
 static int FreeRTOS_get_symbol_list_to_lookup(symbol_table_elem_t *symbol_list[]);
+static int FreeRTOS_get_thread_stack(struct rtos *rtos, threadid_t thread_id,
+		target_addr_t *bottom, target_addr_t *top);
 
 struct rtos_type FreeRTOS_rtos = {
 	.name = "FreeRTOS",
@@ -119,6 +121,7 @@ struct rtos_type FreeRTOS_rtos = {
 	.update_threads = FreeRTOS_update_threads,
 	.get_thread_reg_list = FreeRTOS_get_thread_reg_list,
 	.get_symbol_list_to_lookup = FreeRTOS_get_symbol_list_to_lookup,
+	.get_thread_stack = FreeRTOS_get_thread_stack,
 };
 
 enum FreeRTOS_symbol_values {
@@ -133,6 +136,8 @@ enum FreeRTOS_symbol_values {
 	FreeRTOS_VAL_xSuspendedTaskList = 8,
 	FreeRTOS_VAL_uxCurrentNumberOfTasks = 9,
 	FreeRTOS_VAL_uxTopUsedPriority = 10,
+	FreeRTOS_VAL_uxTaskNumber = 11,
+	FreeRTOS_VAL_openocd_thread_table = 12,
 };
 
 struct symbols {
@@ -152,9 +157,38 @@ static const struct symbols FreeRTOS_symbol_list[] = {
 	{ "xSuspendedTaskList", true }, /* Only if INCLUDE_vTaskSuspend */
 	{ "uxCurrentNumberOfTasks", false },
 	{ "uxTopUsedPriority", true }, /* Unavailable since v7.5.3 */
+	{ "uxTaskNumber", true }, /* Only if configUSE_TRACE_FACILITY */
+	{ "openocd_thread_table", true }, /* Only with contrib/rtos-helpers */
 	{ NULL, false }
 };
 
+/* eTaskState, the states of the thread table */
+static const char * const FreeRTOS_thread_states[] = {
+	"Running", "Ready", "Blocked", "Suspended", "Deleted",
+};
+
+/* Move the running mark of an otherwise unchanged thread list */
+static void FreeRTOS_update_current_thread(struct rtos *rtos, threadid_t current_thread)
+{
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+
+		free(detail->extra_info_str);
+		if (detail->threadid == current_thread)
+			detail->extra_info_str = strdup("State: Running");
+		else
+			detail->extra_info_str = NULL;
+	}
+	rtos->current_thread = current_thread;
+}
+
+/* one thread list being walked by FreeRTOS_update_threads() */
+struct FreeRTOS_list_walk {
+	uint32_t remaining;	/* items the list header claims are left */
+	uint32_t next;		/* list item to read next */
+	uint32_t prev;
+};
+
 /* TODO: */
 /* this is not safe for little endian yet */
 /* may be problems reading if sizes are not 32 bit long integers. */
@@ -181,31 +215,59 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
-	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FreeRTOS_VAL_uxCurrentNumberOfTasks].address,
-			&thread_list_size);
+	/* a table kept by the target saves walking the lists */
+	if (rtos->symbols[FreeRTOS_VAL_openocd_thread_table].address != 0) {
+		if (rtos_read_thread_table(rtos, rtos->symbols[FreeRTOS_VAL_openocd_thread_table].address,
+					FreeRTOS_thread_states, ARRAY_SIZE(FreeRTOS_thread_states)) == ERROR_OK)
+			return ERROR_OK;
+		/* the hint is the table generation, not uxTaskNumber */
+		rtos->change_hint_valid = false;
+	}
+
+	/* read the thread count, the current thread and the task number together */
+	uint8_t counters[3][4];
+	struct target_read_request reads_counters[] = {
+		{ rtos->symbols[FreeRTOS_VAL_uxCurrentNumberOfTasks].address, 4, counters[0], ERROR_OK },
+		{ rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address, 4, counters[1], ERROR_OK },
+		{ rtos->symbols[FreeRTOS_VAL_uxTaskNumber].address,
+			rtos->symbols[FreeRTOS_VAL_uxTaskNumber].address ? 4 : 0, counters[2], ERROR_OK },
+	};
+	target_read_buffer_batch(rtos->target, reads_counters, ARRAY_SIZE(reads_counters));
+
+	retval = reads_counters[0].retval;
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Could not read FreeRTOS thread count from target");
+		return retval;
+	}
+	uint32_t thread_list_size = target_buffer_get_u32(rtos->target, counters[0]);
 	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
 										rtos->symbols[FreeRTOS_VAL_uxCurrentNumberOfTasks].address,
 										thread_list_size);
 
+	retval = reads_counters[1].retval;
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read FreeRTOS thread count from target");
+		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
 		return retval;
 	}
+	uint32_t pointer_casts_are_bad = target_buffer_get_u32(rtos->target, counters[1]);
+
+	/* uxTaskNumber changes whenever a task is created or deleted; while it
+	 * doesn't, the threads are the same and only the running one moves */
+	bool have_task_number = reads_counters[2].size != 0 && reads_counters[2].retval == ERROR_OK;
+	uint32_t task_number = have_task_number ? target_buffer_get_u32(rtos->target, counters[2]) : 0;
+	if (have_task_number && rtos->change_hint_valid && rtos->change_hint == task_number &&
+			rtos->thread_details && rtos->thread_count == (int)thread_list_size &&
+			rtos->current_thread != 0 && pointer_casts_are_bad != 0) {
+		LOG_DEBUG("FreeRTOS: uxTaskNumber unchanged (%" PRIu32 "), keeping the thread list",
+				task_number);
+		FreeRTOS_update_current_thread(rtos, pointer_casts_are_bad);
+		return ERROR_OK;
+	}
+	rtos->change_hint_valid = false;
 
 	/* wipe out previous thread details if any */
 	rtos_free_threadlist(rtos);
 
-	/* read the current thread */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
-	}
 	rtos->current_thread = pointer_casts_are_bad;
 	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
 										rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
@@ -289,117 +351,171 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xSuspendedTaskList].address;
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xTasksWaitingTermination].address;
 
+	/*
+	 * All the lists are walked side by side, so that each step reads the
+	 * next item of every list in one batch; the thread names are read in
+	 * one more batch at the end.
+	 */
+	#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+	unsigned int header_size = param->list_next_offset + param->pointer_width;
+	unsigned int item_size = MAX(param->list_elem_next_offset,
+			param->list_elem_content_offset) + param->pointer_width;
+	unsigned int max_tcbs = thread_list_size - tasks_found;
+	unsigned int num_tcbs = 0;
+	struct FreeRTOS_list_walk *walks = calloc(num_lists, sizeof(*walks));
+	struct target_read_request *reads = calloc(MAX(num_lists, max_tcbs), sizeof(*reads));
+	unsigned int *read_list = calloc(num_lists, sizeof(*read_list));
+	uint8_t *data = malloc(MAX(num_lists * MAX(header_size, item_size),
+				max_tcbs * FREERTOS_THREAD_NAME_STR_SIZE));
+	uint32_t *tcbs = calloc(max_tcbs, sizeof(*tcbs));
+	unsigned int *tcb_list = calloc(max_tcbs, sizeof(*tcb_list));
+	if (!walks || !reads || !read_list || !data || !tcbs || !tcb_list) {
+		LOG_ERROR("Error allocating memory for %u thread lists", num_lists);
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	/* Read the number of threads and the first item of each list */
+	for (unsigned int i = 0; i < num_lists; i++) {
+		reads[i].address = list_of_lists[i];
+		reads[i].size = list_of_lists[i] ? header_size : 0;
+		reads[i].buffer = data + i * header_size;
+	}
+	retval = target_read_buffer_batch(rtos->target, reads, num_lists);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS thread lists");
+		goto done;
+	}
 	for (unsigned int i = 0; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
+		walks[i].remaining = target_buffer_get_u32(rtos->target, reads[i].buffer);
+		walks[i].next = target_buffer_get_u32(rtos->target,
+				reads[i].buffer + param->list_next_offset);
+		walks[i].prev = -1;
+		LOG_DEBUG("FreeRTOS: Read list %u at 0x%" PRIx64 ", %" PRIu32 " threads, first item 0x%" PRIx32,
+				i, list_of_lists[i], walks[i].remaining, walks[i].next);
+	}
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
-		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
-										i, list_of_lists[i], list_thread_count);
+	/* Get the location of the thread structures, one item per list at a time */
+	while (num_tcbs < max_tcbs) {
+		unsigned int num_reads = 0;
 
-		if (list_thread_count == 0)
-			continue;
+		for (unsigned int i = 0; i < num_lists; i++) {
+			struct FreeRTOS_list_walk *walk = &walks[i];
 
-		/* Read the location of first list item */
-		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
+			if (walk->remaining == 0 || walk->next == 0 || walk->next == walk->prev)
+				continue;
+			reads[num_reads].address = walk->next;
+			reads[num_reads].size = item_size;
+			reads[num_reads].buffer = data + num_reads * item_size;
+			read_list[num_reads++] = i;
+		}
+		if (num_reads == 0)
+			break;
+
+		retval = target_read_buffer_batch(rtos->target, reads, num_reads);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
+			LOG_ERROR("Error reading thread list items in FreeRTOS thread list");
+			goto done;
 		}
-		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
-										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
-
-		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
-				(list_elem_ptr != prev_list_elem_ptr) &&
-				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			rtos->thread_details[tasks_found].threadid = 0;
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
-			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
-										list_elem_ptr + param->list_elem_content_offset,
-										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
+		for (unsigned int r = 0; r < num_reads && num_tcbs < max_tcbs; r++) {
+			struct FreeRTOS_list_walk *walk = &walks[read_list[r]];
 
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+			tcbs[num_tcbs] = target_buffer_get_u32(rtos->target,
+					reads[r].buffer + param->list_elem_content_offset);
+			tcb_list[num_tcbs++] = read_list[r];
+			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx32,
+					walk->next + param->list_elem_content_offset, tcbs[num_tcbs - 1]);
 
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
-			rtos->thread_details[tasks_found].exists = true;
-
-			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
-				char running_str[] = "State: Running";
-				rtos->thread_details[tasks_found].extra_info_str = malloc(
-						sizeof(running_str));
-				strcpy(rtos->thread_details[tasks_found].extra_info_str,
-					running_str);
-			} else
-				rtos->thread_details[tasks_found].extra_info_str = NULL;
-
-			tasks_found++;
-			list_thread_count--;
-
-			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
-										prev_list_elem_ptr + param->list_elem_next_offset,
-										list_elem_ptr);
+			walk->remaining--;
+			walk->prev = walk->next;
+			walk->next = target_buffer_get_u32(rtos->target,
+					reads[r].buffer + param->list_elem_next_offset);
 		}
 	}
 
+	/* Read the thread names, keeping the threads in list order */
+	unsigned int num_reads = 0;
+	for (unsigned int i = 0; i < num_lists; i++) {
+		for (unsigned int t = 0; t < num_tcbs; t++) {
+			if (tcb_list[t] != i)
+				continue;
+			reads[num_reads].address = tcbs[t] + param->thread_name_offset;
+			reads[num_reads].size = FREERTOS_THREAD_NAME_STR_SIZE;
+			reads[num_reads].buffer = data + num_reads * FREERTOS_THREAD_NAME_STR_SIZE;
+			num_reads++;
+		}
+	}
+	retval = target_read_buffer_batch(rtos->target, reads, num_reads);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread names in FreeRTOS thread list");
+		goto done;
+	}
+
+	for (unsigned int r = 0; r < num_reads; r++) {
+		struct thread_detail *detail = &rtos->thread_details[tasks_found];
+		char *tmp_str = (char *)reads[r].buffer;
+
+		detail->threadid = reads[r].address - param->thread_name_offset;
+
+		tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
+		LOG_DEBUG("FreeRTOS: Read Thread Name at " TARGET_ADDR_FMT ", value '%s'",
+				reads[r].address, tmp_str);
+
+		detail->thread_name_str = strdup(tmp_str[0] ? tmp_str : "No Name");
+		detail->exists = true;
+
+		if (detail->threadid == rtos->current_thread)
+			detail->extra_info_str = strdup("State: Running");
+		else
+			detail->extra_info_str = NULL;
+
+		tasks_found++;
+	}
+	retval = ERROR_OK;
+
+	rtos->change_hint = task_number;
+	rtos->change_hint_valid = have_task_number;
+
+done:
+	free(tcb_list);
+	free(tcbs);
+	free(data);
+	free(read_list);
+	free(reads);
+	free(walks);
 	free(list_of_lists);
 	rtos->thread_count = tasks_found;
-	return 0;
+	return retval;
+}
+
+/* pxTopOfStack and pxStack, which directly precedes pcTaskName */
+static int FreeRTOS_get_thread_stack(struct rtos *rtos, threadid_t thread_id,
+		target_addr_t *bottom, target_addr_t *top)
+{
+	const struct FreeRTOS_params *param = rtos->rtos_specific_params;
+
+	if (!param || thread_id == 0)
+		return ERROR_FAIL;
+
+	if (param->stacking_info_cm3->stack_growth_direction != -1)
+		return ERROR_FAIL;
+
+	uint8_t stack[2][4];
+	struct target_read_request reads[] = {
+		{ thread_id + param->thread_stack_offset, param->pointer_width, stack[0], ERROR_OK },
+		{ thread_id + param->thread_name_offset - param->pointer_width,
+			param->pointer_width, stack[1], ERROR_OK },
+	};
+	int retval = target_read_buffer_batch(rtos->target, reads, ARRAY_SIZE(reads));
+	if (retval != ERROR_OK)
+		return retval;
+
+	*top = target_buffer_get_u32(rtos->target, stack[0]);
+	*bottom = target_buffer_get_u32(rtos->target, stack[1]);
+	return ERROR_OK;
 }
 
 static int FreeRTOS_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
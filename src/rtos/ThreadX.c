@@ -323,7 +323,7 @@ static int ThreadX_update_threads(struct rtos *rtos)
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
 
-		if (thread_list_size == 0) {
+		if (thread_list_size == 1) {
 			rtos->thread_count = 1;
 			return ERROR_OK;
 		}
@@ -344,60 +344,67 @@ static int ThreadX_update_threads(struct rtos *rtos)
 		return retval;
 	}
 
+	/*
+	 * Read each TCB in one access while following the list, then all the
+	 * thread names in one batch.
+	 */
+	#define THREADX_THREAD_NAME_STR_SIZE (200)
+	unsigned int tcb_size = MAX(MAX(param->thread_name_offset, param->thread_next_offset)
+			+ param->pointer_width, param->thread_state_offset + 4);
+	unsigned int max_threads = thread_list_size - tasks_found;
+	uint8_t *tcb = malloc(tcb_size);
+	uint32_t *states = calloc(max_threads, sizeof(*states));
+	struct target_read_request *names = calloc(max_threads, sizeof(*names));
+	uint8_t *name_data = malloc(max_threads * THREADX_THREAD_NAME_STR_SIZE);
+	unsigned int num_threads = 0;
+	if (!tcb || !states || !names || !name_data) {
+		LOG_ERROR("Error allocating memory for %u ThreadX threads", max_threads);
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
 	/* loop over all threads */
 	int64_t prev_thread_ptr = 0;
-	while ((thread_ptr != prev_thread_ptr) && (tasks_found < thread_list_size)) {
-
-		#define THREADX_THREAD_NAME_STR_SIZE (200)
-		char tmp_str[THREADX_THREAD_NAME_STR_SIZE];
-		unsigned int i = 0;
-		int64_t name_ptr = 0;
+	while ((thread_ptr != prev_thread_ptr) && (num_threads < max_threads)) {
+		retval = target_read_buffer(rtos->target, thread_ptr, tcb_size, tcb);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Could not read ThreadX thread control block from target");
+			goto done;
+		}
 
 		/* Save the thread pointer */
-		rtos->thread_details[tasks_found].threadid = thread_ptr;
+		rtos->thread_details[tasks_found + num_threads].threadid = thread_ptr;
 
-		/* read the name pointer */
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_name_offset,
-				param->pointer_width,
-				(uint8_t *)&name_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Could not read ThreadX thread name pointer from target");
-			return retval;
-		}
+		names[num_threads].address = target_buffer_get_u32(rtos->target,
+				tcb + param->thread_name_offset);
+		names[num_threads].size = THREADX_THREAD_NAME_STR_SIZE;
+		names[num_threads].buffer = name_data + num_threads * THREADX_THREAD_NAME_STR_SIZE;
+		states[num_threads] = target_buffer_get_u32(rtos->target,
+				tcb + param->thread_state_offset);
+		num_threads++;
 
-		/* Read the thread name */
-		retval =
-			target_read_buffer(rtos->target,
-				name_ptr,
-				THREADX_THREAD_NAME_STR_SIZE,
-				(uint8_t *)&tmp_str);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading thread name from ThreadX target");
-			return retval;
-		}
-		tmp_str[THREADX_THREAD_NAME_STR_SIZE-1] = '\x00';
+		/* Get the location of the next thread structure. */
+		prev_thread_ptr = thread_ptr;
+		thread_ptr = target_buffer_get_u32(rtos->target, tcb + param->thread_next_offset);
+	}
 
-		if (tmp_str[0] == '\x00')
-			strcpy(tmp_str, "No Name");
+	/* Read the thread names */
+	retval = target_read_buffer_batch(rtos->target, names, num_threads);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread name from ThreadX target");
+		goto done;
+	}
 
-		rtos->thread_details[tasks_found].thread_name_str =
-			malloc(strlen(tmp_str)+1);
-		strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+	for (unsigned int t = 0; t < num_threads; t++) {
+		struct thread_detail *detail = &rtos->thread_details[tasks_found];
+		char *tmp_str = (char *)names[t].buffer;
+		unsigned int i;
 
-		/* Read the thread status */
-		int64_t thread_status = 0;
-		retval = target_read_buffer(rtos->target,
-				thread_ptr + param->thread_state_offset,
-				4,
-				(uint8_t *)&thread_status);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading thread state from ThreadX target");
-			return retval;
-		}
+		tmp_str[THREADX_THREAD_NAME_STR_SIZE-1] = '\x00';
+		detail->thread_name_str = strdup(tmp_str[0] ? tmp_str : "No Name");
 
 		for (i = 0; (i < THREADX_NUM_STATES) &&
-				(ThreadX_thread_states[i].value != thread_status); i++) {
+				(ThreadX_thread_states[i].value != states[t]); i++) {
 			/* empty */
 		}
 
@@ -407,30 +414,23 @@ static int ThreadX_update_threads(struct rtos *rtos)
 		else
 			state_desc = "Unknown state";
 
-		rtos->thread_details[tasks_found].extra_info_str = malloc(strlen(
-					state_desc)+8);
-		sprintf(rtos->thread_details[tasks_found].extra_info_str, "State: %s", state_desc);
+		detail->extra_info_str = malloc(strlen(state_desc)+8);
+		sprintf(detail->extra_info_str, "State: %s", state_desc);
 
-		rtos->thread_details[tasks_found].exists = true;
+		detail->exists = true;
 
 		tasks_found++;
-		prev_thread_ptr = thread_ptr;
-
-		/* Get the location of the next thread structure. */
-		thread_ptr = 0;
-		retval = target_read_buffer(rtos->target,
-				prev_thread_ptr + param->thread_next_offset,
-				param->pointer_width,
-				(uint8_t *) &thread_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading next thread pointer in ThreadX thread list");
-			return retval;
-		}
 	}
+	retval = ERROR_OK;
 
+done:
+	free(name_data);
+	free(names);
+	free(states);
+	free(tcb);
 	rtos->thread_count = tasks_found;
 
-	return 0;
+	return retval;
 }
 
 static int ThreadX_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
@@ -237,12 +237,25 @@ static int hwthread_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	if (!target_was_examined(curr))
 		return ERROR_FAIL;
 
+	/* registers still cached by the core are not read again, the others
+	 * are read in one batch where the core supports it, like for "g" */
 	struct reg **reg_list;
-	int retval = target_get_gdb_reg_list(curr, &reg_list, rtos_reg_list_size,
+	int retval = target_get_gdb_reg_list_noread(curr, &reg_list, rtos_reg_list_size,
 			REG_CLASS_GENERAL);
 	if (retval != ERROR_OK)
 		return retval;
 
+	if (target_read_registers_batch(curr, reg_list, *rtos_reg_list_size) != ERROR_OK)
+		LOG_DEBUG("Couldn't batch read registers, reading one by one");
+
+	for (int i = 0; i < *rtos_reg_list_size; i++) {
+		if (!reg_list[i]->exist || reg_list[i]->valid)
+			continue;
+		/* like "g", report what was read before the failure */
+		if (reg_list[i]->type->get(reg_list[i]) != ERROR_OK)
+			LOG_DEBUG("Couldn't get register %s.", reg_list[i]->name);
+	}
+
 	*rtos_reg_list = calloc(*rtos_reg_list_size, sizeof(struct rtos_reg));
 	if (*rtos_reg_list == NULL) {
 		free(reg_list);
@@ -250,10 +263,10 @@ static int hwthread_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	}
 
 	for (int i = 0; i < *rtos_reg_list_size; i++) {
-		(*rtos_reg_list)[i].number = (*reg_list)[i].number;
-		(*rtos_reg_list)[i].size = (*reg_list)[i].size;
-		memcpy((*rtos_reg_list)[i].value, (*reg_list)[i].value,
-				((*reg_list)[i].size + 7) / 8);
+		(*rtos_reg_list)[i].number = reg_list[i]->number;
+		(*rtos_reg_list)[i].size = reg_list[i]->size;
+		memcpy((*rtos_reg_list)[i].value, reg_list[i]->value,
+				(reg_list[i]->size + 7) / 8);
 	}
 	free(reg_list);
 
@@ -598,6 +598,63 @@ uint32_t next_task(struct target *target, struct threads *t)
 	return 0;
 }
 
+/*  task_struct fields used by the task list walks, all read at once  */
+#define TASK_SPAN	(MAX(MAX(COMM + 16, NEXT + 4), MAX(PID, MAX(ONCPU, MEM)) + 4))
+/*  the fields checked for tasks already known: tasks.next and pid  */
+#define TASK_CHECK_START	MIN(NEXT, PID)
+#define TASK_CHECK_SPAN	(MAX(NEXT, PID) + 4 - TASK_CHECK_START)
+
+/*  read a new task in one access, and the address of the next one  */
+static int task_read(struct target *target, struct threads *t, uint32_t *next)
+{
+	uint8_t task[(TASK_SPAN + 3) & ~3];
+	int retval = linux_read_memory(target, t->base_addr, 4, sizeof(task) / 4, task);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("task read: unable to read memory");
+		return retval;
+	}
+
+	t->state = get_buffer(target, task);
+	t->pid = get_buffer(target, task + PID);
+	t->oncpu = get_buffer(target, task + ONCPU);
+	memcpy(t->name, task + COMM, 16);
+	t->name[16] = 0;
+	*next = get_buffer(target, task + NEXT) - NEXT;
+
+	uint32_t mm = get_buffer(target, task + MEM);
+	t->asid = 0;
+	if (mm != 0) {
+		uint8_t buffer[4];
+		retval = fill_buffer(target, mm + MM_CTX, buffer);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("task read: unable to read memory -- ASID");
+			return retval;
+		}
+		t->asid = get_buffer(target, buffer);
+	}
+
+	return ERROR_OK;
+}
+
+/*  read the pid of a task and the address of the next one in one access  */
+static int task_check(struct target *target, uint32_t base_addr,
+	uint32_t *pid, uint32_t *next)
+{
+	uint8_t fields[(TASK_CHECK_SPAN + 3) & ~3];
+	int retval = linux_read_memory(target, base_addr + TASK_CHECK_START, 4,
+			sizeof(fields) / 4, fields);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("task check: unable to read memory");
+		return retval;
+	}
+
+	*pid = get_buffer(target, fields + PID - TASK_CHECK_START);
+	*next = get_buffer(target, fields + NEXT - TASK_CHECK_START) - NEXT;
+	return ERROR_OK;
+}
+
 struct current_thread *add_current_thread(struct current_thread *currents,
 	struct current_thread *ct)
 {
@@ -708,8 +765,8 @@ int linux_get_tasks(struct target *target, int context)
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != 0)) || (loop == 0)) {
 		loop++;
-		fill_task(target, t);
-		retval = get_name(target, t);
+		uint32_t base_addr;
+		retval = task_read(target, t, &base_addr);
 
 		if (loop > MAX_THREADS) {
 			free(t);
@@ -724,7 +781,6 @@ int linux_get_tasks(struct target *target, int context)
 
 		/*  check that this thread is not one the current threads already
 		 *  created */
-		uint32_t base_addr;
 #ifdef PID_CHECK
 
 		if (!current_pid(linux_os, t->pid)) {
@@ -745,10 +801,8 @@ int linux_get_tasks(struct target *target, int context)
 				t->context =
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
-			base_addr = next_task(target, t);
 		} else {
 			/*LOG_INFO("thread %s is a current thread already created",t->name); */
-			base_addr = next_task(target, t);
 			free(t);
 		}
 
@@ -955,10 +1009,10 @@ static int linux_task_update(struct target *target, int context)
 		 *  target */
 		loop++;
 		previous = t->base_addr;
-		/*  read only pid */
-#ifdef PID_CHECK
-		retval = fill_task_pid(target, t);
-#endif
+		/*  read only pid and next task, the other fields of known
+		 *  tasks are kept from the previous updates */
+		uint32_t next;
+		retval = task_check(target, t->base_addr, &t->pid, &next);
 
 		if (retval != ERROR_OK) {
 			free(t);
@@ -977,6 +1031,13 @@ static int linux_task_update(struct target *target, int context)
 #ifdef PID_CHECK
 					if (t->base_addr != thread_list->base_addr)
 						LOG_INFO("thread base_addr has changed !!");
+#else
+					/*  task_struct reused by a new task  */
+					if (t->pid != thread_list->pid &&
+							task_read(target, thread_list, &next) != ERROR_OK) {
+						free(t);
+						return ERROR_FAIL;
+					}
 #endif
 					/*  this is not a current thread  */
 					thread_list->base_addr = t->base_addr;
@@ -1007,9 +1068,10 @@ static int linux_task_update(struct target *target, int context)
 		}
 
 		if (found == 0) {
-			uint32_t base_addr;
-			fill_task(target, t);
-			get_name(target, t);
+			if (task_read(target, t, &next) != ERROR_OK) {
+				free(t);
+				return ERROR_FAIL;
+			}
 			retval = insert_into_threadlist(target, t);
 			t->thread_info_addr = 0xdeadbeef;
 
@@ -1018,12 +1080,11 @@ static int linux_task_update(struct target *target, int context)
 					cpu_context_read(target, t->base_addr,
 						&t->thread_info_addr);
 
-			base_addr = next_task(target, t);
 			t = calloc(1, sizeof(struct threads));
-			t->base_addr = base_addr;
+			t->base_addr = next;
 			linux_os->thread_count++;
 		} else
-			t->base_addr = next_task(target, t);
+			t->base_addr = next;
 	}
 
 	LOG_INFO("update thread done %" PRId64 ", mean%" PRId64 "\n",
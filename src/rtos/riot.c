@@ -207,21 +207,61 @@ static int riot_update_threads(struct rtos *rtos)
 		return ERROR_FAIL;
 	}
 
-	/* Buffer for thread names, maximum to display is 32 */
-	char buffer[32];
+	/*
+	 * Read the whole thread array, then the TCBs of all used PIDs in one
+	 * batch, then their names in another one.
+	 */
+	unsigned int tcb_size = MAX(param->thread_status_offset + 1, name_offset + 4);
+	uint8_t *tcb_pointers = malloc(max_threads * 4);
+	uint8_t *tcbs = malloc(max_threads * tcb_size);
+	struct target_read_request *reads = calloc(max_threads, sizeof(*reads));
+	/* Buffers for thread names, maximum to display is 32 */
+	char (*names)[32] = calloc(max_threads, sizeof(*names));
+	if (max_threads > 0 && (!tcb_pointers || !tcbs || !reads || !names)) {
+		LOG_ERROR("RIOT: out of memory");
+		retval = ERROR_FAIL;
+		goto error;
+	}
+
+	retval = target_read_buffer(rtos->target, threads_base, max_threads * 4, tcb_pointers);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Can't parse `%s`", riot_symbol_list[RIOT_THREADS_BASE]);
+		goto error;
+	}
 
 	for (unsigned int i = 0; i < max_threads; i++) {
-		/* get pointer to tcb_t */
-		uint32_t tcb_pointer = 0;
-		retval = target_read_u32(rtos->target,
-				threads_base + (i * 4),
-				&tcb_pointer);
+		reads[i].address = target_buffer_get_u32(rtos->target, tcb_pointers + i * 4);
+		/* PID unused if 0 */
+		reads[i].size = reads[i].address ? tcb_size : 0;
+		reads[i].buffer = tcbs + i * tcb_size;
+	}
+
+	retval = target_read_buffer_batch(rtos->target, reads, max_threads);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Can't parse `%s`", riot_symbol_list[RIOT_THREADS_BASE]);
+		goto error;
+	}
+
+	/* Thread names are only available if compiled with DEVELHELP */
+	if (name_offset != 0) {
+		for (unsigned int i = 0; i < max_threads; i++) {
+			bool used = reads[i].size != 0;
+
+			reads[i].address = used ? target_buffer_get_u32(rtos->target,
+					tcbs + i * tcb_size + name_offset) : 0;
+			reads[i].size = used ? sizeof(names[i]) : 0;
+			reads[i].buffer = (uint8_t *)names[i];
+		}
+
+		retval = target_read_buffer_batch(rtos->target, reads, max_threads);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Can't parse `%s`", riot_symbol_list[RIOT_THREADS_BASE]);
 			goto error;
 		}
+	}
 
-		if (tcb_pointer == 0) {
+	for (unsigned int i = 0; i < max_threads && tasks_found < thread_count; i++) {
+		if (target_buffer_get_u32(rtos->target, tcb_pointers + i * 4) == 0) {
 			/* PID unused */
 			continue;
 		}
@@ -229,15 +269,8 @@ static int riot_update_threads(struct rtos *rtos)
 		/* Index is PID */
 		rtos->thread_details[tasks_found].threadid = i;
 
-		/* read thread state */
-		uint8_t status = 0;
-		retval = target_read_u8(rtos->target,
-				tcb_pointer + param->thread_status_offset,
-				&status);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Can't parse `%s`", riot_symbol_list[RIOT_THREADS_BASE]);
-			goto error;
-		}
+		/* thread state */
+		uint8_t status = tcbs[i * tcb_size + param->thread_status_offset];
 
 		/* Search for state */
 		unsigned int k;
@@ -261,36 +294,13 @@ static int riot_update_threads(struct rtos *rtos)
 			goto error;
 		}
 
-		/* Thread names are only available if compiled with DEVELHELP */
 		if (name_offset != 0) {
-			uint32_t name_pointer = 0;
-			retval = target_read_u32(rtos->target,
-					tcb_pointer + name_offset,
-					&name_pointer);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Can't parse `%s`",
-					riot_symbol_list[RIOT_THREADS_BASE]);
-				goto error;
-			}
-
-			/* read thread name */
-			retval = target_read_buffer(rtos->target,
-					name_pointer,
-					sizeof(buffer),
-					(uint8_t *)&buffer);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Can't parse `%s`",
-					riot_symbol_list[RIOT_THREADS_BASE]);
-				goto error;
-			}
-
 			/* Make sure the string in the buffer terminates */
-			if (buffer[sizeof(buffer) - 1] != 0)
-				buffer[sizeof(buffer) - 1] = 0;
+			names[i][sizeof(names[i]) - 1] = 0;
 
 			/* Copy thread name */
 			rtos->thread_details[tasks_found].thread_name_str =
-			strdup(buffer);
+			strdup(names[i]);
 
 		} else {
 			rtos->thread_details[tasks_found].thread_name_str =
@@ -308,9 +318,17 @@ static int riot_update_threads(struct rtos *rtos)
 		tasks_found++;
 	}
 
+	free(names);
+	free(reads);
+	free(tcbs);
+	free(tcb_pointers);
 	return ERROR_OK;
 
 error:
+	free(names);
+	free(reads);
+	free(tcbs);
+	free(tcb_pointers);
 	rtos_free_threadlist(rtos);
 	return retval;
 }
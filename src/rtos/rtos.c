@@ -24,6 +24,8 @@
 #include "target/target.h"
 #include "helper/log.h"
 #include "helper/binarybuffer.h"
+#include "helper/time_support.h"
+#include "helper/perf.h"
 #include "server/gdb_server.h"
 
 /* RTOSs */
@@ -95,11 +97,14 @@ static int os_alloc(struct target *target, struct rtos_type *ostype)
 	return JIM_OK;
 }
 
+static void rtos_reg_cache_flush(struct rtos *rtos);
+
 static void os_free(struct target *target)
 {
 	if (!target->rtos)
 		return;
 
+	rtos_reg_cache_flush(target->rtos);
 	free(target->rtos->symbols);
 	free(target->rtos);
 	target->rtos = NULL;
@@ -174,7 +179,7 @@ int gdb_thread_packet(struct connection *connection, char const *packet, int pac
 	return target->rtos->gdb_thread_packet(connection, packet, packet_size);
 }
 
-static symbol_table_elem_t *next_symbol(struct rtos *os, char *cur_symbol, uint64_t cur_addr)
+static symbol_table_elem_t *next_symbol(struct rtos *os, const char *cur_symbol, uint64_t cur_addr)
 {
 	symbol_table_elem_t *s;
 
@@ -194,6 +199,20 @@ static symbol_table_elem_t *next_symbol(struct rtos *os, char *cur_symbol, uint6
 	return NULL;
 }
 
+/* steps of the check of a symbol table kept from an earlier gdb connection */
+#define RTOS_SYMBOLS_CHECK_NONE		0
+#define RTOS_SYMBOLS_CHECK_FIRST	1
+#define RTOS_SYMBOLS_CHECK_LAST		2
+
+static symbol_table_elem_t *last_symbol(struct rtos *os)
+{
+	symbol_table_elem_t *s = os->symbols;
+
+	while (s[1].symbol_name)
+		s++;
+	return s;
+}
+
 /* searches for 'symbol' in the lookup table for 'os' and returns TRUE,
  * if 'symbol' is not declared optional */
 static bool is_symbol_mandatory(const struct rtos *os, const char *symbol)
@@ -222,6 +241,10 @@ static bool is_symbol_mandatory(const struct rtos *os, const char *symbol)
  * specified explicitly, then no further symbol lookup is done. When
  * auto-detecting, the RTOS driver _detect() function must return success.
  *
+ * Once all the symbols were looked up, a new GDB connection, typically with
+ * the same ELF file, only confirms the first and the last symbol of the
+ * table. The whole table is looked up again if either of them moved.
+ *
  * rtos_qsymbol() returns 1 if an RTOS has been detected, or 0 otherwise.
  */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size)
@@ -239,10 +262,49 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 	if (!os)
 		goto done;
 
-	/* Decode any symbol name in the packet*/
-	size_t len = unhexify((uint8_t *)cur_sym, strchr(packet + 8, ':') + 1, strlen(strchr(packet + 8, ':') + 1));
+	/* Decode any symbol name in the packet, packets may be larger than cur_sym */
+	const char *hex_sym = strchr(packet + 8, ':') + 1;
+	size_t len = unhexify((uint8_t *)cur_sym, hex_sym,
+			MIN(strlen(hex_sym) / 2, sizeof(cur_sym) - 1));
 	cur_sym[len] = 0;
 
+	if (strcmp(packet, "qSymbol::") == 0) {
+		os->symbols_check = RTOS_SYMBOLS_CHECK_NONE;
+		if (os->symbols_complete && os->symbols && os->symbols[0].symbol_name) {
+			os->symbols_check = RTOS_SYMBOLS_CHECK_FIRST;
+			next_sym = &os->symbols[0];
+			goto ask;
+		}
+	} else if (os->symbols_check != RTOS_SYMBOLS_CHECK_NONE) {
+		symbol_table_elem_t *s = os->symbols_check == RTOS_SYMBOLS_CHECK_FIRST ?
+			&os->symbols[0] : last_symbol(os);
+		if (sscanf(packet, "qSymbol:%" SCNx64 ":", &addr) != 1)
+			addr = 0;
+
+		if (!strcmp(s->symbol_name, cur_sym) && s->address == addr) {
+			if (os->symbols_check == RTOS_SYMBOLS_CHECK_FIRST && s != last_symbol(os)) {
+				os->symbols_check = RTOS_SYMBOLS_CHECK_LAST;
+				next_sym = last_symbol(os);
+				goto ask;
+			}
+			LOG_DEBUG("RTOS %s symbols unchanged", os->type->name);
+			os->symbols_check = RTOS_SYMBOLS_CHECK_NONE;
+			rtos_detected = 1;
+			goto done;
+		}
+
+		LOG_DEBUG("RTOS %s symbols changed, looking all of them up", os->type->name);
+		os->symbols_complete = false;
+		if (os->symbols_check == RTOS_SYMBOLS_CHECK_LAST) {
+			/* start over, as if GDB had just offered the lookup */
+			os->symbols_check = RTOS_SYMBOLS_CHECK_NONE;
+			next_sym = &os->symbols[0];
+			goto ask;
+		}
+		/* else go on with the answer about the first symbol */
+		os->symbols_check = RTOS_SYMBOLS_CHECK_NONE;
+	}
+
 	if ((strcmp(packet, "qSymbol::") != 0) &&               /* GDB is not offering symbol lookup for the first time */
 	    (!sscanf(packet, "qSymbol:%" SCNx64 ":", &addr)) && /* GDB did not find an address for a symbol */
 	    is_symbol_mandatory(os, cur_sym)) {					/* the symbol is mandatory for this RTOS */
@@ -282,6 +344,7 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 		}
 	}
 
+ask:
 	if (8 + (strlen(next_sym->symbol_name) * 2) + 1 > sizeof(reply)) {
 		LOG_ERROR("ERROR: RTOS symbol '%s' name is too long for GDB!", next_sym->symbol_name);
 		goto done;
@@ -293,6 +356,8 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 		sizeof(reply) - reply_len);
 
 done:
+	if (rtos_detected)
+		os->symbols_complete = true;
 	gdb_put_packet(connection, reply, reply_len);
 	return rtos_detected;
 }
@@ -362,7 +427,10 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 				target->rtos_auto_detect = false;
 				target->rtos->type->create(target);
 			}
-			target->rtos->type->update_threads(target->rtos);
+			/* the symbols may tell a different story now */
+			target->rtos->threads_valid = false;
+			target->rtos->change_hint_valid = false;
+			rtos_update_threads(target);
 		}
 		return ERROR_OK;
 	} else if (strncmp(packet, "qfThreadInfo", 12) == 0) {
@@ -468,6 +536,65 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+/* the registers of one thread, as returned by get_thread_reg_list() */
+struct rtos_reg_cache {
+	int64_t threadid;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
+static void rtos_reg_cache_flush(struct rtos *rtos)
+{
+	for (unsigned int i = 0; i < rtos->reg_cache_count; i++)
+		free(rtos->reg_cache[i].reg_list);
+	free(rtos->reg_cache);
+	rtos->reg_cache = NULL;
+	rtos->reg_cache_count = 0;
+}
+
+/**
+ * Get the register list of @a threadid, which is kept until the target
+ * resumes or memory is written: gdb asks for the registers of every thread
+ * at each stop to show their backtraces, often more than once.
+ * The list belongs to the cache unless the target is running, then the
+ * caller must free it.
+ */
+static int rtos_get_thread_reg_list(struct rtos *rtos, int64_t threadid,
+		struct rtos_reg **reg_list, int *num_regs, bool *cached)
+{
+	if (rtos->target->state != TARGET_HALTED ||
+			rtos->reg_cache_generation != target_memory_generation())
+		rtos_reg_cache_flush(rtos);
+
+	for (unsigned int i = 0; i < rtos->reg_cache_count; i++) {
+		if (rtos->reg_cache[i].threadid == threadid) {
+			*reg_list = rtos->reg_cache[i].reg_list;
+			*num_regs = rtos->reg_cache[i].num_regs;
+			*cached = true;
+			return ERROR_OK;
+		}
+	}
+
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, reg_list, num_regs);
+	*cached = false;
+	if (retval != ERROR_OK || rtos->target->state != TARGET_HALTED)
+		return retval;
+
+	struct rtos_reg_cache *cache = realloc(rtos->reg_cache,
+			(rtos->reg_cache_count + 1) * sizeof(*cache));
+	if (!cache)
+		return ERROR_OK;
+
+	rtos->reg_cache = cache;
+	rtos->reg_cache[rtos->reg_cache_count].threadid = threadid;
+	rtos->reg_cache[rtos->reg_cache_count].reg_list = *reg_list;
+	rtos->reg_cache[rtos->reg_cache_count].num_regs = *num_regs;
+	rtos->reg_cache_count++;
+	rtos->reg_cache_generation = target_memory_generation();
+	*cached = true;
+	return ERROR_OK;
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -487,6 +614,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										target->rtos->current_thread);
 
 		int retval;
+		bool cached = false;
 		if (target->rtos->type->get_thread_reg) {
 			reg_list = calloc(1, sizeof(*reg_list));
 			num_regs = 1;
@@ -497,10 +625,11 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
+			retval = rtos_get_thread_reg_list(target->rtos,
 					current_threadid,
 					&reg_list,
-					&num_regs);
+					&num_regs,
+					&cached);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("RTOS: failed to get register list");
 				return retval;
@@ -510,12 +639,14 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
+				if (!cached)
+					free(reg_list);
 				return ERROR_OK;
 			}
 		}
 
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 	}
 	return ERROR_FAIL;
 }
@@ -537,17 +668,20 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		bool cached;
+		int retval = rtos_get_thread_reg_list(target->rtos,
 				current_threadid,
 				&reg_list,
-				&num_regs);
+				&num_regs,
+				&cached);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("RTOS: failed to get register list");
 			return retval;
 		}
 
 		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 
 		return ERROR_OK;
 	}
@@ -563,6 +697,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg != NULL) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_reg_cache_flush(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -645,19 +780,183 @@ int rtos_try_next(struct target *target)
 
 	os->type = *type;
 
+	rtos_reg_cache_flush(os);
 	free(os->symbols);
 	os->symbols = NULL;
+	os->symbols_complete = false;
 
 	return 1;
 }
 
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos != NULL) && (target->rtos->type != NULL))
-		target->rtos->type->update_threads(target->rtos);
+	struct rtos *rtos = target->rtos;
+
+	if (!rtos || !rtos->type)
+		return ERROR_OK;
+
+	/* nothing can have changed since the last update during this halt */
+	if (rtos->threads_valid && target->state == TARGET_HALTED &&
+			rtos->threads_generation == target_memory_generation())
+		return ERROR_OK;
+
+	rtos->threads_valid = false;
+	int64_t start = perf_start();
+	if (rtos->type->update_threads(rtos) == ERROR_OK && target->state == TARGET_HALTED) {
+		rtos->threads_valid = true;
+		rtos->threads_generation = target_memory_generation();
+	}
+	perf_end(PERF_RTOS_UPDATE_THREADS, start);
 	return ERROR_OK;
 }
 
+/* layout of contrib/rtos-helpers/openocd-thread-table.h */
+#define RTOS_THREAD_TABLE_MAGIC			0x5454434f
+#define RTOS_THREAD_TABLE_VERSION		1
+#define RTOS_THREAD_TABLE_HEADER_SIZE	24
+#define RTOS_THREAD_TABLE_ENTRY_SIZE	12
+/* sanity limit of the thread count */
+#define RTOS_THREAD_TABLE_MAX			4096
+#define RTOS_THREAD_TABLE_NAME_SIZE		32
+
+/**
+ * Replace the thread list of @a rtos with the thread table the target keeps
+ * at @a address, see contrib/rtos-helpers/openocd-thread-table.h. The table
+ * is usually read in one access, the thread names only when threads were
+ * added or removed since the last call.
+ *
+ * @param state_names Names of the RTOS specific thread states, may be NULL.
+ * @returns ERROR_OK if the thread list was updated, else the table is
+ * missing, empty or being changed, and the RTOS has to walk its own lists.
+ */
+int rtos_read_thread_table(struct rtos *rtos, symbol_address_t address,
+		const char * const *state_names, unsigned int num_states)
+{
+	struct target *target = rtos->target;
+	struct thread_detail *details = NULL;
+	struct target_read_request *names = NULL;
+	char (*name_data)[RTOS_THREAD_TABLE_NAME_SIZE] = NULL;
+	int retval;
+
+	/* guess the size from the last read, to get it all in one access */
+	uint32_t size = RTOS_THREAD_TABLE_HEADER_SIZE;
+	if (rtos->change_hint_valid && rtos->thread_details)
+		size += rtos->thread_count * RTOS_THREAD_TABLE_ENTRY_SIZE;
+	uint8_t *table = malloc(size);
+	if (!table)
+		return ERROR_FAIL;
+
+	retval = target_read_buffer(target, address, size, table);
+	if (retval != ERROR_OK)
+		goto done;
+
+	uint32_t magic = target_buffer_get_u32(target, table);
+	uint16_t version = target_buffer_get_u16(target, table + 4);
+	uint16_t entry_size = target_buffer_get_u16(target, table + 6);
+	uint32_t count = target_buffer_get_u32(target, table + 8);
+	uint32_t capacity = target_buffer_get_u32(target, table + 12);
+	uint32_t generation = target_buffer_get_u32(target, table + 16);
+	threadid_t current = target_buffer_get_u32(target, table + 20);
+
+	retval = ERROR_FAIL;
+	if (magic != RTOS_THREAD_TABLE_MAGIC || version != RTOS_THREAD_TABLE_VERSION ||
+			entry_size < RTOS_THREAD_TABLE_ENTRY_SIZE || count > capacity ||
+			count > RTOS_THREAD_TABLE_MAX || count == 0 || current == 0 ||
+			(generation & 1)) {
+		LOG_DEBUG("RTOS: no usable thread table at 0x%" PRIx64, address);
+		goto done;
+	}
+
+	uint32_t table_size = RTOS_THREAD_TABLE_HEADER_SIZE + count * entry_size;
+	if (table_size > size) {
+		uint8_t *t = realloc(table, table_size);
+		if (!t)
+			goto done;
+		table = t;
+		retval = target_read_buffer(target, address + size, table_size - size, table + size);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+
+	bool same_threads = rtos->change_hint_valid && rtos->change_hint == generation &&
+		rtos->thread_details && rtos->thread_count == (int)count;
+	unsigned int num_names = 0;
+
+	details = calloc(count, sizeof(*details));
+	names = calloc(count, sizeof(*names));
+	name_data = calloc(count, sizeof(*name_data));
+	if (!details || !names || !name_data) {
+		LOG_ERROR("RTOS: out of memory");
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t *entry = table + RTOS_THREAD_TABLE_HEADER_SIZE + i * entry_size;
+		struct thread_detail *old = same_threads ? &rtos->thread_details[i] : NULL;
+		uint32_t name = target_buffer_get_u32(target, entry + 4);
+
+		details[i].threadid = target_buffer_get_u32(target, entry);
+		details[i].exists = true;
+
+		/* names only change with the threads */
+		if (old && old->threadid == details[i].threadid && old->thread_name_str) {
+			details[i].thread_name_str = strdup(old->thread_name_str);
+		} else if (name) {
+			names[num_names].address = name;
+			names[num_names].size = RTOS_THREAD_TABLE_NAME_SIZE;
+			names[num_names].buffer = (uint8_t *)name_data[i];
+			num_names++;
+		}
+	}
+
+	retval = target_read_buffer_batch(target, names, num_names);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("RTOS: failed to read the thread names");
+		goto done;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t *entry = table + RTOS_THREAD_TABLE_HEADER_SIZE + i * entry_size;
+		unsigned int state = entry[8];
+		unsigned int priority = entry[9];
+		char info[64];
+
+		if (!details[i].thread_name_str) {
+			name_data[i][RTOS_THREAD_TABLE_NAME_SIZE - 1] = 0;
+			details[i].thread_name_str = strdup(name_data[i][0] ? name_data[i] : "No Name");
+		}
+
+		if (details[i].threadid == current)
+			snprintf(info, sizeof(info), "State: Running, Priority: %u", priority);
+		else if (state_names && state < num_states && state_names[state])
+			snprintf(info, sizeof(info), "State: %s, Priority: %u", state_names[state], priority);
+		else
+			snprintf(info, sizeof(info), "Priority: %u", priority);
+		details[i].extra_info_str = strdup(info);
+	}
+
+	rtos_free_threadlist(rtos);
+	rtos->thread_details = details;
+	rtos->thread_count = count;
+	rtos->current_thread = current;
+	rtos->change_hint = generation;
+	rtos->change_hint_valid = true;
+	details = NULL;
+	retval = ERROR_OK;
+
+done:
+	if (details) {
+		for (uint32_t i = 0; i < count; i++)
+			free(details[i].thread_name_str);
+		free(details);
+	}
+	free(name_data);
+	free(names);
+	free(table);
+	return retval;
+}
+
 void rtos_free_threadlist(struct rtos *rtos)
 {
 	if (rtos->thread_details) {
@@ -674,4 +973,115 @@ void rtos_free_threadlist(struct rtos *rtos)
 		rtos->current_threadid = -1;
 		rtos->current_thread = 0;
 	}
+	rtos->threads_valid = false;
 }
+
+COMMAND_HANDLER(handle_rtos_stack_usage_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct rtos *rtos = target->rtos;
+	uint8_t fill_value = 0xa5;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(u8, CMD_ARGV[0], fill_value);
+
+	if (!rtos || !rtos->type) {
+		command_print(CMD, "no RTOS configured for target %s", target_name(target));
+		return ERROR_FAIL;
+	}
+	if (!rtos->type->get_thread_stack) {
+		command_print(CMD, "%s does not tell the thread stacks", rtos->type->name);
+		return ERROR_FAIL;
+	}
+	if (target->state != TARGET_HALTED) {
+		command_print(CMD, "target %s not halted", target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	int64_t start = timeval_ms();
+
+	rtos_update_threads(target);
+	if (rtos->thread_count <= 0) {
+		command_print(CMD, "no threads");
+		return ERROR_OK;
+	}
+
+	struct target_memory_check_block *blocks = calloc(rtos->thread_count, sizeof(*blocks));
+	int *thread = calloc(rtos->thread_count, sizeof(*thread));
+	if (!blocks || !thread) {
+		free(blocks);
+		free(thread);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* the word aligned part between the bottom and the saved stack pointer */
+	int num_blocks = 0;
+	for (int i = 0; i < rtos->thread_count; i++) {
+		target_addr_t bottom, top;
+		if (rtos->type->get_thread_stack(rtos, rtos->thread_details[i].threadid,
+					&bottom, &top) != ERROR_OK)
+			continue;
+		bottom = (bottom + 3) & ~(target_addr_t)3;
+		top &= ~(target_addr_t)3;
+		if (top <= bottom)
+			continue;
+		blocks[num_blocks].address = bottom;
+		blocks[num_blocks].size = top - bottom;
+		thread[num_blocks++] = i;
+	}
+
+	int retval = ERROR_OK;
+	for (int done = 0; done < num_blocks; ) {
+		retval = target_stack_check_memory(target, blocks + done, num_blocks - done,
+				fill_value);
+		if (retval < 0)
+			break;
+		done += retval;
+		retval = ERROR_OK;
+	}
+
+	if (retval == ERROR_OK) {
+		command_print(CMD, "%-18s %-20s %-18s %10s %10s", "thread", "name",
+				"stack", "in use", "never used");
+		for (int i = 0; i < num_blocks; i++) {
+			const struct thread_detail *detail = &rtos->thread_details[thread[i]];
+			command_print(CMD, "0x%-16" PRIx64 " %-20s " TARGET_ADDR_FMT " %10" PRIu32
+					" %10" PRIu32, detail->threadid,
+					detail->thread_name_str ? detail->thread_name_str : "",
+					blocks[i].address, blocks[i].size - blocks[i].result,
+					blocks[i].result);
+		}
+		LOG_DEBUG("stack usage of %d threads in %" PRId64 " ms", num_blocks,
+				timeval_ms() - start);
+	}
+
+	free(blocks);
+	free(thread);
+	return retval;
+}
+
+static const struct command_registration rtos_subcommand_handlers[] = {
+	{
+		.name = "stack_usage",
+		.handler = handle_rtos_stack_usage_command,
+		.mode = COMMAND_EXEC,
+		.help = "show how much of the stack of each thread still holds "
+			"the fill value",
+		.usage = "[fill_value]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration rtos_command_handlers[] = {
+	{
+		.name = "rtos",
+		.mode = COMMAND_EXEC,
+		.help = "RTOS command group",
+		.usage = "",
+		.chain = rtos_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -56,6 +56,21 @@ struct rtos {
 	threadid_t current_thread;
 	struct thread_detail *thread_details;
 	int thread_count;
+	/* thread_details were read while halted at this target_memory_generation() */
+	bool threads_valid;
+	unsigned int threads_generation;
+	/* RTOS specific counter of thread list changes seen by the last update,
+	 * e.g. FreeRTOS' uxTaskNumber, which lets it skip rescanning the lists */
+	bool change_hint_valid;
+	uint64_t change_hint;
+	/* symbols were all looked up by an earlier gdb connection, and which
+	 * of them (RTOS_SYMBOLS_CHECK_*) a new connection is verifying */
+	bool symbols_complete;
+	int symbols_check;
+	/* register lists of threads read by gdb at reg_cache_generation */
+	struct rtos_reg_cache *reg_cache;
+	unsigned int reg_cache_count;
+	unsigned int reg_cache_generation;
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
@@ -82,6 +97,10 @@ struct rtos_type {
 	int (*clean)(struct target *target);
 	char * (*ps_command)(struct target *target);
 	int (*set_reg)(struct rtos *rtos, uint32_t reg_num, uint8_t *reg_value);
+	/** Optional. The stack of a thread growing down from @a top, the saved
+	 * stack pointer, towards @a bottom, for "rtos stack_usage". */
+	int (*get_thread_stack)(struct rtos *rtos, threadid_t thread_id,
+			target_addr_t *bottom, target_addr_t *top);
 };
 
 struct stack_register_offset {
@@ -125,7 +144,10 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num);
 int rtos_get_gdb_reg_list(struct connection *connection);
 int rtos_update_threads(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
+int rtos_read_thread_table(struct rtos *rtos, symbol_address_t address,
+		const char * const *state_names, unsigned int num_states);
 int rtos_smp_init(struct target *target);
+extern const struct command_registration rtos_command_handlers[];
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
 
@@ -164,40 +164,13 @@ static int uCOS_III_find_thread_address(struct rtos *rtos, threadid_t threadid,
 	return ERROR_OK;
 }
 
-static int uCOS_III_find_last_thread_address(struct rtos *rtos, symbol_address_t *thread_address)
+static symbol_address_t uCOS_III_get_pointer(struct rtos *rtos, const uint8_t *buffer)
 {
 	struct uCOS_III_params *params = rtos->rtos_specific_params;
-	int retval;
-
-	/* read the thread list head */
-	symbol_address_t thread_list_address = 0;
-
-	retval = target_read_memory(rtos->target,
-			rtos->symbols[uCOS_III_VAL_OSTaskDbgListPtr].address,
-			params->pointer_width,
-			1,
-			(void *)&thread_list_address);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("uCOS-III: failed to read thread list address");
-		return retval;
-	}
-
-	/* advance to end of thread list */
-	do {
-		*thread_address = thread_list_address;
-
-		retval = target_read_memory(rtos->target,
-				thread_list_address + params->thread_next_offset,
-				params->pointer_width,
-				1,
-				(void *)&thread_list_address);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read next thread address");
-			return retval;
-		}
-	} while (thread_list_address != 0);
 
-	return ERROR_OK;
+	if (params->pointer_width == sizeof(uint64_t))
+		return target_buffer_get_u64(rtos->target, buffer);
+	return target_buffer_get_u32(rtos->target, buffer);
 }
 
 static int uCOS_III_update_thread_offsets(struct rtos *rtos)
@@ -376,25 +349,88 @@ static int uCOS_III_update_threads(struct rtos *rtos)
 
 	/*
 	 * uC/OS-III adds tasks in LIFO order; advance to the end of the
-	 * list and work backwards to preserve the intended order.
+	 * list, reading each TCB in one access, and work backwards to
+	 * preserve the intended order. The names are read in one batch.
 	 */
+	size_t tcb_size = MAX(MAX(params->thread_name_offset, params->thread_next_offset),
+			params->thread_prev_offset) + params->pointer_width;
+	tcb_size = MAX(tcb_size, MAX(params->thread_state_offset,
+				params->thread_priority_offset) + 1);
+
+	symbol_address_t *tcb_addresses = calloc(UCOS_III_MAX_THREADS, sizeof(*tcb_addresses));
+	uint8_t *tcbs = malloc(UCOS_III_MAX_THREADS * tcb_size);
+	struct target_read_request *names = calloc(UCOS_III_MAX_THREADS, sizeof(*names));
+	char (*name_data)[UCOS_III_MAX_STRLEN + 1] = calloc(UCOS_III_MAX_THREADS,
+			sizeof(*name_data));
+	int num_tcbs = 0;
+
+	if (!tcb_addresses || !tcbs || !names || !name_data) {
+		LOG_ERROR("uCOS-III: out of memory");
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	/* read the thread list head */
 	symbol_address_t thread_address = 0;
 
-	retval = uCOS_III_find_last_thread_address(rtos, &thread_address);
+	retval = target_read_memory(rtos->target,
+			rtos->symbols[uCOS_III_VAL_OSTaskDbgListPtr].address,
+			params->pointer_width,
+			1,
+			(void *)&thread_address);
 	if (retval != ERROR_OK) {
-		LOG_ERROR("uCOS-III: failed to find last thread address");
-		return retval;
+		LOG_ERROR("uCOS-III: failed to read thread list address");
+		goto done;
+	}
+
+	while (thread_address != 0) {
+		if (num_tcbs == UCOS_III_MAX_THREADS) {
+			LOG_WARNING("uCOS-III: too many threads; increase UCOS_III_MAX_THREADS");
+			retval = ERROR_FAIL;
+			goto done;
+		}
+
+		uint8_t *tcb = tcbs + num_tcbs * tcb_size;
+
+		retval = target_read_buffer(rtos->target, thread_address, tcb_size, tcb);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("uCOS-III: failed to read thread");
+			goto done;
+		}
+		tcb_addresses[num_tcbs++] = thread_address;
+
+		thread_address = uCOS_III_get_pointer(rtos, tcb + params->thread_next_offset);
+	}
+
+	if (rtos->thread_count > num_tcbs)
+		rtos->thread_count = num_tcbs;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		uint8_t *tcb = tcbs + (num_tcbs - 1 - i) * tcb_size;
+
+		names[i].address = uCOS_III_get_pointer(rtos, tcb + params->thread_name_offset);
+		names[i].size = sizeof(name_data[i]);
+		names[i].buffer = (uint8_t *)name_data[i];
+	}
+
+	retval = target_read_buffer_batch(rtos->target, names, rtos->thread_count);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("uCOS-III: failed to read thread name");
+		goto done;
 	}
 
 	for (int i = 0; i < rtos->thread_count; i++) {
 		struct thread_detail *thread_detail = &rtos->thread_details[i];
+		uint8_t *tcb = tcbs + (num_tcbs - 1 - i) * tcb_size;
 		char thread_str_buffer[UCOS_III_MAX_STRLEN + 1];
 
+		thread_address = tcb_addresses[num_tcbs - 1 - i];
+
 		/* find or create new threadid */
 		retval = uCOS_III_find_or_create_thread(rtos, thread_address, &thread_detail->threadid);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("uCOS-III: failed to find or create thread");
-			return retval;
+			goto done;
 		}
 
 		if (thread_address == current_thread_address)
@@ -402,50 +438,12 @@ static int uCOS_III_update_threads(struct rtos *rtos)
 
 		thread_detail->exists = true;
 
-		/* read thread name */
-		symbol_address_t thread_name_address = 0;
+		name_data[i][UCOS_III_MAX_STRLEN] = '\0';
+		thread_detail->thread_name_str = strdup(name_data[i]);
 
-		retval = target_read_memory(rtos->target,
-				thread_address + params->thread_name_offset,
-				params->pointer_width,
-				1,
-				(void *)&thread_name_address);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to name address");
-			return retval;
-		}
-
-		retval = target_read_buffer(rtos->target,
-				thread_name_address,
-				sizeof(thread_str_buffer),
-				(void *)thread_str_buffer);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read thread name");
-			return retval;
-		}
-
-		thread_str_buffer[sizeof(thread_str_buffer) - 1] = '\0';
-		thread_detail->thread_name_str = strdup(thread_str_buffer);
-
-		/* read thread extra info */
-		uint8_t thread_state;
-		uint8_t thread_priority;
-
-		retval = target_read_u8(rtos->target,
-				thread_address + params->thread_state_offset,
-				&thread_state);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read thread state");
-			return retval;
-		}
-
-		retval = target_read_u8(rtos->target,
-				thread_address + params->thread_priority_offset,
-				&thread_priority);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read thread priority");
-			return retval;
-		}
+		/* thread extra info */
+		uint8_t thread_state = tcb[params->thread_state_offset];
+		uint8_t thread_priority = tcb[params->thread_priority_offset];
 
 		const char *thread_state_str;
 
@@ -457,20 +455,14 @@ static int uCOS_III_update_threads(struct rtos *rtos)
 		snprintf(thread_str_buffer, sizeof(thread_str_buffer), "State: %s, Priority: %d",
 				thread_state_str, thread_priority);
 		thread_detail->extra_info_str = strdup(thread_str_buffer);
-
-		/* read previous thread address */
-		retval = target_read_memory(rtos->target,
-				thread_address + params->thread_prev_offset,
-				params->pointer_width,
-				1,
-				(void *)&thread_address);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("uCOS-III: failed to read previous thread address");
-			return retval;
-		}
 	}
 
-	return ERROR_OK;
+done:
+	free(name_data);
+	free(names);
+	free(tcbs);
+	free(tcb_addresses);
+	return retval;
 }
 
 static int uCOS_III_get_thread_reg_list(struct rtos *rtos, threadid_t threadid,
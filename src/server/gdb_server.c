@@ -39,6 +39,7 @@
 #endif
 
 #include <target/breakpoints.h>
+#include <target/agent_expr.h>
 #include <target/target_request.h>
 #include <target/register.h>
 #include <target/target.h>
@@ -48,6 +49,7 @@
 #include <flash/nor/core.h>
 #include "gdb_server.h"
 #include <target/image.h>
+#include <helper/perf.h>
 #include <jtag/jtag.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
@@ -61,9 +63,28 @@
  * found in most modern embedded processors.
  */
 
-struct target_desc_format {
+/* target description generated for a target, see gdb_get_target_description() */
+struct gdb_tdesc_cache {
+	struct target *target;
+	/* of the register list the description was generated from */
+	uint32_t signature;
 	char *tdesc;
 	uint32_t tdesc_length;
+	struct gdb_tdesc_cache *next;
+};
+
+static struct gdb_tdesc_cache *gdb_tdesc_cache;
+
+/* a core of the SMP group while GDB runs in non-stop mode */
+struct gdb_nonstop_core {
+	struct target *target;
+	int64_t thread_id;
+	/* as seen by GDB: resumed and no stop reported yet */
+	bool running;
+	/* stopped by vCont;t, reported with signal 0 */
+	bool stop_requested;
+	/* stop reply not yet fetched by GDB, see vStopped */
+	bool stop_pending;
 };
 
 /* private connection data for GDB */
@@ -71,9 +92,18 @@ struct gdb_connection {
 	char buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
 	char *buf_p;
 	int buf_cnt;
+	/* incoming packets, PacketSize advertised to this connection */
+	char *packet_buffer;
+	int packet_size;
 	bool ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	/* bytes in vflash_image, and written to flash since the last vFlashDone */
+	uint32_t vflash_buffered;
+	uint32_t vflash_written;
+	/* first error programming a vflash_image chunk, reported at vFlashDone */
+	int vflash_result;
+	bool vflash_started;
 	bool closed;
 	bool busy;
 	int noack_mode;
@@ -93,10 +123,14 @@ struct gdb_connection {
 	bool attached;
 	/* set when extended protocol is used */
 	bool extended_protocol;
-	/* temporarily used for target description support */
-	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
+	/* set by QNonStop:1 */
+	bool non_stop;
+	struct gdb_nonstop_core *cores;
+	int num_cores;
+	/* stop reply of a %Stop notification or vStopped, not yet acknowledged */
+	struct gdb_nonstop_core *stop_reported;
 };
 
 #if 0
@@ -117,6 +151,9 @@ static void gdb_log_callback(void *priv, const char *file, unsigned line,
 
 static void gdb_sig_halted(struct connection *connection);
 
+/* PacketSize advertised to new connections */
+static int gdb_packet_size = GDB_BUFFER_SIZE;
+
 /* number of gdb connections, mainly to suppress gdb related debugging spam
  * in helper/log.c when no gdb connections are actually active */
 int gdb_actual_connections;
@@ -127,6 +164,9 @@ int gdb_actual_connections;
 static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
+/* concurrent connections read memory through the target memory cache,
+ * enabled by default */
+static int gdb_shared_mem_cache = 1;
 
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
@@ -357,11 +397,72 @@ static int gdb_write(struct connection *connection, void *data, int len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* a reply encoded while it is sent, see gdb_put_packet_data() */
+struct gdb_packet_data {
+	const char *prefix;
+	const uint8_t *data;
+	size_t len;
+	/* escaped binary as in qXfer replies, otherwise hex */
+	bool binary;
+};
+
+/**
+ * Sends "$", the encoded @a pd and "#" with the checksum. The encoding is
+ * done in pieces of a small local buffer, so a reply of any size is never
+ * assembled in memory.
+ */
+static int gdb_write_packet_data(struct connection *connection,
+		const struct gdb_packet_data *pd)
+{
+	char local_buffer[1024];
+	/* room for "#xx" and the null of snprintf() */
+	const size_t end = sizeof(local_buffer) - 4;
+	size_t prefix_len = strlen(pd->prefix);
+	unsigned char my_checksum = buf_checksum8(pd->prefix, prefix_len);
+	size_t n = 0;
+	int retval;
+
+	local_buffer[n++] = '$';
+	memcpy(local_buffer + n, pd->prefix, prefix_len);
+	n += prefix_len;
+
+	size_t i = 0;
+	while (i < pd->len) {
+		size_t start = n;
+
+		if (!pd->binary) {
+			size_t count = MIN(pd->len - i, (end - n) / 2);
+			n += hexify(local_buffer + n, pd->data + i, count, 2 * count + 1);
+			i += count;
+		} else {
+			for (; i < pd->len && n + 2 <= end; i++) {
+				uint8_t c = pd->data[i];
+				if (c == '#' || c == '$' || c == '}' || c == '*') {
+					local_buffer[n++] = '}';
+					local_buffer[n++] = c ^ 0x20;
+				} else {
+					local_buffer[n++] = c;
+				}
+			}
+		}
+		my_checksum += buf_checksum8(local_buffer + start, n - start);
+
+		if (i < pd->len) {
+			retval = gdb_write(connection, local_buffer, n);
+			if (retval != ERROR_OK)
+				return retval;
+			n = 0;
+		}
+	}
+
+	n += snprintf(local_buffer + n, sizeof(local_buffer) - n, "#%02x", my_checksum);
+	return gdb_write(connection, local_buffer, n);
+}
+
 static int gdb_put_packet_inner(struct connection *connection,
-		char *buffer, int len)
+		char *buffer, int len, const struct gdb_packet_data *pd)
 {
-	int i;
-	unsigned char my_checksum = 0;
+	unsigned char my_checksum = buf_checksum8(buffer, len);
 #ifdef _DEBUG_GDB_IO_
 	char *debug_buffer;
 #endif
@@ -369,9 +470,6 @@ static int gdb_put_packet_inner(struct connection *connection,
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
 
-	for (i = 0; i < len; i++)
-		my_checksum += buffer[i];
-
 #ifdef _DEBUG_GDB_IO_
 	/*
 	 * At this point we should have nothing in the input queue from GDB,
@@ -401,14 +499,22 @@ static int gdb_put_packet_inner(struct connection *connection,
 
 	while (1) {
 #ifdef _DEBUG_GDB_IO_
-		debug_buffer = strndup(buffer, len);
-		LOG_DEBUG("sending packet '$%s#%2.2x'", debug_buffer, my_checksum);
-		free(debug_buffer);
+		if (pd) {
+			LOG_DEBUG("sending packet '$%s<%zu bytes>'", pd->prefix, pd->len);
+		} else {
+			debug_buffer = strndup(buffer, len);
+			LOG_DEBUG("sending packet '$%s#%2.2x'", debug_buffer, my_checksum);
+			free(debug_buffer);
+		}
 #endif
 
 		char local_buffer[1024];
 		local_buffer[0] = '$';
-		if ((size_t)len + 4 <= sizeof(local_buffer)) {
+		if (pd) {
+			retval = gdb_write_packet_data(connection, pd);
+			if (retval != ERROR_OK)
+				return retval;
+		} else if ((size_t)len + 4 <= sizeof(local_buffer)) {
 			/* performance gain on smaller packets by only a single call to gdb_write() */
 			memcpy(local_buffer + 1, buffer, len++);
 			len += snprintf(local_buffer + len, sizeof(local_buffer) - len, "#%02x", my_checksum);
@@ -484,7 +590,54 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 {
 	struct gdb_connection *gdb_con = connection->priv;
 	gdb_con->busy = true;
-	int retval = gdb_put_packet_inner(connection, buffer, len);
+	int retval = gdb_put_packet_inner(connection, buffer, len, NULL);
+	gdb_con->busy = false;
+
+	/* we sent some data, reset timer for keep alive messages */
+	kept_alive();
+
+	return retval;
+}
+
+/**
+ * Sends an asynchronous notification, "%" instead of "$" and not
+ * acknowledged by GDB.
+ */
+static int gdb_put_notification(struct connection *connection, const char *buffer, int len)
+{
+	char header[2] = "%";
+	char trailer[4];
+
+	snprintf(trailer, sizeof(trailer), "#%02x", buf_checksum8(buffer, len));
+
+	int retval = gdb_write(connection, header, 1);
+	if (retval == ERROR_OK)
+		retval = gdb_write(connection, (void *)buffer, len);
+	if (retval == ERROR_OK)
+		retval = gdb_write(connection, trailer, 3);
+
+	kept_alive();
+	return retval;
+}
+
+/**
+ * Sends @a prefix followed by @a data, hex encoded or, with @a binary,
+ * escaped as binary data. The encoding is streamed to the connection,
+ * with a retransmission encoding @a data again.
+ */
+static int gdb_put_packet_data(struct connection *connection, const char *prefix,
+		const uint8_t *data, size_t len, bool binary)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct gdb_packet_data pd = {
+		.prefix = prefix,
+		.data = data,
+		.len = len,
+		.binary = binary,
+	};
+
+	gdb_con->busy = true;
+	int retval = gdb_put_packet_inner(connection, NULL, 0, &pd);
 	gdb_con->busy = false;
 
 	/* we sent some data, reset timer for keep alive messages */
@@ -724,6 +877,36 @@ static int gdb_output(struct command_context *context, const char *line)
 	return ERROR_OK;
 }
 
+/* the watchpoint part of a stop reply, empty if none was hit */
+static void gdb_stop_reason(struct target *ct, char *stop_reason, size_t size)
+{
+	stop_reason[0] = '\0';
+	if (ct->debug_reason == DBG_REASON_WATCHPOINT) {
+		enum watchpoint_rw hit_wp_type;
+		target_addr_t hit_wp_address;
+
+		if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) == ERROR_OK) {
+
+			switch (hit_wp_type) {
+				case WPT_WRITE:
+					snprintf(stop_reason, size,
+							"watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				case WPT_READ:
+					snprintf(stop_reason, size,
+							"rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				case WPT_ACCESS:
+					snprintf(stop_reason, size,
+							"awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
 static void gdb_signal_reply(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -751,31 +934,7 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 		} else
 			signal_var = gdb_last_signal(ct);
 
-		stop_reason[0] = '\0';
-		if (ct->debug_reason == DBG_REASON_WATCHPOINT) {
-			enum watchpoint_rw hit_wp_type;
-			target_addr_t hit_wp_address;
-
-			if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) == ERROR_OK) {
-
-				switch (hit_wp_type) {
-					case WPT_WRITE:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_READ:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_ACCESS:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					default:
-						break;
-				}
-			}
-		}
+		gdb_stop_reason(ct, stop_reason, sizeof(stop_reason));
 
 		current_thread[0] = '\0';
 		if (target->rtos != NULL)
@@ -905,11 +1064,336 @@ static void gdb_frontend_halted(struct target *target, struct connection *connec
 	}
 }
 
+/*
+ * Non-stop mode: the cores of an SMP group, the threads of the hwthread
+ * RTOS, are resumed, stepped and halted one by one. vCont is answered at
+ * once, a core halting later is reported by a %Stop notification and GDB
+ * fetches further pending stops with vStopped. A single core target
+ * without RTOS is one thread, which lets GDB read and write memory through
+ * the DAP while it runs, e.g. for live watch.
+ */
+
+/* thread id of a single core target in non-stop mode */
+#define GDB_NONSTOP_SINGLE_THREAD	1
+
+static struct gdb_nonstop_core *gdb_nonstop_find(struct gdb_connection *gdb_con,
+		struct target *target)
+{
+	for (int i = 0; i < gdb_con->num_cores; i++)
+		if (gdb_con->cores[i].target == target)
+			return &gdb_con->cores[i];
+	return NULL;
+}
+
+static void gdb_nonstop_set_mode(struct target *target, bool non_stop)
+{
+	struct target_list *head;
+
+	foreach_smp_target(head, target->head)
+		head->target->smp_nonstop = non_stop;
+}
+
+static int gdb_nonstop_enable(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+
+	if (!target->smp && !target->rtos) {
+		struct gdb_nonstop_core *core = calloc(1, sizeof(*core));
+		if (!core)
+			return ERROR_FAIL;
+		core->target = target;
+		core->thread_id = GDB_NONSTOP_SINGLE_THREAD;
+		core->running = target->state == TARGET_RUNNING;
+
+		free(gdb_con->cores);
+		gdb_con->cores = core;
+		gdb_con->num_cores = 1;
+		gdb_con->stop_reported = NULL;
+		gdb_con->non_stop = true;
+
+		LOG_INFO("GDB non-stop mode for %s", target_name(target));
+		return ERROR_OK;
+	}
+
+	if (!target->smp || !target->rtos || !target->rtos->gdb_target_for_threadid) {
+		LOG_ERROR("non-stop mode needs a single core target without RTOS, "
+				"or an SMP target with the hwthread RTOS");
+		return ERROR_FAIL;
+	}
+
+	rtos_update_threads(target);
+	struct rtos *rtos = target->rtos;
+	struct gdb_nonstop_core *cores = calloc(MAX(rtos->thread_count, 1), sizeof(*cores));
+	if (!cores)
+		return ERROR_FAIL;
+
+	int num_cores = 0;
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct target *ct = NULL;
+		int64_t thread_id = rtos->thread_details[i].threadid;
+		if (rtos->gdb_target_for_threadid(connection, thread_id, &ct) != ERROR_OK || !ct)
+			continue;
+		cores[num_cores].target = ct;
+		cores[num_cores].thread_id = thread_id;
+		cores[num_cores].running = ct->state == TARGET_RUNNING;
+		num_cores++;
+	}
+
+	free(gdb_con->cores);
+	gdb_con->cores = cores;
+	gdb_con->num_cores = num_cores;
+	gdb_con->stop_reported = NULL;
+	gdb_con->non_stop = true;
+	gdb_nonstop_set_mode(target, true);
+
+	LOG_INFO("GDB non-stop mode for %d cores of %s", num_cores, target_name(target));
+	return ERROR_OK;
+}
+
+static void gdb_nonstop_disable(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->non_stop)
+		gdb_nonstop_set_mode(get_target_from_connection(connection), false);
+
+	free(gdb_con->cores);
+	gdb_con->cores = NULL;
+	gdb_con->num_cores = 0;
+	gdb_con->stop_reported = NULL;
+	gdb_con->non_stop = false;
+}
+
+static int gdb_nonstop_stop_reply(struct gdb_nonstop_core *core, char *reply, size_t size)
+{
+	char stop_reason[20];
+	int signal_var = core->stop_requested ? 0 : gdb_last_signal(core->target);
+
+	gdb_stop_reason(core->target, stop_reason, sizeof(stop_reason));
+	return snprintf(reply, size, "T%2.2x%sthread:%" PRIx64 ";",
+			signal_var, stop_reason, core->thread_id);
+}
+
+/* a core has halted, report it unless a notification waits for vStopped */
+static void gdb_nonstop_halted(struct connection *connection, struct gdb_nonstop_core *core)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (!core->running)
+		return;
+	core->running = false;
+	core->stop_pending = true;
+
+	if (gdb_con->stop_reported)
+		return;
+
+	char reply[80] = "Stop:";
+	int len = 5 + gdb_nonstop_stop_reply(core, reply + 5, sizeof(reply) - 5);
+	gdb_con->stop_reported = core;
+	gdb_put_notification(connection, reply, len);
+}
+
+/* vStopped and '?': report the next pending stop, "OK" when none is left */
+static int gdb_nonstop_next_stop(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	char reply[80];
+
+	if (gdb_con->stop_reported) {
+		gdb_con->stop_reported->stop_pending = false;
+		gdb_con->stop_reported->stop_requested = false;
+		gdb_con->stop_reported = NULL;
+	}
+
+	for (int i = 0; i < gdb_con->num_cores; i++) {
+		struct gdb_nonstop_core *core = &gdb_con->cores[i];
+		if (!core->stop_pending)
+			continue;
+		gdb_con->stop_reported = core;
+		int len = gdb_nonstop_stop_reply(core, reply, sizeof(reply));
+		return gdb_put_packet(connection, reply, len);
+	}
+
+	return gdb_put_packet(connection, "OK", 2);
+}
+
+/* '?' in non-stop mode: all halted cores are reported again */
+static int gdb_nonstop_status(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	gdb_con->stop_reported = NULL;
+	for (int i = 0; i < gdb_con->num_cores; i++) {
+		struct gdb_nonstop_core *core = &gdb_con->cores[i];
+		core->running = core->target->state == TARGET_RUNNING;
+		core->stop_pending = !core->running;
+	}
+
+	return gdb_nonstop_next_stop(connection);
+}
+
+/**
+ * vCont in non-stop mode, @a parse at the first action. The leftmost
+ * action naming a core applies to it, one without thread-id to all others.
+ */
+static int gdb_nonstop_vcont(struct connection *connection, const char *parse)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	char *actions = calloc(MAX(gdb_con->num_cores, 1), 1);
+
+	if (!actions)
+		return gdb_put_packet(connection, "E01", 3);
+
+	while (*parse == ';') {
+		parse++;
+		char action = *parse++;
+		if (action == 'C' || action == 'S') {
+			/* the signal is not passed to the target */
+			strtoul(parse, (char **)&parse, 16);
+			action = tolower(action);
+		}
+		if (action != 'c' && action != 's' && action != 't') {
+			free(actions);
+			LOG_ERROR("Unknown vCont action '%c'", action);
+			return gdb_put_packet(connection, "E01", 3);
+		}
+
+		int64_t thread_id = -1;
+		if (*parse == ':') {
+			parse++;
+			thread_id = strtoll(parse, (char **)&parse, 16);
+		}
+
+		for (int i = 0; i < gdb_con->num_cores; i++)
+			if (!actions[i] && (thread_id <= 0 || thread_id == gdb_con->cores[i].thread_id))
+				actions[i] = action;
+	}
+
+	/* reply first, halts are reported by notifications */
+	int retval = gdb_put_packet(connection, "OK", 2);
+
+	for (int i = 0; i < gdb_con->num_cores && retval == ERROR_OK; i++) {
+		struct gdb_nonstop_core *core = &gdb_con->cores[i];
+		struct target *ct = core->target;
+		int ret;
+
+		switch (actions[i]) {
+		case 'c':
+			if (ct->state != TARGET_HALTED)
+				break;
+			LOG_DEBUG("non-stop continue %s", target_name(ct));
+			core->running = true;
+			core->stop_requested = false;
+			ret = target_resume(ct, 1, 0, 0, 0);
+			if (ret != ERROR_OK)
+				LOG_ERROR("failed to resume %s", target_name(ct));
+			break;
+		case 's':
+			if (ct->state != TARGET_HALTED)
+				break;
+			LOG_DEBUG("non-stop step %s", target_name(ct));
+			core->running = true;
+			core->stop_requested = false;
+			ret = target_step(ct, 1, 0, 0);
+			if (ret == ERROR_OK)
+				ret = target_poll(ct);
+			if (ret != ERROR_OK)
+				LOG_ERROR("failed to step %s", target_name(ct));
+			/* a step may end without a halted event */
+			if (ct->state == TARGET_HALTED)
+				gdb_nonstop_halted(connection, core);
+			break;
+		case 't':
+			if (!core->running)
+				break;
+			LOG_DEBUG("non-stop halt %s", target_name(ct));
+			core->stop_requested = true;
+			ret = target_halt(ct);
+			if (ret == ERROR_OK)
+				ret = target_poll(ct);
+			if (ret != ERROR_OK)
+				LOG_ERROR("failed to halt %s", target_name(ct));
+			if (ct->state == TARGET_HALTED)
+				gdb_nonstop_halted(connection, core);
+			break;
+		default:
+			break;
+		}
+	}
+
+	free(actions);
+	return retval;
+}
+
+/* the thread packets of a single core target in non-stop mode, which
+ * has no RTOS to answer them */
+static int gdb_nonstop_thread_packet(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	char buffer[20];
+
+	if (!gdb_con->non_stop || target->rtos)
+		return gdb_thread_packet(connection, packet, packet_size);
+
+	if (strncmp(packet, "qfThreadInfo", 12) == 0) {
+		snprintf(buffer, sizeof(buffer), "m%x", GDB_NONSTOP_SINGLE_THREAD);
+		return gdb_put_packet(connection, buffer, strlen(buffer));
+	} else if (strncmp(packet, "qsThreadInfo", 12) == 0) {
+		return gdb_put_packet(connection, "l", 1);
+	} else if (strncmp(packet, "qC", 2) == 0 && strncmp(packet, "qCRC:", 5) != 0) {
+		snprintf(buffer, sizeof(buffer), "QC%x", GDB_NONSTOP_SINGLE_THREAD);
+		return gdb_put_packet(connection, buffer, strlen(buffer));
+	} else if (packet[0] == 'T' || packet[0] == 'H') {
+		return gdb_put_packet(connection, "OK", 2);
+	}
+
+	return gdb_thread_packet(connection, packet, packet_size);
+}
+
+/*
+ * Memory is accessed through the selected core if it is halted, else any
+ * halted one. When all are running it is the running target, no halt is
+ * forced: a target with background access, e.g. through a MEM-AP, serves
+ * it without touching run control, others fail the access.
+ */
+static struct target *gdb_memory_target(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+
+	if (!gdb_con->non_stop)
+		return target;
+
+	struct target *ct = NULL;
+	struct rtos *rtos = target->rtos;
+	if (rtos && rtos->current_threadid > 0)
+		rtos->gdb_target_for_threadid(connection, rtos->current_threadid, &ct);
+	if (ct && ct->state == TARGET_HALTED)
+		return ct;
+
+	for (int i = 0; i < gdb_con->num_cores; i++)
+		if (gdb_con->cores[i].target->state == TARGET_HALTED)
+			return gdb_con->cores[i].target;
+
+	return target;
+}
+
 static int gdb_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
 {
 	struct connection *connection = priv;
 	struct gdb_service *gdb_service = connection->service->priv;
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->non_stop) {
+		struct gdb_nonstop_core *core = gdb_nonstop_find(gdb_con, target);
+		if (core && event == TARGET_EVENT_HALTED)
+			gdb_nonstop_halted(connection, core);
+		return ERROR_OK;
+	}
 
 	if (gdb_service->target != target)
 		return ERROR_OK;
@@ -928,13 +1412,42 @@ static int gdb_target_callback_event_handler(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Several connections to one target, e.g. an IDE and a scripting gdb,
+ * ask for the same memory after each halt. While more than one is
+ * attached they read through the memory cache of the target, which holds
+ * what was read during the current halt and is dropped on any target
+ * event. Registers are shared anyway through the register cache.
+ */
+static void gdb_update_mem_cache_sharing(struct gdb_service *gdb_service)
+{
+	bool share = gdb_shared_mem_cache && gdb_service->num_connections > 1;
+
+	if (share == gdb_service->mem_cache_shared)
+		return;
+
+	if (target_mem_cache_share(gdb_service->target, share) == ERROR_OK)
+		gdb_service->mem_cache_shared = share;
+}
+
 static int gdb_new_connection(struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = malloc(sizeof(struct gdb_connection));
+	struct gdb_service *gdb_service = connection->service->priv;
 	struct target *target;
 	int retval;
 	int initial_ack;
 
+	if (!gdb_connection)
+		return ERROR_FAIL;
+	gdb_connection->packet_size = gdb_packet_size;
+	gdb_connection->packet_buffer = malloc(gdb_packet_size + 1); /* Extra byte for null-termination */
+	if (!gdb_connection->packet_buffer) {
+		LOG_ERROR("Unable to allocate the GDB packet buffer");
+		free(gdb_connection);
+		return ERROR_FAIL;
+	}
+
 	target = get_target_from_connection(connection);
 	connection->priv = gdb_connection;
 	connection->cmd_ctx->current_target = target;
@@ -945,6 +1458,10 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->ctrl_c = false;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	gdb_connection->vflash_buffered = 0;
+	gdb_connection->vflash_written = 0;
+	gdb_connection->vflash_result = ERROR_OK;
+	gdb_connection->vflash_started = false;
 	gdb_connection->closed = false;
 	gdb_connection->busy = false;
 	gdb_connection->noack_mode = 0;
@@ -952,9 +1469,11 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
 	gdb_connection->extended_protocol = false;
-	gdb_connection->target_desc.tdesc = NULL;
-	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
+	gdb_connection->non_stop = false;
+	gdb_connection->cores = NULL;
+	gdb_connection->num_cores = 0;
+	gdb_connection->stop_reported = NULL;
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -975,6 +1494,7 @@ static int gdb_new_connection(struct connection *connection)
 			target->rtos->type->clean(target);
 
 		/* update threads */
+		target->rtos->threads_valid = false;
 		rtos_update_threads(target);
 	}
 
@@ -1036,6 +1556,9 @@ static int gdb_new_connection(struct connection *connection)
 	 * register callback to be informed about target events */
 	target_register_event_callback(gdb_target_callback_event_handler, connection);
 
+	gdb_service->num_connections++;
+	gdb_update_mem_cache_sharing(gdb_service);
+
 	return ERROR_OK;
 }
 
@@ -1043,6 +1566,7 @@ static int gdb_connection_closed(struct connection *connection)
 {
 	struct target *target;
 	struct gdb_connection *gdb_connection = connection->priv;
+	struct gdb_service *gdb_service = connection->service->priv;
 
 	target = get_target_from_connection(connection);
 
@@ -1063,10 +1587,17 @@ static int gdb_connection_closed(struct connection *connection)
 		free(gdb_connection->vflash_image);
 		gdb_connection->vflash_image = NULL;
 	}
+	/* a load was cut short after some chunks were programmed */
+	if (gdb_connection->vflash_started)
+		target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_WRITE_END);
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	gdb_nonstop_disable(connection);
+	gdb_service->num_connections--;
+	gdb_update_mem_cache_sharing(gdb_service);
+	free(gdb_connection->packet_buffer);
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1138,7 +1669,7 @@ static void gdb_str_to_target(struct target *target,
 
 	for (i = 0; i < buf_len; i++) {
 		int j = gdb_reg_pos(target, i, buf_len);
-		tstr += sprintf(tstr, "%02x", buf[j]);
+		tstr += hexify(tstr, &buf[j], 1, 3);
 	}
 }
 
@@ -1153,14 +1684,11 @@ static void gdb_target_to_reg(struct target *target,
 
 	int i;
 	for (i = 0; i < str_len; i += 2) {
-		unsigned t;
-		if (sscanf(tstr + i, "%02x", &t) != 1) {
+		int j = gdb_reg_pos(target, i/2, str_len/2);
+		if (unhexify(&bin[j], tstr + i, 1) != 1) {
 			LOG_ERROR("BUG: unable to convert register value");
 			exit(-1);
 		}
-
-		int j = gdb_reg_pos(target, i/2, str_len/2);
-		bin[j] = t;
 	}
 }
 
@@ -1202,6 +1730,11 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	/* fetch what we can in one go, the loop below reads the rest */
+	retval = target_read_registers_batch(target, reg_list, reg_list_size);
+	if (retval != ERROR_OK)
+		LOG_DEBUG("Couldn't batch read registers, reading one by one");
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (reg_list[i] == NULL || reg_list[i]->exist == false)
 			continue;
@@ -1430,13 +1963,13 @@ static int gdb_error(struct connection *connection, int retval)
 static int gdb_read_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
-	struct target *target = get_target_from_connection(connection);
+	struct target *target = gdb_memory_target(connection);
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
 
 	uint8_t *buffer;
-	char *hex_buffer;
+	bool binary = packet[0] == 'x';
 
 	int retval = ERROR_OK;
 
@@ -1453,6 +1986,11 @@ static int gdb_read_memory_packet(struct connection *connection,
 	len = strtoul(separator + 1, NULL, 16);
 
 	if (!len) {
+		if (binary) {
+			/* an empty binary read is valid */
+			gdb_put_packet(connection, "b", 1);
+			return ERROR_OK;
+		}
 		LOG_WARNING("invalid read memory packet received (len == 0)");
 		gdb_put_packet(connection, "", 0);
 		return ERROR_OK;
@@ -1462,7 +2000,10 @@ static int gdb_read_memory_packet(struct connection *connection,
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = target_read_buffer(target, addr, len, buffer);
+	/* code in flash is read again and again while stepping */
+	retval = flash_cache_read_memory(target, addr, len, buffer);
+	if (retval == ERROR_FLASH_DST_OUT_OF_BANK)
+		retval = target_read_buffer(target, addr, len, buffer);
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1482,15 +2023,10 @@ static int gdb_read_memory_packet(struct connection *connection,
 		retval = ERROR_OK;
 	}
 
-	if (retval == ERROR_OK) {
-		hex_buffer = malloc(len * 2 + 1);
-
-		size_t pkt_len = hexify(hex_buffer, buffer, len, len * 2 + 1);
-
-		gdb_put_packet(connection, hex_buffer, pkt_len);
-
-		free(hex_buffer);
-	} else
+	/* 'x' is answered with "b" and the binary data, 'm' in hex */
+	if (retval == ERROR_OK)
+		gdb_put_packet_data(connection, binary ? "b" : "", buffer, len, binary);
+	else
 		retval = gdb_error(connection, retval);
 
 	free(buffer);
@@ -1501,7 +2037,7 @@ static int gdb_read_memory_packet(struct connection *connection,
 static int gdb_write_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
-	struct target *target = get_target_from_connection(connection);
+	struct target *target = gdb_memory_target(connection);
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
@@ -1548,7 +2084,7 @@ static int gdb_write_memory_packet(struct connection *connection,
 static int gdb_write_memory_binary_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
-	struct target *target = get_target_from_connection(connection);
+	struct target *target = gdb_memory_target(connection);
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
@@ -1647,6 +2183,52 @@ static int gdb_step_continue_packet(struct connection *connection,
 	return retval;
 }
 
+/* parse the ";X len,expr..." conditions following a Z0/Z1 packet */
+static int gdb_parse_breakpoint_conditions(const char *p,
+		struct agent_expr **conds, unsigned int *num_conds)
+{
+	*conds = NULL;
+	*num_conds = 0;
+
+	if (*p != ';')
+		return ERROR_OK;
+	p++;
+
+	while (*p == 'X') {
+		char *end;
+		size_t len = strtoul(p + 1, &end, 16);
+		if (*end != ',' || !len || strnlen(end + 1, 2 * len) < 2 * len)
+			goto fail;
+		p = end + 1;
+
+		struct agent_expr *new_conds = realloc(*conds, (*num_conds + 1) * sizeof(**conds));
+		if (!new_conds)
+			goto fail;
+		*conds = new_conds;
+
+		struct agent_expr *cond = &new_conds[*num_conds];
+		cond->bytecode = malloc(len);
+		if (!cond->bytecode)
+			goto fail;
+		(*num_conds)++;
+		cond->len = unhexify(cond->bytecode, p, len);
+		if (cond->len != len)
+			goto fail;
+		p += 2 * len;
+	}
+
+	/* ";cmds:..." is not advertised, anything else is ignored */
+	return ERROR_OK;
+
+fail:
+	for (unsigned int i = 0; i < *num_conds; i++)
+		free((*conds)[i].bytecode);
+	free(*conds);
+	*conds = NULL;
+	*num_conds = 0;
+	return ERROR_FAIL;
+}
+
 static int gdb_breakpoint_watchpoint_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1699,7 +2281,27 @@ static int gdb_breakpoint_watchpoint_packet(struct connection *connection,
 		case 0:
 		case 1:
 			if (packet[0] == 'Z') {
-				retval = breakpoint_add(target, address, size, bp_type);
+				struct agent_expr *conds;
+				unsigned int num_conds;
+				if (gdb_parse_breakpoint_conditions(separator, &conds, &num_conds) != ERROR_OK) {
+					LOG_ERROR("invalid breakpoint condition received");
+					gdb_send_error(connection, EINVAL);
+					return ERROR_OK;
+				}
+
+				/* GDB sends a Z packet again for a breakpoint whose
+				 * conditions changed */
+				if (breakpoint_find(target, address))
+					retval = ERROR_OK;
+				else
+					retval = breakpoint_add(target, address, size, bp_type);
+				if (retval == ERROR_OK)
+					retval = breakpoint_set_conditions(target, address, conds, num_conds);
+
+				for (unsigned int i = 0; i < num_conds; i++)
+					free(conds[i].bytecode);
+				free(conds);
+
 				if (retval != ERROR_OK) {
 					retval = gdb_error(connection, retval);
 					if (retval != ERROR_OK)
@@ -2346,56 +2948,111 @@ error:
 	return retval;
 }
 
-static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
-		char **chunk, int32_t offset, uint32_t length)
+/* identifies the register list a target description is generated from */
+static int gdb_reg_list_signature(struct target *target, uint32_t *signature)
 {
-	if (target_desc == NULL) {
-		LOG_ERROR("Unable to Generate Target Description");
-		return ERROR_FAIL;
+	struct reg **reg_list;
+	int reg_list_size;
+
+	int retval = target_get_gdb_reg_list_noread(target, &reg_list,
+			&reg_list_size, REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* FNV-1a over what the description is made of */
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		uintptr_t words[] = {
+			(uintptr_t)reg, (uintptr_t)reg->name, (uintptr_t)reg->feature,
+			(uintptr_t)reg->reg_data_type, (uintptr_t)reg->group,
+			reg->number, reg->size, reg->exist, reg->caller_save,
+		};
+		const uint8_t *p = (const uint8_t *)words;
+		for (size_t j = 0; j < sizeof(words); j++)
+			hash = (hash ^ p[j]) * 16777619u;
 	}
+	hash = (hash ^ reg_list_size) * 16777619u;
 
-	char *tdesc = target_desc->tdesc;
-	uint32_t tdesc_length = target_desc->tdesc_length;
+	free(reg_list);
+	*signature = hash;
+	return ERROR_OK;
+}
 
-	if (tdesc == NULL) {
-		int retval = gdb_generate_target_description(target, &tdesc);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Unable to Generate Target Description");
+/**
+ * @returns the target description of @a target. It is generated once and
+ * then kept until the register list of the target changes, so reconnecting
+ * GDBs and the chunks of qXfer:features:read are served from memory.
+ */
+static int gdb_get_target_description(struct target *target,
+		const char **tdesc, uint32_t *tdesc_length)
+{
+	uint32_t signature;
+	int retval = gdb_reg_list_signature(target, &signature);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct gdb_tdesc_cache *cache;
+	for (cache = gdb_tdesc_cache; cache; cache = cache->next)
+		if (cache->target == target)
+			break;
+
+	if (cache && cache->tdesc && cache->signature == signature) {
+		*tdesc = cache->tdesc;
+		*tdesc_length = cache->tdesc_length;
+		return ERROR_OK;
+	}
+
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache) {
+			LOG_ERROR("Unable to allocate memory");
 			return ERROR_FAIL;
 		}
-
-		tdesc_length = strlen(tdesc);
+		cache->target = target;
+		cache->next = gdb_tdesc_cache;
+		gdb_tdesc_cache = cache;
 	}
 
-	char transfer_type;
+	free(cache->tdesc);
+	cache->tdesc = NULL;
 
-	if (length < (tdesc_length - offset))
-		transfer_type = 'm';
-	else
-		transfer_type = 'l';
+	char *xml;
+	retval = gdb_generate_target_description(target, &xml);
+	if (retval != ERROR_OK)
+		return retval;
 
-	*chunk = malloc(length + 2);
-	if (*chunk == NULL) {
-		LOG_ERROR("Unable to allocate memory");
+	LOG_DEBUG("generated target description of %s", target_name(target));
+	cache->tdesc = xml;
+	cache->tdesc_length = strlen(xml);
+	cache->signature = signature;
+
+	*tdesc = cache->tdesc;
+	*tdesc_length = cache->tdesc_length;
+	return ERROR_OK;
+}
+
+static int gdb_get_target_description_chunk(struct target *target, char *transfer_type,
+		const char **chunk, uint32_t *chunk_length, uint32_t offset, uint32_t length)
+{
+	const char *tdesc;
+	uint32_t tdesc_length;
+
+	int retval = gdb_get_target_description(target, &tdesc, &tdesc_length);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	(*chunk)[0] = transfer_type;
-	if (transfer_type == 'm') {
-		strncpy((*chunk) + 1, tdesc + offset, length);
-		(*chunk)[1 + length] = '\0';
+	offset = MIN(offset, tdesc_length);
+	if (length < (tdesc_length - offset)) {
+		*transfer_type = 'm';
+		*chunk_length = length;
 	} else {
-		strncpy((*chunk) + 1, tdesc + offset, tdesc_length - offset);
-		(*chunk)[1 + (tdesc_length - offset)] = '\0';
-
-		/* After gdb-server sends out last chunk, invalidate tdesc. */
-		free(tdesc);
-		tdesc = NULL;
-		tdesc_length = 0;
+		*transfer_type = 'l';
+		*chunk_length = tdesc_length - offset;
 	}
-
-	target_desc->tdesc = tdesc;
-	target_desc->tdesc_length = tdesc_length;
+	*chunk = tdesc + offset;
 
 	return ERROR_OK;
 }
@@ -2627,8 +3284,8 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
-			GDB_BUFFER_SIZE,
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+;binary-upload+;QNonStop+;ConditionalBreakpoints+",
+			gdb_connection->packet_size,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
 
@@ -2645,7 +3302,9 @@ static int gdb_query_packet(struct connection *connection,
 		   && (flash_get_bank_count() > 0))
 		return gdb_memory_map(connection, packet, packet_size);
 	else if (strncmp(packet, "qXfer:features:read:", 20) == 0) {
-		char *xml = NULL;
+		const char *xml;
+		uint32_t xml_length;
+		char transfer_type[2] = "";
 		int retval = ERROR_OK;
 
 		int offset;
@@ -2664,16 +3323,15 @@ static int gdb_query_packet(struct connection *connection,
 		 * there are *more* chunks to transfer. 'l' for it is the *last*
 		 * chunk of target description.
 		 */
-		retval = gdb_get_target_description_chunk(target, &gdb_connection->target_desc,
-				&xml, offset, length);
+		retval = gdb_get_target_description_chunk(target, &transfer_type[0],
+				&xml, &xml_length, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
 		}
 
-		gdb_put_packet(connection, xml, strlen(xml));
-
-		free(xml);
+		gdb_put_packet_data(connection, transfer_type, (const uint8_t *)xml,
+				xml_length, true);
 		return ERROR_OK;
 	} else if (strncmp(packet, "qXfer:threads:read:", 19) == 0) {
 		char *xml = NULL;
@@ -2702,7 +3360,10 @@ static int gdb_query_packet(struct connection *connection,
 			return retval;
 		}
 
-		gdb_put_packet(connection, xml, strlen(xml));
+		/* the first character is the transfer type, the rest binary data */
+		char transfer_type[2] = { xml[0], '\0' };
+		gdb_put_packet_data(connection, transfer_type, (uint8_t *)xml + 1,
+				strlen(xml + 1), true);
 
 		free(xml);
 		return ERROR_OK;
@@ -2710,6 +3371,17 @@ static int gdb_query_packet(struct connection *connection,
 		gdb_connection->noack_mode = 1;
 		gdb_put_packet(connection, "OK", 2);
 		return ERROR_OK;
+	} else if (strncmp(packet, "QNonStop:", 9) == 0) {
+		if (packet[9] == '1') {
+			if (gdb_nonstop_enable(connection) != ERROR_OK) {
+				gdb_send_error(connection, 01);
+				return ERROR_OK;
+			}
+		} else {
+			gdb_nonstop_disable(connection);
+		}
+		gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
 	}
 
 	gdb_put_packet(connection, "", 0);
@@ -2727,12 +3399,20 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 	if (parse[0] == '?') {
 		if (target->type->step != NULL) {
 			/* gdb doesn't accept c without C and s without S */
-			gdb_put_packet(connection, "vCont;c;C;s;S", 13);
+			if (gdb_connection->non_stop)
+				gdb_put_packet(connection, "vCont;c;C;s;S;t", 15);
+			else
+				gdb_put_packet(connection, "vCont;c;C;s;S", 13);
 			return true;
 		}
 		return false;
 	}
 
+	if (gdb_connection->non_stop) {
+		gdb_nonstop_vcont(connection, parse);
+		return true;
+	}
+
 	if (parse[0] == ';') {
 		++parse;
 		--packet_size;
@@ -2985,6 +3665,70 @@ static bool gdb_handle_vrun_packet(struct connection *connection, const char *pa
 	return true;
 }
 
+/* vFlashWrite data is programmed in chunks of at least this many bytes */
+#define GDB_VFLASH_CHUNK_SIZE (64 * 1024)
+
+/*
+ * Whether the data buffered in the vFlash image may be programmed before
+ * the data of a vFlashWrite at @a addr is added. GDB writes the flash in
+ * ascending order, so this is the case once the sector of @a addr starts
+ * past the buffered data: no later packet can share a sector with it, and
+ * no sector gets programmed twice.
+ */
+static bool gdb_vflash_chunk_done(struct connection *connection,
+		struct target *target, target_addr_t addr)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	struct image *image = gdb_connection->vflash_image;
+	struct flash_bank *bank;
+
+	if (!image || !image->num_sections ||
+			gdb_connection->vflash_buffered < GDB_VFLASH_CHUNK_SIZE)
+		return false;
+
+	struct imagesection *last = &image->sections[image->num_sections - 1];
+	target_addr_t end = last->base_address + last->size;
+
+	if (get_flash_bank_by_addr(target, addr, false, &bank) != ERROR_OK || !bank)
+		return false;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		target_addr_t start = bank->base + sector->offset;
+
+		if (addr >= start && addr - start < sector->size)
+			return start >= end;
+	}
+
+	return false;
+}
+
+/* Program the vFlash image built so far and start a new one. */
+static void gdb_vflash_flush(struct connection *connection, struct target *target)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+	uint32_t written = 0;
+
+	if (!gdb_connection->vflash_started) {
+		gdb_connection->vflash_started = true;
+		target_call_event_callbacks(target,
+				TARGET_EVENT_GDB_FLASH_WRITE_START);
+	}
+
+	if (gdb_connection->vflash_image) {
+		int result = flash_write(target, gdb_connection->vflash_image,
+				&written, false);
+		if (result != ERROR_OK && gdb_connection->vflash_result == ERROR_OK)
+			gdb_connection->vflash_result = result;
+		gdb_connection->vflash_written += written;
+
+		image_close(gdb_connection->vflash_image);
+		free(gdb_connection->vflash_image);
+		gdb_connection->vflash_image = NULL;
+	}
+	gdb_connection->vflash_buffered = 0;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -3006,6 +3750,14 @@ static int gdb_v_packet(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	if (strncmp(packet, "vStopped", 8) == 0) {
+		if (gdb_connection->non_stop)
+			gdb_nonstop_next_stop(connection);
+		else
+			gdb_put_packet(connection, "", 0);
+		return ERROR_OK;
+	}
+
 	if (strncmp(packet, "vRun", 4) == 0) {
 		bool handled;
 
@@ -3096,6 +3848,16 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
+		/* program the sectors GDB is done with while it keeps sending */
+		if (gdb_vflash_chunk_done(connection, target, addr))
+			gdb_vflash_flush(connection, target);
+
+		/* the error is reported at vFlashDone, stop buffering meanwhile */
+		if (gdb_connection->vflash_result != ERROR_OK) {
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
 		/* create a new image if there isn't already one */
 		if (gdb_connection->vflash_image == NULL) {
 			gdb_connection->vflash_image = malloc(sizeof(struct image));
@@ -3107,6 +3869,7 @@ static int gdb_v_packet(struct connection *connection,
 				addr, length, 0x0, (uint8_t const *)parse);
 		if (retval != ERROR_OK)
 			return retval;
+		gdb_connection->vflash_buffered += length;
 
 		gdb_put_packet(connection, "OK", 2);
 
@@ -3114,29 +3877,27 @@ static int gdb_v_packet(struct connection *connection,
 	}
 
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
-		uint32_t written;
-
-		/* process the flashing buffer. No need to erase as GDB
-		 * always issues a vFlashErase first. */
-		target_call_event_callbacks(target,
-				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(target, gdb_connection->vflash_image,
-			&written, false);
+		/* process the rest of the flashing buffer. No need to erase
+		 * as GDB always issues a vFlashErase first. */
+		gdb_vflash_flush(connection, target);
 		target_call_event_callbacks(target,
 			TARGET_EVENT_GDB_FLASH_WRITE_END);
+
+		result = gdb_connection->vflash_result;
 		if (result != ERROR_OK) {
 			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
 				gdb_put_packet(connection, "E.memtype", 9);
 			else
 				gdb_send_error(connection, EIO);
 		} else {
-			LOG_DEBUG("wrote %u bytes from vFlash image to flash", (unsigned)written);
+			LOG_DEBUG("wrote %u bytes from vFlash image to flash",
+					(unsigned)gdb_connection->vflash_written);
 			gdb_put_packet(connection, "OK", 2);
 		}
 
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
+		gdb_connection->vflash_written = 0;
+		gdb_connection->vflash_result = ERROR_OK;
+		gdb_connection->vflash_started = false;
 
 		return ERROR_OK;
 	}
@@ -3227,14 +3988,12 @@ static void gdb_sig_halted(struct connection *connection)
 
 static int gdb_input_inner(struct connection *connection)
 {
-	/* Do not allocate this on the stack */
-	static char gdb_packet_buffer[GDB_BUFFER_SIZE + 1]; /* Extra byte for null-termination */
-
+	struct gdb_connection *gdb_con = connection->priv;
+	char *gdb_packet_buffer = gdb_con->packet_buffer;
 	struct target *target;
 	char const *packet = gdb_packet_buffer;
 	int packet_size;
 	int retval;
-	struct gdb_connection *gdb_con = connection->priv;
 	static bool warn_use_ext;
 
 	target = get_target_from_connection(connection);
@@ -3251,7 +4010,7 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
-		packet_size = GDB_BUFFER_SIZE;
+		packet_size = gdb_con->packet_size;
 		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
 		if (retval != ERROR_OK)
 			return retval;
@@ -3272,19 +4031,20 @@ static int gdb_input_inner(struct connection *connection)
 				LOG_DEBUG("received packet: '%s'", packet);
 		}
 
+		int64_t perf = perf_start();
 		if (packet_size > 0) {
 			retval = ERROR_OK;
 			switch (packet[0]) {
 				case 'T':	/* Is thread alive? */
-					gdb_thread_packet(connection, packet, packet_size);
+					gdb_nonstop_thread_packet(connection, packet, packet_size);
 					break;
 				case 'H':	/* Set current thread ( 'c' for step and continue,
 							 * 'g' for all other operations ) */
-					gdb_thread_packet(connection, packet, packet_size);
+					gdb_nonstop_thread_packet(connection, packet, packet_size);
 					break;
 				case 'q':
 				case 'Q':
-					retval = gdb_thread_packet(connection, packet, packet_size);
+					retval = gdb_nonstop_thread_packet(connection, packet, packet_size);
 					if (retval == GDB_THREAD_PACKET_NOT_CONSUMED)
 						retval = gdb_query_packet(connection, packet, packet_size);
 					break;
@@ -3301,6 +4061,7 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_set_register_packet(connection, packet, packet_size);
 					break;
 				case 'm':
+				case 'x':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
 				case 'M':
@@ -3311,6 +4072,10 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_breakpoint_watchpoint_packet(connection, packet, packet_size);
 					break;
 				case '?':
+					if (gdb_con->non_stop) {
+						gdb_nonstop_status(connection);
+						break;
+					}
 					gdb_last_signal_packet(connection, packet, packet_size);
 					/* '?' is sent after the eventual '!' */
 					if (!warn_use_ext && !gdb_con->extended_protocol) {
@@ -3449,6 +4214,8 @@ static int gdb_input_inner(struct connection *connection)
 					break;
 			}
 
+			perf_end(PERF_GDB_PACKET, perf);
+
 			/* if a packet handler returned an error, exit input loop */
 			if (retval != ERROR_OK)
 				return retval;
@@ -3505,10 +4272,12 @@ static int gdb_target_start(struct target *target, const char *port)
 	gdb_service->target = target;
 	gdb_service->core[0] = -1;
 	gdb_service->core[1] = -1;
+	gdb_service->num_connections = 0;
+	gdb_service->mem_cache_shared = false;
 	target->gdb_service = gdb_service;
 
 	ret = add_service("gdb",
-			port, 1, &gdb_new_connection, &gdb_input,
+			port, target->gdb_max_connections, &gdb_new_connection, &gdb_input,
 			&gdb_connection_closed, gdb_service);
 	/* initialize all targets gdb service with the same pointer */
 	{
@@ -3624,6 +4393,26 @@ COMMAND_HANDLER(handle_gdb_port_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_gdb_packet_size_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int size;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size);
+		if (size < GDB_MIN_PACKET_SIZE || size > GDB_MAX_PACKET_SIZE) {
+			command_print(CMD, "packet size must be between %d and %d",
+					GDB_MIN_PACKET_SIZE, GDB_MAX_PACKET_SIZE);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		gdb_packet_size = size;
+	}
+
+	command_print(CMD, "%d", gdb_packet_size);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_memory_map_command)
 {
 	if (CMD_ARGC != 1)
@@ -3633,6 +4422,15 @@ COMMAND_HANDLER(handle_gdb_memory_map_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_shared_mem_cache_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_shared_mem_cache);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_flash_program_command)
 {
 	if (CMD_ARGC != 1)
@@ -3695,18 +4493,16 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
-	char *tdesc;
+	const char *tdesc;
 	uint32_t tdesc_length;
 	struct target *target = get_current_target(CMD_CTX);
 
-	int retval = gdb_generate_target_description(target, &tdesc);
+	int retval = gdb_get_target_description(target, &tdesc, &tdesc_length);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	tdesc_length = strlen(tdesc);
-
 	struct fileio *fileio;
 	size_t size_written;
 
@@ -3732,7 +4528,6 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 
 out:
 	free(tdesc_filename);
-	free(tdesc);
 
 	return retval;
 }
@@ -3760,6 +4555,14 @@ static const struct command_registration gdb_command_handlers[] = {
 			"Output pipe is the same name as input pipe, but with 'o' appended.",
 		.usage = "[port_num]",
 	},
+	{
+		.name = "gdb_packet_size",
+		.handler = handle_gdb_packet_size_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or set the PacketSize advertised to new GDB "
+			"connections, the largest packet GDB may send or request.",
+		.usage = "[size]",
+	},
 	{
 		.name = "gdb_memory_map",
 		.handler = handle_gdb_memory_map_command,
@@ -3767,6 +4570,14 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable memory map",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_shared_mem_cache",
+		.handler = handle_gdb_shared_mem_cache_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable sharing the memory cache of a target "
+			"between concurrent gdb connections",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_flash_program",
 		.handler = handle_gdb_flash_program_command,
@@ -3824,4 +4635,11 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+
+	while (gdb_tdesc_cache) {
+		struct gdb_tdesc_cache *next = gdb_tdesc_cache->next;
+		free(gdb_tdesc_cache->tdesc);
+		free(gdb_tdesc_cache);
+		gdb_tdesc_cache = next;
+	}
 }
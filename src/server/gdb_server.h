@@ -33,6 +33,9 @@ struct reg;
 #include <target/target.h>
 
 #define GDB_BUFFER_SIZE 16384
+/* limits of the PacketSize set by gdb_packet_size */
+#define GDB_MIN_PACKET_SIZE 2048
+#define GDB_MAX_PACKET_SIZE 0x400000
 
 int gdb_target_add_all(struct target *target);
 int gdb_register_commands(struct command_context *command_context);
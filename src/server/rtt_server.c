@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Every "rtt server" listens on its own port for one RTT channel: the
+ * data of the up channel goes to all its connections, what they send is
+ * written to the down channel with the same number.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "server.h"
+#include "rtt_server.h"
+#include <target/rtt.h>
+
+#define RTT_SERVER_BUFFER_SIZE	1024
+
+struct rtt_service {
+	unsigned int channel;
+};
+
+static int rtt_server_sink(unsigned int channel, const uint8_t *data,
+		size_t len, void *priv)
+{
+	struct connection *connection = priv;
+
+	/* a failed write closes the connection on its next input */
+	connection_write(connection, data, len);
+	return ERROR_OK;
+}
+
+static int rtt_new_connection(struct connection *connection)
+{
+	struct rtt_service *service = connection->service->priv;
+
+	LOG_DEBUG("rtt: new connection for channel %u", service->channel);
+	return rtt_register_sink(service->channel, rtt_server_sink, connection);
+}
+
+static int rtt_connection_closed(struct connection *connection)
+{
+	struct rtt_service *service = connection->service->priv;
+
+	LOG_DEBUG("rtt: connection for channel %u closed", service->channel);
+	return rtt_unregister_sink(service->channel, rtt_server_sink, connection);
+}
+
+static int rtt_input(struct connection *connection)
+{
+	struct rtt_service *service = connection->service->priv;
+	uint8_t buffer[RTT_SERVER_BUFFER_SIZE];
+
+	int bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	else if (bytes_read < 0) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	size_t len = bytes_read;
+	rtt_write_channel(service->channel, buffer, &len);
+	if (len < (size_t)bytes_read)
+		LOG_WARNING("rtt: down channel %u is full, %zu bytes dropped",
+				service->channel, bytes_read - len);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_server_start_command)
+{
+	struct rtt_service *service;
+	unsigned int channel;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], channel);
+
+	service = malloc(sizeof(*service));
+	if (!service) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	service->channel = channel;
+
+	int retval = add_service("rtt", CMD_ARGV[0], CONNECTION_LIMIT_UNLIMITED,
+			rtt_new_connection, rtt_input, rtt_connection_closed, service);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "failed to start the RTT server on port %s",
+				CMD_ARGV[0]);
+		free(service);
+	}
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_rtt_server_stop_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return remove_service("rtt", CMD_ARGV[0]);
+}
+
+const struct command_registration rtt_server_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_rtt_server_start_command,
+		.mode = COMMAND_ANY,
+		.help = "serve an RTT channel on a TCP port",
+		.usage = "port channel",
+	},
+	{
+		.name = "stop",
+		.handler = handle_rtt_server_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "stop the RTT server on a TCP port",
+		.usage = "port",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * TCP servers for RTT channels, see "rtt server".
+ */
+
+#ifndef OPENOCD_SERVER_RTT_SERVER_H
+#define OPENOCD_SERVER_RTT_SERVER_H
+
+#include <helper/command.h>
+
+extern const struct command_registration rtt_server_command_handlers[];
+
+#endif /* OPENOCD_SERVER_RTT_SERVER_H */
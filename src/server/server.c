@@ -44,6 +44,14 @@
 #include <netinet/tcp.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#define SERVER_EVENTS_EPOLL
+#elif defined(HAVE_SYS_EVENT_H)
+#include <sys/event.h>
+#define SERVER_EVENTS_KQUEUE
+#endif
+
 static struct service *services;
 
 enum shutdown_reason {
@@ -63,6 +71,194 @@ static int polling_period = 100;
 /* address by name on which to listen for incoming TCP/IP connections */
 static char *bindto_name;
 
+/*
+ * Waiting for activity on the service and connection fds. With epoll or
+ * kqueue an fd is registered once and the kernel returns only the ready
+ * ones; select() is used on Windows, and as fallback, e.g. for an stdin
+ * which can't be watched by epoll.
+ */
+
+/* the fds passed to select() */
+static fd_set events_read_fds;
+static int events_fd_max;
+
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+#define SERVER_EVENTS_MAX	64
+
+/* epoll or kqueue fd, -1 when select() is used */
+static int events_fd = -1;
+/* per fd number, true when registered with events_fd */
+static bool *events_registered;
+static int events_registered_size;
+/* the fds found ready by the last server_events_wait() */
+static int events_ready[SERVER_EVENTS_MAX];
+static int events_num_ready;
+
+static void server_events_fallback(int fd)
+{
+	LOG_DEBUG("fd %d can't be watched (%s), using select()", fd, strerror(errno));
+	close(events_fd);
+	events_fd = -1;
+}
+#endif
+
+static void server_events_init(void)
+{
+#if defined(SERVER_EVENTS_EPOLL)
+	events_fd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(SERVER_EVENTS_KQUEUE)
+	events_fd = kqueue();
+#endif
+}
+
+static void server_events_quit(void)
+{
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	if (events_fd != -1)
+		close(events_fd);
+	events_fd = -1;
+	free(events_registered);
+	events_registered = NULL;
+	events_registered_size = 0;
+#endif
+}
+
+/* start of a round of server_events_watch() calls */
+static void server_events_begin(void)
+{
+	FD_ZERO(&events_read_fds);
+	events_fd_max = 0;
+}
+
+/* @a fd is waited for in the next server_events_wait() */
+static void server_events_watch(int fd)
+{
+	/* select() is always prepared, in case epoll or kqueue fail */
+#ifndef _WIN32
+	if (fd < FD_SETSIZE)
+#endif
+		FD_SET(fd, &events_read_fds);
+	if (fd > events_fd_max)
+		events_fd_max = fd;
+
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	if (events_fd == -1)
+		return;
+
+	if (fd >= events_registered_size) {
+		int size = MAX(fd + 1, 2 * events_registered_size);
+		bool *registered = realloc(events_registered, size * sizeof(*registered));
+		if (!registered) {
+			server_events_fallback(fd);
+			return;
+		}
+		memset(registered + events_registered_size, 0,
+				(size - events_registered_size) * sizeof(*registered));
+		events_registered = registered;
+		events_registered_size = size;
+	}
+	if (events_registered[fd])
+		return;
+
+#if defined(SERVER_EVENTS_EPOLL)
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+	if (epoll_ctl(events_fd, EPOLL_CTL_ADD, fd, &ev) != 0 && errno != EEXIST) {
+		server_events_fallback(fd);
+		return;
+	}
+#else
+	struct kevent ev;
+	EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+	if (kevent(events_fd, &ev, 1, NULL, 0, NULL) != 0) {
+		server_events_fallback(fd);
+		return;
+	}
+#endif
+	events_registered[fd] = true;
+#endif
+}
+
+/* @a fd is about to be closed, or is no longer watched */
+static void server_events_forget(int fd)
+{
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	if (fd < 0 || fd >= events_registered_size || !events_registered[fd])
+		return;
+	events_registered[fd] = false;
+
+	if (events_fd == -1)
+		return;
+#if defined(SERVER_EVENTS_EPOLL)
+	epoll_ctl(events_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+	struct kevent ev;
+	EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	kevent(events_fd, &ev, 1, NULL, 0, NULL);
+#endif
+	for (int i = 0; i < events_num_ready; i++)
+		if (events_ready[i] == fd)
+			events_ready[i] = -1;
+#else
+	(void)fd;
+#endif
+}
+
+/* @returns the number of ready fds, 0 on timeout, -1 on error as select() */
+static int server_events_wait(int timeout_ms)
+{
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	events_num_ready = 0;
+	if (events_fd != -1) {
+		int n;
+#if defined(SERVER_EVENTS_EPOLL)
+		struct epoll_event events[SERVER_EVENTS_MAX];
+		n = epoll_wait(events_fd, events, SERVER_EVENTS_MAX, timeout_ms);
+		for (int i = 0; i < n; i++)
+			events_ready[i] = events[i].data.fd;
+#else
+		struct kevent events[SERVER_EVENTS_MAX];
+		struct timespec ts = {
+			.tv_sec = timeout_ms / 1000,
+			.tv_nsec = (timeout_ms % 1000) * 1000000,
+		};
+		n = kevent(events_fd, NULL, 0, events, SERVER_EVENTS_MAX, &ts);
+		for (int i = 0; i < n; i++)
+			events_ready[i] = events[i].ident;
+#endif
+		if (n > 0)
+			events_num_ready = n;
+		return n;
+	}
+#endif
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	return socket_select(events_fd_max + 1, &events_read_fds, NULL, NULL, &tv);
+}
+
+/* nothing is ready, after an interrupted or timed out wait */
+static void server_events_clear(void)
+{
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	events_num_ready = 0;
+#endif
+	FD_ZERO(&events_read_fds);
+}
+
+static bool server_events_ready(int fd)
+{
+#if defined(SERVER_EVENTS_EPOLL) || defined(SERVER_EVENTS_KQUEUE)
+	if (events_fd != -1) {
+		for (int i = 0; i < events_num_ready; i++)
+			if (events_ready[i] == fd)
+				return true;
+		return false;
+	}
+#endif
+	return FD_ISSET(fd, &events_read_fds);
+}
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -171,9 +367,10 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
-			if (service->type == CONNECTION_TCP)
+			if (service->type == CONNECTION_TCP) {
+				server_events_forget(c->fd);
 				close_socket(c->fd);
-			else if (service->type == CONNECTION_PIPE) {
+			} else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
 			}
@@ -226,6 +423,7 @@ int add_service(char *name,
 	c->new_connection = new_connection_handler;
 	c->input = input_handler;
 	c->connection_closed = connection_closed_handler;
+	c->flush = NULL;
 	c->priv = priv;
 	c->next = NULL;
 	long portnumber;
@@ -364,6 +562,18 @@ static void remove_connections(struct service *service)
 	}
 }
 
+int service_set_flush_handler(const char *name, connection_flush_handler_t flush_handler)
+{
+	for (struct service *s = services; s; s = s->next) {
+		if (!strcmp(s->name, name)) {
+			s->flush = flush_handler;
+			return ERROR_OK;
+		}
+	}
+
+	return ERROR_FAIL;
+}
+
 int remove_service(const char *name, const char *port)
 {
 	struct service *tmp;
@@ -380,8 +590,10 @@ int remove_service(const char *name, const char *port)
 			else
 				prev->next = tmp->next;
 
-			if (tmp->type != CONNECTION_STDINOUT)
+			if (tmp->type != CONNECTION_STDINOUT) {
+				server_events_forget(tmp->fd);
 				close_socket(tmp->fd);
+			}
 
 			free(tmp->priv);
 			free_service(tmp);
@@ -406,8 +618,10 @@ static int remove_services(void)
 		free(c->name);
 
 		if (c->type == CONNECTION_PIPE) {
-			if (c->fd != -1)
+			if (c->fd != -1) {
+				server_events_forget(c->fd);
 				close(c->fd);
+			}
 		}
 		free(c->port);
 		free(c->priv);
@@ -429,10 +643,6 @@ int server_loop(struct command_context *command_context)
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -443,17 +653,13 @@ int server_loop(struct command_context *command_context)
 
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
 		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
+		server_events_begin();
 
-		/* add service and connection fds to read_fds */
+		/* watch service and connection fds */
 		for (service = services; service; service = service->next) {
 			if (service->fd != -1) {
 				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
+				server_events_watch(service->fd);
 			}
 
 			if (service->connections) {
@@ -461,27 +667,23 @@ int server_loop(struct command_context *command_context)
 
 				for (c = service->connections; c; c = c->next) {
 					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
+					server_events_watch(c->fd);
 				}
 			}
 		}
 
-		struct timeval tv;
-		tv.tv_sec = 0;
 		if (poll_ok) {
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_events_wait(0);
 		} else {
-			/* Every 100ms, can be changed with "poll_period" command */
-			tv.tv_usec = polling_period * 1000;
+			/* Every 100ms, can be changed with "poll_period" command,
+			 * or earlier when a timer callback is due */
+			int64_t next_ms = MIN((int64_t)polling_period, target_timer_next_event());
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_events_wait(next_ms);
 			openocd_sleep_postlude();
 		}
 
@@ -491,7 +693,7 @@ int server_loop(struct command_context *command_context)
 			errno = WSAGetLastError();
 
 			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
+				server_events_clear();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -499,7 +701,7 @@ int server_loop(struct command_context *command_context)
 #else
 
 			if (errno == EINTR)
-				FD_ZERO(&read_fds);
+				server_events_clear();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -513,7 +715,7 @@ int server_loop(struct command_context *command_context)
 			target_call_timer_callbacks();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+			server_events_clear();	/* eCos leaves read_fds unchanged in this case!  */
 
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
@@ -528,12 +730,12 @@ int server_loop(struct command_context *command_context)
 		 *
 		 * This greatly improves performance of DCC.
 		 */
-		poll_ok = poll_ok || target_got_message();
+		poll_ok = poll_ok || target_got_message() || target_timer_callbacks_poll_requested();
 
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
 			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
+				&& server_events_ready(service->fd)) {
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -557,7 +759,7 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if ((c->fd >= 0 && server_events_ready(c->fd)) || c->input_pending) {
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -579,6 +781,24 @@ int server_loop(struct command_context *command_context)
 			}
 		}
 
+		/* write out what the connections have buffered in this iteration */
+		for (service = services; service; service = service->next) {
+			if (!service->flush)
+				continue;
+
+			for (struct connection *c = service->connections; c; ) {
+				struct connection *next = c->next;
+				if (service->flush(c) != ERROR_OK) {
+					if (service->type == CONNECTION_PIPE ||
+							service->type == CONNECTION_STDINOUT)
+						shutdown_openocd = SHUTDOWN_REQUESTED;
+					remove_connection(service, c);
+					LOG_INFO("dropped '%s' connection", service->name);
+				}
+				c = next;
+			}
+		}
+
 #ifdef _WIN32
 		MSG msg;
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
@@ -676,6 +896,8 @@ int server_preinit(void)
 
 int server_init(struct command_context *cmd_ctx)
 {
+	server_events_init();
+
 	int ret = tcl_init();
 
 	if (ret != ERROR_OK)
@@ -694,6 +916,7 @@ int server_init(struct command_context *cmd_ctx)
 int server_quit(void)
 {
 	remove_services();
+	server_events_quit();
 	target_quit();
 
 #ifdef _WIN32
@@ -57,6 +57,7 @@ struct connection {
 typedef int (*new_connection_handler_t)(struct connection *connection);
 typedef int (*input_handler_t)(struct connection *connection);
 typedef int (*connection_closed_handler_t)(struct connection *connection);
+typedef int (*connection_flush_handler_t)(struct connection *connection);
 
 struct service {
 	char *name;
@@ -70,6 +71,7 @@ struct service {
 	new_connection_handler_t new_connection;
 	input_handler_t input;
 	connection_closed_handler_t connection_closed;
+	connection_flush_handler_t flush;
 	void *priv;
 	struct service *next;
 };
@@ -80,6 +82,14 @@ int add_service(char *name, const char *port,
 		void *priv);
 int remove_service(const char *name, const char *port);
 
+/**
+ * Let the server loop call @a flush_handler for each connection of the
+ * service @a name, once per iteration after the input has been handled.
+ * An error returned by the handler drops the connection like one returned
+ * by the input handler.
+ */
+int service_set_flush_handler(const char *name, connection_flush_handler_t flush_handler);
+
 int server_host_os_entry(void);
 int server_host_os_close(void);
 
@@ -22,11 +22,48 @@
 
 #include "tcl_server.h"
 #include <target/target.h>
+#include <target/register.h>
+#include <target/target_sample.h>
 #include <helper/binarybuffer.h>
+#include <helper/bits.h>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
+#define TCL_OUT_INITIAL			(4*1024)
+/* responses are written out at once when this much output is pending */
+#define TCL_OUT_FLUSH			(64*1024)
+/* notifications and trace data are dropped while this much is pending */
+#define TCL_OUT_MAX				(1024*1024)
+
+/*
+ * Binary mode, entered with "tcl_binary". All fields are little endian:
+ *  request: opcode(1) size(1) flags(2) length(4) address(8) payload(length)
+ *  reply:   opcode(1) reserved(3) status(4) length(4) payload(length)
+ * The status is an ERROR_ code, the payload is only sent on success.
+ */
+#define TCL_BIN_REQ_HDR			16
+#define TCL_BIN_REPLY_HDR		12
+
+#define TCL_BIN_READ_MEM		0x01	/* read length bytes of size sized words */
+#define TCL_BIN_WRITE_MEM		0x02	/* write the payload as size sized words */
+#define TCL_BIN_READ_REG		0x03	/* payload: register name */
+#define TCL_BIN_WRITE_REG		0x04	/* payload: register name, NUL, value */
+#define TCL_BIN_HALT			0x05
+#define TCL_BIN_RESUME			0x06
+#define TCL_BIN_STEP			0x07
+#define TCL_BIN_STATE			0x08	/* reply: one byte enum target_state */
+#define TCL_BIN_TEXT			0x7f	/* back to Tcl command lines */
+
+/* resume or step at address instead of the current pc */
+#define TCL_BIN_FLAG_ADDRESS	BIT(0)
 
 struct tcl_connection {
 	int tc_linedrop;
@@ -34,9 +71,16 @@ struct tcl_connection {
 	int tc_line_size;
 	char *tc_line;
 	int tc_outerror;/* flag an output error */
+	/* output buffered until the end of the server loop iteration */
+	char *tc_out;
+	size_t tc_out_len;
+	size_t tc_out_size;
+	unsigned int tc_dropped;	/* notifications dropped for a slow client */
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_samples;
+	bool tc_binary;	/* binary mode requests instead of command lines */
 };
 
 static char *tcl_port;
@@ -46,6 +90,9 @@ static int tcl_new_connection(struct connection *connection);
 static int tcl_input(struct connection *connection);
 static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
 static int tcl_closed(struct connection *connection);
+static int tcl_flush(struct connection *connection);
+static int tcl_notify(struct connection *connection, const void *buf, size_t len);
+static char *tcl_notify_reserve(struct connection *connection, size_t len);
 
 static int tcl_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
@@ -56,16 +103,20 @@ static int tcl_target_callback_event_handler(struct target *target,
 
 	tclc = connection->priv;
 
+	/* text notifications would break the binary framing */
+	if (tclc->tc_binary)
+		return ERROR_OK;
+
 	if (tclc->tc_notify) {
 		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_notify(connection, buf, strlen(buf));
 	}
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
 		if (tclc->tc_notify) {
 			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
+			tcl_notify(connection, buf, strlen(buf));
 		}
 	}
 
@@ -81,62 +132,230 @@ static int tcl_target_callback_reset_handler(struct target *target,
 
 	tclc = connection->priv;
 
-	if (tclc->tc_notify) {
+	if (tclc->tc_notify && !tclc->tc_binary) {
 		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_notify(connection, buf, strlen(buf));
 	}
 
 	return ERROR_OK;
 }
 
+/* queue a notification of @a header followed by @a data in hex */
+static void tcl_notify_hex(struct connection *connection, const char *header,
+		const uint8_t *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+	const char *trailer = "\r\n\x1a";
+	size_t hex_len = len * 2 + 1;
+	size_t max_len = hex_len + strlen(header) + strlen(trailer);
+	char *buf;
+
+	/* format right into the output buffer */
+	buf = tcl_notify_reserve(connection, max_len);
+	if (buf == NULL)
+		return;
+	strcpy(buf, header);
+	hexify(buf + strlen(header), data, len, hex_len);
+	strcpy(buf + strlen(header) + len * 2, trailer);
+	tclc->tc_out_len += max_len - 1;
+}
+
 static int tcl_target_callback_trace_handler(struct target *target,
 		size_t len, uint8_t *data, void *priv)
 {
 	struct connection *connection = priv;
-	struct tcl_connection *tclc;
-	char *header = "type target_trace data ";
-	char *trailer = "\r\n\x1a";
-	size_t hex_len = len * 2 + 1;
-	size_t max_len = hex_len + strlen(header) + strlen(trailer);
-	char *buf, *hex;
+	struct tcl_connection *tclc = connection->priv;
 
-	tclc = connection->priv;
+	if (tclc->tc_trace && !tclc->tc_binary)
+		tcl_notify_hex(connection, "type target_trace data ", data, len);
+
+	return ERROR_OK;
+}
+
+static int tcl_target_callback_sample_handler(struct target *target,
+		const uint8_t *record, size_t len, void *priv)
+{
+	struct connection *connection = priv;
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_samples && !tclc->tc_binary)
+		tcl_notify_hex(connection, "type target_sample data ", record, len);
+
+	return ERROR_OK;
+}
+
+/* make room for @a len more bytes in the output buffer */
+static char *tcl_out_reserve(struct tcl_connection *tclc, size_t len)
+{
+	size_t need = tclc->tc_out_len + len;
+
+	if (need > tclc->tc_out_size) {
+		size_t size = MAX(tclc->tc_out_size ? 2 * tclc->tc_out_size : TCL_OUT_INITIAL, need);
+		char *out = realloc(tclc->tc_out, size);
+		if (out == NULL)
+			return NULL;
+		tclc->tc_out = out;
+		tclc->tc_out_size = size;
+	}
+
+	return tclc->tc_out + tclc->tc_out_len;
+}
+
+/* one write of the buffered output from @a offset followed by @a len bytes
+ * of @a data; with @a nonblock it fails with EAGAIN instead of waiting */
+static ssize_t tcl_write_once(struct connection *connection, size_t offset,
+		const void *data, size_t len, bool nonblock)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+#ifdef HAVE_SYS_UIO_H
+	struct iovec iov[2];
+	int iovcnt = 0;
+
+	if (offset < tclc->tc_out_len) {
+		iov[iovcnt].iov_base = tclc->tc_out + offset;
+		iov[iovcnt].iov_len = tclc->tc_out_len - offset;
+		iovcnt++;
+	}
+	if (len) {
+		iov[iovcnt].iov_base = (void *)data;
+		iov[iovcnt].iov_len = len;
+		iovcnt++;
+	}
+
+#ifdef MSG_DONTWAIT
+	if (nonblock) {
+		struct msghdr msg = {
+			.msg_iov = iov,
+			.msg_iovlen = iovcnt,
+		};
+		return sendmsg(connection->fd_out, &msg, MSG_DONTWAIT);
+	}
+#endif
+	return writev(connection->fd_out, iov, iovcnt);
+#else
+	if (offset < tclc->tc_out_len)
+		return connection_write(connection, tclc->tc_out + offset, tclc->tc_out_len - offset);
+	return connection_write(connection, data, len);
+#endif
+}
+
+/* write out the buffered output followed by @a len bytes of @a data, all
+ * of it or, with @a nonblock, what the socket takes without waiting */
+static int tcl_write_out(struct connection *connection, const void *data, size_t len, bool nonblock)
+{
+	struct tcl_connection *tclc = connection->priv;
+	size_t done = 0;
+	size_t total = tclc->tc_out_len + len;
+
+	/* pipes are always written blocking */
+	if (connection->service->type != CONNECTION_TCP)
+		nonblock = false;
+
+	while (done < total) {
+		size_t data_done = done > tclc->tc_out_len ? done - tclc->tc_out_len : 0;
+		ssize_t wlen = tcl_write_once(connection, done,
+				(const char *)data + data_done, len - data_done, nonblock);
+		if (wlen > 0) {
+			done += wlen;
+			continue;
+		}
+		if (wlen < 0 && errno == EINTR)
+			continue;
+		if (wlen < 0 && nonblock && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		LOG_ERROR("error during write: %s", wlen < 0 ? strerror(errno) : "connection closed");
+		tclc->tc_outerror = 1;
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
 
-	if (tclc->tc_trace) {
-		hex = malloc(hex_len);
-		buf = malloc(max_len);
-		hexify(hex, data, len, hex_len);
-		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
-		free(hex);
-		free(buf);
+	/* keep what the socket did not take, @a data is only passed blocking */
+	if (done < tclc->tc_out_len) {
+		memmove(tclc->tc_out, tclc->tc_out + done, tclc->tc_out_len - done);
+		tclc->tc_out_len -= done;
+	} else {
+		tclc->tc_out_len = 0;
 	}
 
 	return ERROR_OK;
 }
 
-/* write data out to a socket.
- *
- * this is a blocking write, so the return value must equal the length, if
- * that is not the case then flag the connection with an output error.
- */
+/* queue a response for the client. It is written out at the end of the
+ * server loop iteration, or at once when much output is pending. */
 int tcl_output(struct connection *connection, const void *data, ssize_t len)
 {
-	ssize_t wlen;
 	struct tcl_connection *tclc;
+	char *out;
 
 	tclc = connection->priv;
 	if (tclc->tc_outerror)
 		return ERROR_SERVER_REMOTE_CLOSED;
 
-	wlen = connection_write(connection, data, len);
+	if (tclc->tc_out_len + len <= TCL_OUT_FLUSH) {
+		out = tcl_out_reserve(tclc, len);
+		if (out != NULL) {
+			memcpy(out, data, len);
+			tclc->tc_out_len += len;
+			return ERROR_OK;
+		}
+	}
+
+	return tcl_write_out(connection, data, len, false);
+}
 
-	if (wlen == len)
+/* @returns room for a notification of @a len bytes, or NULL when it has to
+ * be dropped because the client does not keep up with the output */
+static char *tcl_notify_reserve(struct connection *connection, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+	char *out = NULL;
+
+	if (tclc->tc_outerror)
+		return NULL;
+
+	if (tclc->tc_out_len + len <= TCL_OUT_MAX)
+		out = tcl_out_reserve(tclc, len);
+	if (out == NULL)
+		tclc->tc_dropped++;
+
+	return out;
+}
+
+/* queue a notification, never waiting for the client */
+static int tcl_notify(struct connection *connection, const void *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+	char *out = tcl_notify_reserve(connection, len);
+
+	if (out == NULL)
 		return ERROR_OK;
 
-	LOG_ERROR("error during write: %d != %d", (int)wlen, (int)len);
-	tclc->tc_outerror = 1;
-	return ERROR_SERVER_REMOTE_CLOSED;
+	memcpy(out, data, len);
+	tclc->tc_out_len += len;
+	return ERROR_OK;
+}
+
+/* called by the server loop once per iteration */
+static int tcl_flush(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+	int retval;
+
+	if (tclc == NULL || tclc->tc_out_len == 0)
+		return ERROR_OK;
+
+	retval = tcl_write_out(connection, NULL, 0, true);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (tclc->tc_out_len == 0 && tclc->tc_dropped) {
+		LOG_WARNING("tcl client reads too slowly, %u notifications dropped",
+				tclc->tc_dropped);
+		tclc->tc_dropped = 0;
+	}
+
+	return ERROR_OK;
 }
 
 /* connections */
@@ -167,36 +386,27 @@ static int tcl_new_connection(struct connection *connection)
 	target_register_event_callback(tcl_target_callback_event_handler, connection);
 	target_register_reset_callback(tcl_target_callback_reset_handler, connection);
 	target_register_trace_callback(tcl_target_callback_trace_handler, connection);
+	target_register_sample_callback(tcl_target_callback_sample_handler, connection);
 
 	return ERROR_OK;
 }
 
-static int tcl_input(struct connection *connection)
+/* feed text input to the command line buffer, running each complete line
+ * as a command. Stops after a command which switched to binary mode. */
+static int tcl_line_input(struct connection *connection,
+		const unsigned char *in, size_t len, size_t *used)
 {
 	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
 	int retval;
-	int i;
-	ssize_t rlen;
+	size_t i;
 	const char *result;
 	int reslen;
-	struct tcl_connection *tclc;
-	unsigned char in[256];
+	struct tcl_connection *tclc = connection->priv;
 	char *tc_line_new;
 	int tc_line_size_new;
 
-	rlen = connection_read(connection, &in, sizeof(in));
-	if (rlen <= 0) {
-		if (rlen < 0)
-			LOG_ERROR("error during read: %s", strerror(errno));
-		return ERROR_SERVER_REMOTE_CLOSED;
-	}
-
-	tclc = connection->priv;
-	if (tclc == NULL)
-		return ERROR_CONNECTION_REJECTED;
-
 	/* push as much data into the line as possible */
-	for (i = 0; i < rlen; i++) {
+	for (i = 0; i < len; i++) {
 		/* buffer the data */
 		tclc->tc_line[tclc->tc_lineoffset] = in[i];
 		if (tclc->tc_lineoffset + 1 < tclc->tc_line_size) {
@@ -252,6 +462,250 @@ static int tcl_input(struct connection *connection)
 
 		tclc->tc_lineoffset = 0;
 		tclc->tc_linedrop = 0;
+
+		if (tclc->tc_binary) {
+			i++;
+			break;
+		}
+	}
+
+	*used = i;
+	return ERROR_OK;
+}
+
+static bool tcl_binary_size_ok(unsigned int size, uint32_t length)
+{
+	if (size != 1 && size != 2 && size != 4 && size != 8)
+		return false;
+	return length % size == 0 && length <= TCL_LINE_MAX;
+}
+
+/* @returns room for @a len bytes of reply payload in the output buffer */
+static uint8_t *tcl_binary_reply_begin(struct tcl_connection *tclc, size_t len)
+{
+	uint8_t *out = (uint8_t *)tcl_out_reserve(tclc, TCL_BIN_REPLY_HDR + len);
+
+	return out ? out + TCL_BIN_REPLY_HDR : NULL;
+}
+
+/* queue the reply made room for by tcl_binary_reply_begin() */
+static void tcl_binary_reply_end(struct tcl_connection *tclc, uint8_t op, int status, size_t len)
+{
+	uint8_t *hdr = (uint8_t *)tclc->tc_out + tclc->tc_out_len;
+
+	if (status != ERROR_OK)
+		len = 0;
+
+	hdr[0] = op;
+	hdr[1] = 0;
+	h_u16_to_le(hdr + 2, 0);
+	h_u32_to_le(hdr + 4, status);
+	h_u32_to_le(hdr + 8, len);
+	tclc->tc_out_len += TCL_BIN_REPLY_HDR + len;
+}
+
+/* look up the register named at the start of @a payload, @returns the
+ * length of the name including its terminating NUL in @a name_len */
+static struct reg *tcl_binary_reg(struct target *target,
+		const uint8_t *payload, uint32_t length, size_t *name_len)
+{
+	char name[128];
+	size_t len = strnlen((const char *)payload, length);
+
+	if (len >= sizeof(name))
+		return NULL;
+	memcpy(name, payload, len);
+	name[len] = '\0';
+	*name_len = MIN(len + 1, length);
+
+	struct reg *reg = register_get_by_name(target->reg_cache, name, 1);
+	if (reg == NULL || !reg->exist)
+		return NULL;
+	return reg;
+}
+
+/* execute one binary mode request and queue its reply */
+static int tcl_binary_request(struct connection *connection, const uint8_t *req)
+{
+	struct tcl_connection *tclc = connection->priv;
+	uint8_t op = req[0];
+	unsigned int size = req[1];
+	uint16_t flags = le_to_h_u16(req + 2);
+	uint32_t length = le_to_h_u32(req + 4);
+	target_addr_t address = le_to_h_u64(req + 8);
+	const uint8_t *payload = req + TCL_BIN_REQ_HDR;
+	struct target *target = get_current_target_or_null(connection->cmd_ctx);
+	int current = !(flags & TCL_BIN_FLAG_ADDRESS);
+	struct reg *reg;
+	size_t name_len;
+	uint8_t *out = NULL;
+	uint32_t out_len = 0;
+	int retval;
+
+	if (op == TCL_BIN_TEXT) {
+		tclc->tc_binary = false;
+		retval = ERROR_OK;
+	} else if (target == NULL) {
+		retval = ERROR_FAIL;
+	} else {
+		switch (op) {
+		case TCL_BIN_READ_MEM:
+			if (!tcl_binary_size_ok(size, length)) {
+				retval = ERROR_COMMAND_ARGUMENT_INVALID;
+				break;
+			}
+			/* read right into the output buffer */
+			out = tcl_binary_reply_begin(tclc, length);
+			if (out == NULL) {
+				retval = ERROR_FAIL;
+				break;
+			}
+			retval = target_read_memory(target, address, size, length / size, out);
+			out_len = length;
+			break;
+		case TCL_BIN_WRITE_MEM:
+			if (!tcl_binary_size_ok(size, length)) {
+				retval = ERROR_COMMAND_ARGUMENT_INVALID;
+				break;
+			}
+			retval = target_write_memory(target, address, size, length / size, payload);
+			break;
+		case TCL_BIN_READ_REG:
+			reg = tcl_binary_reg(target, payload, length, &name_len);
+			if (reg == NULL) {
+				retval = ERROR_COMMAND_ARGUMENT_INVALID;
+				break;
+			}
+			retval = reg->valid ? ERROR_OK : reg->type->get(reg);
+			if (retval != ERROR_OK)
+				break;
+			out_len = DIV_ROUND_UP(reg->size, 8);
+			out = tcl_binary_reply_begin(tclc, out_len);
+			if (out == NULL) {
+				retval = ERROR_FAIL;
+				break;
+			}
+			memcpy(out, reg->value, out_len);
+			break;
+		case TCL_BIN_WRITE_REG:
+			reg = tcl_binary_reg(target, payload, length, &name_len);
+			if (reg == NULL || length - name_len != DIV_ROUND_UP(reg->size, 8)) {
+				retval = ERROR_COMMAND_ARGUMENT_INVALID;
+				break;
+			}
+			retval = reg->type->set(reg, (uint8_t *)payload + name_len);
+			break;
+		case TCL_BIN_HALT:
+			retval = target_halt(target);
+			break;
+		case TCL_BIN_RESUME:
+			retval = target_resume(target, current, address, 1, 0);
+			break;
+		case TCL_BIN_STEP:
+			retval = target_step(target, current, address, 1);
+			break;
+		case TCL_BIN_STATE:
+			retval = target_poll(target);
+			if (retval != ERROR_OK)
+				break;
+			out_len = 1;
+			out = tcl_binary_reply_begin(tclc, out_len);
+			if (out == NULL) {
+				retval = ERROR_FAIL;
+				break;
+			}
+			out[0] = target->state;
+			break;
+		default:
+			retval = ERROR_COMMAND_SYNTAX_ERROR;
+			break;
+		}
+	}
+
+	if (out == NULL || retval != ERROR_OK)
+		out = tcl_binary_reply_begin(tclc, 0);
+	if (out == NULL)
+		return ERROR_FAIL;
+	tcl_binary_reply_end(tclc, op, retval, out_len);
+
+	return ERROR_OK;
+}
+
+/* collect a binary mode request in the line buffer and execute it once
+ * complete. Stops after each request, which may switch back to text. */
+static int tcl_binary_input(struct connection *connection,
+		const unsigned char *in, size_t len, size_t *used)
+{
+	struct tcl_connection *tclc = connection->priv;
+	uint32_t length;
+	size_t need, n;
+	int retval;
+
+	*used = 0;
+	while (*used < len) {
+		need = TCL_BIN_REQ_HDR;
+		if (tclc->tc_lineoffset >= TCL_BIN_REQ_HDR)
+			need += le_to_h_u32((uint8_t *)tclc->tc_line + 4);
+
+		n = MIN(len - *used, need - tclc->tc_lineoffset);
+		memcpy(tclc->tc_line + tclc->tc_lineoffset, in + *used, n);
+		tclc->tc_lineoffset += n;
+		*used += n;
+		if ((size_t)tclc->tc_lineoffset < need)
+			continue;
+
+		if (need == TCL_BIN_REQ_HDR) {
+			/* header complete, make room for the payload */
+			length = le_to_h_u32((uint8_t *)tclc->tc_line + 4);
+			if (length > TCL_LINE_MAX) {
+				LOG_ERROR("tcl binary request of %" PRIu32 " bytes is too long", length);
+				return ERROR_SERVER_REMOTE_CLOSED;
+			}
+			if (need + length > (size_t)tclc->tc_line_size) {
+				char *tc_line_new = realloc(tclc->tc_line, need + length);
+				if (tc_line_new == NULL)
+					return ERROR_FAIL;
+				tclc->tc_line = tc_line_new;
+				tclc->tc_line_size = need + length;
+			}
+			if (length)
+				continue;
+		}
+
+		retval = tcl_binary_request(connection, (uint8_t *)tclc->tc_line);
+		tclc->tc_lineoffset = 0;
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int tcl_input(struct connection *connection)
+{
+	int retval;
+	ssize_t rlen;
+	size_t pos, used;
+	struct tcl_connection *tclc;
+	unsigned char in[4096];
+
+	rlen = connection_read(connection, &in, sizeof(in));
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc = connection->priv;
+	if (tclc == NULL)
+		return ERROR_CONNECTION_REJECTED;
+
+	for (pos = 0; pos < (size_t)rlen; pos += used) {
+		if (tclc->tc_binary)
+			retval = tcl_binary_input(connection, in + pos, rlen - pos, &used);
+		else
+			retval = tcl_line_input(connection, in + pos, rlen - pos, &used);
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
 	return ERROR_OK;
@@ -265,6 +719,7 @@ static int tcl_closed(struct connection *connection)
 	/* cleanup connection context */
 	if (tclc) {
 		free(tclc->tc_line);
+		free(tclc->tc_out);
 		free(tclc);
 		connection->priv = NULL;
 	}
@@ -272,6 +727,7 @@ static int tcl_closed(struct connection *connection)
 	target_unregister_event_callback(tcl_target_callback_event_handler, connection);
 	target_unregister_reset_callback(tcl_target_callback_reset_handler, connection);
 	target_unregister_trace_callback(tcl_target_callback_trace_handler, connection);
+	target_unregister_sample_callback(tcl_target_callback_sample_handler, connection);
 
 	return ERROR_OK;
 }
@@ -283,9 +739,13 @@ int tcl_init(void)
 		return ERROR_OK;
 	}
 
-	return add_service("tcl", tcl_port, CONNECTION_LIMIT_UNLIMITED,
+	int ret = add_service("tcl", tcl_port, CONNECTION_LIMIT_UNLIMITED,
 		&tcl_new_connection, &tcl_input,
 		&tcl_closed, NULL);
+	if (ret != ERROR_OK)
+		return ret;
+
+	return service_set_flush_handler("tcl", &tcl_flush);
 }
 
 COMMAND_HANDLER(handle_tcl_port_command)
@@ -327,6 +787,37 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+COMMAND_HANDLER(handle_tcl_samples_command)
+{
+	struct connection *connection = CMD_CTX->output_handler_priv;
+
+	if (connection != NULL && !strcmp(connection->service->name, "tcl")) {
+		struct tcl_connection *tclc = connection->priv;
+		return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_samples, "Target sample output ");
+	} else {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+}
+
+COMMAND_HANDLER(handle_tcl_binary_command)
+{
+	struct connection *connection = CMD_CTX->output_handler_priv;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (connection == NULL || strcmp(connection->service->name, "tcl")) {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	/* takes effect after the reply to this command */
+	struct tcl_connection *tclc = connection->priv;
+	tclc->tc_binary = true;
+	return ERROR_OK;
+}
+
 static const struct command_registration tcl_command_handlers[] = {
 	{
 		.name = "tcl_port",
@@ -351,6 +842,20 @@ static const struct command_registration tcl_command_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "tcl_samples",
+		.handler = handle_tcl_samples_command,
+		.mode = COMMAND_EXEC,
+		.help = "Target sample output, see 'target sample'",
+		.usage = "[on|off]",
+	},
+	{
+		.name = "tcl_binary",
+		.handler = handle_tcl_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Switch the current Tcl RPC connection to binary requests",
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -29,6 +29,7 @@
 #include "telnet_server.h"
 #include <target/target_request.h>
 #include <helper/configuration.h>
+#include <helper/time_support.h>
 
 static char *telnet_port;
 
@@ -45,12 +46,10 @@ static char *negotiate =
  * we write to it, we will fail. Subsequent write operations will
  * succeed. Shudder!
  */
-static int telnet_write(struct connection *connection, const void *data,
+static int telnet_write_out(struct connection *connection, const void *data,
 	int len)
 {
 	struct telnet_connection *t_con = connection->priv;
-	if (t_con->closed)
-		return ERROR_SERVER_REMOTE_CLOSED;
 
 	if (connection_write(connection, data, len) == len)
 		return ERROR_OK;
@@ -58,6 +57,50 @@ static int telnet_write(struct connection *connection, const void *data,
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* write out the buffered output, called once per server loop iteration */
+static int telnet_flush(struct connection *connection)
+{
+	struct telnet_connection *t_con = connection->priv;
+	size_t size = t_con->out_size;
+
+	if (t_con->closed)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	if (!size)
+		return ERROR_OK;
+
+	t_con->out_size = 0;
+	return telnet_write_out(connection, t_con->out, size);
+}
+
+/* Output is collected per connection, so that line editing and large
+ * command outputs are not written one small piece at a time. */
+static int telnet_write(struct connection *connection, const void *data,
+	int len)
+{
+	struct telnet_connection *t_con = connection->priv;
+	int retval;
+
+	if (t_con->closed)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	if (t_con->out_size &&
+			(t_con->out_size + len > TELNET_OUTPUT_SIZE ||
+			timeval_ms() - t_con->out_start_ms > TELNET_OUTPUT_DELAY_MS)) {
+		retval = telnet_flush(connection);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (len > TELNET_OUTPUT_SIZE)
+		return telnet_write_out(connection, data, len);
+
+	if (!t_con->out_size)
+		t_con->out_start_ms = timeval_ms();
+	memcpy(t_con->out + t_con->out_size, data, len);
+	t_con->out_size += len;
+	return ERROR_OK;
+}
+
 static int telnet_prompt(struct connection *connection)
 {
 	struct telnet_connection *t_con = connection->priv;
@@ -227,6 +270,7 @@ static int telnet_new_connection(struct connection *connection)
 
 	/* initialize telnet connection information */
 	telnet_connection->closed = false;
+	telnet_connection->out_size = 0;
 	telnet_connection->line_size = 0;
 	telnet_connection->line_cursor = 0;
 	telnet_connection->prompt = strdup("> ");
@@ -645,6 +689,9 @@ static int telnet_connection_closed(struct connection *connection)
 
 	log_remove_callback(telnet_log_callback, connection);
 
+	/* e.g. the reply to "exit" */
+	telnet_flush(connection);
+
 	free(t_con->prompt);
 	t_con->prompt = NULL;
 
@@ -691,7 +738,7 @@ int telnet_init(char *banner)
 		return ret;
 	}
 
-	return ERROR_OK;
+	return service_set_flush_handler("telnet", telnet_flush);
 }
 
 /* daemon configuration command telnet_port */
@@ -31,6 +31,9 @@
 
 #define TELNET_LINE_HISTORY_SIZE (128)
 #define TELNET_LINE_MAX_SIZE (10*256)
+#define TELNET_OUTPUT_SIZE (16*1024)
+/* buffered output older than this is written out with the next output */
+#define TELNET_OUTPUT_DELAY_MS (100)
 
 enum telnet_states {
 	TELNET_STATE_DATA,
@@ -56,6 +59,10 @@ struct telnet_connection {
 	size_t next_history;
 	size_t current_history;
 	bool closed;
+	/* output buffered until the end of the server loop iteration */
+	char out[TELNET_OUTPUT_SIZE];
+	size_t out_size;
+	int64_t out_start_ms;
 };
 
 struct telnet_service {
@@ -33,6 +33,15 @@
 #include "svf.h"
 #include <helper/time_support.h>
 
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define SVF_READ_AHEAD
+#include <pthread.h>
+/* only the reader thread uses the file, skip the locking of each character */
+#define svf_getc getc_unlocked
+#else
+#define svf_getc fgetc
+#endif
+
 /* SVF command */
 enum svf_command {
 	ENDDR,
@@ -209,6 +218,7 @@ struct svf_check_tdo_para {
 #define SVF_CHECK_TDO_PARA_SIZE 1024
 static struct svf_check_tdo_para *svf_check_tdo_para;
 static int svf_check_tdo_para_index;
+static int svf_check_tdo_para_size;
 
 static int svf_read_command_from_file(FILE *fd);
 static int svf_check_tdo(void);
@@ -216,21 +226,73 @@ static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len);
 static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str);
 static int svf_execute_tap(void);
 
+/* owned by the reader, see svf_read_next() */
 static FILE *svf_fd;
 static char *svf_read_line;
 static size_t svf_read_line_size;
 static char *svf_command_buffer;
 static size_t svf_command_buffer_size;
+static int svf_read_line_number;
+static bool svf_read_error;
+
 static int svf_line_number;
 static int svf_getline(char **lineptr, size_t *n, FILE *stream);
 
+/* a command as read from the file, with the line it ended on */
+struct svf_read_command {
+	char *command;
+	size_t size;
+	char *line;
+	int line_number;
+};
+
+#ifdef SVF_READ_AHEAD
+/* The file is read and preprocessed by a thread of its own, which runs up
+ * to SVF_READ_AHEAD_COMMANDS commands or SVF_READ_AHEAD_BYTES ahead, so
+ * that the reading overlaps the execution of the JTAG queue. */
+#define SVF_READ_AHEAD_COMMANDS	16384
+#define SVF_READ_AHEAD_BYTES	(16 * 1024 * 1024)
+
+static struct svf_read_command svf_read_queue[SVF_READ_AHEAD_COMMANDS];
+static unsigned int svf_read_head, svf_read_count;
+static size_t svf_read_bytes;
+static bool svf_read_done, svf_read_stop, svf_read_threaded, svf_read_full;
+static pthread_t svf_read_thread;
+static pthread_mutex_t svf_read_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t svf_read_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t svf_read_not_full = PTHREAD_COND_INITIALIZER;
+#endif
+
+static void svf_read_start(void);
+static int svf_read_take(struct svf_read_command *cmd);
+static void svf_read_finish(void);
+
+/* The queue is committed once SVF_MAX_BUFFER_SIZE_TO_COMMIT bytes of scan
+ * data or SVF_CHECK_TDO_PARA_SIZE / 2 scans are queued, initially. Commits
+ * shorter than SVF_COMMIT_MIN_MS are dominated by the adapter's latency and
+ * let the limit that was hit double; commits longer than SVF_COMMIT_MAX_MS
+ * halve both limits. */
 #define SVF_MAX_BUFFER_SIZE_TO_COMMIT   (1024 * 1024)
+#define SVF_COMMIT_SIZE_MIN		(64 * 1024)
+#define SVF_COMMIT_SIZE_MAX		(16 * 1024 * 1024)
+#define SVF_COMMIT_SCANS_MIN	64
+#define SVF_COMMIT_SCANS_MAX	(64 * 1024)
+#define SVF_COMMIT_MIN_MS		50
+#define SVF_COMMIT_MAX_MS		500
+static int svf_commit_size, svf_commit_scans;
+
 static uint8_t *svf_tdi_buffer, *svf_tdo_buffer, *svf_mask_buffer;
 static int svf_buffer_index, svf_buffer_size;
 static int svf_quiet;
 static int svf_nil;
 static int svf_ignore_error;
 
+/* with lazy_verify, TDO check errors do not stop the run, nor do the
+ * checks force commits; the first failing line is reported at the end */
+static int svf_lazy_verify;
+static int svf_lazy_errors;
+static int svf_lazy_error_line;
+
 /* Targeting particular tap */
 static int svf_tap_is_specified;
 static int svf_set_padding(struct svf_xxr_para *para, int len, unsigned char tdi);
@@ -353,7 +415,7 @@ int svf_add_statemove(tap_state_t state_to)
 COMMAND_HANDLER(handle_svf_command)
 {
 #define SVF_MIN_NUM_OF_OPTIONS 1
-#define SVF_MAX_NUM_OF_OPTIONS 5
+#define SVF_MAX_NUM_OF_OPTIONS 8
 	int command_num = 0;
 	int ret = ERROR_OK;
 	int64_t time_measure_ms;
@@ -373,6 +435,8 @@ COMMAND_HANDLER(handle_svf_command)
 	svf_nil = 0;
 	svf_progress_enabled = 0;
 	svf_ignore_error = 0;
+	svf_lazy_verify = 0;
+	svf_lazy_errors = 0;
 	for (unsigned int i = 0; i < CMD_ARGC; i++) {
 		if (strcmp(CMD_ARGV[i], "-tap") == 0) {
 			tap = jtag_tap_by_string(CMD_ARGV[i+1]);
@@ -392,6 +456,9 @@ COMMAND_HANDLER(handle_svf_command)
 		else if ((strcmp(CMD_ARGV[i],
 				  "ignore_error") == 0) || (strcmp(CMD_ARGV[i], "-ignore_error") == 0))
 			svf_ignore_error = 1;
+		else if ((strcmp(CMD_ARGV[i],
+				  "lazy_verify") == 0) || (strcmp(CMD_ARGV[i], "-lazy_verify") == 0))
+			svf_lazy_verify = 1;
 		else {
 			svf_fd = fopen(CMD_ARGV[i], "r");
 			if (svf_fd == NULL) {
@@ -412,9 +479,12 @@ COMMAND_HANDLER(handle_svf_command)
 
 	/* init */
 	svf_line_number = 0;
+	svf_read_line_number = 0;
+	svf_read_error = false;
 	svf_command_buffer_size = 0;
 
 	svf_check_tdo_para_index = 0;
+	svf_check_tdo_para_size = SVF_CHECK_TDO_PARA_SIZE;
 	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
 	if (NULL == svf_check_tdo_para) {
 		LOG_ERROR("not enough memory");
@@ -422,6 +492,9 @@ COMMAND_HANDLER(handle_svf_command)
 		goto free_all;
 	}
 
+	svf_commit_size = SVF_MAX_BUFFER_SIZE_TO_COMMIT;
+	svf_commit_scans = svf_lazy_verify ? SVF_COMMIT_SCANS_MAX : SVF_CHECK_TDO_PARA_SIZE / 2;
+
 	svf_buffer_index = 0;
 	/* double the buffer size */
 	/* in case current command cannot be committed, and next command is a bit scan command */
@@ -491,7 +564,11 @@ COMMAND_HANDLER(handle_svf_command)
 		}
 		rewind(svf_fd);
 	}
-	while (ERROR_OK == svf_read_command_from_file(svf_fd)) {
+	svf_read_start();
+	struct svf_read_command command;
+	while (ERROR_OK == svf_read_take(&command)) {
+		svf_line_number = command.line_number;
+
 		/* Log Output */
 		if (svf_quiet) {
 			if (svf_progress_enabled) {
@@ -504,24 +581,34 @@ COMMAND_HANDLER(handle_svf_command)
 		} else {
 			if (svf_progress_enabled) {
 				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
-				LOG_USER_N("%3d%%  %s", svf_percentage, svf_read_line);
+				LOG_USER_N("%3d%%  %s", svf_percentage, command.line);
 			} else
-				LOG_USER_N("%s", svf_read_line);
+				LOG_USER_N("%s", command.line);
 		}
 		/* Run Command */
-		if (ERROR_OK != svf_run_command(CMD_CTX, svf_command_buffer)) {
+		int retval = svf_run_command(CMD_CTX, command.command);
+		free(command.command);
+		free(command.line);
+		if (ERROR_OK != retval) {
 			LOG_ERROR("fail to run command at line %d", svf_line_number);
 			ret = ERROR_FAIL;
 			break;
 		}
 		command_num++;
 	}
+	svf_read_finish();
 
 	if ((!svf_nil) && (ERROR_OK != jtag_execute_queue()))
 		ret = ERROR_FAIL;
 	else if (ERROR_OK != svf_check_tdo())
 		ret = ERROR_FAIL;
 
+	if (svf_lazy_errors) {
+		LOG_ERROR("%d tdo check errors, the first at line %d",
+				svf_lazy_errors, svf_lazy_error_line);
+		ret = ERROR_FAIL;
+	}
+
 	/* print time */
 	time_measure_ms = timeval_ms() - time_measure_ms;
 	time_measure_s = time_measure_ms / 1000;
@@ -583,7 +670,7 @@ free_all:
 
 static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 {
-#define MIN_CHUNK 16	/* Buffer is increased by this size each time as required */
+#define MIN_CHUNK 16	/* Initial size of the buffer */
 	size_t i = 0;
 
 	if (*lineptr == NULL) {
@@ -593,20 +680,28 @@ static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 			return -1;
 	}
 
-	(*lineptr)[0] = fgetc(stream);
-	while ((*lineptr)[i] != '\n') {
-		(*lineptr)[++i] = fgetc(stream);
-		if (feof(stream)) {
+	int c;
+	do {
+		c = svf_getc(stream);
+		if (c == EOF) {
 			(*lineptr)[0] = 0;
 			return -1;
 		}
-		if ((i + 2) > *n) {
-			*n += MIN_CHUNK;
-			*lineptr = realloc(*lineptr, *n);
+		(*lineptr)[i++] = c;
+		if ((i + 1) >= *n) {
+			/* grow geometrically, bit strings can span megabytes */
+			char *p = realloc(*lineptr, 2 * *n);
+			if (!p) {
+				svf_read_error = true;
+				(*lineptr)[0] = 0;
+				return -1;
+			}
+			*lineptr = p;
+			*n *= 2;
 		}
-	}
+	} while (c != '\n');
 
-	(*lineptr)[++i] = 0;
+	(*lineptr)[i] = 0;
 
 	return sizeof(*lineptr);
 }
@@ -621,7 +716,7 @@ static int svf_read_command_from_file(FILE *fd)
 
 	if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
 		return ERROR_FAIL;
-	svf_line_number++;
+	svf_read_line_number++;
 	ch = svf_read_line[0];
 	while (!cmd_ok && (ch != 0)) {
 		switch (ch) {
@@ -629,7 +724,7 @@ static int svf_read_command_from_file(FILE *fd)
 				slash = 0;
 				if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
 					return ERROR_FAIL;
-				svf_line_number++;
+				svf_read_line_number++;
 				i = -1;
 				break;
 			case '/':
@@ -638,7 +733,7 @@ static int svf_read_command_from_file(FILE *fd)
 					if (svf_getline(&svf_read_line, &svf_read_line_size,
 						svf_fd) <= 0)
 						return ERROR_FAIL;
-					svf_line_number++;
+					svf_read_line_number++;
 					i = -1;
 				}
 				break;
@@ -647,7 +742,7 @@ static int svf_read_command_from_file(FILE *fd)
 				cmd_ok = 1;
 				break;
 			case '\n':
-				svf_line_number++;
+				svf_read_line_number++;
 				if (svf_getline(&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
 					return ERROR_FAIL;
 				i = -1;
@@ -672,12 +767,15 @@ static int svf_read_command_from_file(FILE *fd)
 				 *  - terminating NUL ('\0')
 				 */
 				if (cmd_pos + 3 > svf_command_buffer_size) {
-					svf_command_buffer = realloc(svf_command_buffer, cmd_pos + 3);
-					svf_command_buffer_size = cmd_pos + 3;
-					if (svf_command_buffer == NULL) {
-						LOG_ERROR("not enough memory");
+					size_t size = MAX(2 * svf_command_buffer_size,
+							(size_t)SVFP_CMD_INC_CNT);
+					char *p = realloc(svf_command_buffer, size);
+					if (!p) {
+						svf_read_error = true;
 						return ERROR_FAIL;
 					}
+					svf_command_buffer = p;
+					svf_command_buffer_size = size;
 				}
 
 				/* insert a space before '(' */
@@ -701,6 +799,141 @@ static int svf_read_command_from_file(FILE *fd)
 		return ERROR_FAIL;
 }
 
+/* read the next command, handing over the command buffer */
+static int svf_read_next(struct svf_read_command *cmd)
+{
+	if (svf_read_command_from_file(svf_fd) != ERROR_OK)
+		return ERROR_FAIL;
+
+	cmd->command = svf_command_buffer;
+	cmd->size = svf_command_buffer_size;
+	cmd->line = NULL;
+	cmd->line_number = svf_read_line_number;
+	if (!svf_quiet) {
+		cmd->line = strdup(svf_read_line);
+		if (!cmd->line) {
+			svf_read_error = true;
+			return ERROR_FAIL;
+		}
+	}
+
+	svf_command_buffer = NULL;
+	svf_command_buffer_size = 0;
+	return ERROR_OK;
+}
+
+#ifdef SVF_READ_AHEAD
+static void *svf_read_thread_main(void *arg)
+{
+	struct svf_read_command cmd;
+
+	while (svf_read_next(&cmd) == ERROR_OK) {
+		pthread_mutex_lock(&svf_read_mutex);
+		while (!svf_read_stop && (svf_read_count == SVF_READ_AHEAD_COMMANDS ||
+				(svf_read_count && svf_read_bytes >= SVF_READ_AHEAD_BYTES))) {
+			svf_read_full = true;
+			pthread_cond_wait(&svf_read_not_full, &svf_read_mutex);
+		}
+		if (svf_read_stop) {
+			pthread_mutex_unlock(&svf_read_mutex);
+			free(cmd.command);
+			free(cmd.line);
+			break;
+		}
+		svf_read_queue[(svf_read_head + svf_read_count) % SVF_READ_AHEAD_COMMANDS] = cmd;
+		svf_read_bytes += cmd.size;
+		/* only an empty queue has a waiter */
+		if (svf_read_count++ == 0)
+			pthread_cond_signal(&svf_read_not_empty);
+		pthread_mutex_unlock(&svf_read_mutex);
+	}
+
+	pthread_mutex_lock(&svf_read_mutex);
+	svf_read_done = true;
+	pthread_cond_signal(&svf_read_not_empty);
+	pthread_mutex_unlock(&svf_read_mutex);
+	return NULL;
+}
+#endif
+
+static void svf_read_start(void)
+{
+#ifdef SVF_READ_AHEAD
+	svf_read_head = 0;
+	svf_read_count = 0;
+	svf_read_bytes = 0;
+	svf_read_done = false;
+	svf_read_stop = false;
+	svf_read_full = false;
+
+	/* without the thread the file is read in turn with the execution */
+	svf_read_threaded = pthread_create(&svf_read_thread, NULL,
+			svf_read_thread_main, NULL) == 0;
+	if (!svf_read_threaded)
+		LOG_DEBUG("no read ahead thread, reading synchronously");
+#endif
+}
+
+static int svf_read_take(struct svf_read_command *cmd)
+{
+	int retval;
+
+#ifdef SVF_READ_AHEAD
+	if (svf_read_threaded) {
+		pthread_mutex_lock(&svf_read_mutex);
+		while (!svf_read_count && !svf_read_done)
+			pthread_cond_wait(&svf_read_not_empty, &svf_read_mutex);
+		if (svf_read_count) {
+			*cmd = svf_read_queue[svf_read_head];
+			svf_read_head = (svf_read_head + 1) % SVF_READ_AHEAD_COMMANDS;
+			svf_read_count--;
+			svf_read_bytes -= cmd->size;
+			/* let a reader which waits for room refill half of the queue at once */
+			if (svf_read_full && svf_read_count <= SVF_READ_AHEAD_COMMANDS / 2 &&
+					svf_read_bytes <= SVF_READ_AHEAD_BYTES / 2) {
+				svf_read_full = false;
+				pthread_cond_signal(&svf_read_not_full);
+			}
+			retval = ERROR_OK;
+		} else {
+			retval = ERROR_FAIL;
+		}
+		pthread_mutex_unlock(&svf_read_mutex);
+	} else
+#endif
+		retval = svf_read_next(cmd);
+
+	/* the reader cannot log, it may not run on the main thread */
+	if (retval != ERROR_OK && svf_read_error) {
+		LOG_ERROR("not enough memory");
+		svf_read_error = false;
+	}
+	return retval;
+}
+
+/* stop reading ahead, and drop everything read but not taken */
+static void svf_read_finish(void)
+{
+#ifdef SVF_READ_AHEAD
+	if (!svf_read_threaded)
+		return;
+
+	pthread_mutex_lock(&svf_read_mutex);
+	svf_read_stop = true;
+	pthread_cond_signal(&svf_read_not_full);
+	pthread_mutex_unlock(&svf_read_mutex);
+	pthread_join(svf_read_thread, NULL);
+	svf_read_threaded = false;
+
+	while (svf_read_count) {
+		free(svf_read_queue[svf_read_head].command);
+		free(svf_read_queue[svf_read_head].line);
+		svf_read_head = (svf_read_head + 1) % SVF_READ_AHEAD_COMMANDS;
+		svf_read_count--;
+	}
+#endif
+}
+
 static int svf_parse_cmd_string(char *str, int len, char **argus, int *num_of_argu)
 {
 	int pos = 0, num = 0, space_found = 1, in_bracket = 0;
@@ -847,26 +1080,63 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 	return ERROR_OK;
 }
 
+/* log a failing check, and decide whether that ends the run */
+static int svf_check_tdo_failed(const struct svf_check_tdo_para *para)
+{
+	int index_var = para->buffer_offset;
+	int len = para->bit_len;
+
+	if (svf_ignore_error) {
+		svf_ignore_error++;
+	} else if (svf_lazy_verify) {
+		/* the run goes on, only the first error is shown in full */
+		if (svf_lazy_errors++)
+			return ERROR_OK;
+		svf_lazy_error_line = para->line_num;
+	}
+
+	LOG_ERROR("tdo check error at line %d", para->line_num);
+	SVF_BUF_LOG(ERROR, &svf_tdi_buffer[index_var], len, "READ");
+	SVF_BUF_LOG(ERROR, &svf_tdo_buffer[index_var], len, "WANT");
+	SVF_BUF_LOG(ERROR, &svf_mask_buffer[index_var], len, "MASK");
+
+	if (svf_ignore_error || svf_lazy_verify)
+		return ERROR_OK;
+	return ERROR_FAIL;
+}
+
 static int svf_check_tdo(void)
 {
-	int i, len, index_var;
-
-	for (i = 0; i < svf_check_tdo_para_index; i++) {
-		index_var = svf_check_tdo_para[i].buffer_offset;
-		len = svf_check_tdo_para[i].bit_len;
-		if ((svf_check_tdo_para[i].enabled)
-				&& buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
-				&svf_mask_buffer[index_var], len)) {
-			LOG_ERROR("tdo check error at line %d",
-				svf_check_tdo_para[i].line_num);
-			SVF_BUF_LOG(ERROR, &svf_tdi_buffer[index_var], len, "READ");
-			SVF_BUF_LOG(ERROR, &svf_tdo_buffer[index_var], len, "WANT");
-			SVF_BUF_LOG(ERROR, &svf_mask_buffer[index_var], len, "MASK");
-
-			if (svf_ignore_error == 0)
+	int i = 0;
+
+	while (i < svf_check_tdo_para_index) {
+		const struct svf_check_tdo_para *para = &svf_check_tdo_para[i];
+		if (!para->enabled) {
+			i++;
+			continue;
+		}
+
+		/* checks of whole bytes which follow each other in the buffers
+		 * are compared at once, a mismatch is then located per check */
+		int first = i, index_var = para->buffer_offset, len = para->bit_len;
+		while (len % 8 == 0 && ++i < svf_check_tdo_para_index &&
+				svf_check_tdo_para[i].enabled &&
+				svf_check_tdo_para[i].buffer_offset == index_var + len / 8)
+			len += svf_check_tdo_para[i].bit_len;
+		if (i == first || len % 8)
+			i++;
+
+		if (!buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
+				&svf_mask_buffer[index_var], len))
+			continue;
+
+		for (int j = first; j < i; j++) {
+			para = &svf_check_tdo_para[j];
+			index_var = para->buffer_offset;
+			if (buf_cmp_mask(&svf_tdi_buffer[index_var], &svf_tdo_buffer[index_var],
+					&svf_mask_buffer[index_var], para->bit_len) &&
+					svf_check_tdo_failed(para) != ERROR_OK)
 				return ERROR_FAIL;
-			else
-				svf_ignore_error++;
 		}
 	}
 	svf_check_tdo_para_index = 0;
@@ -876,9 +1146,15 @@ static int svf_check_tdo(void)
 
 static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 {
-	if (svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE) {
-		LOG_ERROR("toooooo many operation undone");
-		return ERROR_FAIL;
+	if (svf_check_tdo_para_index >= svf_check_tdo_para_size) {
+		struct svf_check_tdo_para *p = realloc(svf_check_tdo_para,
+				2 * svf_check_tdo_para_size * sizeof(*p));
+		if (!p) {
+			LOG_ERROR("not enough memory");
+			return ERROR_FAIL;
+		}
+		svf_check_tdo_para = p;
+		svf_check_tdo_para_size *= 2;
 	}
 
 	svf_check_tdo_para[svf_check_tdo_para_index].line_num = svf_line_number;
@@ -902,6 +1178,36 @@ static int svf_execute_tap(void)
 	return ERROR_OK;
 }
 
+/* execute the queue once a commit limit is reached, and adapt the limits */
+static int svf_commit(void)
+{
+	bool size_reached = svf_buffer_index >= svf_commit_size;
+	bool scans_reached = svf_check_tdo_para_index >= svf_commit_scans;
+	int64_t start = timeval_ms();
+
+	if (svf_execute_tap() != ERROR_OK)
+		return ERROR_FAIL;
+
+	int64_t elapsed = timeval_ms() - start;
+	if (elapsed < SVF_COMMIT_MIN_MS) {
+		if (scans_reached && svf_commit_scans < SVF_COMMIT_SCANS_MAX)
+			svf_commit_scans *= 2;
+		if (size_reached && svf_commit_size < SVF_COMMIT_SIZE_MAX) {
+			svf_commit_size *= 2;
+			/* half of the buffer is for the next command */
+			if (svf_buffer_size < 2 * svf_commit_size)
+				return svf_realloc_buffers(2 * svf_commit_size);
+		}
+	} else if (elapsed > SVF_COMMIT_MAX_MS) {
+		if (svf_commit_scans > SVF_COMMIT_SCANS_MIN)
+			svf_commit_scans /= 2;
+		if (svf_commit_size > SVF_COMMIT_SIZE_MIN)
+			svf_commit_size /= 2;
+	}
+
+	return ERROR_OK;
+}
+
 static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str)
 {
 	char *argus[256], command;
@@ -1524,7 +1830,7 @@ XXR_common:
 			LOG_USER("(Above Padding command skipped, as per -tap argument)");
 	}
 
-	if (debug_level >= LOG_LVL_DEBUG) {
+	if (debug_level >= LOG_LVL_DEBUG && !svf_lazy_verify) {
 		/* for convenient debugging, execute tap if possible */
 		if ((svf_buffer_index > 0) &&
 				(((command != STATE) && (command != RUNTEST)) ||
@@ -1540,11 +1846,11 @@ XXR_common:
 	} else {
 		/* for fast executing, execute tap if necessary */
 		/* half of the buffer is for the next command */
-		if (((svf_buffer_index >= SVF_MAX_BUFFER_SIZE_TO_COMMIT) ||
-				(svf_check_tdo_para_index >= SVF_CHECK_TDO_PARA_SIZE / 2)) &&
+		if (((svf_buffer_index >= svf_commit_size) ||
+				(svf_check_tdo_para_index >= svf_commit_scans)) &&
 				(((command != STATE) && (command != RUNTEST)) ||
 						((command == STATE) && (num_of_argu == 2))))
-			return svf_execute_tap();
+			return svf_commit();
 	}
 
 	return ERROR_OK;
@@ -1556,7 +1862,8 @@ static const struct command_registration svf_command_handlers[] = {
 		.handler = handle_svf_command,
 		.mode = COMMAND_EXEC,
 		.help = "Runs a SVF file.",
-		.usage = "[-tap device.tap] <file> [quiet] [nil] [progress] [ignore_error]",
+		.usage = "[-tap device.tap] <file> [quiet] [nil] [progress] [ignore_error] "
+			"[lazy_verify]",
 	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -318,35 +318,134 @@ static int aarch64_wait_halt_one(struct target *target)
 	return retval;
 }
 
+/*
+ * SMP groups are handled in one pass over all PEs: the per-PE accesses
+ * are queued on the DAP and only flushed once, instead of one round trip
+ * to the adapter per register access and PE.
+ */
+struct aarch64_smp_pe {
+	struct target *target;
+	uint32_t prsr;
+	uint32_t dscr;
+	uint32_t gate;
+};
+
+/* Collect the examined PEs of the SMP group of @a target. */
+static int aarch64_smp_get_pes(struct target *target, struct aarch64_smp_pe **p_pes,
+		unsigned int *p_num)
+{
+	struct target_list *head;
+	unsigned int num = 0;
+
+	foreach_smp_target(head, target->head)
+		num++;
+
+	*p_pes = calloc(num ? num : 1, sizeof(**p_pes));
+	if (!*p_pes) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	num = 0;
+	foreach_smp_target(head, target->head) {
+		if (target_was_examined(head->target))
+			(*p_pes)[num++].target = head->target;
+	}
+	*p_num = num;
+
+	return ERROR_OK;
+}
+
+/* Flush the queued accesses to the debug and CTI APs of @a pes, once per DAP. */
+static int aarch64_smp_run(struct aarch64_smp_pe *pes, unsigned int num)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < 2 * num && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i / 2].target);
+		struct adiv5_dap *dap = (i & 1) ? arm_cti_dap(armv8->cti) : armv8->debug_ap->dap;
+		bool seen = false;
+
+		for (unsigned int j = 0; j < i && !seen; j++) {
+			struct armv8_common *prev = target_to_armv8(pes[j / 2].target);
+			seen = dap == ((j & 1) ? arm_cti_dap(prev->cti) : prev->debug_ap->dap);
+		}
+		if (!seen)
+			retval = dap_run(dap);
+	}
+
+	return retval;
+}
+
+/* Read PRSR of all @a pes in one go. */
+static int aarch64_smp_read_prsr(struct aarch64_smp_pe *pes, unsigned int num)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < num && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR, &pes[i].prsr);
+	}
+	if (retval == ERROR_OK)
+		retval = aarch64_smp_run(pes, num);
+
+	return retval;
+}
+
 static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, struct target **p_first)
 {
 	int retval = ERROR_OK;
-	struct target_list *head = target->head;
+	struct aarch64_smp_pe *pes;
+	unsigned int num, i;
 	struct target *first = NULL;
 
 	LOG_DEBUG("target %s exc %i", target_name(target), exc_target);
 
-	while (head != NULL) {
-		struct target *curr = head->target;
-		struct armv8_common *armv8 = target_to_armv8(curr);
-		head = head->next;
+	retval = aarch64_smp_get_pes(target, &pes, &num);
+	if (retval != ERROR_OK)
+		return retval;
 
-		if (exc_target && curr == target)
-			continue;
-		if (!target_was_examined(curr))
-			continue;
-		if (curr->state != TARGET_RUNNING)
-			continue;
+	/* keep the running PEs only */
+	for (i = 0; i < num;) {
+		struct target *curr = pes[i].target;
 
-		/* HACK: mark this target as prepared for halting */
-		curr->debug_reason = DBG_REASON_DBGRQ;
+		if ((exc_target && curr == target) || curr->state != TARGET_RUNNING)
+			pes[i] = pes[--num];
+		else
+			i++;
+	}
 
-		/* open the gate for channel 0 to let HALT requests pass to the CTM */
-		retval = arm_cti_ungate_channel(armv8->cti, 0);
+	/* read the CTI gates and DSCRs, then open the gate for channel 0 to
+	 * let HALT requests pass to the CTM and set DSCR.HDE, on all PEs */
+	for (i = 0; i < num && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		retval = arm_cti_queue_read_reg(armv8->cti, CTI_GATE, &pes[i].gate);
 		if (retval == ERROR_OK)
-			retval = aarch64_set_dscr_bits(curr, DSCR_HDE, DSCR_HDE);
-		if (retval != ERROR_OK)
-			break;
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, &pes[i].dscr);
+	}
+	if (retval == ERROR_OK && num)
+		retval = aarch64_smp_run(pes, num);
+
+	for (i = 0; i < num && retval == ERROR_OK; i++) {
+		struct armv8_common *armv8 = target_to_armv8(pes[i].target);
+
+		retval = arm_cti_queue_write_reg(armv8->cti, CTI_GATE,
+				pes[i].gate | CTI_CHNL(0));
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, pes[i].dscr | DSCR_HDE);
+	}
+	if (retval == ERROR_OK && num)
+		retval = aarch64_smp_run(pes, num);
+
+	for (i = 0; i < num && retval == ERROR_OK; i++) {
+		struct target *curr = pes[i].target;
+
+		/* HACK: mark this target as prepared for halting */
+		curr->debug_reason = DBG_REASON_DBGRQ;
 
 		LOG_DEBUG("target %s prepared", target_name(curr));
 
@@ -354,6 +453,8 @@ static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, stru
 			first = curr;
 	}
 
+	free(pes);
+
 	if (p_first) {
 		if (exc_target && first)
 			*p_first = first;
@@ -411,23 +512,26 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 	if (retval != ERROR_OK)
 		return retval;
 
+	struct aarch64_smp_pe *pes;
+	unsigned int num;
+
+	retval = aarch64_smp_get_pes(target, &pes, &num);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* wait for all PEs to halt */
 	int64_t then = timeval_ms();
 	for (;;) {
 		bool all_halted = true;
-		struct target_list *head;
-		struct target *curr;
-
-		foreach_smp_target(head, target->head) {
-			int halted;
-
-			curr = head->target;
+		struct target *curr = target;
 
-			if (!target_was_examined(curr))
-				continue;
+		retval = aarch64_smp_read_prsr(pes, num);
+		if (retval != ERROR_OK)
+			break;
 
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
+		for (unsigned int i = 0; i < num; i++) {
+			if (!(pes[i].prsr & PRSR_HALT)) {
+				curr = pes[i].target;
 				all_halted = false;
 				break;
 			}
@@ -453,6 +557,7 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 			break;
 	}
 
+	free(pes);
 	return retval;
 }
 
@@ -525,7 +630,7 @@ static int aarch64_poll(struct target *target)
 			if (retval != ERROR_OK)
 				return retval;
 
-			if (target->smp)
+			if (target->smp && !target->smp_nonstop)
 				update_halt_gdb(target, debug_reason);
 
 			if (arm_semihosting(target, &retval) != 0)
@@ -555,7 +660,7 @@ static int aarch64_halt(struct target *target)
 	struct armv8_common *armv8 = target_to_armv8(target);
 	armv8->last_run_control_op = ARMV8_RUNCONTROL_HALT;
 
-	if (target->smp)
+	if (target->smp && !target->smp_nonstop)
 		return aarch64_halt_smp(target, false);
 
 	return aarch64_halt_one(target, HALT_SYNC);
@@ -764,45 +869,40 @@ static int aarch64_prep_restart_smp(struct target *target, int handle_breakpoint
 }
 
 
-static int aarch64_step_restart_smp(struct target *target)
+/*
+ * wait for the PEs of the SMP group of @a target, but @a target itself,
+ * to leave debug state after a restart through the CTM
+ */
+static int aarch64_wait_restart_smp(struct target *target)
 {
-	int retval = ERROR_OK;
-	struct target_list *head;
-	struct target *first = NULL;
-
-	LOG_DEBUG("%s", target_name(target));
+	struct aarch64_smp_pe *pes;
+	unsigned int num;
+	int retval;
 
-	retval = aarch64_prep_restart_smp(target, 0, &first);
+	retval = aarch64_smp_get_pes(target, &pes, &num);
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (first != NULL)
-		retval = aarch64_do_restart_one(first, RESTART_LAZY);
-	if (retval != ERROR_OK) {
-		LOG_DEBUG("error restarting target %s", target_name(first));
-		return retval;
-	}
-
 	int64_t then = timeval_ms();
 	for (;;) {
 		struct target *curr = target;
 		bool all_resumed = true;
 
-		foreach_smp_target(head, target->head) {
-			uint32_t prsr;
-			int resumed;
+		retval = aarch64_smp_read_prsr(pes, num);
+		if (retval != ERROR_OK)
+			break;
 
-			curr = head->target;
+		for (unsigned int i = 0; i < num; i++) {
+			curr = pes[i].target;
 
 			if (curr == target)
 				continue;
 
-			if (!target_was_examined(curr))
-				continue;
-
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
+			/*
+			 * if PRSR.SDR is set, the PE did restart, even if it's
+			 * now already halted again (e.g. due to breakpoint)
+			 */
+			if (!(pes[i].prsr & PRSR_SDR) && (pes[i].prsr & PRSR_HALT)) {
 				all_resumed = false;
 				break;
 			}
@@ -818,10 +918,11 @@ static int aarch64_step_restart_smp(struct target *target)
 			break;
 
 		if (timeval_ms() > then + 1000) {
-			LOG_ERROR("%s: timeout waiting for target resume", __func__);
+			LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
 			retval = ERROR_TARGET_TIMEOUT;
 			break;
 		}
+
 		/*
 		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
 		 * and it looks like the CTI's are not connected by a common
@@ -832,11 +933,33 @@ static int aarch64_step_restart_smp(struct target *target)
 		retval = aarch64_do_restart_one(curr, RESTART_LAZY);
 		if (retval != ERROR_OK)
 			break;
-}
+	}
 
+	free(pes);
 	return retval;
 }
 
+static int aarch64_step_restart_smp(struct target *target)
+{
+	int retval = ERROR_OK;
+	struct target *first = NULL;
+
+	LOG_DEBUG("%s", target_name(target));
+
+	retval = aarch64_prep_restart_smp(target, 0, &first);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (first != NULL)
+		retval = aarch64_do_restart_one(first, RESTART_LAZY);
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("error restarting target %s", target_name(first));
+		return retval;
+	}
+
+	return aarch64_wait_restart_smp(target);
+}
+
 static int aarch64_resume(struct target *target, int current,
 	target_addr_t address, int handle_breakpoints, int debug_execution)
 {
@@ -855,7 +978,7 @@ static int aarch64_resume(struct target *target, int current,
 	 * target register context and setting up CTI gates to accept
 	 * resume events from the trigger matrix.
 	 */
-	if (target->smp) {
+	if (target->smp && !target->smp_nonstop) {
 		retval = aarch64_prep_restart_smp(target, handle_breakpoints, NULL);
 		if (retval != ERROR_OK)
 			return retval;
@@ -869,58 +992,8 @@ static int aarch64_resume(struct target *target, int current,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (target->smp) {
-		int64_t then = timeval_ms();
-		for (;;) {
-			struct target *curr = target;
-			struct target_list *head;
-			bool all_resumed = true;
-
-			foreach_smp_target(head, target->head) {
-				uint32_t prsr;
-				int resumed;
-
-				curr = head->target;
-				if (curr == target)
-					continue;
-				if (!target_was_examined(curr))
-					continue;
-
-				retval = aarch64_check_state_one(curr,
-						PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-				if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-					all_resumed = false;
-					break;
-				}
-
-				if (curr->state != TARGET_RUNNING) {
-					curr->state = TARGET_RUNNING;
-					curr->debug_reason = DBG_REASON_NOTHALTED;
-					target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-				}
-			}
-
-			if (all_resumed)
-				break;
-
-			if (timeval_ms() > then + 1000) {
-				LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
-				retval = ERROR_TARGET_TIMEOUT;
-				break;
-			}
-
-			/*
-			 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-			 * and it looks like the CTI's are not connected by a common
-			 * trigger matrix. It seems that we need to halt one core in each
-			 * cluster explicitly. So if we find that a core has not halted
-			 * yet, we trigger an explicit resume for the second cluster.
-			 */
-			retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	if (target->smp && !target->smp_nonstop)
+		retval = aarch64_wait_restart_smp(target);
 
 	if (retval != ERROR_OK)
 		return retval;
@@ -1111,7 +1184,7 @@ static int aarch64_step(struct target *target, int current, target_addr_t addres
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (target->smp && (current == 1)) {
+	if (target->smp && !target->smp_nonstop && (current == 1)) {
 		/*
 		 * isolate current target so that it doesn't get resumed
 		 * together with the others
@@ -2222,11 +2295,12 @@ static int aarch64_handle_target_request(void *priv)
 	if (!target->dbg_msg_enabled)
 		return ERROR_OK;
 
-	if (target->state == TARGET_RUNNING) {
+	if (target->state == TARGET_RUNNING && target_request_poll_due(target)) {
 		uint32_t request;
 		uint32_t dscr;
 		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
 				armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+		target_request_polled(target, retval == ERROR_OK && (dscr & DSCR_DTR_TX_FULL));
 
 		/* check if we have data */
 		while ((dscr & DSCR_DTR_TX_FULL) && (retval == ERROR_OK)) {
@@ -2456,6 +2530,46 @@ static void aarch64_deinit_target(struct target *target)
 	free(aarch64);
 }
 
+static int aarch64_profiling(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	uint32_t devid;
+	int retval;
+
+	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_EDDEVID, &devid);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* EDDEVID.PCSample, EDPCSR is implemented from 2 on */
+	if ((devid & 0xf) < 2)
+		return target_profiling_default(target, samples, max_num_samples,
+				num_samples, seconds);
+
+	/* Make sure the target is running */
+	target_poll(target);
+	if (target->state == TARGET_HALTED) {
+		retval = target_resume(target, 1, 0, 0, 0);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Error while resuming target");
+			return retval;
+		}
+	}
+
+	/* reading EDPCSRlo captures the sample, only 32 bit PCs are profiled */
+	LOG_INFO("Starting profiling. Sampling EDPCSR as fast as we can...");
+	retval = mem_ap_sample_pc(armv8->debug_ap, armv8->debug_base + CPUV8_DBG_EDPCSR,
+			samples, max_num_samples, num_samples, seconds);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error while reading EDPCSR");
+		return retval;
+	}
+
+	LOG_INFO("Profiling completed. %" PRIu32 " samples.", *num_samples);
+	return ERROR_OK;
+}
+
 static int aarch64_mmu(struct target *target, int *enabled)
 {
 	if (target->state != TARGET_HALTED) {
@@ -2772,6 +2886,9 @@ static int jim_mcrmrc(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 		retval = arm->mcr(target, cpnum, op1, op2, CRn, CRm, value);
 		if (retval != ERROR_OK)
 			return JIM_ERR;
+		/* the translation tables may have moved */
+		if (arm->dpm)
+			arm_dpm_tlb_flush(arm->dpm);
 	} else {
 		/* NOTE: parameters reordered! */
 		/* ARMV4_5_MRC(cpnum, op1, 0, CRn, CRm, op2) */
@@ -2897,4 +3014,5 @@ struct target_type aarch64_target = {
 	.write_phys_memory = aarch64_write_phys_memory,
 	.mmu = aarch64_mmu,
 	.virt2phys = aarch64_virt2phys,
+	.profiling = aarch64_profiling,
 };
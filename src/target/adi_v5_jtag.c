@@ -37,7 +37,6 @@
 #include "arm.h"
 #include "arm_adi_v5.h"
 #include <helper/time_support.h>
-#include <helper/list.h>
 #include <jtag/swd.h>
 
 /*#define DEBUG_WAIT*/
@@ -125,7 +124,8 @@ static const char *dap_reg_name(int instr, int reg_addr)
 #endif
 
 struct dap_cmd {
-	struct list_head lh;
+	/* next free object while in the pool */
+	struct dap_cmd *next_free;
 	uint8_t instr;
 	uint8_t reg_addr;
 	uint8_t RnW;
@@ -142,10 +142,17 @@ struct dap_cmd {
 
 #define MAX_DAP_COMMAND_NUM 65536
 
-struct dap_cmd_pool {
-	struct list_head lh;
-	struct dap_cmd cmd;
-} dap_cmd_pool;
+/* Commands WAIT recovery and the end of transaction check may need on
+ * top of a full queue of MAX_DAP_COMMAND_NUM */
+#define DAP_CMD_RESERVE 16
+#define DAP_CMD_CAPACITY (MAX_DAP_COMMAND_NUM + DAP_CMD_RESERVE)
+
+/* dap_cmd objects are carved from chunks that stay in place until
+ * jtag_quit(), the JTAG queue points into them until it is executed */
+#define DAP_CMD_CHUNK_SIZE 1024
+#define DAP_CMD_CHUNKS DIV_ROUND_UP(DAP_CMD_CAPACITY, DAP_CMD_CHUNK_SIZE)
+/* all the objects the pool can hand out, each is in the journal at most once */
+#define DAP_CMD_POOL_SIZE (DAP_CMD_CHUNKS * DAP_CMD_CHUNK_SIZE)
 
 static void log_dap_cmd(const char *header, struct dap_cmd *el)
 {
@@ -169,28 +176,52 @@ static int jtag_limit_queue_size(struct adiv5_dap *dap)
 	return dap_run(dap);
 }
 
+/* Add a chunk of free dap_cmd objects to the pool */
+static int dap_cmd_pool_grow(struct adiv5_dap *dap)
+{
+	if (dap->cmd_chunks == NULL) {
+		dap->cmd_chunks = calloc(DAP_CMD_CHUNKS, sizeof(*dap->cmd_chunks));
+		dap->cmd_journal = calloc(DAP_CMD_POOL_SIZE, sizeof(*dap->cmd_journal));
+		if (dap->cmd_chunks == NULL || dap->cmd_journal == NULL) {
+			free(dap->cmd_chunks);
+			free(dap->cmd_journal);
+			dap->cmd_chunks = NULL;
+			dap->cmd_journal = NULL;
+			return ERROR_FAIL;
+		}
+	}
+
+	if (dap->cmd_chunk_count == DAP_CMD_CHUNKS) {
+		LOG_ERROR("BUG: DAP command pool exhausted");
+		return ERROR_FAIL;
+	}
+
+	struct dap_cmd *chunk = calloc(DAP_CMD_CHUNK_SIZE, sizeof(*chunk));
+	if (chunk == NULL)
+		return ERROR_FAIL;
+	dap->cmd_chunks[dap->cmd_chunk_count++] = chunk;
+
+	for (int i = DAP_CMD_CHUNK_SIZE - 1; i >= 0; i--) {
+		chunk[i].next_free = dap->cmd_free;
+		dap->cmd_free = &chunk[i];
+	}
+
+	return ERROR_OK;
+}
+
 static struct dap_cmd *dap_cmd_new(struct adiv5_dap *dap, uint8_t instr,
 		uint8_t reg_addr, uint8_t RnW,
 		uint8_t *outvalue, uint8_t *invalue,
 		uint32_t memaccess_tck)
 {
+	if (dap->cmd_free == NULL && dap_cmd_pool_grow(dap) != ERROR_OK)
+		return NULL;
 
-	struct dap_cmd_pool *pool = NULL;
-
-	if (list_empty(&dap->cmd_pool)) {
-		pool = calloc(1, sizeof(struct dap_cmd_pool));
-		if (pool == NULL)
-			return NULL;
-	} else {
-		pool = list_first_entry(&dap->cmd_pool, struct dap_cmd_pool, lh);
-		list_del(&pool->lh);
-	}
-
-	INIT_LIST_HEAD(&pool->lh);
+	struct dap_cmd *cmd = dap->cmd_free;
+	dap->cmd_free = cmd->next_free;
 	dap->cmd_pool_size++;
 
-	struct dap_cmd *cmd = &pool->cmd;
-	INIT_LIST_HEAD(&cmd->lh);
+	cmd->next_free = NULL;
 	cmd->instr = instr;
 	cmd->reg_addr = reg_addr;
 	cmd->RnW = RnW;
@@ -204,34 +235,31 @@ static struct dap_cmd *dap_cmd_new(struct adiv5_dap *dap, uint8_t instr,
 
 static void dap_cmd_release(struct adiv5_dap *dap, struct dap_cmd *cmd)
 {
-	struct dap_cmd_pool *pool = container_of(cmd, struct dap_cmd_pool, cmd);
-	if (dap->cmd_pool_size > MAX_DAP_COMMAND_NUM)
-		free(pool);
-	else
-		list_add(&pool->lh, &dap->cmd_pool);
-
+	cmd->next_free = dap->cmd_free;
+	dap->cmd_free = cmd;
 	dap->cmd_pool_size--;
 }
 
-static void flush_journal(struct adiv5_dap *dap, struct list_head *lh)
+static void flush_journal(struct adiv5_dap *dap)
 {
-	struct dap_cmd *el, *tmp;
-
-	list_for_each_entry_safe(el, tmp, lh, lh) {
-		list_del(&el->lh);
-		dap_cmd_release(dap, el);
-	}
+	for (size_t i = 0; i < dap->cmd_journal_len; i++)
+		dap_cmd_release(dap, dap->cmd_journal[i]);
+	dap->cmd_journal_len = 0;
 }
 
 static void jtag_quit(struct adiv5_dap *dap)
 {
-	struct dap_cmd_pool *el, *tmp;
-	struct list_head *lh = &dap->cmd_pool;
-
-	list_for_each_entry_safe(el, tmp, lh, lh) {
-		list_del(&el->lh);
-		free(el);
-	}
+	flush_journal(dap);
+
+	for (size_t i = 0; i < dap->cmd_chunk_count; i++)
+		free(dap->cmd_chunks[i]);
+	free(dap->cmd_chunks);
+	free(dap->cmd_journal);
+	dap->cmd_chunks = NULL;
+	dap->cmd_journal = NULL;
+	dap->cmd_chunk_count = 0;
+	dap->cmd_free = NULL;
+	dap->cmd_pool_size = 0;
 }
 
 /***************************************************************************
@@ -329,8 +357,12 @@ static int adi_jtag_dp_scan(struct adiv5_dap *dap,
 		return ERROR_JTAG_DEVICE_ERROR;
 
 	retval = adi_jtag_dp_scan_cmd(dap, cmd, ack);
-	if (retval == ERROR_OK)
-		list_add_tail(&cmd->lh,	&dap->cmd_journal);
+	if (retval == ERROR_OK) {
+		assert(dap->cmd_journal_len < DAP_CMD_POOL_SIZE);
+		dap->cmd_journal[dap->cmd_journal_len++] = cmd;
+	}
+	else
+		dap_cmd_release(dap, cmd);
 
 	return retval;
 }
@@ -401,13 +433,48 @@ static int adi_jtag_scan_inout_check_u32(struct adiv5_dap *dap,
 	return jtag_execute_queue();
 }
 
+/* Synchronously retry @a el until it is not answered with WAIT any more */
+static int jtagdp_replay_cmd(struct adiv5_dap *dap, struct dap_cmd *el)
+{
+	int retval;
+	int64_t time_now = timeval_ms();
+
+	do {
+		retval = adi_jtag_dp_scan_cmd_sync(dap, el, NULL);
+		if (retval != ERROR_OK)
+			return retval;
+		log_dap_cmd("REC", el);
+		if (el->ack == JTAG_ACK_OK_FAULT) {
+			if (el->invalue != el->invalue_buf) {
+				uint32_t invalue = le_to_h_u32(el->invalue);
+				memcpy(el->invalue, &invalue, sizeof(uint32_t));
+			}
+			return ERROR_OK;
+		}
+		if (el->ack != JTAG_ACK_WAIT) {
+			LOG_ERROR("Invalid ACK (%1x) in DAP response", el->ack);
+			log_dap_cmd("ERR", el);
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+	} while (timeval_ms() - time_now < 1000);
+
+	LOG_ERROR("Timeout during WAIT recovery");
+	dap->select = DP_SELECT_INVALID;
+	jtag_ap_q_abort(dap, NULL);
+	/* clear the sticky overrun condition */
+	adi_jtag_scan_inout_check_u32(dap, JTAG_DP_DPACC,
+		DP_CTRL_STAT, DPAP_WRITE,
+		dap->dp_ctrl_stat | SSTICKYORUN, NULL, 0);
+	return ERROR_JTAG_DEVICE_ERROR;
+}
+
 static int jtagdp_overrun_check(struct adiv5_dap *dap)
 {
 	int retval;
-	struct dap_cmd *el, *tmp, *prev = NULL;
+	struct dap_cmd *el = NULL, *tmp, *prev = NULL;
+	size_t wait_idx;
 	int found_wait = 0;
 	int64_t time_now;
-	LIST_HEAD(replay_list);
 
 	/* make sure all queued transactions are complete */
 	retval = jtag_execute_queue();
@@ -415,7 +482,8 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		goto done;
 
 	/* skip all completed transactions up to the first WAIT */
-	list_for_each_entry(el, &dap->cmd_journal, lh) {
+	for (wait_idx = 0; wait_idx < dap->cmd_journal_len; wait_idx++) {
+		el = dap->cmd_journal[wait_idx];
 		if (el->ack == JTAG_ACK_OK_FAULT) {
 			log_dap_cmd("LOG", el);
 		} else if (el->ack == JTAG_ACK_WAIT) {
@@ -429,18 +497,22 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		}
 	}
 
+	/* the transactions from the WAIT on have to be replayed, commands
+	 * queued during the recovery are appended behind them */
+	size_t replay_end = dap->cmd_journal_len;
+
 	/*
 	 * If we found a stalled transaction and a previous transaction
 	 * exists, check if it's a READ access.
 	 */
-	if (found_wait && el != list_first_entry(&dap->cmd_journal, struct dap_cmd, lh)) {
-		prev = list_entry(el->lh.prev, struct dap_cmd, lh);
+	if (found_wait && wait_idx > 0) {
+		prev = dap->cmd_journal[wait_idx - 1];
 		if (prev->RnW == DPAP_READ) {
 			log_dap_cmd("PND", prev);
 			/* search for the next OK transaction, it contains
 			 * the result of the previous READ */
-			tmp = el;
-			list_for_each_entry_from(tmp, &dap->cmd_journal, lh) {
+			for (size_t i = wait_idx; i < replay_end; i++) {
+				tmp = dap->cmd_journal[i];
 				if (tmp->ack == JTAG_ACK_OK_FAULT) {
 					/* recover the read value */
 					log_dap_cmd("FND", tmp);
@@ -521,18 +593,16 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 		}
 	}
 
-	/* move all remaining transactions over to the replay list */
-	list_for_each_entry_safe_from(el, tmp, &dap->cmd_journal, lh) {
-		log_dap_cmd("REP", el);
-		list_move_tail(&el->lh, &replay_list);
-	}
-
-	/* we're done with the journal, flush it */
-	flush_journal(dap, &dap->cmd_journal);
+	for (size_t i = wait_idx; i < replay_end; i++)
+		log_dap_cmd("REP", dap->cmd_journal[i]);
 
 	/* check for overrun condition in the last batch of transactions */
 	if (found_wait) {
+		dap->wait_recoveries++;
+		dap->wait_replayed += replay_end - wait_idx;
 		LOG_INFO("DAP transaction stalled (WAIT) - slowing down");
+		LOG_DEBUG("WAIT recovery #%" PRIu64 ", replaying %zu transactions",
+				dap->wait_recoveries, replay_end - wait_idx);
 		/* clear the sticky overrun condition */
 		retval = adi_jtag_scan_inout_check_u32(dap, JTAG_DP_DPACC,
 				DP_CTRL_STAT, DPAP_WRITE,
@@ -541,61 +611,27 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 			goto done;
 
 		/* restore SELECT register first */
-		if (!list_empty(&replay_list)) {
-			el = list_first_entry(&replay_list, struct dap_cmd, lh);
+		if (wait_idx < replay_end) {
+			el = dap->cmd_journal[wait_idx];
 			tmp = dap_cmd_new(dap, JTAG_DP_DPACC,
 					  DP_SELECT, DPAP_WRITE, (uint8_t *)&el->dp_select, NULL, 0);
 			if (tmp == NULL) {
 				retval = ERROR_JTAG_DEVICE_ERROR;
 				goto done;
 			}
-			list_add(&tmp->lh, &replay_list);
 
 			dap->select = DP_SELECT_INVALID;
-		}
 
-		list_for_each_entry_safe(el, tmp, &replay_list, lh) {
-			time_now = timeval_ms();
-			do {
-				retval = adi_jtag_dp_scan_cmd_sync(dap, el, NULL);
-				if (retval != ERROR_OK)
-					break;
-				log_dap_cmd("REC", el);
-				if (el->ack == JTAG_ACK_OK_FAULT) {
-					if (el->invalue != el->invalue_buf) {
-						uint32_t invalue = le_to_h_u32(el->invalue);
-						memcpy(el->invalue, &invalue, sizeof(uint32_t));
-					}
-					break;
-				}
-				if (el->ack != JTAG_ACK_WAIT) {
-					LOG_ERROR("Invalid ACK (%1x) in DAP response", el->ack);
-					log_dap_cmd("ERR", el);
-					retval = ERROR_JTAG_DEVICE_ERROR;
-					break;
-				}
-			} while (timeval_ms() - time_now < 1000);
-
-			if (retval == ERROR_OK) {
-				if (el->ack != JTAG_ACK_OK_FAULT) {
-					LOG_ERROR("Timeout during WAIT recovery");
-					dap->select = DP_SELECT_INVALID;
-					jtag_ap_q_abort(dap, NULL);
-					/* clear the sticky overrun condition */
-					adi_jtag_scan_inout_check_u32(dap, JTAG_DP_DPACC,
-						DP_CTRL_STAT, DPAP_WRITE,
-						dap->dp_ctrl_stat | SSTICKYORUN, NULL, 0);
-					retval = ERROR_JTAG_DEVICE_ERROR;
-					break;
-				}
-			} else
-				break;
+			retval = jtagdp_replay_cmd(dap, tmp);
+			dap_cmd_release(dap, tmp);
 		}
+
+		for (size_t i = wait_idx; i < replay_end && retval == ERROR_OK; i++)
+			retval = jtagdp_replay_cmd(dap, dap->cmd_journal[i]);
 	}
 
  done:
-	flush_journal(dap, &replay_list);
-	flush_journal(dap, &dap->cmd_journal);
+	flush_journal(dap);
 	return retval;
 }
 
@@ -644,7 +680,7 @@ static int jtagdp_transaction_endcheck(struct adiv5_dap *dap)
 	}
 
  done:
-	flush_journal(dap, &dap->cmd_journal);
+	flush_journal(dap);
 	return retval;
 }
 
@@ -718,8 +754,10 @@ static int jtag_ap_q_bankselect(struct adiv5_ap *ap, unsigned reg)
 	struct adiv5_dap *dap = ap->dap;
 	uint32_t sel = ((uint32_t)ap->ap_num << 24) | (reg & 0x000000F0);
 
-	if (sel == dap->select)
+	if (sel == dap->select) {
+		dap->select_writes_skipped++;
 		return ERROR_OK;
+	}
 
 	dap->select = sel;
 
@@ -24,7 +24,7 @@
  * is a transport level interface, with "target/arm_adi_v5.[hc]" code
  * understanding operation semantics, shared with the JTAG transport.
  *
- * Single-DAP support only.
+ * Several DPs may share the link with SWD multi-drop (DPv2 TARGETSEL).
  *
  * for details, see "ARM IHI 0031A"
  * ARM Debug Interface v5 Architecture Specification
@@ -55,6 +55,9 @@
 
 static bool do_sync;
 
+/* DP currently selected by TARGETSEL on a multi-drop link */
+static struct adiv5_dap *swd_multidrop_selected_dap;
+
 static void swd_finish_read(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
@@ -83,9 +86,12 @@ static int swd_run_inner(struct adiv5_dap *dap)
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	int retval;
 
+	int64_t stats_start = adapter_stats_queue_start();
 	retval = swd->run();
+	adapter_stats_queue_done(stats_start);
 
-	if (retval != ERROR_OK) {
+	/* a value which did not match is no fault */
+	if (retval != ERROR_OK && retval != ERROR_TIMEOUT_REACHED) {
 		/* fault response */
 		dap->do_reconnect = true;
 	}
@@ -93,6 +99,68 @@ static int swd_run_inner(struct adiv5_dap *dap)
 	return retval;
 }
 
+/**
+ * Line reset, then TARGETSEL and DPIDR read to select this DP of a
+ * multi-drop link. A line reset does not change SELECT, so the SELECT
+ * cache of the DP stays valid. The queue is run before returning.
+ */
+static int swd_multidrop_targetsel(struct adiv5_dap *dap, uint32_t *dpidr)
+{
+	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+
+	swd->switch_seq(LINE_RESET);
+	/* no ACK, the deselected DPs and the selected one all stay silent */
+	swd->write_reg(swd_cmd(false, false, DP_TARGETSEL), dap->multidrop_targetsel, 0);
+	/* a DP is left in lockout state until DPIDR is read */
+	swd->read_reg(swd_cmd(true, false, DP_DPIDR), dpidr, 0);
+
+	int retval = swd->run();
+	if (retval != ERROR_OK) {
+		swd_multidrop_selected_dap = NULL;
+		LOG_ERROR("No DP answers to TARGETSEL 0x%08" PRIx32, dap->multidrop_targetsel);
+		return retval;
+	}
+
+	swd_multidrop_selected_dap = dap;
+	dap->multidrop_switches++;
+	LOG_DEBUG_IO("Selected DP, TARGETSEL 0x%08" PRIx32, dap->multidrop_targetsel);
+	return ERROR_OK;
+}
+
+/* Transactions queued for the selected DP have to reach it before the link
+ * is switched to another one */
+static int swd_multidrop_flush(void)
+{
+	struct adiv5_dap *prev = swd_multidrop_selected_dap;
+	if (!prev)
+		return ERROR_OK;
+
+	swd_finish_read(prev);
+	int retval = adiv5_dap_swd_driver(prev)->run();
+	if (retval != ERROR_OK)
+		prev->do_reconnect = true;
+
+	return retval;
+}
+
+/** Switch a multi-drop link to @a dap unless it is selected already */
+static int swd_multidrop_select(struct adiv5_dap *dap)
+{
+	if (!dap->multidrop || swd_multidrop_selected_dap == dap)
+		return ERROR_OK;
+
+	int retval = swd_multidrop_flush();
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t dpidr;
+	retval = swd_multidrop_targetsel(dap, &dpidr);
+	if (retval != ERROR_OK)
+		dap->do_reconnect = true;
+
+	return retval;
+}
+
 static int swd_connect(struct adiv5_dap *dap)
 {
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
@@ -118,14 +186,31 @@ static int swd_connect(struct adiv5_dap *dap)
 		}
 	}
 
-	/* Note, debugport_init() does setup too */
-	swd->switch_seq(JTAG_TO_SWD);
-
 	/* Clear link state, including the SELECT cache. */
 	dap->do_reconnect = false;
 	dap_invalidate_cache(dap);
 
-	swd_queue_dp_read(dap, DP_DPIDR, &dpidr);
+	if (dap->multidrop) {
+		status = swd_multidrop_flush();
+		if (status != ERROR_OK)
+			LOG_DEBUG("queue of the previously selected DP failed");
+
+		/* multi-drop DPs are SWD only and may start out dormant */
+		swd->switch_seq(DORMANT_TO_SWD);
+		status = swd_multidrop_targetsel(dap, &dpidr);
+		if (status != ERROR_OK) {
+			dap->do_reconnect = true;
+			return status;
+		}
+		if (((dpidr & DP_DPIDR_VERSION_MASK) >> DP_DPIDR_VERSION_SHIFT) < 2)
+			LOG_WARNING("DP with TARGETSEL 0x%08" PRIx32 " is not DPv2, multi-drop "
+					"needs DPv2", dap->multidrop_targetsel);
+	} else {
+		/* Note, debugport_init() does setup too */
+		swd->switch_seq(JTAG_TO_SWD);
+
+		swd_queue_dp_read(dap, DP_DPIDR, &dpidr);
+	}
 
 	/* force clear all sticky faults */
 	swd_clear_sticky_errors(dap);
@@ -160,7 +245,7 @@ static int swd_check_reconnect(struct adiv5_dap *dap)
 	if (dap->do_reconnect)
 		return swd_connect(dap);
 
-	return ERROR_OK;
+	return swd_multidrop_select(dap);
 }
 
 static int swd_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
@@ -168,6 +253,10 @@ static int swd_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
 	assert(swd);
 
+	int retval = swd_multidrop_select(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
 	swd->write_reg(swd_cmd(false,  false, DP_ABORT),
 		DAPABORT | STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR, 0);
 	return check_sync(dap);
@@ -184,8 +273,10 @@ static int swd_queue_dp_bankselect(struct adiv5_dap *dap, unsigned reg)
 	uint32_t sel = select_dp_bank
 			| (dap->select & (DP_SELECT_APSEL | DP_SELECT_APBANK));
 
-	if (sel == dap->select)
+	if (sel == dap->select) {
+		dap->select_writes_skipped++;
 		return ERROR_OK;
+	}
 
 	dap->select = sel;
 
@@ -255,8 +346,10 @@ static int swd_queue_ap_bankselect(struct adiv5_ap *ap, unsigned reg)
 			| (reg & 0x000000F0)
 			| (dap->select & DP_SELECT_DPBANK);
 
-	if (sel == dap->select)
+	if (sel == dap->select) {
+		dap->select_writes_skipped++;
 		return ERROR_OK;
+	}
 
 	dap->select = sel;
 
@@ -288,6 +381,32 @@ static int swd_queue_ap_read(struct adiv5_ap *ap, unsigned reg,
 	return check_sync(dap);
 }
 
+static int swd_queue_ap_read_match(struct adiv5_ap *ap, unsigned reg,
+		uint32_t mask, uint32_t match)
+{
+	struct adiv5_dap *dap = ap->dap;
+	const struct swd_driver *swd = adiv5_dap_swd_driver(dap);
+	assert(swd);
+
+	if (swd->read_reg_match == NULL)
+		return ERROR_NOT_IMPLEMENTED;
+
+	int retval = swd_check_reconnect(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = swd_queue_ap_bankselect(ap, reg);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the adapter does not post the matched read, collect the
+	 * result of a previous read before */
+	swd_finish_read(dap);
+	swd->read_reg_match(swd_cmd(true,  true, reg), mask, match, ap->memaccess_tck);
+
+	return check_sync(dap);
+}
+
 static int swd_queue_ap_write(struct adiv5_ap *ap, unsigned reg,
 		uint32_t data)
 {
@@ -334,6 +453,7 @@ const struct dap_ops swd_dap_ops = {
 	.queue_ap_read = swd_queue_ap_read,
 	.queue_ap_write = swd_queue_ap_write,
 	.queue_ap_abort = swd_queue_ap_abort,
+	.queue_ap_read_match = swd_queue_ap_read_match,
 	.run = swd_run,
 	.quit = swd_quit,
 };
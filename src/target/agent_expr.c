@@ -0,0 +1,342 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * GDB agent expressions, see "Agent Expressions" in the GDB manual. The
+ * integer subset is implemented, which is what GDB generates for
+ * breakpoint conditions; floating point, tracing and trace state
+ * variables are rejected.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "agent_expr.h"
+#include "target.h"
+#include "register.h"
+#include <helper/binarybuffer.h>
+#include <helper/log.h>
+
+#define AGENT_EXPR_STACK_SIZE	64
+/* bound the run time of expressions with loops */
+#define AGENT_EXPR_MAX_STEPS	10000
+
+enum agent_op {
+	AX_ADD = 0x02,
+	AX_SUB = 0x03,
+	AX_MUL = 0x04,
+	AX_DIV_SIGNED = 0x05,
+	AX_DIV_UNSIGNED = 0x06,
+	AX_REM_SIGNED = 0x07,
+	AX_REM_UNSIGNED = 0x08,
+	AX_LSH = 0x09,
+	AX_RSH_SIGNED = 0x0a,
+	AX_RSH_UNSIGNED = 0x0b,
+	AX_LOG_NOT = 0x0e,
+	AX_BIT_AND = 0x0f,
+	AX_BIT_OR = 0x10,
+	AX_BIT_XOR = 0x11,
+	AX_BIT_NOT = 0x12,
+	AX_EQUAL = 0x13,
+	AX_LESS_SIGNED = 0x14,
+	AX_LESS_UNSIGNED = 0x15,
+	AX_EXT = 0x16,
+	AX_REF8 = 0x17,
+	AX_REF16 = 0x18,
+	AX_REF32 = 0x19,
+	AX_REF64 = 0x1a,
+	AX_IF_GOTO = 0x20,
+	AX_GOTO = 0x21,
+	AX_CONST8 = 0x22,
+	AX_CONST16 = 0x23,
+	AX_CONST32 = 0x24,
+	AX_CONST64 = 0x25,
+	AX_REG = 0x26,
+	AX_END = 0x27,
+	AX_DUP = 0x28,
+	AX_POP = 0x29,
+	AX_ZERO_EXT = 0x2a,
+	AX_SWAP = 0x2b,
+	AX_PICK = 0x32,
+	AX_ROT = 0x33,
+};
+
+struct agent_expr_state {
+	struct target *target;
+	const struct agent_expr *expr;
+	size_t pc;
+	int64_t stack[AGENT_EXPR_STACK_SIZE];
+	unsigned int sp;
+	/* the GDB register list, fetched on the first reg */
+	struct reg **reg_list;
+	int reg_list_size;
+};
+
+/* @returns the @a n bytes big endian immediate operand at the pc */
+static bool agent_expr_operand(struct agent_expr_state *s, unsigned int n, uint64_t *value)
+{
+	if (s->pc + n > s->expr->len)
+		return false;
+
+	*value = 0;
+	for (unsigned int i = 0; i < n; i++)
+		*value = (*value << 8) | s->expr->bytecode[s->pc++];
+	return true;
+}
+
+static int agent_expr_reg(struct agent_expr_state *s, unsigned int num, int64_t *value)
+{
+	int retval;
+
+	if (!s->reg_list) {
+		retval = target_get_gdb_reg_list(s->target, &s->reg_list,
+				&s->reg_list_size, REG_CLASS_ALL);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (num >= (unsigned int)s->reg_list_size)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	struct reg *reg = s->reg_list[num];
+	if (!reg || !reg->exist || !reg->size)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	if (!reg->valid) {
+		retval = reg->type->get(reg);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	*value = buf_get_u64(reg->value, 0, MIN(reg->size, 64));
+	return ERROR_OK;
+}
+
+static int agent_expr_ref(struct agent_expr_state *s, unsigned int size,
+		target_addr_t address, int64_t *value)
+{
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	int retval;
+
+	switch (size) {
+	case 1:
+		retval = target_read_u8(s->target, address, &u8);
+		*value = u8;
+		break;
+	case 2:
+		retval = target_read_u16(s->target, address, &u16);
+		*value = u16;
+		break;
+	case 4:
+		retval = target_read_u32(s->target, address, &u32);
+		*value = u32;
+		break;
+	default:
+		retval = target_read_u64(s->target, address, &u64);
+		*value = u64;
+		break;
+	}
+
+	return retval;
+}
+
+static int64_t agent_expr_sign_extend(uint64_t value, unsigned int bits)
+{
+	if (bits == 0 || bits >= 64)
+		return value;
+	uint64_t sign = 1ULL << (bits - 1);
+	value &= (sign << 1) - 1;
+	return (value ^ sign) - sign;
+}
+
+static int agent_expr_run(struct agent_expr_state *s, int64_t *result)
+{
+	const struct agent_expr *expr = s->expr;
+	uint64_t operand;
+	int64_t a, b;
+	int retval;
+
+#define POP(x)	do { if (s->sp == 0) goto underflow; x = s->stack[--s->sp]; } while (0)
+#define PUSH(x)	do { if (s->sp == AGENT_EXPR_STACK_SIZE) goto overflow; s->stack[s->sp++] = (x); } while (0)
+#define OPERAND(n)	do { if (!agent_expr_operand(s, n, &operand)) goto truncated; } while (0)
+
+	for (unsigned int steps = 0; steps < AGENT_EXPR_MAX_STEPS; steps++) {
+		if (s->pc >= expr->len)
+			goto truncated;
+
+		uint8_t op = expr->bytecode[s->pc++];
+		switch (op) {
+		case AX_ADD:
+			POP(b); POP(a); PUSH((uint64_t)a + (uint64_t)b);
+			break;
+		case AX_SUB:
+			POP(b); POP(a); PUSH((uint64_t)a - (uint64_t)b);
+			break;
+		case AX_MUL:
+			POP(b); POP(a); PUSH((uint64_t)a * (uint64_t)b);
+			break;
+		case AX_DIV_SIGNED:
+		case AX_REM_SIGNED:
+			POP(b); POP(a);
+			if (b == 0)
+				goto div_zero;
+			if (b == -1)	/* INT64_MIN / -1 overflows */
+				PUSH(op == AX_DIV_SIGNED ? (int64_t)(0 - (uint64_t)a) : 0);
+			else
+				PUSH(op == AX_DIV_SIGNED ? a / b : a % b);
+			break;
+		case AX_DIV_UNSIGNED:
+		case AX_REM_UNSIGNED:
+			POP(b); POP(a);
+			if (b == 0)
+				goto div_zero;
+			PUSH(op == AX_DIV_UNSIGNED ? (uint64_t)a / (uint64_t)b : (uint64_t)a % (uint64_t)b);
+			break;
+		case AX_LSH:
+			POP(b); POP(a); PUSH((uint64_t)b >= 64 ? 0 : (uint64_t)a << b);
+			break;
+		case AX_RSH_SIGNED:
+			POP(b); POP(a); PUSH((uint64_t)b >= 64 ? (a < 0 ? -1 : 0) : a >> b);
+			break;
+		case AX_RSH_UNSIGNED:
+			POP(b); POP(a); PUSH((uint64_t)b >= 64 ? 0 : (uint64_t)a >> b);
+			break;
+		case AX_LOG_NOT:
+			POP(a); PUSH(!a);
+			break;
+		case AX_BIT_AND:
+			POP(b); POP(a); PUSH(a & b);
+			break;
+		case AX_BIT_OR:
+			POP(b); POP(a); PUSH(a | b);
+			break;
+		case AX_BIT_XOR:
+			POP(b); POP(a); PUSH(a ^ b);
+			break;
+		case AX_BIT_NOT:
+			POP(a); PUSH(~a);
+			break;
+		case AX_EQUAL:
+			POP(b); POP(a); PUSH(a == b);
+			break;
+		case AX_LESS_SIGNED:
+			POP(b); POP(a); PUSH(a < b);
+			break;
+		case AX_LESS_UNSIGNED:
+			POP(b); POP(a); PUSH((uint64_t)a < (uint64_t)b);
+			break;
+		case AX_EXT:
+			OPERAND(1);
+			POP(a); PUSH(agent_expr_sign_extend(a, operand));
+			break;
+		case AX_ZERO_EXT:
+			OPERAND(1);
+			POP(a);
+			if (operand < 64)
+				a = (uint64_t)a & ((1ULL << operand) - 1);
+			PUSH(a);
+			break;
+		case AX_REF8:
+		case AX_REF16:
+		case AX_REF32:
+		case AX_REF64:
+			POP(a);
+			retval = agent_expr_ref(s, 1 << (op - AX_REF8), a, &b);
+			if (retval != ERROR_OK)
+				return retval;
+			PUSH(b);
+			break;
+		case AX_IF_GOTO:
+			OPERAND(2);
+			POP(a);
+			if (a)
+				s->pc = operand;
+			break;
+		case AX_GOTO:
+			OPERAND(2);
+			s->pc = operand;
+			break;
+		case AX_CONST8:
+		case AX_CONST16:
+		case AX_CONST32:
+		case AX_CONST64:
+			OPERAND(1 << (op - AX_CONST8));
+			PUSH(operand);
+			break;
+		case AX_REG:
+			OPERAND(2);
+			retval = agent_expr_reg(s, operand, &a);
+			if (retval != ERROR_OK)
+				return retval;
+			PUSH(a);
+			break;
+		case AX_END:
+			POP(a);
+			*result = a;
+			return ERROR_OK;
+		case AX_DUP:
+			POP(a); PUSH(a); PUSH(a);
+			break;
+		case AX_POP:
+			POP(a);
+			break;
+		case AX_SWAP:
+			POP(b); POP(a); PUSH(b); PUSH(a);
+			break;
+		case AX_PICK:
+			OPERAND(1);
+			if (operand >= s->sp)
+				goto underflow;
+			a = s->stack[s->sp - 1 - operand];
+			PUSH(a);
+			break;
+		case AX_ROT:
+			if (s->sp < 3)
+				goto underflow;
+			/* a b c => c a b */
+			a = s->stack[s->sp - 1];
+			s->stack[s->sp - 1] = s->stack[s->sp - 2];
+			s->stack[s->sp - 2] = s->stack[s->sp - 3];
+			s->stack[s->sp - 3] = a;
+			break;
+		default:
+			LOG_DEBUG("unsupported agent expression opcode 0x%02x", op);
+			return ERROR_NOT_IMPLEMENTED;
+		}
+	}
+
+	LOG_DEBUG("agent expression exceeds %d steps", AGENT_EXPR_MAX_STEPS);
+	return ERROR_FAIL;
+
+#undef POP
+#undef PUSH
+#undef OPERAND
+
+underflow:
+	LOG_DEBUG("agent expression stack underflow at %zu", s->pc);
+	return ERROR_FAIL;
+overflow:
+	LOG_DEBUG("agent expression stack overflow at %zu", s->pc);
+	return ERROR_FAIL;
+truncated:
+	LOG_DEBUG("agent expression truncated at %zu", s->pc);
+	return ERROR_FAIL;
+div_zero:
+	LOG_DEBUG("agent expression divides by zero at %zu", s->pc);
+	return ERROR_FAIL;
+}
+
+int agent_expr_eval(struct target *target, const struct agent_expr *expr, int64_t *result)
+{
+	struct agent_expr_state s = {
+		.target = target,
+		.expr = expr,
+	};
+
+	int retval = agent_expr_run(&s, result);
+	free(s.reg_list);
+	return retval;
+}
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * Evaluation of GDB agent expressions, the bytecode GDB sends with the
+ * conditions of breakpoints.
+ */
+
+#ifndef OPENOCD_TARGET_AGENT_EXPR_H
+#define OPENOCD_TARGET_AGENT_EXPR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct target;
+
+struct agent_expr {
+	uint8_t *bytecode;
+	size_t len;
+};
+
+/**
+ * Evaluate @a expr on the halted @a target, reading registers by their
+ * GDB number and memory as the expression needs them.
+ * @returns ERROR_OK and the value left on top of the stack in @a result,
+ * or an error for an invalid or unsupported expression or a failed access.
+ */
+int agent_expr_eval(struct target *target, const struct agent_expr *expr, int64_t *result);
+
+#endif /* OPENOCD_TARGET_AGENT_EXPR_H */
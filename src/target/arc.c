@@ -103,6 +103,65 @@ int arc_reset_caches_states(struct target *target)
 	arc->icache_invalidated = false;
 	arc->dcache_invalidated = false;
 	arc->l2cache_invalidated = false;
+	arc->dc_ctrl.valid = false;
+	arc->slc_ctrl.valid = false;
+
+	return ERROR_OK;
+}
+
+/* Read AUX register through its write-back copy. */
+static int arc_wb_reg_read(struct arc_common *arc, struct arc_aux_wb_reg *reg,
+	uint32_t *value)
+{
+	if (!reg->valid) {
+		CHECK_RETVAL(arc_jtag_read_aux_reg_one(&arc->jtag_info, reg->addr,
+			&reg->saved));
+		reg->value = reg->saved;
+		reg->valid = true;
+	}
+
+	*value = reg->value;
+
+	return ERROR_OK;
+}
+
+/* Write AUX register read with arc_wb_reg_read(), unless it holds @a value. */
+static int arc_wb_reg_write(struct arc_common *arc, struct arc_aux_wb_reg *reg,
+	uint32_t value)
+{
+	assert(reg->valid);
+
+	if (reg->value == value)
+		return ERROR_OK;
+
+	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, reg->addr, value));
+	reg->value = value;
+
+	return ERROR_OK;
+}
+
+static int arc_wb_reg_write_back(struct arc_common *arc, struct arc_aux_wb_reg *reg)
+{
+	if (!reg->valid)
+		return ERROR_OK;
+
+	reg->valid = false;
+	if (reg->value == reg->saved)
+		return ERROR_OK;
+
+	return arc_jtag_write_aux_reg_one(&arc->jtag_info, reg->addr, reg->saved);
+}
+
+/**
+ * Restore cache control registers changed while the core was halted. Must
+ * be called before the core runs.
+ */
+static int arc_cache_ctrl_write_back(struct target *target)
+{
+	struct arc_common *arc = target_to_arc(target);
+
+	CHECK_RETVAL(arc_wb_reg_write_back(arc, &arc->dc_ctrl));
+	CHECK_RETVAL(arc_wb_reg_write_back(arc, &arc->slc_ctrl));
 
 	return ERROR_OK;
 }
@@ -129,6 +188,8 @@ static int arc_init_arch_info(struct target *target, struct arc_common *arc,
 	arc->has_icache = true;
 	/* L2$ is not available in a target by default. */
 	arc->has_l2cache = false;
+	arc->dc_ctrl.addr = AUX_DC_CTRL_REG;
+	arc->slc_ctrl.addr = SLC_AUX_CACHE_CTRL;
 	arc_reset_caches_states(target);
 
 	/* Add standard GDB data types */
@@ -1100,6 +1161,8 @@ static int arc_assert_reset(struct target *target)
 	jtag_add_sleep(50000);
 
 	register_cache_invalidate(arc->core_and_aux_cache);
+	arc->dc_ctrl.valid = false;
+	arc->slc_ctrl.valid = false;
 
 	if (target->reset_halt)
 		CHECK_RETVAL(target_halt(target));
@@ -1253,6 +1316,8 @@ static int arc_resume(struct target *target, int current, target_addr_t address,
 	LOG_DEBUG("current:%i, address:0x%08" TARGET_PRIxADDR ", handle_breakpoints(not supported yet):%i,"
 		" debug_execution:%i", current, address, handle_breakpoints, debug_execution);
 
+	CHECK_RETVAL(arc_cache_ctrl_write_back(target));
+
 	/* We need to reset ARC cache variables so caches
 	 * would be invalidated and actual data
 	 * would be fetched from memory. */
@@ -1695,15 +1760,10 @@ void arc_reset_actionpoints(struct target *target)
 {
 	struct arc_common *arc = target_to_arc(target);
 	struct arc_actionpoint *ap_list = arc->actionpoints_list;
-	struct breakpoint *next_b;
 
-	while (target->breakpoints) {
-		next_b = target->breakpoints->next;
-		arc_remove_breakpoint(target, target->breakpoints);
-		free(target->breakpoints->orig_instr);
-		free(target->breakpoints);
-		target->breakpoints = next_b;
-	}
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next)
+		arc_remove_breakpoint(target, b);
+	breakpoint_forget_all(target);
 	for (unsigned int i = 0; i < arc->actionpoints_num; i++) {
 		if ((ap_list[i].used) && (ap_list[i].reg_address))
 			arc_remove_auxreg_actionpoint(target, ap_list[i].reg_address);
@@ -1870,6 +1930,7 @@ int arc_step(struct target *target, int current, target_addr_t address,
 
 	/* restore context */
 	CHECK_RETVAL(arc_restore_context(target));
+	CHECK_RETVAL(arc_cache_ctrl_write_back(target));
 
 	target->debug_reason = DBG_REASON_SINGLESTEP;
 
@@ -1926,7 +1987,7 @@ static int arc_icache_invalidate(struct target *target)
 /* This function invalidates dcache */
 static int arc_dcache_invalidate(struct target *target)
 {
-	uint32_t value, dc_ctrl_value;
+	uint32_t value;
 
 	struct arc_common *arc = target_to_arc(target);
 
@@ -1935,18 +1996,15 @@ static int arc_dcache_invalidate(struct target *target)
 
 	LOG_DEBUG("Invalidating D$.");
 
-	CHECK_RETVAL(arc_jtag_read_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, &value));
-	dc_ctrl_value = value;
+	CHECK_RETVAL(arc_wb_reg_read(arc, &arc->dc_ctrl, &value));
 	value &= ~DC_CTRL_IM;
 
-	/* set DC_CTRL invalidate mode to invalidate-only (no flushing!!) */
-	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, value));
+	/* set DC_CTRL invalidate mode to invalidate-only (no flushing!!),
+	 * it is restored before the core runs */
+	CHECK_RETVAL(arc_wb_reg_write(arc, &arc->dc_ctrl, value));
 	value = DC_IVDC_INVALIDATE;	/* invalidate D$ */
 	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_IVDC_REG, value));
 
-	/* restore DC_CTRL invalidate mode */
-	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, dc_ctrl_value));
-
 	arc->dcache_invalidated = true;
 
 	return ERROR_OK;
@@ -1955,7 +2013,7 @@ static int arc_dcache_invalidate(struct target *target)
 /* This function invalidates l2 cache. */
 static int arc_l2cache_invalidate(struct target *target)
 {
-	uint32_t value, slc_ctrl_value;
+	uint32_t value;
 
 	struct arc_common *arc = target_to_arc(target);
 
@@ -1964,12 +2022,12 @@ static int arc_l2cache_invalidate(struct target *target)
 
 	LOG_DEBUG("Invalidating L2$.");
 
-	CHECK_RETVAL(arc_jtag_read_aux_reg_one(&arc->jtag_info, SLC_AUX_CACHE_CTRL, &value));
-	slc_ctrl_value = value;
+	CHECK_RETVAL(arc_wb_reg_read(arc, &arc->slc_ctrl, &value));
 	value &= ~L2_CTRL_IM;
 
-	/* set L2_CTRL invalidate mode to invalidate-only (no flushing!!) */
-	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, SLC_AUX_CACHE_CTRL, value));
+	/* set L2_CTRL invalidate mode to invalidate-only (no flushing!!),
+	 * it is restored before the core runs */
+	CHECK_RETVAL(arc_wb_reg_write(arc, &arc->slc_ctrl, value));
 	/* invalidate L2$ */
 	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, SLC_AUX_CACHE_INV, L2_INV_IV));
 
@@ -1979,9 +2037,6 @@ static int arc_l2cache_invalidate(struct target *target)
 	    CHECK_RETVAL(arc_jtag_read_aux_reg_one(&arc->jtag_info, SLC_AUX_CACHE_CTRL, &value));
 	} while (value & L2_CTRL_BS);
 
-	/* restore L2_CTRL invalidate mode */
-	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, SLC_AUX_CACHE_CTRL, slc_ctrl_value));
-
 	arc->l2cache_invalidated = true;
 
 	return ERROR_OK;
@@ -2004,8 +2059,7 @@ int arc_cache_invalidate(struct target *target)
  * */
 int arc_dcache_flush(struct target *target)
 {
-	uint32_t value, dc_ctrl_value;
-	bool has_to_set_dc_ctrl_im;
+	uint32_t value;
 
 	struct arc_common *arc = target_to_arc(target);
 
@@ -2015,24 +2069,15 @@ int arc_dcache_flush(struct target *target)
 
 	LOG_DEBUG("Flushing D$.");
 
-	/* Store current value of DC_CTRL */
-	CHECK_RETVAL(arc_jtag_read_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, &dc_ctrl_value));
-
-	/* Set DC_CTRL invalidate mode to flush (if not already set) */
-	has_to_set_dc_ctrl_im = (dc_ctrl_value & DC_CTRL_IM) == 0;
-	if (has_to_set_dc_ctrl_im) {
-		value = dc_ctrl_value | DC_CTRL_IM;
-		CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, value));
-	}
+	/* Set DC_CTRL invalidate mode to flush (if not already set), it is
+	 * restored before the core runs */
+	CHECK_RETVAL(arc_wb_reg_read(arc, &arc->dc_ctrl, &value));
+	CHECK_RETVAL(arc_wb_reg_write(arc, &arc->dc_ctrl, value | DC_CTRL_IM));
 
 	/* Flush D$ */
 	value = DC_IVDC_INVALIDATE;
 	CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_IVDC_REG, value));
 
-	/* Restore DC_CTRL invalidate mode (even of flush failed) */
-	if (has_to_set_dc_ctrl_im)
-	    CHECK_RETVAL(arc_jtag_write_aux_reg_one(&arc->jtag_info, AUX_DC_CTRL_REG, dc_ctrl_value));
-
 	arc->dcache_flushed = true;
 
 	return ERROR_OK;
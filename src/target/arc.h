@@ -139,6 +139,15 @@ struct arc_actionpoint {
 	enum arc_actionpointype type;
 };
 
+/* AUX register which the debugger changes while the core is halted. The
+ * value found at halt is written back before the core runs again. */
+struct arc_aux_wb_reg {
+	uint32_t addr;
+	uint32_t saved;
+	uint32_t value;
+	bool valid;
+};
+
 struct arc_common {
 	uint32_t common_magic;
 
@@ -162,6 +171,10 @@ struct arc_common {
 	bool icache_invalidated;
 	bool dcache_invalidated;
 	bool l2cache_invalidated;
+	/* DC_CTRL and SLC_CTRL, their invalidate mode is switched for flushes
+	 * and invalidations. */
+	struct arc_aux_wb_reg dc_ctrl;
+	struct arc_aux_wb_reg slc_ctrl;
 
 	/* Indicate if cach was built (for deinit function) */
 	bool core_aux_cache_built;
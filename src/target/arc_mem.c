@@ -56,99 +56,77 @@ static int arc_mem_write_block32(struct target *target, uint32_t addr,
 	return ERROR_OK;
 }
 
-/* Write half-word at half-word-aligned address */
-static int arc_mem_write_block16(struct target *target, uint32_t addr,
-	uint32_t count, void *buf)
+/* Write half-words or bytes, doing a read-modify-write of the words holding
+ * them. Those words are read and written back in one burst each, so that
+ * the ARC JTAG transaction is set up only twice for the whole block. */
+static int arc_mem_write_block_rmw(struct target *target, uint32_t addr,
+	uint32_t size, uint32_t count, void *buf)
 {
 	struct arc_common *arc = target_to_arc(target);
 	uint32_t i;
-	uint32_t buffer_he;
-	uint8_t buffer_te[sizeof(uint32_t)];
-	uint8_t halfword_te[sizeof(uint16_t)];
+	int retval;
 
-	LOG_DEBUG("Write 2-byte memory block: addr=0x%08" PRIx32 ", count=%" PRIu32,
-			addr, count);
+	LOG_DEBUG("Write %" PRIu32 "-byte memory block: addr=0x%08" PRIx32 ", count=%" PRIu32,
+			size, addr, count);
 
 	/* Check arguments */
-	assert(!(addr & 1));
-
-	/* We will read data from memory, so we need to flush the cache. */
-	CHECK_RETVAL(arc_cache_flush(target));
-
-	/* non-word writes are less common than 4-byte writes, so I suppose we can
-	 * allow ourselves to write this in a cycle, instead of calling arc_jtag
-	 * with count > 1. */
-	for (i = 0; i < count; i++) {
-		/* We can read only word at word-aligned address. Also *jtag_read_memory
-		 * functions return data in host endianness, so host endianness !=
-		 * target endianness we have to convert data back to target endianness,
-		 * or bytes will be at the wrong places.So:
-		 *   1) read word
-		 *   2) convert to target endianness
-		 *   3) make changes
-		 *   4) convert back to host endianness
-		 *   5) write word back to target.
-		 */
-		bool is_slow_memory = arc_mem_is_slow_memory(arc,
-			(addr + i * sizeof(uint16_t)) & ~3u, 4, 1);
-		CHECK_RETVAL(arc_jtag_read_memory(&arc->jtag_info,
-				(addr + i * sizeof(uint16_t)) & ~3u, 1, &buffer_he,
-				is_slow_memory));
-		target_buffer_set_u32(target, buffer_te, buffer_he);
-
-		/* buf is in host endianness, convert to target */
-		target_buffer_set_u16(target, halfword_te, ((uint16_t *)buf)[i]);
+	assert(!(addr & (size - 1)));
 
-		memcpy(buffer_te  + ((addr + i * sizeof(uint16_t)) & 3u),
-			halfword_te, sizeof(uint16_t));
+	const uint32_t word_addr = addr & ~3u;
+	const uint32_t offset = addr & 3u;
+	const uint32_t words = (offset + count * size + 3) / 4;
 
-		buffer_he = target_buffer_get_u32(target, buffer_te);
-
-		CHECK_RETVAL(arc_jtag_write_memory(&arc->jtag_info,
-			(addr + i * sizeof(uint16_t)) & ~3u, 1, &buffer_he));
+	uint32_t *buffer_he = malloc(words * sizeof(uint32_t));
+	uint8_t *buffer_te = malloc(words * sizeof(uint32_t));
+	if (!buffer_he || !buffer_te) {
+		LOG_ERROR("Unable to allocate memory");
+		retval = ERROR_FAIL;
+		goto exit;
 	}
 
-	/* Invalidate caches. */
-	CHECK_RETVAL(arc_cache_invalidate(target));
-
-	return ERROR_OK;
-}
-
-/* Write byte at address */
-static int arc_mem_write_block8(struct target *target, uint32_t addr,
-	uint32_t count, void *buf)
-{
-	struct arc_common *arc = target_to_arc(target);
-	uint32_t i;
-	uint32_t buffer_he;
-	uint8_t buffer_te[sizeof(uint32_t)];
-
-
-	LOG_DEBUG("Write 1-byte memory block: addr=0x%08" PRIx32 ", count=%" PRIu32,
-			addr, count);
-
 	/* We will read data from memory, so we need to flush the cache. */
-	CHECK_RETVAL(arc_cache_flush(target));
-
-	/* non-word writes are less common than 4-byte writes, so I suppose we can
-	 * allow ourselves to write this in a cycle, instead of calling arc_jtag
-	 * with count > 1. */
-	for (i = 0; i < count; i++) {
-		/* See comment in arc_mem_write_block16 for details. Since it is a byte
-		 * there is not need to convert write buffer to target endianness, but
-		 * we still have to convert read buffer. */
-		CHECK_RETVAL(arc_jtag_read_memory(&arc->jtag_info, (addr + i) & ~3, 1, &buffer_he,
-			    arc_mem_is_slow_memory(arc, (addr + i) & ~3, 4, 1)));
-		target_buffer_set_u32(target, buffer_te, buffer_he);
-		memcpy(buffer_te  + ((addr + i) & 3), (uint8_t *)buf + i, 1);
-		buffer_he = target_buffer_get_u32(target, buffer_te);
-		CHECK_RETVAL(arc_jtag_write_memory(&arc->jtag_info, (addr + i) & ~3, 1, &buffer_he));
+	retval = arc_cache_flush(target);
+	if (retval != ERROR_OK)
+		goto exit;
+
+	/* We can read only word at word-aligned address. Also *jtag_read_memory
+	 * functions return data in host endianness, so host endianness !=
+	 * target endianness we have to convert data back to target endianness,
+	 * or bytes will be at the wrong places.So:
+	 *   1) read words
+	 *   2) convert to target endianness
+	 *   3) make changes
+	 *   4) convert back to host endianness
+	 *   5) write words back to target.
+	 */
+	retval = arc_jtag_read_memory(&arc->jtag_info, word_addr, words, buffer_he,
+			arc_mem_is_slow_memory(arc, word_addr, 4, words));
+	if (retval != ERROR_OK)
+		goto exit;
+	target_buffer_set_u32_array(target, buffer_te, words, buffer_he);
+
+	if (size == 2) {
+		/* buf is in host endianness, convert to target */
+		for (i = 0; i < count; i++)
+			target_buffer_set_u16(target, buffer_te + offset + i * 2,
+				((uint16_t *)buf)[i]);
+	} else {
+		memcpy(buffer_te + offset, buf, count);
 	}
 
+	target_buffer_get_u32_array(target, buffer_te, words, buffer_he);
+	retval = arc_jtag_write_memory(&arc->jtag_info, word_addr, words, buffer_he);
+	if (retval != ERROR_OK)
+		goto exit;
+
 	/* Invalidate caches. */
-	CHECK_RETVAL(arc_cache_invalidate(target));
+	retval = arc_cache_invalidate(target);
 
-	return ERROR_OK;
+exit:
+	free(buffer_he);
+	free(buffer_te);
+
+	return retval;
 }
 
 /* ----- Exported functions ------------------------------------------------ */
@@ -201,13 +179,11 @@ int arc_mem_write(struct target *target, target_addr_t address, uint32_t size,
 
 	if (size == 4) {
 		retval = arc_mem_write_block32(target, address, count, (void *)buffer);
-	} else if (size == 2) {
-		/* We convert buffer from host endianness to target. But then in
-		 * write_block16, we do the reverse. Is there a way to avoid this without
-		 * breaking other cases? */
-		retval = arc_mem_write_block16(target, address, count, (void *)buffer);
 	} else {
-		retval = arc_mem_write_block8(target, address, count, (void *)buffer);
+		/* We convert buffer from host endianness to target. But then in
+		 * write_block_rmw, we do the reverse. Is there a way to avoid this
+		 * without breaking other cases? */
+		retval = arc_mem_write_block_rmw(target, address, size, count, (void *)buffer);
 	}
 
 	free(tunnel);
@@ -758,13 +758,15 @@ static int arm7_9_handle_target_request(void *priv)
 	if (!target->dbg_msg_enabled)
 		return ERROR_OK;
 
-	if (target->state == TARGET_RUNNING) {
+	if (target->state == TARGET_RUNNING && target_request_poll_due(target)) {
 		/* read DCC control register */
 		embeddedice_read_reg(dcc_control);
 		retval = jtag_execute_queue();
 		if (retval != ERROR_OK)
 			return retval;
 
+		target_request_polled(target, buf_get_u32(dcc_control->value, 1, 1) == 1);
+
 		/* check W bit */
 		if (buf_get_u32(dcc_control->value, 1, 1) == 1) {
 			uint32_t request;
@@ -2125,6 +2127,14 @@ int arm7_9_read_memory(struct target *target,
 	if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	if (size == 4 && count > 32 && arm7_9->bulk_read_memory) {
+		/* Attempt to do a bulk read */
+		retval = arm7_9->bulk_read_memory(target, address, count, buffer);
+
+		if (retval == ERROR_OK)
+			return ERROR_OK;
+	}
+
 	/* load the base register with the address of the first word */
 	reg[0] = address;
 	arm7_9->write_core_regs(target, 0x1, reg);
@@ -2511,6 +2521,35 @@ int arm7_9_write_memory_no_opt(struct target *target,
 
 static int dcc_count;
 static const uint8_t *dcc_buffer;
+static uint32_t *dcc_read_buffer;
+
+/**
+ * DCC transfers don't poll the handshake bits, so they rely on the JTAG
+ * clock being slow enough relative to the core clock.  Unless configured
+ * by the user, they are used when the adapter runs from adaptive clocking
+ * (RTCK), where the core clock paces TCK.
+ */
+bool arm7_9_dcc_downloads_enabled(struct arm7_9_common *arm7_9)
+{
+	if (arm7_9->dcc_downloads_auto)
+		return jtag_get_speed_khz() == 0;
+
+	return arm7_9->dcc_downloads;
+}
+
+/**
+ * A DCC transfer lost words; if DCC transfers were enabled automatically,
+ * don't try them again.
+ */
+static void arm7_9_dcc_lost_words(struct arm7_9_common *arm7_9)
+{
+	if (!arm7_9->dcc_downloads_auto)
+		return;
+
+	LOG_WARNING("DCC transfers are too fast for this target, disabling them");
+	arm7_9->dcc_downloads_auto = false;
+	arm7_9->dcc_downloads = false;
+}
 
 static int arm7_9_dcc_completion(struct target *target,
 	uint32_t exit_point,
@@ -2589,7 +2628,7 @@ int arm7_9_bulk_write_memory(struct target *target,
 	if (address % 4 != 0)
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	if (!arm7_9->dcc_downloads)
+	if (!arm7_9_dcc_downloads_enabled(arm7_9))
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
 	/* regrab previously allocated working_area, or allocate a new one */
@@ -2638,6 +2677,7 @@ int arm7_9_bulk_write_memory(struct target *target,
 				"DCC write failed, expected end address 0x%08" TARGET_PRIxADDR " got 0x%0" PRIx32 "",
 				(address + count*4),
 				endaddress);
+			arm7_9_dcc_lost_words(arm7_9);
 			retval = ERROR_FAIL;
 		}
 	}
@@ -2647,6 +2687,133 @@ int arm7_9_bulk_write_memory(struct target *target,
 	return retval;
 }
 
+static int arm7_9_dcc_read_completion(struct target *target,
+	uint32_t exit_point,
+	int timeout_ms,
+	void *arch_info)
+{
+	int retval = ERROR_OK;
+	struct arm7_9_common *arm7_9 = target_to_arm7_9(target);
+
+	retval = target_wait_state(target, TARGET_DEBUG_RUNNING, 500);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = embeddedice_receive(&arm7_9->jtag_info, dcc_read_buffer, dcc_count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_halt(target);
+	if (retval != ERROR_OK)
+		return retval;
+	return target_wait_state(target, TARGET_HALTED, 500);
+}
+
+static const uint32_t dcc_read_code[] = {
+	/* r0 == input, points to memory buffer
+	 * r1 == input, number of words
+	 * r2, r3 == scratch
+	 */
+
+	/* read word from memory */
+	0xe4902004,	/* l: ldr r2, [r0], #4        */
+
+	/* spin until the debugger took the previous word from DCC (c0) */
+	0xee103e10,	/* w: mrc p14, #0, r3, c0, c0 */
+	0xe3130002,	/*    tst r3, #2              */
+	0x1afffffc,	/*    bne w                   */
+
+	/* write word to DCC (c1) */
+	0xee012e10,	/*    mcr p14, #0, r2, c1, c0 */
+
+	/* repeat until done */
+	0xe2511001,	/*    subs r1, r1, #1         */
+	0x1afffff8,	/*    bne l                   */
+	0xeafffffe	/* e: b   e                   */
+};
+
+int arm7_9_bulk_read_memory(struct target *target,
+	target_addr_t address,
+	uint32_t count,
+	uint8_t *buffer)
+{
+	int retval;
+	struct arm7_9_common *arm7_9 = target_to_arm7_9(target);
+
+	if (address % 4 != 0)
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	if (!arm7_9_dcc_downloads_enabled(arm7_9))
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* regrab previously allocated working_area, or allocate a new one */
+	if (!arm7_9->dcc_read_working_area) {
+		uint8_t dcc_code_buf[sizeof(dcc_read_code)];
+
+		/* make sure we have a working area */
+		if (target_alloc_working_area(target, sizeof(dcc_read_code),
+				&arm7_9->dcc_read_working_area) != ERROR_OK) {
+			LOG_INFO("no working area available, falling back to memory reads");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+
+		/* copy target instructions to target endianness */
+		target_buffer_set_u32_array(target, dcc_code_buf, ARRAY_SIZE(dcc_read_code), dcc_read_code);
+
+		retval = arm7_9_write_memory_no_opt(target, arm7_9->dcc_read_working_area->address,
+				4, ARRAY_SIZE(dcc_read_code), dcc_code_buf);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	uint32_t *data = malloc(count * sizeof(uint32_t));
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	struct arm_algorithm arm_algo;
+	struct reg_param reg_params[2];
+
+	arm_algo.common_magic = ARM_COMMON_MAGIC;
+	arm_algo.core_mode = ARM_MODE_SVC;
+	arm_algo.core_state = ARM_STATE_ARM;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN_OUT);
+
+	buf_set_u32(reg_params[0].value, 0, 32, address);
+	buf_set_u32(reg_params[1].value, 0, 32, count);
+
+	dcc_count = count;
+	dcc_read_buffer = data;
+	retval = armv4_5_run_algorithm_inner(target, 0, NULL, 2, reg_params,
+			arm7_9->dcc_read_working_area->address,
+			arm7_9->dcc_read_working_area->address + (ARRAY_SIZE(dcc_read_code) - 1) * 4,
+			20*1000, &arm_algo, arm7_9_dcc_read_completion);
+
+	if (retval == ERROR_OK) {
+		/* each word is only written to the DCC after the debugger
+		 * took the previous one, so a scan that came too early
+		 * leaves the loop short of its end */
+		uint32_t left = buf_get_u32(reg_params[1].value, 0, 32);
+		if (left != 0) {
+			LOG_ERROR("DCC read failed, %" PRIu32 " of %" PRIu32 " words not sent",
+				left, count);
+			arm7_9_dcc_lost_words(arm7_9);
+			retval = ERROR_FAIL;
+		} else {
+			target_buffer_set_u32_array(target, buffer, count, data);
+		}
+	}
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	free(data);
+
+	return retval;
+}
+
 /**
  * Perform per-target setup that requires JTAG access.
  */
@@ -2696,7 +2863,7 @@ int arm7_9_check_reset(struct target *target)
 {
 	struct arm7_9_common *arm7_9 = target_to_arm7_9(target);
 
-	if (get_target_reset_nag() && !arm7_9->dcc_downloads)
+	if (get_target_reset_nag() && !arm7_9_dcc_downloads_enabled(arm7_9))
 		LOG_WARNING(
 			"NOTE! DCC downloads have not been enabled, defaulting to slow memory writes. Type 'help dcc'.");
 
@@ -2800,12 +2967,15 @@ COMMAND_HANDLER(handle_arm7_9_dcc_downloads_command)
 		return ERROR_TARGET_INVALID;
 	}
 
-	if (CMD_ARGC > 0)
+	if (CMD_ARGC > 0) {
 		COMMAND_PARSE_ENABLE(CMD_ARGV[0], arm7_9->dcc_downloads);
+		arm7_9->dcc_downloads_auto = false;
+	}
 
 	command_print(CMD,
-		"dcc downloads are %s",
-		(arm7_9->dcc_downloads) ? "enabled" : "disabled");
+		"dcc downloads are %s%s",
+		arm7_9_dcc_downloads_enabled(arm7_9) ? "enabled" : "disabled",
+		arm7_9->dcc_downloads_auto ? " (automatic)" : "");
 
 	return ERROR_OK;
 }
@@ -2855,6 +3025,7 @@ int arm7_9_init_arch_info(struct target *target, struct arm7_9_common *arm7_9)
 
 	arm7_9->fast_memory_access = false;
 	arm7_9->dcc_downloads = false;
+	arm7_9->dcc_downloads_auto = true;
 
 	arm->arch_info = arm7_9;
 	arm->core_type = ARM_CORE_TYPE_STD;
@@ -66,8 +66,10 @@ struct arm7_9_common {
 
 	bool fast_memory_access;
 	bool dcc_downloads;
+	bool dcc_downloads_auto; /**< dcc_downloads not configured by the user */
 
 	struct working_area *dcc_working_area;
+	struct working_area *dcc_read_working_area;
 
 	int (*examine_debug_reason)(struct target *target);
 	/**< Function for determining why debug state was entered */
@@ -130,6 +132,12 @@ struct arm7_9_common {
 	 */
 	int (*bulk_write_memory)(struct target *target, target_addr_t address,
 			uint32_t count, const uint8_t *buffer);
+	/**
+	 * Read target memory in multiples of 4 bytes, optimized for
+	 * reading large quantities of data.
+	 */
+	int (*bulk_read_memory)(struct target *target, target_addr_t address,
+			uint32_t count, uint8_t *buffer);
 };
 
 static inline struct arm7_9_common *target_to_arm7_9(struct target *target)
@@ -169,6 +177,9 @@ int arm7_9_write_memory_no_opt(struct target *target, uint32_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer);
 int arm7_9_bulk_write_memory(struct target *target, target_addr_t address,
 		uint32_t count, const uint8_t *buffer);
+int arm7_9_bulk_read_memory(struct target *target, target_addr_t address,
+		uint32_t count, uint8_t *buffer);
+bool arm7_9_dcc_downloads_enabled(struct arm7_9_common *arm7_9);
 
 int arm7_9_run_algorithm(struct target *target, int num_mem_params,
 		struct mem_param *mem_params, int num_reg_prams,
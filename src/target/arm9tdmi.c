@@ -754,6 +754,7 @@ int arm9tdmi_init_arch_info(struct target *target,
 
 	arm7_9->write_memory = arm7_9_write_memory;
 	arm7_9->bulk_write_memory = arm7_9_bulk_write_memory;
+	arm7_9->bulk_read_memory = arm7_9_bulk_read_memory;
 
 	arm7_9->post_debug_entry = NULL;
 
@@ -109,6 +109,8 @@ static int mem_ap_setup_csw(struct adiv5_ap *ap, uint32_t csw)
 			return retval;
 		}
 		ap->csw_value = csw;
+	} else {
+		ap->dap->csw_writes_skipped++;
 	}
 	return ERROR_OK;
 }
@@ -124,6 +126,8 @@ static int mem_ap_setup_tar(struct adiv5_ap *ap, uint32_t tar)
 		}
 		ap->tar_value = tar;
 		ap->tar_valid = true;
+	} else {
+		ap->dap->tar_writes_skipped++;
 	}
 	return ERROR_OK;
 }
@@ -262,6 +266,73 @@ int mem_ap_read_atomic_u32(struct adiv5_ap *ap, uint32_t address,
 	return dap_run(ap->dap);
 }
 
+/**
+ * Synchronous wait until the bits of @a mask of a word in memory or a
+ * system register read as @a match. If the adapter supports it, the
+ * word is read repeatedly by the adapter, else each read is a round
+ * trip from the host.
+ *
+ * @param ap The MEM-AP to access.
+ * @param address Address of the 32-bit word to poll.
+ * @param mask Bits of the word to compare.
+ * @param match Value expected in the bits of @a mask.
+ * @param value If not NULL, where the last value read is stored.
+ * @param timeout_ms How long to wait.
+ *
+ * @return ERROR_OK when the word matched, ERROR_TIMEOUT_REACHED when it
+ * did not match in time. Otherwise a fault code.
+ */
+int mem_ap_poll_atomic_u32(struct adiv5_ap *ap, uint32_t address,
+		uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms)
+{
+	int64_t then = timeval_ms();
+	bool offload = true;
+	uint32_t data;
+	int retval;
+
+	for (;;) {
+		if (offload) {
+			retval = mem_ap_setup_transfer(ap,
+					CSW_32BIT | (ap->csw_value & CSW_ADDRINC_MASK),
+					address & 0xFFFFFFF0);
+			if (retval != ERROR_OK)
+				return retval;
+
+			retval = dap_queue_ap_read_match(ap, MEM_AP_REG_BD0 | (address & 0xC),
+					mask, match);
+			if (retval == ERROR_NOT_IMPLEMENTED) {
+				offload = false;
+				continue;
+			}
+			if (retval == ERROR_OK)
+				retval = dap_run(ap->dap);
+			/* the matching value is not returned, read it once more */
+			if (retval == ERROR_OK)
+				return value ? mem_ap_read_atomic_u32(ap, address, value) : ERROR_OK;
+			if (retval != ERROR_TIMEOUT_REACHED)
+				return retval;
+		} else {
+			retval = mem_ap_read_atomic_u32(ap, address, &data);
+			if (retval != ERROR_OK)
+				return retval;
+			if (value)
+				*value = data;
+			if ((data & mask) == match)
+				return ERROR_OK;
+		}
+
+		if (timeval_ms() - then > timeout_ms)
+			break;
+		keep_alive();
+	}
+
+	/* report the value which did not match */
+	if (offload && value)
+		mem_ap_read_atomic_u32(ap, address, value);
+
+	return ERROR_TIMEOUT_REACHED;
+}
+
 /**
  * Asynchronous (queued) write of a word to memory or a system register.
  *
@@ -314,19 +385,25 @@ int mem_ap_write_atomic_u32(struct adiv5_ap *ap, uint32_t address,
 }
 
 /**
- * Synchronous write of a block of memory, using a specific access size.
- *
- * @param ap The MEM-AP to access.
- * @param buffer The data buffer to write. No particular alignment is assumed.
- * @param size Which access size to use, in bytes. 1, 2 or 4.
- * @param count The number of writes to do (in size units, not bytes).
- * @param address Address to be written; it must be writable by the currently selected MEM-AP.
- * @param addrinc Whether the target address should be increased for each write or not. This
- *  should normally be true, except when writing to e.g. a FIFO.
- * @return ERROR_OK on success, otherwise an error code.
+ * Number of bytes the next DRW access of a block transfer moves: a full word
+ * packed from @a size accesses when the MEM-AP supports packed transfers and
+ * the word does not cross the TAR auto-increment block, else just @a size.
  */
-static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size, uint32_t count,
+static uint32_t mem_ap_drw_bytes(struct adiv5_ap *ap, uint32_t size, size_t nbytes,
 		uint32_t address, bool addrinc)
+{
+	if (addrinc && ap->packed_transfers && nbytes >= 4
+			&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4)
+		return 4;
+
+	return size;
+}
+
+/**
+ * Queue the transfers of mem_ap_write() without running the DAP queue.
+ */
+static int mem_ap_write_queue(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size,
+		uint32_t count, uint32_t address, bool addrinc)
 {
 	struct adiv5_dap *dap = ap->dap;
 	size_t nbytes = size * count;
@@ -365,16 +442,12 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
 	while (nbytes > 0) {
-		uint32_t this_size = size;
-
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
+		uint32_t this_size = mem_ap_drw_bytes(ap, size, nbytes, address, addrinc);
+		if (this_size != size)
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
-		} else {
+		else
 			retval = mem_ap_setup_csw(ap, csw_size | csw_addrincr);
-		}
 
 		if (retval != ERROR_OK)
 			break;
@@ -428,9 +501,28 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 			address += this_size;
 	}
 
-	/* REVISIT: Might want to have a queued version of this function that does not run. */
+	return retval;
+}
+
+/**
+ * Synchronous write of a block of memory, using a specific access size.
+ *
+ * @param ap The MEM-AP to access.
+ * @param buffer The data buffer to write. No particular alignment is assumed.
+ * @param size Which access size to use, in bytes. 1, 2 or 4.
+ * @param count The number of writes to do (in size units, not bytes).
+ * @param address Address to be written; it must be writable by the currently selected MEM-AP.
+ * @param addrinc Whether the target address should be increased for each write or not. This
+ *  should normally be true, except when writing to e.g. a FIFO.
+ * @return ERROR_OK on success, otherwise an error code.
+ */
+static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t size, uint32_t count,
+		uint32_t address, bool addrinc)
+{
+	int retval = mem_ap_write_queue(ap, buffer, size, count, address, addrinc);
+
 	if (retval == ERROR_OK)
-		retval = dap_run(dap);
+		retval = dap_run(ap->dap);
 
 	if (retval != ERROR_OK) {
 		uint32_t tar;
@@ -444,21 +536,12 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 }
 
 /**
- * Synchronous read of a block of memory, using a specific access size.
- *
- * @param ap The MEM-AP to access.
- * @param buffer The data buffer to receive the data. No particular alignment is assumed.
- * @param size Which access size to use, in bytes. 1, 2 or 4.
- * @param count The number of reads to do (in size units, not bytes).
- * @param address Address to be read; it must be readable by the currently selected MEM-AP.
- * @param addrinc Whether the target address should be increased after each read or not. This
- *  should normally be true, except when reading from e.g. a FIFO.
- * @return ERROR_OK on success, otherwise an error code.
+ * Queue the DRW reads of mem_ap_read() without running the DAP queue. The
+ * read words go to *@a drw_buf, which is NULL if nothing could be queued.
  */
-static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
-		uint32_t adr, bool addrinc)
+static int mem_ap_read_queue(struct adiv5_ap *ap, uint32_t size, uint32_t count,
+		uint32_t adr, bool addrinc, uint32_t **drw_buf)
 {
-	struct adiv5_dap *dap = ap->dap;
 	size_t nbytes = size * count;
 	const uint32_t csw_addrincr = addrinc ? CSW_ADDRINC_SINGLE : CSW_ADDRINC_OFF;
 	uint32_t csw_size;
@@ -472,6 +555,8 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	 * Also, packed 8-bit and 16-bit transfers seem to sometimes return garbage in some bytes,
 	 * so avoid them. */
 
+	*drw_buf = NULL;
+
 	if (size == 4)
 		csw_size = CSW_32BIT;
 	else if (size == 2)
@@ -484,10 +569,20 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	if (ap->unaligned_access_bad && (adr % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
-	 * over-allocation if packed transfers are going to be used, but determining the real need at
-	 * this point would be messy. */
-	uint32_t *read_buf = calloc(count, sizeof(uint32_t));
+	/* Allocate buffer to hold the sequence of DRW reads that will be made. With packed
+	 * transfers a byte or halfword read needs far fewer DRW reads than count. */
+	size_t drw_count = count;
+	if (ap->packed_transfers && size < 4) {
+		drw_count = 0;
+		for (size_t left = nbytes; left > 0; drw_count++) {
+			uint32_t this_size = mem_ap_drw_bytes(ap, size, left, address, addrinc);
+			left -= this_size;
+			if (addrinc)
+				address += this_size;
+		}
+		address = adr;
+	}
+	uint32_t *read_buf = calloc(drw_count, sizeof(uint32_t));
 	/* Multiplication count * sizeof(uint32_t) may overflow, calloc() is safe */
 	uint32_t *read_ptr = read_buf;
 	if (read_buf == NULL) {
@@ -499,16 +594,12 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	 * useful bytes it contains, and their location in the word, depends on the type of transfer
 	 * and alignment. */
 	while (nbytes > 0) {
-		uint32_t this_size = size;
-
 		/* Select packed transfer if possible */
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
+		uint32_t this_size = mem_ap_drw_bytes(ap, size, nbytes, address, addrinc);
+		if (this_size != size)
 			retval = mem_ap_setup_csw(ap, csw_size | CSW_ADDRINC_PACKED);
-		} else {
+		else
 			retval = mem_ap_setup_csw(ap, csw_size | csw_addrincr);
-		}
 		if (retval != ERROR_OK)
 			break;
 
@@ -527,13 +618,21 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 		mem_ap_update_tar_cache(ap);
 	}
 
-	if (retval == ERROR_OK)
-		retval = dap_run(dap);
+	*drw_buf = read_buf;
+	return retval;
+}
 
-	/* Restore state */
-	address = adr;
-	nbytes = size * count;
-	read_ptr = read_buf;
+/**
+ * Copy the words read by mem_ap_read_queue() to @a buffer and free them.
+ * @a retval is the result of running the queue.
+ */
+static int mem_ap_read_finish(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
+		uint32_t adr, bool addrinc, uint32_t *read_buf, int retval)
+{
+	struct adiv5_dap *dap = ap->dap;
+	uint32_t address = adr;
+	size_t nbytes = size * count;
+	uint32_t *read_ptr = read_buf;
 
 	/* If something failed, read TAR to find out how much data was successfully read, so we can
 	 * at least give the caller what we have. */
@@ -552,11 +651,23 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 
 	/* Replay loop to populate caller's buffer from the correct word and byte lane */
 	while (nbytes > 0) {
-		uint32_t this_size = size;
-
-		if (addrinc && ap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(ap->tar_autoincr_block, address) >= 4) {
-			this_size = 4;
+		uint32_t this_size = mem_ap_drw_bytes(ap, size, nbytes, address, addrinc);
+
+		/* Word aligned full DRW words, either 32-bit or packed 8/16-bit reads: all lanes
+		 * are in order and every following word is full too, until the tail */
+		if (!dap->ti_be_32_quirks && this_size == 4 && (address & 3) == 0) {
+			size_t words = nbytes / 4;
+#ifdef WORDS_BIGENDIAN
+			for (size_t i = 0; i < words; i++)
+				h_u32_to_le(buffer + 4 * i, read_ptr[i]);
+#else
+			memcpy(buffer, read_ptr, 4 * words);
+#endif
+			buffer += 4 * words;
+			read_ptr += words;
+			address += 4 * words;
+			nbytes -= 4 * words;
+			continue;
 		}
 
 		if (dap->ti_be_32_quirks) {
@@ -593,12 +704,225 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	return retval;
 }
 
+/**
+ * Synchronous read of a block of memory, using a specific access size.
+ *
+ * @param ap The MEM-AP to access.
+ * @param buffer The data buffer to receive the data. No particular alignment is assumed.
+ * @param size Which access size to use, in bytes. 1, 2 or 4.
+ * @param count The number of reads to do (in size units, not bytes).
+ * @param address Address to be read; it must be readable by the currently selected MEM-AP.
+ * @param addrinc Whether the target address should be increased after each read or not. This
+ *  should normally be true, except when reading from e.g. a FIFO.
+ * @return ERROR_OK on success, otherwise an error code.
+ */
+static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint32_t count,
+		uint32_t adr, bool addrinc)
+{
+	uint32_t *read_buf;
+	int retval = mem_ap_read_queue(ap, size, count, adr, addrinc, &read_buf);
+	if (!read_buf)
+		return retval;
+
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+
+	return mem_ap_read_finish(ap, buffer, size, count, adr, addrinc, read_buf, retval);
+}
+
+/**
+ * Run several block transfers, typically on different MEM-APs, as one
+ * job.  All transfers of a DAP are queued before the queue is run once,
+ * so the adapter pipeline does not drain between them and the DP SELECT
+ * register is written once per job instead of once per queue run.
+ *
+ * If running the queue of a DAP fails, its read jobs are retried one at a
+ * time to find out which of them failed and how much was read. Its write
+ * jobs are not repeated, part of them may already have reached the
+ * target; they all get the error of the queue run.
+ *
+ * @param jobs The transfers; each gets its result in retval.
+ * @param job_count Number of entries in @a jobs.
+ * @return ERROR_OK if all transfers succeeded, else the first failure.
+ */
+int mem_ap_run_jobs(struct mem_ap_job *jobs, unsigned int job_count)
+{
+	for (unsigned int i = 0; i < job_count; i++) {
+		struct mem_ap_job *job = &jobs[i];
+
+		if (job->write)
+			job->retval = mem_ap_write_queue(job->ap, job->buffer, job->size,
+					job->count, job->address, true);
+		else
+			job->retval = mem_ap_read_queue(job->ap, job->size, job->count,
+					job->address, true, &job->read_buf);
+	}
+
+	for (unsigned int i = 0; i < job_count; i++) {
+		struct adiv5_dap *dap = jobs[i].ap->dap;
+		bool done = false;
+
+		/* each DAP is run once, by its first job */
+		for (unsigned int j = 0; j < i && !done; j++)
+			done = jobs[j].ap->dap == dap;
+		if (done)
+			continue;
+
+		int retval = dap_run(dap);
+		for (unsigned int j = i; j < job_count; j++) {
+			struct mem_ap_job *job = &jobs[j];
+
+			if (job->ap->dap != dap)
+				continue;
+
+			if (retval == ERROR_OK && job->retval == ERROR_OK) {
+				if (!job->write)
+					job->retval = mem_ap_read_finish(job->ap, job->buffer, job->size,
+							job->count, job->address, true, job->read_buf, ERROR_OK);
+			} else if (job->write) {
+				/* writing again could repeat side effects */
+				if (job->retval == ERROR_OK)
+					job->retval = retval;
+			} else {
+				/* the failure can't be attributed, repeat on its own */
+				free(job->read_buf);
+				job->retval = mem_ap_read_buf(job->ap, job->buffer, job->size,
+						job->count, job->address);
+			}
+			job->read_buf = NULL;
+		}
+	}
+
+	for (unsigned int i = 0; i < job_count; i++) {
+		if (jobs[i].retval != ERROR_OK)
+			return jobs[i].retval;
+	}
+
+	return ERROR_OK;
+}
+
 int mem_ap_read_buf(struct adiv5_ap *ap,
 		uint8_t *buffer, uint32_t size, uint32_t count, uint32_t address)
 {
 	return mem_ap_read(ap, buffer, size, count, address, true);
 }
 
+/* Bytes read per chunk of an asynchronous request, and time spent per service call */
+#define MEM_AP_ASYNC_CHUNK	4096
+#define MEM_AP_ASYNC_SLICE_MS	10
+
+struct mem_ap_async {
+	struct adiv5_ap *ap;
+	uint8_t *buffer;
+	uint32_t size;
+	uint32_t count;		/* left to read, in size units */
+	uint32_t address;
+	mem_ap_async_callback callback;
+	void *priv;
+	struct mem_ap_async *next;
+};
+
+static struct mem_ap_async *mem_ap_async_queue;
+static bool mem_ap_async_registered;
+
+static int mem_ap_async_service(void *priv);
+
+static void mem_ap_async_idle(void)
+{
+	if (mem_ap_async_registered && !mem_ap_async_queue) {
+		target_unregister_timer_callback(mem_ap_async_service, NULL);
+		mem_ap_async_registered = false;
+	}
+}
+
+static int mem_ap_async_service(void *priv)
+{
+	int64_t end = timeval_ms() + MEM_AP_ASYNC_SLICE_MS;
+
+	while (mem_ap_async_queue && timeval_ms() < end) {
+		struct mem_ap_async *req = mem_ap_async_queue;
+		uint32_t n = MIN(req->count, MEM_AP_ASYNC_CHUNK / req->size);
+		int retval = ERROR_OK;
+
+		if (n > 0)
+			retval = mem_ap_read(req->ap, req->buffer, req->size, n, req->address, true);
+		req->buffer += n * req->size;
+		req->address += n * req->size;
+		req->count -= n;
+
+		if (retval != ERROR_OK || req->count == 0) {
+			mem_ap_async_queue = req->next;
+			req->callback(req, retval, req->priv);
+			free(req);
+		}
+	}
+
+	if (mem_ap_async_queue)
+		target_timer_callbacks_request_poll();
+	mem_ap_async_idle();
+
+	return ERROR_OK;
+}
+
+/**
+ * Asynchronous variant of mem_ap_read_buf(). The block is read in chunks from
+ * a timer callback, so the server loop keeps servicing the other connections
+ * in between. Requests are served in submission order.
+ *
+ * @return A handle for mem_ap_async_cancel(), or NULL if the request could
+ *  not be queued; the callback is not called in that case.
+ */
+struct mem_ap_async *mem_ap_read_buf_async(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, uint32_t address,
+		mem_ap_async_callback callback, void *priv)
+{
+	if (!callback || (size != 1 && size != 2 && size != 4))
+		return NULL;
+
+	struct mem_ap_async *req = calloc(1, sizeof(*req));
+	if (!req) {
+		LOG_ERROR("Unable to allocate memory");
+		return NULL;
+	}
+	req->ap = ap;
+	req->buffer = buffer;
+	req->size = size;
+	req->count = count;
+	req->address = address;
+	req->callback = callback;
+	req->priv = priv;
+
+	if (!mem_ap_async_registered) {
+		if (target_register_timer_callback(mem_ap_async_service, 0,
+				TARGET_TIMER_TYPE_PERIODIC, NULL) != ERROR_OK) {
+			free(req);
+			return NULL;
+		}
+		mem_ap_async_registered = true;
+	}
+
+	struct mem_ap_async **p = &mem_ap_async_queue;
+	while (*p)
+		p = &(*p)->next;
+	*p = req;
+
+	target_timer_callbacks_request_poll();
+	return req;
+}
+
+void mem_ap_async_cancel(struct mem_ap_async *req)
+{
+	for (struct mem_ap_async **p = &mem_ap_async_queue; *p; p = &(*p)->next) {
+		if (*p == req) {
+			*p = req->next;
+			free(req);
+			break;
+		}
+	}
+
+	mem_ap_async_idle();
+}
+
 int mem_ap_write_buf(struct adiv5_ap *ap,
 		const uint8_t *buffer, uint32_t size, uint32_t count, uint32_t address)
 {
@@ -617,11 +941,124 @@ int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 	return mem_ap_write(ap, buffer, size, count, address, false);
 }
 
+/**
+ * Sample a PC sample register such as DBGPCSR or EDPCSR at @a address for
+ * @a seconds, or until @a max_num_samples were taken, without halting the
+ * core. The reads are queued in blocks through a non-incrementing MEM-AP
+ * access, which is much faster than halting the core for every sample.
+ * Reads returning 0xffffffff, i.e. no sample available because the core is
+ * halted or sampling is prohibited, are dropped.
+ */
+int mem_ap_sample_pc(struct adiv5_ap *ap, uint32_t address, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	struct timeval timeout, now;
+	uint32_t sample_count = 0;
+	int retval = ERROR_OK;
+
+	gettimeofday(&timeout, NULL);
+	timeval_add_time(&timeout, seconds, 0);
+
+	while (sample_count < max_num_samples) {
+		uint32_t read_count = MIN(max_num_samples - sample_count, 1024u);
+		uint8_t *buf = (uint8_t *)&samples[sample_count];
+
+		retval = mem_ap_read_buf_noincr(ap, buf, 4, read_count, address);
+		if (retval != ERROR_OK)
+			break;
+
+		for (uint32_t i = 0; i < read_count; i++) {
+			uint32_t pc = le_to_h_u32(buf + 4 * i);
+			if (pc != 0xffffffff)
+				samples[sample_count++] = pc;
+		}
+
+		keep_alive();
+		gettimeofday(&now, NULL);
+		if (timeval_compare(&now, &timeout) >= 0)
+			break;
+	}
+
+	*num_samples = sample_count;
+	return retval;
+}
+
 /*--------------------------------------------------------------------------*/
 
 
 #define DAP_POWER_DOMAIN_TIMEOUT (10)
 
+/* largest TAR autoincrement block mem_ap_probe_tar_autoincr() reports */
+#define TAR_AUTOINCR_BLOCK_MAX	(1 << 16)
+
+/**
+ * Find the TAR autoincrement block size of a MEM-AP.
+ *
+ * After a DRW access at the last word of a block the TAR either points
+ * to the next block or has wrapped to the start of the same one.  Only
+ * the 4 kB component the BASE register points to is known to be safe to
+ * read, so the boundaries at its offsets 0x400, 0x800 and 0x1000 are
+ * tested.  Crossing offset 0x1000 also crosses every larger boundary that
+ * address is aligned to, which bounds the detected size from below.
+ *
+ * @return the detected block size, or 0 if it could not be determined.
+ */
+static uint32_t mem_ap_probe_tar_autoincr(struct adiv5_ap *ap)
+{
+	uint32_t base, dummy, tar;
+
+	int retval = dap_queue_ap_read(ap, MEM_AP_REG_BASE, &base);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+	if (retval != ERROR_OK)
+		return 0;
+
+	/* legacy "no debug entries" or ADIv5 format with no entry present */
+	if (base == 0xFFFFFFFF || (base & 0x3) == 0x2)
+		return 0;
+
+	uint32_t component = base & 0xFFFFF000;
+	for (uint32_t boundary = 0x400; boundary <= 0x1000; boundary <<= 1) {
+		retval = mem_ap_setup_transfer(ap, CSW_32BIT | CSW_ADDRINC_SINGLE,
+				component + boundary - 4);
+		if (retval == ERROR_OK)
+			retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW, &dummy);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_tar(ap, &tar);
+		if (retval != ERROR_OK) {
+			ap->tar_valid = false;
+			return 0;
+		}
+
+		if (tar != component + boundary)
+			return boundary;
+	}
+
+	/* no wrap at component + 0x1000, so the block is larger than the
+	 * largest power of two that address is a multiple of */
+	uint32_t next = component + 0x1000;
+	if (!next)
+		return TAR_AUTOINCR_BLOCK_MAX;
+	return MIN((uint64_t)(next & -next) << 1, TAR_AUTOINCR_BLOCK_MAX);
+}
+
+/**
+ * Override the TAR autoincrement block size of a MEM-AP, for cores that
+ * document it.  A size larger than the one found by mem_ap_init() is
+ * not applied.
+ */
+void mem_ap_set_tar_autoincr_block(struct adiv5_ap *ap, uint32_t size)
+{
+	if (ap->tar_autoincr_detected && size > ap->tar_autoincr_detected) {
+		LOG_WARNING("MEM-AP #%" PRIu8 ": TAR autoincrement block of %" PRIu32
+				" bytes exceeds the detected %" PRIu32 ", ignored",
+				ap->ap_num, size, ap->tar_autoincr_detected);
+		return;
+	}
+
+	ap->tar_autoincr_block = size;
+}
+
 /*--------------------------------------------------------------------------*/
 
 /**
@@ -640,6 +1077,144 @@ void dap_invalidate_cache(struct adiv5_dap *dap)
 	}
 }
 
+/* number of times the check sequence is run at each probed adapter speed */
+#define DAP_SPEED_AUTO_PASSES	16
+
+/* word aligned values written to and read back from MEM-AP TAR */
+static const uint32_t dap_speed_auto_patterns[] = {
+	0x00000000, 0xfffffffc, 0xaaaaaaa8, 0x55555554,
+	0x0f0f0f0c, 0xf0f0f0f0, 0x12345678, 0xedcba984,
+};
+
+struct dap_speed_auto_sample {
+	uint32_t dpidr;
+	uint32_t idr;
+	uint32_t csw;
+	uint32_t tar[ARRAY_SIZE(dap_speed_auto_patterns)];
+};
+
+/*
+ * Read DPIDR and AP #0 IDR and, if AP #0 is a MEM-AP, its CSW and
+ * the TAR value after writing each of the patterns.  Memory is never
+ * accessed, so this is safe before the target memory map is known.
+ */
+static int dap_speed_auto_sample(struct adiv5_dap *dap, bool mem_ap,
+		struct dap_speed_auto_sample *s)
+{
+	struct adiv5_ap *ap = dap_ap(dap, 0);
+
+	memset(s, 0, sizeof(*s));
+	int retval = dap_queue_dp_read(dap, DP_DPIDR, &s->dpidr);
+	if (retval == ERROR_OK)
+		retval = dap_queue_ap_read(ap, AP_REG_IDR, &s->idr);
+	if (retval == ERROR_OK && mem_ap)
+		retval = dap_queue_ap_read(ap, MEM_AP_REG_CSW, &s->csw);
+	for (size_t i = 0; retval == ERROR_OK && mem_ap && i < ARRAY_SIZE(dap_speed_auto_patterns); i++) {
+		retval = dap_queue_ap_write(ap, MEM_AP_REG_TAR, dap_speed_auto_patterns[i]);
+		if (retval == ERROR_OK)
+			retval = dap_queue_ap_read(ap, MEM_AP_REG_TAR, &s->tar[i]);
+	}
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+	return retval;
+}
+
+/*
+ * Search for the fastest reliable adapter speed, see "adapter speed auto".
+ * The speed is doubled from the configured one until a check sequence at
+ * the new speed fails or differs from the one taken at the starting speed,
+ * then the last good speed is restored.
+ */
+static int dap_speed_auto(struct adiv5_dap *dap)
+{
+	unsigned max_khz = jtag_get_speed_auto_max_khz();
+	struct dap_speed_auto_sample ref, s;
+	int good_khz = 0;
+	bool failed = false;
+
+	dap->speed_auto_done = true;
+
+	int retval = jtag_get_speed_readable(&good_khz);
+	if (retval != ERROR_OK)
+		return retval;
+	if (good_khz <= 0) {
+		LOG_WARNING("DAP: adapter speed auto needs a fixed starting speed");
+		return ERROR_OK;
+	}
+
+	retval = dap_speed_auto_sample(dap, false, &ref);
+	if (retval == ERROR_OK)
+		retval = dap_speed_auto_sample(dap, (ref.idr & IDR_CLASS) == AP_CLASS_MEM_AP, &ref);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("DAP: adapter speed auto reference check failed at %d kHz", good_khz);
+		return retval;
+	}
+	bool mem_ap = (ref.idr & IDR_CLASS) == AP_CLASS_MEM_AP;
+
+	while ((unsigned)good_khz < max_khz && !failed) {
+		unsigned try_khz = MIN((unsigned)good_khz * 2, max_khz);
+		int khz = 0;
+
+		retval = jtag_config_khz(try_khz);
+		if (retval != ERROR_OK) {
+			/* e.g. a CMSIS-DAP probe refused DAP_SWJ_Clock, its clock
+			 * is unknown now */
+			LOG_DEBUG("DAP: adapter refused a speed of %u kHz", try_khz);
+			failed = true;
+			break;
+		}
+		retval = jtag_get_speed_readable(&khz);
+		if (retval != ERROR_OK || khz <= good_khz)
+			break;	/* the adapter can't go any faster */
+
+		/* Some adapters, e.g. CMSIS-DAP, echo the requested speed and
+		 * quietly clamp it in the probe, so the speed is only trusted
+		 * once DPIDR reads back right at it. */
+		uint32_t dpidr = 0;
+		retval = dap_queue_dp_read(dap, DP_DPIDR, &dpidr);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+		if (retval != ERROR_OK || dpidr != ref.dpidr) {
+			LOG_DEBUG("DAP: DPIDR check at %d kHz failed", khz);
+			failed = true;
+			break;
+		}
+
+		for (int pass = 0; pass < DAP_SPEED_AUTO_PASSES; pass++) {
+			if (dap_speed_auto_sample(dap, mem_ap, &s) != ERROR_OK
+					|| memcmp(&s, &ref, sizeof(s))) {
+				LOG_DEBUG("DAP: adapter speed %d kHz failed in pass %d", khz, pass);
+				failed = true;
+				break;
+			}
+		}
+		if (!failed)
+			good_khz = khz;
+	}
+
+	retval = jtag_config_khz(good_khz);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* TAR of AP #0 was clobbered */
+	dap_invalidate_cache(dap);
+
+	if (failed) {
+		/* the link may be lost, reestablish it at the good speed */
+		dap->do_reconnect = true;
+		retval = dap_queue_dp_read(dap, DP_DPIDR, NULL);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("DAP: reconnect at %d kHz failed", good_khz);
+			return retval;
+		}
+	}
+
+	LOG_INFO("DAP: adapter speed auto settled at %d kHz", good_khz);
+	return ERROR_OK;
+}
+
 /**
  * Initialize a DAP.  This sets up the power domains, prepares the DP
  * for further use and activates overrun checking.
@@ -728,6 +1303,10 @@ int dap_dp_init(struct adiv5_dap *dap)
 	if (retval != ERROR_OK)
 		return retval;
 
+	if (!dap->speed_auto_done && jtag_get_speed_auto_max_khz()
+			&& (transport_is_swd() || transport_is_dapdirect_swd()))
+		retval = dap_speed_auto(dap);
+
 	return retval;
 }
 
@@ -787,6 +1366,15 @@ int mem_ap_init(struct adiv5_ap *ap)
 	LOG_DEBUG("MEM_AP CFG: large data %d, long address %d, big-endian %d",
 			!!(cfg & 0x04), !!(cfg & 0x02), !!(cfg & 0x01));
 
+	/* probed once, mem_ap_init() runs again on each examine */
+	if (!ap->tar_autoincr_detected) {
+		ap->tar_autoincr_detected = mem_ap_probe_tar_autoincr(ap);
+		if (ap->tar_autoincr_detected)
+			ap->tar_autoincr_block = ap->tar_autoincr_detected;
+		LOG_DEBUG("MEM_AP TAR autoincrement block: %" PRIu32 " bytes%s",
+				ap->tar_autoincr_block, ap->tar_autoincr_detected ? "" : " (default)");
+	}
+
 	return ERROR_OK;
 }
 
@@ -920,7 +1508,7 @@ int dap_get_debugbase(struct adiv5_ap *ap,
 	return ERROR_OK;
 }
 
-int dap_lookup_cs_component(struct adiv5_ap *ap,
+static int dap_lookup_cs_component_scan(struct adiv5_ap *ap,
 			uint32_t dbgbase, uint8_t type, uint32_t *addr, int32_t *idx)
 {
 	uint32_t romentry, entry_offset = 0, component_base, devtype;
@@ -946,7 +1534,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap,
 				return retval;
 			}
 			if (((c_cid1 >> 4) & 0x0f) == 1) {
-				retval = dap_lookup_cs_component(ap, component_base,
+				retval = dap_lookup_cs_component_scan(ap, component_base,
 							type, addr, idx);
 				if (retval == ERROR_OK)
 					break;
@@ -976,6 +1564,179 @@ int dap_lookup_cs_component(struct adiv5_ap *ap,
 	return ERROR_OK;
 }
 
+/*
+ * ROM table cache: one line per dap_lookup_cs_component() result, keyed on
+ * the identity of the DP, the AP and the ROM table the walk started from.
+ */
+struct dap_rom_cache_entry {
+	uint32_t dpidr;
+	uint32_t apid;
+	uint32_t dbgbase;
+	uint8_t ap_num;
+	uint8_t type;
+	int32_t idx;
+	uint32_t addr;
+};
+
+static void dap_rom_cache_free(struct adiv5_dap *dap)
+{
+	free(dap->rom_cache);
+	dap->rom_cache = NULL;
+	dap->rom_cache_count = 0;
+	dap->rom_cache_loaded = false;
+}
+
+void dap_rom_cache_cleanup(struct adiv5_dap *dap)
+{
+	free(dap->rom_cache_file);
+	dap->rom_cache_file = NULL;
+	dap_rom_cache_free(dap);
+}
+
+static int dap_rom_cache_add(struct adiv5_dap *dap, const struct dap_rom_cache_entry *e)
+{
+	struct dap_rom_cache_entry *cache = realloc(dap->rom_cache,
+			(dap->rom_cache_count + 1) * sizeof(*cache));
+	if (!cache) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
+	}
+	cache[dap->rom_cache_count++] = *e;
+	dap->rom_cache = cache;
+	return ERROR_OK;
+}
+
+static void dap_rom_cache_load(struct adiv5_dap *dap)
+{
+	char line[128];
+	unsigned int ap_num, type;
+	struct dap_rom_cache_entry e;
+
+	dap->rom_cache_loaded = true;
+
+	FILE *f = fopen(dap->rom_cache_file, "r");
+	if (!f)
+		return;	/* nothing cached yet */
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%" SCNx32 " %u %" SCNx32 " %" SCNx32 " %x %" SCNi32 " %" SCNx32,
+				&e.dpidr, &ap_num, &e.apid, &e.dbgbase, &type, &e.idx, &e.addr) != 7
+				|| ap_num > 255 || type > 255) {
+			LOG_WARNING("%s: ignoring malformed ROM table cache line", dap->rom_cache_file);
+			continue;
+		}
+		e.ap_num = ap_num;
+		e.type = type;
+		if (dap_rom_cache_add(dap, &e) != ERROR_OK)
+			break;
+	}
+	fclose(f);
+
+	LOG_DEBUG("%s: %u cached ROM table lookups", dap->rom_cache_file, dap->rom_cache_count);
+}
+
+static void dap_rom_cache_save(struct adiv5_dap *dap)
+{
+	FILE *f = fopen(dap->rom_cache_file, "w");
+	if (!f) {
+		LOG_WARNING("Unable to write ROM table cache %s", dap->rom_cache_file);
+		return;
+	}
+
+	fprintf(f, "# dpidr ap apid dbgbase type idx addr\n");
+	for (unsigned int i = 0; i < dap->rom_cache_count; i++) {
+		const struct dap_rom_cache_entry *e = &dap->rom_cache[i];
+		fprintf(f, "%08" PRIx32 " %u %08" PRIx32 " %08" PRIx32 " %02x %" PRId32 " %08" PRIx32 "\n",
+				e->dpidr, e->ap_num, e->apid, e->dbgbase, e->type, e->idx, e->addr);
+	}
+	fclose(f);
+}
+
+static struct dap_rom_cache_entry *dap_rom_cache_find(struct adiv5_dap *dap,
+		const struct dap_rom_cache_entry *key)
+{
+	for (unsigned int i = 0; i < dap->rom_cache_count; i++) {
+		struct dap_rom_cache_entry *e = &dap->rom_cache[i];
+		if (e->dpidr == key->dpidr && e->ap_num == key->ap_num && e->apid == key->apid
+				&& e->dbgbase == key->dbgbase && e->type == key->type && e->idx == key->idx)
+			return e;
+	}
+	return NULL;
+}
+
+/* Check that a cached component is still there: CoreSight CID and DEVTYPE */
+static bool dap_rom_cache_verify(struct adiv5_ap *ap, uint32_t component_base, uint8_t type)
+{
+	uint32_t cid[4], devtype;
+	int retval;
+
+	retval = mem_ap_read_u32(ap, component_base | 0xFCC, &devtype);
+	for (unsigned int i = 0; i < 4 && retval == ERROR_OK; i++)
+		retval = mem_ap_read_u32(ap, component_base | (0xFF0 + 4 * i), &cid[i]);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+	if (retval != ERROR_OK)
+		return false;
+
+	return (cid[0] & 0xFF) == 0x0D && (cid[1] & 0xFF) == 0x90
+		&& (cid[2] & 0xFF) == 0x05 && (cid[3] & 0xFF) == 0xB1
+		&& (devtype & 0xFF) == type;
+}
+
+int dap_lookup_cs_component(struct adiv5_ap *ap,
+			uint32_t dbgbase, uint8_t type, uint32_t *addr, int32_t *idx)
+{
+	struct adiv5_dap *dap = ap->dap;
+	struct dap_rom_cache_entry key = {
+		.dbgbase = dbgbase,
+		.ap_num = ap->ap_num,
+		.type = type,
+		.idx = *idx,
+	};
+	struct dap_rom_cache_entry *e = NULL;
+	bool use_cache = false;
+	int retval;
+
+	if (dap->rom_cache_file) {
+		if (!dap->rom_cache_loaded)
+			dap_rom_cache_load(dap);
+
+		retval = dap_queue_dp_read(dap, DP_DPIDR, &key.dpidr);
+		if (retval == ERROR_OK)
+			retval = dap_queue_ap_read(ap, AP_REG_IDR, &key.apid);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+		use_cache = retval == ERROR_OK;
+	}
+
+	if (use_cache) {
+		e = dap_rom_cache_find(dap, &key);
+		if (e && dap_rom_cache_verify(ap, e->addr, type)) {
+			LOG_DEBUG("AP%d cached component type 0x%02x at 0x%08" PRIx32,
+					ap->ap_num, type, e->addr);
+			*addr = e->addr;
+			*idx = 0;
+			return ERROR_OK;
+		}
+	}
+
+	retval = dap_lookup_cs_component_scan(ap, dbgbase, type, addr, idx);
+
+	if (use_cache && retval == ERROR_OK) {
+		key.addr = *addr;
+		if (e) {
+			*e = key;
+			dap_rom_cache_save(dap);
+		} else if (dap_rom_cache_add(dap, &key) == ERROR_OK) {
+			dap_rom_cache_save(dap);
+		}
+	}
+
+	return retval;
+}
+
 static int dap_read_part_id(struct adiv5_ap *ap, uint32_t component_base, uint32_t *cid, uint64_t *pid)
 {
 	assert((component_base & 0xFFF) == 0);
@@ -1428,6 +2189,16 @@ int dap_info_command(struct command_invocation *cmd,
 	if (retval != ERROR_OK)
 		return retval;
 
+	command_print(cmd, "Register writes skipped: SELECT %" PRIu64 ", CSW %" PRIu64 ", TAR %" PRIu64,
+			ap->dap->select_writes_skipped, ap->dap->csw_writes_skipped,
+			ap->dap->tar_writes_skipped);
+	if (transport_is_jtag())
+		command_print(cmd, "JTAG-DP WAIT recoveries: %" PRIu64 ", replayed transactions: %" PRIu64,
+				ap->dap->wait_recoveries, ap->dap->wait_replayed);
+	if (ap->dap->multidrop)
+		command_print(cmd, "SWD multi-drop TARGETSEL 0x%08" PRIx32 ", switches to this DP: %" PRIu64,
+				ap->dap->multidrop_targetsel, ap->dap->multidrop_switches);
+
 	command_print(cmd, "AP ID register 0x%8.8" PRIx32, apid);
 	if (apid == 0) {
 		command_print(cmd, "No AP found at this ap 0x%x", ap->ap_num);
@@ -1789,6 +2560,101 @@ COMMAND_HANDLER(dap_apid_command)
 	return retval;
 }
 
+static void dap_bench_report(struct command_invocation *cmd, const char *what,
+		const struct duration *d, size_t bytes, size_t transactions, unsigned int calls)
+{
+	float elapsed = duration_elapsed(d);
+
+	command_print(cmd, "%s: %zu bytes in %.3f s, %.2f KiB/s, %.0f transactions/s, "
+			"%.3f ms per call", what, bytes, elapsed, duration_kbps(d, bytes),
+			elapsed > 0 ? transactions / elapsed : 0, 1000 * elapsed / calls);
+}
+
+/*
+ * Time mem_ap_read_buf() and mem_ap_write_buf() over a memory block. The
+ * block is read, then its content is written back, so RAM is left as it was.
+ */
+COMMAND_HANDLER(dap_bench_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+	uint32_t apsel, address, bytes, width = 4, iterations = 1;
+	bool addrinc = true;
+	struct duration bench;
+	int retval = ERROR_OK;
+
+	if (CMD_ARGC < 3 || CMD_ARGC > 6)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], apsel);
+	if (apsel > DP_APSEL_MAX) {
+		command_print(CMD, "Invalid AP number");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], bytes);
+	if (CMD_ARGC > 3)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], width);
+	if (CMD_ARGC > 4)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[4], iterations);
+	if (CMD_ARGC > 5) {
+		if (strcmp(CMD_ARGV[5], "noincr"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		addrinc = false;
+	}
+
+	if (width != 1 && width != 2 && width != 4) {
+		command_print(CMD, "Invalid width (should be 1, 2 or 4)");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (bytes == 0 || bytes % width || address % width || iterations == 0) {
+		command_print(CMD, "Invalid size, alignment or iteration count");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct adiv5_ap *ap = dap_ap(dap, apsel);
+	uint32_t count = bytes / width;
+	/* DRW accesses per call, packed transfers move a whole word each */
+	size_t transactions = count;
+	if (ap->packed_transfers && addrinc && width < 4)
+		transactions = DIV_ROUND_UP(bytes, 4);
+
+	uint8_t *buffer = malloc(bytes);
+	if (!buffer) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
+	}
+
+	command_print(CMD, "AP%" PRIu32 " 0x%08" PRIx32 ", %" PRIu32 " bytes, %" PRIu32
+			"-bit%s, %" PRIu32 " iterations", apsel, address, bytes, 8 * width,
+			addrinc ? "" : " noincr", iterations);
+
+	duration_start(&bench);
+	for (uint32_t i = 0; i < iterations && retval == ERROR_OK; i++) {
+		if (addrinc)
+			retval = mem_ap_read_buf(ap, buffer, width, count, address);
+		else
+			retval = mem_ap_read_buf_noincr(ap, buffer, width, count, address);
+	}
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK)
+		dap_bench_report(CMD, "read", &bench, (size_t)bytes * iterations,
+				transactions * iterations, iterations);
+
+	if (retval == ERROR_OK)
+		duration_start(&bench);
+	for (uint32_t i = 0; i < iterations && retval == ERROR_OK; i++) {
+		if (addrinc)
+			retval = mem_ap_write_buf(ap, buffer, width, count, address);
+		else
+			retval = mem_ap_write_buf_noincr(ap, buffer, width, count, address);
+	}
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK)
+		dap_bench_report(CMD, "write", &bench, (size_t)bytes * iterations,
+				transactions * iterations, iterations);
+
+	free(buffer);
+	return retval;
+}
+
 COMMAND_HANDLER(dap_apreg_command)
 {
 	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
@@ -1886,6 +2752,30 @@ COMMAND_HANDLER(dap_ti_be_32_quirks_command)
 		"TI BE-32 quirks mode");
 }
 
+COMMAND_HANDLER(dap_rom_cache_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		free(dap->rom_cache_file);
+		dap->rom_cache_file = NULL;
+		dap_rom_cache_free(dap);
+		if (CMD_ARGV[0][0]) {
+			dap->rom_cache_file = strdup(CMD_ARGV[0]);
+			if (!dap->rom_cache_file) {
+				LOG_ERROR("Unable to allocate memory");
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	command_print(CMD, "rom_cache %s", dap->rom_cache_file ? dap->rom_cache_file : "disabled");
+	return ERROR_OK;
+}
+
 const struct command_registration dap_instance_commands[] = {
 	{
 		.name = "info",
@@ -1927,6 +2817,14 @@ const struct command_registration dap_instance_commands[] = {
 			"(reg is byte address of a word register, like 0 4 8...)",
 		.usage = "ap_num reg [value]",
 	},
+	{
+		.name = "bench",
+		.handler = dap_bench_command,
+		.mode = COMMAND_EXEC,
+		.help = "measure MEM-AP read and write throughput over a memory "
+			"block, restoring its content",
+		.usage = "ap_num address bytes [width [iterations ['noincr']]]",
+	},
 	{
 		.name = "dpreg",
 		.handler = dap_dpreg_command,
@@ -1958,5 +2856,13 @@ const struct command_registration dap_instance_commands[] = {
 		.help = "set/get quirks mode for TI TMS450/TMS570 processors",
 		.usage = "[enable]",
 	},
+	{
+		.name = "rom_cache",
+		.handler = dap_rom_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "set/get the file caching CoreSight component lookups "
+			"(empty string disables the cache)",
+		.usage = "[filename]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -30,6 +30,7 @@
  */
 
 #include <helper/list.h>
+#include <helper/perf.h>
 #include "arm_jtag.h"
 
 /* three-bit ACK values for SWD access (sent LSB first) */
@@ -61,6 +62,14 @@
 
 #define DLCR_TO_TRN(dlcr) ((uint32_t)(1 + ((3 & (dlcr)) >> 8))) /* 1..4 clocks */
 
+/* Fields of the DP's DPIDR register */
+#define DP_DPIDR_VERSION_SHIFT  12
+#define DP_DPIDR_VERSION_MASK   (0xFUL << DP_DPIDR_VERSION_SHIFT)
+
+/* Fields of the DP's TARGETSEL register */
+#define DP_TARGETSEL_TINSTANCE_SHIFT 28
+#define DP_TARGETSEL_DPID_MASK  0x0FFFFFFFUL
+
 /* Fields of the DP's AP ABORT register */
 #define DAPABORT        (1UL << 0)
 #define STKCMPCLR       (1UL << 1) /* SWD-only */
@@ -210,6 +219,9 @@ struct adiv5_ap {
 	/* Size of TAR autoincrement block, ARM ADI Specification requires at least 10 bits */
 	uint32_t tar_autoincr_block;
 
+	/* TAR autoincrement block size found by mem_ap_init(), 0 if unknown */
+	uint32_t tar_autoincr_detected;
+
 	/* true if packed transfers are supported by the MEM-AP */
 	bool packed_transfers;
 
@@ -240,15 +252,34 @@ struct adiv5_ap {
 struct adiv5_dap {
 	const struct dap_ops *ops;
 
-	/* dap transaction list for WAIT support */
-	struct list_head cmd_journal;
+	/* dap transactions since the last run, in order, for WAIT support */
+	struct dap_cmd **cmd_journal;
+	size_t cmd_journal_len;
 
-	/* pool for dap_cmd objects */
-	struct list_head cmd_pool;
+	/* pool for dap_cmd objects: fixed size chunks and a free list */
+	struct dap_cmd **cmd_chunks;
+	size_t cmd_chunk_count;
+	struct dap_cmd *cmd_free;
 
-	/* number of dap_cmd objects in the pool */
+	/* number of dap_cmd objects in use */
 	size_t cmd_pool_size;
 
+	/* WAIT recoveries and the transactions they replayed */
+	uint64_t wait_recoveries;
+	uint64_t wait_replayed;
+
+	/* writes avoided because SELECT, or CSW or TAR of an AP, already
+	 * held the value */
+	uint64_t select_writes_skipped;
+	uint64_t csw_writes_skipped;
+	uint64_t tar_writes_skipped;
+
+	/* SWD multi-drop: TARGETSEL value of this DP, and how many times
+	 * the link was switched to it */
+	bool multidrop;
+	uint32_t multidrop_targetsel;
+	uint64_t multidrop_switches;
+
 	struct jtag_tap *tap;
 	/* Control config */
 	uint32_t dp_ctrl_stat;
@@ -294,6 +325,16 @@ struct adiv5_dap {
 	/** Flag saying whether to ignore the syspwrupack flag in DAP. Some devices
 	 *  do not set this bit until later in the bringup sequence */
 	bool ignore_syspwrupack;
+
+	/** Set once the "adapter speed auto" search has run on this DAP */
+	bool speed_auto_done;
+
+	/** File keeping dap_lookup_cs_component() results across sessions,
+	 *  NULL when the ROM table cache is disabled */
+	char *rom_cache_file;
+	struct dap_rom_cache_entry *rom_cache;
+	unsigned int rom_cache_count;
+	bool rom_cache_loaded;
 };
 
 /**
@@ -327,6 +368,12 @@ struct dap_ops {
 	/** AP operation abort. */
 	int (*queue_ap_abort)(struct adiv5_dap *dap, uint8_t *ack);
 
+	/** Optional; AP register read repeated by the adapter until
+	 * (value & mask) == match, run() returns ERROR_TIMEOUT_REACHED if
+	 * it gave up. ERROR_NOT_IMPLEMENTED if the adapter can't do it. */
+	int (*queue_ap_read_match)(struct adiv5_ap *ap, unsigned reg,
+			uint32_t mask, uint32_t match);
+
 	/** Executes all queued DAP operations. */
 	int (*run)(struct adiv5_dap *dap);
 
@@ -442,6 +489,28 @@ static inline int dap_queue_ap_write(struct adiv5_ap *ap,
 	return ap->dap->ops->queue_ap_write(ap, reg, data);
 }
 
+/**
+ * Queue an AP register read which the adapter repeats until the bits
+ * of @a mask read as @a match, without a round trip to the host for
+ * each read.
+ *
+ * @param ap The AP used for reading.
+ * @param reg The number of the AP register being read.
+ * @param mask Bits of the register to compare.
+ * @param match Value expected in the bits of @a mask.
+ *
+ * @return ERROR_OK for success, ERROR_NOT_IMPLEMENTED if the adapter
+ * can't compare the values.
+ */
+static inline int dap_queue_ap_read_match(struct adiv5_ap *ap,
+		unsigned reg, uint32_t mask, uint32_t match)
+{
+	assert(ap->dap->ops != NULL);
+	if (ap->dap->ops->queue_ap_read_match == NULL)
+		return ERROR_NOT_IMPLEMENTED;
+	return ap->dap->ops->queue_ap_read_match(ap, reg, mask, match);
+}
+
 /**
  * Queue an AP abort operation.  The current AP transaction is aborted,
  * including any update of the transaction counter.  The AP is left in
@@ -459,6 +528,9 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	return dap->ops->queue_ap_abort(dap, ack);
 }
 
+/* Invalidate cached DP select and cached TAR and CSW of all APs */
+void dap_invalidate_cache(struct adiv5_dap *dap);
+
 /**
  * Perform all queued DAP operations, and clear any errors posted in the
  * CTRL_STAT register when they are done.  Note that if more than one AP
@@ -472,7 +544,15 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 static inline int dap_run(struct adiv5_dap *dap)
 {
 	assert(dap->ops != NULL);
-	return dap->ops->run(dap);
+	int64_t start = perf_start();
+	int retval = dap->ops->run(dap);
+	perf_end(PERF_DAP_RUN, start);
+
+	/* a failed transaction leaves SELECT, CSW and TAR unknown */
+	if (retval != ERROR_OK)
+		dap_invalidate_cache(dap);
+
+	return retval;
 }
 
 static inline int dap_sync(struct adiv5_dap *dap)
@@ -531,6 +611,8 @@ int mem_ap_write_u32(struct adiv5_ap *ap,
 		uint32_t address, uint32_t value);
 
 /* Synchronous MEM-AP memory mapped single word transfers. */
+int mem_ap_poll_atomic_u32(struct adiv5_ap *ap, uint32_t address,
+		uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms);
 int mem_ap_read_atomic_u32(struct adiv5_ap *ap,
 		uint32_t address, uint32_t *value);
 int mem_ap_write_atomic_u32(struct adiv5_ap *ap,
@@ -548,12 +630,52 @@ int mem_ap_read_buf_noincr(struct adiv5_ap *ap,
 int mem_ap_write_buf_noincr(struct adiv5_ap *ap,
 		const uint8_t *buffer, uint32_t size, uint32_t count, uint32_t address);
 
+/* Non-intrusive PC sampling through a DBGPCSR/EDPCSR style register. */
+int mem_ap_sample_pc(struct adiv5_ap *ap, uint32_t address, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+
+/**
+ * One block transfer of mem_ap_run_jobs(), with the arguments of
+ * mem_ap_read_buf() or mem_ap_write_buf().
+ */
+struct mem_ap_job {
+	struct adiv5_ap *ap;
+	bool write;
+	/* data read, or data to write */
+	uint8_t *buffer;
+	uint32_t size;
+	uint32_t count;
+	uint32_t address;
+	/* result of this job, set by mem_ap_run_jobs() */
+	int retval;
+	/* DRW words of a read job while it is queued */
+	uint32_t *read_buf;
+};
+
+/* Synchronous block transfers on several MEM-APs sharing the DAP queues */
+int mem_ap_run_jobs(struct mem_ap_job *jobs, unsigned int job_count);
+
+struct mem_ap_async;
+
+/**
+ * Completion callback of mem_ap_read_buf_async(), called from the server
+ * loop once the whole block is in the buffer or a transfer failed.
+ */
+typedef void (*mem_ap_async_callback)(struct mem_ap_async *req, int retval, void *priv);
+
+/* Block read split in chunks serviced by the server loop between clients */
+struct mem_ap_async *mem_ap_read_buf_async(struct adiv5_ap *ap,
+		uint8_t *buffer, uint32_t size, uint32_t count, uint32_t address,
+		mem_ap_async_callback callback, void *priv);
+/* Drop a pending request; its callback is not called */
+void mem_ap_async_cancel(struct mem_ap_async *req);
+
 /* Initialisation of the debug system, power domains and registers */
 int dap_dp_init(struct adiv5_dap *dap);
 int mem_ap_init(struct adiv5_ap *ap);
 
-/* Invalidate cached DP select and cached TAR and CSW of all APs */
-void dap_invalidate_cache(struct adiv5_dap *dap);
+/* Override the TAR autoincrement block size, never above the detected one */
+void mem_ap_set_tar_autoincr_block(struct adiv5_ap *ap, uint32_t size);
 
 /* Probe the AP for ROM Table location */
 int dap_get_debugbase(struct adiv5_ap *ap,
@@ -573,6 +695,9 @@ static inline struct adiv5_ap *dap_ap(struct adiv5_dap *dap, uint8_t ap_num)
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint32_t dbgbase, uint8_t type, uint32_t *addr, int32_t *idx);
 
+/* Release the ROM table cache of a DAP */
+void dap_rom_cache_cleanup(struct adiv5_dap *dap);
+
 struct target;
 
 /* Put debug link into SWD mode */
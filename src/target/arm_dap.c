@@ -58,8 +58,6 @@ static void dap_instance_init(struct adiv5_dap *dap)
 		/* default CSW value */
 		dap->ap[i].csw_default = CSW_AHB_DEFAULT;
 	}
-	INIT_LIST_HEAD(&dap->cmd_journal);
-	INIT_LIST_HEAD(&dap->cmd_pool);
 }
 
 const char *adiv5_dap_name(struct adiv5_dap *self)
@@ -144,6 +142,7 @@ int dap_cleanup_all(void)
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
 
+		dap_rom_cache_cleanup(dap);
 		free(obj->name);
 		free(obj);
 	}
@@ -154,17 +153,23 @@ int dap_cleanup_all(void)
 enum dap_cfg_param {
 	CFG_CHAIN_POSITION,
 	CFG_IGNORE_SYSPWRUPACK,
+	CFG_DP_ID,
+	CFG_INSTANCE_ID,
 };
 
 static const Jim_Nvp nvp_config_opts[] = {
 	{ .name = "-chain-position",   .value = CFG_CHAIN_POSITION },
 	{ .name = "-ignore-syspwrupack", .value = CFG_IGNORE_SYSPWRUPACK },
+	{ .name = "-dp-id",            .value = CFG_DP_ID },
+	{ .name = "-instance-id",      .value = CFG_INSTANCE_ID },
 	{ .name = NULL, .value = -1 }
 };
 
 static int dap_configure(Jim_GetOptInfo *goi, struct arm_dap_object *dap)
 {
 	struct jtag_tap *tap = NULL;
+	bool multidrop = false;
+	uint32_t dp_id = 0, instance_id = 0;
 	Jim_Nvp *n;
 	int e;
 
@@ -194,6 +199,31 @@ static int dap_configure(Jim_GetOptInfo *goi, struct arm_dap_object *dap)
 		case CFG_IGNORE_SYSPWRUPACK:
 			dap->dap.ignore_syspwrupack = true;
 			break;
+		case CFG_DP_ID: {
+			jim_wide w;
+			e = Jim_GetOpt_Wide(goi, &w);
+			if (e != JIM_OK)
+				return e;
+			if (w < 0 || w > DP_TARGETSEL_DPID_MASK) {
+				Jim_SetResultString(goi->interp, "-dp-id out of range", -1);
+				return JIM_ERR;
+			}
+			dp_id = w;
+			multidrop = true;
+			break;
+		}
+		case CFG_INSTANCE_ID: {
+			jim_wide w;
+			e = Jim_GetOpt_Wide(goi, &w);
+			if (e != JIM_OK)
+				return e;
+			if (w < 0 || w > 15) {
+				Jim_SetResultString(goi->interp, "-instance-id out of range", -1);
+				return JIM_ERR;
+			}
+			instance_id = w;
+			break;
+		}
 		default:
 			break;
 		}
@@ -206,6 +236,8 @@ static int dap_configure(Jim_GetOptInfo *goi, struct arm_dap_object *dap)
 
 	dap_instance_init(&dap->dap);
 	dap->dap.tap = tap;
+	dap->dap.multidrop = multidrop;
+	dap->dap.multidrop_targetsel = (instance_id << DP_TARGETSEL_TINSTANCE_SHIFT) | dp_id;
 
 	return JIM_OK;
 }
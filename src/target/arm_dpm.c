@@ -348,6 +348,8 @@ int arm_dpm_read_current_registers(struct arm_dpm *dpm)
 	int retval;
 	struct reg *r;
 
+	arm_dpm_tlb_flush(dpm);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -456,6 +458,8 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	int retval;
 	bool did_write;
 
+	arm_dpm_tlb_flush(dpm);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -1045,6 +1049,40 @@ void arm_dpm_report_dscr(struct arm_dpm *dpm, uint32_t dscr)
 	}
 }
 
+static struct dpm_tlb_entry *arm_dpm_tlb_entry(struct arm_dpm *dpm,
+	target_addr_t va)
+{
+	return &dpm->tlb[(va >> 12) % DPM_TLB_SIZE];
+}
+
+void arm_dpm_tlb_flush(struct arm_dpm *dpm)
+{
+	for (unsigned int i = 0; i < DPM_TLB_SIZE; i++)
+		dpm->tlb[i].valid = false;
+}
+
+bool arm_dpm_tlb_lookup(struct arm_dpm *dpm, target_addr_t va, uint64_t *par)
+{
+	struct dpm_tlb_entry *e = arm_dpm_tlb_entry(dpm, va);
+
+	if (!e->valid || e->mode != dpm->arm->core_mode
+			|| e->va != (va & ~(target_addr_t)0xfff))
+		return false;
+
+	*par = e->par;
+	return true;
+}
+
+void arm_dpm_tlb_fill(struct arm_dpm *dpm, target_addr_t va, uint64_t par)
+{
+	struct dpm_tlb_entry *e = arm_dpm_tlb_entry(dpm, va);
+
+	e->valid = true;
+	e->mode = dpm->arm->core_mode;
+	e->va = va & ~(target_addr_t)0xfff;
+	e->par = par;
+}
+
 /*----------------------------------------------------------------------*/
 
 /*
@@ -47,6 +47,20 @@ struct dpm_wp {
 	struct dpm_bpwp bpwp;
 };
 
+/** Number of translations remembered while the core is halted. */
+#define DPM_TLB_SIZE 32
+
+/**
+ * One translation of a 4 KiB page, as the raw PAR value returned by
+ * the core's address translation instruction in @a mode.
+ */
+struct dpm_tlb_entry {
+	bool valid;
+	enum arm_mode mode;
+	target_addr_t va;
+	uint64_t par;
+};
+
 /**
  * This wraps an implementation of DPM primitives.  Each interface
  * provider supplies a structure like this, which is the glue between
@@ -146,6 +160,9 @@ struct arm_dpm {
 	/** Recent exception level on armv8 */
 	unsigned int last_el;
 
+	/** Translations done since the last halt, see arm_dpm_tlb_lookup() */
+	struct dpm_tlb_entry tlb[DPM_TLB_SIZE];
+
 	/* FIXME -- read/write DCSR methods and symbols */
 };
 
@@ -220,6 +237,15 @@ void arm_dpm_report_wfar(struct arm_dpm *dpm, uint32_t wfar);
 
 void arm_dpm_report_dscr(struct arm_dpm *dpm, uint32_t dcsr);
 
+/**
+ * Software TLB of the address translations done while the core is halted.
+ * It is emptied on halt and resume, and by any coprocessor write from the
+ * user since those may change TTBRx, TTBCR, SCTLR or CONTEXTIDR.
+ */
+void arm_dpm_tlb_flush(struct arm_dpm *dpm);
+bool arm_dpm_tlb_lookup(struct arm_dpm *dpm, target_addr_t va, uint64_t *par);
+void arm_dpm_tlb_fill(struct arm_dpm *dpm, target_addr_t va, uint64_t par);
+
 /* PRCR (Device Power-down and Reset Control Register) bits */
 #define PRCR_DEBUG_NO_POWER_DOWN         (1 << 0)
 #define PRCR_WARM_RESET                  (1 << 1)
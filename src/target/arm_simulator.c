@@ -232,6 +232,112 @@ static int thumb_pass_branch_condition(uint32_t cpsr, uint16_t opcode)
 	return pass_condition(cpsr, (opcode & 0x0f00) << 20);
 }
 
+/* Instructions decoded by earlier steps, and a window of the target memory
+ * around the PC, so stepping through a loop neither decodes nor reads the
+ * same instructions again and again. */
+#define ARM_SIM_DECODED		64
+#define ARM_SIM_PREFETCH	32
+
+struct arm_sim_decoded {
+	bool valid;
+	bool thumb;
+	uint32_t address;
+	uint32_t opcode;
+	struct arm_instruction instruction;
+};
+
+static struct {
+	/* target whose memory is in data[], len 0 if none */
+	struct target *target;
+	uint32_t address;
+	uint32_t len;
+	uint8_t data[ARM_SIM_PREFETCH];
+	/* target_memory_write_generation() when data[] was read */
+	unsigned int generation;
+	/* where the last simulated instruction went; data[] is only trusted
+	 * while stepping on from there, else the target ran in between */
+	uint32_t next_pc;
+	/* the decoding only depends on the key, whatever target it came from */
+	struct arm_sim_decoded decoded[ARM_SIM_DECODED];
+} arm_sim_cache;
+
+static void arm_sim_prefetch_check(struct target *target, uint32_t pc)
+{
+	if (arm_sim_cache.target != target || arm_sim_cache.next_pc != pc ||
+			arm_sim_cache.generation != target_memory_write_generation())
+		arm_sim_cache.len = 0;
+}
+
+/* Read the opcode at address from the prefetch window, filling it first
+ * if needed. */
+static int arm_sim_fetch(struct target *target, uint32_t address, uint32_t size,
+	uint32_t *opcode)
+{
+	if (!arm_sim_cache.len || address < arm_sim_cache.address ||
+			address + size > arm_sim_cache.address + arm_sim_cache.len) {
+		uint32_t base = address & ~(ARM_SIM_PREFETCH - 1);
+
+		arm_sim_cache.len = 0;
+		if (target_read_memory(target, base, 4, ARM_SIM_PREFETCH / 4,
+				arm_sim_cache.data) != ERROR_OK) {
+			/* e.g. the window crosses the end of the memory */
+			if (size == 4)
+				return target_read_u32(target, address, opcode);
+
+			uint16_t half;
+			int retval = target_read_u16(target, address, &half);
+			*opcode = half;
+			return retval;
+		}
+		arm_sim_cache.target = target;
+		arm_sim_cache.address = base;
+		arm_sim_cache.len = ARM_SIM_PREFETCH;
+		arm_sim_cache.generation = target_memory_write_generation();
+	}
+
+	const uint8_t *p = arm_sim_cache.data + (address - arm_sim_cache.address);
+	if (size == 4)
+		*opcode = target_buffer_get_u32(target, p);
+	else
+		*opcode = target_buffer_get_u16(target, p);
+	return ERROR_OK;
+}
+
+static int arm_sim_decode(uint32_t opcode, uint32_t address, bool thumb,
+	struct arm_instruction *instruction)
+{
+	struct arm_sim_decoded *d =
+		&arm_sim_cache.decoded[((address >> 1) ^ opcode) % ARM_SIM_DECODED];
+
+	if (d->valid && d->address == address && d->opcode == opcode && d->thumb == thumb) {
+		*instruction = d->instruction;
+		return ERROR_OK;
+	}
+
+	int retval;
+	if (thumb)
+		retval = thumb_evaluate_opcode(opcode, address, instruction);
+	else
+		retval = arm_evaluate_opcode(opcode, address, instruction);
+	if (retval != ERROR_OK)
+		return retval;
+
+	d->valid = true;
+	d->thumb = thumb;
+	d->address = address;
+	d->opcode = opcode;
+	d->instruction = *instruction;
+	return ERROR_OK;
+}
+
+/* Whether stepping the instruction surely leaves the memory alone: branches,
+ * data processing, loads, status register accesses and multiplies. */
+static bool arm_sim_keeps_memory(const struct arm_instruction *instruction)
+{
+	return (instruction->type >= ARM_B && instruction->type <= ARM_LDM) ||
+		(instruction->type >= ARM_MRS && instruction->type <= ARM_CLZ);
+}
+
 /* simulate a single step (if possible)
  * if the dry_run_pc argument is provided, no state is changed,
  * but the new pc is stored in the variable pointed at by the argument
@@ -244,14 +350,16 @@ static int arm_simulate_step_core(struct target *target,
 	int instruction_size;
 	int retval = ERROR_OK;
 
+	arm_sim_prefetch_check(target, current_pc);
+
 	if (sim->get_state(sim) == ARM_STATE_ARM) {
 		uint32_t opcode;
 
 		/* get current instruction, and identify it */
-		retval = target_read_u32(target, current_pc, &opcode);
+		retval = arm_sim_fetch(target, current_pc, 4, &opcode);
 		if (retval != ERROR_OK)
 			return retval;
-		retval = arm_evaluate_opcode(opcode, current_pc, &instruction);
+		retval = arm_sim_decode(opcode, current_pc, false, &instruction);
 		if (retval != ERROR_OK)
 			return retval;
 		instruction_size = 4;
@@ -266,12 +374,12 @@ static int arm_simulate_step_core(struct target *target,
 			return ERROR_OK;
 		}
 	} else {
-		uint16_t opcode;
+		uint32_t opcode;
 
-		retval = target_read_u16(target, current_pc, &opcode);
+		retval = arm_sim_fetch(target, current_pc, 2, &opcode);
 		if (retval != ERROR_OK)
 			return retval;
-		retval = thumb_evaluate_opcode(opcode, current_pc, &instruction);
+		retval = arm_sim_decode(opcode, current_pc, true, &instruction);
 		if (retval != ERROR_OK)
 			return retval;
 		instruction_size = 2;
@@ -291,16 +399,20 @@ static int arm_simulate_step_core(struct target *target,
 		/* Deal with 32-bit BL/BLX */
 		if ((opcode & 0xf800) == 0xf000) {
 			uint32_t high = instruction.info.b_bl_bx_blx.target_address;
-			retval = target_read_u16(target, current_pc+2, &opcode);
+			retval = arm_sim_fetch(target, current_pc+2, 2, &opcode);
 			if (retval != ERROR_OK)
 				return retval;
-			retval = thumb_evaluate_opcode(opcode, current_pc, &instruction);
+			retval = arm_sim_decode(opcode, current_pc, true, &instruction);
 			if (retval != ERROR_OK)
 				return retval;
 			instruction.info.b_bl_bx_blx.target_address += high;
 		}
 	}
 
+	/* the step may change the code, e.g. through a store */
+	if (!arm_sim_keeps_memory(&instruction))
+		arm_sim_cache.len = 0;
+
 	/* examine instruction type */
 
 	/* branch instructions */
@@ -718,5 +830,11 @@ int arm_simulate_step(struct target *target, uint32_t *dry_run_pc)
 	sim.get_state = &armv4_5_get_state;
 	sim.set_state = &armv4_5_set_state;
 
-	return arm_simulate_step_core(target, dry_run_pc, &sim);
+	int retval = arm_simulate_step_core(target, dry_run_pc, &sim);
+	if (retval == ERROR_OK)
+		arm_sim_cache.next_pc = dry_run_pc ? *dry_run_pc : sim.get_reg(&sim, 15);
+	else
+		arm_sim_cache.len = 0;
+
+	return retval;
 }
@@ -32,6 +32,7 @@
 #include "arm.h"
 #include "armv4_5.h"
 #include "arm_jtag.h"
+#include "arm_dpm.h"
 #include "breakpoints.h"
 #include "arm_disassembler.h"
 #include <helper/binarybuffer.h>
@@ -1110,6 +1111,9 @@ static int jim_mcrmrc(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 		retval = arm->mcr(target, cpnum, op1, op2, CRn, CRm, value);
 		if (retval != ERROR_OK)
 			return JIM_ERR;
+		/* the translation tables may have moved */
+		if (arm->dpm)
+			arm_dpm_tlb_flush(arm->dpm);
 	} else {
 		/* NOTE: parameters reordered! */
 		/* ARMV4_5_MRC(cpnum, op1, 0, CRn, CRm, op2) */
@@ -1596,7 +1600,8 @@ int arm_blank_check_memory(struct target *target,
 	struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value)
 {
 	struct working_area *check_algorithm;
-	struct reg_param reg_params[3];
+	struct working_area *check_params;
+	struct reg_param reg_params[2];
 	struct arm_algorithm arm_algo;
 	struct arm *arm = target_to_arm(target);
 	int retval;
@@ -1609,11 +1614,9 @@ int arm_blank_check_memory(struct target *target,
 
 	assert(sizeof(check_code_le) % 4 == 0);
 
-	if (erased_value != 0xff) {
-		LOG_ERROR("Erase value 0x%02" PRIx8 " not yet supported for ARMv4/v5 targets",
-			erased_value);
-		return ERROR_FAIL;
-	}
+	/* the algorithm checks whole words */
+	if ((blocks[0].address | blocks[0].size) & 3)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
 	/* make sure we have a working area */
 	retval = target_alloc_working_area(target,
@@ -1628,45 +1631,94 @@ int arm_blank_check_memory(struct target *target,
 				+ i * sizeof(uint32_t),
 				le_to_h_u32(&check_code_le[i * 4]));
 		if (retval != ERROR_OK)
-			goto cleanup;
+			goto cleanup1;
+	}
+
+	/* table of { size in words / result, address }, zero terminated */
+	uint32_t avail = target_get_working_area_avail(target);
+	int blocks_to_check = avail / 8 - 1;
+	if (num_blocks < blocks_to_check)
+		blocks_to_check = num_blocks;
+	/* stop before the first block the algorithm cannot check */
+	for (int n = 1; n < blocks_to_check; n++) {
+		if ((blocks[n].address | blocks[n].size) & 3) {
+			blocks_to_check = n;
+			break;
+		}
+	}
+	if (blocks_to_check < 1) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup1;
+	}
+
+	uint32_t param_size = (blocks_to_check + 1) * 8;
+	uint8_t *params = calloc(1, param_size);
+	if (!params) {
+		retval = ERROR_FAIL;
+		goto cleanup1;
+	}
+
+	uint32_t total_size = 0;
+	for (int n = 0; n < blocks_to_check; n++) {
+		total_size += blocks[n].size;
+		target_buffer_set_u32(target, params + n * 8, blocks[n].size / 4);
+		target_buffer_set_u32(target, params + n * 8 + 4, blocks[n].address);
+	}
+
+	if (target_alloc_working_area(target, param_size, &check_params) != ERROR_OK) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup2;
 	}
 
+	retval = target_write_buffer(target, check_params->address, param_size, params);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	uint32_t erased_word = erased_value | (erased_value << 8)
+			       | (erased_value << 16) | (erased_value << 24);
+
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
 	arm_algo.core_mode = ARM_MODE_SVC;
 	arm_algo.core_state = ARM_STATE_ARM;
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
-	buf_set_u32(reg_params[0].value, 0, 32, blocks[0].address);
+	buf_set_u32(reg_params[0].value, 0, 32, check_params->address);
 
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
-	buf_set_u32(reg_params[1].value, 0, 32, blocks[0].size);
-
-	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN_OUT);
-	buf_set_u32(reg_params[2].value, 0, 32, erased_value);
+	buf_set_u32(reg_params[1].value, 0, 32, erased_word);
 
 	/* armv4 must exit using a hardware breakpoint */
 	if (arm->is_armv4)
 		exit_var = check_algorithm->address + sizeof(check_code_le) - 4;
 
-	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
+	/* assume CPU clk at least 1 MHz */
+	retval = target_run_algorithm(target, 0, NULL, 2, reg_params,
 			check_algorithm->address,
 			exit_var,
-			10000, &arm_algo);
+			10000 + total_size * 3 / 1000, &arm_algo);
+	if (retval != ERROR_OK)
+		goto cleanup4;
 
-	if (retval == ERROR_OK)
-		blocks[0].result = buf_get_u32(reg_params[2].value, 0, 32);
+	retval = target_read_buffer(target, check_params->address, param_size, params);
+	if (retval != ERROR_OK)
+		goto cleanup4;
+
+	for (int n = 0; n < blocks_to_check; n++)
+		blocks[n].result = target_buffer_get_u32(target, params + n * 8);
 
+	retval = blocks_to_check;	/* number of blocks checked */
+
+cleanup4:
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
-	destroy_reg_param(&reg_params[2]);
-
-cleanup:
+cleanup3:
+	target_free_working_area(target, check_params);
+cleanup2:
+	free(params);
+cleanup1:
 	target_free_working_area(target, check_algorithm);
 
-	if (retval != ERROR_OK)
-		return retval;
-
-	return 1;       /* only one block has been checked */
+	return retval;
 }
 
 static int arm_full_context(struct target *target)
@@ -158,6 +158,12 @@ static inline bool is_armv7a(struct armv7a_common *armv7a)
 #define CPUDBG_ITR		0x084
 #define CPUDBG_DTRTX		0x08c
 
+/* See ARMv7a arch spec section C11.11.1, v7.0 debug only uses the first */
+#define CPUDBG_PCSR_V70		0x084
+#define CPUDBG_PCSR		0x0A0
+#define CPUDBG_DEVID1		0xFC4
+#define CPUDBG_DEVID		0xFC8
+
 /* See ARMv7a arch spec section C10.5 */
 #define CPUDBG_BVR_BASE		0x100
 #define CPUDBG_BCR_BASE		0x140
@@ -128,13 +128,9 @@ done:
 	return retval;
 }
 
-int armv7a_cache_auto_flush_all_data(struct target *target)
+static int armv7a_cache_flush_all_data(struct target *target)
 {
 	int retval = ERROR_FAIL;
-	struct armv7a_common *armv7a = target_to_armv7a(target);
-
-	if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled)
-		return ERROR_OK;
 
 	if (target->smp) {
 		struct target_list *head;
@@ -157,6 +153,40 @@ int armv7a_cache_auto_flush_all_data(struct target *target)
 	return arm7a_l2x_flush_all_data(target);
 }
 
+int armv7a_cache_auto_flush_all_data(struct target *target)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+
+	if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled)
+		return ERROR_OK;
+
+	return armv7a_cache_flush_all_data(target);
+}
+
+/*
+ * Maintenance by MVA takes one operation per line of the range, cleaning the
+ * whole data cache by set/way one per line of the cache. Returns true if the
+ * range is the cheaper one.
+ */
+static bool armv7a_cache_range_is_small(struct target *target, uint32_t size)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct armv7a_cache_common *cache = &armv7a->armv7a_mmu.armv7a_cache;
+	uint32_t set_way_ops = 0;
+
+	if (cache->info == -1 || cache->dminline == 0)
+		return true;
+
+	for (int cl = 0; cl < cache->loc; cl++) {
+		if (cache->arch[cl].ctype < CACHE_LEVEL_HAS_D_CACHE)
+			continue;
+		set_way_ops += cache->arch[cl].d_u_size.nsets *
+			cache->arch[cl].d_u_size.associativity;
+	}
+
+	return size / cache->dminline < set_way_ops;
+}
+
 
 int armv7a_l1_d_cache_inval_virt(struct target *target, uint32_t virt,
 					uint32_t size)
@@ -399,6 +429,12 @@ done:
 int armv7a_cache_flush_virt(struct target *target, uint32_t virt,
 				uint32_t size)
 {
+	if (!armv7a_cache_range_is_small(target, size)) {
+		LOG_DEBUG("flushing the whole data cache for %" PRIu32 " bytes", size);
+		armv7a_cache_flush_all_data(target);
+		return ERROR_OK;
+	}
+
 	armv7a_l1_d_cache_flush_virt(target, virt, size);
 	armv7a_l2x_cache_flush_virt(target, virt, size);
 
@@ -68,14 +68,20 @@ int arm7a_l2x_flush_all_data(struct target *target)
 			l2_way_val);
 }
 
-int armv7a_l2x_cache_flush_virt(struct target *target, target_addr_t virt,
-					uint32_t size)
+/*
+ * Write the physical address of every line from @a virt to @a virt + @a size
+ * to the line operation register @a reg. The address is translated once per
+ * 4 KiB page, the smallest page size, instead of once per line.
+ */
+static int armv7a_l2x_cache_line_op(struct target *target, target_addr_t virt,
+					uint32_t size, uint32_t reg)
 {
 	struct armv7a_common *armv7a = target_to_armv7a(target);
 	struct armv7a_l2x_cache *l2x_cache = (struct armv7a_l2x_cache *)
 		(armv7a->armv7a_mmu.armv7a_cache.outer_cache);
 	/* FIXME: different controllers have different linelen? */
 	uint32_t i, linelen = 32;
+	target_addr_t pa = 0, page = 1;
 	int retval;
 
 	retval = arm7a_l2x_sanity_check(target);
@@ -83,15 +89,17 @@ int armv7a_l2x_cache_flush_virt(struct target *target, target_addr_t virt,
 		return retval;
 
 	for (i = 0; i < size; i += linelen) {
-		target_addr_t pa, offs = virt + i;
+		target_addr_t offs = virt + i;
 
-		/* FIXME: use less verbose virt2phys? */
-		retval = target->type->virt2phys(target, offs, &pa);
-		if (retval != ERROR_OK)
-			goto done;
+		if ((offs & ~(target_addr_t)0xfff) != page) {
+			page = offs & ~(target_addr_t)0xfff;
+			retval = target->type->virt2phys(target, page, &pa);
+			if (retval != ERROR_OK)
+				goto done;
+		}
 
 		retval = target_write_phys_u32(target,
-				l2x_cache->base + L2X0_CLEAN_INV_LINE_PA, pa);
+				l2x_cache->base + reg, pa + (offs & 0xfff));
 		if (retval != ERROR_OK)
 			goto done;
 	}
@@ -103,74 +111,22 @@ done:
 	return retval;
 }
 
-static int armv7a_l2x_cache_inval_virt(struct target *target, target_addr_t virt,
+int armv7a_l2x_cache_flush_virt(struct target *target, target_addr_t virt,
 					uint32_t size)
 {
-	struct armv7a_common *armv7a = target_to_armv7a(target);
-	struct armv7a_l2x_cache *l2x_cache = (struct armv7a_l2x_cache *)
-		(armv7a->armv7a_mmu.armv7a_cache.outer_cache);
-	/* FIXME: different controllers have different linelen */
-	uint32_t i, linelen = 32;
-	int retval;
-
-	retval = arm7a_l2x_sanity_check(target);
-	if (retval)
-		return retval;
-
-	for (i = 0; i < size; i += linelen) {
-		target_addr_t pa, offs = virt + i;
-
-		/* FIXME: use less verbose virt2phys? */
-		retval = target->type->virt2phys(target, offs, &pa);
-		if (retval != ERROR_OK)
-			goto done;
-
-		retval = target_write_phys_u32(target,
-				l2x_cache->base + L2X0_INV_LINE_PA, pa);
-		if (retval != ERROR_OK)
-			goto done;
-	}
-	return retval;
-
-done:
-	LOG_ERROR("d-cache invalidate failed");
+	return armv7a_l2x_cache_line_op(target, virt, size, L2X0_CLEAN_INV_LINE_PA);
+}
 
-	return retval;
+static int armv7a_l2x_cache_inval_virt(struct target *target, target_addr_t virt,
+					uint32_t size)
+{
+	return armv7a_l2x_cache_line_op(target, virt, size, L2X0_INV_LINE_PA);
 }
 
 static int armv7a_l2x_cache_clean_virt(struct target *target, target_addr_t virt,
 					unsigned int size)
 {
-	struct armv7a_common *armv7a = target_to_armv7a(target);
-	struct armv7a_l2x_cache *l2x_cache = (struct armv7a_l2x_cache *)
-		(armv7a->armv7a_mmu.armv7a_cache.outer_cache);
-	/* FIXME: different controllers have different linelen */
-	uint32_t i, linelen = 32;
-	int retval;
-
-	retval = arm7a_l2x_sanity_check(target);
-	if (retval)
-		return retval;
-
-	for (i = 0; i < size; i += linelen) {
-		target_addr_t pa, offs = virt + i;
-
-		/* FIXME: use less verbose virt2phys? */
-		retval = target->type->virt2phys(target, offs, &pa);
-		if (retval != ERROR_OK)
-			goto done;
-
-		retval = target_write_phys_u32(target,
-				l2x_cache->base + L2X0_CLEAN_LINE_PA, pa);
-		if (retval != ERROR_OK)
-			goto done;
-	}
-	return retval;
-
-done:
-	LOG_ERROR("d-cache invalidate failed");
-
-	return retval;
+	return armv7a_l2x_cache_line_op(target, virt, size, L2X0_CLEAN_LINE_PA);
 }
 
 static int arm7a_handle_l2x_cache_info_command(struct command_invocation *cmd,
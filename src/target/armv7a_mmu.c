@@ -43,7 +43,13 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	struct arm_dpm *dpm = armv7a->arm.dpm;
 	uint32_t virt = va & ~0xfff, value;
 	uint32_t NOS, NS, INNER, OUTER, SS;
+	uint64_t par;
 	*val = 0xdeadbeef;
+	if (arm_dpm_tlb_lookup(dpm, virt, &par)) {
+		value = par;
+		retval = ERROR_OK;
+		goto decode;
+	}
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -59,6 +65,13 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 			&value);
 	if (retval != ERROR_OK)
 		goto done;
+	dpm->finish(dpm);
+
+	/* PAR bit 0 flags an aborted translation */
+	if (!(value & 1))
+		arm_dpm_tlb_fill(dpm, virt, value);
+
+decode:
 
 	/* decode memory attribute */
 	SS = (value >> 1) & 1;
@@ -121,6 +134,8 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 		}
 	}
 
+	return retval;
+
 done:
 	dpm->finish(dpm);
 
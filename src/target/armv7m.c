@@ -150,6 +150,15 @@ int armv7m_restore_context(struct target *target)
 	if (armv7m->pre_restore_context)
 		armv7m->pre_restore_context(target);
 
+	struct reg **reg_list = malloc(cache->num_regs * sizeof(*reg_list));
+	if (reg_list) {
+		for (unsigned int n = 0; n < cache->num_regs; n++)
+			reg_list[n] = &cache->reg_list[n];
+		target_write_registers_batch(target, reg_list, cache->num_regs);
+		free(reg_list);
+	}
+
+	/* whatever the batch left dirty */
 	for (i = cache->num_regs - 1; i >= 0; i--) {
 		if (cache->reg_list[i].dirty) {
 			armv7m->arm.write_core_reg(target, &cache->reg_list[i], i,
@@ -346,6 +355,28 @@ int armv7m_run_algorithm(struct target *target,
 }
 
 /** Starts a Thumb algorithm in the target. */
+/* Reads every register which is not valid yet, registers may be fetched
+ * lazily after a halt. */
+static void armv7m_read_all_core_regs(struct target *target)
+{
+	struct arm *arm = target_to_arm(target);
+	struct reg_cache *cache = arm->core_cache;
+
+	struct reg **reg_list = malloc(cache->num_regs * sizeof(*reg_list));
+	if (reg_list) {
+		for (unsigned int i = 0; i < cache->num_regs; i++)
+			reg_list[i] = &cache->reg_list[i];
+		target_read_registers_batch(target, reg_list, cache->num_regs);
+		free(reg_list);
+	}
+
+	for (unsigned int i = 0; i < cache->num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		if (!r->valid)
+			arm->read_core_reg(target, r, i, ARM_MODE_ANY);
+	}
+}
+
 int armv7m_start_algorithm(struct target *target,
 	int num_mem_params, struct mem_param *mem_params,
 	int num_reg_params, struct reg_param *reg_params,
@@ -370,8 +401,9 @@ int armv7m_start_algorithm(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	/* refresh core register cache
-	 * Not needed if core register cache is always consistent with target process state */
+	/* refresh core register cache, registers may be read lazily after halt */
+	armv7m_read_all_core_regs(target);
+
 	for (unsigned i = 0; i < armv7m->arm.core_cache->num_regs; i++) {
 
 		armv7m_algorithm_info->context[i] = buf_get_u32(
@@ -525,14 +557,23 @@ int armv7m_wait_algorithm(struct target *target,
 				return ERROR_COMMAND_SYNTAX_ERROR;
 			}
 
+			if (!reg->valid) {
+				retval = reg->type->get(reg);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+
 			buf_set_u32(reg_params[i].value, 0, 32, buf_get_u32(reg->value, 0, 32));
 		}
 	}
 
 	for (int i = armv7m->arm.core_cache->num_regs - 1; i >= 0; i--) {
+		struct reg *reg = &armv7m->arm.core_cache->reg_list[i];
 		uint32_t regvalue;
-		regvalue = buf_get_u32(armv7m->arm.core_cache->reg_list[i].value, 0, 32);
-		if (regvalue != armv7m_algorithm_info->context[i]) {
+		regvalue = buf_get_u32(reg->value, 0, 32);
+		/* a register not read since the algorithm halted may be clobbered */
+		if (regvalue != armv7m_algorithm_info->context[i] ||
+				(!reg->valid && reg->exist)) {
 			LOG_DEBUG("restoring register %s with value 0x%8.8" PRIx32,
 					armv7m->arm.core_cache->reg_list[i].name,
 				armv7m_algorithm_info->context[i]);
@@ -759,6 +800,203 @@ cleanup:
 	return retval;
 }
 
+/**
+ * Generates the CRC32 checksums of an array of memory regions in a single
+ * algorithm run.
+ * @returns the number of blocks checked, or an error code.
+ */
+int armv7m_checksum_memory_blocks(struct target *target,
+	struct target_memory_check_block *blocks, int num_blocks)
+{
+	struct working_area *crc_algorithm;
+	struct working_area *crc_params;
+	struct armv7m_algorithm armv7m_info;
+	struct reg_param reg_params[1];
+	int retval;
+
+	static const uint8_t crc_blocks_code[] = {
+#include "../../contrib/loaders/checksum/armv7m_crc_blocks.inc"
+	};
+
+	const uint32_t code_size = sizeof(crc_blocks_code);
+
+	retval = target_alloc_working_area(target, code_size, &crc_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, crc_algorithm->address,
+			code_size, crc_blocks_code);
+	if (retval != ERROR_OK)
+		goto cleanup1;
+
+	/* prepare blocks array for algo, a zero size ends it */
+	struct algo_block {
+		union {
+			uint32_t size;
+			uint32_t crc;
+		};
+		uint32_t address;
+	};
+
+	uint32_t avail = target_get_working_area_avail(target);
+	int blocks_to_check = avail / sizeof(struct algo_block) - 1;
+	if (num_blocks < blocks_to_check)
+		blocks_to_check = num_blocks;
+	for (int i = 0; i < blocks_to_check; i++) {
+		if (blocks[i].size == 0) {
+			blocks_to_check = i;
+			break;
+		}
+	}
+
+	if (blocks_to_check <= 0) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup1;
+	}
+
+	struct algo_block *params = malloc((blocks_to_check + 1) * sizeof(struct algo_block));
+	if (params == NULL) {
+		retval = ERROR_FAIL;
+		goto cleanup1;
+	}
+
+	uint32_t total_size = 0;
+	for (int i = 0; i < blocks_to_check; i++) {
+		total_size += blocks[i].size;
+		target_buffer_set_u32(target, (uint8_t *)&(params[i].size),
+						blocks[i].size);
+		target_buffer_set_u32(target, (uint8_t *)&(params[i].address),
+						blocks[i].address);
+	}
+	target_buffer_set_u32(target, (uint8_t *)&(params[blocks_to_check].size), 0);
+
+	uint32_t param_size = (blocks_to_check + 1) * sizeof(struct algo_block);
+	if (target_alloc_working_area(target, param_size, &crc_params) != ERROR_OK) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup2;
+	}
+
+	retval = target_write_buffer(target, crc_params->address,
+				param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	LOG_DEBUG("Starting checksum of %d blocks, parameters@"
+		 TARGET_ADDR_FMT, blocks_to_check, crc_params->address);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, crc_params->address);
+
+	int timeout = 20000 * (1 + (total_size / (1024 * 1024)));
+
+	/* exit at the bkpt, followed by padding and the polynomial */
+	retval = target_run_algorithm(target, 0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			crc_algorithm->address,
+			crc_algorithm->address + (code_size - 8),
+			timeout, &armv7m_info);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("error executing cortex_m crc algorithm");
+		goto cleanup4;
+	}
+
+	retval = target_read_buffer(target, crc_params->address,
+				param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup4;
+
+	for (int i = 0; i < blocks_to_check; i++)
+		blocks[i].result = target_buffer_get_u32(target,
+					(uint8_t *)&(params[i].crc));
+
+	retval = blocks_to_check;	/* return number of blocks really checked */
+
+cleanup4:
+	destroy_reg_param(&reg_params[0]);
+cleanup3:
+	target_free_working_area(target, crc_params);
+cleanup2:
+	free(params);
+cleanup1:
+	target_free_working_area(target, crc_algorithm);
+
+	return retval;
+}
+
+/** Fills and optionally tests a memory region, see target_mem_pattern(). */
+int armv7m_mem_pattern(struct target *target, target_addr_t address,
+		uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+		struct target_mem_test_result *result)
+{
+	struct working_area *memtest_algorithm;
+	struct armv7m_algorithm armv7m_info;
+	struct reg_param reg_params[4];
+	int retval;
+
+	static const uint8_t memtest_code[] = {
+#include "../../contrib/loaders/memtest/armv7m_memtest.inc"
+	};
+
+	retval = target_alloc_working_area(target, sizeof(memtest_code), &memtest_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the algorithm must not overwrite itself */
+	if (memtest_algorithm->address + sizeof(memtest_code) > address &&
+			memtest_algorithm->address < address + 4 * (target_addr_t)count) {
+		LOG_DEBUG("working area inside the tested region");
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup;
+	}
+
+	retval = target_write_buffer(target, memtest_algorithm->address,
+			sizeof(memtest_code), memtest_code);
+	if (retval != ERROR_OK)
+		goto cleanup;
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_IN_OUT);
+
+	buf_set_u32(reg_params[0].value, 0, 32, address);
+	buf_set_u32(reg_params[1].value, 0, 32, count);
+	buf_set_u32(reg_params[2].value, 0, 32, pattern);
+	buf_set_u32(reg_params[3].value, 0, 32, value);
+
+	/* write and verify passes, assume some 20 cycles per word at 1 MHz */
+	int timeout = 20000 + count / 25 * (pattern == TARGET_MEM_FILL ? 1 : 2);
+
+	retval = target_run_algorithm(target, 0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			memtest_algorithm->address,
+			memtest_algorithm->address + (sizeof(memtest_code) - 2),
+			timeout, &armv7m_info);
+
+	if (retval == ERROR_OK) {
+		result->failed = buf_get_u32(reg_params[3].value, 0, 32) != 0;
+		result->address = buf_get_u32(reg_params[0].value, 0, 32);
+		result->expected = buf_get_u32(reg_params[1].value, 0, 32);
+		result->actual = buf_get_u32(reg_params[2].value, 0, 32);
+	} else {
+		LOG_ERROR("error executing cortex_m memory test algorithm");
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+cleanup:
+	target_free_working_area(target, memtest_algorithm);
+
+	return retval;
+}
+
 /** Checks an array of memory regions whether they are erased. */
 int armv7m_blank_check_memory(struct target *target,
 	struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value)
@@ -892,6 +1130,147 @@ cleanup1:
 	return retval;
 }
 
+static bool armv7m_area_overlaps(struct working_area *area,
+		const struct target_memory_check_block *blocks, int num_blocks)
+{
+	for (int i = 0; i < num_blocks; i++) {
+		if (area->address < blocks[i].address + blocks[i].size &&
+				blocks[i].address < area->address + area->size)
+			return true;
+	}
+	return false;
+}
+
+/** Counts the bytes at the start of each block still holding the fill value,
+ * see target_stack_check_memory(). */
+int armv7m_stack_check_memory(struct target *target,
+	struct target_memory_check_block *blocks, int num_blocks, uint8_t fill_value)
+{
+	struct working_area *stack_check_algorithm;
+	struct working_area *stack_check_params;
+	struct reg_param reg_params[2];
+	struct armv7m_algorithm armv7m_info;
+	int retval;
+
+	static const uint8_t stack_check_code[] = {
+#include "../../contrib/loaders/stack_check/armv7m_stack_check.inc"
+	};
+
+	const uint32_t code_size = sizeof(stack_check_code);
+
+	if (target_alloc_working_area(target, code_size,
+		&stack_check_algorithm) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	struct algo_block {
+		union {
+			uint32_t size;
+			uint32_t result;
+		};
+		uint32_t address;
+	};
+
+	uint32_t avail = target_get_working_area_avail(target);
+	int blocks_to_check = avail / sizeof(struct algo_block) - 1;
+	if (num_blocks < blocks_to_check)
+		blocks_to_check = num_blocks;
+	if (blocks_to_check < 1) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup1;
+	}
+
+	struct algo_block *params = malloc((blocks_to_check + 1) * sizeof(struct algo_block));
+	if (params == NULL) {
+		retval = ERROR_FAIL;
+		goto cleanup1;
+	}
+
+	uint32_t total_size = 0;
+	for (int i = 0; i < blocks_to_check; i++) {
+		total_size += blocks[i].size;
+		target_buffer_set_u32(target, (uint8_t *)&(params[i].size),
+						blocks[i].size / sizeof(uint32_t));
+		target_buffer_set_u32(target, (uint8_t *)&(params[i].address),
+						blocks[i].address);
+	}
+	target_buffer_set_u32(target, (uint8_t *)&(params[blocks_to_check].size), 0);
+
+	uint32_t param_size = (blocks_to_check + 1) * sizeof(struct algo_block);
+	if (target_alloc_working_area(target, param_size,
+			&stack_check_params) != ERROR_OK) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup2;
+	}
+
+	/* the working area must not be one of the scanned stacks */
+	if (armv7m_area_overlaps(stack_check_algorithm, blocks, blocks_to_check) ||
+			armv7m_area_overlaps(stack_check_params, blocks, blocks_to_check)) {
+		LOG_DEBUG("working area inside a checked block");
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup3;
+	}
+
+	retval = target_write_buffer(target, stack_check_algorithm->address,
+			code_size, stack_check_code);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	retval = target_write_buffer(target, stack_check_params->address,
+				param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	uint32_t fill_word = fill_value | (fill_value << 8)
+			       | (fill_value << 16) | (fill_value << 24);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, stack_check_params->address);
+
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	buf_set_u32(reg_params[1].value, 0, 32, fill_word);
+
+	/* assume CPU clk at least 1 MHz */
+	int timeout = 2000 + total_size * 3 / 1000;
+
+	retval = target_run_algorithm(target,
+				0, NULL,
+				ARRAY_SIZE(reg_params), reg_params,
+				stack_check_algorithm->address,
+				stack_check_algorithm->address + (code_size - 2),
+				timeout,
+				&armv7m_info);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("error executing cortex_m stack check algorithm");
+		goto cleanup4;
+	}
+
+	retval = target_read_buffer(target, stack_check_params->address,
+				param_size, (uint8_t *)params);
+	if (retval != ERROR_OK)
+		goto cleanup4;
+
+	for (int i = 0; i < blocks_to_check; i++)
+		blocks[i].result = sizeof(uint32_t) * target_buffer_get_u32(target,
+					(uint8_t *)&(params[i].result));
+
+	retval = blocks_to_check;	/* return number of blocks really checked */
+
+cleanup4:
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+cleanup3:
+	target_free_working_area(target, stack_check_params);
+cleanup2:
+	free(params);
+cleanup1:
+	target_free_working_area(target, stack_check_algorithm);
+
+	return retval;
+}
+
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
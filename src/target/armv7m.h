@@ -224,8 +224,15 @@ int armv7m_restore_context(struct target *target);
 
 int armv7m_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t count, uint32_t *checksum);
+int armv7m_checksum_memory_blocks(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks);
+int armv7m_mem_pattern(struct target *target, target_addr_t address,
+		uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+		struct target_mem_test_result *result);
 int armv7m_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value);
+int armv7m_stack_check_memory(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks, uint8_t fill_value);
 
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found);
 
@@ -23,11 +23,12 @@
 #include <target/armv7m.h>
 #include <target/cortex_m.h>
 #include <target/armv7m_trace.h>
+#include <target/itm_decode.h>
 #include <jtag/interface.h>
 
 #define TRACE_BUF_SIZE	4096
 
-static int armv7m_poll_trace(void *target)
+int armv7m_trace_poll(void *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	uint8_t buf[TRACE_BUF_SIZE];
@@ -59,7 +60,7 @@ int armv7m_trace_tpiu_config(struct target *target)
 	uint16_t prescaler;
 	int retval;
 
-	target_unregister_timer_callback(armv7m_poll_trace, target);
+	target_unregister_timer_callback(armv7m_trace_poll, target);
 
 	retval = adapter_config_trace(trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL,
 		trace_config->pin_protocol, trace_config->port_size,
@@ -114,7 +115,7 @@ int armv7m_trace_tpiu_config(struct target *target)
 		return retval;
 
 	if (trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL)
-		target_register_timer_callback(armv7m_poll_trace, 1,
+		target_register_timer_callback(armv7m_trace_poll, 1,
 		TARGET_TIMER_TYPE_PERIODIC, target);
 
 	target_call_event_callbacks(target, TARGET_EVENT_TRACE_CONFIG);
@@ -328,6 +329,9 @@ static const struct command_registration itm_command_handlers[] = {
 		.help = "Enable or disable all ITM stimulus ports",
 		.usage = "(0|1|on|off)",
 	},
+	{
+		.chain = itm_decode_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
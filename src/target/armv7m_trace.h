@@ -45,6 +45,8 @@ enum itm_ts_prescaler {
 	ITM_TS_PRESCALE64,	/**< refclock divided by 64 for the timestamp counter */
 };
 
+struct itm_decoder;
+
 struct armv7m_trace_config {
 	/** Currently active trace capture mode */
 	enum trace_config_type config_type;
@@ -75,6 +77,8 @@ struct armv7m_trace_config {
 	unsigned int trace_freq;
 	/** Handle to output trace data in INTERNAL capture mode */
 	FILE *trace_file;
+	/** Decoder of the captured packets, see "itm decode" */
+	struct itm_decoder *itm_decoder;
 };
 
 extern const struct command_registration armv7m_trace_command_handlers[];
@@ -87,5 +91,10 @@ int armv7m_trace_tpiu_config(struct target *target);
  * Configure hardware accordingly to the current ITM target settings
  */
 int armv7m_trace_itm_config(struct target *target);
+/**
+ * Pass the trace captured by the adapter to the trace callbacks and the
+ * trace file, periodic timer callback for TRACE_CONFIG_TYPE_INTERNAL.
+ */
+int armv7m_trace_poll(void *target);
 
 #endif /* OPENOCD_TARGET_ARMV7M_TRACE_H */
@@ -949,6 +949,9 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	if (arm_dpm_tlb_lookup(dpm, va, &par))
+		goto decode;
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
@@ -993,6 +996,10 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 	if (retval != ERROR_OK)
 		return retval;
 
+	if (!(par & 1))
+		arm_dpm_tlb_fill(dpm, va, par);
+
+decode:
 	if (par & 1) {
 		LOG_ERROR("Address translation failed at stage %i, FST=%x, PTW=%i",
 				((int)(par >> 9) & 1)+1, (int)(par >> 1) & 0x3f, (int)(par >> 8) & 1);
@@ -270,6 +270,9 @@ static inline bool is_armv8(struct armv8_common *armv8)
 #define CPUV8_DBG_SCR		0x088
 #define CPUV8_DBG_DTRTX		0x08c
 
+#define CPUV8_DBG_EDPCSR	0x0A0
+#define CPUV8_DBG_EDDEVID	0xFC8
+
 #define CPUV8_DBG_BVR_BASE	0x400
 #define CPUV8_DBG_BCR_BASE	0x408
 #define CPUV8_DBG_WVR_BASE	0x800
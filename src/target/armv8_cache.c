@@ -29,6 +29,9 @@
 #define CACHE_LEVEL_HAS_D_CACHE		0x2
 #define CACHE_LEVEL_HAS_I_CACHE		0x1
 
+/* Cache maintenance operations queued per DAP queue run */
+#define CACHE_QUEUE_OPS			256
+
 static int armv8_d_cache_sanity_check(struct armv8_common *armv8)
 {
 	struct armv8_cache_common *armv8_cache = &armv8->armv8_mmu.armv8_cache;
@@ -49,6 +52,45 @@ static int armv8_i_cache_sanity_check(struct armv8_common *armv8)
 	return ERROR_TARGET_INVALID;
 }
 
+/*
+ * Queue a maintenance operation taking its operand in R0, and run the queue
+ * every CACHE_QUEUE_OPS operations or when @a last is set.
+ */
+static int armv8_cache_queue_op(struct arm_dpm *dpm, uint32_t opcode,
+	uint64_t operand, unsigned int *queued, bool last)
+{
+	int retval = armv8_dpm_queue_instr_write_data_r0_64(dpm, opcode, operand);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (++*queued < CACHE_QUEUE_OPS && !last)
+		return ERROR_OK;
+
+	*queued = 0;
+	return armv8_dpm_queue_run(dpm);
+}
+
+static int armv8_cache_d_inner_flush_level_queued(struct armv8_common *armv8,
+	struct armv8_cachesize *size, int cl)
+{
+	struct arm_dpm *dpm = armv8->arm.dpm;
+	unsigned int queued = 0;
+
+	for (int32_t c_index = size->index; c_index >= 0; c_index--) {
+		for (int32_t c_way = size->way; c_way >= 0; c_way--) {
+			uint32_t value = (c_index << size->index_shift)
+				| (c_way << size->way_shift) | (cl << 1);
+			int retval = armv8_cache_queue_op(dpm,
+					armv8_opcode(armv8, ARMV8_OPC_DCCISW), value,
+					&queued, c_index == 0 && c_way == 0);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int armv8_cache_d_inner_flush_level(struct armv8_common *armv8, struct armv8_cachesize *size, int cl)
 {
 	struct arm_dpm *dpm = armv8->arm.dpm;
@@ -56,6 +98,12 @@ static int armv8_cache_d_inner_flush_level(struct armv8_common *armv8, struct ar
 	int32_t c_way, c_index = size->index;
 
 	LOG_DEBUG("cl %" PRId32, cl);
+
+	/* Cleaning by set/way can be repeated, so if the queued operations
+	 * fail the level is done again one operation at a time. */
+	if (armv8_cache_d_inner_flush_level_queued(armv8, size, cl) == ERROR_OK)
+		return ERROR_OK;
+
 	do {
 		c_way = size->way;
 		do {
@@ -111,6 +159,27 @@ done:
 	return retval;
 }
 
+/*
+ * Queue a maintenance operation by VA for every line from @a va_line to
+ * @a va_end. Maintenance by VA can be repeated, so callers fall back to
+ * single operations if this fails.
+ */
+static int armv8_cache_queue_range(struct arm_dpm *dpm, uint32_t opcode,
+	target_addr_t va_line, target_addr_t va_end, uint64_t linelen)
+{
+	unsigned int queued = 0;
+
+	while (va_line < va_end) {
+		int retval = armv8_cache_queue_op(dpm, opcode, va_line, &queued,
+				va_line + linelen >= va_end);
+		if (retval != ERROR_OK)
+			return retval;
+		va_line += linelen;
+	}
+
+	return ERROR_OK;
+}
+
 int armv8_cache_d_inner_flush_virt(struct armv8_common *armv8, target_addr_t va, size_t size)
 {
 	struct arm_dpm *dpm = armv8->arm.dpm;
@@ -130,6 +199,10 @@ int armv8_cache_d_inner_flush_virt(struct armv8_common *armv8, target_addr_t va,
 	va_line = va & (-linelen);
 	va_end = va + size;
 
+	if (armv8_cache_queue_range(dpm, armv8_opcode(armv8, ARMV8_OPC_DCCIVAC),
+				va_line, va_end, linelen) == ERROR_OK)
+		goto finish;
+
 	while (va_line < va_end) {
 		/* DC CIVAC */
 		/* Aarch32: DCCIMVAC: ARMV4_5_MCR(15, 0, 0, 7, 14, 1) */
@@ -140,6 +213,7 @@ int armv8_cache_d_inner_flush_virt(struct armv8_common *armv8, target_addr_t va,
 		va_line += linelen;
 	}
 
+finish:
 	dpm->finish(dpm);
 	return retval;
 
@@ -169,6 +243,10 @@ int armv8_cache_i_inner_inval_virt(struct armv8_common *armv8, target_addr_t va,
 	va_line = va & (-linelen);
 	va_end = va + size;
 
+	if (armv8_cache_queue_range(dpm, armv8_opcode(armv8, ARMV8_OPC_ICIVAU),
+				va_line, va_end, linelen) == ERROR_OK)
+		goto finish;
+
 	while (va_line < va_end) {
 		/* IC IVAU - Invalidate instruction cache by VA to PoU. */
 		retval = dpm->instr_write_data_r0_64(dpm,
@@ -178,6 +256,7 @@ int armv8_cache_i_inner_inval_virt(struct armv8_common *armv8, target_addr_t va,
 		va_line += linelen;
 	}
 
+finish:
 	dpm->finish(dpm);
 	return retval;
 
@@ -425,6 +425,132 @@ static int dpmv8_instr_read_data_r0_64(struct arm_dpm *dpm,
 	return dpmv8_read_dcc_64(armv8, data, &dpm->dscr);
 }
 
+/*
+ * Queued instruction stream. The ITR and DTR accesses are only queued, nothing
+ * waits for ITE or the DTR flags in between. An instruction written before
+ * the previous one completed, like a DTR access at the wrong time, is ignored
+ * by the core and sets the sticky DSCR.ERR, which armv8_dpm_queue_run()
+ * checks once at the end. Callers repeat the work with the normal, polled,
+ * operations if running the queue fails, so only sequences which can be
+ * repeated may be queued.
+ */
+
+int armv8_dpm_queue_instr(struct arm_dpm *dpm, uint32_t opcode)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		opcode = T32_FMTITR(opcode);
+
+	return mem_ap_write_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_ITR, opcode);
+}
+
+/* Queue the transfer of @a data to R0 and an instruction using it. */
+int armv8_dpm_queue_instr_write_data_r0_64(struct arm_dpm *dpm,
+	uint32_t opcode, uint64_t data)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	int retval;
+
+	retval = mem_ap_write_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DTRRX, data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (dpm->arm->core_state != ARM_STATE_AARCH64) {
+		retval = armv8_dpm_queue_instr(dpm, armv8_opcode(armv8, READ_REG_DTRRX));
+	} else {
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, data >> 32);
+		if (retval == ERROR_OK)
+			retval = armv8_dpm_queue_instr(dpm, ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, 0));
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	return armv8_dpm_queue_instr(dpm, opcode);
+}
+
+/*
+ * Queue the read of general purpose register X<regnum> in AArch64 state. The
+ * low word goes to data[0] and the high word to data[1], once the queue ran.
+ */
+int armv8_dpm_queue_read_xreg(struct arm_dpm *dpm, unsigned int regnum,
+	uint32_t data[2])
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	int retval;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64 || regnum > 30)
+		return ERROR_FAIL;
+
+	retval = armv8_dpm_queue_instr(dpm, ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, regnum));
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, &data[0]);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRRX, &data[1]);
+	return retval;
+}
+
+/*
+ * Run the queued instruction stream and check DSCR once. Returns ERROR_FAIL
+ * if any of the queued operations was lost or faulted.
+ */
+int armv8_dpm_queue_run(struct arm_dpm *dpm)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint32_t dscr;
+	int retval;
+
+	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the last instruction may still be executing */
+	long long then = timeval_ms();
+	while ((dscr & DSCR_ITE) == 0) {
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+		if (retval != ERROR_OK)
+			return retval;
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("Timeout waiting for queued instructions");
+			return ERROR_FAIL;
+		}
+	}
+
+	dpm->dscr = dscr;
+	dpm->last_el = (dscr >> 8) & 3;
+
+	if (dscr & DSCR_ERR) {
+		if (dscr & (DSCR_TXU | DSCR_RTO | DSCR_ITO)) {
+			uint32_t dummy;
+
+			LOG_DEBUG("queued instructions overran the DCC, dscr 0x%08" PRIx32, dscr);
+			/* drop what a lost instruction left in the DCC */
+			if (dscr & DSCR_DTR_RX_FULL)
+				mem_ap_read_u32(armv8->debug_ap,
+						armv8->debug_base + CPUV8_DBG_DTRRX, &dummy);
+			if (dscr & DSCR_DTR_TX_FULL)
+				mem_ap_read_u32(armv8->debug_ap,
+						armv8->debug_base + CPUV8_DBG_DTRTX, &dummy);
+			mem_ap_write_atomic_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
+			dpm->dscr = dscr & ~(DSCR_ERR | DSCR_DTR_RX_FULL | DSCR_DTR_TX_FULL);
+		} else {
+			LOG_DEBUG("queued instructions faulted, dscr 0x%08" PRIx32, dscr);
+			armv8_dpm_handle_exception(dpm, true);
+		}
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 #if 0
 static int dpmv8_bpwp_enable(struct arm_dpm *dpm, unsigned index_t,
 	target_addr_t addr, uint32_t control)
@@ -730,6 +856,44 @@ static int dpmv8_write_reg(struct arm_dpm *dpm, struct reg *r, unsigned regnum)
 	return retval;
 }
 
+/*
+ * Read all the general purpose registers not yet cached in one queue run.
+ * If that fails they are read one by one later on.
+ */
+static void dpmv8_read_xregs_queued(struct arm_dpm *dpm)
+{
+	struct reg_cache *cache = dpm->arm->core_cache;
+	uint32_t data[31][2];
+	bool queued = false;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_R30; i++) {
+		if (cache->reg_list[i].valid)
+			continue;
+		if (armv8_dpm_queue_read_xreg(dpm, i - ARMV8_R0, data[i - ARMV8_R0]) != ERROR_OK) {
+			/* the queued reads must complete before data goes away */
+			armv8_dpm_queue_run(dpm);
+			return;
+		}
+		queued = true;
+	}
+
+	if (!queued || armv8_dpm_queue_run(dpm) != ERROR_OK)
+		return;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_R30; i++) {
+		struct reg *r = &cache->reg_list[i];
+		if (r->valid)
+			continue;
+		uint32_t *value = data[i - ARMV8_R0];
+		buf_set_u64(r->value, 0, 64, value[0] | (uint64_t)value[1] << 32);
+		r->valid = true;
+		r->dirty = false;
+	}
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR;
  * sets the core mode (such as USR or IRQ) and state (such as ARM or Thumb).
@@ -746,12 +910,16 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 	uint32_t cpsr;
 	int retval;
 
+	arm_dpm_tlb_flush(dpm);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		return retval;
 
 	cache = arm->core_cache;
 
+	dpmv8_read_xregs_queued(dpm);
+
 	/* read R0 first (it's used for scratch), then CPSR */
 	r = cache->reg_list + ARMV8_R0;
 	if (!r->valid) {
@@ -875,6 +1043,8 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	struct reg_cache *cache = arm->core_cache;
 	int retval;
 
+	arm_dpm_tlb_flush(dpm);
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -39,6 +39,13 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp);
 
 void armv8_dpm_report_wfar(struct arm_dpm *dpm, uint64_t wfar);
 
+int armv8_dpm_queue_instr(struct arm_dpm *dpm, uint32_t opcode);
+int armv8_dpm_queue_instr_write_data_r0_64(struct arm_dpm *dpm,
+		uint32_t opcode, uint64_t data);
+int armv8_dpm_queue_read_xreg(struct arm_dpm *dpm, unsigned int regnum,
+		uint32_t data[2]);
+int armv8_dpm_queue_run(struct arm_dpm *dpm);
+
 /* DSCR bits; see ARMv7a arch spec section C10.3.1.
  * Not all v7 bits are valid in v6.
  */
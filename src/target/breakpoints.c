@@ -26,6 +26,8 @@
 #include "target.h"
 #include <helper/log.h>
 #include "breakpoints.h"
+#include "agent_expr.h"
+#include "smp.h"
 
 static const char * const breakpoint_type_strings[] = {
 	"hardware",
@@ -41,32 +43,86 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/*
+ * Besides their lists, the breakpoints and watchpoints of a target are
+ * kept in hash tables keyed by address, so that the lookups made on each
+ * halt and GDB packet do not walk hundreds of breakpoints.  The buckets
+ * keep the order of the lists.
+ */
+static unsigned int breakpoint_hash_index(target_addr_t address)
+{
+	/* instructions are at least 2-byte aligned */
+	uint32_t h = (uint32_t)(address >> 1) ^ (uint32_t)(address >> 33);
+	return ((h * 2654435761u) >> 16) & (TARGET_BREAKPOINT_HASH_SIZE - 1);
+}
+
+static void breakpoint_hash_add(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint **p = &target->breakpoint_hash[breakpoint_hash_index(breakpoint->address)];
+	while (*p)
+		p = &(*p)->hash_next;
+	breakpoint->hash_next = NULL;
+	*p = breakpoint;
+}
+
+static void breakpoint_hash_remove(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint **p = &target->breakpoint_hash[breakpoint_hash_index(breakpoint->address)];
+	while (*p && *p != breakpoint)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = breakpoint->hash_next;
+}
+
+static void watchpoint_hash_add(struct target *target, struct watchpoint *watchpoint)
+{
+	struct watchpoint **p = &target->watchpoint_hash[breakpoint_hash_index(watchpoint->address)];
+	while (*p)
+		p = &(*p)->hash_next;
+	watchpoint->hash_next = NULL;
+	*p = watchpoint;
+}
+
+static void watchpoint_hash_remove(struct target *target, struct watchpoint *watchpoint)
+{
+	struct watchpoint **p = &target->watchpoint_hash[breakpoint_hash_index(watchpoint->address)];
+	while (*p && *p != watchpoint)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = watchpoint->hash_next;
+}
+
+static struct watchpoint *watchpoint_find(struct target *target, target_addr_t address)
+{
+	struct watchpoint *watchpoint = target->watchpoint_hash[breakpoint_hash_index(address)];
+
+	while (watchpoint && watchpoint->address != address)
+		watchpoint = watchpoint->hash_next;
+	return watchpoint;
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint;
 	struct breakpoint **breakpoint_p = &target->breakpoints;
 	const char *reason;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	breakpoint = breakpoint_find(target, address);
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
 
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
@@ -77,6 +133,8 @@ static int breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	(*breakpoint_p)->conds = NULL;
+	(*breakpoint_p)->num_conds = 0;
 
 	retval = target_add_breakpoint(target, *breakpoint_p);
 	switch (retval) {
@@ -98,6 +156,7 @@ fail:
 			return retval;
 	}
 
+	breakpoint_hash_add(target, *breakpoint_p);
 	LOG_DEBUG("added %s breakpoint at " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->address, (*breakpoint_p)->length,
@@ -141,6 +200,8 @@ static int context_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	(*breakpoint_p)->conds = NULL;
+	(*breakpoint_p)->num_conds = 0;
 	retval = target_add_context_breakpoint(target, *breakpoint_p);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
@@ -150,6 +211,7 @@ static int context_breakpoint_add_internal(struct target *target,
 		return retval;
 	}
 
+	breakpoint_hash_add(target, *breakpoint_p);
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->asid, (*breakpoint_p)->length,
@@ -164,13 +226,11 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[breakpoint_hash_index(address)];
 	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
-	int n;
-	n = 0;
-	while (breakpoint) {
-		n++;
+
+	for (; breakpoint; breakpoint = breakpoint->hash_next) {
 		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
@@ -185,9 +245,9 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
 	}
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
 	(*breakpoint_p)->asid = asid;
@@ -197,6 +257,8 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	(*breakpoint_p)->conds = NULL;
+	(*breakpoint_p)->num_conds = 0;
 
 
 	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
@@ -207,6 +269,7 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 		*breakpoint_p = NULL;
 		return retval;
 	}
+	breakpoint_hash_add(target, *breakpoint_p);
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
@@ -287,6 +350,15 @@ int hybrid_breakpoint_add(struct target *target,
 		return hybrid_breakpoint_add_internal(target, address, asid, length, type);
 }
 
+static void breakpoint_free_conditions(struct breakpoint *breakpoint)
+{
+	for (unsigned int i = 0; i < breakpoint->num_conds; i++)
+		free(breakpoint->conds[i].bytecode);
+	free(breakpoint->conds);
+	breakpoint->conds = NULL;
+	breakpoint->num_conds = 0;
+}
+
 /* free up a breakpoint */
 static void breakpoint_free(struct target *target, struct breakpoint *breakpoint_to_remove)
 {
@@ -308,19 +380,21 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 
 	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
 	(*breakpoint_p) = breakpoint->next;
+	breakpoint_hash_remove(target, breakpoint);
+	breakpoint_free_conditions(breakpoint);
 	free(breakpoint->orig_instr);
 	free(breakpoint);
 }
 
 static int breakpoint_remove_internal(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	/* context breakpoints are removed by their asid */
+	for (struct breakpoint *b = target->breakpoint_hash[breakpoint_hash_index(0)];
+			!breakpoint && b; b = b->hash_next) {
+		if (b->address == 0 && b->asid == address)
+			breakpoint = b;
 	}
 
 	if (breakpoint) {
@@ -404,43 +478,123 @@ void breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[breakpoint_hash_index(address)];
 
-	while (breakpoint) {
-		if (breakpoint->address == address)
-			return breakpoint;
-		breakpoint = breakpoint->next;
+	while (breakpoint && breakpoint->address != address)
+		breakpoint = breakpoint->hash_next;
+	return breakpoint;
+}
+
+void breakpoint_forget_all(struct target *target)
+{
+	while (target->breakpoints) {
+		struct breakpoint *next = target->breakpoints->next;
+		breakpoint_free_conditions(target->breakpoints);
+		free(target->breakpoints->orig_instr);
+		free(target->breakpoints);
+		target->breakpoints = next;
+	}
+	memset(target->breakpoint_hash, 0, sizeof(target->breakpoint_hash));
+}
+
+static int breakpoint_set_conditions_internal(struct breakpoint *breakpoint,
+		const struct agent_expr *conds, unsigned int num_conds)
+{
+	breakpoint_free_conditions(breakpoint);
+	if (!num_conds)
+		return ERROR_OK;
+
+	breakpoint->conds = calloc(num_conds, sizeof(*conds));
+	if (!breakpoint->conds)
+		goto fail;
+
+	for (unsigned int i = 0; i < num_conds; i++) {
+		breakpoint->conds[i].bytecode = malloc(conds[i].len);
+		if (!breakpoint->conds[i].bytecode)
+			goto fail;
+		memcpy(breakpoint->conds[i].bytecode, conds[i].bytecode, conds[i].len);
+		breakpoint->conds[i].len = conds[i].len;
+		breakpoint->num_conds++;
 	}
 
-	return NULL;
+	return ERROR_OK;
+
+fail:
+	LOG_ERROR("Out of memory");
+	breakpoint_free_conditions(breakpoint);
+	return ERROR_FAIL;
+}
+
+int breakpoint_set_conditions(struct target *target, target_addr_t address,
+		const struct agent_expr *conds, unsigned int num_conds)
+{
+	struct target_list *head;
+	struct breakpoint *breakpoint;
+	int retval = ERROR_OK;
+
+	if (!target->smp) {
+		breakpoint = breakpoint_find(target, address);
+		return breakpoint ? breakpoint_set_conditions_internal(breakpoint, conds, num_conds) : ERROR_FAIL;
+	}
+
+	/* a soft breakpoint only exists on the first target of the group */
+	foreach_smp_target(head, target->head) {
+		breakpoint = breakpoint_find(head->target, address);
+		if (breakpoint && retval == ERROR_OK)
+			retval = breakpoint_set_conditions_internal(breakpoint, conds, num_conds);
+	}
+
+	return retval;
+}
+
+bool breakpoint_conditions_met(struct target *target, target_addr_t address)
+{
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+
+	if (!breakpoint && target->smp)
+		breakpoint = breakpoint_find(target->head->target, address);
+	if (!breakpoint || !breakpoint->num_conds)
+		return true;
+
+	for (unsigned int i = 0; i < breakpoint->num_conds; i++) {
+		int64_t value;
+		int retval = agent_expr_eval(target, &breakpoint->conds[i], &value);
+		if (retval != ERROR_OK) {
+			LOG_WARNING("can't evaluate the condition of the breakpoint at "
+					TARGET_ADDR_FMT ", stopping", address);
+			return true;
+		}
+		if (value)
+			return true;
+	}
+
+	return false;
 }
 
 int watchpoint_add(struct target *target, target_addr_t address, uint32_t length,
 	enum watchpoint_rw rw, uint32_t value, uint32_t mask)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
+	struct watchpoint *watchpoint = watchpoint_find(target, address);
 	struct watchpoint **watchpoint_p = &target->watchpoints;
 	int retval;
 	const char *reason;
 
-	while (watchpoint) {
-		if (watchpoint->address == address) {
-			if (watchpoint->length != length
-				|| watchpoint->value != value
-				|| watchpoint->mask != mask
-				|| watchpoint->rw != rw) {
-				LOG_ERROR("address " TARGET_ADDR_FMT
-					" already has watchpoint %d",
-					address, watchpoint->unique_id);
-				return ERROR_FAIL;
-			}
-
-			/* ignore duplicate watchpoint */
-			return ERROR_OK;
+	if (watchpoint) {
+		if (watchpoint->length != length
+			|| watchpoint->value != value
+			|| watchpoint->mask != mask
+			|| watchpoint->rw != rw) {
+			LOG_ERROR("address " TARGET_ADDR_FMT
+				" already has watchpoint %d",
+				address, watchpoint->unique_id);
+			return ERROR_FAIL;
 		}
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
+
+		/* ignore duplicate watchpoint */
+		return ERROR_OK;
 	}
+	while (*watchpoint_p)
+		watchpoint_p = &(*watchpoint_p)->next;
 
 	(*watchpoint_p) = calloc(1, sizeof(struct watchpoint));
 	(*watchpoint_p)->address = address;
@@ -471,6 +625,7 @@ bye:
 			return retval;
 	}
 
+	watchpoint_hash_add(target, *watchpoint_p);
 	LOG_DEBUG("added %s watchpoint at " TARGET_ADDR_FMT
 		" of length 0x%8.8" PRIx32 " (WPID: %d)",
 		watchpoint_rw_strings[(*watchpoint_p)->rw],
@@ -499,18 +654,13 @@ static void watchpoint_free(struct target *target, struct watchpoint *watchpoint
 	retval = target_remove_watchpoint(target, watchpoint);
 	LOG_DEBUG("free WPID: %d --> %d", watchpoint->unique_id, retval);
 	(*watchpoint_p) = watchpoint->next;
+	watchpoint_hash_remove(target, watchpoint);
 	free(watchpoint);
 }
 
 void watchpoint_remove(struct target *target, target_addr_t address)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-
-	while (watchpoint) {
-		if (watchpoint->address == address)
-			break;
-		watchpoint = watchpoint->next;
-	}
+	struct watchpoint *watchpoint = watchpoint_find(target, address);
 
 	if (watchpoint)
 		watchpoint_free(target, watchpoint);
@@ -526,6 +676,16 @@ void watchpoint_clear_target(struct target *target)
 		watchpoint_free(target, target->watchpoints);
 }
 
+void watchpoint_forget_all(struct target *target)
+{
+	while (target->watchpoints) {
+		struct watchpoint *next = target->watchpoints->next;
+		free(target->watchpoints);
+		target->watchpoints = next;
+	}
+	memset(target->watchpoint_hash, 0, sizeof(target->watchpoint_hash));
+}
+
 int watchpoint_hit(struct target *target, enum watchpoint_rw *rw,
 		   target_addr_t *address)
 {
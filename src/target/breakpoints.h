@@ -19,9 +19,11 @@
 #ifndef OPENOCD_TARGET_BREAKPOINTS_H
 #define OPENOCD_TARGET_BREAKPOINTS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct target;
+struct agent_expr;
 
 enum breakpoint_type {
 	BKPT_HARD,
@@ -40,8 +42,12 @@ struct breakpoint {
 	int set;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	struct breakpoint *hash_next;	/* bucket chain of breakpoint_find() */
 	uint32_t unique_id;
 	int linked_BRP;
+	/* GDB conditions, the breakpoint only stops when one of them is true */
+	struct agent_expr *conds;
+	unsigned int num_conds;
 };
 
 struct watchpoint {
@@ -52,6 +58,7 @@ struct watchpoint {
 	enum watchpoint_rw rw;
 	int set;
 	struct watchpoint *next;
+	struct watchpoint *hash_next;	/* bucket chain of the address index */
 	int unique_id;
 };
 
@@ -64,14 +71,26 @@ int hybrid_breakpoint_add(struct target *target,
 		target_addr_t address, uint32_t asid, uint32_t length, enum breakpoint_type type);
 void breakpoint_remove(struct target *target, target_addr_t address);
 void breakpoint_remove_all(struct target *target);
+/* free all breakpoints of @a target without removing them from the target,
+ * once a reset has cleared them there */
+void breakpoint_forget_all(struct target *target);
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
+/* replace the conditions of the breakpoint at @a address by copies of @a conds */
+int breakpoint_set_conditions(struct target *target, target_addr_t address,
+		const struct agent_expr *conds, unsigned int num_conds);
+/* @returns false when the breakpoint at @a address has conditions, which
+ * are all false, true when it has none or one is true or fails */
+bool breakpoint_conditions_met(struct target *target, target_addr_t address);
+
 void watchpoint_clear_target(struct target *target);
 int watchpoint_add(struct target *target,
 		target_addr_t address, uint32_t length,
 		enum watchpoint_rw rw, uint32_t value, uint32_t mask);
 void watchpoint_remove(struct target *target, target_addr_t address);
+/* same as breakpoint_forget_all() for watchpoints */
+void watchpoint_forget_all(struct target *target);
 
 /* report type and address of just hit watchpoint */
 int watchpoint_hit(struct target *target, enum watchpoint_rw *rw,
@@ -71,6 +71,9 @@ static int cortex_a_set_hybrid_breakpoint(struct target *target,
 	struct breakpoint *breakpoint);
 static int cortex_a_unset_breakpoint(struct target *target,
 	struct breakpoint *breakpoint);
+static int cortex_a_write_soft_breakpoint(struct target *target,
+	struct breakpoint *breakpoint);
+static int cortex_a_set_pending_breakpoints(struct target *target);
 static int cortex_a_wait_dscr_bits(struct target *target, uint32_t mask,
 	uint32_t value, uint32_t *dscr);
 static int cortex_a_mmu(struct target *target, int *enabled);
@@ -734,7 +737,7 @@ static int cortex_a_poll(struct target *target)
 			if (retval != ERROR_OK)
 				return retval;
 
-			if (target->smp) {
+			if (target->smp && !target->smp_nonstop) {
 				retval = update_halt_gdb(target);
 				if (retval != ERROR_OK)
 					return retval;
@@ -954,8 +957,9 @@ static int cortex_a_restore_smp(struct target *target, int handle_breakpoints)
 	return retval;
 }
 
-static int cortex_a_resume(struct target *target, int current,
-	target_addr_t address, int handle_breakpoints, int debug_execution)
+static int cortex_a_resume_internal(struct target *target, int current,
+	target_addr_t address, int handle_breakpoints, int debug_execution,
+	bool set_pending)
 {
 	int retval = 0;
 	/* dummy resume for smp toggle in order to reduce gdb impact  */
@@ -967,8 +971,13 @@ static int cortex_a_resume(struct target *target, int current,
 		target_call_event_callbacks(target, TARGET_EVENT_RESUMED);
 		return 0;
 	}
+	if (set_pending) {
+		retval = cortex_a_set_pending_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 	cortex_a_internal_restore(target, current, &address, handle_breakpoints, debug_execution);
-	if (target->smp) {
+	if (target->smp && !target->smp_nonstop) {
 		target->gdb_service->core[0] = -1;
 		retval = cortex_a_restore_smp(target, handle_breakpoints);
 		if (retval != ERROR_OK)
@@ -989,6 +998,13 @@ static int cortex_a_resume(struct target *target, int current,
 	return ERROR_OK;
 }
 
+static int cortex_a_resume(struct target *target, int current,
+	target_addr_t address, int handle_breakpoints, int debug_execution)
+{
+	return cortex_a_resume_internal(target, current, address,
+			handle_breakpoints, debug_execution, true);
+}
+
 static int cortex_a_debug_entry(struct target *target)
 {
 	uint32_t dscr;
@@ -1153,6 +1169,12 @@ static int cortex_a_step(struct target *target, int current, target_addr_t addre
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* insert the pending software breakpoints before looking for
+	 * the one at the stepped address */
+	retval = cortex_a_set_pending_breakpoints(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* current = 1: continue on current pc, otherwise continue at <address> */
 	r = arm->pc;
 	if (!current)
@@ -1191,7 +1213,8 @@ static int cortex_a_step(struct target *target, int current, target_addr_t addre
 
 	target->debug_reason = DBG_REASON_SINGLESTEP;
 
-	retval = cortex_a_resume(target, 1, address, 0, 0);
+	/* the breakpoint at the stepped address stays out */
+	retval = cortex_a_resume_internal(target, 1, address, 0, 0, false);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -1292,54 +1315,114 @@ static int cortex_a_set_breakpoint(struct target *target,
 			brp_list[brp_i].control,
 			brp_list[brp_i].value);
 	} else if (breakpoint->type == BKPT_SOFT) {
-		uint8_t code[4];
-		/* length == 2: Thumb breakpoint */
-		if (breakpoint->length == 2)
-			buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
-		else
-		/* length == 3: Thumb-2 breakpoint, actual encoding is
-		 * a regular Thumb BKPT instruction but we replace a
-		 * 32bit Thumb-2 instruction, so fix-up the breakpoint
-		 * length
-		 */
-		if (breakpoint->length == 3) {
-			buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
-			breakpoint->length = 4;
-		} else
-			/* length == 4, normal ARM breakpoint */
-			buf_set_u32(code, 0, 32, ARMV5_BKPT(0x11));
-
-		retval = target_read_memory(target,
-				breakpoint->address & 0xFFFFFFFE,
-				breakpoint->length, 1,
-				breakpoint->orig_instr);
-		if (retval != ERROR_OK)
-			return retval;
-
-		/* make sure data cache is cleaned & invalidated down to PoC */
-		if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled) {
-			armv7a_cache_flush_virt(target, breakpoint->address,
-						breakpoint->length);
-		}
-
-		retval = target_write_memory(target,
-				breakpoint->address & 0xFFFFFFFE,
-				breakpoint->length, 1, code);
+		retval = cortex_a_write_soft_breakpoint(target, breakpoint);
 		if (retval != ERROR_OK)
 			return retval;
 
 		/* update i-cache at breakpoint location */
-		armv7a_l1_d_cache_inval_virt(target, breakpoint->address,
-					breakpoint->length);
 		armv7a_l1_i_cache_inval_virt(target, breakpoint->address,
 						 breakpoint->length);
+	}
+
+	return ERROR_OK;
+}
 
-		breakpoint->set = 0x11;	/* Any nice value but 0 */
+/**
+ * Write the BKPT instruction of a software breakpoint and push it out of
+ * the data cache. The i-cache is left to the caller, which may batch it.
+ */
+static int cortex_a_write_soft_breakpoint(struct target *target,
+	struct breakpoint *breakpoint)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	uint8_t code[4];
+	int retval;
+
+	/* length == 2: Thumb breakpoint */
+	if (breakpoint->length == 2)
+		buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+	else
+	/* length == 3: Thumb-2 breakpoint, actual encoding is
+	 * a regular Thumb BKPT instruction but we replace a
+	 * 32bit Thumb-2 instruction, so fix-up the breakpoint
+	 * length
+	 */
+	if (breakpoint->length == 3) {
+		buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+		breakpoint->length = 4;
+	} else
+		/* length == 4, normal ARM breakpoint */
+		buf_set_u32(code, 0, 32, ARMV5_BKPT(0x11));
+
+	retval = target_read_memory(target,
+			breakpoint->address & 0xFFFFFFFE,
+			breakpoint->length, 1,
+			breakpoint->orig_instr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* make sure data cache is cleaned & invalidated down to PoC */
+	if (!armv7a->armv7a_mmu.armv7a_cache.auto_cache_enabled) {
+		armv7a_cache_flush_virt(target, breakpoint->address,
+					breakpoint->length);
 	}
 
+	retval = target_write_memory(target,
+			breakpoint->address & 0xFFFFFFFE,
+			breakpoint->length, 1, code);
+	if (retval != ERROR_OK)
+		return retval;
+
+	armv7a_l1_d_cache_inval_virt(target, breakpoint->address,
+				breakpoint->length);
+
+	breakpoint->set = 0x11;	/* Any nice value but 0 */
+
 	return ERROR_OK;
 }
 
+/**
+ * Write the software breakpoints added since the last halt. They are
+ * inserted together right before the core restarts, so that a whole
+ * batch from gdb costs a single i-cache invalidation instead of one
+ * per breakpoint. In SMP the software breakpoints live on the first
+ * target of the group, the memory being shared.
+ */
+static int cortex_a_set_pending_breakpoints(struct target *target)
+{
+	struct target_list head_self = { .target = target, .next = NULL };
+	struct target_list *head = target->smp ? target->head : &head_self;
+	struct target *inval = NULL;
+	int retval = ERROR_OK;
+
+	for (; head; head = head->next) {
+		struct target *curr = head->target;
+
+		if (curr->state != TARGET_HALTED || !target_was_examined(curr))
+			continue;
+
+		for (struct breakpoint *bp = curr->breakpoints; bp; bp = bp->next) {
+			if (bp->type != BKPT_SOFT || bp->set)
+				continue;
+
+			int ret = cortex_a_write_soft_breakpoint(curr, bp);
+			if (ret != ERROR_OK) {
+				LOG_ERROR("can't insert breakpoint at " TARGET_ADDR_FMT,
+					bp->address);
+				retval = ret;
+				continue;
+			}
+			inval = curr;
+		}
+	}
+
+	/* update the i-cache of the whole batch */
+	if (inval)
+		armv7a_l1_i_cache_inval_all(inval);
+
+	return retval;
+}
+
 static int cortex_a_set_context_breakpoint(struct target *target,
 	struct breakpoint *breakpoint, uint8_t matchmode)
 {
@@ -1599,6 +1682,10 @@ static int cortex_a_add_breakpoint(struct target *target,
 	if (breakpoint->type == BKPT_HARD)
 		cortex_a->brp_num_available--;
 
+	/* software breakpoints are written at the next resume or step */
+	if (breakpoint->type == BKPT_SOFT)
+		return ERROR_OK;
+
 	return cortex_a_set_breakpoint(target, breakpoint, 0x00);	/* Exact match */
 }
 
@@ -1991,6 +2078,18 @@ static int cortex_a_write_cpu_memory_slow(struct target *target,
 	return ERROR_OK;
 }
 
+/* Words moved through the DCC per DAP queue run in fast mode. The core
+ * stays in fast mode between chunks; a chunk only bounds the queue and the
+ * amount of data transferred after a data abort. */
+#define CORTEX_A_DCC_CHUNK_WORDS	16384
+
+/* Once a sticky abort is set the rest of a transfer is useless, so a
+ * transfer in fast mode stops at the chunk following the abort. */
+static bool cortex_a_dcc_aborted(uint32_t dscr)
+{
+	return dscr & (DSCR_STICKY_ABORT_PRECISE | DSCR_STICKY_ABORT_IMPRECISE);
+}
+
 static int cortex_a_write_cpu_memory_fast(struct target *target,
 	uint32_t count, const uint8_t *buffer, uint32_t *dscr)
 {
@@ -2015,9 +2114,33 @@ static int cortex_a_write_cpu_memory_fast(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* Transfer all the data and issue all the instructions. */
-	return mem_ap_write_buf_noincr(armv7a->debug_ap, buffer,
-			4, count, armv7a->debug_base + CPUDBG_DTRRX);
+	/* Transfer all the data and issue all the instructions. DSCR of the
+	 * previous chunk is read at the start of the next one, in the same
+	 * queue run. */
+	bool check_dscr = false;
+	while (count > 0) {
+		uint32_t chunk = MIN(count, CORTEX_A_DCC_CHUNK_WORDS);
+
+		if (check_dscr) {
+			retval = mem_ap_read_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DSCR, dscr);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		retval = mem_ap_write_buf_noincr(armv7a->debug_ap, buffer,
+				4, chunk, armv7a->debug_base + CPUDBG_DTRRX);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (check_dscr && cortex_a_dcc_aborted(*dscr))
+			break;
+		check_dscr = true;
+		buffer += chunk * 4;
+		count -= chunk;
+	}
+
+	return ERROR_OK;
 }
 
 static int cortex_a_write_cpu_memory(struct target *target,
@@ -2294,14 +2417,32 @@ static int cortex_a_read_cpu_memory_fast(struct target *target,
 		 * then reissues the read instruction to read the next word from
 		 * memory. The last read of DTRTX in this call reads the second-to-last
 		 * word from memory and issues the read instruction for the last word.
+		 * As for writes, DSCR of a chunk is read with the next one.
 		 */
-		retval = mem_ap_read_buf_noincr(armv7a->debug_ap, buffer,
-				4, count, armv7a->debug_base + CPUDBG_DTRTX);
-		if (retval != ERROR_OK)
-			return retval;
+		bool check_dscr = false;
+		while (count > 0) {
+			uint32_t chunk = MIN(count, CORTEX_A_DCC_CHUNK_WORDS);
 
-		/* Advance. */
-		buffer += count * 4;
+			if (check_dscr) {
+				retval = mem_ap_read_u32(armv7a->debug_ap,
+						armv7a->debug_base + CPUDBG_DSCR, dscr);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+
+			retval = mem_ap_read_buf_noincr(armv7a->debug_ap, buffer,
+					4, chunk, armv7a->debug_base + CPUDBG_DTRTX);
+			if (retval != ERROR_OK)
+				return retval;
+
+			if (check_dscr && cortex_a_dcc_aborted(*dscr))
+				break;
+			check_dscr = true;
+
+			/* Advance. */
+			buffer += chunk * 4;
+			count -= chunk;
+		}
 	}
 
 	/* Wait for last issued instruction to complete. */
@@ -2642,11 +2783,12 @@ static int cortex_a_handle_target_request(void *priv)
 	if (!target->dbg_msg_enabled)
 		return ERROR_OK;
 
-	if (target->state == TARGET_RUNNING) {
+	if (target->state == TARGET_RUNNING && target_request_poll_due(target)) {
 		uint32_t request;
 		uint32_t dscr;
 		retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
 				armv7a->debug_base + CPUDBG_DSCR, &dscr);
+		target_request_polled(target, retval == ERROR_OK && (dscr & DSCR_DTR_TX_FULL));
 
 		/* check if we have data */
 		int64_t then = timeval_ms();
@@ -2966,6 +3108,73 @@ static void cortex_a_deinit_target(struct target *target)
 	free(cortex_a);
 }
 
+static int cortex_a_profiling(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+	uint32_t version = (cortex_a->didr >> 16) & 0xf;
+	uint32_t pcsr = 0;
+	bool pc_offset = true;
+	int retval;
+
+	if (version >= 5) {
+		/* v7.1 debug: DBGDEVID tells about DBGPCSR and its offset */
+		uint32_t devid, devid1;
+		retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DEVID, &devid);
+		if (retval != ERROR_OK)
+			return retval;
+		if (devid & 0xf) {
+			pcsr = CPUDBG_PCSR;
+			retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DEVID1, &devid1);
+			if (retval != ERROR_OK)
+				return retval;
+			pc_offset = (devid1 & 0xf) == 0;
+		}
+	} else if (cortex_a->didr & (1 << 13)) {
+		pcsr = CPUDBG_PCSR_V70;
+	}
+
+	if (!pcsr)
+		return target_profiling_default(target, samples, max_num_samples,
+				num_samples, seconds);
+
+	/* Make sure the target is running */
+	target_poll(target);
+	if (target->state == TARGET_HALTED) {
+		retval = target_resume(target, 1, 0, 0, 0);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Error while resuming target");
+			return retval;
+		}
+	}
+
+	LOG_INFO("Starting profiling. Sampling DBGPCSR as fast as we can...");
+	retval = mem_ap_sample_pc(armv7a->debug_ap, armv7a->debug_base + pcsr,
+			samples, max_num_samples, num_samples, seconds);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error while reading DBGPCSR");
+		return retval;
+	}
+
+	/* bits [1:0] encode the instruction set, the sample may be ahead
+	 * of the instruction by 8 (ARM) or 4 (Thumb) bytes */
+	for (uint32_t i = 0; i < *num_samples; i++) {
+		uint32_t pc = samples[i];
+		if (pc & 1)
+			samples[i] = (pc & ~1) - (pc_offset ? 4 : 0);
+		else if (!(pc & 2))
+			samples[i] = pc - (pc_offset ? 8 : 0);
+		else
+			samples[i] = pc & ~3;
+	}
+
+	LOG_INFO("Profiling completed. %" PRIu32 " samples.", *num_samples);
+	return ERROR_OK;
+}
+
 static int cortex_a_mmu(struct target *target, int *enabled)
 {
 	struct armv7a_common *armv7a = target_to_armv7a(target);
@@ -3187,6 +3396,7 @@ struct target_type cortexa_target = {
 	.write_phys_memory = cortex_a_write_phys_memory,
 	.mmu = cortex_a_mmu,
 	.virt2phys = cortex_a_virt2phys,
+	.profiling = cortex_a_profiling,
 };
 
 static const struct command_registration cortex_r4_exec_command_handlers[] = {
@@ -3259,4 +3469,5 @@ struct target_type cortexr4_target = {
 	.init_target = cortex_a_init_target,
 	.examine = cortex_a_examine,
 	.deinit_target = cortex_a_deinit_target,
+	.profiling = cortex_a_profiling,
 };
@@ -38,6 +38,7 @@
 #include "register.h"
 #include "arm_opcodes.h"
 #include "arm_semihosting.h"
+#include "itm_decode.h"
 #include <helper/time_support.h>
 
 /* NOTE:  most of this should work fine for the Cortex-M1 and
@@ -89,6 +90,258 @@ static int cortexm_dap_read_coreregister_u32(struct target *target,
 	return retval;
 }
 
+/**
+ * Reads the invalid core registers of @a reg_list which have a DCRSR
+ * selector in a single DAP queue run. Every DCRDR read is preceded by a
+ * DHCSR read, which both gives the core time to transfer the register and
+ * lets us check S_REGRDY afterwards. Nothing is stored unless all the
+ * transfers were ready and the core was not reset meanwhile.
+ */
+static int cortex_m_read_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	struct {
+		struct reg *reg;
+		unsigned int word;
+		uint32_t dhcsr;
+		uint32_t value;
+	} *ops;
+	int num_ops = 0;
+	int retval = ERROR_OK;
+
+	/* DCRDR is the emulated DCC channel then, see above */
+	if (target->dbg_msg_enabled || !cache)
+		return ERROR_OK;
+
+	ops = calloc(2 * reg_list_size, sizeof(*ops));
+	if (!ops) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *r = reg_list[i];
+		if (!r || r->valid || !r->exist ||
+				r < cache->reg_list || r >= cache->reg_list + cache->num_regs)
+			continue;
+
+		int num = ((struct arm_reg *)r->arch_info)->num;
+		uint32_t sel;
+		unsigned int words = 1;
+
+		switch (num) {
+		case ARMV7M_R0 ... ARMV7M_PSP:
+			sel = num;
+			break;
+		case ARMV7M_PRIMASK ... ARMV7M_CONTROL:
+			sel = 20;
+			break;
+		case ARMV7M_S0 ... ARMV7M_S31:
+			sel = num - ARMV7M_S0 + 0x40;
+			break;
+		case ARMV7M_D0 ... ARMV7M_D15:
+			sel = 2 * (num - ARMV7M_D0) + 0x40;
+			words = 2;
+			break;
+		case ARMV7M_FPSCR:
+			sel = 0x21;
+			break;
+		default:
+			continue;
+		}
+
+		for (unsigned int w = 0; w < words; w++) {
+			ops[num_ops].reg = r;
+			ops[num_ops].word = w;
+			retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRSR, sel + w);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR,
+						&ops[num_ops].dhcsr);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR,
+						&ops[num_ops].value);
+			if (retval != ERROR_OK)
+				goto out;
+			num_ops++;
+		}
+	}
+
+	if (!num_ops)
+		goto out;
+
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		goto out;
+
+	for (int i = 0; i < num_ops; i++) {
+		if (!(ops[i].dhcsr & S_REGRDY) || (ops[i].dhcsr & S_RESET_ST)) {
+			LOG_DEBUG("register transfer not ready, reading one by one");
+			goto out;
+		}
+	}
+
+	for (int i = 0; i < num_ops; i++) {
+		struct reg *r = ops[i].reg;
+		uint32_t value = ops[i].value;
+
+		switch (((struct arm_reg *)r->arch_info)->num) {
+		case ARMV7M_PRIMASK:
+			value = buf_get_u32((uint8_t *)&ops[i].value, 0, 1);
+			break;
+		case ARMV7M_BASEPRI:
+			value = buf_get_u32((uint8_t *)&ops[i].value, 8, 8);
+			break;
+		case ARMV7M_FAULTMASK:
+			value = buf_get_u32((uint8_t *)&ops[i].value, 16, 1);
+			break;
+		case ARMV7M_CONTROL:
+			value = buf_get_u32((uint8_t *)&ops[i].value, 24, 3);
+			break;
+		}
+
+		buf_set_u32((uint8_t *)r->value + 4 * ops[i].word, 0, 32, value);
+		if (!r->valid)
+			target_to_cm(target)->regs_read++;
+		r->valid = true;
+		r->dirty = false;
+	}
+
+out:
+	free(ops);
+	return retval;
+}
+
+/**
+ * Writes the dirty core registers of @a reg_list which have a DCRSR
+ * selector in a single DAP queue run, the counterpart of
+ * cortex_m_read_registers_batch(). A DHCSR read after every DCRSR write
+ * gives the core time to complete the transfer before the next DCRDR
+ * write, and S_REGRDY is checked afterwards. PRIMASK, BASEPRI, FAULTMASK
+ * and CONTROL share one selector, so they are only written here when
+ * all four are known. Nothing is marked clean unless every transfer was
+ * ready. Like the write back loop of armv7m_restore_context() the list is
+ * written from its end, so CONTROL goes before the stack pointers, which
+ * then land on the stack it selects, and S<n> goes after D<n>.
+ */
+static int cortex_m_write_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	struct reg **done;
+	uint32_t *dhcsr;
+	int num_done = 0;
+	int num_ops = 0;
+	bool special_done = false;
+	int retval = ERROR_OK;
+
+	/* DCRDR is the emulated DCC channel then */
+	if (target->dbg_msg_enabled || !cache)
+		return ERROR_OK;
+
+	done = calloc(reg_list_size, sizeof(*done));
+	dhcsr = calloc(2 * reg_list_size, sizeof(*dhcsr));
+	if (!done || !dhcsr) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (int i = reg_list_size - 1; i >= 0; i--) {
+		struct reg *r = reg_list[i];
+		if (!r || !r->dirty || !r->valid || !r->exist ||
+				r < cache->reg_list || r >= cache->reg_list + cache->num_regs)
+			continue;
+
+		int num = ((struct arm_reg *)r->arch_info)->num;
+		uint32_t sel;
+		uint32_t value[2];
+		unsigned int words = 1;
+
+		value[0] = buf_get_u32(r->value, 0, 32);
+
+		switch (num) {
+		case ARMV7M_R0 ... ARMV7M_PSP:
+			sel = num;
+			break;
+		case ARMV7M_PRIMASK ... ARMV7M_CONTROL: {
+			struct reg *primask = &cache->reg_list[ARMV7M_PRIMASK];
+			struct reg *basepri = &cache->reg_list[ARMV7M_BASEPRI];
+			struct reg *faultmask = &cache->reg_list[ARMV7M_FAULTMASK];
+			struct reg *control = &cache->reg_list[ARMV7M_CONTROL];
+
+			if (special_done || !primask->valid || !basepri->valid ||
+					!faultmask->valid || !control->valid)
+				continue;
+
+			value[0] = 0;
+			buf_set_u32((uint8_t *)&value[0], 0, 1, buf_get_u32(primask->value, 0, 1));
+			buf_set_u32((uint8_t *)&value[0], 8, 8, buf_get_u32(basepri->value, 0, 8));
+			buf_set_u32((uint8_t *)&value[0], 16, 1, buf_get_u32(faultmask->value, 0, 1));
+			buf_set_u32((uint8_t *)&value[0], 24, 3, buf_get_u32(control->value, 0, 3));
+			special_done = true;
+			sel = 20;
+			break;
+		}
+		case ARMV7M_S0 ... ARMV7M_S31:
+			sel = num - ARMV7M_S0 + 0x40;
+			break;
+		case ARMV7M_D0 ... ARMV7M_D15:
+			sel = 2 * (num - ARMV7M_D0) + 0x40;
+			value[1] = buf_get_u32((uint8_t *)r->value + 4, 0, 32);
+			words = 2;
+			break;
+		case ARMV7M_FPSCR:
+			sel = 0x21;
+			break;
+		default:
+			continue;
+		}
+
+		for (unsigned int w = 0; w < words; w++) {
+			retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRDR, value[w]);
+			if (retval == ERROR_OK)
+				retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRSR,
+						(sel + w) | DCRSR_WnR);
+			if (retval == ERROR_OK)
+				retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR,
+						&dhcsr[num_ops]);
+			if (retval != ERROR_OK)
+				goto out;
+			num_ops++;
+		}
+		done[num_done++] = r;
+	}
+
+	if (!num_ops)
+		goto out;
+
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		goto out;
+
+	for (int i = 0; i < num_ops; i++) {
+		if (!(dhcsr[i] & S_REGRDY) || (dhcsr[i] & S_RESET_ST)) {
+			LOG_DEBUG("register transfer not ready, writing one by one");
+			goto out;
+		}
+	}
+
+	for (int i = 0; i < num_done; i++)
+		done[i]->dirty = false;
+	if (special_done) {
+		for (int num = ARMV7M_PRIMASK; num <= ARMV7M_CONTROL; num++)
+			cache->reg_list[num].dirty = false;
+	}
+
+out:
+	free(dhcsr);
+	free(done);
+	return retval;
+}
+
 static int cortexm_dap_write_coreregister_u32(struct target *target,
 	uint32_t value, int regnum)
 {
@@ -122,7 +375,8 @@ static int cortexm_dap_write_coreregister_u32(struct target *target,
 	return retval;
 }
 
-static int cortex_m_write_debug_halt_mask(struct target *target,
+/* Queue a DHCSR write only, it runs with the next DAP queue run. */
+static int cortex_m_queue_debug_halt_mask(struct target *target,
 	uint32_t mask_on, uint32_t mask_off)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
@@ -133,7 +387,19 @@ static int cortex_m_write_debug_halt_mask(struct target *target,
 	/* create new register mask */
 	cortex_m->dcb_dhcsr |= DBGKEY | C_DEBUGEN | mask_on;
 
-	return mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR, cortex_m->dcb_dhcsr);
+	return mem_ap_write_u32(armv7m->debug_ap, DCB_DHCSR, cortex_m->dcb_dhcsr);
+}
+
+static int cortex_m_write_debug_halt_mask(struct target *target,
+	uint32_t mask_on, uint32_t mask_off)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	int retval = cortex_m_queue_debug_halt_mask(target, mask_on, mask_off);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return dap_run(armv7m->debug_ap->dap);
 }
 
 static int cortex_m_set_maskints(struct target *target, bool mask)
@@ -213,6 +479,10 @@ static int cortex_m_set_maskints_for_step(struct target *target)
 	return ERROR_OK;
 }
 
+/*
+ * Clear C_STEP and the Debug Fault Status, and read DHCSR again, together
+ * with whatever DHCSR writes are queued, in a single DAP queue run.
+ */
 static int cortex_m_clear_halt(struct target *target)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
@@ -220,15 +490,17 @@ static int cortex_m_clear_halt(struct target *target)
 	int retval;
 
 	/* clear step if any */
-	cortex_m_write_debug_halt_mask(target, C_HALT, C_STEP);
+	retval = cortex_m_queue_debug_halt_mask(target, C_HALT, C_STEP);
 
-	/* Read Debug Fault Status Register */
-	retval = mem_ap_read_atomic_u32(armv7m->debug_ap, NVIC_DFSR, &cortex_m->nvic_dfsr);
-	if (retval != ERROR_OK)
-		return retval;
-
-	/* Clear Debug Fault Status */
-	retval = mem_ap_write_atomic_u32(armv7m->debug_ap, NVIC_DFSR, cortex_m->nvic_dfsr);
+	/* Read and clear Debug Fault Status Register. The core is halted, so no
+	 * new event can come in between, and each bit is write-one-to-clear. */
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_u32(armv7m->debug_ap, NVIC_DFSR, &cortex_m->nvic_dfsr);
+	if (retval == ERROR_OK)
+		retval = mem_ap_write_u32(armv7m->debug_ap, NVIC_DFSR,
+				DFSR_HALTED | DFSR_BKPT | DFSR_DWTTRAP | DFSR_VCATCH | DFSR_EXTERNAL);
+	if (retval == ERROR_OK)
+		retval = mem_ap_read_atomic_u32(armv7m->debug_ap, DCB_DHCSR, &cortex_m->dcb_dhcsr);
 	if (retval != ERROR_OK)
 		return retval;
 	LOG_DEBUG(" NVIC_DFSR 0x%" PRIx32 "", cortex_m->nvic_dfsr);
@@ -247,21 +519,19 @@ static int cortex_m_single_step_core(struct target *target)
 	 * HALT can put the core into an unknown state.
 	 */
 	if (!(cortex_m->dcb_dhcsr & C_MASKINTS)) {
-		retval = mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR,
+		retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DHCSR,
 				DBGKEY | C_MASKINTS | C_HALT | C_DEBUGEN);
 		if (retval != ERROR_OK)
 			return retval;
 	}
-	retval = mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR,
+	retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DHCSR,
 			DBGKEY | C_MASKINTS | C_STEP | C_DEBUGEN);
 	if (retval != ERROR_OK)
 		return retval;
 	LOG_DEBUG(" ");
 
-	/* restore dhcsr reg */
-	cortex_m_clear_halt(target);
-
-	return ERROR_OK;
+	/* restore dhcsr reg, this runs the step too */
+	return cortex_m_clear_halt(target);
 }
 
 static int cortex_m_enable_fpb(struct target *target)
@@ -493,8 +763,8 @@ static int cortex_m_debug_entry(struct target *target)
 	 * can pile up pending interrupts. */
 	cortex_m_set_maskints_for_halt(target);
 
-	cortex_m_clear_halt(target);
-	retval = mem_ap_read_atomic_u32(armv7m->debug_ap, DCB_DHCSR, &cortex_m->dcb_dhcsr);
+	/* this reads DHCSR too */
+	retval = cortex_m_clear_halt(target);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -518,10 +788,32 @@ static int cortex_m_debug_entry(struct target *target)
 	 * First load register accessible through core debug port */
 	int num_regs = arm->core_cache->num_regs;
 
-	for (i = 0; i < num_regs; i++) {
-		r = &armv7m->arm.core_cache->reg_list[i];
+	/* With lazy_regs only what debug entry, arch_state and semihosting
+	 * need; everything else is read when first used. */
+	static const int eager_regs[] = {
+		ARMV7M_R0, ARMV7M_R1, ARMV7M_R13, ARMV7M_R14, ARMV7M_PC,
+		ARMV7M_xPSR, ARMV7M_CONTROL,
+	};
+	int num_fetch = cortex_m->lazy_regs ? (int)ARRAY_SIZE(eager_regs) : num_regs;
+
+	cortex_m->halt_count++;
+
+	struct reg **reg_list = malloc(num_fetch * sizeof(*reg_list));
+	if (reg_list) {
+		for (i = 0; i < num_fetch; i++)
+			reg_list[i] = &armv7m->arm.core_cache->reg_list[
+				cortex_m->lazy_regs ? eager_regs[i] : i];
+		retval = cortex_m_read_registers_batch(target, reg_list, num_fetch);
+		free(reg_list);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (i = 0; i < num_fetch; i++) {
+		int n = cortex_m->lazy_regs ? eager_regs[i] : i;
+		r = &armv7m->arm.core_cache->reg_list[n];
 		if (!r->valid)
-			arm->read_core_reg(target, r, i, ARM_MODE_ANY);
+			arm->read_core_reg(target, r, n, ARM_MODE_ANY);
 	}
 
 	r = arm->cpsr;
@@ -942,9 +1234,14 @@ static int cortex_m_step(struct target *target, int current,
 	if (bkpt_inst_found == false) {
 		if (cortex_m->isrmasking_mode != CORTEX_M_ISRMASK_AUTO) {
 			/* Automatic ISR masking mode off: Just step over the next
-			 * instruction, with interrupts on or off as appropriate. */
+			 * instruction, with interrupts on or off as appropriate.
+			 * The step runs along with the debug entry below, unless a
+			 * breakpoint at pc has to be set again right after it. */
 			cortex_m_set_maskints_for_step(target);
-			cortex_m_write_debug_halt_mask(target, C_STEP, C_HALT);
+			if (breakpoint)
+				cortex_m_write_debug_halt_mask(target, C_STEP, C_HALT);
+			else
+				cortex_m_queue_debug_halt_mask(target, C_STEP, C_HALT);
 		} else {
 			/* Process interrupts during stepping in a way they don't interfere
 			 * debugging.
@@ -982,10 +1279,10 @@ static int cortex_m_step(struct target *target, int current,
 			 */
 			if ((pc_value & 0x02) && breakpoint_find(target, pc_value & ~0x03)) {
 				LOG_DEBUG("Stepping over next instruction with interrupts disabled");
-				cortex_m_write_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
+				cortex_m_queue_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
 				cortex_m_write_debug_halt_mask(target, C_STEP, C_HALT);
 				/* Re-enable interrupts if appropriate */
-				cortex_m_write_debug_halt_mask(target, C_HALT, 0);
+				cortex_m_queue_debug_halt_mask(target, C_HALT, 0);
 				cortex_m_set_maskints_for_halt(target);
 			} else {
 
@@ -1008,26 +1305,22 @@ static int cortex_m_step(struct target *target, int current,
 					cortex_m_set_maskints_for_step(target);
 					cortex_m_write_debug_halt_mask(target, C_STEP, C_HALT);
 					/* Re-enable interrupts if appropriate */
-					cortex_m_write_debug_halt_mask(target, C_HALT, 0);
+					cortex_m_queue_debug_halt_mask(target, C_HALT, 0);
 					cortex_m_set_maskints_for_halt(target);
 				} else {
 					/* Start the core */
 					LOG_DEBUG("Starting core to serve pending interrupts");
-					int64_t t_start = timeval_ms();
 					cortex_m_set_maskints_for_run(target);
 					cortex_m_write_debug_halt_mask(target, 0, C_HALT | C_STEP);
 
 					/* Wait for pending handlers to complete or timeout */
-					do {
-						retval = mem_ap_read_atomic_u32(armv7m->debug_ap,
-								DCB_DHCSR,
-								&cortex_m->dcb_dhcsr);
-						if (retval != ERROR_OK) {
-							target->state = TARGET_UNKNOWN;
-							return retval;
-						}
-						isr_timed_out = ((timeval_ms() - t_start) > 500);
-					} while (!((cortex_m->dcb_dhcsr & S_HALT) || isr_timed_out));
+					retval = mem_ap_poll_atomic_u32(armv7m->debug_ap, DCB_DHCSR,
+							S_HALT, S_HALT, &cortex_m->dcb_dhcsr, 500);
+					isr_timed_out = retval == ERROR_TIMEOUT_REACHED;
+					if (retval != ERROR_OK && !isr_timed_out) {
+						target->state = TARGET_UNKNOWN;
+						return retval;
+					}
 
 					/* only remove breakpoint if we created it */
 					if (breakpoint)
@@ -1043,12 +1336,12 @@ static int cortex_m_step(struct target *target, int current,
 					} else {
 						/* Step over next instruction with interrupts disabled */
 						cortex_m_set_maskints_for_step(target);
-						cortex_m_write_debug_halt_mask(target,
+						cortex_m_queue_debug_halt_mask(target,
 							C_HALT | C_MASKINTS,
 							0);
 						cortex_m_write_debug_halt_mask(target, C_STEP, C_HALT);
 						/* Re-enable interrupts if appropriate */
-						cortex_m_write_debug_halt_mask(target, C_HALT, 0);
+						cortex_m_queue_debug_halt_mask(target, C_HALT, 0);
 						cortex_m_set_maskints_for_halt(target);
 					}
 				}
@@ -1056,9 +1349,8 @@ static int cortex_m_step(struct target *target, int current,
 		}
 	}
 
-	retval = mem_ap_read_atomic_u32(armv7m->debug_ap, DCB_DHCSR, &cortex_m->dcb_dhcsr);
-	if (retval != ERROR_OK)
-		return retval;
+	/* DHCSR is read by the debug entry, which also runs the queued
+	 * step, or was read while waiting for the interrupt handlers. */
 
 	/* registers are now invalid */
 	register_cache_invalidate(armv7m->arm.core_cache);
@@ -1073,10 +1365,6 @@ static int cortex_m_step(struct target *target, int current,
 		return ERROR_OK;
 	}
 
-	LOG_DEBUG("target stepped dcb_dhcsr = 0x%" PRIx32
-		" nvic_icsr = 0x%" PRIx32,
-		cortex_m->dcb_dhcsr, cortex_m->nvic_icsr);
-
 	retval = cortex_m_debug_entry(target);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1619,6 +1907,8 @@ static int cortex_m_load_core_reg_u32(struct target *target,
 	 * in the v7m header match the Cortex-M3 Debug Core Register
 	 * Selector values for R0..R15, xPSR, MSP, and PSP.
 	 */
+	target_to_cm(target)->regs_read++;
+
 	switch (num) {
 		case 0 ... 18:
 			/* read a normal core register */
@@ -1794,6 +2084,104 @@ static int cortex_m_read_memory(struct target *target, target_addr_t address,
 	return mem_ap_read_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+/**
+ * Reads every block of @a reads as a MEM-AP job, so that all of them go
+ * out in one DAP queue run. Each block uses the widest access its address
+ * and length are aligned to.
+ */
+static int cortex_m_read_buffer_batch(struct target *target,
+		struct target_read_request *reads, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct mem_ap_job *jobs = calloc(count, sizeof(*jobs));
+	unsigned int num_jobs = 0;
+
+	if (!jobs) {
+		LOG_ERROR("Out of memory");
+		for (unsigned int i = 0; i < count; i++)
+			reads[i].retval = ERROR_FAIL;
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct target_read_request *req = &reads[i];
+
+		if (req->size == 0)
+			continue;
+
+		uint32_t width = 4;
+		while (width > 1 && ((req->address | req->size) & (width - 1)))
+			width /= 2;
+
+		struct mem_ap_job *job = &jobs[num_jobs++];
+		job->ap = armv7m->debug_ap;
+		job->buffer = req->buffer;
+		job->size = width;
+		job->count = req->size / width;
+		job->address = req->address;
+	}
+
+	int retval = mem_ap_run_jobs(jobs, num_jobs);
+
+	num_jobs = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (reads[i].size > 0)
+			reads[i].retval = jobs[num_jobs++].retval;
+	}
+	free(jobs);
+
+	return retval;
+}
+
+/* one write job per target, the DAP of several targets sharing one runs
+ * all their writes in one queue run */
+static int cortex_m_write_buffer_multi(struct target **targets, unsigned int count,
+		target_addr_t address, uint32_t size, const uint8_t *buffer, int *retvals)
+{
+	/* no alignment fixups, these go through target_write_buffer() */
+	if ((address | size) & 3)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	struct mem_ap_job *jobs = calloc(count, sizeof(*jobs));
+	if (!jobs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct mem_ap_job *job = &jobs[i];
+
+		job->ap = target_to_armv7m(targets[i])->debug_ap;
+		job->write = true;
+		job->buffer = (uint8_t *)buffer;
+		job->size = 4;
+		job->count = size / 4;
+		job->address = address;
+	}
+
+	int retval = mem_ap_run_jobs(jobs, count);
+
+	for (unsigned int i = 0; i < count; i++)
+		retvals[i] = jobs[i].retval;
+	free(jobs);
+
+	return retval;
+}
+
+/* only offloaded to the adapter, the host side loop of target_poll_u32()
+ * sleeps between the reads */
+static int cortex_m_poll_u32(struct target *target, target_addr_t address,
+		uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_ap *ap = armv7m->debug_ap;
+
+	if (ap->dap->ops->queue_ap_read_match == NULL || (address & 3))
+		return ERROR_NOT_IMPLEMENTED;
+
+	return mem_ap_poll_atomic_u32(ap, address, mask, match, value, timeout_ms);
+}
+
 static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
@@ -1822,6 +2210,7 @@ void cortex_m_deinit_target(struct target *target)
 
 	free(cortex_m->fp_comparator_list);
 
+	itm_decode_free(target);
 	cortex_m_dwt_free(target);
 	armv7m_free_reg_cache(target);
 
@@ -1829,6 +2218,49 @@ void cortex_m_deinit_target(struct target *target)
 	free(cortex_m);
 }
 
+/* collect the DWT PC samples of the decoded trace, see "itm decode" */
+static int cortex_m_profiling_trace(struct target *target, uint32_t *samples,
+			      uint32_t max_num_samples, uint32_t *num_samples,
+			      const struct timeval *timeout)
+{
+	struct timeval first, now;
+	uint32_t sample_count = 0;
+	int retval = ERROR_OK;
+
+	if (!itm_decode_collect_pc(target, true))
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	target_poll(target);
+	if (target->state == TARGET_HALTED)
+		retval = target_resume(target, 1, 0, 0, 0);
+
+	gettimeofday(&first, NULL);
+	timeval_add_time(&first, 1, 0);
+
+	while (retval == ERROR_OK && sample_count < max_num_samples) {
+		retval = armv7m_trace_poll(target);
+		sample_count += itm_decode_take_pc(target, samples + sample_count,
+				max_num_samples - sample_count);
+
+		gettimeofday(&now, NULL);
+		if (timeval_compare(&now, timeout) > 0)
+			break;
+		if (!sample_count && timeval_compare(&now, &first) > 0) {
+			LOG_INFO("No PC samples in the trace, is DWT_CTRL.PCSAMPLENA set?");
+			retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+			break;
+		}
+		keep_alive();
+	}
+
+	itm_decode_collect_pc(target, false);
+	if (retval == ERROR_OK)
+		LOG_INFO("Profiling completed. %" PRIu32 " samples.", sample_count);
+
+	*num_samples = sample_count;
+	return retval;
+}
+
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
@@ -1842,6 +2274,14 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 	gettimeofday(&timeout, NULL);
 	timeval_add_time(&timeout, seconds, 0);
 
+	if (armv7m->trace_config.itm_decoder) {
+		LOG_INFO("Starting Cortex-M profiling. Collecting the PC samples of the trace...");
+		retval = cortex_m_profiling_trace(target, samples, max_num_samples,
+				num_samples, &timeout);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
 	retval = target_read_u32(target, DWT_PCSR, &reg_value);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Error while reading PCSR");
@@ -2253,10 +2693,10 @@ int cortex_m_examine(struct target *target)
 			if (i == 3 || i == 4)
 				/* Cortex-M3/M4 have 4096 bytes autoincrement range,
 				 * s. ARM IHI 0031C: MEM-AP 7.2.2 */
-				armv7m->debug_ap->tar_autoincr_block = (1 << 12);
+				mem_ap_set_tar_autoincr_block(armv7m->debug_ap, 1 << 12);
 			else if (i == 7)
 				/* Cortex-M7 has only 1024 bytes autoincrement range */
-				armv7m->debug_ap->tar_autoincr_block = (1 << 10);
+				mem_ap_set_tar_autoincr_block(armv7m->debug_ap, 1 << 10);
 		}
 
 		/* Enable debug requests */
@@ -2379,7 +2819,7 @@ static int cortex_m_handle_target_request(void *priv)
 	if (!target->dbg_msg_enabled)
 		return ERROR_OK;
 
-	if (target->state == TARGET_RUNNING) {
+	if (target->state == TARGET_RUNNING && target_request_poll_due(target)) {
 		uint8_t data;
 		uint8_t ctrl;
 		int retval;
@@ -2388,6 +2828,8 @@ static int cortex_m_handle_target_request(void *priv)
 		if (retval != ERROR_OK)
 			return retval;
 
+		target_request_polled(target, ctrl & (1 << 0));
+
 		/* check if we have data */
 		if (ctrl & (1 << 0)) {
 			uint32_t request;
@@ -2417,6 +2859,7 @@ static int cortex_m_init_arch_info(struct target *target,
 	/* default reset mode is to use srst if fitted
 	 * if not it will use CORTEX_M3_RESET_VECTRESET */
 	cortex_m->soft_reset_config = CORTEX_M_RESET_VECTRESET;
+	cortex_m->lazy_regs = true;
 
 	armv7m->arm.dap = dap;
 
@@ -2649,6 +3092,38 @@ COMMAND_HANDLER(handle_cortex_m_reset_config_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_m_lazy_regs_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	int retval;
+
+	retval = cortex_m_verify_pointer(CMD, cortex_m);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "reset")) {
+			cortex_m->halt_count = 0;
+			cortex_m->regs_read = 0;
+		} else {
+			COMMAND_PARSE_ON_OFF(CMD_ARGV[0], cortex_m->lazy_regs);
+		}
+	}
+
+	command_print(CMD, "cortex_m lazy_regs %s: %u halts, %u register reads",
+			cortex_m->lazy_regs ? "on" : "off",
+			cortex_m->halt_count, cortex_m->regs_read);
+	if (cortex_m->halt_count)
+		command_print(CMD, "%.1f register reads per halt",
+				(double)cortex_m->regs_read / cortex_m->halt_count);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_m_exec_command_handlers[] = {
 	{
 		.name = "maskisr",
@@ -2671,6 +3146,14 @@ static const struct command_registration cortex_m_exec_command_handlers[] = {
 		.help = "configure software reset handling",
 		.usage = "['sysresetreq'|'vectreset']",
 	},
+	{
+		.name = "lazy_regs",
+		.handler = handle_cortex_m_lazy_regs_command,
+		.mode = COMMAND_ANY,
+		.help = "read only a minimal register set on debug entry, "
+			"and show how many registers were read",
+		.usage = "['on'|'off'|'reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 static const struct command_registration cortex_m_command_handlers[] = {
@@ -2709,11 +3192,19 @@ struct target_type cortexm_target = {
 
 	.get_gdb_arch = arm_get_gdb_arch,
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
+	.read_registers_batch = cortex_m_read_registers_batch,
+	.write_registers_batch = cortex_m_write_registers_batch,
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.read_buffer_batch = cortex_m_read_buffer_batch,
+	.write_buffer_multi = cortex_m_write_buffer_multi,
+	.poll_u32 = cortex_m_poll_u32,
 	.checksum_memory = armv7m_checksum_memory,
+	.checksum_memory_blocks = armv7m_checksum_memory_blocks,
+	.mem_pattern = armv7m_mem_pattern,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.stack_check_memory = armv7m_stack_check_memory,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
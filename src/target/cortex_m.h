@@ -219,6 +219,12 @@ struct cortex_m_common {
 	/* Whether this target has the erratum that makes C_MASKINTS not apply to
 	 * already pending interrupts */
 	bool maskints_erratum;
+
+	/* Only read a minimal register set on debug entry, the rest on demand */
+	bool lazy_regs;
+	/* statistics for "cortex_m lazy_regs" */
+	unsigned int halt_count;
+	unsigned int regs_read;
 };
 
 static inline struct cortex_m_common *
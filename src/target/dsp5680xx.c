@@ -1128,43 +1128,42 @@ static int dsp5680xx_read_16_single(struct target *t, uint32_t a,
 	return retval;
 }
 
-static int dsp5680xx_read_32_single(struct target *t, uint32_t a,
-				    uint8_t *data_read, int r_pmem)
+/*
+ * Reads @words 16 bit words starting at @address. r0 walks the memory and
+ * r2 stays on the EOnCE TX/RX register, so each word only costs one move
+ * into y0, one move to TX/RX and the read of OTX. The scans are queued and
+ * the queue is executed every FLUSH_COUNT_READ_WRITE words.
+ */
+static int dsp5680xx_read_block(struct target *target, uint32_t address,
+				uint8_t *buffer, uint32_t words, int pmem)
 {
-	struct target *target = t;
-
-	uint32_t address = a;
-
 	int retval;
 
-	address = (address & 0xFFFFF);
-	/* Get data to an intermediate register */
+	int counter = FLUSH_COUNT_READ_WRITE;
+
 	retval = core_move_long_to_r0(target, address);
 	err_check_propagate(retval);
-	if (r_pmem) {
-		retval = core_move_at_pr0_inc_to_y0(target);
-		err_check_propagate(retval);
-		retval = core_move_at_pr0_inc_to_y1(target);
+	retval = core_move_long_to_r2(target,
+				      ((MC568013_EONCE_TX_RX_ADDR) +
+				       (MC568013_EONCE_OBASE_ADDR << 16)));
+	err_check_propagate(retval);
+
+	for (uint32_t i = 0; i < words; i++) {
+		if (--counter == 0) {
+			dsp5680xx_context.flush = 1;
+			counter = FLUSH_COUNT_READ_WRITE;
+		}
+		if (pmem)
+			retval = core_move_at_pr0_inc_to_y0(target);
+		else
+			retval = core_move_at_r0_inc_to_y0(target);
 		err_check_propagate(retval);
-	} else {
-		retval = core_move_at_r0_inc_to_y0(target);
+		retval = core_move_y0_at_r2(target);
 		err_check_propagate(retval);
-		retval = core_move_at_r0_to_y1(target);
+		retval = core_rx_lower_data(target, buffer + 2 * i);
 		err_check_propagate(retval);
+		dsp5680xx_context.flush = 0;
 	}
-	/* Get lower part of data to TX/RX */
-	retval = eonce_load_TX_RX_to_r0(target);
-	err_check_propagate(retval);
-	retval = core_move_y0_at_r0_inc(target);    /* This also load TX/RX high to r0 */
-	err_check_propagate(retval);
-	/* Get upper part of data to TX/RX */
-	retval = core_move_y1_at_r0(target);
-	err_check_propagate(retval);
-	/* at this point the data i want is at the reg eonce can read */
-	retval = core_rx_lower_data(target, data_read);
-	err_check_propagate(retval);
-	retval = core_rx_upper_data(target, data_read + 2);
-	err_check_propagate(retval);
 	return retval;
 }
 
@@ -1187,38 +1186,36 @@ static int dsp5680xx_read(struct target *t, target_addr_t a, uint32_t size,
 	err_check_propagate(retval);
 
 	dsp5680xx_context.flush = 0;
-	int counter = FLUSH_COUNT_READ_WRITE;
 
-	for (unsigned i = 0; i < count; i++) {
-		if (--counter == 0) {
-			dsp5680xx_context.flush = 1;
-			counter = FLUSH_COUNT_READ_WRITE;
-		}
-		switch (size) {
-		case 1:
-			if (!(i % 2))
-				retval =
-					dsp5680xx_read_16_single(target,
-								 address + i / 2,
-								 buffer + i, pmem);
-			break;
-		case 2:
-			retval =
-				dsp5680xx_read_16_single(target, address + i,
-							 buffer + 2 * i, pmem);
-			break;
-		case 4:
-			retval =
-				dsp5680xx_read_32_single(target, address + 2 * i,
-							 buffer + 4 * i, pmem);
-			break;
-		default:
-			LOG_USER("%s: Invalid read size.", __func__);
-			break;
+	switch (size) {
+	case 1:
+		retval = dsp5680xx_read_block(target, address, buffer, count / 2, pmem);
+		if (retval == ERROR_OK && (count % 2)) {
+			/* memory is 16 bit, only keep the low byte of the last word */
+			uint8_t last[2];
+
+			retval = dsp5680xx_read_16_single(target, address + count / 2,
+							  last, pmem);
+			if (retval == ERROR_OK) {
+				dsp5680xx_context.flush = 1;
+				retval = dsp5680xx_execute_queue();
+				buffer[count - 1] = last[0];
+			}
 		}
-		err_check_propagate(retval);
-		dsp5680xx_context.flush = 0;
+		break;
+	case 2:
+		retval = dsp5680xx_read_block(target, address, buffer, count, pmem);
+		break;
+	case 4:
+		retval = dsp5680xx_read_block(target, address, buffer, 2 * count, pmem);
+		break;
+	default:
+		LOG_USER("%s: Invalid read size.", __func__);
+		break;
 	}
+	if (retval != ERROR_OK)
+		dsp5680xx_context.flush = 1;
+	err_check_propagate(retval);
 
 	dsp5680xx_context.flush = 1;
 	retval = dsp5680xx_execute_queue();
@@ -1250,29 +1247,45 @@ static int dsp5680xx_write_16_single(struct target *t, uint32_t a,
 	return retval;
 }
 
-static int dsp5680xx_write_32_single(struct target *t, uint32_t a,
-				     uint32_t data, int w_pmem)
+/*
+ * Writes @words 16 bit little endian words of @data starting at @address.
+ * r0 is loaded once and post-incremented by the stores, so each word only
+ * costs a move of the value to y0 and its store. As for the reads the scans
+ * are queued and executed every FLUSH_COUNT_READ_WRITE words.
+ */
+static int dsp5680xx_write_block(struct target *target, uint32_t address,
+				 const uint8_t *data, uint32_t words, int pmem)
 {
-	struct target *target = t;
-
-	uint32_t address = a;
+	int retval;
 
-	int retval = ERROR_OK;
+	int counter = FLUSH_COUNT_READ_WRITE;
 
 	retval = core_move_long_to_r0(target, address);
 	err_check_propagate(retval);
-	retval = core_move_long_to_y(target, data);
-	err_check_propagate(retval);
-	if (w_pmem)
-		retval = core_move_y0_at_pr0_inc(target);
-	else
-		retval = core_move_y0_at_r0_inc(target);
-	err_check_propagate(retval);
-	if (w_pmem)
-		retval = core_move_y1_at_pr0_inc(target);
-	else
-		retval = core_move_y1_at_r0_inc(target);
-	err_check_propagate(retval);
+
+	for (uint32_t i = 0; i < words; i++) {
+		if (--counter == 0) {
+			dsp5680xx_context.flush = 1;
+			counter = FLUSH_COUNT_READ_WRITE;
+		}
+		uint16_t value = data[2 * i] | (data[2 * i + 1] << 8);
+
+		retval = core_move_value_to_y0(target, value);
+		if (retval == ERROR_OK) {
+			if (pmem)
+				retval = core_move_y0_at_pr0_inc(target);
+			else
+				retval = core_move_y0_at_r0_inc(target);
+		}
+		if (retval != ERROR_OK) {
+			LOG_ERROR("%s: Could not write to p:0x%04" PRIX32, __func__,
+				  address + i);
+			dsp5680xx_context.flush = 1;
+			return retval;
+		}
+		dsp5680xx_context.flush = 0;
+	}
+	dsp5680xx_context.flush = 1;
 	return retval;
 }
 
@@ -1287,32 +1300,12 @@ static int dsp5680xx_write_8(struct target *t, uint32_t a, uint32_t c,
 
 	const uint8_t *data = d;
 
-	int retval = 0;
-
-	uint16_t data_16;
+	int retval;
 
-	uint32_t iter;
+	uint32_t iter = count / 2;
 
-	int counter = FLUSH_COUNT_READ_WRITE;
-
-	for (iter = 0; iter < count / 2; iter++) {
-		if (--counter == 0) {
-			dsp5680xx_context.flush = 1;
-			counter = FLUSH_COUNT_READ_WRITE;
-		}
-		data_16 = (data[2 * iter] | (data[2 * iter + 1] << 8));
-		retval =
-			dsp5680xx_write_16_single(target, address + iter, data_16,
-						  pmem);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("%s: Could not write to p:0x%04" PRIX32, __func__,
-				  address);
-			dsp5680xx_context.flush = 1;
-			return retval;
-		}
-		dsp5680xx_context.flush = 0;
-	}
-	dsp5680xx_context.flush = 1;
+	retval = dsp5680xx_write_block(target, address, data, iter, pmem);
+	err_check_propagate(retval);
 
 	/* Only one byte left, let's not overwrite the other byte (mem is 16bit) */
 	/* Need to retrieve the part we do not want to overwrite. */
@@ -1320,14 +1313,10 @@ static int dsp5680xx_write_8(struct target *t, uint32_t a, uint32_t c,
 
 	if ((count == 1) || (count % 2)) {
 		retval =
-			dsp5680xx_read(target, address + iter, 1, 1,
+			dsp5680xx_read(target, address + iter, 2, 1,
 				       (uint8_t *) &data_old);
 		err_check_propagate(retval);
-		if (count == 1)
-			data_old = (((data_old & 0xff) << 8) | data[0]); /* preserve upper byte */
-		else
-			data_old =
-				(((data_old & 0xff) << 8) | data[2 * iter + 1]);
+		data_old = (((data_old & 0xff) << 8) | data[count - 1]); /* preserve upper byte */
 		retval =
 			dsp5680xx_write_16_single(target, address + iter, data_old,
 						  pmem);
@@ -1339,75 +1328,14 @@ static int dsp5680xx_write_8(struct target *t, uint32_t a, uint32_t c,
 static int dsp5680xx_write_16(struct target *t, uint32_t a, uint32_t c,
 			      const uint8_t *d, int pmem)
 {
-	struct target *target = t;
-
-	uint32_t address = a;
-
-	uint32_t count = c;
-
-	const uint8_t *data = d;
-
-	int retval = ERROR_OK;
-
-	uint32_t iter;
-
-	int counter = FLUSH_COUNT_READ_WRITE;
-
-	for (iter = 0; iter < count; iter++) {
-		if (--counter == 0) {
-			dsp5680xx_context.flush = 1;
-			counter = FLUSH_COUNT_READ_WRITE;
-		}
-		retval =
-			dsp5680xx_write_16_single(target, address + iter,
-						  data[iter], pmem);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("%s: Could not write to p:0x%04" PRIX32, __func__,
-				  address);
-			dsp5680xx_context.flush = 1;
-			return retval;
-		}
-		dsp5680xx_context.flush = 0;
-	}
-	dsp5680xx_context.flush = 1;
-	return retval;
+	return dsp5680xx_write_block(t, a, d, c, pmem);
 }
 
 static int dsp5680xx_write_32(struct target *t, uint32_t a, uint32_t c,
 			      const uint8_t *d, int pmem)
 {
-	struct target *target = t;
-
-	uint32_t address = a;
-
-	uint32_t count = c;
-
-	const uint8_t *data = d;
-
-	int retval = ERROR_OK;
-
-	uint32_t iter;
-
-	int counter = FLUSH_COUNT_READ_WRITE;
-
-	for (iter = 0; iter < count; iter++) {
-		if (--counter == 0) {
-			dsp5680xx_context.flush = 1;
-			counter = FLUSH_COUNT_READ_WRITE;
-		}
-		retval =
-			dsp5680xx_write_32_single(target, address + (iter << 1),
-						  data[iter], pmem);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("%s: Could not write to p:0x%04" PRIX32, __func__,
-				  address);
-			dsp5680xx_context.flush = 1;
-			return retval;
-		}
-		dsp5680xx_context.flush = 0;
-	}
-	dsp5680xx_context.flush = 1;
-	return retval;
+	/* low word first, as move.l #value, y followed by y0 and y1 stores */
+	return dsp5680xx_write_block(t, a, d, 2 * c, pmem);
 }
 
 /**
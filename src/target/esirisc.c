@@ -370,6 +370,15 @@ static int esirisc_read_memory(struct target *target, target_addr_t address,
 
 	LOG_DEBUG("-");
 
+	/* blocks of words are batched in as few JTAG queues as possible */
+	if (size == sizeof(uint32_t) && count > 1) {
+		retval = esirisc_jtag_read_words(jtag_info, address, count, buffer);
+		if (retval != ERROR_OK)
+			LOG_ERROR("%s: failed to read address: 0x%" TARGET_PRIxADDR, target_name(target),
+					address);
+		return retval;
+	}
+
 	int num_bits = 8 * size;
 	for (uint32_t i = 0; i < count; ++i) {
 		union esirisc_memory value;
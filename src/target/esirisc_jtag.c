@@ -109,7 +109,7 @@ static void esirisc_jtag_unstuff(uint8_t *data, size_t len)
  * corrupted at the expense of sending additional padding bits.
  */
 
-static int esirisc_jtag_send(struct esirisc_jtag *jtag_info, uint8_t command,
+static void esirisc_jtag_queue_send(struct esirisc_jtag *jtag_info, uint8_t command,
 		int num_out_fields, struct scan_field *out_fields)
 {
 	int num_fields = 2 + num_out_fields;
@@ -130,18 +130,25 @@ static int esirisc_jtag_send(struct esirisc_jtag *jtag_info, uint8_t command,
 		jtag_scan_field_clone(&fields[2+i], &out_fields[i]);
 
 	jtag_add_dr_scan(jtag_info->tap, num_fields, fields, TAP_IDLE);
+}
+
+static int esirisc_jtag_send(struct esirisc_jtag *jtag_info, uint8_t command,
+		int num_out_fields, struct scan_field *out_fields)
+{
+	esirisc_jtag_queue_send(jtag_info, command, num_out_fields, out_fields);
 
 	return jtag_execute_queue();
 }
 
-static int esirisc_jtag_recv(struct esirisc_jtag *jtag_info,
-		int num_in_fields, struct scan_field *in_fields)
+/*
+ * Queues the receive of a response of num_in_bits; the status byte and the
+ * (still stuffed) response data are captured to status and r once the
+ * queue is executed. r must hold num_in_bits * 2 bits.
+ */
+static void esirisc_jtag_queue_recv(struct esirisc_jtag *jtag_info, int num_in_bits,
+		uint8_t *status, uint8_t *r)
 {
-	int num_in_bits = esirisc_jtag_count_bits(num_in_fields, in_fields);
-	int num_in_bytes = DIV_ROUND_UP(num_in_bits, 8);
-
 	struct scan_field fields[3];
-	uint8_t r[num_in_bytes * 2];
 
 	esirisc_jtag_set_instr(jtag_info, INSTR_DEBUG);
 
@@ -151,13 +158,24 @@ static int esirisc_jtag_recv(struct esirisc_jtag *jtag_info,
 
 	fields[1].num_bits = 8;
 	fields[1].out_value = NULL;
-	fields[1].in_value = &jtag_info->status;
+	fields[1].in_value = status;
 
 	fields[2].num_bits = num_in_bits * 2;
 	fields[2].out_value = NULL;
 	fields[2].in_value = r;
 
 	jtag_add_dr_scan(jtag_info->tap, ARRAY_SIZE(fields), fields, TAP_IDLE);
+}
+
+static int esirisc_jtag_recv(struct esirisc_jtag *jtag_info,
+		int num_in_fields, struct scan_field *in_fields)
+{
+	int num_in_bits = esirisc_jtag_count_bits(num_in_fields, in_fields);
+	int num_in_bytes = DIV_ROUND_UP(num_in_bits, 8);
+
+	uint8_t r[num_in_bytes * 2];
+
+	esirisc_jtag_queue_recv(jtag_info, num_in_bits, &jtag_info->status, r);
 
 	int retval = jtag_execute_queue();
 	if (retval != ERROR_OK)
@@ -326,6 +344,61 @@ int esirisc_jtag_read_word(struct esirisc_jtag *jtag_info, uint32_t address, uin
 	return ERROR_OK;
 }
 
+/*
+ * Reads count words starting at address, the word commands and their
+ * responses of up to ESIRISC_JTAG_BATCH words are queued and executed at
+ * once. Words are stored to buffer in the little-endian order of the
+ * responses.
+ */
+int esirisc_jtag_read_words(struct esirisc_jtag *jtag_info, uint32_t address,
+		uint32_t count, uint8_t *buffer)
+{
+	uint8_t status[ESIRISC_JTAG_BATCH];
+	uint8_t r[ESIRISC_JTAG_BATCH][4 * 2];
+
+	while (count > 0) {
+		uint32_t batch = MIN(count, ESIRISC_JTAG_BATCH);
+
+		for (uint32_t i = 0; i < batch; ++i) {
+			struct scan_field out_fields[1];
+			uint8_t a[4];
+
+			out_fields[0].num_bits = 32;
+			out_fields[0].out_value = a;
+			h_u32_to_be(a, address + 4 * i);
+			out_fields[0].in_value = NULL;
+
+			/* out values are copied when queued */
+			esirisc_jtag_queue_send(jtag_info, DEBUG_READ_WORD,
+					ARRAY_SIZE(out_fields), out_fields);
+			esirisc_jtag_queue_recv(jtag_info, 32, &status[i], r[i]);
+		}
+
+		int retval = jtag_execute_queue();
+		if (retval != ERROR_OK) {
+			LOG_ERROR("esirisc_jtag: read of %" PRIu32 " words at 0x%" PRIx32 " failed",
+					batch, address);
+			return ERROR_FAIL;
+		}
+
+		for (uint32_t i = 0; i < batch; ++i) {
+			jtag_info->status = status[i];
+			retval = esirisc_jtag_check_status(jtag_info);
+			if (retval != ERROR_OK)
+				return retval;
+
+			esirisc_jtag_unstuff(r[i], sizeof(r[i]));
+			memcpy(buffer, r[i], 4);
+			buffer += 4;
+		}
+
+		address += 4 * batch;
+		count -= batch;
+	}
+
+	return ERROR_OK;
+}
+
 int esirisc_jtag_write_byte(struct esirisc_jtag *jtag_info, uint32_t address, uint8_t data)
 {
 	struct scan_field out_fields[2];
@@ -58,6 +58,9 @@
 #define STUFF_MARKER			0x55
 #define PAD_BYTE				0xaa
 
+/* Words read per JTAG queue by esirisc_jtag_read_words() */
+#define ESIRISC_JTAG_BATCH		64
+
 struct esirisc_jtag {
 	struct jtag_tap *tap;
 	uint8_t status;
@@ -73,6 +76,8 @@ int esirisc_jtag_read_hword(struct esirisc_jtag *jtag_info,
 		uint32_t address, uint16_t *data);
 int esirisc_jtag_read_word(struct esirisc_jtag *jtag_info,
 		uint32_t address, uint32_t *data);
+int esirisc_jtag_read_words(struct esirisc_jtag *jtag_info,
+		uint32_t address, uint32_t count, uint8_t *buffer);
 
 int esirisc_jtag_write_byte(struct esirisc_jtag *jtag_info,
 		uint32_t address, uint8_t data);
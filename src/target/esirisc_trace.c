@@ -23,8 +23,10 @@
 #include <helper/binarybuffer.h>
 #include <helper/command.h>
 #include <helper/fileio.h>
+#include <helper/list.h>
 #include <helper/log.h>
 #include <helper/types.h>
+#include <server/server.h>
 #include <target/target.h>
 
 #include "esirisc.h"
@@ -51,6 +53,29 @@
 #define TRIGGER_TSP(x)		(((x) << 8) & 0xf00)	/* Trigger Stop */
 #define TRIGGER_DSP			(1<<15)					/* Delay Start */
 
+#define STREAM_DEFAULT_INTERVAL_MS	10
+
+struct esirisc_trace_connection {
+	struct list_head list;
+	struct connection *connection;
+};
+
+struct esirisc_trace_stream {
+	struct target *target;
+	FILE *file;
+	char *tcp_port;
+	struct list_head connections;
+
+	uint32_t last;			/* BufferCurrent at the previous drain */
+	uint64_t bytes;
+	uint8_t *buffer;
+};
+
+/* the priv of the stream's service, freed by remove_service() */
+struct esirisc_trace_service {
+	struct esirisc_trace_stream *stream;
+};
+
 static const char * const esirisc_trace_delay_strings[] = {
 	"none", "start", "stop", "both",
 };
@@ -670,6 +695,159 @@ done:
 	return retval;
 }
 
+static void esirisc_trace_stream_write(struct esirisc_trace_stream *stream,
+		const uint8_t *data, size_t len)
+{
+	struct esirisc_trace_connection *entry;
+
+	if (stream->file) {
+		if (fwrite(data, 1, len, stream->file) != len || fflush(stream->file) != 0) {
+			LOG_ERROR("esirisc: write to the trace stream file failed, closing it");
+			fclose(stream->file);
+			stream->file = NULL;
+		}
+	}
+
+	list_for_each_entry(entry, &stream->connections, list)
+		connection_write(entry->connection, data, len);
+
+	stream->bytes += len;
+}
+
+static int esirisc_trace_stream_drain(struct esirisc_trace_stream *stream,
+		uint32_t address, uint32_t size)
+{
+	struct esirisc_common *esirisc = target_to_esirisc(stream->target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+
+	if (size == 0)
+		return ERROR_OK;
+
+	int retval = esirisc_jtag_read_words(jtag_info, address, size / 4, stream->buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("%s: failed to read trace data", target_name(stream->target));
+		return retval;
+	}
+
+	esirisc_trace_stream_write(stream, stream->buffer, size);
+	return ERROR_OK;
+}
+
+/*
+ * Copies what the core traced since the previous call, from the previous
+ * BufferCurrent to the current one. The buffer must wrap and be drained
+ * before the core laps it, or the lapped data is lost.
+ */
+static int esirisc_trace_stream_poll(void *priv)
+{
+	struct esirisc_trace_stream *stream = priv;
+	struct target *target = stream->target;
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	uint32_t buffer_cur;
+	int retval;
+
+	if (target->state != TARGET_RUNNING && target->state != TARGET_HALTED)
+		return ERROR_OK;
+
+	retval = esirisc_jtag_read_csr(jtag_info, CSR_TRACE, CSR_TRACE_BUFFER_CUR, &buffer_cur);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("%s: failed to read Trace CSR: BufferCurrent", target_name(target));
+		return retval;
+	}
+
+	/* whole words only, the rest comes with the next drain */
+	buffer_cur &= ~3u;
+	if (buffer_cur == stream->last)
+		return ERROR_OK;
+
+	if (buffer_cur < trace_info->buffer_start || buffer_cur > trace_info->buffer_end) {
+		LOG_ERROR("%s: BufferCurrent 0x%08" PRIx32 " is outside of the trace buffer",
+				target_name(target), buffer_cur);
+		return ERROR_FAIL;
+	}
+
+	if (buffer_cur < stream->last) {
+		/* wrapped, the end of the buffer comes first */
+		retval = esirisc_trace_stream_drain(stream, stream->last,
+				trace_info->buffer_end - stream->last);
+		if (retval != ERROR_OK)
+			return retval;
+		stream->last = trace_info->buffer_start;
+	}
+
+	retval = esirisc_trace_stream_drain(stream, stream->last, buffer_cur - stream->last);
+	if (retval != ERROR_OK)
+		return retval;
+	stream->last = buffer_cur;
+
+	return ERROR_OK;
+}
+
+static int esirisc_trace_new_connection(struct connection *connection)
+{
+	struct esirisc_trace_service *service = connection->service->priv;
+	struct esirisc_trace_connection *entry = malloc(sizeof(*entry));
+
+	if (entry == NULL)
+		return ERROR_FAIL;
+
+	entry->connection = connection;
+	list_add_tail(&entry->list, &service->stream->connections);
+	return ERROR_OK;
+}
+
+static int esirisc_trace_input(struct connection *connection)
+{
+	uint8_t buffer[64];
+
+	/* nothing goes to the target, only notice the closed connections */
+	int bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	if (bytes_read < 0) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+	return ERROR_OK;
+}
+
+static int esirisc_trace_connection_closed(struct connection *connection)
+{
+	struct esirisc_trace_service *service = connection->service->priv;
+	struct esirisc_trace_connection *entry;
+
+	list_for_each_entry(entry, &service->stream->connections, list) {
+		if (entry->connection == connection) {
+			list_del(&entry->list);
+			free(entry);
+			break;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static void esirisc_trace_stream_free(struct esirisc_trace *trace_info)
+{
+	struct esirisc_trace_stream *stream = trace_info->stream;
+
+	if (stream == NULL)
+		return;
+
+	target_unregister_timer_callback(esirisc_trace_stream_poll, stream);
+	if (stream->file)
+		fclose(stream->file);
+	if (stream->tcp_port) {
+		remove_service("esirisc_trace", stream->tcp_port);
+		free(stream->tcp_port);
+	}
+	free(stream->buffer);
+	free(stream);
+	trace_info->stream = NULL;
+}
+
 COMMAND_HANDLER(handle_esirisc_trace_init_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -862,6 +1040,133 @@ COMMAND_HANDLER(handle_esirisc_trace_dump_command)
 	}
 }
 
+COMMAND_HANDLER(handle_esirisc_trace_stream_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct esirisc_common *esirisc = target_to_esirisc(target);
+	struct esirisc_jtag *jtag_info = &esirisc->jtag_info;
+	struct esirisc_trace *trace_info = &esirisc->trace_info;
+	struct esirisc_trace_stream *stream;
+	unsigned int interval_ms = STREAM_DEFAULT_INTERVAL_MS;
+	uint32_t buffer_cur;
+
+	if (!esirisc->has_trace) {
+		command_print(CMD, "target does not support trace");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		if (trace_info->stream)
+			command_print(CMD, "trace streaming is on, %" PRIu64 " bytes streamed",
+					trace_info->stream->bytes);
+		else
+			command_print(CMD, "trace streaming is off");
+		return ERROR_OK;
+	}
+
+	if (strcmp(CMD_ARGV[0], "off") == 0) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		esirisc_trace_stream_free(trace_info);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC < 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], interval_ms);
+		if (interval_ms == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	/* also see: handle_esirisc_trace_analyze_command() */
+	if (esirisc_trace_is_fifo(trace_info)) {
+		command_print(CMD, "stream from FIFO not supported");
+		return ERROR_FAIL;
+	}
+
+	if (trace_info->buffer_start % 4 || esirisc_trace_buffer_size(trace_info) % 4) {
+		command_print(CMD, "trace buffer must be word aligned to be streamed");
+		return ERROR_FAIL;
+	}
+
+	int retval = esirisc_jtag_read_csr(jtag_info, CSR_TRACE, CSR_TRACE_BUFFER_CUR, &buffer_cur);
+	if (retval != ERROR_OK) {
+		command_print(CMD, "failed to read Trace CSR: BufferCurrent");
+		return retval;
+	}
+
+	esirisc_trace_stream_free(trace_info);
+
+	stream = calloc(1, sizeof(*stream));
+	if (stream == NULL) {
+		command_print(CMD, "out of memory");
+		return ERROR_FAIL;
+	}
+	INIT_LIST_HEAD(&stream->connections);
+	stream->target = target;
+	stream->last = buffer_cur & ~3u;
+
+	stream->buffer = malloc(esirisc_trace_buffer_size(trace_info));
+	if (stream->buffer == NULL) {
+		command_print(CMD, "out of memory");
+		free(stream);
+		return ERROR_FAIL;
+	}
+
+	if (strcmp(CMD_ARGV[0], "file") == 0) {
+		stream->file = fopen(CMD_ARGV[1], "ab");
+		if (stream->file == NULL) {
+			command_print(CMD, "can't open %s: %s", CMD_ARGV[1], strerror(errno));
+			retval = ERROR_FAIL;
+			goto fail;
+		}
+	} else if (strcmp(CMD_ARGV[0], "tcp") == 0) {
+		struct esirisc_trace_service *service = malloc(sizeof(*service));
+		if (service == NULL) {
+			command_print(CMD, "out of memory");
+			retval = ERROR_FAIL;
+			goto fail;
+		}
+		service->stream = stream;
+
+		if (add_service("esirisc_trace", CMD_ARGV[1], CONNECTION_LIMIT_UNLIMITED,
+					esirisc_trace_new_connection, esirisc_trace_input,
+					esirisc_trace_connection_closed, service) != ERROR_OK) {
+			command_print(CMD, "can't serve the trace on %s", CMD_ARGV[1]);
+			free(service);
+			retval = ERROR_FAIL;
+			goto fail;
+		}
+		stream->tcp_port = strdup(CMD_ARGV[1]);
+	} else {
+		retval = ERROR_COMMAND_SYNTAX_ERROR;
+		goto fail;
+	}
+
+	retval = target_register_timer_callback(esirisc_trace_stream_poll, interval_ms,
+			TARGET_TIMER_TYPE_PERIODIC, stream);
+	if (retval != ERROR_OK)
+		goto fail;
+
+	trace_info->stream = stream;
+
+	if (!trace_info->buffer_wrap)
+		command_print(CMD, "trace buffer does not wrap, trace stops once it is full");
+	command_print(CMD, "trace streamed every %u ms", interval_ms);
+
+	return ERROR_OK;
+
+fail:
+	trace_info->stream = stream;
+	esirisc_trace_stream_free(trace_info);
+	return retval;
+}
+
 COMMAND_HANDLER(handle_esirisc_trace_buffer_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -1119,6 +1424,14 @@ static const struct command_registration esirisc_trace_exec_command_handlers[] =
 		.help = "dump collected trace data to file",
 		.usage = "[address size] filename",
 	},
+	{
+		.name = "stream",
+		.handler = handle_esirisc_trace_stream_command,
+		.mode = COMMAND_EXEC,
+		.help = "drain the trace buffer while the target runs, to a file "
+			"or to the connections of a TCP port",
+		.usage = "[off | file filename [interval_ms] | tcp tcp_port [interval_ms]]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -69,6 +69,8 @@ enum esirisc_trace_trigger {
 	ESIRISC_TRACE_TRIGGER_LOW,
 };
 
+struct esirisc_trace_stream;
+
 struct esirisc_trace {
 	target_addr_t buffer_start;
 	target_addr_t buffer_end;
@@ -88,6 +90,9 @@ struct esirisc_trace {
 
 	enum esirisc_trace_delay delay;
 	uint32_t delay_cycles;
+
+	/* trace buffer drained while the target runs, see "esirisc trace stream" */
+	struct esirisc_trace_stream *stream;
 };
 
 extern const struct command_registration esirisc_trace_command_handlers[];
@@ -156,11 +156,15 @@ struct reg_cache *etb_build_reg_cache(struct etb *etb)
 	return reg_cache;
 }
 
-static void etb_getbuf(jtag_callback_data_t arg)
+static int etb_getbuf_all(jtag_callback_data_t arg, jtag_callback_data_t count,
+	jtag_callback_data_t unused2, jtag_callback_data_t unused3)
 {
-	uint8_t *in = (uint8_t *)arg;
+	uint32_t *data = (uint32_t *)arg;
 
-	*((uint32_t *)arg) = buf_get_u32(in, 0, 32);
+	for (int i = 0; i < (int)count; i++)
+		data[i] = le_to_h_u32((uint8_t *)(data + i));
+
+	return ERROR_OK;
 }
 
 static int etb_read_ram(struct etb *etb, uint32_t *data, int num_frames)
@@ -201,13 +205,13 @@ static int etb_read_ram(struct etb *etb, uint32_t *data, int num_frames)
 
 		fields[0].in_value = (uint8_t *)(data + i);
 		jtag_add_dr_scan(etb->tap, 3, fields, TAP_IDLE);
-
-		jtag_add_callback(etb_getbuf, (jtag_callback_data_t)(data + i));
 	}
 
-	jtag_execute_queue();
+	/* one conversion of the whole buffer instead of one callback per word */
+	jtag_add_callback4(etb_getbuf_all, (jtag_callback_data_t)data,
+		(jtag_callback_data_t)num_frames, 0, 0);
 
-	return ERROR_OK;
+	return jtag_execute_queue();
 }
 
 static int etb_read_reg_w_check(struct reg *reg,
@@ -648,7 +648,56 @@ static struct etm_capture_driver *etm_capture_drivers[] = {
 	NULL
 };
 
+/* direct mapped, trace analysis keeps decoding the same loops */
+#define ETM_DECODE_CACHE_SIZE	2048
+
+struct etm_decode_cache_entry {
+	bool valid;
+	int core_state;
+	uint32_t address;
+	struct arm_instruction instruction;
+};
+
+static void etm_decode_cache_free(struct etm_context *ctx)
+{
+	free(ctx->decode_cache);
+	ctx->decode_cache = NULL;
+}
+
+static int etm_decode_instruction(struct etm_context *ctx, struct arm_instruction *instruction);
+
 static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction *instruction)
+{
+	struct etm_decode_cache_entry *entry;
+
+	if (!ctx->image)
+		return ERROR_TRACE_IMAGE_UNAVAILABLE;
+
+	if (!ctx->decode_cache) {
+		ctx->decode_cache = calloc(ETM_DECODE_CACHE_SIZE, sizeof(*ctx->decode_cache));
+		if (!ctx->decode_cache)
+			return etm_decode_instruction(ctx, instruction);
+	}
+
+	entry = &ctx->decode_cache[(ctx->current_pc >> 1) % ETM_DECODE_CACHE_SIZE];
+	if (entry->valid && entry->address == ctx->current_pc
+			&& entry->core_state == ctx->core_state) {
+		*instruction = entry->instruction;
+		return ERROR_OK;
+	}
+
+	int retval = etm_decode_instruction(ctx, instruction);
+	if (retval == ERROR_OK) {
+		entry->valid = true;
+		entry->address = ctx->current_pc;
+		entry->core_state = ctx->core_state;
+		entry->instruction = *instruction;
+	}
+
+	return retval;
+}
+
+static int etm_decode_instruction(struct etm_context *ctx, struct arm_instruction *instruction)
 {
 	int i;
 	int section = -1;
@@ -656,9 +705,6 @@ static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction
 	uint32_t opcode;
 	int retval;
 
-	if (!ctx->image)
-		return ERROR_TRACE_IMAGE_UNAVAILABLE;
-
 	/* search for the section the current instruction belongs to */
 	for (i = 0; i < ctx->image->num_sections; i++) {
 		if ((ctx->image->sections[i].base_address <= ctx->current_pc) &&
@@ -1676,6 +1722,8 @@ COMMAND_HANDLER(handle_etm_image_command)
 		return ERROR_FAIL;
 	}
 
+	etm_decode_cache_free(etm_ctx);
+
 	if (etm_ctx->image) {
 		image_close(etm_ctx->image);
 		free(etm_ctx->image);
@@ -50,6 +50,30 @@ static inline struct hl_interface_s *target_to_adapter(struct target *target)
 	return target->tap->priv;
 }
 
+/* Queue a read on adapters which batch operations, or read right away */
+static int adapter_queue_read_reg(struct hl_interface_s *adapter, int num, uint32_t *value)
+{
+	if (adapter->layout->api->queue_read_reg)
+		return adapter->layout->api->queue_read_reg(adapter->handle, num, value);
+	return adapter->layout->api->read_reg(adapter->handle, num, value);
+}
+
+static int adapter_queue_read_mem(struct hl_interface_s *adapter, uint32_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	if (adapter->layout->api->queue_read_mem)
+		return adapter->layout->api->queue_read_mem(adapter->handle, address,
+				size, count, buffer);
+	return adapter->layout->api->read_mem(adapter->handle, address, size, count, buffer);
+}
+
+static int adapter_queue_flush(struct hl_interface_s *adapter)
+{
+	if (adapter->layout->api->queue_flush)
+		return adapter->layout->api->queue_flush(adapter->handle);
+	return ERROR_OK;
+}
+
 static int adapter_load_core_reg_u32(struct target *target,
 		uint32_t num, uint32_t *value)
 {
@@ -384,16 +408,65 @@ static int adapter_target_create(struct target *target,
 	return ERROR_OK;
 }
 
+/* Reads the registers not cached yet. R0..R15, xPSR, MSP, PSP and the
+ * special registers are queued and sent to the adapter together, with any
+ * read queued by the caller; the other registers are read one by one. */
 static int adapter_load_context(struct target *target)
 {
+	struct hl_interface_s *adapter = target_to_adapter(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
-	int num_regs = armv7m->arm.core_cache->num_regs;
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	int num_regs = cache->num_regs;
+	/* Debug Core Register Selector values 0..18 and 20 */
+	uint32_t values[21];
+	int retval;
+
+	for (int num = 0; num <= 20; num++) {
+		if (num == 19)
+			continue;
+		retval = adapter_queue_read_reg(adapter, num, &values[num]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = adapter_queue_flush(adapter);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("JTAG failure %i", retval);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
 
 	for (int i = 0; i < num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		struct arm_reg *arm_reg = r->arch_info;
+		uint32_t value;
+
+		if (r->valid)
+			continue;
 
-		struct reg *r = &armv7m->arm.core_cache->reg_list[i];
-		if (!r->valid)
+		switch (arm_reg->num) {
+		case 0 ... 18:
+			value = values[arm_reg->num];
+			break;
+		case ARMV7M_PRIMASK:
+			value = values[20] & 0x1;
+			break;
+		case ARMV7M_BASEPRI:
+			value = (values[20] >> 8) & 0xff;
+			break;
+		case ARMV7M_FAULTMASK:
+			value = (values[20] >> 16) & 0x1;
+			break;
+		case ARMV7M_CONTROL:
+			value = (values[20] >> 24) & 0x7;
+			break;
+		default:
 			armv7m->arm.read_core_reg(target, r, i, ARM_MODE_ANY);
+			continue;
+		}
+
+		buf_set_u32(r->value, 0, 32, value);
+		r->valid = true;
+		r->dirty = false;
 	}
 
 	return ERROR_OK;
@@ -405,19 +478,24 @@ static int adapter_debug_entry(struct target *target)
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	struct arm *arm = &armv7m->arm;
 	struct reg *r;
+	uint8_t dcrdr[4];
 	uint32_t xPSR;
 	int retval;
 
-	/* preserve the DCRDR across halts */
-	retval = target_read_u32(target, DCB_DCRDR, &target->savedDCRDR);
+	retval = armv7m->examine_debug_reason(target);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = armv7m->examine_debug_reason(target);
+	/* preserve the DCRDR across halts, read along with the registers.
+	 * Queued last, so that no early return leaves it aimed at this frame */
+	retval = adapter_queue_read_mem(adapter, DCB_DCRDR, 4, 1, dcrdr);
 	if (retval != ERROR_OK)
 		return retval;
 
-	adapter_load_context(target);
+	retval = adapter_load_context(target);
+	if (retval != ERROR_OK)
+		return retval;
+	target->savedDCRDR = target_buffer_get_u32(target, dcrdr);
 
 	/* make sure we clear the vector catch bit */
 	adapter->layout->api->write_debug_reg(adapter->handle, DCB_DEMCR, TRCENA);
@@ -824,7 +902,10 @@ struct target_type hla_target = {
 	.read_memory = adapter_read_memory,
 	.write_memory = adapter_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
+	.checksum_memory_blocks = armv7m_checksum_memory_blocks,
+	.mem_pattern = armv7m_mem_pattern,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.stack_check_memory = armv7m_stack_check_memory,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -42,6 +42,10 @@
 	((elf->endianness == ELFDATA2LSB) ? \
 	le_to_h_u32((uint8_t *)&field) : be_to_h_u32((uint8_t *)&field))
 
+#define field64(elf, field) \
+	((elf->endianness == ELFDATA2LSB) ? \
+	le_to_h_u64((uint8_t *)&field) : be_to_h_u64((uint8_t *)&field))
+
 static int autodetect_image_type(struct image *image, const char *url)
 {
 	int retval;
@@ -115,319 +119,427 @@ static int identify_image_type(struct image *image, const char *type_string, con
 	return ERROR_OK;
 }
 
-static int image_ihex_buffer_complete_inner(struct image *image,
-	char *lpszLine,
-	struct imagesection *section)
+/* value of each hex digit, -1 for any other character */
+static int8_t image_hex_table[256];
+
+static void image_hex_table_init(void)
 {
-	struct image_ihex *ihex = image->type_private;
-	struct fileio *fileio = ihex->fileio;
-	uint32_t full_address;
-	uint32_t cooked_bytes;
-	bool end_rec = false;
-	int i;
+	static bool done;
+
+	if (done)
+		return;
+
+	memset(image_hex_table, -1, sizeof(image_hex_table));
+	for (int i = 0; i < 10; i++)
+		image_hex_table['0' + i] = i;
+	for (int i = 0; i < 6; i++) {
+		image_hex_table['a' + i] = 10 + i;
+		image_hex_table['A' + i] = 10 + i;
+	}
+	done = true;
+}
+
+/* decode the @a count bytes in hex at @a hex, @returns their sum modulo 256
+ * or -1 on a character which is no hex digit */
+static int image_hex_decode(const char *hex, size_t count, uint8_t *out)
+{
+	unsigned int sum = 0;
+	int bad = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		int hi = image_hex_table[(uint8_t)hex[2 * i]];
+		int lo = image_hex_table[(uint8_t)hex[2 * i + 1]];
+		bad |= hi | lo;
+		out[i] = (hi << 4) | lo;
+		sum += out[i];
+	}
+
+	return bad < 0 ? -1 : (int)(sum & 0xff);
+}
+
+/* get the next line at @a pos without line ending and trailing white space,
+ * @returns false at the end of the text */
+static bool image_text_line(const char **pos, const char *end,
+		const char **line, size_t *len)
+{
+	const char *p = *pos;
+
+	if (p >= end)
+		return false;
 
-	/* we can't determine the number of sections that we'll have to create ahead of time,
-	 * so we locally hold them until parsing is finished */
+	const char *eol = memchr(p, '\n', end - p);
+	if (!eol)
+		eol = end;
+	*pos = eol < end ? eol + 1 : end;
 
-	size_t filesize;
+	while (eol > p && isspace((unsigned char)eol[-1]))
+		eol--;
+	*line = p;
+	*len = eol - p;
+	return true;
+}
+
+/* get the whole text of a hex file, from its mapping if possible;
+ * @a copy is set to the buffer to free afterwards, if any */
+static int image_text_load(struct fileio *fileio, const char **text,
+		size_t *len, char **copy)
+{
+	const uint8_t *map;
+	size_t size, size_read;
 	int retval;
-	retval = fileio_size(fileio, &filesize);
+
+	*copy = NULL;
+
+	retval = fileio_size(fileio, &size);
 	if (retval != ERROR_OK)
 		return retval;
+	*len = size;
 
-	ihex->buffer = malloc(filesize >> 1);
-	cooked_bytes = 0x0;
-	image->num_sections = 0;
+	if (fileio_map(fileio, &map) == ERROR_OK) {
+		*text = (const char *)map;
+		return ERROR_OK;
+	}
 
-	while (!fileio_feof(fileio)) {
-		full_address = 0x0;
-		section[image->num_sections].private = &ihex->buffer[cooked_bytes];
-		section[image->num_sections].base_address = 0x0;
-		section[image->num_sections].size = 0x0;
-		section[image->num_sections].flags = 0;
-
-		while (fileio_fgets(fileio, 1023, lpszLine) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
-			uint8_t cal_checksum = 0;
-			size_t bytes_read = 0;
-
-			/* skip comments and blank lines */
-			if ((lpszLine[0] == '#') || (strlen(lpszLine + strspn(lpszLine, "\n\t\r ")) == 0))
-				continue;
-
-			if (sscanf(&lpszLine[bytes_read], ":%2" SCNx32 "%4" SCNx32 "%2" SCNx32, &count,
-				&address, &record_type) != 3)
-				return ERROR_IMAGE_FORMAT_ERROR;
-			bytes_read += 9;
-
-			cal_checksum += (uint8_t)count;
-			cal_checksum += (uint8_t)(address >> 8);
-			cal_checksum += (uint8_t)address;
-			cal_checksum += (uint8_t)record_type;
-
-			if (record_type == 0) {	/* Data Record */
-				if ((full_address & 0xffff) != address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff0000) | address;
-					full_address = (full_address & 0xffff0000) | address;
-				}
+	*copy = malloc(size + 1);
+	if (!*copy) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	retval = fileio_read(fileio, size, *copy, &size_read);
+	if (retval != ERROR_OK || size_read != size) {
+		free(*copy);
+		*copy = NULL;
+		return retval != ERROR_OK ? retval : ERROR_FILEIO_OPERATION_FAILED;
+	}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpszLine[bytes_read], "%2x", &value);
-					ihex->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
-			} else if (record_type == 1) {	/* End of File Record */
-				/* finish the current section */
-				image->num_sections++;
-
-				/* copy section information */
-				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
-				for (i = 0; i < image->num_sections; i++) {
-					image->sections[i].private = section[i].private;
-					image->sections[i].base_address = section[i].base_address;
-					image->sections[i].size = section[i].size;
-					image->sections[i].flags = section[i].flags;
-				}
+	*text = *copy;
+	return ERROR_OK;
+}
 
-				end_rec = true;
-				break;
-			} else if (record_type == 2) {	/* Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpszLine[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
-
-				if ((full_address >> 4) != upper_address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff) | (upper_address << 4);
-					full_address = (full_address & 0xffff) | (upper_address << 4);
-				}
-			} else if (record_type == 3) {	/* Start Segment Address Record */
-				uint32_t dummy;
-
-				/* "Start Segment Address Record" will not be supported
-				 * but we must consume it, and do not create an error.  */
-				while (count-- > 0) {
-					sscanf(&lpszLine[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
-			} else if (record_type == 4) {	/* Extended Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpszLine[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
-
-				if ((full_address >> 16) != upper_address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff) | (upper_address << 16);
-					full_address = (full_address & 0xffff) | (upper_address << 16);
-				}
-			} else if (record_type == 5) {	/* Start Linear Address Record */
-				uint32_t start_address;
-
-				sscanf(&lpszLine[bytes_read], "%8" SCNx32, &start_address);
-				cal_checksum += (uint8_t)(start_address >> 24);
-				cal_checksum += (uint8_t)(start_address >> 16);
-				cal_checksum += (uint8_t)(start_address >> 8);
-				cal_checksum += (uint8_t)start_address;
-				bytes_read += 8;
-
-				image->start_address_set = 1;
-				image->start_address = be_to_h_u32((uint8_t *)&start_address);
-			} else {
-				LOG_ERROR("unhandled IHEX record type: %i", (int)record_type);
-				return ERROR_IMAGE_FORMAT_ERROR;
-			}
+/* append @a size bytes for @a address to the sections of a hex file;
+ * a new section is started unless they continue the last one */
+static int image_text_append(struct image *image, int *sections_alloc,
+		uint8_t **cooked, target_addr_t address, const uint8_t *data, uint32_t size)
+{
+	struct imagesection *section = NULL;
 
-			sscanf(&lpszLine[bytes_read], "%2" SCNx32, &checksum);
+	if (image->num_sections > 0) {
+		section = &image->sections[image->num_sections - 1];
+		if (section->base_address + section->size != address)
+			section = NULL;
+	}
 
-			if ((uint8_t)checksum != (uint8_t)(~cal_checksum + 1)) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in IHEX file");
-				return ERROR_IMAGE_CHECKSUM;
+	if (!section) {
+		if (image->num_sections == *sections_alloc) {
+			int alloc = *sections_alloc ? 2 * *sections_alloc : 16;
+			struct imagesection *sections = realloc(image->sections,
+					alloc * sizeof(*sections));
+			if (!sections) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
 			}
+			image->sections = sections;
+			*sections_alloc = alloc;
+		}
+		section = &image->sections[image->num_sections++];
+		section->base_address = address;
+		section->size = 0;
+		section->flags = 0;
+		section->private = *cooked;
+	}
 
-			if (end_rec) {
-				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpszLine);
-			}
+	memcpy(*cooked, data, size);
+	*cooked += size;
+	section->size += size;
+	return ERROR_OK;
+}
+
+static int image_ihex_parse(struct image *image, const char *text, size_t len)
+{
+	struct image_ihex *ihex = image->type_private;
+	const char *pos = text, *end = text + len;
+	const char *line;
+	size_t line_len;
+	/* count, address, type, up to 255 data bytes, checksum */
+	uint8_t record[260];
+	uint32_t base = 0;
+	uint8_t *cooked;
+	int sections_alloc = 0;
+	bool end_rec = false;
+
+	/* every data byte takes at least two characters */
+	ihex->buffer = malloc(len / 2 + 1);
+	if (!ihex->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	cooked = ihex->buffer;
+	image->num_sections = 0;
+
+	while (image_text_line(&pos, end, &line, &line_len)) {
+		/* skip comments and blank lines */
+		if (line_len == 0 || line[0] == '#')
+			continue;
+
+		if (line[0] != ':' || line_len < 11 || (line_len & 1) == 0) {
+			LOG_ERROR("invalid IHEX record: %.40s", line);
+			return ERROR_IMAGE_FORMAT_ERROR;
+		}
+
+		size_t n = (line_len - 1) / 2;
+		if (n > sizeof(record))
+			return ERROR_IMAGE_FORMAT_ERROR;
+		int sum = image_hex_decode(line + 1, n, record);
+		if (sum < 0 || n != record[0] + 5u) {
+			LOG_ERROR("invalid IHEX record: %.40s", line);
+			return ERROR_IMAGE_FORMAT_ERROR;
+		}
+		if (sum != 0) {
+			LOG_ERROR("incorrect record checksum found in IHEX file");
+			return ERROR_IMAGE_CHECKSUM;
+		}
+
+		if (end_rec) {
+			end_rec = false;
+			LOG_WARNING("continuing after end-of-file record: %.40s", line);
+		}
+
+		uint8_t count = record[0];
+		uint32_t address = be_to_h_u16(record + 1);
+		const uint8_t *data = record + 4;
+		int retval;
+
+		switch (record[3]) {
+		case 0:	/* Data Record */
+			retval = image_text_append(image, &sections_alloc, &cooked,
+					base + address, data, count);
+			if (retval != ERROR_OK)
+				return retval;
+			break;
+		case 1:	/* End of File Record */
+			end_rec = true;
+			break;
+		case 2:	/* Extended Segment Address Record */
+			if (count != 2)
+				return ERROR_IMAGE_FORMAT_ERROR;
+			base = (uint32_t)be_to_h_u16(data) << 4;
+			break;
+		case 3:	/* Start Segment Address Record */
+			/* "Start Segment Address Record" will not be supported
+			 * but we must consume it, and do not create an error.  */
+			break;
+		case 4:	/* Extended Linear Address Record */
+			if (count != 2)
+				return ERROR_IMAGE_FORMAT_ERROR;
+			base = (uint32_t)be_to_h_u16(data) << 16;
+			break;
+		case 5:	/* Start Linear Address Record */
+			if (count != 4)
+				return ERROR_IMAGE_FORMAT_ERROR;
+			image->start_address_set = 1;
+			image->start_address = be_to_h_u32(data);
+			break;
+		default:
+			LOG_ERROR("unhandled IHEX record type: %i", (int)record[3]);
+			return ERROR_IMAGE_FORMAT_ERROR;
 		}
 	}
 
-	if (end_rec)
-		return ERROR_OK;
-	else {
+	if (!end_rec) {
 		LOG_ERROR("premature end of IHEX file, no matching end-of-file record found");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
+
+	return ERROR_OK;
 }
 
 /**
- * Allocate memory dynamically instead of on the stack. This
- * is important w/embedded hosts.
+ * Parse the whole file in one pass over its mapping, or over one copy of
+ * it where the file can't be mapped.
  */
 static int image_ihex_buffer_complete(struct image *image)
 {
-	char *lpszLine = malloc(1023);
-	if (lpszLine == NULL) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
-	if (section == NULL) {
-		free(lpszLine);
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-	int retval;
+	struct image_ihex *ihex = image->type_private;
+	const char *text;
+	size_t len;
+	char *copy;
+
+	image_hex_table_init();
 
-	retval = image_ihex_buffer_complete_inner(image, lpszLine, section);
+	int retval = image_text_load(ihex->fileio, &text, &len, &copy);
+	if (retval != ERROR_OK)
+		return retval;
 
-	free(section);
-	free(lpszLine);
+	image->sections = NULL;
+	retval = image_ihex_parse(image, text, len);
+	free(copy);
+
+	if (retval != ERROR_OK) {
+		free(image->sections);
+		image->sections = NULL;
+		image->num_sections = 0;
+		free(ihex->buffer);
+		ihex->buffer = NULL;
+	}
 
 	return retval;
 }
 
+/* program header fields common to ELF32 and ELF64, in host byte order */
+struct image_elf_segment {
+	uint32_t type;
+	uint32_t flags;
+	uint64_t offset;
+	uint64_t vaddr;
+	uint64_t paddr;
+	uint64_t filesz;
+	uint64_t memsz;
+};
+
+static void image_elf_segment(struct image_elf *elf, const void *phdr,
+		struct image_elf_segment *segment)
+{
+	if (elf->is_64_bit) {
+		const Elf64_Phdr *p = phdr;
+		segment->type = field32(elf, p->p_type);
+		segment->flags = field32(elf, p->p_flags);
+		segment->offset = field64(elf, p->p_offset);
+		segment->vaddr = field64(elf, p->p_vaddr);
+		segment->paddr = field64(elf, p->p_paddr);
+		segment->filesz = field64(elf, p->p_filesz);
+		segment->memsz = field64(elf, p->p_memsz);
+	} else {
+		const Elf32_Phdr *p = phdr;
+		segment->type = field32(elf, p->p_type);
+		segment->flags = field32(elf, p->p_flags);
+		segment->offset = field32(elf, p->p_offset);
+		segment->vaddr = field32(elf, p->p_vaddr);
+		segment->paddr = field32(elf, p->p_paddr);
+		segment->filesz = field32(elf, p->p_filesz);
+		segment->memsz = field32(elf, p->p_memsz);
+	}
+}
+
+static const void *image_elf_phdr(struct image_elf *elf, uint32_t i)
+{
+	if (elf->is_64_bit)
+		return &elf->segments64[i];
+	return &elf->segments32[i];
+}
+
 static int image_elf_read_headers(struct image *image)
 {
 	struct image_elf *elf = image->type_private;
-	size_t read_bytes;
+	struct image_elf_segment segment;
+	size_t read_bytes, header_size, phdr_size;
+	uint64_t phoff, entry;
 	uint32_t i, j;
 	int retval;
 	uint32_t nload, load_to_vaddr = 0;
 
-	elf->header = malloc(sizeof(Elf32_Ehdr));
+	/* large enough for both classes, the identification tells which */
+	elf->header64 = malloc(sizeof(Elf64_Ehdr));
 
-	if (elf->header == NULL) {
+	if (elf->header64 == NULL) {
 		LOG_ERROR("insufficient memory to perform operation ");
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
 
-	retval = fileio_read(elf->fileio, sizeof(Elf32_Ehdr), (uint8_t *)elf->header, &read_bytes);
+	retval = fileio_read(elf->fileio, EI_NIDENT, (uint8_t *)elf->header64, &read_bytes);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("cannot read ELF file header, read failed");
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
-	if (read_bytes != sizeof(Elf32_Ehdr)) {
+	if (read_bytes != EI_NIDENT) {
 		LOG_ERROR("cannot read ELF file header, only partially read");
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
 
-	if (strncmp((char *)elf->header->e_ident, ELFMAG, SELFMAG) != 0) {
+	if (strncmp((char *)elf->header64->e_ident, ELFMAG, SELFMAG) != 0) {
 		LOG_ERROR("invalid ELF file, bad magic number");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
-	if (elf->header->e_ident[EI_CLASS] != ELFCLASS32) {
-		LOG_ERROR("invalid ELF file, only 32bits files are supported");
+
+	if (elf->header64->e_ident[EI_CLASS] == ELFCLASS32) {
+		elf->is_64_bit = false;
+		header_size = sizeof(Elf32_Ehdr);
+		phdr_size = sizeof(Elf32_Phdr);
+	} else if (elf->header64->e_ident[EI_CLASS] == ELFCLASS64) {
+		elf->is_64_bit = true;
+		header_size = sizeof(Elf64_Ehdr);
+		phdr_size = sizeof(Elf64_Phdr);
+	} else {
+		LOG_ERROR("invalid ELF file, unknown class");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
 
-	elf->endianness = elf->header->e_ident[EI_DATA];
+	elf->endianness = elf->header64->e_ident[EI_DATA];
 	if ((elf->endianness != ELFDATA2LSB)
 		&& (elf->endianness != ELFDATA2MSB)) {
 		LOG_ERROR("invalid ELF file, unknown endianness setting");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
 
-	elf->segment_count = field16(elf, elf->header->e_phnum);
+	retval = fileio_read(elf->fileio, header_size - EI_NIDENT,
+			(uint8_t *)elf->header64 + EI_NIDENT, &read_bytes);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("cannot read ELF file header, read failed");
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+	if (read_bytes != header_size - EI_NIDENT) {
+		LOG_ERROR("cannot read ELF file header, only partially read");
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	if (elf->is_64_bit) {
+		elf->segment_count = field16(elf, elf->header64->e_phnum);
+		phoff = field64(elf, elf->header64->e_phoff);
+		entry = field64(elf, elf->header64->e_entry);
+	} else {
+		elf->segment_count = field16(elf, elf->header32->e_phnum);
+		phoff = field32(elf, elf->header32->e_phoff);
+		entry = field32(elf, elf->header32->e_entry);
+	}
 	if (elf->segment_count == 0) {
 		LOG_ERROR("invalid ELF file, no program headers");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
 
-	retval = fileio_seek(elf->fileio, field32(elf, elf->header->e_phoff));
+	retval = fileio_seek(elf->fileio, phoff);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("cannot seek to ELF program header table, read failed");
 		return retval;
 	}
 
-	elf->segments = malloc(elf->segment_count*sizeof(Elf32_Phdr));
-	if (elf->segments == NULL) {
+	elf->segments64 = malloc(elf->segment_count * phdr_size);
+	if (elf->segments64 == NULL) {
 		LOG_ERROR("insufficient memory to perform operation ");
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
 
-	retval = fileio_read(elf->fileio, elf->segment_count*sizeof(Elf32_Phdr),
-			(uint8_t *)elf->segments, &read_bytes);
+	retval = fileio_read(elf->fileio, elf->segment_count * phdr_size,
+			(uint8_t *)elf->segments64, &read_bytes);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("cannot read ELF segment headers, read failed");
 		return retval;
 	}
-	if (read_bytes != elf->segment_count*sizeof(Elf32_Phdr)) {
+	if (read_bytes != elf->segment_count * phdr_size) {
 		LOG_ERROR("cannot read ELF segment headers, only partially read");
 		return ERROR_FILEIO_OPERATION_FAILED;
 	}
 
 	/* count useful segments (loadable), ignore BSS section */
 	image->num_sections = 0;
-	for (i = 0; i < elf->segment_count; i++)
-		if ((field32(elf,
-			elf->segments[i].p_type) == PT_LOAD) &&
-			(field32(elf, elf->segments[i].p_filesz) != 0))
+	for (i = 0; i < elf->segment_count; i++) {
+		image_elf_segment(elf, image_elf_phdr(elf, i), &segment);
+		if (segment.type == PT_LOAD && segment.filesz != 0) {
+			if (segment.filesz > UINT32_MAX) {
+				LOG_ERROR("ELF segment %" PRIu32 " too large", i);
+				return ERROR_IMAGE_FORMAT_ERROR;
+			}
 			image->num_sections++;
+		}
+	}
 
 	assert(image->num_sections > 0);
 
@@ -441,13 +553,13 @@ static int image_elf_read_headers(struct image *image)
 	 * library uses this approach to workaround zero-initialized p_paddrs
 	 * when obtaining lma - look at elf.c of BDF)
 	 */
-	for (nload = 0, i = 0; i < elf->segment_count; i++)
-		if (elf->segments[i].p_paddr != 0)
+	for (nload = 0, i = 0; i < elf->segment_count; i++) {
+		image_elf_segment(elf, image_elf_phdr(elf, i), &segment);
+		if (segment.paddr != 0)
 			break;
-		else if ((field32(elf,
-			elf->segments[i].p_type) == PT_LOAD) &&
-			(field32(elf, elf->segments[i].p_memsz) != 0))
+		else if (segment.type == PT_LOAD && segment.memsz != 0)
 			++nload;
+	}
 
 	if (i >= elf->segment_count && nload > 1)
 		load_to_vaddr = 1;
@@ -455,28 +567,54 @@ static int image_elf_read_headers(struct image *image)
 	/* alloc and fill sections array with loadable segments */
 	image->sections = malloc(image->num_sections * sizeof(struct imagesection));
 	for (i = 0, j = 0; i < elf->segment_count; i++) {
-		if ((field32(elf,
-			elf->segments[i].p_type) == PT_LOAD) &&
-			(field32(elf, elf->segments[i].p_filesz) != 0)) {
-			image->sections[j].size = field32(elf, elf->segments[i].p_filesz);
+		image_elf_segment(elf, image_elf_phdr(elf, i), &segment);
+		if (segment.type == PT_LOAD && segment.filesz != 0) {
+			image->sections[j].size = segment.filesz;
 			if (load_to_vaddr)
-				image->sections[j].base_address = field32(elf,
-						elf->segments[i].p_vaddr);
+				image->sections[j].base_address = segment.vaddr;
 			else
-				image->sections[j].base_address = field32(elf,
-						elf->segments[i].p_paddr);
-			image->sections[j].private = &elf->segments[i];
-			image->sections[j].flags = field32(elf, elf->segments[i].p_flags);
+				image->sections[j].base_address = segment.paddr;
+			image->sections[j].private = (void *)image_elf_phdr(elf, i);
+			image->sections[j].flags = segment.flags;
 			j++;
 		}
 	}
 
 	image->start_address_set = 1;
-	image->start_address = field32(elf, elf->header->e_entry);
+	image->start_address = entry;
 
 	return ERROR_OK;
 }
 
+/* @returns the contents of @a section inside the image, or NULL */
+static const uint8_t *image_section_pointer(struct image *image, int section)
+{
+	struct imagesection *s = &image->sections[section];
+
+	switch (image->type) {
+	case IMAGE_BINARY: {
+		struct image_binary *image_binary = image->type_private;
+		return image_binary->map;
+	}
+	case IMAGE_ELF: {
+		struct image_elf *elf = image->type_private;
+		struct image_elf_segment segment;
+
+		image_elf_segment(elf, s->private, &segment);
+		if (!elf->map || segment.offset > elf->map_size
+				|| s->size > elf->map_size - segment.offset)
+			return NULL;
+		return elf->map + segment.offset;
+	}
+	case IMAGE_IHEX:
+	case IMAGE_SRECORD:
+	case IMAGE_BUILDER:
+		return s->private;
+	default:
+		return NULL;
+	}
+}
+
 static int image_elf_read_section(struct image *image,
 	int section,
 	uint32_t offset,
@@ -485,22 +623,30 @@ static int image_elf_read_section(struct image *image,
 	size_t *size_read)
 {
 	struct image_elf *elf = image->type_private;
-	Elf32_Phdr *segment = (Elf32_Phdr *)image->sections[section].private;
+	struct image_elf_segment segment;
 	size_t read_size, really_read;
 	int retval;
 
 	*size_read = 0;
 
+	image_elf_segment(elf, image->sections[section].private, &segment);
+
 	LOG_DEBUG("load segment %d at 0x%" PRIx32 " (sz = 0x%" PRIx32 ")", section, offset, size);
 
 	/* read initialized data in current segment if any */
-	if (offset < field32(elf, segment->p_filesz)) {
+	if (offset < segment.filesz) {
 		/* maximal size present in file for the current segment */
-		read_size = MIN(size, field32(elf, segment->p_filesz) - offset);
-		LOG_DEBUG("read elf: size = 0x%zx at 0x%" PRIx32 "", read_size,
-			field32(elf, segment->p_offset) + offset);
+		read_size = MIN(size, segment.filesz - offset);
+		LOG_DEBUG("read elf: size = 0x%zx at 0x%" PRIx64 "", read_size,
+			segment.offset + offset);
+		const uint8_t *p = image_section_pointer(image, section);
+		if (p) {
+			memcpy(buffer, p + offset, read_size);
+			*size_read += read_size;
+			return ERROR_OK;
+		}
 		/* read initialized area of the segment */
-		retval = fileio_seek(elf->fileio, field32(elf, segment->p_offset) + offset);
+		retval = fileio_seek(elf->fileio, segment.offset + offset);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("cannot find ELF segment content, seek failed");
 			return retval;
@@ -520,206 +666,134 @@ static int image_elf_read_section(struct image *image,
 	return ERROR_OK;
 }
 
-static int image_mot_buffer_complete_inner(struct image *image,
-	char *lpszLine,
-	struct imagesection *section)
+static int image_mot_parse(struct image *image, const char *text, size_t len)
 {
 	struct image_mot *mot = image->type_private;
-	struct fileio *fileio = mot->fileio;
-	uint32_t full_address;
-	uint32_t cooked_bytes;
+	const char *pos = text, *end = text + len;
+	const char *line;
+	size_t line_len;
+	/* count, address, data and checksum */
+	uint8_t record[256];
+	uint8_t *cooked;
+	int sections_alloc = 0;
 	bool end_rec = false;
-	int i;
-
-	/* we can't determine the number of sections that we'll have to create ahead of time,
-	 * so we locally hold them until parsing is finished */
-
-	int retval;
-	size_t filesize;
-	retval = fileio_size(fileio, &filesize);
-	if (retval != ERROR_OK)
-		return retval;
 
-	mot->buffer = malloc(filesize >> 1);
-	cooked_bytes = 0x0;
+	/* every data byte takes at least two characters */
+	mot->buffer = malloc(len / 2 + 1);
+	if (!mot->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	cooked = mot->buffer;
 	image->num_sections = 0;
 
-	while (!fileio_feof(fileio)) {
-		full_address = 0x0;
-		section[image->num_sections].private = &mot->buffer[cooked_bytes];
-		section[image->num_sections].base_address = 0x0;
-		section[image->num_sections].size = 0x0;
-		section[image->num_sections].flags = 0;
-
-		while (fileio_fgets(fileio, 1023, lpszLine) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
-			uint8_t cal_checksum = 0;
-			uint32_t bytes_read = 0;
-
-			/* skip comments and blank lines */
-			if ((lpszLine[0] == '#') || (strlen(lpszLine + strspn(lpszLine, "\n\t\r ")) == 0))
-				continue;
-
-			/* get record type and record length */
-			if (sscanf(&lpszLine[bytes_read], "S%1" SCNx32 "%2" SCNx32, &record_type,
-				&count) != 2)
-				return ERROR_IMAGE_FORMAT_ERROR;
-
-			bytes_read += 4;
-			cal_checksum += (uint8_t)count;
-
-			/* skip checksum byte */
-			count -= 1;
+	while (image_text_line(&pos, end, &line, &line_len)) {
+		/* skip comments and blank lines */
+		if (line_len == 0 || line[0] == '#')
+			continue;
 
-			if (record_type == 0) {
-				/* S0 - starting record (optional) */
-				int iValue;
-
-				while (count-- > 0) {
-					sscanf(&lpszLine[bytes_read], "%2x", &iValue);
-					cal_checksum += (uint8_t)iValue;
-					bytes_read += 2;
-				}
-			} else if (record_type >= 1 && record_type <= 3) {
-				switch (record_type) {
-					case 1:
-						/* S1 - 16 bit address data record */
-						sscanf(&lpszLine[bytes_read], "%4" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 4;
-						count -= 2;
-						break;
-
-					case 2:
-						/* S2 - 24 bit address data record */
-						sscanf(&lpszLine[bytes_read], "%6" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 6;
-						count -= 3;
-						break;
-
-					case 3:
-						/* S3 - 32 bit address data record */
-						sscanf(&lpszLine[bytes_read], "%8" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 24);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 8;
-						count -= 4;
-						break;
+		if (line[0] != 'S' || !isdigit((unsigned char)line[1])
+				|| line_len < 6 || (line_len & 1)) {
+			LOG_ERROR("invalid S19 record: %.40s", line);
+			return ERROR_IMAGE_FORMAT_ERROR;
+		}
 
-				}
+		unsigned int record_type = line[1] - '0';
+		size_t n = (line_len - 2) / 2;
+		if (n > sizeof(record))
+			return ERROR_IMAGE_FORMAT_ERROR;
+		int sum = image_hex_decode(line + 2, n, record);
+		if (sum < 0 || n != record[0] + 1u) {
+			LOG_ERROR("invalid S19 record: %.40s", line);
+			return ERROR_IMAGE_FORMAT_ERROR;
+		}
+		/* the checksum is the ones' complement of the sum of all other bytes */
+		if (sum != 0xff) {
+			LOG_ERROR("incorrect record checksum found in S19 file");
+			return ERROR_IMAGE_CHECKSUM;
+		}
 
-				if (full_address != address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&mot->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address = address;
-					full_address = address;
-				}
+		if (end_rec) {
+			end_rec = false;
+			LOG_WARNING("continuing after end-of-file record: %.40s", line);
+		}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpszLine[bytes_read], "%2x", &value);
-					mot->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
-			} else if (record_type == 5 || record_type == 6) {
-				/* S5 and S6 are the data count records, we ignore them */
-				uint32_t dummy;
-
-				while (count-- > 0) {
-					sscanf(&lpszLine[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
-			} else if (record_type >= 7 && record_type <= 9) {
-				/* S7, S8, S9 - ending records for 32, 24 and 16bit */
-				image->num_sections++;
-
-				/* copy section information */
-				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
-				for (i = 0; i < image->num_sections; i++) {
-					image->sections[i].private = section[i].private;
-					image->sections[i].base_address = section[i].base_address;
-					image->sections[i].size = section[i].size;
-					image->sections[i].flags = section[i].flags;
-				}
+		/* address and data, without count and checksum */
+		unsigned int count = record[0] - 1;
+		const uint8_t *data = record + 1;
+		uint32_t address;
+		int retval;
 
-				end_rec = true;
-				break;
-			} else {
-				LOG_ERROR("unhandled S19 record type: %i", (int)(record_type));
+		switch (record_type) {
+		case 0:
+			/* S0 - starting record (optional) */
+			break;
+		case 1:
+		case 2:
+		case 3:
+			/* S1, S2, S3 - data records with 16, 24 and 32 bit address */
+			if (count < record_type + 1)
 				return ERROR_IMAGE_FORMAT_ERROR;
-			}
-
-			/* account for checksum, will always be 0xFF */
-			sscanf(&lpszLine[bytes_read], "%2" SCNx32, &checksum);
-			cal_checksum += (uint8_t)checksum;
-
-			if (cal_checksum != 0xFF) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in S19 file");
-				return ERROR_IMAGE_CHECKSUM;
-			}
-
-			if (end_rec) {
-				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpszLine);
-			}
+			address = 0;
+			for (unsigned int i = 0; i <= record_type; i++)
+				address = (address << 8) | data[i];
+			retval = image_text_append(image, &sections_alloc, &cooked, address,
+					data + record_type + 1, count - (record_type + 1));
+			if (retval != ERROR_OK)
+				return retval;
+			break;
+		case 5:
+		case 6:
+			/* S5 and S6 are the data count records, we ignore them */
+			break;
+		case 7:
+		case 8:
+		case 9:
+			/* S7, S8, S9 - ending records for 32, 24 and 16bit */
+			end_rec = true;
+			break;
+		default:
+			LOG_ERROR("unhandled S19 record type: %i", (int)record_type);
+			return ERROR_IMAGE_FORMAT_ERROR;
 		}
 	}
 
-	if (end_rec)
-		return ERROR_OK;
-	else {
+	if (!end_rec) {
 		LOG_ERROR("premature end of S19 file, no matching end-of-file record found");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
+
+	return ERROR_OK;
 }
 
 /**
- * Allocate memory dynamically instead of on the stack. This
- * is important w/embedded hosts.
+ * Parse the whole file in one pass over its mapping, or over one copy of
+ * it where the file can't be mapped.
  */
 static int image_mot_buffer_complete(struct image *image)
 {
-	char *lpszLine = malloc(1023);
-	if (lpszLine == NULL) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
-	if (section == NULL) {
-		free(lpszLine);
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
-	int retval;
+	struct image_mot *mot = image->type_private;
+	const char *text;
+	size_t len;
+	char *copy;
 
-	retval = image_mot_buffer_complete_inner(image, lpszLine, section);
+	image_hex_table_init();
 
-	free(section);
-	free(lpszLine);
+	int retval = image_text_load(mot->fileio, &text, &len, &copy);
+	if (retval != ERROR_OK)
+		return retval;
+
+	image->sections = NULL;
+	retval = image_mot_parse(image, text, len);
+	free(copy);
+
+	if (retval != ERROR_OK) {
+		free(image->sections);
+		image->sections = NULL;
+		image->num_sections = 0;
+		free(mot->buffer);
+		mot->buffer = NULL;
+	}
 
 	return retval;
 }
@@ -747,6 +821,10 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			return retval;
 		}
 
+		/* sections are read from the mapping when the file can be mapped */
+		if (fileio_map(image_binary->fileio, &image_binary->map) != ERROR_OK)
+			image_binary->map = NULL;
+
 		image->num_sections = 1;
 		image->sections = malloc(sizeof(struct imagesection));
 		image->sections[0].base_address = 0x0;
@@ -757,7 +835,7 @@ int image_open(struct image *image, const char *url, const char *type_string)
 
 		image_ihex = image->type_private = malloc(sizeof(struct image_ihex));
 
-		retval = fileio_open(&image_ihex->fileio, url, FILEIO_READ, FILEIO_TEXT);
+		retval = fileio_open(&image_ihex->fileio, url, FILEIO_READ, FILEIO_BINARY);
 		if (retval != ERROR_OK)
 			return retval;
 
@@ -782,6 +860,12 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(image_elf->fileio);
 			return retval;
 		}
+
+		/* only the pages of the loadable segments are ever touched, not
+		 * the debug info making up most of a typical ELF file */
+		if (fileio_map(image_elf->fileio, &image_elf->map) != ERROR_OK
+				|| fileio_size(image_elf->fileio, &image_elf->map_size) != ERROR_OK)
+			image_elf->map = NULL;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -808,7 +892,7 @@ int image_open(struct image *image, const char *url, const char *type_string)
 
 		image_mot = image->type_private = malloc(sizeof(struct image_mot));
 
-		retval = fileio_open(&image_mot->fileio, url, FILEIO_READ, FILEIO_TEXT);
+		retval = fileio_open(&image_mot->fileio, url, FILEIO_READ, FILEIO_BINARY);
 		if (retval != ERROR_OK)
 			return retval;
 
@@ -867,6 +951,12 @@ int image_read_section(struct image *image,
 		if (section != 0)
 			return ERROR_COMMAND_SYNTAX_ERROR;
 
+		if (image_binary->map) {
+			memcpy(buffer, image_binary->map + offset, size);
+			*size_read = size;
+			return ERROR_OK;
+		}
+
 		/* seek to offset */
 		retval = fileio_seek(image_binary->fileio, offset);
 		if (retval != ERROR_OK)
@@ -936,6 +1026,36 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+int image_map_section(struct image *image, int section,
+		const uint8_t **data, uint8_t **buffer, size_t *size)
+{
+	const uint8_t *p = image_section_pointer(image, section);
+	uint32_t section_size = image->sections[section].size;
+
+	*buffer = NULL;
+	if (p) {
+		*data = p;
+		*size = section_size;
+		return ERROR_OK;
+	}
+
+	*buffer = malloc(section_size);
+	if (*buffer == NULL) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", section_size);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, 0, section_size, *buffer, size);
+	if (retval != ERROR_OK) {
+		free(*buffer);
+		*buffer = NULL;
+		return retval;
+	}
+
+	*data = *buffer;
+	return ERROR_OK;
+}
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size, int flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -991,11 +1111,11 @@ void image_close(struct image *image)
 
 		fileio_close(image_elf->fileio);
 
-		free(image_elf->header);
-		image_elf->header = NULL;
+		free(image_elf->header64);
+		image_elf->header64 = NULL;
 
-		free(image_elf->segments);
-		image_elf->segments = NULL;
+		free(image_elf->segments64);
+		image_elf->segments64 = NULL;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct image_memory *image_memory = image->type_private;
 
@@ -1024,12 +1144,13 @@ void image_close(struct image *image)
 	image->sections = NULL;
 }
 
-int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
+int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
 {
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
+	/* slicing-by-4: crc32_table[k] advances the crc over k + 1 zero bytes */
+	static uint32_t crc32_table[4][256];
 
 	static bool first_init;
 	if (!first_init) {
@@ -1039,8 +1160,13 @@ int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksu
 			/* as per gdb */
 			for (c = i << 24, j = 8; j > 0; --j)
 				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
+			crc32_table[0][i] = c;
 		}
+		for (j = 1; j < 4; j++)
+			for (i = 0; i < 256; i++) {
+				c = crc32_table[j - 1][i];
+				crc32_table[j][i] = (c << 8) ^ crc32_table[0][c >> 24];
+			}
 
 		first_init = true;
 	}
@@ -1050,9 +1176,14 @@ int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksu
 		if (run > 32768)
 			run = 32768;
 		nbytes -= run;
+		for (; run >= 4; run -= 4, buffer += 4) {
+			crc ^= be_to_h_u32(buffer);
+			crc = crc32_table[3][crc >> 24] ^ crc32_table[2][(crc >> 16) & 255]
+				^ crc32_table[1][(crc >> 8) & 255] ^ crc32_table[0][crc & 255];
+		}
 		while (run--) {
 			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
+			crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buffer++) & 255];
 		}
 		keep_alive();
 	}
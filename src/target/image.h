@@ -65,6 +65,7 @@ struct image {
 
 struct image_binary {
 	struct fileio *fileio;
+	const uint8_t *map;		/* file mapping, or NULL */
 };
 
 struct image_ihex {
@@ -80,10 +81,19 @@ struct image_memory {
 
 struct image_elf {
 	struct fileio *fileio;
-	Elf32_Ehdr *header;
-	Elf32_Phdr *segments;
+	bool is_64_bit;
+	union {
+		Elf32_Ehdr *header32;
+		Elf64_Ehdr *header64;
+	};
+	union {
+		Elf32_Phdr *segments32;
+		Elf64_Phdr *segments64;
+	};
 	uint32_t segment_count;
 	uint8_t endianness;
+	const uint8_t *map;		/* file mapping, or NULL */
+	size_t map_size;
 };
 
 struct image_mot {
@@ -96,10 +106,19 @@ int image_read_section(struct image *image, int section, uint32_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
 void image_close(struct image *image);
 
+/**
+ * Get the whole contents of @a section. @a data points right into the
+ * image where possible, e.g. into the mapping of a binary or ELF file,
+ * otherwise into a buffer allocated for the section which is returned in
+ * @a buffer and must be freed by the caller (NULL if nothing was copied).
+ */
+int image_map_section(struct image *image, int section,
+		const uint8_t **data, uint8_t **buffer, size_t *size);
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size,
 		int flags, uint8_t const *data);
 
-int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
+int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
 
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
@@ -0,0 +1,549 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Decoder of ITM and DWT packets (ARMv7-M Architecture Reference Manual,
+ * appendix D4) for the trace that the adapter captures in "tpiu config
+ * internal" mode, with the TPIU formatter bypassed.
+ *
+ * A table built once classifies every header byte and gives the size of
+ * its payload, so the decoder only looks up each header and then copies
+ * payload bytes. Stimulus port data goes to a file or to the connections
+ * of a TCP server per port, the DWT periodic PC samples are kept for
+ * "profile".
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "target.h"
+#include "armv7m.h"
+#include "itm_decode.h"
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/server.h>
+
+#define ITM_PORTS			256
+#define ITM_PC_SAMPLES_MAX	65536
+
+/* payload ends with a byte without continuation bit */
+#define ITM_SIZE_CONT		0xff
+#define ITM_CONT_MAX		6
+
+enum itm_packet_type {
+	ITM_PKT_RESERVED,
+	ITM_PKT_SYNC,
+	ITM_PKT_OVERFLOW,
+	ITM_PKT_LOCAL_TS,
+	ITM_PKT_GLOBAL_TS,
+	ITM_PKT_EXTENSION,
+	ITM_PKT_STIMULUS,
+	ITM_PKT_HARDWARE,
+};
+
+struct itm_header {
+	uint8_t type;
+	uint8_t size;
+};
+
+/* DWT packet discriminator of the periodic PC samples */
+#define DWT_DISC_PC_SAMPLE	2
+
+struct itm_connection {
+	struct list_head list;
+	struct connection *connection;
+};
+
+struct itm_output {
+	FILE *file;
+	char *tcp_port;
+	struct list_head connections;
+};
+
+/* the priv of an output's service, freed by remove_service() */
+struct itm_service {
+	struct itm_output *output;
+};
+
+struct itm_decoder {
+	struct target *target;
+
+	/* packet in progress */
+	uint8_t header;
+	uint8_t type;
+	unsigned int need;
+	unsigned int len;
+	uint8_t payload[ITM_CONT_MAX];
+	bool in_sync;
+
+	/* stimulus port page, set by extension packets */
+	unsigned int page;
+
+	struct itm_output *outputs[ITM_PORTS];
+
+	bool collect_pc;
+	uint32_t *pc_samples;
+	uint32_t pc_count;
+
+	uint64_t packets;
+	uint64_t stimulus_bytes;
+	uint32_t overflows;
+	uint32_t syncs;
+	uint32_t reserved;
+	uint64_t pc_received;
+	uint64_t pc_sleep;
+	uint64_t pc_dropped;
+};
+
+static struct itm_header itm_headers[256];
+static bool itm_headers_built;
+
+static void itm_build_headers(void)
+{
+	static const uint8_t source_size[4] = { 0, 1, 2, 4 };
+
+	for (unsigned int h = 0; h < 256; h++) {
+		struct itm_header *p = &itm_headers[h];
+
+		p->size = 0;
+		if (h == 0x00) {
+			p->type = ITM_PKT_SYNC;
+		} else if (h == 0x70) {
+			p->type = ITM_PKT_OVERFLOW;
+		} else if (h & 0x03) {
+			p->type = (h & 0x04) ? ITM_PKT_HARDWARE : ITM_PKT_STIMULUS;
+			p->size = source_size[h & 0x03];
+		} else if ((h & 0x0f) == 0x00) {
+			p->type = ITM_PKT_LOCAL_TS;
+			p->size = (h & 0x80) ? ITM_SIZE_CONT : 0;
+		} else if ((h & 0x0b) == 0x08) {
+			p->type = ITM_PKT_EXTENSION;
+			p->size = (h & 0x80) ? ITM_SIZE_CONT : 0;
+		} else if ((h & 0xdf) == 0x94) {
+			p->type = ITM_PKT_GLOBAL_TS;
+			p->size = ITM_SIZE_CONT;
+		} else {
+			p->type = ITM_PKT_RESERVED;
+		}
+	}
+
+	itm_headers_built = true;
+}
+
+static void itm_output_write(struct itm_output *output, const uint8_t *data,
+		size_t len)
+{
+	struct itm_connection *entry;
+
+	if (output->file && fwrite(data, 1, len, output->file) != len) {
+		LOG_ERROR("itm: write to the output file failed, closing it");
+		fclose(output->file);
+		output->file = NULL;
+	}
+
+	list_for_each_entry(entry, &output->connections, list)
+		connection_write(entry->connection, data, len);
+}
+
+static void itm_packet(struct itm_decoder *decoder)
+{
+	uint8_t header = decoder->header;
+	uint32_t value;
+
+	decoder->packets++;
+
+	switch (decoder->type) {
+	case ITM_PKT_STIMULUS: {
+		unsigned int port = decoder->page * 32 + (header >> 3);
+		decoder->stimulus_bytes += decoder->len;
+		if (port < ITM_PORTS && decoder->outputs[port])
+			itm_output_write(decoder->outputs[port], decoder->payload,
+					decoder->len);
+		break;
+	}
+	case ITM_PKT_HARDWARE:
+		if ((header >> 3) != DWT_DISC_PC_SAMPLE)
+			break;
+		if (decoder->len != 4) {
+			/* the core was asleep */
+			decoder->pc_sleep++;
+			break;
+		}
+		decoder->pc_received++;
+		if (!decoder->collect_pc)
+			break;
+		if (decoder->pc_count == ITM_PC_SAMPLES_MAX) {
+			decoder->pc_dropped++;
+			break;
+		}
+		value = le_to_h_u32(decoder->payload);
+		decoder->pc_samples[decoder->pc_count++] = value;
+		break;
+	case ITM_PKT_EXTENSION:
+		/* stimulus port page, SH bit clear */
+		if (!(header & 0x04) && !(header & 0x80))
+			decoder->page = (header >> 4) & 0x07;
+		break;
+	case ITM_PKT_OVERFLOW:
+		decoder->overflows++;
+		break;
+	case ITM_PKT_RESERVED:
+		decoder->reserved++;
+		break;
+	default:
+		break;
+	}
+}
+
+static void itm_decode(struct itm_decoder *decoder, const uint8_t *data, size_t len)
+{
+	const uint8_t *end = data + len;
+
+	while (data < end) {
+		uint8_t c;
+
+		/* payload of the packet in progress */
+		if (decoder->need == ITM_SIZE_CONT) {
+			c = *data++;
+			if (decoder->len < ITM_CONT_MAX)
+				decoder->payload[decoder->len++] = c;
+			if (!(c & 0x80) || decoder->len == ITM_CONT_MAX) {
+				decoder->need = 0;
+				itm_packet(decoder);
+			}
+			continue;
+		}
+		if (decoder->need) {
+			size_t count = MIN((size_t)decoder->need, (size_t)(end - data));
+			memcpy(decoder->payload + decoder->len, data, count);
+			decoder->len += count;
+			decoder->need -= count;
+			data += count;
+			if (!decoder->need)
+				itm_packet(decoder);
+			continue;
+		}
+
+		c = *data++;
+
+		/* a synchronization packet is a run of zeros ended by 0x80 */
+		if (decoder->in_sync) {
+			if (c == 0x00)
+				continue;
+			decoder->in_sync = false;
+			if (c == 0x80) {
+				decoder->syncs++;
+				continue;
+			}
+		}
+
+		const struct itm_header *h = &itm_headers[c];
+		if (h->type == ITM_PKT_SYNC) {
+			decoder->in_sync = true;
+			continue;
+		}
+
+		decoder->header = c;
+		decoder->type = h->type;
+		decoder->len = 0;
+		decoder->need = h->size;
+		if (!decoder->need)
+			itm_packet(decoder);
+	}
+}
+
+static int itm_trace_callback(struct target *target, size_t len, uint8_t *data,
+		void *priv)
+{
+	struct itm_decoder *decoder = priv;
+
+	if (target == decoder->target)
+		itm_decode(decoder, data, len);
+
+	return ERROR_OK;
+}
+
+static int itm_new_connection(struct connection *connection)
+{
+	struct itm_service *service = connection->service->priv;
+	struct itm_connection *entry = malloc(sizeof(*entry));
+
+	if (!entry)
+		return ERROR_FAIL;
+
+	entry->connection = connection;
+	list_add_tail(&entry->list, &service->output->connections);
+	return ERROR_OK;
+}
+
+static int itm_input(struct connection *connection)
+{
+	uint8_t buffer[64];
+
+	/* nothing goes to the target, only notice the closed connections */
+	int bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	if (bytes_read < 0) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+	return ERROR_OK;
+}
+
+static int itm_connection_closed(struct connection *connection)
+{
+	struct itm_service *service = connection->service->priv;
+	struct itm_connection *entry;
+
+	list_for_each_entry(entry, &service->output->connections, list) {
+		if (entry->connection == connection) {
+			list_del(&entry->list);
+			free(entry);
+			break;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static void itm_output_free(struct itm_output *output)
+{
+	if (!output)
+		return;
+
+	if (output->file)
+		fclose(output->file);
+	if (output->tcp_port) {
+		remove_service("itm", output->tcp_port);
+		free(output->tcp_port);
+	}
+	free(output);
+}
+
+static struct itm_decoder *itm_decoder_of(struct target *target)
+{
+	if (!target || !is_armv7m(target_to_armv7m(target)))
+		return NULL;
+	return target_to_armv7m(target)->trace_config.itm_decoder;
+}
+
+void itm_decode_free(struct target *target)
+{
+	struct itm_decoder *decoder = itm_decoder_of(target);
+
+	if (!decoder)
+		return;
+
+	target_unregister_trace_callback(itm_trace_callback, decoder);
+	for (unsigned int i = 0; i < ITM_PORTS; i++)
+		itm_output_free(decoder->outputs[i]);
+	free(decoder->pc_samples);
+	free(decoder);
+
+	target_to_armv7m(target)->trace_config.itm_decoder = NULL;
+}
+
+bool itm_decode_collect_pc(struct target *target, bool enable)
+{
+	struct itm_decoder *decoder = itm_decoder_of(target);
+
+	if (!decoder)
+		return false;
+
+	decoder->collect_pc = enable;
+	decoder->pc_count = 0;
+	return true;
+}
+
+uint32_t itm_decode_take_pc(struct target *target, uint32_t *samples, uint32_t max)
+{
+	struct itm_decoder *decoder = itm_decoder_of(target);
+
+	if (!decoder)
+		return 0;
+
+	uint32_t count = MIN(max, decoder->pc_count);
+	memcpy(samples, decoder->pc_samples, count * sizeof(*samples));
+	memmove(decoder->pc_samples, decoder->pc_samples + count,
+			(decoder->pc_count - count) * sizeof(*samples));
+	decoder->pc_count -= count;
+	return count;
+}
+
+static int itm_decode_start(struct command_invocation *cmd, struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct itm_decoder *decoder;
+
+	if (armv7m->trace_config.itm_decoder)
+		return ERROR_OK;
+
+	if (armv7m->trace_config.formatter)
+		command_print(cmd, "warning: decoding needs the TPIU formatter "
+				"to be bypassed, see 'tpiu config'");
+
+	if (!itm_headers_built)
+		itm_build_headers();
+
+	decoder = calloc(1, sizeof(*decoder));
+	if (decoder)
+		decoder->pc_samples = malloc(ITM_PC_SAMPLES_MAX * sizeof(uint32_t));
+	if (!decoder || !decoder->pc_samples) {
+		free(decoder);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	decoder->target = target;
+
+	int retval = target_register_trace_callback(itm_trace_callback, decoder);
+	if (retval != ERROR_OK) {
+		free(decoder->pc_samples);
+		free(decoder);
+		return retval;
+	}
+
+	armv7m->trace_config.itm_decoder = decoder;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	bool enable;
+
+	if (!is_armv7m(target_to_armv7m(target))) {
+		command_print(CMD, "current target isn't an ARMv7-M");
+		return ERROR_TARGET_INVALID;
+	}
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+		if (enable)
+			return itm_decode_start(CMD, target);
+		itm_decode_free(target);
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "itm decoding is %s",
+			itm_decoder_of(target) ? "on" : "off");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_output_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct itm_decoder *decoder = itm_decoder_of(target);
+	unsigned int port;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!decoder) {
+		command_print(CMD, "enable decoding first, see 'itm decode'");
+		return ERROR_FAIL;
+	}
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ITM_PORTS)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	itm_output_free(decoder->outputs[port]);
+	decoder->outputs[port] = NULL;
+
+	if (!strcmp(CMD_ARGV[1], "off"))
+		return CMD_ARGC == 2 ? ERROR_OK : ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct itm_output *output = calloc(1, sizeof(*output));
+	if (!output) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	INIT_LIST_HEAD(&output->connections);
+
+	if (!strcmp(CMD_ARGV[1], "file")) {
+		output->file = fopen(CMD_ARGV[2], "ab");
+		if (!output->file) {
+			command_print(CMD, "can't open %s: %s", CMD_ARGV[2], strerror(errno));
+			free(output);
+			return ERROR_FAIL;
+		}
+	} else if (!strcmp(CMD_ARGV[1], "tcp")) {
+		struct itm_service *service = malloc(sizeof(*service));
+		if (!service) {
+			LOG_ERROR("Out of memory");
+			free(output);
+			return ERROR_FAIL;
+		}
+		service->output = output;
+
+		if (add_service("itm", CMD_ARGV[2], CONNECTION_LIMIT_UNLIMITED,
+					itm_new_connection, itm_input, itm_connection_closed,
+					service) != ERROR_OK) {
+			command_print(CMD, "can't serve port %u on %s", port, CMD_ARGV[2]);
+			free(service);
+			free(output);
+			return ERROR_FAIL;
+		}
+		output->tcp_port = strdup(CMD_ARGV[2]);
+	} else {
+		free(output);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	decoder->outputs[port] = output;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_stats_command)
+{
+	struct itm_decoder *decoder = itm_decoder_of(get_current_target(CMD_CTX));
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!decoder) {
+		command_print(CMD, "itm decoding is off");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "%" PRIu64 " packets, %" PRIu64 " stimulus bytes, %"
+			PRIu32 " syncs, %" PRIu32 " overflows, %" PRIu32 " reserved headers",
+			decoder->packets, decoder->stimulus_bytes, decoder->syncs,
+			decoder->overflows, decoder->reserved);
+	command_print(CMD, "%" PRIu64 " PC samples, %" PRIu64 " asleep, %" PRIu64
+			" dropped", decoder->pc_received, decoder->pc_sleep,
+			decoder->pc_dropped);
+	return ERROR_OK;
+}
+
+const struct command_registration itm_decode_command_handlers[] = {
+	{
+		.name = "decode",
+		.handler = handle_itm_decode_command,
+		.mode = COMMAND_EXEC,
+		.help = "decode the ITM/DWT packets of the captured trace",
+		.usage = "[(0|1|on|off)]",
+	},
+	{
+		.name = "output",
+		.handler = handle_itm_output_command,
+		.mode = COMMAND_EXEC,
+		.help = "send the data of a decoded stimulus port to a file "
+			"or to the connections of a TCP port",
+		.usage = "<port> (off | file <filename> | tcp <tcp_port>)",
+	},
+	{
+		.name = "stats",
+		.handler = handle_itm_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show the packet counters of the decoder",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
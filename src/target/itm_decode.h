@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * Decoder of the ITM/DWT packets in the trace captured by the adapter,
+ * see "itm decode".
+ */
+
+#ifndef OPENOCD_TARGET_ITM_DECODE_H
+#define OPENOCD_TARGET_ITM_DECODE_H
+
+#include <helper/command.h>
+
+struct target;
+struct itm_decoder;
+
+extern const struct command_registration itm_decode_command_handlers[];
+
+/** Stop decoding and close the outputs of @a target. */
+void itm_decode_free(struct target *target);
+
+/**
+ * Start or stop collecting the DWT PC samples of the trace of @a target.
+ * @returns false when the trace of @a target is not decoded.
+ */
+bool itm_decode_collect_pc(struct target *target, bool enable);
+
+/**
+ * Move up to @a max collected PC samples to @a samples.
+ * @returns the number of samples moved.
+ */
+uint32_t itm_decode_take_pc(struct target *target, uint32_t *samples, uint32_t max);
+
+#endif /* OPENOCD_TARGET_ITM_DECODE_H */
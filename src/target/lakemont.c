@@ -58,6 +58,8 @@ static int read_all_core_hw_regs(struct target *t);
 static int write_all_core_hw_regs(struct target *t);
 static int read_hw_reg(struct target *t,
 			int reg, uint32_t *regval, uint8_t cache);
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *pdr);
+static int queue_write_hw_reg(struct target *t, int reg, uint32_t regval);
 static int write_hw_reg(struct target *t,
 			int reg, uint32_t regval, uint8_t cache);
 static struct reg_cache *lakemont_build_reg_cache
@@ -604,26 +606,54 @@ static int do_resume(struct target *t)
 	return target_call_event_callbacks(t, TARGET_EVENT_RESUMED);
 }
 
+/*
+ * All the registers are queued and read back with a single flush, the
+ * PDR captures are decoded into the reg cache afterwards.
+ */
 static int read_all_core_hw_regs(struct target *t)
 {
-	int err;
-	uint32_t regval;
+	int err = ERROR_OK;
 	unsigned i;
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	uint8_t *pdr = malloc(x86_32->cache->num_regs * (PDR_SIZE / 8));
+	if (pdr == NULL) {
+		LOG_ERROR("%s out of memory", __func__);
+		return ERROR_FAIL;
+	}
+
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (NOT_AVAIL_REG == regs[i].pm_idx)
 			continue;
-		err = read_hw_reg(t, regs[i].id, &regval, 1);
+		err = queue_read_hw_reg(t, regs[i].id, pdr + i * (PDR_SIZE / 8));
 		if (err != ERROR_OK) {
 			LOG_ERROR("%s error saving reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
-			return err;
+			goto out;
 		}
 	}
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		goto out;
+	}
+
+	for (i = 0; i < (x86_32->cache->num_regs); i++) {
+		if (NOT_AVAIL_REG == regs[i].pm_idx)
+			continue;
+		struct reg *r = &x86_32->cache->reg_list[regs[i].id];
+		buf_cpy(pdr + i * (PDR_SIZE / 8), r->value, 32);
+		r->valid = true;
+		r->dirty = false;
+	}
 	LOG_DEBUG("read_all_core_hw_regs read %u registers ok", i);
-	return ERROR_OK;
+
+out:
+	x86_32->flush = 1;
+	free(pdr);
+	return err;
 }
 
+/* all the registers are queued and written with a single flush */
 static int write_all_core_hw_regs(struct target *t)
 {
 	int err;
@@ -632,23 +662,34 @@ static int write_all_core_hw_regs(struct target *t)
 	for (i = 0; i < (x86_32->cache->num_regs); i++) {
 		if (NOT_AVAIL_REG == regs[i].pm_idx)
 			continue;
-		err = write_hw_reg(t, i, 0, 1);
+		err = queue_write_hw_reg(t, i,
+				buf_get_u32(x86_32->cache->reg_list[i].value, 0, 32));
 		if (err != ERROR_OK) {
 			LOG_ERROR("%s error restoring reg %s",
 					__func__, x86_32->cache->reg_list[i].name);
+			x86_32->flush = 1;
 			return err;
 		}
+		x86_32->cache->reg_list[i].dirty = false;
+		x86_32->cache->reg_list[i].valid = false;
+	}
+	x86_32->flush = 1;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		return err;
 	}
 	LOG_DEBUG("write_all_core_hw_regs wrote %u registers ok", i);
 	return ERROR_OK;
 }
 
-/* read reg from lakemont core shadow ram, update reg cache if needed */
-static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cache)
+/*
+ * queue the read of a reg from lakemont core shadow ram, its value is in
+ * pdr once the queue is executed
+ */
+static int queue_read_hw_reg(struct target *t, int reg, uint8_t *pdr)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
-	struct lakemont_core_reg *arch_info;
-	arch_info = x86_32->cache->reg_list[reg].arch_info;
 	x86_32->flush = 0; /* don't flush scans till we have a batch */
 	if (submit_reg_pir(t, reg) != ERROR_OK)
 		return ERROR_FAIL;
@@ -656,14 +697,31 @@ static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cach
 		return ERROR_FAIL;
 	if (submit_instruction_pir(t, SRAM2PDR) != ERROR_OK)
 		return ERROR_FAIL;
-	x86_32->flush = 1;
 	scan.out[0] = RDWRPDR;
 	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
 		return ERROR_FAIL;
-	if (drscan(t, NULL, scan.out, PDR_SIZE) != ERROR_OK)
+	if (drscan(t, NULL, pdr, PDR_SIZE) != ERROR_OK)
 		return ERROR_FAIL;
-
 	jtag_add_sleep(DELAY_SUBMITPIR);
+	return ERROR_OK;
+}
+
+/* read reg from lakemont core shadow ram, update reg cache if needed */
+static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cache)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	struct lakemont_core_reg *arch_info;
+	arch_info = x86_32->cache->reg_list[reg].arch_info;
+	int err = queue_read_hw_reg(t, reg, scan.out);
+	x86_32->flush = 1;
+	if (err != ERROR_OK)
+		return err;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		return err;
+	}
+
 	*regval = buf_get_u32(scan.out, 0, 32);
 	if (cache) {
 		buf_set_u32(x86_32->cache->reg_list[reg].value, 0, 32, *regval);
@@ -677,21 +735,12 @@ static int read_hw_reg(struct target *t, int reg, uint32_t *regval, uint8_t cach
 	return ERROR_OK;
 }
 
-/* write lakemont core shadow ram reg, update reg cache if needed */
-static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cache)
+/* queue the write of a lakemont core shadow ram reg */
+static int queue_write_hw_reg(struct target *t, int reg, uint32_t regval)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
-	struct lakemont_core_reg *arch_info;
-	arch_info = x86_32->cache->reg_list[reg].arch_info;
-
 	uint8_t reg_buf[4];
-	if (cache)
-		regval = buf_get_u32(x86_32->cache->reg_list[reg].value, 0, 32);
 	buf_set_u32(reg_buf, 0, 32, regval);
-	LOG_DEBUG("reg=%s, op=0x%016" PRIx64 ", val=0x%08" PRIx32,
-			x86_32->cache->reg_list[reg].name,
-			arch_info->op,
-			regval);
 
 	x86_32->flush = 0; /* don't flush scans till we have a batch */
 	if (submit_reg_pir(t, reg) != ERROR_OK)
@@ -701,11 +750,37 @@ static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cach
 	scan.out[0] = RDWRPDR;
 	if (irscan(t, scan.out, NULL, LMT_IRLEN) != ERROR_OK)
 		return ERROR_FAIL;
+	/* the out value is copied when queued, the capture is not needed */
 	if (drscan(t, reg_buf, scan.out, PDR_SIZE) != ERROR_OK)
 		return ERROR_FAIL;
-	x86_32->flush = 1;
 	if (submit_instruction_pir(t, PDR2SRAM) != ERROR_OK)
 		return ERROR_FAIL;
+	return ERROR_OK;
+}
+
+/* write lakemont core shadow ram reg, update reg cache if needed */
+static int write_hw_reg(struct target *t, int reg, uint32_t regval, uint8_t cache)
+{
+	struct x86_32_common *x86_32 = target_to_x86_32(t);
+	struct lakemont_core_reg *arch_info;
+	arch_info = x86_32->cache->reg_list[reg].arch_info;
+
+	if (cache)
+		regval = buf_get_u32(x86_32->cache->reg_list[reg].value, 0, 32);
+	LOG_DEBUG("reg=%s, op=0x%016" PRIx64 ", val=0x%08" PRIx32,
+			x86_32->cache->reg_list[reg].name,
+			arch_info->op,
+			regval);
+
+	int err = queue_write_hw_reg(t, reg, regval);
+	x86_32->flush = 1;
+	if (err != ERROR_OK)
+		return err;
+	err = jtag_execute_queue();
+	if (err != ERROR_OK) {
+		LOG_ERROR("%s failed to execute queue", __func__);
+		return err;
+	}
 
 	/* we are writing from the cache so ensure we reset flags */
 	if (cache) {
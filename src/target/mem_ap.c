@@ -22,11 +22,25 @@
 #include "arm_adi_v5.h"
 
 #include <jtag/jtag.h>
+#include <helper/time_support.h>
+
+/* Bytes moved per transfer of "mem_ap copy" */
+#define MEM_AP_COPY_CHUNK	8192
+
+/* Traffic of one kind through the AP, for "mem_ap stats" */
+struct mem_ap_counter {
+	uint64_t bytes;
+	int64_t us;
+};
 
 struct mem_ap {
 	struct arm arm;
 	struct adiv5_ap *ap;
 	int ap_num;
+
+	struct mem_ap_counter read;
+	struct mem_ap_counter write;
+	struct mem_ap_counter copy;
 };
 
 static int mem_ap_target_create(struct target *target, Jim_Interp *interp)
@@ -144,6 +158,12 @@ static int mem_ap_deassert_reset(struct target *target)
 	return ERROR_OK;
 }
 
+static void mem_ap_count(struct mem_ap_counter *counter, uint64_t bytes, int64_t start)
+{
+	counter->bytes += bytes;
+	counter->us += timeval_us() - start;
+}
+
 static int mem_ap_read_memory(struct target *target, target_addr_t address,
 			       uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -155,7 +175,11 @@ static int mem_ap_read_memory(struct target *target, target_addr_t address,
 	if (count == 0 || buffer == NULL)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	return mem_ap_read_buf(mem_ap->ap, buffer, size, count, address);
+	int64_t start = timeval_us();
+	int retval = mem_ap_read_buf(mem_ap->ap, buffer, size, count, address);
+	if (retval == ERROR_OK)
+		mem_ap_count(&mem_ap->read, size * count, start);
+	return retval;
 }
 
 static int mem_ap_write_memory(struct target *target, target_addr_t address,
@@ -170,11 +194,206 @@ static int mem_ap_write_memory(struct target *target, target_addr_t address,
 	if (count == 0 || buffer == NULL)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	return mem_ap_write_buf(mem_ap->ap, buffer, size, count, address);
+	int64_t start = timeval_us();
+	int retval = mem_ap_write_buf(mem_ap->ap, buffer, size, count, address);
+	if (retval == ERROR_OK)
+		mem_ap_count(&mem_ap->write, size * count, start);
+	return retval;
 }
 
+static struct mem_ap *target_to_mem_ap(struct command_invocation *cmd, struct target *target)
+{
+	if (strcmp(target_type_name(target), "mem_ap")) {
+		command_print(cmd, "target %s is not a mem_ap target", target_name(target));
+		return NULL;
+	}
+	if (!target_was_examined(target)) {
+		command_print(cmd, "target %s not examined yet", target_name(target));
+		return NULL;
+	}
+	return target->arch_info;
+}
+
+/*
+ * Copy a block between two addresses, possibly through different APs, in
+ * chunks. The write of a chunk is queued together with the read of the next
+ * one in a single run of the DAP queue, so the data only makes one round
+ * trip through the host per chunk. The ranges must not overlap.
+ */
+static int mem_ap_copy(struct mem_ap *src, struct mem_ap *dst, uint32_t src_address,
+		uint32_t dst_address, uint32_t len)
+{
+	uint32_t size = (src_address | dst_address | len) & 3 ? 1 : 4;
+	uint8_t *buf[2];
+	int retval = ERROR_OK;
+
+	uint8_t *mem = malloc(2 * MEM_AP_COPY_CHUNK);
+	if (!mem) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	buf[0] = mem;
+	buf[1] = mem + MEM_AP_COPY_CHUNK;
+
+	int64_t start = timeval_us();
+	uint32_t pending = 0;	/* bytes read into buf[1] and not yet written */
+	uint32_t offset = 0;	/* of the next chunk to read */
+	while (retval == ERROR_OK && (pending || offset < len)) {
+		uint32_t n = MIN(len - offset, MEM_AP_COPY_CHUNK);
+		struct mem_ap_job jobs[2];
+		unsigned int job_count = 0;
+
+		if (pending) {
+			jobs[job_count++] = (struct mem_ap_job) {
+				.ap = dst->ap,
+				.write = true,
+				.buffer = buf[1],
+				.size = size,
+				.count = pending / size,
+				.address = dst_address + offset - pending,
+			};
+		}
+		if (n) {
+			jobs[job_count++] = (struct mem_ap_job) {
+				.ap = src->ap,
+				.buffer = buf[0],
+				.size = size,
+				.count = n / size,
+				.address = src_address + offset,
+			};
+		}
+
+		retval = mem_ap_run_jobs(jobs, job_count);
+
+		uint8_t *tmp = buf[0];
+		buf[0] = buf[1];
+		buf[1] = tmp;
+		pending = n;
+		offset += n;
+	}
+
+	free(mem);
+
+	if (retval == ERROR_OK) {
+		mem_ap_count(&src->copy, len, start);
+		if (dst != src)
+			mem_ap_count(&dst->copy, len, start);
+	}
+	return retval;
+}
+
+COMMAND_HANDLER(mem_ap_handle_copy_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target *dst_target = target;
+	uint32_t src_address, dst_address, len;
+
+	if (CMD_ARGC < 3 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], src_address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], dst_address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], len);
+	if (CMD_ARGC > 3) {
+		dst_target = get_target(CMD_ARGV[3]);
+		if (!dst_target) {
+			command_print(CMD, "unknown target %s", CMD_ARGV[3]);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	struct mem_ap *src = target_to_mem_ap(CMD, target);
+	struct mem_ap *dst = target_to_mem_ap(CMD, dst_target);
+	if (!src || !dst)
+		return ERROR_TARGET_INVALID;
+
+	if (len == 0)
+		return ERROR_OK;
+	if (src_address + len < src_address || dst_address + len < dst_address) {
+		command_print(CMD, "range wraps around the address space");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct duration bench;
+	duration_start(&bench);
+
+	int retval = mem_ap_copy(src, dst, src_address, dst_address, len);
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK)
+		command_print(CMD, "copied %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				len, duration_elapsed(&bench), duration_kbps(&bench, len));
+
+	return retval;
+}
+
+static void mem_ap_print_counter(struct command_invocation *cmd, const char *name,
+		const struct mem_ap_counter *counter)
+{
+	double kbps = counter->us ? counter->bytes * 1e6 / 1024 / counter->us : 0;
+
+	command_print(cmd, "%-6s %12" PRIu64 " bytes %10" PRId64 " ms %10.1f KiB/s",
+			name, counter->bytes, counter->us / 1000, kbps);
+}
+
+COMMAND_HANDLER(mem_ap_handle_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1 || (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset")))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(target_type_name(target), "mem_ap")) {
+		command_print(CMD, "target %s is not a mem_ap target", target_name(target));
+		return ERROR_TARGET_INVALID;
+	}
+	struct mem_ap *mem_ap = target->arch_info;
+
+	if (CMD_ARGC == 1) {
+		memset(&mem_ap->read, 0, sizeof(mem_ap->read));
+		memset(&mem_ap->write, 0, sizeof(mem_ap->write));
+		memset(&mem_ap->copy, 0, sizeof(mem_ap->copy));
+		return ERROR_OK;
+	}
+
+	mem_ap_print_counter(CMD, "read", &mem_ap->read);
+	mem_ap_print_counter(CMD, "write", &mem_ap->write);
+	mem_ap_print_counter(CMD, "copy", &mem_ap->copy);
+	return ERROR_OK;
+}
+
+static const struct command_registration mem_ap_exec_command_handlers[] = {
+	{
+		.name = "copy",
+		.handler = mem_ap_handle_copy_command,
+		.mode = COMMAND_EXEC,
+		.help = "copy a block of memory through the AP of this target "
+			"to the AP of another mem_ap target, or of this one",
+		.usage = "src_address dst_address length [dst_target]",
+	},
+	{
+		.name = "stats",
+		.handler = mem_ap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset the amount and speed of the memory "
+			"accesses through the AP",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration mem_ap_command_handlers[] = {
+	{
+		.name = "mem_ap",
+		.mode = COMMAND_ANY,
+		.help = "mem_ap command group",
+		.usage = "",
+		.chain = mem_ap_exec_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 struct target_type mem_ap_target = {
 	.name = "mem_ap",
+	.commands = mem_ap_command_handlers,
 
 	.target_create = mem_ap_target_create,
 	.init_target = mem_ap_init_target,
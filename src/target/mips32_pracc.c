@@ -996,7 +996,7 @@ int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info, struct working_are
 	/* Send the load start address */
 	uint32_t val = addr;
 	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
-	mips_ejtag_fastdata_scan(ejtag_info, 1, &val);
+	mips_ejtag_fastdata_scan(ejtag_info, 1, &val, NULL);
 
 	retval = wait_for_pracc_rw(ejtag_info);
 	if (retval != ERROR_OK)
@@ -1005,23 +1005,42 @@ int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info, struct working_are
 	/* Send the load end address */
 	val = addr + (count - 1) * 4;
 	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
-	mips_ejtag_fastdata_scan(ejtag_info, 1, &val);
+	mips_ejtag_fastdata_scan(ejtag_info, 1, &val, NULL);
 
 	unsigned num_clocks = 0;	/* like in legacy code */
 	if (ejtag_info->mode != 0)
 		num_clocks = ((uint64_t)(ejtag_info->scan_delay) * jtag_get_speed_khz() + 500000) / 1000000;
 
+	/* All the words go in one queue, without waiting for PrAcc. Whether the
+	 * core kept up is checked afterwards through SPrAcc of each scan. */
+	uint8_t *spracc = calloc(count, sizeof(*spracc));
+	if (spracc == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
 	for (int i = 0; i < count; i++) {
 		jtag_add_clocks(num_clocks);
-		mips_ejtag_fastdata_scan(ejtag_info, write_t, buf++);
+		mips_ejtag_fastdata_scan(ejtag_info, write_t, buf++, &spracc[i]);
 	}
 
 	retval = jtag_execute_queue();
 	if (retval != ERROR_OK) {
+		free(spracc);
 		LOG_ERROR("fastdata load failed");
 		return retval;
 	}
 
+	int missed = 0;
+	for (int i = 0; i < count; i++)
+		missed += !(spracc[i] & 1);
+	free(spracc);
+	if (missed) {
+		LOG_ERROR("fastdata: %d of %d words were not transferred, "
+				"lower the adapter speed or raise scan_delay", missed, count);
+		return ERROR_FAIL;
+	}
+
 	retval = mips32_pracc_read_ctrl_addr(ejtag_info);
 	if (retval != ERROR_OK)
 		return retval;
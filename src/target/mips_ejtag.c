@@ -418,7 +418,13 @@ int mips_ejtag_init(struct mips_ejtag *ejtag_info)
 	return ERROR_OK;
 }
 
-int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_t *data)
+/**
+ * Queue a FASTDATA scan. If @a spracc isn't NULL, bit 0 of it is set once
+ * the queue ran if the processor access completed, i.e. the word was
+ * actually transferred.
+ */
+int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_t *data,
+		uint8_t *spracc)
 {
 	assert(ejtag_info->tap != NULL);
 	struct jtag_tap *tap = ejtag_info->tap;
@@ -428,9 +434,9 @@ int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_
 	/* fastdata 1-bit register */
 	fields[0].num_bits = 1;
 
-	uint8_t spracc = 0;
-	fields[0].out_value = &spracc;
-	fields[0].in_value = NULL;
+	static const uint8_t spracc_out;
+	fields[0].out_value = &spracc_out;
+	fields[0].in_value = spracc;
 
 	/* processor access data register 32 bit */
 	fields[1].num_bits = 32;
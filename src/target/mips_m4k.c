@@ -47,6 +47,8 @@ static int mips_m4k_internal_restore(struct target *target, int current,
 static int mips_m4k_halt(struct target *target);
 static int mips_m4k_bulk_write_memory(struct target *target, target_addr_t address,
 		uint32_t count, const uint8_t *buffer);
+static int mips_m4k_bulk_read_memory(struct target *target, target_addr_t address,
+		uint32_t count, uint8_t *buffer);
 
 static int mips_m4k_examine_debug_reason(struct target *target)
 {
@@ -233,7 +235,7 @@ static int mips_m4k_poll(struct target *target)
 			if (retval != ERROR_OK)
 				return retval;
 
-			if (target->smp &&
+			if (target->smp && !target->smp_nonstop &&
 				((prev_target_state == TARGET_RUNNING)
 			     || (prev_target_state == TARGET_RESET))) {
 				retval = update_halt_gdb(target);
@@ -248,7 +250,7 @@ static int mips_m4k_poll(struct target *target)
 			if (retval != ERROR_OK)
 				return retval;
 
-			if (target->smp) {
+			if (target->smp && !target->smp_nonstop) {
 				retval = update_halt_gdb(target);
 				if (retval != ERROR_OK)
 					return retval;
@@ -528,7 +530,7 @@ static int mips_m4k_resume(struct target *target, int current,
 				handle_breakpoints,
 				debug_execution);
 
-	if (retval == ERROR_OK && target->smp) {
+	if (retval == ERROR_OK && target->smp && !target->smp_nonstop) {
 		target->gdb_service->core[0] = -1;
 		retval = mips_m4k_restore_smp(target, address, handle_breakpoints);
 	}
@@ -1040,6 +1042,14 @@ static int mips_m4k_read_memory(struct target *target, target_addr_t address,
 	if (((size == 4) && (address & 0x3u)) || ((size == 2) && (address & 0x1u)))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	/* the fastdata handler needs a working area, and plain pracc reads
+	 * are used without one. With DMA access, reads are fast already. */
+	if (size == 4 && count > 32 && (ejtag_info->impcode & EJTAG_IMP_NODMA)
+			&& (mips32->fast_data_area
+				|| target_get_working_area_avail(target) >= MIPS32_FASTDATA_HANDLER_SIZE)
+			&& mips_m4k_bulk_read_memory(target, address, count, buffer) == ERROR_OK)
+		return ERROR_OK;
+
 	/* since we don't know if buffer is aligned, we allocate new mem that is always aligned */
 	void *t = NULL;
 
@@ -1092,7 +1102,11 @@ static int mips_m4k_write_memory(struct target *target, target_addr_t address,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	if (size == 4 && count > 32) {
+	/* use the fastdata handler whenever a working area can hold it,
+	 * without one don't even try */
+	if (size == 4 && count > 32
+			&& (mips32->fast_data_area
+				|| target_get_working_area_avail(target) >= MIPS32_FASTDATA_HANDLER_SIZE)) {
 		int retval = mips_m4k_bulk_write_memory(target, address, count, buffer);
 		if (retval == ERROR_OK)
 			return ERROR_OK;
@@ -1202,17 +1216,15 @@ static int mips_m4k_examine(struct target *target)
 	return mips32_examine(target);
 }
 
-static int mips_m4k_bulk_write_memory(struct target *target, target_addr_t address,
-		uint32_t count, const uint8_t *buffer)
+/* Get the (preserved) working area of the fastdata handler, which must not
+ * overlap the @a count words at @a address being transferred */
+static int mips_m4k_fastdata_area(struct target *target, target_addr_t address,
+		uint32_t count)
 {
 	struct mips32_common *mips32 = target_to_mips32(target);
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
 	struct working_area *fast_data_area;
 	int retval;
-	int write_t = 1;
-
-	LOG_DEBUG("address: " TARGET_ADDR_FMT ", count: 0x%8.8" PRIx32 "",
-			  address, count);
 
 	/* check alignment */
 	if (address & 0x3u)
@@ -1238,14 +1250,32 @@ static int mips_m4k_bulk_write_memory(struct target *target, target_addr_t addre
 	fast_data_area = mips32->fast_data_area;
 
 	if (address <= fast_data_area->address + fast_data_area->size &&
-			fast_data_area->address <= address + count) {
-		LOG_ERROR("fast_data (" TARGET_ADDR_FMT ") is within write area "
+			fast_data_area->address <= address + count * 4) {
+		LOG_ERROR("fast_data (" TARGET_ADDR_FMT ") is within transfer area "
 			  "(" TARGET_ADDR_FMT "-" TARGET_ADDR_FMT ").",
-			  fast_data_area->address, address, address + count);
+			  fast_data_area->address, address, address + count * 4);
 		LOG_ERROR("Change work-area-phys or load_image address!");
 		return ERROR_FAIL;
 	}
 
+	return ERROR_OK;
+}
+
+static int mips_m4k_bulk_write_memory(struct target *target, target_addr_t address,
+		uint32_t count, const uint8_t *buffer)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
+	int write_t = 1;
+
+	LOG_DEBUG("address: " TARGET_ADDR_FMT ", count: 0x%8.8" PRIx32 "",
+			  address, count);
+
+	retval = mips_m4k_fastdata_area(target, address, count);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* mips32_pracc_fastdata_xfer requires uint32_t in host endianness, */
 	/* but byte array represents target endianness                      */
 	uint32_t *t = NULL;
@@ -1268,6 +1298,40 @@ static int mips_m4k_bulk_write_memory(struct target *target, target_addr_t addre
 	return retval;
 }
 
+/* Same handler as the bulk write, running the other way round: the core
+ * copies memory into the fastdata area and the host collects each word */
+static int mips_m4k_bulk_read_memory(struct target *target, target_addr_t address,
+		uint32_t count, uint8_t *buffer)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
+
+	LOG_DEBUG("address: " TARGET_ADDR_FMT ", count: 0x%8.8" PRIx32 "",
+			  address, count);
+
+	retval = mips_m4k_fastdata_area(target, address, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t *t = malloc(count * sizeof(uint32_t));
+	if (t == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = mips32_pracc_fastdata_xfer(ejtag_info, mips32->fast_data_area, 0, address,
+			count, t);
+	if (retval == ERROR_OK)
+		target_buffer_set_u32_array(target, buffer, count, t);
+	else
+		LOG_ERROR("Fastdata access Failed");
+
+	free(t);
+
+	return retval;
+}
+
 static int mips_m4k_verify_pointer(struct command_invocation *cmd,
 		struct mips_m4k_common *mips_m4k)
 {
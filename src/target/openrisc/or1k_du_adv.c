@@ -135,9 +135,13 @@
 #define BURST_READ_READY		1
 #define MAX_BUS_ERRORS			2
 
-#define MAX_BURST_SIZE			(4 * 1024)
+/* The burst length is a 16 bit field of the burst command */
+#define MAX_BURST_SIZE			0xffff
 
-#define STATUS_BYTES			1
+/* The status bit is searched in the first STATUS_BYTES of a burst read.
+ * The command and the data scans are queued back to back, so this is all
+ * the time the bus has to deliver the first word. */
+#define STATUS_BYTES			4
 #define CRC_LEN				4
 
 static struct or1k_du or1k_du_adv;
@@ -158,6 +162,24 @@ static uint32_t adbg_compute_crc(uint32_t crc, uint32_t data_in,
 	return crc;
 }
 
+/* Same CRC as adbg_compute_crc(), a byte at a time over a whole burst */
+static uint32_t adbg_compute_crc_buf(uint32_t crc, const uint8_t *data, int len)
+{
+	static uint32_t table[256];
+	static bool table_ready;
+
+	if (!table_ready) {
+		for (int i = 0; i < 256; i++)
+			table[i] = adbg_compute_crc(0, i, 8);
+		table_ready = true;
+	}
+
+	for (int i = 0; i < len; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
 static int find_status_bit(void *_buf, int len)
 {
 	int i = 0;
@@ -419,6 +441,8 @@ static int adbg_ctrl_read(struct or1k_jtag *jtag_info, uint32_t regidx,
  * 4-bit opcode
  * 32-bit address
  * 16-bit length (of the burst, in words)
+ * The command is only queued, the caller queues the data scan after it
+ * and executes both at once.
  */
 static int adbg_burst_command(struct or1k_jtag *jtag_info, uint32_t opcode,
 			      uint32_t address, uint16_t length_words)
@@ -438,7 +462,7 @@ static int adbg_burst_command(struct or1k_jtag *jtag_info, uint32_t opcode,
 
 	jtag_add_dr_scan(jtag_info->tap, 1, &field, TAP_IDLE);
 
-	return jtag_execute_queue();
+	return ERROR_OK;
 }
 
 static int adbg_wb_burst_read(struct or1k_jtag *jtag_info, int size,
@@ -494,6 +518,10 @@ static int adbg_wb_burst_read(struct or1k_jtag *jtag_info, int size,
 	int total_size_bytes = count * size;
 	struct scan_field field;
 	uint8_t *in_buffer = malloc(total_size_bytes + CRC_LEN + STATUS_BYTES);
+	if (in_buffer == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
 retry_read_full:
 
@@ -533,9 +561,7 @@ retry_read_full:
 	memcpy(data, in_buffer, total_size_bytes);
 	memcpy(&crc_read, &in_buffer[total_size_bytes], 4);
 
-	uint32_t crc_calc = 0xffffffff;
-	for (int i = 0; i < total_size_bytes; i++)
-		crc_calc = adbg_compute_crc(crc_calc, data[i], 8);
+	uint32_t crc_calc = adbg_compute_crc_buf(0xffffffff, data, total_size_bytes);
 
 	if (crc_calc != crc_read) {
 		LOG_WARNING("CRC ERROR! Computed 0x%08" PRIx32 ", read CRC 0x%08" PRIx32, crc_calc, crc_read);
@@ -661,9 +687,7 @@ retry_full_write:
 	field[0].out_value = &value;
 	field[0].in_value = NULL;
 
-	uint32_t crc_calc = 0xffffffff;
-	for (int i = 0; i < (count * size); i++)
-		crc_calc = adbg_compute_crc(crc_calc, data[i], 8);
+	uint32_t crc_calc = adbg_compute_crc_buf(0xffffffff, data, count * size);
 
 	field[1].num_bits = count * size * 8;
 	field[1].out_value = data;
@@ -40,6 +40,8 @@ static void riscv013_clear_abstract_error(struct target *target);
 /* Implementations of the functions in riscv_info_t. */
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int hid, int rid);
+static int riscv013_get_registers(struct target *target,
+		riscv_reg_t *values, int hid, int first, unsigned count);
 static int riscv013_set_register(struct target *target, int hartid, int regid, uint64_t value);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_prep(struct target *target);
@@ -53,6 +55,8 @@ static bool riscv013_is_halted(struct target *target);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
 static int riscv013_write_debug_buffer(struct target *target, unsigned index,
 		riscv_insn_t d);
+static int riscv013_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count);
 static riscv_insn_t riscv013_read_debug_buffer(struct target *target, unsigned
 		index);
 static int riscv013_execute_debug_buffer(struct target *target);
@@ -75,6 +79,7 @@ void write_memory_sba_simple(struct target *target, target_addr_t addr, uint32_t
 void read_memory_sba_simple(struct target *target, target_addr_t addr,
 		uint32_t *rd_buf, uint32_t read_size, uint32_t sbcs);
 static int	riscv013_test_compliance(struct target *target);
+static int riscv013_print_info(struct command_invocation *cmd, struct target *target);
 
 /**
  * Since almost everything can be accomplish by scanning the dbus register, all
@@ -155,6 +160,10 @@ typedef struct {
 	/* The currently selected hartid on this DM. */
 	int current_hartid;
 	bool hasel_supported;
+	/* The hart array mask last written, in the first hawindow_valid windows,
+	 * so that halting or resuming the same group again writes nothing. */
+	uint32_t hawindow[32];
+	unsigned int hawindow_valid;
 
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
@@ -166,6 +175,29 @@ typedef struct {
 	struct target *target;
 } target_list_t;
 
+/* The kinds of access which learn their own number of idle cycles. */
+enum riscv013_delay {
+	RISCV013_DELAY_DMI,
+	RISCV013_DELAY_AC,
+	RISCV013_DELAY_SB_READ,
+	RISCV013_DELAY_SB_WRITE,
+	RISCV013_DELAYS
+};
+
+static const char * const riscv013_delay_names[RISCV013_DELAYS] = {
+	"dmi", "abstract", "sba read", "sba write",
+};
+
+/* After this many operations without a busy response a delay is lowered. */
+#define RISCV013_DELAY_DECAY_OPS	1000
+
+struct riscv013_delay_stats {
+	uint64_t ops;
+	uint64_t busy;
+	/* operations since the last busy response or decay */
+	unsigned int clean;
+};
+
 typedef struct {
 	/* The indexed used to address this hart in its DM. */
 	unsigned index;
@@ -203,6 +235,14 @@ typedef struct {
 	 * go low. */
 	unsigned int ac_busy_delay;
 
+	/* Busy responses of each kind of access, see delay_busy(). */
+	struct riscv013_delay_stats delay_stats[RISCV013_DELAYS];
+
+	/* Whether abstract memory writes work, and with aampostincrement. This
+	 * is learned by the first abstract memory write. */
+	yes_no_maybe_t abstract_mem_write;
+	yes_no_maybe_t abstract_mem_postincrement;
+
 	bool abstract_read_csr_supported;
 	bool abstract_write_csr_supported;
 	bool abstract_read_fpr_supported;
@@ -233,6 +273,57 @@ static riscv013_info_t *get_info(const struct target *target)
 	return (riscv013_info_t *) info->version_specific;
 }
 
+static unsigned int *delay_of(riscv013_info_t *info, enum riscv013_delay delay)
+{
+	switch (delay) {
+		case RISCV013_DELAY_DMI:
+			return &info->dmi_busy_delay;
+		case RISCV013_DELAY_AC:
+			return &info->ac_busy_delay;
+		case RISCV013_DELAY_SB_READ:
+			return &info->bus_master_read_delay;
+		case RISCV013_DELAY_SB_WRITE:
+		default:
+			return &info->bus_master_write_delay;
+	}
+}
+
+/* An access came back busy, so more idle cycles are needed. */
+static void delay_busy(struct target *target, enum riscv013_delay delay)
+{
+	riscv013_info_t *info = get_info(target);
+	struct riscv013_delay_stats *stats = &info->delay_stats[delay];
+	unsigned int *value = delay_of(info, delay);
+
+	stats->ops++;
+	stats->busy++;
+	stats->clean = 0;
+	*value += *value / 10 + 1;
+}
+
+/* @a ops accesses completed without a busy response. A delay which was
+ * raised by a single slow access decays again, so that it doesn't slow down
+ * the rest of the session; if it was really needed, it is raised again by
+ * one busy response every RISCV013_DELAY_DECAY_OPS accesses. */
+static void delay_success(struct target *target, enum riscv013_delay delay,
+		unsigned int ops)
+{
+	riscv013_info_t *info = get_info(target);
+	struct riscv013_delay_stats *stats = &info->delay_stats[delay];
+	unsigned int *value = delay_of(info, delay);
+
+	stats->ops += ops;
+	stats->clean += ops;
+	if (stats->clean < RISCV013_DELAY_DECAY_OPS)
+		return;
+
+	stats->clean = 0;
+	if (*value) {
+		*value -= *value / 8 + 1;
+		LOG_DEBUG("%s delay decayed to %d", riscv013_delay_names[delay], *value);
+	}
+}
+
 /**
  * Return the DM structure for this target. If there isn't one, find it in the
  * global list of DMs. If it's not in there, then create one and initialize it
@@ -458,7 +549,7 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 static void increase_dmi_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
-	info->dmi_busy_delay += info->dmi_busy_delay / 10 + 1;
+	delay_busy(target, RISCV013_DELAY_DMI);
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
 			info->ac_busy_delay);
@@ -641,6 +732,7 @@ static int dmi_op_timeout(struct target *target, uint32_t *data_in,
 		}
 	}
 
+	delay_success(target, RISCV013_DELAY_DMI, 1);
 	return ERROR_OK;
 }
 
@@ -670,9 +762,29 @@ static int dmi_read_exec(struct target *target, uint32_t *value, uint32_t addres
 	return dmi_op(target, value, NULL, DMI_OP_READ, address, 0, true, true);
 }
 
+/* Keep the program buffer cache coherent with a DMI write: a program buffer
+ * word holds what was written, clearing dmactive resets the whole buffer. */
+static void dmi_write_update_cache(struct target *target, uint32_t address,
+		uint32_t value, int result)
+{
+	dm013_info_t *dm;
+
+	if (address >= DM_PROGBUF0 && address < DM_PROGBUF0 + ARRAY_SIZE(dm->progbuf_cache)) {
+		dm = get_dm(target);
+		if (dm)
+			dm->progbuf_cache[address - DM_PROGBUF0] = result == ERROR_OK ? value : 0;
+	} else if (address == DM_DMCONTROL && !get_field(value, DM_DMCONTROL_DMACTIVE)) {
+		dm = get_dm(target);
+		if (dm)
+			memset(dm->progbuf_cache, 0, sizeof(dm->progbuf_cache));
+	}
+}
+
 static int dmi_write(struct target *target, uint32_t address, uint32_t value)
 {
-	return dmi_op(target, NULL, NULL, DMI_OP_WRITE, address, value, false, true);
+	int result = dmi_op(target, NULL, NULL, DMI_OP_WRITE, address, value, false, true);
+	dmi_write_update_cache(target, address, value, result);
+	return result;
 }
 
 static int dmi_write_exec(struct target *target, uint32_t address,
@@ -713,7 +825,7 @@ int dmstatus_read(struct target *target, uint32_t *dmstatus,
 static void increase_ac_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
-	info->ac_busy_delay += info->ac_busy_delay / 10 + 1;
+	delay_busy(target, RISCV013_DELAY_AC);
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
 			info->ac_busy_delay);
@@ -806,6 +918,7 @@ static int execute_abstract_command(struct target *target, uint32_t command)
 		return ERROR_FAIL;
 	}
 
+	delay_success(target, RISCV013_DELAY_AC, 1);
 	return ERROR_OK;
 }
 
@@ -1598,6 +1711,7 @@ static int examine(struct target *target)
 		dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_DMACTIVE);
 		dm->was_reset = true;
 	}
+	dm->hawindow_valid = 0;
 
 	dmi_write(target, DM_DMCONTROL, DM_DMCONTROL_HARTSELLO |
 			DM_DMCONTROL_HARTSELHI | DM_DMCONTROL_DMACTIVE |
@@ -2012,6 +2126,7 @@ static int init_target(struct command_context *cmd_ctx,
 	riscv_info_t *generic_info = (riscv_info_t *) target->arch_info;
 
 	generic_info->get_register = &riscv013_get_register;
+	generic_info->get_registers = &riscv013_get_registers;
 	generic_info->set_register = &riscv013_set_register;
 	generic_info->get_register_buf = &riscv013_get_register_buf;
 	generic_info->set_register_buf = &riscv013_set_register_buf;
@@ -2027,6 +2142,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->halt_reason = &riscv013_halt_reason;
 	generic_info->read_debug_buffer = &riscv013_read_debug_buffer;
 	generic_info->write_debug_buffer = &riscv013_write_debug_buffer;
+	generic_info->write_progbuf = &riscv013_write_progbuf;
 	generic_info->execute_debug_buffer = &riscv013_execute_debug_buffer;
 	generic_info->fill_dmi_write_u64 = &riscv013_fill_dmi_write_u64;
 	generic_info->fill_dmi_read_u64 = &riscv013_fill_dmi_read_u64;
@@ -2039,6 +2155,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->read_memory = read_memory;
 	generic_info->test_sba_config_reg = &riscv013_test_sba_config_reg;
 	generic_info->test_compliance = &riscv013_test_compliance;
+	generic_info->print_info = &riscv013_print_info;
 	generic_info->hart_count = &riscv013_hart_count;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->version_specific = calloc(1, sizeof(riscv013_info_t));
@@ -2063,6 +2180,24 @@ static int init_target(struct command_context *cmd_ctx,
 	info->abstract_read_fpr_supported = true;
 	info->abstract_write_fpr_supported = true;
 
+	info->abstract_mem_write = YNM_MAYBE;
+	info->abstract_mem_postincrement = YNM_MAYBE;
+
+	return ERROR_OK;
+}
+
+static int riscv013_print_info(struct command_invocation *cmd, struct target *target)
+{
+	RISCV013_INFO(info);
+
+	command_print(cmd, "dtmcs idle: %d", info->dtmcs_idle);
+	command_print(cmd, "%-10s %12s %12s %12s", "delay", "idle cycles",
+			"accesses", "busy");
+	for (unsigned int i = 0; i < RISCV013_DELAYS; i++) {
+		const struct riscv013_delay_stats *stats = &info->delay_stats[i];
+		command_print(cmd, "%-10s %12u %12" PRIu64 " %12" PRIu64,
+				riscv013_delay_names[i], *delay_of(info, i), stats->ops, stats->busy);
+	}
 	return ERROR_OK;
 }
 
@@ -2456,6 +2591,111 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static int batch_run(const struct target *target, struct riscv_batch *batch)
+{
+	RISCV013_INFO(info);
+	RISCV_INFO(r);
+	if (r->reset_delays_wait >= 0) {
+		r->reset_delays_wait -= batch->used_scans;
+		if (r->reset_delays_wait <= 0) {
+			batch->idle_count = 0;
+			info->dmi_busy_delay = 0;
+			info->ac_busy_delay = 0;
+		}
+	}
+	return riscv_batch_run(batch);
+}
+
+/* A batch should keep the adapter busy for a while, to hide its per
+ * queue overhead, so it is sized in TCK cycles rather than in scans. */
+#define RISCV013_BATCH_TCK_CYCLES	65536
+#define RISCV013_BATCH_MIN_SCANS	32
+#define RISCV013_BATCH_MAX_SCANS	4096
+
+static size_t batch_scans(struct target *target, size_t idle)
+{
+	/* DR scan, the TAP state moves around it and the idle cycles */
+	size_t cycles = riscv_dmi_write_u64_bits(target) + 6 + idle;
+	size_t scans = RISCV013_BATCH_TCK_CYCLES / cycles;
+	return MAX(RISCV013_BATCH_MIN_SCANS, MIN(scans, RISCV013_BATCH_MAX_SCANS));
+}
+
+/**
+ * Read @a count consecutive GPRs starting at @a first with one abstract
+ * command and one data read each, all in a single batch, and check
+ * abstractcs once at the end.
+ */
+static int register_read_gprs_abstract(struct target *target,
+		riscv_reg_t *values, uint32_t first, unsigned count)
+{
+	RISCV013_INFO(info);
+	assert(first + count - 1 <= GDB_REGNO_XPR31);
+
+	const unsigned int xlen = riscv_xlen(target);
+	const unsigned int arg_words = xlen / 32;
+
+	while (1) {
+		size_t idle = info->dmi_busy_delay + info->ac_busy_delay;
+		struct riscv_batch *batch = riscv_batch_alloc(target,
+				count * (1 + arg_words), idle);
+		if (!batch)
+			return ERROR_FAIL;
+
+		for (unsigned i = 0; i < count; i++) {
+			riscv_batch_add_dmi_write(batch, DM_COMMAND,
+					access_register_command(target, first + i, xlen,
+						AC_ACCESS_REGISTER_TRANSFER));
+			riscv_batch_add_dmi_read(batch, DM_DATA0);
+			if (arg_words > 1)
+				riscv_batch_add_dmi_read(batch, DM_DATA1);
+		}
+
+		int result = batch_run(target, batch);
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
+			return result;
+		}
+
+		bool dmi_busy_encountered = false;
+		for (size_t key = 0; key < count * arg_words; key++)
+			dmi_busy_encountered |= riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS;
+
+		uint32_t abstractcs;
+		bool busy;
+		result = dmi_op(target, &abstractcs, &busy, DMI_OP_READ,
+				DM_ABSTRACTCS, 0, false, true);
+		dmi_busy_encountered |= busy;
+		if (result == ERROR_OK && get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+			result = wait_for_idle(target, &abstractcs);
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
+			return result;
+		}
+		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+
+		if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
+			for (unsigned i = 0; i < count; i++) {
+				values[i] = riscv_batch_get_dmi_read_data(batch, i * arg_words);
+				if (arg_words > 1)
+					values[i] |= (riscv_reg_t)riscv_batch_get_dmi_read_data(batch,
+							i * arg_words + 1) << 32;
+			}
+			riscv_batch_free(batch);
+			delay_success(target, RISCV013_DELAY_AC, count);
+			return ERROR_OK;
+		}
+		riscv_batch_free(batch);
+
+		riscv013_clear_abstract_error(target);
+		if (info->cmderr != CMDERR_BUSY && !dmi_busy_encountered) {
+			LOG_DEBUG("batched GPR read failed, abstractcs=0x%08" PRIx32, abstractcs);
+			return ERROR_FAIL;
+		}
+		/* Reading a GPR has no side effect, so just try again. */
+		increase_ac_busy_delay(target);
+	}
+}
+
 /**
  * Read the requested memory using the system bus interface.
  */
@@ -2468,21 +2708,25 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	}
 
 	RISCV013_INFO(info);
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
+	static const int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
+	assert(size <= 16);
+	const unsigned int words = (size + 3) / 4;
+	uint32_t index = 0;
+
+	while (index < count) {
+		bool read_ahead = index < count - 1;
 
-	while (next_address < end_address) {
 		uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
 		sbcs_write |= sb_sbaccess(size);
 		if (increment == size)
 			sbcs_write = set_field(sbcs_write, DM_SBCS_SBAUTOINCREMENT, 1);
-		if (count > 1)
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, count > 1);
+		if (read_ahead)
+			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 1);
 		if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
 			return ERROR_FAIL;
 
 		/* This address write will trigger the first read. */
-		if (sb_write_address(target, next_address) != ERROR_OK)
+		if (sb_write_address(target, address + index * increment) != ERROR_OK)
 			return ERROR_FAIL;
 
 		if (info->bus_master_read_delay) {
@@ -2493,62 +2737,98 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			}
 		}
 
-		/* First value has been read, and is waiting for us to issue a DMI read
-		 * to get it. */
-
-		static int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
-		assert(size <= 16);
-		target_addr_t next_read = address - 1;
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			for (int j = (size - 1) / 4; j >= 0; j--) {
-				uint32_t value;
-				unsigned attempt = 0;
-				while (1) {
-					if (attempt++ > 100) {
-						LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								  next_read);
-						return ERROR_FAIL;
-					}
-					dmi_status_t status = dmi_scan(target, NULL, &value,
-												   DMI_OP_READ, sbdata[j], 0, false);
-					if (status == DMI_STATUS_BUSY)
-						increase_dmi_busy_delay(target);
-					else if (status == DMI_STATUS_SUCCESS)
-						break;
-					else
-						return ERROR_FAIL;
-				}
-				if (next_read != address - 1) {
-					buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-					log_memory_access(next_read, value, MIN(size, 4), true);
+		/* Each read of sbdata0 starts the next bus read, so all but the last
+		 * value are read in batches, which only end with a read of sbcs. The
+		 * reads are only checked once a batch ran, and restarted from the
+		 * first value which may be wrong. */
+		bool resync = false;
+		while (index < count - 1) {
+			size_t idle = info->dmi_busy_delay + info->bus_master_read_delay;
+			struct riscv_batch *batch = riscv_batch_alloc(target,
+					batch_scans(target, idle), idle);
+			if (!batch)
+				return ERROR_FAIL;
+
+			uint32_t reads = 0;
+			while (index + reads < count - 1 &&
+					riscv_batch_available_scans(batch) > words) {
+				for (int j = words - 1; j >= 0; j--)
+					riscv_batch_add_dmi_read(batch, sbdata[j]);
+				reads++;
+			}
+			size_t sbcs_key = riscv_batch_add_dmi_read(batch, DM_SBCS);
+
+			int result = batch_run(target, batch);
+			if (result != ERROR_OK) {
+				riscv_batch_free(batch);
+				return result;
+			}
+
+			uint32_t good = 0;
+			for (size_t key = 0; good < reads; good++, key += words) {
+				bool busy = false;
+				for (unsigned int j = 0; j < words; j++)
+					busy |= riscv_batch_get_dmi_read_op(batch, key + j) != DMI_STATUS_SUCCESS;
+				if (busy)
+					break;
+
+				for (unsigned int j = 0; j < words; j++) {
+					uint32_t value = riscv_batch_get_dmi_read_data(batch, key + j);
+					unsigned int word = words - 1 - j;
+					buf_set_u32(buffer + (index + good) * size + word * 4, 0,
+							8 * MIN(size, 4), value);
+					log_memory_access(address + (index + good) * increment + word * 4,
+							value, MIN(size, 4), true);
 				}
-				next_read = address + i * size + j * 4;
 			}
-		}
+			uint32_t sbcs_read = riscv_batch_get_dmi_read_data(batch, sbcs_key);
+			bool sbcs_valid = riscv_batch_get_dmi_read_op(batch, sbcs_key) == DMI_STATUS_SUCCESS;
+			riscv_batch_free(batch);
 
-		uint32_t sbcs_read = 0;
-		if (count > 1) {
-			uint32_t value;
-			unsigned attempt = 0;
-			while (1) {
-				if (attempt++ > 100) {
-					LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								next_read);
+			if (good < reads || !sbcs_valid) {
+				/* DMI busy, clears the busy state, the sbcs read below tells
+				 * whether the values read so far are right */
+				increase_dmi_busy_delay(target);
+				if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
 					return ERROR_FAIL;
-				}
-				dmi_status_t status = dmi_scan(target, NULL, &value, DMI_OP_NOP, 0, 0, false);
-				if (status == DMI_STATUS_BUSY)
-					increase_dmi_busy_delay(target);
-				else if (status == DMI_STATUS_SUCCESS)
-					break;
-				else
+				resync = true;
+			}
+
+			if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
+				/* We read while the bus was busy, so any value of this batch
+				 * may be wrong. Slow down and try again. */
+				delay_busy(target, RISCV013_DELAY_SB_READ);
+				good = 0;
+				resync = true;
+			} else if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
+				/* Some error indicating the bus access failed, but not because of
+				 * something we did wrong. */
+				if (dmi_write(target, DM_SBCS, DM_SBCS_SBERROR) != ERROR_OK)
 					return ERROR_FAIL;
+				return ERROR_FAIL;
 			}
-			buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-			log_memory_access(next_read, value, MIN(size, 4), true);
 
+			index += good;
+			if (resync)
+				break;
+			delay_success(target, RISCV013_DELAY_SB_READ, reads);
+		}
+
+		if (resync) {
 			/* "Writes to sbcs while sbbusy is high result in undefined behavior.
 			 * A debugger must not write to sbcs until it reads sbbusy as 0." */
+			uint32_t sbcs_read;
+			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
+				return ERROR_FAIL;
+			if (dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR) != ERROR_OK)
+				return ERROR_FAIL;
+			LOG_DEBUG("restarting system bus read at 0x%" TARGET_PRIxADDR,
+					address + index * increment);
+			continue;
+		}
+
+		uint32_t sbcs_read = 0;
+		if (read_ahead) {
 			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
 				return ERROR_FAIL;
 
@@ -2560,7 +2840,7 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		/* Read the last word, after we disabled sbreadondata if necessary. */
 		if (!get_field(sbcs_read, DM_SBCS_SBERROR) &&
 				!get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
-			if (read_memory_bus_word(target, address + (count - 1) * size, size,
+			if (read_memory_bus_word(target, address + (count - 1) * increment, size,
 						buffer + (count - 1) * size) != ERROR_OK)
 				return ERROR_FAIL;
 
@@ -2572,14 +2852,14 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			/* We read while the target was busy. Slow down and try again. */
 			if (dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
-			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			delay_busy(target, RISCV013_DELAY_SB_READ);
+			index = count - 1;
 			continue;
 		}
 
 		unsigned error = get_field(sbcs_read, DM_SBCS_SBERROR);
 		if (error == 0) {
-			next_address = end_address;
+			index = count;
 		} else {
 			/* Some error indicating the bus access failed, but not because of
 			 * something we did wrong. */
@@ -2592,21 +2872,6 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
-static int batch_run(const struct target *target, struct riscv_batch *batch)
-{
-	RISCV013_INFO(info);
-	RISCV_INFO(r);
-	if (r->reset_delays_wait >= 0) {
-		r->reset_delays_wait -= batch->used_scans;
-		if (r->reset_delays_wait <= 0) {
-			batch->idle_count = 0;
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
-		}
-	}
-	return riscv_batch_run(batch);
-}
-
 /*
  * Performs a memory read using memory access abstract commands. The read sizes
  * supported are 1, 2, and 4 bytes despite the spec's support of 8 and 16 byte
@@ -2680,6 +2945,7 @@ static int read_memory_abstract(struct target *target, target_addr_t address,
 static int write_memory_abstract(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
+	RISCV013_INFO(info);
 	int result = ERROR_OK;
 
 	LOG_DEBUG("writing %d words of %d bytes from 0x%" TARGET_PRIxADDR, count,
@@ -2694,42 +2960,141 @@ static int write_memory_abstract(struct target *target, target_addr_t address,
 		return ERROR_FAIL;
 	}
 
-	/* Create the command (physical address, postincrement, write) */
-	uint32_t command = access_memory_command(target, false, width, true, true);
+	const unsigned int xlen = riscv_xlen(target);
+	const unsigned int arg_words = xlen / 32;
 
-	/* Execute the writes */
-	const uint8_t *p = buffer;
-	bool updateaddr = true;
-	for (uint32_t c = 0; c < count; c++) {
-		/* Move data to arg0 */
-		riscv_reg_t value = buf_get_u64(p, 0, 8 * size);
-		result = write_abstract_arg(target, 0, value, riscv_xlen(target));
+	uint32_t index = 0;
+	while (index < count) {
+		/* Write the first word with the address, which also tells whether
+		 * the command, and postincrement, are supported. */
+		bool postincrement = info->abstract_mem_postincrement != YNM_NO;
+		uint32_t command = access_memory_command(target, false, width,
+				postincrement, true);
+
+		riscv_reg_t value = buf_get_u64(buffer + index * size, 0, 8 * size);
+		result = write_abstract_arg(target, 0, value, xlen);
 		if (result != ERROR_OK) {
 			LOG_ERROR("Failed to write arg0 during write_memory_abstract().");
 			return result;
 		}
-
-		/* Only update the address initially and let postincrement update it */
-		if (updateaddr) {
-			/* Set arg1 to the address: address + c * size */
-			result = write_abstract_arg(target, 1, address, riscv_xlen(target));
-			if (result != ERROR_OK) {
-				LOG_ERROR("Failed to write arg1 during write_memory_abstract().");
-				return result;
-			}
+		result = write_abstract_arg(target, 1, address + index * size, xlen);
+		if (result != ERROR_OK) {
+			LOG_ERROR("Failed to write arg1 during write_memory_abstract().");
+			return result;
 		}
+		log_memory_access(address + index * size, value, size, false);
 
-		/* Execute the command */
 		result = execute_abstract_command(target, command);
 		if (result != ERROR_OK) {
-			LOG_ERROR("Failed to execute command write_memory_abstract().");
+			if (info->cmderr == CMDERR_NOT_SUPPORTED && postincrement) {
+				LOG_DEBUG("abstract memory write without aampostincrement");
+				info->abstract_mem_postincrement = YNM_NO;
+				continue;
+			}
+			if (info->cmderr == CMDERR_NOT_SUPPORTED)
+				info->abstract_mem_write = YNM_NO;
+			LOG_DEBUG("Failed to execute command write_memory_abstract().");
 			return result;
 		}
+		info->abstract_mem_write = YNM_YES;
+		if (postincrement)
+			info->abstract_mem_postincrement = YNM_YES;
+		index++;
 
-		updateaddr = false;
-		p += size;
+		/* With postincrement every write of data0 runs the command again
+		 * on the next address, otherwise arg1 and the command are written
+		 * for each word. The batch is checked once, at its end. */
+		if (postincrement && index < count &&
+				dmi_write(target, DM_ABSTRACTAUTO,
+					1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET) != ERROR_OK)
+			return ERROR_FAIL;
+
+		const unsigned int scans = arg_words + (postincrement ? 0 : arg_words + 1);
+		bool setup_needed = false;
+		while (index < count && !setup_needed) {
+			size_t idle = info->dmi_busy_delay + info->ac_busy_delay;
+			struct riscv_batch *batch = riscv_batch_alloc(target,
+					batch_scans(target, idle), idle);
+			if (!batch) {
+				result = ERROR_FAIL;
+				goto error;
+			}
+
+			uint32_t batch_start = index;
+			while (index < count && riscv_batch_available_scans(batch) >= scans) {
+				value = buf_get_u64(buffer + index * size, 0, 8 * size);
+				if (arg_words > 1)
+					riscv_batch_add_dmi_write(batch, DM_DATA1, value >> 32);
+				riscv_batch_add_dmi_write(batch, DM_DATA0, value);
+				if (!postincrement) {
+					target_addr_t word_address = address + index * size;
+					if (arg_words > 1)
+						riscv_batch_add_dmi_write(batch, DM_DATA0 + 3,
+								(uint64_t)word_address >> 32);
+					riscv_batch_add_dmi_write(batch, DM_DATA0 + arg_words,
+							word_address);
+					riscv_batch_add_dmi_write(batch, DM_COMMAND, command);
+				}
+				log_memory_access(address + index * size, value, size, false);
+				index++;
+			}
+
+			result = batch_run(target, batch);
+			riscv_batch_free(batch);
+			if (result != ERROR_OK)
+				goto error;
+
+			uint32_t abstractcs;
+			bool dmi_busy_encountered;
+			result = dmi_op(target, &abstractcs, &dmi_busy_encountered,
+					DMI_OP_READ, DM_ABSTRACTCS, 0, false, true);
+			if (result != ERROR_OK)
+				goto error;
+			if (get_field(abstractcs, DM_ABSTRACTCS_BUSY)) {
+				result = wait_for_idle(target, &abstractcs);
+				if (result != ERROR_OK)
+					goto error;
+			}
+			info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+
+			if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
+				delay_success(target, RISCV013_DELAY_AC, index - batch_start);
+			} else if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered) {
+				LOG_DEBUG("abstract memory write busy, cmderr=%d", info->cmderr);
+				riscv013_clear_abstract_error(target);
+				increase_ac_busy_delay(target);
+				if (dmi_write(target, DM_ABSTRACTAUTO, 0) != ERROR_OK) {
+					result = ERROR_FAIL;
+					goto error;
+				}
+
+				/* Writing a word again does no harm, so start over at the
+				 * word postincrement got to, or at the start of this batch. */
+				uint32_t next = batch_start;
+				if (postincrement) {
+					target_addr_t next_address = read_abstract_arg(target, 1, xlen);
+					if (next_address >= address + batch_start * size &&
+							next_address <= address + index * size)
+						next = (next_address - address) / size;
+				}
+				index = next;
+				setup_needed = true;
+			} else {
+				LOG_ERROR("error when writing memory, abstractcs=0x%08lx", (long)abstractcs);
+				riscv013_clear_abstract_error(target);
+				result = ERROR_FAIL;
+				goto error;
+			}
+		}
+
+		if (postincrement && dmi_write(target, DM_ABSTRACTAUTO, 0) != ERROR_OK)
+			return ERROR_FAIL;
 	}
 
+	return ERROR_OK;
+
+error:
+	dmi_write(target, DM_ABSTRACTAUTO, 0);
 	return result;
 }
 
@@ -2826,6 +3191,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		switch (info->cmderr) {
 			case CMDERR_NONE:
 				LOG_DEBUG("successful (partial?) memory read");
+				delay_success(target, RISCV013_DELAY_AC, reads);
 				next_index = index + reads;
 				break;
 			case CMDERR_BUSY:
@@ -3264,6 +3630,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 	while (next_address < end_address) {
 		LOG_DEBUG("transferring burst starting at address 0x%" TARGET_PRIxADDR,
 				next_address);
+		target_addr_t burst_address = next_address;
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
@@ -3338,7 +3705,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR)) {
 			/* We wrote while the target was busy. Slow down and try again. */
 			dmi_write(target, DM_SBCS, DM_SBCS_SBBUSYERROR);
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			delay_busy(target, RISCV013_DELAY_SB_WRITE);
 		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
@@ -3360,6 +3727,9 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			dmi_write(target, DM_SBCS, DM_SBCS_SBERROR);
 			return ERROR_FAIL;
 		}
+
+		delay_success(target, RISCV013_DELAY_SB_WRITE,
+				(next_address - burst_address) / size);
 	}
 
 	return ERROR_OK;
@@ -3517,6 +3887,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
 		if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
 			LOG_DEBUG("successful (partial?) memory write");
+			delay_success(target, RISCV013_DELAY_AC, (cur_addr - address) / size - start);
 		} else if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered) {
 			if (info->cmderr == CMDERR_BUSY)
 				LOG_DEBUG("Memory write resulted in abstract command busy response.");
@@ -3562,6 +3933,20 @@ static int write_memory(struct target *target, target_addr_t address,
 {
 	RISCV013_INFO(info);
 
+	/* Abstract memory writes with postincrement move one word per DMI write
+	 * like the program buffer does, without saving registers, so they are
+	 * tried first; until the first write tells if they work. */
+	if (!riscv_prefer_sba && !riscv_enable_virtual &&
+			info->abstract_mem_write != YNM_NO &&
+			info->abstract_mem_postincrement != YNM_NO &&
+			size * 8 <= riscv_xlen(target)) {
+		yes_no_maybe_t known = info->abstract_mem_write;
+		int result = write_memory_abstract(target, address, size, count, buffer);
+		if (result == ERROR_OK || known == YNM_YES)
+			return result;
+		LOG_DEBUG("abstract memory write failed, using other methods");
+	}
+
 	if (has_sufficient_progbuf(target, 3) && !riscv_prefer_sba)
 		return write_memory_progbuf(target, address, size, count, buffer);
 
@@ -3634,6 +4019,20 @@ static int riscv013_get_register(struct target *target,
 	return result;
 }
 
+static int riscv013_get_registers(struct target *target,
+		riscv_reg_t *values, int hid, int first, unsigned count)
+{
+	LOG_DEBUG("[%d] reading %d registers from %s on hart %d", target->coreid,
+			count, gdb_regno_name(first), hid);
+
+	riscv_set_current_hartid(target, hid);
+
+	if (first < GDB_REGNO_ZERO || first + count - 1 > GDB_REGNO_XPR31)
+		return ERROR_FAIL;
+
+	return register_read_gprs_abstract(target, values, first, count);
+}
+
 static int riscv013_set_register(struct target *target, int hid, int rid, uint64_t value)
 {
 	LOG_DEBUG("[%d] writing 0x%" PRIx64 " to register %s on hart %d",
@@ -3729,11 +4128,44 @@ static int select_prepped_harts(struct target *target, bool *use_hasel)
 		return ERROR_OK;
 	}
 
+	/* Write the windows which changed, all in one batch. */
+	RISCV013_INFO(info);
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * hawindow_count,
+			info->dmi_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+	unsigned written = 0;
 	for (unsigned i = 0; i < hawindow_count; i++) {
-		if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
-			return ERROR_FAIL;
-		if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
-			return ERROR_FAIL;
+		if (i < dm->hawindow_valid && dm->hawindow[i] == hawindow[i])
+			continue;
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOWSEL, i);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOW, hawindow[i]);
+		written++;
+	}
+	int result = batch_run(target, batch);
+	riscv_batch_free(batch);
+	dm->hawindow_valid = 0;
+	if (result != ERROR_OK)
+		return result;
+
+	/* A busy response means some write may have been lost. */
+	uint32_t dmstatus;
+	bool dmi_busy_encountered = false;
+	if (written && dmi_op(target, &dmstatus, &dmi_busy_encountered, DMI_OP_READ,
+				DM_DMSTATUS, 0, false, true) != ERROR_OK)
+		return ERROR_FAIL;
+	if (dmi_busy_encountered) {
+		for (unsigned i = 0; i < hawindow_count; i++) {
+			if (dmi_write(target, DM_HAWINDOWSEL, i) != ERROR_OK)
+				return ERROR_FAIL;
+			if (dmi_write(target, DM_HAWINDOW, hawindow[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+	}
+
+	if (hawindow_count <= DIM(dm->hawindow)) {
+		memcpy(dm->hawindow, hawindow, sizeof(uint32_t) * hawindow_count);
+		dm->hawindow_valid = hawindow_count;
 	}
 
 	*use_hasel = true;
@@ -3897,13 +4329,79 @@ int riscv013_write_debug_buffer(struct target *target, unsigned index, riscv_ins
 	if (dm->progbuf_cache[index] != data) {
 		if (dmi_write(target, DM_PROGBUF0 + index, data) != ERROR_OK)
 			return ERROR_FAIL;
-		dm->progbuf_cache[index] = data;
 	} else {
 		LOG_DEBUG("cache hit for 0x%" PRIx32 " @%d", data, index);
 	}
 	return ERROR_OK;
 }
 
+/**
+ * Write the words of a program which differ from the program buffer cache,
+ * all in one batch. The DMI busy status is sticky, so the result of a read
+ * at the end of the batch tells whether any of the writes was dropped.
+ */
+static int riscv013_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	assert(count <= ARRAY_SIZE(dm->progbuf_cache));
+
+	unsigned int changed = 0;
+	for (unsigned int i = 0; i < count; i++)
+		if (dm->progbuf_cache[i] != insns[i])
+			changed++;
+
+	if (changed == 0) {
+		LOG_DEBUG("cache hit for all %u program buffer words", count);
+		return ERROR_OK;
+	}
+
+	if (changed == 1) {
+		for (unsigned int i = 0; i < count; i++)
+			if (riscv013_write_debug_buffer(target, i, insns[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		return ERROR_OK;
+	}
+
+	while (1) {
+		struct riscv_batch *batch = riscv_batch_alloc(target, changed + 1,
+				info->dmi_busy_delay);
+		if (!batch)
+			return ERROR_FAIL;
+
+		for (unsigned int i = 0; i < count; i++)
+			if (dm->progbuf_cache[i] != insns[i])
+				riscv_batch_add_dmi_write(batch, DM_PROGBUF0 + i, insns[i]);
+		size_t key = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+
+		int result = batch_run(target, batch);
+		bool busy = result == ERROR_OK &&
+			riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS;
+		riscv_batch_free(batch);
+
+		if (result != ERROR_OK) {
+			/* unknown which of the words made it */
+			for (unsigned int i = 0; i < count; i++)
+				dm->progbuf_cache[i] = 0;
+			return result;
+		}
+		if (!busy)
+			break;
+
+		/* the writes are idempotent, do them all again more slowly */
+		increase_dmi_busy_delay(target);
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+		dm->progbuf_cache[i] = insns[i];
+
+	return ERROR_OK;
+}
+
 riscv_insn_t riscv013_read_debug_buffer(struct target *target, unsigned index)
 {
 	uint32_t value;
@@ -269,6 +269,7 @@ virt2phys_info_t sv48 = {
 };
 
 static int riscv_resume_go_all_harts(struct target *target);
+static bool gdb_regno_cacheable(enum gdb_regno regno, bool write);
 
 void select_dmi_via_bscan(struct target *target)
 {
@@ -496,8 +497,41 @@ static void trigger_from_breakpoint(struct trigger *trigger,
 	trigger->unique_id = breakpoint->unique_id;
 }
 
+/* Set the trigger selected by tselect on hartid. Whether the hardware keeps
+ * a tdata1 value is only read back the first time that value is used. */
+static int set_trigger(struct target *target, unsigned hartid,
+		struct trigger *trigger, uint64_t tdata1, struct riscv_trigger_cache *cache)
+{
+	if (tdata1 == cache->rejected)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, tdata1);
+
+	if (tdata1 != cache->accepted) {
+		riscv_reg_t tdata1_rb;
+		if (riscv_get_register_on_hart(target, &tdata1_rb, hartid,
+					GDB_REGNO_TDATA1) != ERROR_OK)
+			return ERROR_FAIL;
+		LOG_DEBUG("tdata1=0x%" PRIx64, tdata1_rb);
+
+		if (tdata1 != tdata1_rb) {
+			LOG_DEBUG("Trigger doesn't support what we need; After writing 0x%"
+					PRIx64 " to tdata1 it contains 0x%" PRIx64,
+					tdata1, tdata1_rb);
+			riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, 0);
+			cache->rejected = tdata1;
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+		cache->accepted = tdata1;
+	}
+
+	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA2, trigger->address);
+
+	return ERROR_OK;
+}
+
 static int maybe_add_trigger_t1(struct target *target, unsigned hartid,
-		struct trigger *trigger, uint64_t tdata1)
+		struct trigger *trigger, uint64_t tdata1, struct riscv_trigger_cache *cache)
 {
 	RISCV_INFO(r);
 
@@ -529,29 +563,11 @@ static int maybe_add_trigger_t1(struct target *target, unsigned hartid,
 	tdata1 = set_field(tdata1, bpcontrol_bpmatch, 0); /* exact match */
 	tdata1 = set_field(tdata1, bpcontrol_bpaction, 0); /* cause bp exception */
 
-	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, tdata1);
-
-	riscv_reg_t tdata1_rb;
-	if (riscv_get_register_on_hart(target, &tdata1_rb, hartid,
-				GDB_REGNO_TDATA1) != ERROR_OK)
-		return ERROR_FAIL;
-	LOG_DEBUG("tdata1=0x%" PRIx64, tdata1_rb);
-
-	if (tdata1 != tdata1_rb) {
-		LOG_DEBUG("Trigger doesn't support what we need; After writing 0x%"
-				PRIx64 " to tdata1 it contains 0x%" PRIx64,
-				tdata1, tdata1_rb);
-		riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, 0);
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA2, trigger->address);
-
-	return ERROR_OK;
+	return set_trigger(target, hartid, trigger, tdata1, cache);
 }
 
 static int maybe_add_trigger_t2(struct target *target, unsigned hartid,
-		struct trigger *trigger, uint64_t tdata1)
+		struct trigger *trigger, uint64_t tdata1, struct riscv_trigger_cache *cache)
 {
 	RISCV_INFO(r);
 
@@ -581,25 +597,20 @@ static int maybe_add_trigger_t2(struct target *target, unsigned hartid,
 	if (trigger->write)
 		tdata1 |= MCONTROL_STORE;
 
-	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, tdata1);
-
-	uint64_t tdata1_rb;
-	int result = riscv_get_register_on_hart(target, &tdata1_rb, hartid, GDB_REGNO_TDATA1);
-	if (result != ERROR_OK)
-		return result;
-	LOG_DEBUG("tdata1=0x%" PRIx64, tdata1_rb);
+	return set_trigger(target, hartid, trigger, tdata1, cache);
+}
 
-	if (tdata1 != tdata1_rb) {
-		LOG_DEBUG("Trigger doesn't support what we need; After writing 0x%"
-				PRIx64 " to tdata1 it contains 0x%" PRIx64,
-				tdata1, tdata1_rb);
-		riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, 0);
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+/* Whether tdata1 is that of a trigger which is set, presumably by user code. */
+static bool trigger_in_use(struct target *target, uint64_t tdata1)
+{
+	switch (get_field(tdata1, MCONTROL_TYPE(riscv_xlen(target)))) {
+		case 1:
+			return tdata1 & 0x7;	/* bpcontrol r, w or x */
+		case 2:
+			return tdata1 & (MCONTROL_EXECUTE | MCONTROL_STORE | MCONTROL_LOAD);
+		default:
+			return false;
 	}
-
-	riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA2, trigger->address);
-
-	return ERROR_OK;
 }
 
 static int add_trigger(struct target *target, struct trigger *trigger)
@@ -636,14 +647,28 @@ static int add_trigger(struct target *target, struct trigger *trigger)
 		if (r->trigger_unique_id[i] != -1)
 			continue;
 
+		struct riscv_trigger_cache *cache = &r->trigger_cache[i];
+		uint64_t tdata1 = cache->tdata1;
+		int type = get_field(tdata1, MCONTROL_TYPE(riscv_xlen(target)));
+
+		/* A trigger of a type we can't use is skipped without even
+		 * selecting it. */
+		if (cache->valid && type != 1 && type != 2)
+			continue;
+
 		riscv_set_register_on_hart(target, first_hart, GDB_REGNO_TSELECT, i);
 
-		uint64_t tdata1;
-		int result = riscv_get_register_on_hart(target, &tdata1, first_hart,
-				GDB_REGNO_TDATA1);
-		if (result != ERROR_OK)
-			return result;
-		int type = get_field(tdata1, MCONTROL_TYPE(riscv_xlen(target)));
+		int result;
+		if (!cache->valid) {
+			result = riscv_get_register_on_hart(target, &tdata1, first_hart,
+					GDB_REGNO_TDATA1);
+			if (result != ERROR_OK)
+				return result;
+			type = get_field(tdata1, MCONTROL_TYPE(riscv_xlen(target)));
+			/* Keep reading a trigger used by user code, it may be freed. */
+			cache->tdata1 = tdata1;
+			cache->valid = !trigger_in_use(target, tdata1);
+		}
 
 		result = ERROR_OK;
 		for (int hartid = first_hart; hartid < riscv_count_harts(target); ++hartid) {
@@ -653,10 +678,10 @@ static int add_trigger(struct target *target, struct trigger *trigger)
 				riscv_set_register_on_hart(target, hartid, GDB_REGNO_TSELECT, i);
 			switch (type) {
 				case 1:
-					result = maybe_add_trigger_t1(target, hartid, trigger, tdata1);
+					result = maybe_add_trigger_t1(target, hartid, trigger, tdata1, cache);
 					break;
 				case 2:
-					result = maybe_add_trigger_t2(target, hartid, trigger, tdata1);
+					result = maybe_add_trigger_t2(target, hartid, trigger, tdata1, cache);
 					break;
 				default:
 					LOG_DEBUG("trigger %d has unknown type %d", i, type);
@@ -1616,6 +1641,40 @@ static int riscv_write_memory(struct target *target, target_addr_t address,
 	return tt->write_memory(target, address, size, count, buffer);
 }
 
+/* Fill the register cache with all the GPRs at once, so gdb's first
+ * register read after a halt doesn't need a round trip per register. */
+static void riscv_read_gprs(struct target *target)
+{
+	RISCV_INFO(r);
+	if (!r->get_registers || target->state != TARGET_HALTED)
+		return;
+
+	int hartid = riscv_current_hartid(target);
+	unsigned count = riscv_supports_extension(target, hartid, 'E') ? 15 : 31;
+	struct reg *reg_list = target->reg_cache->reg_list;
+
+	bool needed = false;
+	for (unsigned i = 0; i < count; i++) {
+		struct reg *reg = &reg_list[GDB_REGNO_RA + i];
+		needed |= reg->exist && !reg->valid;
+	}
+	if (!needed)
+		return;
+
+	/* On failure the registers are read one at a time as usual. */
+	riscv_reg_t values[31];
+	if (r->get_registers(target, values, hartid, GDB_REGNO_RA, count) != ERROR_OK)
+		return;
+
+	for (unsigned i = 0; i < count; i++) {
+		struct reg *reg = &reg_list[GDB_REGNO_RA + i];
+		if (reg->valid)
+			continue;
+		buf_set_u64(reg->value, 0, reg->size, values[i]);
+		reg->valid = gdb_regno_cacheable(GDB_REGNO_RA + i, false);
+	}
+}
+
 static int riscv_get_gdb_reg_list_internal(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class, bool read)
@@ -1648,6 +1707,9 @@ static int riscv_get_gdb_reg_list_internal(struct target *target,
 	if (!*reg_list)
 		return ERROR_FAIL;
 
+	if (read)
+		riscv_read_gprs(target);
+
 	for (int i = 0; i < *reg_list_size; i++) {
 		assert(!target->reg_cache->reg_list[i].valid ||
 				target->reg_cache->reg_list[i].size > 0);
@@ -2151,6 +2213,21 @@ COMMAND_HANDLER(riscv_test_compliance) {
 	}
 }
 
+COMMAND_HANDLER(riscv_info_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC > 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!r->print_info) {
+		LOG_ERROR("This target does not support this command (may implement an older version of the spec).");
+		return ERROR_FAIL;
+	}
+	return r->print_info(CMD, target);
+}
+
 COMMAND_HANDLER(riscv_set_prefer_sba)
 {
 	if (CMD_ARGC != 1) {
@@ -2539,6 +2616,13 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.mode = COMMAND_EXEC,
 		.help = "Runs a basic compliance test suite against the RISC-V Debug Spec."
 	},
+	{
+		.name = "info",
+		.handler = riscv_info_command,
+		.usage = "",
+		.mode = COMMAND_EXEC,
+		.help = "Show the idle cycles learned for each kind of access."
+	},
 	{
 		.name = "set_command_timeout_sec",
 		.handler = riscv_set_command_timeout_sec,
@@ -3130,6 +3214,20 @@ int riscv_write_debug_buffer(struct target *target, int index, riscv_insn_t insn
 	return ERROR_OK;
 }
 
+int riscv_write_progbuf(struct target *target, const riscv_insn_t *insns, unsigned int count)
+{
+	RISCV_INFO(r);
+	if (r->write_progbuf)
+		return r->write_progbuf(target, insns, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int result = r->write_debug_buffer(target, i, insns[i]);
+		if (result != ERROR_OK)
+			return result;
+	}
+	return ERROR_OK;
+}
+
 riscv_insn_t riscv_read_debug_buffer(struct target *target, int index)
 {
 	RISCV_INFO(r);
@@ -3191,6 +3289,7 @@ int riscv_enumerate_triggers(struct target *target)
 
 	r->triggers_enumerated = true;	/* At the very least we tried. */
 
+	bool first_hart = true;
 	for (int hartid = 0; hartid < riscv_count_harts(target); ++hartid) {
 		if (!riscv_hart_enabled(target, hartid))
 			continue;
@@ -3226,18 +3325,29 @@ int riscv_enumerate_triggers(struct target *target)
 			int type = get_field(tdata1, MCONTROL_TYPE(riscv_xlen(target)));
 			if (type == 0)
 				break;
+			bool cleared = false;
 			switch (type) {
 				case 1:
 					/* On these older cores we don't support software using
 					 * triggers. */
 					riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, 0);
+					cleared = true;
 					break;
 				case 2:
-					if (tdata1 & MCONTROL_DMODE(riscv_xlen(target)))
+					if (tdata1 & MCONTROL_DMODE(riscv_xlen(target))) {
 						riscv_set_register_on_hart(target, hartid, GDB_REGNO_TDATA1, 0);
+						cleared = true;
+					}
 					break;
 			}
+
+			/* add_trigger() reads a cleared trigger when it first needs it */
+			if (first_hart && !cleared) {
+				r->trigger_cache[t].tdata1 = tdata1;
+				r->trigger_cache[t].valid = !trigger_in_use(target, tdata1);
+			}
 		}
+		first_hart = false;
 
 		riscv_set_register_on_hart(target, hartid, GDB_REGNO_TSELECT, tselect);
 
@@ -3476,6 +3586,9 @@ static int register_set(struct reg *reg, uint8_t *buf)
 	if (reg->number == GDB_REGNO_TDATA1 ||
 			reg->number == GDB_REGNO_TDATA2) {
 		r->manual_hwbp_set = true;
+		/* The free value of the trigger may have changed. */
+		for (unsigned int t = 0; t < ARRAY_SIZE(r->trigger_cache); t++)
+			r->trigger_cache[t].valid = false;
 		/* When enumerating triggers, we clear any triggers with DMODE set,
 		 * assuming they were left over from a previous debug session. So make
 		 * sure that is done before a user might be setting their own triggers.
@@ -11,6 +11,8 @@ struct riscv_program;
 #include "jtag/jtag.h"
 #include "target/register.h"
 
+struct command_invocation;
+
 /* The register cache is statically allocated. */
 #define RISCV_MAX_HARTS 1024
 #define RISCV_MAX_REGISTERS 5000
@@ -51,6 +53,17 @@ typedef struct {
 	unsigned custom_number;
 } riscv_reg_info_t;
 
+struct riscv_trigger_cache {
+	/* tdata1 holds the value of the free trigger */
+	bool valid;
+	uint64_t tdata1;
+	/* The last tdata1 the trigger was set to that the hardware kept, and the
+	 * last one the hardware didn't. 0 when there is none, because a tdata1
+	 * written to set a trigger is never 0. */
+	uint64_t accepted;
+	uint64_t rejected;
+};
+
 typedef struct {
 	unsigned dtm_version;
 
@@ -90,6 +103,12 @@ typedef struct {
 	 * target controls, while otherwise only a single hart is controlled. */
 	int trigger_unique_id[RISCV_MAX_HWBPS];
 
+	/* What was learned about each physical trigger, so it can be set and
+	 * cleared without reading tdata1 back every time. Like
+	 * trigger_unique_id, in RTOS mode this describes the triggers of every
+	 * hart the target controls. */
+	struct riscv_trigger_cache trigger_cache[RISCV_MAX_TRIGGERS];
+
 	/* The number of entries in the debug buffer. */
 	int debug_buffer_size[RISCV_MAX_HARTS];
 
@@ -114,6 +133,10 @@ typedef struct {
 	 * implementations. */
 	int (*get_register)(struct target *target,
 		riscv_reg_t *value, int hid, int rid);
+	/* Read count consecutive GPRs starting at first, in as few round trips
+	 * as possible. Optional. */
+	int (*get_registers)(struct target *target,
+		riscv_reg_t *values, int hid, int first, unsigned count);
 	int (*set_register)(struct target *target, int hartid, int regid,
 			uint64_t value);
 	int (*get_register_buf)(struct target *target, uint8_t *buf, int regno);
@@ -136,6 +159,11 @@ typedef struct {
 	enum riscv_halt_reason (*halt_reason)(struct target *target);
 	int (*write_debug_buffer)(struct target *target, unsigned index,
 			riscv_insn_t d);
+	/* Write the first count words of the debug buffer at once, skipping
+	 * the ones it already holds. Optional, write_debug_buffer is called
+	 * for each word otherwise. */
+	int (*write_progbuf)(struct target *target, const riscv_insn_t *insns,
+			unsigned int count);
 	riscv_insn_t (*read_debug_buffer)(struct target *target, unsigned index);
 	int (*execute_debug_buffer)(struct target *target);
 	int (*dmi_write_u64_bits)(struct target *target);
@@ -154,6 +182,9 @@ typedef struct {
 
 	int (*test_compliance)(struct target *target);
 
+	/* Print what the debug module support learned about the target. */
+	int (*print_info)(struct command_invocation *cmd, struct target *target);
+
 	int (*read_memory)(struct target *target, target_addr_t address,
 			uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment);
 
@@ -319,6 +350,7 @@ size_t riscv_debug_buffer_size(struct target *target);
 
 riscv_insn_t riscv_read_debug_buffer(struct target *target, int index);
 int riscv_write_debug_buffer(struct target *target, int index, riscv_insn_t insn);
+int riscv_write_progbuf(struct target *target, const riscv_insn_t *insns, unsigned int count);
 int riscv_execute_debug_buffer(struct target *target);
 
 void riscv_fill_dmi_nop_u64(struct target *target, char *buf);
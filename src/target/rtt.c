@@ -0,0 +1,552 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * SEGGER Real-Time Transfer (RTT) channels, read without halting.
+ *
+ * The control block in target RAM starts with an ID string of 16 bytes
+ * ("SEGGER RTT"), the number of up and of down channels as 32-bit words,
+ * followed by the descriptors of the up and then of the down channels:
+ *
+ *   u32 name, u32 buffer, u32 size, u32 write offset, u32 read offset,
+ *   u32 flags
+ *
+ * The writer of a channel advances the write offset, the reader the read
+ * offset; the channel is empty when both are equal. Every tick of a
+ * periodic timer callback reads the descriptors of all up channels in one
+ * access and the pending data of all drained channels with a single
+ * target_read_buffer_batch(), i.e. one DAP queue run on targets which
+ * implement it, then advances their read offsets.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "target.h"
+#include "rtt.h"
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/rtt_server.h>
+
+#define RTT_ID_SIZE			16
+#define RTT_CB_HEADER_SIZE	(RTT_ID_SIZE + 8)
+#define RTT_DESC_SIZE		24
+#define RTT_MAX_CHANNELS	32
+#define RTT_NAME_MAX		32
+
+/* offsets in a channel descriptor */
+#define RTT_DESC_NAME		0
+#define RTT_DESC_BUFFER		4
+#define RTT_DESC_SIZE_OFF	8
+#define RTT_DESC_WRITE		12
+#define RTT_DESC_READ		16
+#define RTT_DESC_FLAGS		20
+
+#define RTT_SEARCH_CHUNK	1024
+
+struct rtt_desc {
+	uint32_t name;
+	uint32_t buffer;
+	uint32_t size;
+	uint32_t write;
+	uint32_t read;
+	uint32_t flags;
+};
+
+struct rtt_sink {
+	struct list_head list;
+	unsigned int channel;
+	rtt_sink_t sink;
+	void *priv;
+};
+
+static LIST_HEAD(rtt_sink_list);
+
+/* set by "rtt setup" */
+static bool rtt_configured;
+static target_addr_t rtt_search_address;
+static uint32_t rtt_search_size;
+static char rtt_id[RTT_ID_SIZE + 1];
+
+static unsigned int rtt_period_ms = 100;
+
+/* set by "rtt start" */
+static struct target *rtt_target;
+static target_addr_t rtt_cb_address;
+static uint32_t rtt_num_up;
+static uint32_t rtt_num_down;
+
+/* the data of a tick, grown as needed */
+static uint8_t *rtt_buffer;
+static size_t rtt_buffer_size;
+
+int rtt_register_sink(unsigned int channel, rtt_sink_t sink, void *priv)
+{
+	struct rtt_sink *entry;
+
+	if (sink == NULL)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		LOG_ERROR("error allocating buffer for rtt sink entry");
+		return ERROR_FAIL;
+	}
+
+	entry->channel = channel;
+	entry->sink = sink;
+	entry->priv = priv;
+	list_add_tail(&entry->list, &rtt_sink_list);
+
+	return ERROR_OK;
+}
+
+int rtt_unregister_sink(unsigned int channel, rtt_sink_t sink, void *priv)
+{
+	struct rtt_sink *entry;
+
+	list_for_each_entry(entry, &rtt_sink_list, list) {
+		if (entry->channel == channel && entry->sink == sink
+				&& entry->priv == priv) {
+			list_del(&entry->list);
+			free(entry);
+			break;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static bool rtt_channel_drained(unsigned int channel)
+{
+	struct rtt_sink *entry;
+
+	list_for_each_entry(entry, &rtt_sink_list, list)
+		if (entry->channel == channel)
+			return true;
+	return false;
+}
+
+static void rtt_get_desc(struct target *target, const uint8_t *buf,
+		struct rtt_desc *desc)
+{
+	desc->name = target_buffer_get_u32(target, buf + RTT_DESC_NAME);
+	desc->buffer = target_buffer_get_u32(target, buf + RTT_DESC_BUFFER);
+	desc->size = target_buffer_get_u32(target, buf + RTT_DESC_SIZE_OFF);
+	desc->write = target_buffer_get_u32(target, buf + RTT_DESC_WRITE);
+	desc->read = target_buffer_get_u32(target, buf + RTT_DESC_READ);
+	desc->flags = target_buffer_get_u32(target, buf + RTT_DESC_FLAGS);
+}
+
+static bool rtt_desc_valid(const struct rtt_desc *desc)
+{
+	return desc->buffer && desc->size
+		&& desc->write < desc->size && desc->read < desc->size;
+}
+
+static target_addr_t rtt_desc_address(unsigned int index)
+{
+	return rtt_cb_address + RTT_CB_HEADER_SIZE + index * RTT_DESC_SIZE;
+}
+
+static int rtt_poll_callback(void *priv)
+{
+	struct target *target = priv;
+	uint8_t descs[RTT_MAX_CHANNELS * RTT_DESC_SIZE];
+	struct rtt_desc desc[RTT_MAX_CHANNELS];
+	uint32_t pending[RTT_MAX_CHANNELS];
+	struct target_read_request reads[2 * RTT_MAX_CHANNELS];
+	unsigned int count = 0;
+	size_t total = 0;
+
+	if (list_empty(&rtt_sink_list) || rtt_num_up == 0
+			|| !target_was_examined(target))
+		return ERROR_OK;
+	if (target->state != TARGET_RUNNING && target->state != TARGET_HALTED)
+		return ERROR_OK;
+
+	/* errors of a running target are not fatal, try again next time */
+	int retval = target_read_memory(target, rtt_desc_address(0), 4,
+			rtt_num_up * RTT_DESC_SIZE / 4, descs);
+	if (retval != ERROR_OK)
+		return ERROR_OK;
+
+	for (unsigned int i = 0; i < rtt_num_up; i++) {
+		pending[i] = 0;
+		if (!rtt_channel_drained(i))
+			continue;
+
+		rtt_get_desc(target, descs + i * RTT_DESC_SIZE, &desc[i]);
+		if (!rtt_desc_valid(&desc[i]) || desc[i].write == desc[i].read)
+			continue;
+
+		if (desc[i].write > desc[i].read)
+			pending[i] = desc[i].write - desc[i].read;
+		else
+			pending[i] = desc[i].size - desc[i].read + desc[i].write;
+		total += pending[i];
+	}
+
+	if (total == 0)
+		return ERROR_OK;
+
+	if (total > rtt_buffer_size) {
+		uint8_t *buffer = realloc(rtt_buffer, total);
+		if (!buffer) {
+			LOG_ERROR("Out of memory");
+			return ERROR_OK;
+		}
+		rtt_buffer = buffer;
+		rtt_buffer_size = total;
+	}
+
+	/* up to two blocks per channel, when its data wraps around */
+	uint8_t *p = rtt_buffer;
+	for (unsigned int i = 0; i < rtt_num_up; i++) {
+		if (!pending[i])
+			continue;
+
+		uint32_t first = MIN(pending[i], desc[i].size - desc[i].read);
+		reads[count].address = desc[i].buffer + desc[i].read;
+		reads[count].size = first;
+		reads[count].buffer = p;
+		reads[count].retval = ERROR_OK;
+		count++;
+		if (pending[i] > first) {
+			reads[count].address = desc[i].buffer;
+			reads[count].size = pending[i] - first;
+			reads[count].buffer = p + first;
+			reads[count].retval = ERROR_OK;
+			count++;
+		}
+		p += pending[i];
+	}
+
+	retval = target_read_buffer_batch(target, reads, count);
+	if (retval != ERROR_OK)
+		return ERROR_OK;
+
+	p = rtt_buffer;
+	unsigned int r = 0;
+	for (unsigned int i = 0; i < rtt_num_up; i++) {
+		if (!pending[i])
+			continue;
+
+		bool ok = reads[r].retval == ERROR_OK;
+		bool wrapped = pending[i] > desc[i].size - desc[i].read;
+		if (wrapped)
+			ok = ok && reads[r + 1].retval == ERROR_OK;
+		r += wrapped ? 2 : 1;
+
+		if (ok && target_write_u32(target, rtt_desc_address(i) + RTT_DESC_READ,
+					desc[i].write) == ERROR_OK) {
+			struct rtt_sink *entry, *tmp;
+
+			list_for_each_entry_safe(entry, tmp, &rtt_sink_list, list)
+				if (entry->channel == i)
+					entry->sink(i, p, pending[i], entry->priv);
+		}
+		p += pending[i];
+	}
+
+	return ERROR_OK;
+}
+
+int rtt_write_channel(unsigned int channel, const uint8_t *data, size_t *len)
+{
+	struct target *target = rtt_target;
+	uint8_t buf[RTT_DESC_SIZE];
+	struct rtt_desc desc;
+
+	if (!target || channel >= rtt_num_down) {
+		*len = 0;
+		return ERROR_FAIL;
+	}
+
+	target_addr_t address = rtt_desc_address(rtt_num_up + channel);
+	int retval = target_read_memory(target, address, 4, RTT_DESC_SIZE / 4, buf);
+	if (retval != ERROR_OK) {
+		*len = 0;
+		return retval;
+	}
+
+	rtt_get_desc(target, buf, &desc);
+	if (!rtt_desc_valid(&desc)) {
+		*len = 0;
+		return ERROR_FAIL;
+	}
+
+	/* one byte stays free, to tell a full channel from an empty one */
+	uint32_t room;
+	if (desc.read > desc.write)
+		room = desc.read - desc.write - 1;
+	else
+		room = desc.size - desc.write + desc.read - 1;
+
+	uint32_t size = MIN(*len, room);
+	uint32_t first = MIN(size, desc.size - desc.write);
+	*len = 0;
+	if (size == 0)
+		return ERROR_OK;
+
+	retval = target_write_buffer(target, desc.buffer + desc.write, first, data);
+	if (retval == ERROR_OK && size > first)
+		retval = target_write_buffer(target, desc.buffer, size - first, data + first);
+	if (retval == ERROR_OK)
+		retval = target_write_u32(target, address + RTT_DESC_WRITE,
+				(desc.write + size) % desc.size);
+	if (retval == ERROR_OK)
+		*len = size;
+
+	return retval;
+}
+
+static int rtt_find_control_block(struct target *target, target_addr_t *address)
+{
+	size_t id_len = strlen(rtt_id);
+	uint8_t buf[RTT_SEARCH_CHUNK + RTT_ID_SIZE];
+	target_addr_t addr = rtt_search_address;
+	uint32_t left = rtt_search_size;
+	size_t kept = 0;
+
+	while (left > 0) {
+		uint32_t size = MIN(left, RTT_SEARCH_CHUNK);
+
+		int retval = target_read_buffer(target, addr, size, buf + kept);
+		if (retval != ERROR_OK)
+			return retval;
+
+		size_t avail = kept + size;
+		for (size_t i = 0; i + id_len <= avail; i++) {
+			if (!memcmp(buf + i, rtt_id, id_len)) {
+				*address = addr - kept + i;
+				return ERROR_OK;
+			}
+		}
+
+		/* a match may straddle the chunks */
+		kept = MIN(avail, id_len - 1);
+		memmove(buf, buf + avail - kept, kept);
+		addr += size;
+		left -= size;
+	}
+
+	return ERROR_FAIL;
+}
+
+void rtt_stop(void)
+{
+	if (!rtt_target)
+		return;
+
+	target_unregister_timer_callback(rtt_poll_callback, rtt_target);
+	rtt_target = NULL;
+
+	free(rtt_buffer);
+	rtt_buffer = NULL;
+	rtt_buffer_size = 0;
+}
+
+static int rtt_start(struct command_invocation *cmd, struct target *target)
+{
+	uint8_t buf[8];
+
+	int retval = rtt_find_control_block(target, &rtt_cb_address);
+	if (retval != ERROR_OK) {
+		command_print(cmd, "no control block with ID '%s' in " TARGET_ADDR_FMT
+				"+0x%" PRIx32, rtt_id, rtt_search_address, rtt_search_size);
+		return retval;
+	}
+
+	retval = target_read_memory(target, rtt_cb_address + RTT_ID_SIZE, 4, 2, buf);
+	if (retval != ERROR_OK)
+		return retval;
+
+	rtt_num_up = target_buffer_get_u32(target, buf);
+	rtt_num_down = target_buffer_get_u32(target, buf + 4);
+	if (rtt_num_up > RTT_MAX_CHANNELS || rtt_num_down > RTT_MAX_CHANNELS) {
+		command_print(cmd, "control block at " TARGET_ADDR_FMT " has %" PRIu32
+				" up and %" PRIu32 " down channels, at most %d are supported",
+				rtt_cb_address, rtt_num_up, rtt_num_down, RTT_MAX_CHANNELS);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("rtt: control block at " TARGET_ADDR_FMT ", %" PRIu32 " up and %"
+			PRIu32 " down channels", rtt_cb_address, rtt_num_up, rtt_num_down);
+
+	rtt_target = target;
+	retval = target_register_timer_callback(rtt_poll_callback, rtt_period_ms,
+			TARGET_TIMER_TYPE_PERIODIC, target);
+	if (retval != ERROR_OK)
+		rtt_target = NULL;
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_rtt_setup_command)
+{
+	if (CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], rtt_search_address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], rtt_search_size);
+
+	size_t id_len = strlen(CMD_ARGV[2]);
+	if (id_len == 0 || id_len > RTT_ID_SIZE) {
+		command_print(CMD, "the ID must have 1 to %d characters", RTT_ID_SIZE);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	strcpy(rtt_id, CMD_ARGV[2]);
+	rtt_configured = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_start_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!rtt_configured) {
+		command_print(CMD, "set up the control block search first, see 'rtt setup'");
+		return ERROR_FAIL;
+	}
+	if (rtt_target) {
+		command_print(CMD, "RTT already runs on %s", target_name(rtt_target));
+		return ERROR_FAIL;
+	}
+
+	return rtt_start(CMD, get_current_target(CMD_CTX));
+}
+
+COMMAND_HANDLER(handle_rtt_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	rtt_stop();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_polling_interval_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int period_ms;
+
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], period_ms);
+		if (period_ms == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		rtt_period_ms = period_ms;
+
+		if (rtt_target) {
+			target_unregister_timer_callback(rtt_poll_callback, rtt_target);
+			target_register_timer_callback(rtt_poll_callback, rtt_period_ms,
+					TARGET_TIMER_TYPE_PERIODIC, rtt_target);
+		}
+	}
+
+	command_print(CMD, "RTT polling interval is %u ms", rtt_period_ms);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_channels_command)
+{
+	struct target *target = rtt_target;
+	uint8_t descs[2 * RTT_MAX_CHANNELS * RTT_DESC_SIZE];
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		command_print(CMD, "RTT is not started");
+		return ERROR_FAIL;
+	}
+
+	uint32_t num = rtt_num_up + rtt_num_down;
+	int retval = target_read_memory(target, rtt_desc_address(0), 4,
+			num * RTT_DESC_SIZE / 4, descs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < num; i++) {
+		struct rtt_desc desc;
+		char name[RTT_NAME_MAX + 1] = "";
+
+		rtt_get_desc(target, descs + i * RTT_DESC_SIZE, &desc);
+		if (desc.name
+				&& target_read_buffer(target, desc.name, RTT_NAME_MAX,
+					(uint8_t *)name) == ERROR_OK)
+			name[RTT_NAME_MAX] = 0;
+		else
+			name[0] = 0;
+
+		bool up = i < rtt_num_up;
+		command_print(CMD, "%s %u: \"%s\" size %" PRIu32 " flags 0x%" PRIx32 "%s",
+				up ? "up" : "down", up ? i : i - rtt_num_up, name,
+				desc.size, desc.flags, rtt_desc_valid(&desc) ? "" : " (unused)");
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration rtt_subcommand_handlers[] = {
+	{
+		.name = "setup",
+		.handler = handle_rtt_setup_command,
+		.mode = COMMAND_ANY,
+		.help = "set the memory range in which to search the control "
+			"block and its ID, e.g. \"SEGGER RTT\"",
+		.usage = "address size ID",
+	},
+	{
+		.name = "start",
+		.handler = handle_rtt_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "find the control block on the current target and "
+			"start polling the channels",
+		.usage = "",
+	},
+	{
+		.name = "stop",
+		.handler = handle_rtt_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop polling the channels",
+		.usage = "",
+	},
+	{
+		.name = "polling_interval",
+		.handler = handle_rtt_polling_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "show or set the polling interval in milliseconds",
+		.usage = "[interval_ms]",
+	},
+	{
+		.name = "channels",
+		.handler = handle_rtt_channels_command,
+		.mode = COMMAND_EXEC,
+		.help = "list the up and down channels",
+		.usage = "",
+	},
+	{
+		.name = "server",
+		.mode = COMMAND_ANY,
+		.help = "RTT channels over TCP",
+		.usage = "",
+		.chain = rtt_server_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration rtt_command_handlers[] = {
+	{
+		.name = "rtt",
+		.mode = COMMAND_ANY,
+		.help = "Real-Time Transfer channels",
+		.usage = "",
+		.chain = rtt_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
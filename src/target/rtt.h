@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * SEGGER Real-Time Transfer (RTT): channels in target memory, polled
+ * while the target runs, see "rtt".
+ */
+
+#ifndef OPENOCD_TARGET_RTT_H
+#define OPENOCD_TARGET_RTT_H
+
+#include <helper/command.h>
+
+extern const struct command_registration rtt_command_handlers[];
+
+/** Receives the data read from the up (target to host) @a channel. */
+typedef int (*rtt_sink_t)(unsigned int channel, const uint8_t *data,
+		size_t len, void *priv);
+
+/**
+ * Register @a sink for the data of up @a channel. Only channels with a
+ * sink are drained. Sinks may be registered before RTT is started.
+ */
+int rtt_register_sink(unsigned int channel, rtt_sink_t sink, void *priv);
+int rtt_unregister_sink(unsigned int channel, rtt_sink_t sink, void *priv);
+
+/**
+ * Write up to @a len bytes to the down (host to target) @a channel.
+ * @returns in @a len the number of bytes which fit in the channel.
+ */
+int rtt_write_channel(unsigned int channel, const uint8_t *data, size_t *len);
+
+/** Stop polling the channels. */
+void rtt_stop(void);
+
+#endif /* OPENOCD_TARGET_RTT_H */
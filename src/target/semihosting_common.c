@@ -85,6 +85,189 @@ static void semihosting_set_field(struct target *target, uint64_t value,
 /* Attempts to include gdb_server.h failed. */
 extern int gdb_actual_connections;
 
+/* Period of the flush of the buffered output */
+#define SEMIHOSTING_FLUSH_MS	100
+
+/*
+ * Layout of the header of a semihosting ring, in target endianness,
+ * followed by the data:
+ * - the size of the data
+ * - the write offset, advanced by the target
+ * - the read offset, advanced by OpenOCD
+ */
+#define SEMIHOSTING_RING_SIZE	0
+#define SEMIHOSTING_RING_WRITE	4
+#define SEMIHOSTING_RING_READ	8
+#define SEMIHOSTING_RING_DATA	12
+
+static void semihosting_out_flush(struct semihosting *semihosting)
+{
+	size_t done = 0;
+
+	while (done < semihosting->out_len) {
+		ssize_t count = write(semihosting->out_fd,
+				semihosting->out_buf + done, semihosting->out_len - done);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERROR("semihosting: write to %d failed: %s",
+				semihosting->out_fd, strerror(errno));
+			break;
+		}
+		done += count;
+	}
+
+	semihosting->out_len = 0;
+}
+
+/**
+ * @returns room for @a len bytes of output to @a fd in the output
+ * buffer, after flushing what is there as needed, or NULL if buffering
+ * is disabled or they do not fit. The caller adds @a len to out_len
+ * once the data is there.
+ */
+static uint8_t *semihosting_out_reserve(struct semihosting *semihosting,
+	int fd, size_t len)
+{
+	if (!semihosting->is_buffered || len > SEMIHOSTING_OUT_BUF_SIZE)
+		return NULL;
+
+	if (semihosting->out_fd != fd
+			|| semihosting->out_len + len > SEMIHOSTING_OUT_BUF_SIZE)
+		semihosting_out_flush(semihosting);
+
+	semihosting->out_fd = fd;
+	return semihosting->out_buf + semihosting->out_len;
+}
+
+static void semihosting_out_write(struct semihosting *semihosting, int fd,
+	const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		size_t count = MIN(len, SEMIHOSTING_OUT_BUF_SIZE);
+		uint8_t *room = semihosting_out_reserve(semihosting, fd, count);
+
+		if (!room) {
+			semihosting_out_flush(semihosting);
+			semihosting->out_fd = fd;
+			room = semihosting->out_buf;
+		}
+
+		memcpy(room, buf, count);
+		semihosting->out_len += count;
+		buf += count;
+		len -= count;
+
+		if (!semihosting->is_buffered)
+			semihosting_out_flush(semihosting);
+	}
+}
+
+/**
+ * Read the null-terminated string at @a addr in blocks which do not cross
+ * a 64 bytes boundary, hence no page past its end.
+ * @a emit is called for every piece, if not NULL.
+ * @returns the length of the string in @a len.
+ */
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	void (*emit)(struct semihosting *semihosting, const uint8_t *buf, size_t len),
+	size_t *len)
+{
+	*len = 0;
+
+	for (;;) {
+		uint8_t block[64];
+		size_t count = sizeof(block) - (addr % sizeof(block));
+
+		int retval = target_read_buffer(target, addr, count, block);
+		if (retval != ERROR_OK)
+			return retval;
+
+		uint8_t *end = memchr(block, 0, count);
+		if (end)
+			count = end - block;
+		if (emit)
+			emit(target->semihosting, block, count);
+		*len += count;
+		if (end)
+			return ERROR_OK;
+		addr += count;
+	}
+}
+
+static void semihosting_emit_stdout(struct semihosting *semihosting,
+	const uint8_t *buf, size_t len)
+{
+	semihosting_out_write(semihosting, STDOUT_FILENO, buf, len);
+}
+
+static int semihosting_ring_drain(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	uint64_t ring = semihosting->ring_address;
+	uint8_t header[SEMIHOSTING_RING_DATA];
+
+	int retval = target_read_memory(target, ring, 4, 3, header);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t size = target_buffer_get_u32(target, header + SEMIHOSTING_RING_SIZE);
+	uint32_t wr = target_buffer_get_u32(target, header + SEMIHOSTING_RING_WRITE);
+	uint32_t rd = target_buffer_get_u32(target, header + SEMIHOSTING_RING_READ);
+	if (rd == wr)
+		return ERROR_OK;
+
+	if (wr >= size || rd >= size) {
+		LOG_ERROR("semihosting ring at 0x%" PRIx64 " is corrupt, size %" PRIu32
+			" write %" PRIu32 " read %" PRIu32 ", disabling it",
+			ring, size, wr, rd);
+		semihosting->has_ring = false;
+		return ERROR_FAIL;
+	}
+
+	while (rd != wr) {
+		uint8_t block[1024];
+		uint32_t count = MIN((wr > rd ? wr : size) - rd, sizeof(block));
+
+		retval = target_read_buffer(target, ring + SEMIHOSTING_RING_DATA + rd,
+				count, block);
+		if (retval != ERROR_OK)
+			return retval;
+		semihosting_out_write(semihosting, STDOUT_FILENO, block, count);
+
+		rd += count;
+		if (rd == size)
+			rd = 0;
+	}
+
+	semihosting_out_flush(semihosting);
+
+	return target_write_u32(target, ring + SEMIHOSTING_RING_READ, rd);
+}
+
+static int semihosting_ring_callback(void *priv)
+{
+	struct target *target = priv;
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting->has_ring || !target_was_examined(target))
+		return ERROR_OK;
+	if (target->state != TARGET_RUNNING && target->state != TARGET_HALTED)
+		return ERROR_OK;
+
+	/* errors of a running target are not fatal, try again next time */
+	semihosting_ring_drain(target);
+	return ERROR_OK;
+}
+
+static int semihosting_flush_callback(void *priv)
+{
+	struct target *target = priv;
+
+	semihosting_out_flush(target->semihosting);
+	return ERROR_OK;
+}
+
 /**
  * Initialize common semihosting support.
  *
@@ -121,6 +304,12 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->result = -1;
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
+	semihosting->is_buffered = true;
+	semihosting->out_fd = -1;
+	semihosting->out_len = 0;
+	semihosting->has_ring = false;
+	semihosting->ring_address = 0;
+	semihosting->ring_period_ms = 0;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -133,6 +322,9 @@ int semihosting_common_init(struct target *target, void *setup,
 	target->type->get_gdb_fileio_info = semihosting_common_fileio_info;
 	target->type->gdb_fileio_end = semihosting_common_fileio_end;
 
+	target_register_timer_callback(semihosting_flush_callback,
+		SEMIHOSTING_FLUSH_MS, TARGET_TIMER_TYPE_PERIODIC, target);
+
 	return ERROR_OK;
 }
 
@@ -168,6 +360,16 @@ int semihosting_common(struct target *target)
 	LOG_DEBUG("op=0x%x, param=0x%" PRIx64, (int)semihosting->op,
 		semihosting->param);
 
+	/* keep the output of the ring and of the call in order */
+	if (semihosting->has_ring)
+		semihosting_ring_drain(target);
+
+	/* what the call does may depend on the buffered output */
+	if (semihosting->op != SEMIHOSTING_SYS_WRITE
+			&& semihosting->op != SEMIHOSTING_SYS_WRITEC
+			&& semihosting->op != SEMIHOSTING_SYS_WRITE0)
+		semihosting_out_flush(semihosting);
+
 	switch (semihosting->op) {
 
 		case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
@@ -1137,13 +1339,23 @@ int semihosting_common(struct target *target)
 				int fd = semihosting_get_field(target, 0, fields);
 				uint64_t addr = semihosting_get_field(target, 1, fields);
 				size_t len = semihosting_get_field(target, 2, fields);
+				uint8_t *room = semihosting->is_fileio ? NULL
+					: semihosting_out_reserve(semihosting, fd, len);
 				if (semihosting->is_fileio) {
 					semihosting->hit_fileio = true;
 					fileio_info->identifier = "write";
 					fileio_info->param_1 = fd;
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
+				} else if (room) {
+					/* the write happens later, assume that it succeeds */
+					retval = target_read_buffer(target, addr, len, room);
+					if (retval != ERROR_OK)
+						return retval;
+					semihosting->out_len += len;
+					semihosting->result = 0;
 				} else {
+					semihosting_out_flush(semihosting);
 					uint8_t *buf = malloc(len);
 					if (!buf) {
 						semihosting->result = -1;
@@ -1199,7 +1411,7 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				putchar(c);
+				semihosting_out_write(semihosting, STDOUT_FILENO, &c, 1);
 				semihosting->result = 0;
 			}
 			break;
@@ -1218,33 +1430,22 @@ int semihosting_common(struct target *target)
 			 * None. The RETURN REGISTER is corrupted.
 			 */
 			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
-				}
+				size_t count;
+				retval = semihosting_read_string(target, semihosting->param,
+						NULL, &count);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
 				fileio_info->param_1 = 1;
 				fileio_info->param_2 = semihosting->param;
 				fileio_info->param_3 = count;
 			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					putchar(c);
-				} while (1);
+				size_t count;
+				retval = semihosting_read_string(target, semihosting->param,
+						semihosting_emit_stdout, &count);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->result = 0;
 			}
 			break;
@@ -1595,6 +1796,83 @@ static __COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+static __COMMAND_HANDLER(handle_common_semihosting_buffered_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (target == NULL) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting->is_buffered);
+		if (!semihosting->is_buffered)
+			semihosting_out_flush(semihosting);
+	}
+
+	command_print(CMD, "semihosting output buffering is %s",
+		semihosting->is_buffered
+		? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
+static __COMMAND_HANDLER(handle_common_semihosting_ring_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (target == NULL) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 0) {
+		if (semihosting->has_ring) {
+			target_unregister_timer_callback(semihosting_ring_callback, target);
+			semihosting->has_ring = false;
+		}
+
+		if (strcmp(CMD_ARGV[0], "disable") != 0) {
+			unsigned int period_ms = 10;
+
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], semihosting->ring_address);
+			if (CMD_ARGC > 1)
+				COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], period_ms);
+			if (period_ms == 0)
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+
+			semihosting->ring_period_ms = period_ms;
+			semihosting->has_ring = true;
+			target_register_timer_callback(semihosting_ring_callback,
+				period_ms, TARGET_TIMER_TYPE_PERIODIC, target);
+		}
+	}
+
+	if (semihosting->has_ring)
+		command_print(CMD, "semihosting ring at 0x%" PRIx64 ", polled every %u ms",
+			semihosting->ring_address, semihosting->ring_period_ms);
+	else
+		command_print(CMD, "semihosting ring is disabled");
+
+	return ERROR_OK;
+}
+
 const struct command_registration semihosting_common_handlers[] = {
 	{
 		"semihosting",
@@ -1624,5 +1902,20 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		"semihosting_buffered",
+		.handler = handle_common_semihosting_buffered_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['enable'|'disable']",
+		.help = "coalesce the host writes of semihosting write operations",
+	},
+	{
+		"semihosting_ring",
+		.handler = handle_common_semihosting_ring_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[address [period_ms]|'disable']",
+		.help = "drain a ring buffer in target memory to stdout "
+			"without halting the target",
+	},
 	COMMAND_REGISTRATION_DONE
 };
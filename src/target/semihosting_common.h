@@ -90,6 +90,9 @@ enum semihosting_reported_exceptions {
 
 struct target;
 
+/** Size of the buffer coalescing the output of write operations. */
+#define SEMIHOSTING_OUT_BUF_SIZE	4096
+
 /*
  * A pointer to this structure was added to the target structure.
  */
@@ -152,6 +155,25 @@ struct semihosting {
 	/** The current time when 'execution starts' */
 	clock_t setup_time;
 
+	/**
+	 * Coalesce the host writes of consecutive write operations to the
+	 * same file, until another operation or the periodic flush.
+	 */
+	bool is_buffered;
+
+	/** The file of the pending output in out_buf. */
+	int out_fd;
+	size_t out_len;
+	uint8_t out_buf[SEMIHOSTING_OUT_BUF_SIZE];
+
+	/**
+	 * A ring in target memory, drained to stdout without halting the
+	 * target, see "semihosting_ring".
+	 */
+	bool has_ring;
+	uint64_t ring_address;
+	unsigned int ring_period_ms;
+
 	int (*setup)(struct target *target, int enable);
 	int (*post_result)(struct target *target);
 };
@@ -124,6 +124,10 @@ static const struct {
 #define PUL 0x02
 #define WR_PG_DIS 0x01
 
+/* fast, i.e. without erase, programming of a byte, word or block takes
+ * about 3 ms, standard programming about 6 ms */
+#define STM8_PROG_MIN_US 3000
+
 /* FLASH_CR2 */
 #define OPT 0x80
 #define WPRG 0x40
@@ -656,6 +660,26 @@ static int stm8_unlock_eeprom(struct target *target)
 	return ERROR_OK;
 }
 
+/* Select the programming mode @a mode in FLASH_CR2 and its complement in
+ * FLASH_NCR2. The hardware clears it after each block, word or byte. */
+static int stm8_flash_select_mode(struct target *target, uint8_t mode)
+{
+	struct stm8_common *stm8 = target_to_stm8(target);
+
+	/* on STM8S both registers are adjacent, one SWIM write sets them */
+	if (stm8->flash_cr2 && stm8->flash_ncr2 == stm8->flash_cr2 + 1) {
+		uint8_t buf[2] = { mode, ~mode };
+		return stm8_adapter_write_memory(target, stm8->flash_cr2, 1, 2, buf);
+	}
+
+	int res = ERROR_OK;
+	if (stm8->flash_cr2)
+		res = stm8_write_u8(target, stm8->flash_cr2, mode);
+	if (res == ERROR_OK && stm8->flash_ncr2)
+		res = stm8_write_u8(target, stm8->flash_ncr2, ~mode);
+	return res;
+}
+
 static int stm8_write_flash(struct target *target, enum mem_type type,
 		uint32_t address,
 		uint32_t size, uint32_t count, uint32_t blocksize_param,
@@ -695,27 +719,24 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 	bytecnt = count * size;
 
 	while (bytecnt) {
-		if ((bytecnt >= blocksize_param) && ((address & (blocksize_param-1)) == 0)) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, PRG + opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~(PRG + opt));
+		if (blocksize_param && (bytecnt >= blocksize_param) &&
+				((address & (blocksize_param-1)) == 0)) {
+			res = stm8_flash_select_mode(target, PRG + opt);
 			blocksize = blocksize_param;
 		} else
 		if ((bytecnt >= 4) && ((address & 0x3) == 0)) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, WPRG + opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~(WPRG + opt));
+			res = stm8_flash_select_mode(target, WPRG + opt);
 			blocksize = 4;
-		} else
-		if (blocksize != 1) {
-			if (stm8->flash_cr2)
-				stm8_write_u8(target, stm8->flash_cr2, opt);
-			if (stm8->flash_ncr2)
-				stm8_write_u8(target, stm8->flash_ncr2, ~opt);
+		} else {
+			/* byte programming is selected with no mode bit, which
+			 * the hardware left there after the previous byte */
+			res = ERROR_OK;
+			if (blocksize != 1)
+				res = stm8_flash_select_mode(target, opt);
 			blocksize = 1;
 		}
+		if (res != ERROR_OK)
+			return res;
 
 		res = stm8_adapter_write_memory(target, address, 1, blocksize, buffer);
 		if (res != ERROR_OK)
@@ -724,9 +745,14 @@ static int stm8_write_flash(struct target *target, enum mem_type type,
 		buffer += blocksize;
 		bytecnt -= blocksize;
 
-		/* lets hang here until end of program (EOP) */
+		/* Lets hang here until end of program (EOP). Each poll costs
+		 * some USB round trips, so don't poll before the shortest
+		 * programming time has passed. */
+		usleep(STM8_PROG_MIN_US);
 		for (i = 0; i < 16; i++) {
-			stm8_read_u8(target, stm8->flash_iapsr, &iapsr);
+			res = stm8_read_u8(target, stm8->flash_iapsr, &iapsr);
+			if (res != ERROR_OK)
+				return res;
 			if (iapsr & EOP)
 				break;
 			else
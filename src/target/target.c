@@ -42,12 +42,15 @@
 #endif
 
 #include <helper/time_support.h>
+#include <helper/perf.h>
 #include <jtag/jtag.h>
 #include <flash/nor/core.h>
 
 #include "target.h"
 #include "target_type.h"
 #include "target_request.h"
+#include "target_sample.h"
+#include "rtt.h"
 #include "breakpoints.h"
 #include "register.h"
 #include "trace.h"
@@ -68,12 +71,11 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 static int target_mem2array(Jim_Interp *interp, struct target *target,
 		int argc, Jim_Obj * const *argv);
 static int target_register_user_commands(struct command_context *cmd_ctx);
+static int target_lazy_restore_working_area(struct target *target);
 static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
-static int target_profiling_default(struct target *target, uint32_t *samples,
-		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
 /* targets */
 extern struct target_type arm7tdmi_target;
@@ -155,10 +157,18 @@ static struct target_type *target_types[] = {
 
 struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
-static struct target_timer_callback *target_timer_callbacks;
+/* timer callbacks, kept as a binary min-heap ordered by deadline */
+static struct target_timer_callback **timer_heap;
+static unsigned int timer_heap_count;
+static unsigned int timer_heap_alloc;
+/* the timer callback being executed, see target_unregister_timer_callback() */
+static struct target_timer_callback *timer_running;
 LIST_HEAD(target_reset_callback_list);
 LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = 100;
+/* adaptive polling: fast right after resume/step, backing off to the max */
+static unsigned int poll_interval_min = 10;
+static unsigned int poll_interval_max = 100;
 
 static const Jim_Nvp nvp_assert[] = {
 	{ .name = "assert", NVP_ASSERT },
@@ -543,6 +553,157 @@ struct target *get_current_target_or_null(struct command_context *cmd_ctx)
 		: cmd_ctx->current_target;
 }
 
+/* Direct mapped cache of target memory, only used while the target is halted.
+ * Lines are always fetched with 32 bit accesses. */
+#define TARGET_MEM_CACHE_LINE_SIZE	64
+#define TARGET_MEM_CACHE_LINES		64
+/* longer requests go to the target directly and leave the cache alone */
+#define TARGET_MEM_CACHE_MAX_LINES	4
+
+struct target_mem_cache_region {
+	target_addr_t address;
+	target_addr_t size;
+};
+
+struct target_mem_cache {
+	/* address of the line held by each slot */
+	target_addr_t tag[TARGET_MEM_CACHE_LINES];
+	bool valid[TARGET_MEM_CACHE_LINES];
+	uint8_t data[TARGET_MEM_CACHE_LINES][TARGET_MEM_CACHE_LINE_SIZE];
+	/* regions never cached, e.g. peripherals */
+	struct target_mem_cache_region *volatile_regions;
+	unsigned int num_volatile;
+	uint64_t hits;
+	uint64_t misses;
+	/* enabled by "mem_cache on", else it only exists while shared */
+	bool enabled;
+	unsigned int sharers;
+};
+
+static void target_mem_cache_invalidate(struct target *target)
+{
+	if (target->mem_cache)
+		memset(target->mem_cache->valid, 0, sizeof(target->mem_cache->valid));
+}
+
+/* bumped by target_mem_cache_invalidate_all(), see target_memory_generation() */
+static unsigned int target_mem_generation;
+
+/* Memory may be shared between targets, a write through any of them or a
+ * state change of any of them invalidates all caches. */
+static void target_mem_cache_invalidate_all(void)
+{
+	target_mem_generation++;
+	for (struct target *target = all_targets; target; target = target->next)
+		target_mem_cache_invalidate(target);
+}
+
+/* bumped by target_mem_cache_written(), see target_memory_write_generation() */
+static unsigned int target_mem_write_generation;
+
+/* The memory was written through OpenOCD, or a target ran or was reset */
+static void target_mem_cache_written(void)
+{
+	target_mem_write_generation++;
+	target_mem_cache_invalidate_all();
+}
+
+static bool target_mem_cache_is_volatile(struct target_mem_cache *cache,
+		target_addr_t address, target_addr_t len)
+{
+	for (unsigned int i = 0; i < cache->num_volatile; i++) {
+		struct target_mem_cache_region *r = &cache->volatile_regions[i];
+		if (address < r->address + r->size && r->address < address + len)
+			return true;
+	}
+	return false;
+}
+
+static int target_mem_cache_read(struct target *target,
+		target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+	target_addr_t len = (target_addr_t)size * count;
+	target_addr_t first = address & ~(target_addr_t)(TARGET_MEM_CACHE_LINE_SIZE - 1);
+	target_addr_t end = address + len;
+
+	/* a single access of register size is most likely a register, e.g.
+	 * a flash driver polling its status, never cache it */
+	if (count == 1 && size <= 4)
+		return target->type->read_memory(target, address, size, count, buffer);
+
+	if (end - first > TARGET_MEM_CACHE_MAX_LINES * TARGET_MEM_CACHE_LINE_SIZE
+			|| end < address)
+		return target->type->read_memory(target, address, size, count, buffer);
+
+	/* whole lines are filled, none of them may touch a volatile region */
+	target_addr_t line_end = (end + TARGET_MEM_CACHE_LINE_SIZE - 1)
+		& ~(target_addr_t)(TARGET_MEM_CACHE_LINE_SIZE - 1);
+	if (line_end < end || target_mem_cache_is_volatile(cache, first, line_end - first))
+		return target->type->read_memory(target, address, size, count, buffer);
+
+	for (target_addr_t line = first; line < end; line += TARGET_MEM_CACHE_LINE_SIZE) {
+		unsigned int slot = (line / TARGET_MEM_CACHE_LINE_SIZE) % TARGET_MEM_CACHE_LINES;
+
+		if (cache->valid[slot] && cache->tag[slot] == line) {
+			cache->hits++;
+		} else {
+			cache->misses++;
+			cache->valid[slot] = false;
+			int retval = target->type->read_memory(target, line, 4,
+					TARGET_MEM_CACHE_LINE_SIZE / 4, cache->data[slot]);
+			if (retval != ERROR_OK) {
+				/* e.g. the line crosses the end of the memory */
+				return target->type->read_memory(target, address, size, count, buffer);
+			}
+			cache->tag[slot] = line;
+			cache->valid[slot] = true;
+		}
+
+		target_addr_t from = MAX(line, address);
+		target_addr_t to = MIN(line + TARGET_MEM_CACHE_LINE_SIZE, end);
+		memcpy(buffer + (from - address), cache->data[slot] + (from - line), to - from);
+	}
+
+	return ERROR_OK;
+}
+
+unsigned int target_memory_generation(void)
+{
+	return target_mem_generation;
+}
+
+unsigned int target_memory_write_generation(void)
+{
+	return target_mem_write_generation;
+}
+
+int target_mem_cache_share(struct target *target, bool share)
+{
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (share) {
+		if (!cache) {
+			cache = calloc(1, sizeof(*cache));
+			if (!cache) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			target->mem_cache = cache;
+		}
+		cache->sharers++;
+	} else if (cache && cache->sharers) {
+		cache->sharers--;
+		if (!cache->sharers && !cache->enabled) {
+			free(cache->volatile_regions);
+			free(cache);
+			target->mem_cache = NULL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 int target_poll(struct target *target)
 {
 	int retval;
@@ -635,6 +796,15 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	/* algorithms run with debug_execution, their working areas stay */
+	if (!debug_execution) {
+		retval = target_lazy_restore_working_area(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	target_mem_cache_written();
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -643,6 +813,10 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* anything read while resuming, e.g. to step over a breakpoint, is
+	 * stale once the target runs */
+	target_mem_cache_written();
+
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_END);
 
 	return retval;
@@ -663,6 +837,8 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	for (target = all_targets; target; target = target->next)
 		target_call_reset_callbacks(target, reset_mode);
 
+	target_mem_cache_written();
+
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
 	 * not have JTAG operations injected into the middle of a sequence.
@@ -722,14 +898,21 @@ static int default_check_reset(struct target *target)
  * Keep in sync */
 int target_examine_one(struct target *target)
 {
+	int64_t start = timeval_ms();
+
 	target_call_event_callbacks(target, TARGET_EVENT_EXAMINE_START);
 
 	int retval = target->type->examine(target);
 	if (retval != ERROR_OK) {
+		LOG_INFO("target %s examine failed after %" PRId64 " ms",
+				target_name(target), timeval_ms() - start);
 		target_call_event_callbacks(target, TARGET_EVENT_EXAMINE_FAIL);
 		return retval;
 	}
 
+	LOG_INFO("target %s examined in %" PRId64 " ms",
+			target_name(target), timeval_ms() - start);
+
 	target_call_event_callbacks(target, TARGET_EVENT_EXAMINE_END);
 
 	return ERROR_OK;
@@ -756,6 +939,7 @@ int target_examine(void)
 {
 	int retval = ERROR_OK;
 	struct target *target;
+	int64_t start = timeval_ms();
 
 	for (target = all_targets; target; target = target->next) {
 		/* defer examination, but don't skip it */
@@ -772,6 +956,8 @@ int target_examine(void)
 		if (retval != ERROR_OK)
 			return retval;
 	}
+
+	LOG_INFO("all targets examined in %" PRId64 " ms", timeval_ms() - start);
 	return retval;
 }
 
@@ -823,6 +1009,7 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_written();
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -862,6 +1049,7 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_written();
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -896,6 +1084,7 @@ int target_wait_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_mem_cache_written();
 	retval = target->type->wait_algorithm(target,
 			num_mem_params, mem_params,
 			num_reg_params, reg_params,
@@ -907,6 +1096,11 @@ done:
 	return retval;
 }
 
+struct async_algorithm_stats async_algorithm_stats;
+
+/* give up when the algorithm does not advance its read pointer for this long */
+#define ASYNC_ALGORITHM_TIMEOUT	5000
+
 /**
  * Streams data to a circular buffer on target intended for consumption by code
  * running asynchronously on target.
@@ -957,9 +1151,11 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point, void *arch_info)
 {
 	int retval;
-	int timeout = 0;
 
 	const uint8_t *buffer_orig = buffer;
+	int64_t stats_time = timeval_us();
+	bool first_round = true;
+	bool poll_rp = true;
 
 	/* Set up working area. First word is write pointer, second word is read pointer,
 	 * rest is fifo data area. */
@@ -968,9 +1164,16 @@ int target_run_flash_async_algorithm(struct target *target,
 	uint32_t fifo_start_addr = buffer_start + 8;
 	uint32_t fifo_end_addr = buffer_start + buffer_size;
 
+	uint32_t fifo_size = fifo_end_addr - fifo_start_addr;
+
 	uint32_t wp = fifo_start_addr;
 	uint32_t rp = fifo_start_addr;
 
+	/* last read pointer movement seen, for the drain rate */
+	uint32_t last_rp = rp, drained = 0;
+	int64_t last_rp_us = timeval_us(), drain_us = 0;
+	int64_t progress_ms = timeval_ms();
+
 	/* validate block_size is 2^n */
 	assert(!block_size || !(block_size & (block_size - 1)));
 
@@ -993,31 +1196,48 @@ int target_run_flash_async_algorithm(struct target *target,
 		return retval;
 	}
 
+	async_algorithm_stats.runs++;
+	async_algorithm_stats.start_us += timeval_us() - stats_time;
+	stats_time = timeval_us();
+
 	while (count > 0) {
 
-		retval = target_read_u32(target, rp_addr, &rp);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("failed to get read pointer");
-			break;
-		}
+		if (poll_rp) {
+			retval = target_read_u32(target, rp_addr, &rp);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("failed to get read pointer");
+				break;
+			}
 
-		LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
-			(size_t) (buffer - buffer_orig), count, wp, rp);
+			LOG_DEBUG("offs 0x%zx count 0x%" PRIx32 " wp 0x%" PRIx32 " rp 0x%" PRIx32,
+				(size_t) (buffer - buffer_orig), count, wp, rp);
 
-		if (rp == 0) {
-			LOG_ERROR("flash write algorithm aborted by target");
-			retval = ERROR_FLASH_OPERATION_FAILED;
-			break;
-		}
+			if (rp == 0) {
+				LOG_ERROR("flash write algorithm aborted by target");
+				retval = ERROR_FLASH_OPERATION_FAILED;
+				break;
+			}
 
-		if (((rp - fifo_start_addr) & (block_size - 1)) || rp < fifo_start_addr || rp >= fifo_end_addr) {
-			LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
-			break;
+			if (((rp - fifo_start_addr) & (block_size - 1)) || rp < fifo_start_addr || rp >= fifo_end_addr) {
+				LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
+				break;
+			}
+
+			/* measure how fast the target drains the fifo */
+			int64_t now = timeval_us();
+			if (rp != last_rp) {
+				drained = (rp - last_rp + fifo_size) % fifo_size;
+				drain_us = now - last_rp_us;
+				last_rp = rp;
+				last_rp_us = now;
+				progress_ms = timeval_ms();
+			}
 		}
 
 		/* Count the number of bytes available in the fifo without
 		 * crossing the wrap around. Make sure to not fill it completely,
-		 * because that would make wp == rp and that's the empty condition. */
+		 * because that would make wp == rp and that's the empty condition.
+		 * An rp kept from an earlier poll is a lower bound of the free space. */
 		uint32_t thisrun_bytes;
 		if (rp > wp)
 			thisrun_bytes = rp - wp - block_size;
@@ -1027,23 +1247,37 @@ int target_run_flash_async_algorithm(struct target *target,
 			thisrun_bytes = fifo_end_addr - wp - block_size;
 
 		if (thisrun_bytes == 0) {
-			/* Throttle polling a bit if transfer is (much) faster than flash
-			 * programming. The exact delay shouldn't matter as long as it's
-			 * less than buffer size / flash speed. This is very unlikely to
-			 * run when using high latency connections such as USB. */
-			alive_sleep(10);
+			if (!poll_rp) {
+				poll_rp = true;
+				continue;
+			}
 
-			/* to stop an infinite loop on some targets check and increment a timeout
+			/* Throttle polling if transfer is faster than flash programming:
+			 * sleep about as long as the target takes to free a quarter of
+			 * the fifo, judging by the last observed drain rate. Poll right
+			 * away while that is below a millisecond. */
+			uint32_t sleep_ms = 10;
+			if (drained)
+				sleep_ms = MIN(10, (uint64_t)drain_us * (fifo_size / 4) / drained / 1000);
+			if (sleep_ms)
+				alive_sleep(sleep_ms);
+
+			/* to stop an infinite loop on some targets check for a timeout
 			 * this issue was observed on a stellaris using the new ICDI interface */
-			if (timeout++ >= 500) {
+			if (timeval_ms() - progress_ms > ASYNC_ALGORITHM_TIMEOUT) {
 				LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
 				return ERROR_FLASH_OPERATION_FAILED;
 			}
 			continue;
 		}
 
-		/* reset our timeout */
-		timeout = 0;
+		/* the time since the last write went on polling a full fifo */
+		int64_t now = timeval_us();
+		if (!first_round && poll_rp && rp == wp)
+			async_algorithm_stats.empty++;
+		async_algorithm_stats.full_us += now - stats_time;
+		stats_time = now;
+		first_round = false;
 
 		/* Limit to the amount of data we actually want to write */
 		if (thisrun_bytes > count * block_size)
@@ -1066,6 +1300,17 @@ int target_run_flash_async_algorithm(struct target *target,
 		if (retval != ERROR_OK)
 			break;
 
+		now = timeval_us();
+		async_algorithm_stats.rounds++;
+		async_algorithm_stats.bytes += thisrun_bytes;
+		async_algorithm_stats.transfer_us += now - stats_time;
+		stats_time = now;
+
+		/* Without polling, keep filling the space known to be free since
+		 * the last poll, as long as that is at least a quarter of the fifo. */
+		uint32_t known_free = (rp - wp - block_size + fifo_size) % fifo_size;
+		poll_rp = known_free < fifo_size / 4;
+
 		/* Avoid GDB timeouts */
 		keep_alive();
 	}
@@ -1085,6 +1330,7 @@ int target_run_flash_async_algorithm(struct target *target,
 		LOG_ERROR("error waiting for target flash write algorithm");
 		retval = retval2;
 	}
+	async_algorithm_stats.drain_us += timeval_us() - stats_time;
 
 	if (retval == ERROR_OK) {
 		/* check if algorithm set rp = 0 after fifo writer loop finished */
@@ -1109,7 +1355,14 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
-	return target->type->read_memory(target, address, size, count, buffer);
+	int64_t start = perf_start();
+	int retval;
+	if (target->mem_cache && target->state == TARGET_HALTED)
+		retval = target_mem_cache_read(target, address, size, count, buffer);
+	else
+		retval = target->type->read_memory(target, address, size, count, buffer);
+	perf_end(PERF_TARGET_READ_MEMORY, start);
+	return retval;
 }
 
 int target_read_phys_memory(struct target *target,
@@ -1137,7 +1390,11 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
-	return target->type->write_memory(target, address, size, count, buffer);
+	target_mem_cache_written();
+	int64_t start = perf_start();
+	int retval = target->type->write_memory(target, address, size, count, buffer);
+	perf_end(PERF_TARGET_WRITE_MEMORY, start);
+	return retval;
 }
 
 int target_write_phys_memory(struct target *target,
@@ -1151,6 +1408,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_mem_cache_written();
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1262,6 +1520,22 @@ int target_get_gdb_reg_list_noread(struct target *target,
 	return target_get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+int target_read_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	if (!target->type->read_registers_batch)
+		return ERROR_OK;
+	return target->type->read_registers_batch(target, reg_list, reg_list_size);
+}
+
+int target_write_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	if (!target->type->write_registers_batch)
+		return ERROR_OK;
+	return target->type->write_registers_batch(target, reg_list, reg_list_size);
+}
+
 bool target_supports_gdb_connection(struct target *target)
 {
 	/*
@@ -1278,6 +1552,10 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	retval = target_lazy_restore_working_area(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1422,7 +1700,7 @@ static int target_init(struct command_context *cmd_ctx)
 		return retval;
 
 	retval = target_register_timer_callback(&handle_target,
-			polling_interval, TARGET_TIMER_TYPE_PERIODIC, cmd_ctx->interp);
+			poll_interval_min, TARGET_TIMER_TYPE_PERIODIC, cmd_ctx->interp);
 	if (ERROR_OK != retval)
 		return retval;
 
@@ -1525,31 +1803,111 @@ int target_register_trace_callback(int (*callback)(struct target *target,
 	return ERROR_OK;
 }
 
+static bool timer_heap_before(unsigned int a, unsigned int b)
+{
+	return timeval_compare(&timer_heap[a]->when, &timer_heap[b]->when) < 0;
+}
+
+static void timer_heap_swap(unsigned int a, unsigned int b)
+{
+	struct target_timer_callback *t = timer_heap[a];
+	timer_heap[a] = timer_heap[b];
+	timer_heap[b] = t;
+	timer_heap[a]->heap_index = a;
+	timer_heap[b]->heap_index = b;
+}
+
+static void timer_heap_sift_up(unsigned int i)
+{
+	while (i > 0 && timer_heap_before(i, (i - 1) / 2)) {
+		timer_heap_swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void timer_heap_sift_down(unsigned int i)
+{
+	for (;;) {
+		unsigned int first = i;
+		unsigned int l = 2 * i + 1, r = 2 * i + 2;
+
+		if (l < timer_heap_count && timer_heap_before(l, first))
+			first = l;
+		if (r < timer_heap_count && timer_heap_before(r, first))
+			first = r;
+		if (first == i)
+			return;
+		timer_heap_swap(i, first);
+		i = first;
+	}
+}
+
+/* the deadline of the callback at index i changed */
+static void timer_heap_update(unsigned int i)
+{
+	struct target_timer_callback *cb = timer_heap[i];
+
+	timer_heap_sift_up(i);
+	timer_heap_sift_down(cb->heap_index);
+}
+
+static int timer_heap_insert(struct target_timer_callback *cb)
+{
+	if (timer_heap_count == timer_heap_alloc) {
+		unsigned int alloc = timer_heap_alloc ? 2 * timer_heap_alloc : 16;
+		struct target_timer_callback **heap = realloc(timer_heap, alloc * sizeof(*heap));
+		if (!heap)
+			return ERROR_FAIL;
+		timer_heap = heap;
+		timer_heap_alloc = alloc;
+	}
+
+	cb->heap_index = timer_heap_count;
+	timer_heap[timer_heap_count++] = cb;
+	timer_heap_sift_up(cb->heap_index);
+	return ERROR_OK;
+}
+
+static void timer_heap_remove(struct target_timer_callback *cb)
+{
+	unsigned int i = cb->heap_index;
+
+	timer_heap_count--;
+	if (i == timer_heap_count)
+		return;
+
+	timer_heap[i] = timer_heap[timer_heap_count];
+	timer_heap[i]->heap_index = i;
+	timer_heap_update(i);
+}
+
 int target_register_timer_callback(int (*callback)(void *priv),
 		unsigned int time_ms, enum target_timer_type type, void *priv)
 {
-	struct target_timer_callback **callbacks_p = &target_timer_callbacks;
-
 	if (callback == NULL)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	if (*callbacks_p) {
-		while ((*callbacks_p)->next)
-			callbacks_p = &((*callbacks_p)->next);
-		callbacks_p = &((*callbacks_p)->next);
+	struct target_timer_callback *cb = malloc(sizeof(struct target_timer_callback));
+	if (!cb) {
+		LOG_ERROR("Unable to allocate memory");
+		return ERROR_FAIL;
 	}
 
-	(*callbacks_p) = malloc(sizeof(struct target_timer_callback));
-	(*callbacks_p)->callback = callback;
-	(*callbacks_p)->type = type;
-	(*callbacks_p)->time_ms = time_ms;
-	(*callbacks_p)->removed = false;
+	cb->callback = callback;
+	cb->type = type;
+	cb->time_ms = time_ms;
+	cb->removed = false;
 
-	gettimeofday(&(*callbacks_p)->when, NULL);
-	timeval_add_time(&(*callbacks_p)->when, 0, time_ms * 1000);
+	gettimeofday(&cb->when, NULL);
+	timeval_add_time(&cb->when, 0, time_ms * 1000);
 
-	(*callbacks_p)->priv = priv;
-	(*callbacks_p)->next = NULL;
+	cb->priv = priv;
+
+	if (timer_heap_insert(cb) != ERROR_OK) {
+		LOG_ERROR("Unable to allocate memory");
+		free(cb);
+		return ERROR_FAIL;
+	}
 
 	return ERROR_OK;
 }
@@ -1620,10 +1978,15 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	if (callback == NULL)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	for (struct target_timer_callback *c = target_timer_callbacks;
-	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+	for (unsigned int i = 0; i < timer_heap_count; i++) {
+		struct target_timer_callback *c = timer_heap[i];
+		if ((c->callback == callback) && (c->priv == priv) && !c->removed) {
+			/* a running callback is released once it returns */
 			c->removed = true;
+			if (c != timer_running) {
+				timer_heap_remove(c);
+				free(c);
+			}
 			return ERROR_OK;
 		}
 	}
@@ -1631,11 +1994,42 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	return ERROR_FAIL;
 }
 
+/* @returns true for a halt at a breakpoint whose GDB conditions are false */
+static bool target_breakpoint_conditions_false(struct target *target)
+{
+	if (target->debug_reason != DBG_REASON_BREAKPOINT)
+		return false;
+	if (!target->breakpoints && !(target->smp && target->head->target->breakpoints))
+		return false;
+
+	struct reg *pc = register_get_by_name(target->reg_cache, "pc", 1);
+	if (!pc || (!pc->valid && pc->type->get(pc) != ERROR_OK))
+		return false;
+
+	return !breakpoint_conditions_met(target, buf_get_u64(pc->value, 0, MIN(pc->size, 64)));
+}
+
 int target_call_event_callbacks(struct target *target, enum target_event event)
 {
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	/* resume, step, halt and reset all leave memory in an unknown state */
+	target_mem_cache_invalidate_all();
+
+	/* continue over a conditional breakpoint as if it had not been hit,
+	 * without waking up GDB or the event handlers */
+	if (event == TARGET_EVENT_HALTED && target_breakpoint_conditions_false(target)) {
+		LOG_DEBUG("breakpoint condition false, resuming %s", target_name(target));
+		if (target_resume(target, 1, 0, 1, 0) == ERROR_OK)
+			return ERROR_OK;
+	}
+
+	/* a halt is most likely to follow shortly after a resume or a step */
+	if (event == TARGET_EVENT_RESUMED || event == TARGET_EVENT_RESUME_END ||
+			event == TARGET_EVENT_STEP_END)
+		target_poll_request(target);
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1679,25 +2073,6 @@ int target_call_trace_callbacks(struct target *target, size_t len, uint8_t *data
 	return ERROR_OK;
 }
 
-static int target_timer_callback_periodic_restart(
-		struct target_timer_callback *cb, struct timeval *now)
-{
-	cb->when = *now;
-	timeval_add_time(&cb->when, 0, cb->time_ms * 1000L);
-	return ERROR_OK;
-}
-
-static int target_call_timer_callback(struct target_timer_callback *cb,
-		struct timeval *now)
-{
-	cb->callback(cb->priv);
-
-	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
-		return target_timer_callback_periodic_restart(cb, now);
-
-	return target_unregister_timer_callback(cb->callback, cb->priv);
-}
-
 static int target_call_timer_callbacks_check_time(int checktime)
 {
 	static bool callback_processing;
@@ -1713,32 +2088,81 @@ static int target_call_timer_callbacks_check_time(int checktime)
 	struct timeval now;
 	gettimeofday(&now, NULL);
 
-	/* Store an address of the place containing a pointer to the
-	 * next item; initially, that's a standalone "root of the
-	 * list" variable. */
-	struct target_timer_callback **callback = &target_timer_callbacks;
-	while (callback && *callback) {
-		if ((*callback)->removed) {
-			struct target_timer_callback *p = *callback;
-			*callback = (*callback)->next;
-			free(p);
-			continue;
-		}
+	/* make every periodic callback due */
+	if (!checktime) {
+		for (unsigned int i = 0; i < timer_heap_count; i++)
+			if (timer_heap[i]->type == TARGET_TIMER_TYPE_PERIODIC)
+				timer_heap[i]->when = now;
+		for (unsigned int i = timer_heap_count / 2; i-- > 0; )
+			timer_heap_sift_down(i);
+	}
 
-		bool call_it = (*callback)->callback &&
-			((!checktime && (*callback)->type == TARGET_TIMER_TYPE_PERIODIC) ||
-			 timeval_compare(&now, &(*callback)->when) >= 0);
+	/* Callbacks may register and unregister callbacks, so always look at the
+	 * top of the heap again. A periodic callback is rescheduled at least 1 us
+	 * in the future, so each one runs at most once per call. */
+	while (timer_heap_count > 0 && timeval_compare(&now, &timer_heap[0]->when) >= 0) {
+		struct target_timer_callback *cb = timer_heap[0];
 
-		if (call_it)
-			target_call_timer_callback(*callback, &now);
+		timer_running = cb;
+		cb->callback(cb->priv);
+		timer_running = NULL;
+
+		if (cb->removed || cb->type != TARGET_TIMER_TYPE_PERIODIC) {
+			timer_heap_remove(cb);
+			free(cb);
+			continue;
+		}
 
-		callback = &(*callback)->next;
+		cb->when = now;
+		timeval_add_time(&cb->when, 0, MAX(cb->time_ms * 1000L, 1L));
+		timer_heap_update(cb->heap_index);
 	}
 
 	callback_processing = false;
 	return ERROR_OK;
 }
 
+static bool timer_callbacks_poll;
+
+/* A timer callback has more work queued: run the callbacks again without the
+ * polling period sleep */
+void target_timer_callbacks_request_poll(void)
+{
+	timer_callbacks_poll = true;
+}
+
+bool target_timer_callbacks_poll_requested(void)
+{
+	bool t = timer_callbacks_poll;
+	timer_callbacks_poll = false;
+	return t;
+}
+
+int64_t target_timer_next_event(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	if (!timer_heap_count)
+		return polling_interval;
+
+	struct timeval *when = &timer_heap[0]->when;
+	int64_t next = (when->tv_sec - now.tv_sec) * 1000
+		+ (when->tv_usec - now.tv_usec) / 1000;
+
+	return MIN(MAX(next, 0), (int64_t)polling_interval);
+}
+
+void target_poll_request(struct target *target)
+{
+	for (struct target *t = target ? target : all_targets; t; t = t->next) {
+		t->poll_interval_ms = poll_interval_min;
+		t->poll_next_ms = 0;
+		if (target)
+			break;
+	}
+}
+
 int target_call_timer_callbacks(void)
 {
 	return target_call_timer_callbacks_check_time(1);
@@ -1822,6 +2246,92 @@ static void target_merge_working_areas(struct target *target)
 	}
 }
 
+static bool target_working_area_word_saved(struct target *target, uint32_t word)
+{
+	return target->working_area_saved[word / 32] & (1u << (word % 32));
+}
+
+/*
+ * "-work-area-backup lazy": the words of @a area not saved since the last
+ * restore are read into the shadow of the whole working area. The words
+ * already saved hold algorithm scratch now, their backup is still valid.
+ */
+static int target_lazy_backup_working_area(struct target *target, struct working_area *area)
+{
+	uint32_t words = (target->working_area_size & ~3UL) / 4;
+
+	if (!target->working_area_shadow) {
+		target->working_area_shadow = malloc(words * 4);
+		target->working_area_saved = calloc(DIV_ROUND_UP(words, 32), sizeof(uint32_t));
+		if (!target->working_area_shadow || !target->working_area_saved) {
+			LOG_ERROR("Out of memory");
+			free(target->working_area_shadow);
+			free(target->working_area_saved);
+			target->working_area_shadow = NULL;
+			target->working_area_saved = NULL;
+			return ERROR_FAIL;
+		}
+	}
+
+	uint32_t first = (area->address - target->working_area) / 4;
+	uint32_t last = first + area->size / 4;
+
+	for (uint32_t w = first; w < last; ) {
+		if (target_working_area_word_saved(target, w)) {
+			w++;
+			continue;
+		}
+
+		uint32_t end = w;
+		while (end < last && !target_working_area_word_saved(target, end))
+			end++;
+
+		int retval = target_read_memory(target, target->working_area + 4 * w,
+				4, end - w, target->working_area_shadow + 4 * w);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (; w < end; w++)
+			target->working_area_saved[w / 32] |= 1u << (w % 32);
+	}
+
+	return ERROR_OK;
+}
+
+/* Write back all the words saved by target_lazy_backup_working_area(). */
+static int target_lazy_restore_working_area(struct target *target)
+{
+	uint32_t words = (target->working_area_size & ~3UL) / 4;
+	int retval = ERROR_OK;
+
+	if (!target->working_area_saved)
+		return ERROR_OK;
+
+	for (uint32_t w = 0; w < words; ) {
+		if (!target_working_area_word_saved(target, w)) {
+			w++;
+			continue;
+		}
+
+		uint32_t end = w;
+		while (end < words && target_working_area_word_saved(target, end))
+			end++;
+
+		int ret = target_write_memory(target, target->working_area + 4 * w,
+				4, end - w, target->working_area_shadow + 4 * w);
+		if (ret != ERROR_OK) {
+			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address "
+					TARGET_ADDR_FMT, 4 * (end - w), target->working_area + 4 * w);
+			retval = ret;
+		}
+		w = end;
+	}
+
+	memset(target->working_area_saved, 0, DIV_ROUND_UP(words, 32) * sizeof(uint32_t));
+
+	return retval;
+}
+
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -1875,13 +2385,16 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	if (size % 4)
 		size = (size + 3) & (~3UL);
 
-	struct working_area *c = target->working_areas;
+	struct working_area *c = NULL;
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
+	/* Find the smallest large enough working area, which keeps the large
+	 * free blocks for the large allocations that may follow */
+	for (struct working_area *i = target->working_areas; i; i = i->next) {
+		if (i->free && i->size >= size && (!c || i->size < c->size)) {
+			c = i;
+			if (c->size == size)
+				break;
+		}
 	}
 
 	if (c == NULL)
@@ -1893,7 +2406,11 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	LOG_DEBUG("allocated new working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
 			  size, c->address);
 
-	if (target->backup_working_area) {
+	if (target->backup_working_area == TARGET_WORK_AREA_BACKUP_LAZY) {
+		int retval = target_lazy_backup_working_area(target, c);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (target->backup_working_area) {
 		if (c->backup == NULL) {
 			c->backup = malloc(c->size);
 			if (c->backup == NULL)
@@ -1932,6 +2449,10 @@ static int target_restore_working_area(struct target *target, struct working_are
 {
 	int retval = ERROR_OK;
 
+	/* saved until the target resumes */
+	if (target->backup_working_area == TARGET_WORK_AREA_BACKUP_LAZY)
+		return ERROR_OK;
+
 	if (target->backup_working_area && area->backup != NULL) {
 		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
 		if (retval != ERROR_OK)
@@ -2002,6 +2523,13 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 		c = c->next;
 	}
 
+	if (restore) {
+		target_lazy_restore_working_area(target);
+	} else if (target->working_area_saved) {
+		uint32_t words = (target->working_area_size & ~3UL) / 4;
+		memset(target->working_area_saved, 0, DIV_ROUND_UP(words, 32) * sizeof(uint32_t));
+	}
+
 	/* Run a merge pass to combine all areas into one */
 	target_merge_working_areas(target);
 
@@ -2019,16 +2547,21 @@ void target_free_all_working_areas(struct target *target)
 		free(target->working_areas);
 		target->working_areas = NULL;
 	}
+
+	free(target->working_area_shadow);
+	free(target->working_area_saved);
+	target->working_area_shadow = NULL;
+	target->working_area_saved = NULL;
 }
 
-/* Find the largest number of bytes that can be allocated */
+/* Find the largest number of bytes that can be allocated in one block */
 uint32_t target_get_working_area_avail(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 	uint32_t max_size = 0;
 
 	if (c == NULL)
-		return target->working_area_size;
+		return target->working_area_size & ~3UL;
 
 	while (c) {
 		if (c->free && max_size < c->size)
@@ -2040,12 +2573,36 @@ uint32_t target_get_working_area_avail(struct target *target)
 	return max_size;
 }
 
-static void target_destroy(struct target *target)
+int target_alloc_async_fifo(struct target *target, uint32_t count,
+		uint32_t block_size, uint32_t min_size, struct working_area **area)
 {
-	if (target->type->deinit_target)
-		target->type->deinit_target(target);
+	/* the fifo data area is a multiple of the block size and of words */
+	uint32_t unit = MAX(block_size, 4u);
 
-	free(target->semihosting);
+	/* the write and read pointers, all the data and one spare unit */
+	uint64_t wanted = 8 + ((uint64_t)count * block_size + unit + unit - 1) / unit * unit;
+	uint32_t avail = target_get_working_area_avail(target);
+	uint32_t size = MIN(wanted, (uint64_t)avail);
+
+	/* a fifo holding all the data may be smaller than min_size */
+	while (size > 8 && (size >= min_size || size == wanted)) {
+		size = 8 + (size - 8) / unit * unit;
+		if (target_alloc_working_area_try(target, size, area) == ERROR_OK) {
+			LOG_DEBUG("async algorithm fifo of %" PRIu32 " bytes", size);
+			return ERROR_OK;
+		}
+		size /= 2;
+	}
+
+	return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+}
+
+static void target_destroy(struct target *target)
+{
+	if (target->type->deinit_target)
+		target->type->deinit_target(target);
+
+	free(target->semihosting);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2073,6 +2630,9 @@ static void target_destroy(struct target *target)
 
 	rtos_destroy(target);
 
+	if (target->mem_cache)
+		free(target->mem_cache->volatile_regions);
+	free(target->mem_cache);
 	free(target->gdb_port_override);
 	free(target->type);
 	free(target->trace_info);
@@ -2091,13 +2651,15 @@ void target_quit(void)
 	}
 	target_event_callbacks = NULL;
 
-	struct target_timer_callback *pt = target_timer_callbacks;
-	while (pt) {
-		struct target_timer_callback *t = pt->next;
-		free(pt);
-		pt = t;
-	}
-	target_timer_callbacks = NULL;
+	target_sample_stop();
+	rtt_stop();
+
+	for (unsigned int i = 0; i < timer_heap_count; i++)
+		free(timer_heap[i]);
+	free(timer_heap);
+	timer_heap = NULL;
+	timer_heap_count = 0;
+	timer_heap_alloc = 0;
 
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
@@ -2141,7 +2703,7 @@ static int target_gdb_fileio_end_default(struct target *target,
 	return ERROR_OK;
 }
 
-static int target_profiling_default(struct target *target, uint32_t *samples,
+int target_profiling_default(struct target *target, uint32_t *samples,
 		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
 	struct timeval timeout, now;
@@ -2214,9 +2776,39 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_mem_cache_written();
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
+int target_write_buffer_multi(struct target **targets, unsigned int count,
+		target_addr_t address, uint32_t size, const uint8_t *buffer, int *retvals)
+{
+	int retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* all of one type, or one by one */
+	bool multi = count > 1 && size > 0 && (address + size - 1) >= address;
+	for (unsigned int i = 0; i < count && multi; i++)
+		multi = target_was_examined(targets[i]) && targets[i]->type->write_buffer_multi
+				&& targets[i]->type->write_buffer_multi == targets[0]->type->write_buffer_multi;
+
+	if (multi) {
+		target_mem_cache_written();
+		retval = targets[0]->type->write_buffer_multi(targets, count, address,
+				size, buffer, retvals);
+	}
+
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+		for (unsigned int i = 0; i < count; i++)
+			retvals[i] = target_write_buffer(targets[i], address, size, buffer);
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (retvals[i] != ERROR_OK)
+			return retvals[i];
+	}
+	return ERROR_OK;
+}
+
 static int target_write_buffer_default(struct target *target,
 	target_addr_t address, uint32_t count, const uint8_t *buffer)
 {
@@ -2279,6 +2871,45 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
+int target_read_buffer_batch(struct target *target,
+		struct target_read_request *reads, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct target_read_request *req = &reads[i];
+
+		req->retval = ERROR_OK;
+		if (req->size > 0 && (req->address + req->size - 1) < req->address) {
+			LOG_ERROR("address + size wrapped (" TARGET_ADDR_FMT ", 0x%08" PRIx32 ")",
+					req->address, req->size);
+			return ERROR_FAIL;
+		}
+	}
+
+	/* the memory cache, if any, answers block by block */
+	int retval = ERROR_OK;
+	if (target->type->read_buffer_batch &&
+			!(target->mem_cache && target->state == TARGET_HALTED)) {
+		retval = target->type->read_buffer_batch(target, reads, count);
+	} else {
+		for (unsigned int i = 0; i < count; i++)
+			reads[i].retval = target_read_buffer(target, reads[i].address,
+					reads[i].size, reads[i].buffer);
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (reads[i].retval != ERROR_OK)
+			return reads[i].retval;
+	}
+
+	/* a failure the hook could not attribute to a block */
+	return retval;
+}
+
 static int target_read_buffer_default(struct target *target, target_addr_t address, uint32_t count, uint8_t *buffer)
 {
 	uint32_t size;
@@ -2352,6 +2983,168 @@ int target_checksum_memory(struct target *target, target_addr_t address, uint32_
 	return retval;
 }
 
+/**
+ * Stores the CRC32 of every block in its result field. Uses the target's
+ * multi-block checksum algorithm when it has one, and falls back to
+ * target_checksum_memory() block by block otherwise.
+ */
+int target_checksum_memory_blocks(struct target *target,
+	struct target_memory_check_block *blocks, int num_blocks)
+{
+	bool multi = target->type->checksum_memory_blocks != NULL;
+	int retval;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	for (int done = 0; done < num_blocks; ) {
+		if (multi) {
+			retval = target->type->checksum_memory_blocks(target,
+					blocks + done, num_blocks - done);
+			if (retval > 0) {
+				done += retval;
+				continue;
+			}
+			/* e.g. no working area, do not try again */
+			multi = false;
+		}
+
+		retval = target_checksum_memory(target, blocks[done].address,
+				blocks[done].size, &blocks[done].result);
+		if (retval != ERROR_OK)
+			return retval;
+		done++;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * @returns word @a index of @a pattern, which is at @a address. @a state is
+ * the xorshift32 state of TARGET_MEM_RANDOM, initially the seed.
+ */
+uint32_t target_mem_pattern_value(enum target_mem_pattern pattern,
+		uint32_t index, target_addr_t address, uint32_t value, uint32_t *state)
+{
+	switch (pattern) {
+	case TARGET_MEM_WALKING_ONES:
+		return 1u << (index % 32);
+	case TARGET_MEM_ADDRESS:
+		return address;
+	case TARGET_MEM_RANDOM:
+		*state ^= *state << 13;
+		*state ^= *state >> 17;
+		*state ^= *state << 5;
+		return *state;
+	default:
+		return value;
+	}
+}
+
+/* host driven fallback of target_mem_pattern() */
+static int target_mem_pattern_host(struct target *target, target_addr_t address,
+		uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+		struct target_mem_test_result *result)
+{
+	const uint32_t chunk = 1024;
+	int retval = ERROR_OK;
+
+	uint8_t *buffer = malloc(4 * chunk);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int passes = pattern == TARGET_MEM_FILL ? 1 : 2;
+	for (int pass = 0; pass < passes && retval == ERROR_OK; pass++) {
+		uint32_t state = value;
+
+		for (uint32_t i = 0; i < count; i += chunk) {
+			uint32_t n = MIN(chunk, count - i);
+			target_addr_t addr = address + 4 * (target_addr_t)i;
+
+			if (pass == 1) {
+				retval = target_read_memory(target, addr, 4, n, buffer);
+				if (retval != ERROR_OK)
+					break;
+			}
+
+			for (uint32_t j = 0; j < n; j++) {
+				uint32_t expected = target_mem_pattern_value(pattern, i + j,
+						addr + 4 * j, value, &state);
+				if (pass == 0) {
+					target_buffer_set_u32(target, buffer + 4 * j, expected);
+					continue;
+				}
+
+				uint32_t actual = target_buffer_get_u32(target, buffer + 4 * j);
+				if (actual != expected) {
+					result->failed = true;
+					result->address = addr + 4 * j;
+					result->expected = expected;
+					result->actual = actual;
+					goto done;
+				}
+			}
+
+			if (pass == 0) {
+				retval = target_write_memory(target, addr, 4, n, buffer);
+				if (retval != ERROR_OK)
+					break;
+			}
+			keep_alive();
+		}
+	}
+
+done:
+	free(buffer);
+	return retval;
+}
+
+/**
+ * Writes @a count words of @a pattern from the word aligned @a address on
+ * and, except for TARGET_MEM_FILL, reads them back and compares. Where the
+ * target implements it this runs as an algorithm on the target, and only
+ * the result is transferred.
+ */
+int target_mem_pattern(struct target *target, target_addr_t address,
+		uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+		struct target_mem_test_result *result)
+{
+	int retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (address & 3) {
+		LOG_ERROR("address " TARGET_ADDR_FMT " is not word aligned", address);
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+	}
+
+	memset(result, 0, sizeof(*result));
+	if (!count)
+		return ERROR_OK;
+
+	if (target->type->mem_pattern && target->state == TARGET_HALTED)
+		retval = target->type->mem_pattern(target, address, count, pattern,
+				value, result);
+
+	/* an algorithm that failed may have left the memory half written, the
+	 * host only takes over where no algorithm could be run at all */
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+		LOG_DEBUG("no memory test algorithm, running it from the host");
+		memset(result, 0, sizeof(*result));
+		retval = target_mem_pattern_host(target, address, count, pattern,
+				value, result);
+	}
+
+	return retval;
+}
+
 int target_blank_check_memory(struct target *target,
 	struct target_memory_check_block *blocks, int num_blocks,
 	uint8_t erased_value)
@@ -2367,6 +3160,85 @@ int target_blank_check_memory(struct target *target,
 	return target->type->blank_check_memory(target, blocks, num_blocks, erased_value);
 }
 
+/* host driven fallback of target_stack_check_memory(), one block */
+static int target_stack_check_host(struct target *target,
+		struct target_memory_check_block *block, uint8_t fill_value)
+{
+	const uint32_t chunk = 4096;
+	int retval = ERROR_OK;
+
+	uint8_t *buffer = malloc(chunk);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	block->result = 0;
+	while (block->result < block->size) {
+		uint32_t n = MIN(chunk, block->size - block->result);
+		retval = target_read_memory(target, block->address + block->result,
+				4, n / 4, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		uint32_t i = 0;
+		while (i < n && buffer[i] == fill_value)
+			i++;
+		/* whole words only, like the algorithms */
+		block->result += i & ~3;
+		if (i < n)
+			break;
+		keep_alive();
+	}
+
+	free(buffer);
+	return retval;
+}
+
+/**
+ * Stores in the result field of each of the word aligned @a blocks how many
+ * bytes, in whole words, from its start on still hold @a fill_value, which
+ * for a descending stack filled at thread creation is the part never used.
+ * Where the target implements it this runs as an algorithm on the target.
+ * @returns the number of blocks checked, which may be less than
+ * @a num_blocks, or an error code.
+ */
+int target_stack_check_memory(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks,
+		uint8_t fill_value)
+{
+	int retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < num_blocks; i++) {
+		if ((blocks[i].address | blocks[i].size) & 3 || !blocks[i].size) {
+			LOG_ERROR("block " TARGET_ADDR_FMT " size %" PRIu32 " is not word aligned",
+					blocks[i].address, blocks[i].size);
+			return ERROR_TARGET_UNALIGNED_ACCESS;
+		}
+	}
+
+	if (!num_blocks)
+		return 0;
+
+	if (target->type->stack_check_memory && target->state == TARGET_HALTED)
+		retval = target->type->stack_check_memory(target, blocks, num_blocks,
+				fill_value);
+
+	if (retval <= 0) {
+		LOG_DEBUG("no stack check algorithm, running it from the host");
+		retval = target_stack_check_host(target, &blocks[0], fill_value);
+		if (retval == ERROR_OK)
+			retval = 1;
+	}
+
+	return retval;
+}
+
 int target_read_u64(struct target *target, target_addr_t address, uint64_t *value)
 {
 	uint8_t value_buf[8];
@@ -2415,6 +3287,38 @@ int target_read_u32(struct target *target, target_addr_t address, uint32_t *valu
 	return retval;
 }
 
+int target_poll_u32(struct target *target, target_addr_t address,
+		uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms)
+{
+	uint32_t data;
+	int retval;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	if (target->type->poll_u32) {
+		retval = target->type->poll_u32(target, address, mask, match, value, timeout_ms);
+		if (retval != ERROR_NOT_IMPLEMENTED)
+			return retval;
+	}
+
+	int64_t then = timeval_ms();
+	for (;;) {
+		retval = target_read_u32(target, address, &data);
+		if (retval != ERROR_OK)
+			return retval;
+		if (value)
+			*value = data;
+		if ((data & mask) == match)
+			return ERROR_OK;
+		if (timeval_ms() - then > timeout_ms)
+			return ERROR_TIMEOUT_REACHED;
+		alive_sleep(1);
+	}
+}
+
 int target_read_u16(struct target *target, target_addr_t address, uint16_t *value)
 {
 	uint8_t value_buf[2];
@@ -2761,9 +3665,13 @@ static int handle_target(void *priv)
 		return ERROR_OK;
 	}
 
+	int64_t now = timeval_ms();
+
 	/* we do not want to recurse here... */
 	static int recursive;
-	if (!recursive) {
+	static int64_t next_sense_ms;
+	if (!recursive && now >= next_sense_ms) {
+		next_sense_ms = now + polling_interval;
 		recursive = 1;
 		sense_handler();
 		/* danger! running these procedures can trigger srst assertions and power dropouts.
@@ -2818,17 +3726,26 @@ static int handle_target(void *priv)
 		if (!target->tap->enabled)
 			continue;
 
-		if (target->backoff.times > target->backoff.count) {
-			/* do not poll this time as we failed previously */
-			target->backoff.count++;
+		/* do not poll before the interval expires, or while backing off
+		 * after a failure */
+		if (now < target->poll_next_ms)
 			continue;
-		}
-		target->backoff.count = 0;
 
 		/* only poll target if we've got power and srst isn't asserted */
 		if (!powerDropout && !srstAsserted) {
 			/* polling may fail silently until the target has been examined */
 			retval = target_poll(target);
+
+			/* poll a running target fast at first, then back off exponentially */
+			if (target->poll_interval_ms < poll_interval_min)
+				target->poll_interval_ms = poll_interval_min;
+			if (target->state != TARGET_RUNNING)
+				target->poll_interval_ms = poll_interval_max;
+			target->poll_next_ms = now + target->poll_interval_ms;
+			if (target->poll_interval_ms < poll_interval_max)
+				target->poll_interval_ms = MIN(2 * target->poll_interval_ms,
+						poll_interval_max);
+
 			if (retval != ERROR_OK) {
 				/* 100ms polling interval. Increase interval between polling up to 5000ms */
 				if (target->backoff.times * polling_interval < 5000) {
@@ -2842,6 +3759,8 @@ static int handle_target(void *priv)
 				target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
 			}
 			if (target->backoff.times > 0) {
+				/* do not poll again before the backoff time elapsed */
+				target->poll_next_ms = now + target->backoff.times * polling_interval;
 				LOG_USER("Polling target %s failed, trying to reexamine", target_name(target));
 				target_reset_examined(target);
 				retval = target_examine_one(target);
@@ -3019,6 +3938,36 @@ COMMAND_HANDLER(handle_poll_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_poll_interval_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 0) {
+		unsigned int min, max;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], min);
+		max = MAX(min, poll_interval_max);
+		if (CMD_ARGC > 1)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max);
+		if (min == 0 || max < min) {
+			command_print(CMD, "need 0 < min_ms <= max_ms");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		poll_interval_min = min;
+		poll_interval_max = max;
+
+		/* the background poll ticks at the minimum interval */
+		for (unsigned int i = 0; i < timer_heap_count; i++)
+			if (timer_heap[i]->callback == handle_target)
+				timer_heap[i]->time_ms = min;
+		target_poll_request(NULL);
+	}
+
+	command_print(CMD, "polling interval: %u ms after resume or step, "
+			"backing off to %u ms", poll_interval_min, poll_interval_max);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_wait_halt_command)
 {
 	if (CMD_ARGC > 1)
@@ -3398,6 +4347,100 @@ COMMAND_HANDLER(handle_mw_command)
 	return target_fill_mem(target, address, fn, wordsize, value, count);
 }
 
+static const Jim_Nvp nvp_mem_patterns[] = {
+	{ .name = "walking_ones", .value = TARGET_MEM_WALKING_ONES },
+	{ .name = "address", .value = TARGET_MEM_ADDRESS },
+	{ .name = "random", .value = TARGET_MEM_RANDOM },
+	{ .name = NULL, .value = -1 },
+};
+
+COMMAND_HANDLER(handle_mem_fill_command)
+{
+	if (CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t size, value;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], value);
+	if (size & 3) {
+		command_print(CMD, "size must be a multiple of 4");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_mem_test_result result;
+	struct duration bench;
+	duration_start(&bench);
+
+	int retval = target_mem_pattern(target, address, size / 4,
+			TARGET_MEM_FILL, value, &result);
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK)
+		command_print(CMD, "filled %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				size, duration_elapsed(&bench), duration_kbps(&bench, size));
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_mem_test_command)
+{
+	if (CMD_ARGC < 2 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_addr_t address;
+	uint32_t size;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (size & 3) {
+		command_print(CMD, "size must be a multiple of 4");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	/* all patterns unless one is given */
+	const Jim_Nvp *only = NULL;
+	if (CMD_ARGC >= 3 && strcmp(CMD_ARGV[2], "all")) {
+		only = Jim_Nvp_name2value_simple(nvp_mem_patterns, CMD_ARGV[2]);
+		if (!only->name)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t seed = 0x12345678;
+	if (CMD_ARGC == 4)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], seed);
+	if (!seed) {
+		command_print(CMD, "the random seed must not be 0");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	int retval = ERROR_OK;
+
+	for (const Jim_Nvp *n = nvp_mem_patterns; n->name && retval == ERROR_OK; n++) {
+		if (only && only != n)
+			continue;
+
+		struct target_mem_test_result result;
+		struct duration bench;
+		duration_start(&bench);
+
+		retval = target_mem_pattern(target, address, size / 4, n->value, seed, &result);
+		if (retval != ERROR_OK)
+			break;
+
+		if (result.failed) {
+			command_print(CMD, "%s: failed at " TARGET_ADDR_FMT
+					", wrote 0x%8.8" PRIx32 " read 0x%8.8" PRIx32,
+					n->name, result.address, result.expected, result.actual);
+			retval = ERROR_FAIL;
+		} else if (duration_measure(&bench) == ERROR_OK) {
+			command_print(CMD, "%s: passed in %fs", n->name, duration_elapsed(&bench));
+		}
+	}
+
+	return retval;
+}
+
 static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 		target_addr_t *min_address, target_addr_t *max_address)
 {
@@ -3430,6 +4473,35 @@ static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 	return ERROR_OK;
 }
 
+/**
+ * Clips the @a buf_cnt bytes read from @a section to [min_address, max_address).
+ * @returns false if nothing is left to load.
+ */
+static bool load_image_clip_section(struct imagesection *section, size_t buf_cnt,
+		target_addr_t min_address, target_addr_t max_address,
+		uint32_t *offset, uint32_t *length)
+{
+	*offset = 0;
+	*length = buf_cnt;
+
+	/* DANGER!!! beware of unsigned comparison here!!! */
+
+	if ((section->base_address + buf_cnt < min_address) ||
+			(section->base_address >= max_address))
+		return false;
+
+	if (section->base_address < min_address) {
+		/* clip addresses below */
+		*offset += min_address - section->base_address;
+		*length -= *offset;
+	}
+
+	if (section->base_address + buf_cnt > max_address)
+		*length -= (section->base_address + buf_cnt) - max_address;
+
+	return true;
+}
+
 COMMAND_HANDLER(handle_load_image_command)
 {
 	uint8_t *buffer;
@@ -3456,40 +4528,18 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
+		const uint8_t *data;
+
+		retval = image_map_section(&image, i, &data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
-
-		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
-
-		/* DANGER!!! beware of unsigned comparison here!!! */
-
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
-
-			if (image.sections[i].base_address < min_address) {
-				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
-				length -= offset;
-			}
-
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+		uint32_t offset, length;
 
+		if (load_image_clip_section(&image.sections[i], buf_cnt,
+				min_address, max_address, &offset, &length)) {
 			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
+					image.sections[i].base_address + offset, length, data + offset);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3515,6 +4565,162 @@ COMMAND_HANDLER(handle_load_image_command)
 
 }
 
+struct load_image_job {
+	struct target *target;
+	uint32_t size;
+	int64_t elapsed_us;
+	int retval;
+};
+
+/* Loads one image into several targets, reading and converting it once. A
+ * target failing does not stop the others. */
+COMMAND_HANDLER(handle_load_image_multi_command)
+{
+	uint8_t *buffer;
+	size_t buf_cnt;
+	target_addr_t min_address = 0;
+	target_addr_t max_address = -1;
+	struct image image;
+	struct load_image_job *jobs = NULL;
+	unsigned int num_jobs = 0;
+
+	if (CMD_ARGC < 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	/* the first argument is the list of targets */
+	char *names = strdup(CMD_ARGV[0]);
+	if (!names) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (char *name = strtok(names, " \t"); name; name = strtok(NULL, " \t")) {
+		struct target *target = get_target(name);
+		if (!target) {
+			command_print(CMD, "unknown target '%s'", name);
+			free(names);
+			free(jobs);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		struct load_image_job *tmp = realloc(jobs, (num_jobs + 1) * sizeof(*jobs));
+		if (!tmp) {
+			LOG_ERROR("Out of memory");
+			free(names);
+			free(jobs);
+			return ERROR_FAIL;
+		}
+		jobs = tmp;
+		jobs[num_jobs++] = (struct load_image_job){ .target = target, .retval = ERROR_OK };
+	}
+	free(names);
+
+	if (!num_jobs) {
+		free(jobs);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct target **targets = calloc(num_jobs, sizeof(*targets));
+	int *retvals = calloc(num_jobs, sizeof(*retvals));
+	if (!targets || !retvals) {
+		LOG_ERROR("Out of memory");
+		free(targets);
+		free(retvals);
+		free(jobs);
+		return ERROR_FAIL;
+	}
+
+	CMD_ARGC--;
+	CMD_ARGV++;
+	int retval = CALL_COMMAND_HANDLER(parse_load_image_command_CMD_ARGV,
+			&image, &min_address, &max_address);
+	if (retval == ERROR_OK &&
+			image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL) != ERROR_OK)
+		retval = ERROR_FAIL;
+	if (retval != ERROR_OK) {
+		free(targets);
+		free(retvals);
+		free(jobs);
+		return retval;
+	}
+
+	for (int i = 0; i < image.num_sections; i++) {
+		const uint8_t *data;
+
+		retval = image_map_section(&image, i, &data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
+			break;
+
+		uint32_t offset, length;
+
+		if (load_image_clip_section(&image.sections[i], buf_cnt,
+				min_address, max_address, &offset, &length)) {
+			/* the targets still fine are written together */
+			unsigned int n = 0;
+			for (unsigned int j = 0; j < num_jobs; j++) {
+				if (jobs[j].retval == ERROR_OK)
+					targets[n++] = jobs[j].target;
+			}
+
+			int64_t start = timeval_us();
+			target_write_buffer_multi(targets, n,
+					image.sections[i].base_address + offset, length, data + offset,
+					retvals);
+			int64_t elapsed = timeval_us() - start;
+
+			n = 0;
+			for (unsigned int j = 0; j < num_jobs; j++) {
+				struct load_image_job *job = &jobs[j];
+				if (job->retval != ERROR_OK)
+					continue;
+
+				job->retval = retvals[n++];
+				job->elapsed_us += elapsed;
+				if (job->retval == ERROR_OK)
+					job->size += length;
+			}
+		}
+
+		free(buffer);
+	}
+
+	image_close(&image);
+
+	for (unsigned int j = 0; j < num_jobs && retval == ERROR_OK; j++) {
+		struct load_image_job *job = &jobs[j];
+		if (job->retval != ERROR_OK) {
+			command_print(CMD, "%s: failed after %" PRIu32 " bytes",
+					target_name(job->target), job->size);
+			continue;
+		}
+
+		double seconds = job->elapsed_us / 1000000.0;
+		command_print(CMD, "%s: downloaded %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				target_name(job->target), job->size, seconds,
+				seconds > 0 ? job->size / 1024.0 / seconds : 0.0);
+	}
+
+	for (unsigned int j = 0; j < num_jobs && retval == ERROR_OK; j++)
+		if (jobs[j].retval != ERROR_OK)
+			retval = jobs[j].retval;
+
+	free(targets);
+	free(retvals);
+	free(jobs);
+	return retval;
+}
+
+/* dump_image reads this much per target_read_buffer() call */
+#define DUMP_IMAGE_CHUNK	(64 * 1024)
+/* granularity of the holes left by "dump_image ... sparse" */
+#define DUMP_IMAGE_PAGE		4096
+
+static bool dump_image_is_zero(const uint8_t *buffer, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++)
+		if (buffer[i])
+			return false;
+	return true;
+}
+
 COMMAND_HANDLER(handle_dump_image_command)
 {
 	struct fileio *fileio;
@@ -3523,14 +4729,20 @@ COMMAND_HANDLER(handle_dump_image_command)
 	target_addr_t address, size;
 	struct duration bench;
 	struct target *target = get_current_target(CMD_CTX);
+	bool sparse = false;
 
-	if (CMD_ARGC != 3)
+	if (CMD_ARGC == 4) {
+		if (strcmp(CMD_ARGV[3], "sparse"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		sparse = true;
+	} else if (CMD_ARGC != 3) {
 		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
 
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	uint32_t buf_size = (size > DUMP_IMAGE_CHUNK) ? DUMP_IMAGE_CHUNK : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3543,6 +4755,9 @@ COMMAND_HANDLER(handle_dump_image_command)
 
 	duration_start(&bench);
 
+	/* file offset written up to, and where the next write goes */
+	size_t written = 0, offset = 0, skipped = 0;
+
 	while (size > 0) {
 		size_t size_written;
 		uint32_t this_run_size = (size > buf_size) ? buf_size : size;
@@ -3550,24 +4765,63 @@ COMMAND_HANDLER(handle_dump_image_command)
 		if (retval != ERROR_OK)
 			break;
 
-		retval = fileio_write(fileio, this_run_size, buffer, &size_written);
+		/* pages reading as zero are left as holes in the file */
+		for (uint32_t pos = 0; pos < this_run_size; ) {
+			uint32_t len = MIN(this_run_size - pos, (uint32_t)DUMP_IMAGE_PAGE);
+			uint32_t run = len;
+			bool hole = sparse && dump_image_is_zero(buffer + pos, len);
+
+			if (!hole) {
+				/* write consecutive data pages at once */
+				while (sparse && pos + run < this_run_size) {
+					uint32_t next = MIN(this_run_size - pos - run, (uint32_t)DUMP_IMAGE_PAGE);
+					if (dump_image_is_zero(buffer + pos + run, next))
+						break;
+					run += next;
+				}
+				if (!sparse)
+					run = this_run_size;
+
+				if (offset != written) {
+					retval = fileio_seek(fileio, offset);
+					if (retval != ERROR_OK)
+						break;
+				}
+				retval = fileio_write(fileio, run, buffer + pos, &size_written);
+				if (retval != ERROR_OK)
+					break;
+				written = offset + run;
+			} else {
+				skipped += run;
+			}
+			offset += run;
+			pos += run;
+		}
 		if (retval != ERROR_OK)
 			break;
 
 		size -= this_run_size;
 		address += this_run_size;
+		keep_alive();
+	}
+
+	/* a trailing hole still has to extend the file */
+	if (retval == ERROR_OK && written != offset) {
+		size_t size_written;
+		const uint8_t zero = 0;
+		retval = fileio_seek(fileio, offset - 1);
+		if (retval == ERROR_OK)
+			retval = fileio_write(fileio, 1, &zero, &size_written);
 	}
 
 	free(buffer);
 
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
-		size_t filesize;
-		retval = fileio_size(fileio, &filesize);
-		if (retval != ERROR_OK)
-			return retval;
 		command_print(CMD,
-				"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
-				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+				"dumped %zu bytes in %fs (%0.3f KiB/s)", offset,
+				duration_elapsed(&bench), duration_kbps(&bench, offset));
+		if (sparse)
+			command_print(CMD, "%zu bytes of zero pages left as holes", skipped);
 	}
 
 	retvaltemp = fileio_close(fileio);
@@ -3627,83 +4881,106 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	image_size = 0x0;
 	int diffs = 0;
 	retval = ERROR_OK;
-	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-					"error allocating buffer for section (%d bytes)",
-					(int)(image.sections[i].size));
-			break;
+
+	/* checksum all sections on the target at once, the host side is
+	 * computed while reading the image */
+	struct target_memory_check_block *blocks = NULL;
+	uint32_t *image_checksums = NULL;
+	if (verify >= IMAGE_VERIFY && image.num_sections > 0) {
+		blocks = calloc(image.num_sections, sizeof(*blocks));
+		image_checksums = calloc(image.num_sections, sizeof(*image_checksums));
+		if (!blocks || !image_checksums) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			goto done;
 		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
+
+		for (i = 0; i < image.num_sections; i++) {
+			const uint8_t *section_data;
+
+			retval = image_map_section(&image, i, &section_data, &buffer, &buf_cnt);
+			if (retval == ERROR_OK)
+				retval = image_calculate_checksum(section_data, buf_cnt, &image_checksums[i]);
 			free(buffer);
-			break;
+			if (retval != ERROR_OK)
+				goto done;
+
+			blocks[i].address = image.sections[i].base_address;
+			blocks[i].size = buf_cnt;
 		}
 
+		retval = target_checksum_memory_blocks(target, blocks, image.num_sections);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+
+	for (i = 0; i < image.num_sections; i++) {
 		if (verify >= IMAGE_VERIFY) {
-			/* calculate checksum of image */
-			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
-			}
+			checksum = image_checksums[i];
+			mem_checksum = blocks[i].result;
+			buf_cnt = blocks[i].size;
+			image_size += buf_cnt;
 
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
-			}
-			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
+			if (checksum == mem_checksum)
+				continue;
+			if (verify == IMAGE_CHECKSUM_ONLY) {
 				LOG_ERROR("checksum mismatch");
-				free(buffer);
 				retval = ERROR_FAIL;
 				goto done;
 			}
-			if (checksum != mem_checksum) {
-				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
-
-				if (diffs == 0)
-					LOG_ERROR("checksum mismatch - attempting binary compare");
-
-				data = malloc(buf_cnt);
-
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
-				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
+		}
+
+		const uint8_t *section_data;
+
+		retval = image_map_section(&image, i, &section_data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
+			break;
+
+		if (verify >= IMAGE_VERIFY) {
+			/* failed crc checksum, fall back to a binary compare */
+			uint8_t *data;
+
+			if (diffs == 0)
+				LOG_ERROR("checksum mismatch - attempting binary compare");
+
+			data = malloc(buf_cnt);
+
+			retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
+			if (retval == ERROR_OK) {
+				uint32_t t;
+				for (t = 0; t < buf_cnt; t++) {
+					if (data[t] != section_data[t]) {
+						command_print(CMD,
+									  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
+									  diffs,
+									  (unsigned)(t + image.sections[i].base_address),
+									  data[t],
+									  section_data[t]);
+						if (diffs++ >= 127) {
+							command_print(CMD, "More than 128 errors, the rest are not printed.");
+							free(data);
+							free(buffer);
+							goto done;
 						}
-						keep_alive();
 					}
+					keep_alive();
 				}
-				free(data);
 			}
+			free(data);
 		} else {
 			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
 						  image.sections[i].base_address,
 						  buf_cnt);
+			image_size += buf_cnt;
 		}
 
 		free(buffer);
-		image_size += buf_cnt;
 	}
 	if (diffs > 0)
 		command_print(CMD, "No more differences found.");
 done:
+	free(blocks);
+	free(image_checksums);
 	if (diffs > 0)
 		retval = ERROR_FAIL;
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
@@ -4099,7 +5376,7 @@ COMMAND_HANDLER(handle_profile_command)
 	if ((CMD_ARGC != 2) && (CMD_ARGC != 4))
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	const uint32_t MAX_PROFILE_SAMPLE_NUM = 10000;
+	const uint32_t MAX_PROFILE_SAMPLE_NUM = 1000000;
 	uint32_t offset;
 	uint32_t num_of_samples;
 	int retval = ERROR_OK;
@@ -4164,31 +5441,37 @@ COMMAND_HANDLER(handle_profile_command)
 	return retval;
 }
 
-static int new_int_array_element(Jim_Interp *interp, const char *varname, int idx, uint32_t val)
+/* Value of a width bytes item of target memory in buffer. */
+static uint64_t buffer_get_item(struct target *target, const uint8_t *buffer, uint32_t width)
 {
-	char *namebuf;
-	Jim_Obj *nameObjPtr, *valObjPtr;
-	int result;
-
-	namebuf = alloc_printf("%s(%d)", varname, idx);
-	if (!namebuf)
-		return JIM_ERR;
-
-	nameObjPtr = Jim_NewStringObj(interp, namebuf, -1);
-	valObjPtr = Jim_NewIntObj(interp, val);
-	if (!nameObjPtr || !valObjPtr) {
-		free(namebuf);
-		return JIM_ERR;
+	switch (width) {
+		case 8:
+			return target_buffer_get_u64(target, buffer);
+		case 4:
+			return target_buffer_get_u32(target, buffer);
+		case 2:
+			return target_buffer_get_u16(target, buffer);
+		default:
+			return buffer[0];
 	}
+}
 
-	Jim_IncrRefCount(nameObjPtr);
-	Jim_IncrRefCount(valObjPtr);
-	result = Jim_SetVariable(interp, nameObjPtr, valObjPtr);
-	Jim_DecrRefCount(interp, nameObjPtr);
-	Jim_DecrRefCount(interp, valObjPtr);
-	free(namebuf);
-	/* printf("%s(%d) <= 0%08x\n", varname, idx, val); */
-	return result;
+static void buffer_set_item(struct target *target, uint8_t *buffer, uint32_t width, uint64_t value)
+{
+	switch (width) {
+		case 8:
+			target_buffer_set_u64(target, buffer, value);
+			break;
+		case 4:
+			target_buffer_set_u32(target, buffer, value);
+			break;
+		case 2:
+			target_buffer_set_u16(target, buffer, value);
+			break;
+		default:
+			buffer[0] = value;
+			break;
+	}
 }
 
 static int jim_mem2array(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
@@ -4215,8 +5498,6 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 	int len;
 	uint32_t addr;
 	uint32_t count;
-	uint32_t v;
-	const char *varname;
 	const char *phys;
 	bool is_phys;
 	int  n, e, retval;
@@ -4232,9 +5513,6 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 		Jim_WrongNumArgs(interp, 0, argv, "varname width addr nelems [phys]");
 		return JIM_ERR;
 	}
-	varname = Jim_GetString(argv[0], &len);
-	/* given "foo" get space for worse case "foo(%d)" .. add 20 */
-
 	e = Jim_GetLong(interp, argv[1], &l);
 	width = l;
 	if (e != JIM_OK)
@@ -4302,95 +5580,55 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 		return JIM_ERR;
 	}
 
-	/* Transfer loop */
-
-	/* index counter */
-	n = 0;
-
-	size_t buffersize = 4096;
-	uint8_t *buffer = malloc(buffersize);
+	/* One read of the whole range, so the adapter can pipeline it */
+	uint8_t *buffer = malloc(len * width);
 	if (buffer == NULL)
 		return JIM_ERR;
 
-	/* assume ok */
-	e = JIM_OK;
-	while (len) {
-		/* Slurp... in buffer size chunks */
-
-		count = len; /* in objects.. */
-		if (count > (buffersize / width))
-			count = (buffersize / width);
-
-		if (is_phys)
-			retval = target_read_phys_memory(target, addr, width, count, buffer);
-		else
-			retval = target_read_memory(target, addr, width, count, buffer);
-		if (retval != ERROR_OK) {
-			/* BOO !*/
-			LOG_ERROR("mem2array: Read @ 0x%08" PRIx32 ", w=%" PRIu32 ", cnt=%" PRIu32 ", failed",
-					  addr,
-					  width,
-					  count);
-			Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-			Jim_AppendStrings(interp, Jim_GetResult(interp), "mem2array: cannot read memory", NULL);
-			e = JIM_ERR;
-			break;
-		} else {
-			v = 0; /* shut up gcc */
-			for (i = 0; i < count ; i++, n++) {
-				switch (width) {
-					case 4:
-						v = target_buffer_get_u32(target, &buffer[i*width]);
-						break;
-					case 2:
-						v = target_buffer_get_u16(target, &buffer[i*width]);
-						break;
-					case 1:
-						v = buffer[i] & 0x0ff;
-						break;
-				}
-				new_int_array_element(interp, varname, n, v);
-			}
-			len -= count;
-			addr += count * width;
-		}
-	}
-
-	free(buffer);
-
-	Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-
-	return e;
-}
-
-static int get_int_array_element(Jim_Interp *interp, const char *varname, int idx, uint32_t *val)
-{
-	char *namebuf;
-	Jim_Obj *nameObjPtr, *valObjPtr;
-	int result;
-	long l;
-
-	namebuf = alloc_printf("%s(%d)", varname, idx);
-	if (!namebuf)
+	count = len;
+	if (is_phys)
+		retval = target_read_phys_memory(target, addr, width, count, buffer);
+	else
+		retval = target_read_memory(target, addr, width, count, buffer);
+	if (retval != ERROR_OK) {
+		/* BOO !*/
+		LOG_ERROR("mem2array: Read @ 0x%08" PRIx32 ", w=%" PRIu32 ", cnt=%" PRIu32 ", failed",
+				  addr,
+				  width,
+				  count);
+		free(buffer);
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		Jim_AppendStrings(interp, Jim_GetResult(interp), "mem2array: cannot read memory", NULL);
 		return JIM_ERR;
+	}
 
-	nameObjPtr = Jim_NewStringObj(interp, namebuf, -1);
-	if (!nameObjPtr) {
-		free(namebuf);
+	/* Set all the elements with a single "array set", rather than going
+	 * through the variable lookup of "varname(n)" for each of them. */
+	Jim_Obj **pairs = malloc(2 * count * sizeof(*pairs));
+	if (pairs == NULL) {
+		free(buffer);
 		return JIM_ERR;
 	}
+	for (i = 0; i < count; i++) {
+		pairs[2 * i] = Jim_NewIntObj(interp, i);
+		pairs[2 * i + 1] = Jim_NewIntObj(interp, buffer_get_item(target, &buffer[i * width], width));
+	}
+	free(buffer);
 
-	Jim_IncrRefCount(nameObjPtr);
-	valObjPtr = Jim_GetVariable(interp, nameObjPtr, JIM_ERRMSG);
-	Jim_DecrRefCount(interp, nameObjPtr);
-	free(namebuf);
-	if (valObjPtr == NULL)
-		return JIM_ERR;
+	Jim_Obj *array_set[] = {
+		Jim_NewStringObj(interp, "array", -1),
+		Jim_NewStringObj(interp, "set", -1),
+		argv[0],
+		Jim_NewListObj(interp, pairs, 2 * count),
+	};
+	free(pairs);
+	e = Jim_EvalObjVector(interp, ARRAY_SIZE(array_set), array_set);
+	if (e != JIM_OK)
+		return e;
 
-	result = Jim_GetLong(interp, valObjPtr, &l);
-	/* printf("%s(%d) => 0%08x\n", varname, idx, val); */
-	*val = l;
-	return result;
+	Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+
+	return JIM_OK;
 }
 
 static int jim_array2mem(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
@@ -4418,8 +5656,6 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 	int len;
 	uint32_t addr;
 	uint32_t count;
-	uint32_t v;
-	const char *varname;
 	const char *phys;
 	bool is_phys;
 	int  n, e, retval;
@@ -4434,9 +5670,6 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 		Jim_WrongNumArgs(interp, 0, argv, "varname width addr nelems [phys]");
 		return JIM_ERR;
 	}
-	varname = Jim_GetString(argv[0], &len);
-	/* given "foo" get space for worse case "foo(%d)" .. add 20 */
-
 	e = Jim_GetLong(interp, argv[1], &l);
 	width = l;
 	if (e != JIM_OK)
@@ -4460,113 +5693,315 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 	}
 	switch (width) {
 		case 8:
-			width = 1;
-			break;
+			width = 1;
+			break;
+		case 16:
+			width = 2;
+			break;
+		case 32:
+			width = 4;
+			break;
+		default:
+			Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+			Jim_AppendStrings(interp, Jim_GetResult(interp),
+					"Invalid width param, must be 8/16/32", NULL);
+			return JIM_ERR;
+	}
+	if (len == 0) {
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		Jim_AppendStrings(interp, Jim_GetResult(interp),
+				"array2mem: zero width read?", NULL);
+		return JIM_ERR;
+	}
+	if ((addr + (len * width)) < addr) {
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		Jim_AppendStrings(interp, Jim_GetResult(interp),
+				"array2mem: addr + len - wraps to zero?", NULL);
+		return JIM_ERR;
+	}
+	/* absurd transfer size? */
+	if (len > 65536) {
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		Jim_AppendStrings(interp, Jim_GetResult(interp),
+				"array2mem: absurd > 64K item request", NULL);
+		return JIM_ERR;
+	}
+
+	if ((width == 1) ||
+		((width == 2) && ((addr & 1) == 0)) ||
+		((width == 4) && ((addr & 3) == 0))) {
+		/* all is well */
+	} else {
+		char buf[100];
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		sprintf(buf, "array2mem address: 0x%08" PRIx32 " is not aligned for %" PRIu32 " byte reads",
+				addr,
+				width);
+		Jim_AppendStrings(interp, Jim_GetResult(interp), buf, NULL);
+		return JIM_ERR;
+	}
+
+	/* Look the array up once, then each element in it */
+	Jim_Obj *array = Jim_GetVariable(interp, argv[0], JIM_ERRMSG);
+	if (array == NULL)
+		return JIM_ERR;
+
+	uint8_t *buffer = malloc(len * width);
+	if (buffer == NULL)
+		return JIM_ERR;
+
+	count = len;
+	for (i = 0; i < count; i++) {
+		Jim_Obj *key = Jim_NewIntObj(interp, i);
+		Jim_Obj *value;
+		jim_wide w = 0;
+
+		Jim_IncrRefCount(key);
+		e = Jim_DictKey(interp, array, key, &value, JIM_ERRMSG);
+		Jim_DecrRefCount(interp, key);
+		if (e == JIM_OK)
+			e = Jim_GetWide(interp, value, &w);
+		if (e != JIM_OK) {
+			free(buffer);
+			return e;
+		}
+		buffer_set_item(target, &buffer[i * width], width, w);
+	}
+
+	if (is_phys)
+		retval = target_write_phys_memory(target, addr, width, count, buffer);
+	else
+		retval = target_write_memory(target, addr, width, count, buffer);
+	free(buffer);
+	if (retval != ERROR_OK) {
+		/* BOO !*/
+		LOG_ERROR("array2mem: Write @ 0x%08" PRIx32 ", w=%" PRIu32 ", cnt=%" PRIu32 ", failed",
+				  addr,
+				  width,
+				  count);
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		Jim_AppendStrings(interp, Jim_GetResult(interp), "array2mem: cannot read memory", NULL);
+		return JIM_ERR;
+	}
+
+	Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+
+	return JIM_OK;
+}
+
+/* Parse the "width" and the trailing "phys" and "-binary" options of
+ * read_memory and write_memory. The width is returned in bytes. */
+static int target_memory_options(Jim_Interp *interp, int argc, Jim_Obj *const *argv,
+		uint32_t *width, bool *is_phys, bool *binary)
+{
+	jim_wide w;
+	int e = Jim_GetWide(interp, argv[1], &w);
+	if (e != JIM_OK)
+		return e;
+
+	switch (w) {
+		case 8:
 		case 16:
-			width = 2;
-			break;
 		case 32:
-			width = 4;
+		case 64:
+			*width = w / 8;
 			break;
 		default:
-			Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-			Jim_AppendStrings(interp, Jim_GetResult(interp),
-					"Invalid width param, must be 8/16/32", NULL);
+			Jim_SetResultString(interp, "invalid width, must be 8, 16, 32 or 64", -1);
 			return JIM_ERR;
 	}
-	if (len == 0) {
-		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-		Jim_AppendStrings(interp, Jim_GetResult(interp),
-				"array2mem: zero width read?", NULL);
+
+	*is_phys = false;
+	*binary = false;
+	for (int i = 3; i < argc; i++) {
+		const char *opt = Jim_String(argv[i]);
+		if (!strcmp(opt, "phys")) {
+			*is_phys = true;
+		} else if (!strcmp(opt, "-binary")) {
+			*binary = true;
+		} else {
+			Jim_SetResultFormatted(interp, "unknown option %s", opt);
+			return JIM_ERR;
+		}
+	}
+
+	return JIM_OK;
+}
+
+/* read_memory address width count ['phys'] ['-binary']
+ * returns the items as a list of numbers, or the memory as a byte string
+ */
+static int target_jim_read_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	if (argc < 3 || argc > 5) {
+		Jim_WrongNumArgs(interp, 0, argv, "address width count ['phys'] ['-binary']");
 		return JIM_ERR;
 	}
-	if ((addr + (len * width)) < addr) {
-		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-		Jim_AppendStrings(interp, Jim_GetResult(interp),
-				"array2mem: addr + len - wraps to zero?", NULL);
+
+	jim_wide address, count;
+	uint32_t width;
+	bool is_phys, binary;
+	int e = Jim_GetWide(interp, argv[0], &address);
+	if (e == JIM_OK)
+		e = Jim_GetWide(interp, argv[2], &count);
+	if (e == JIM_OK)
+		e = target_memory_options(interp, argc, argv, &width, &is_phys, &binary);
+	if (e != JIM_OK)
+		return e;
+
+	if (count <= 0 || count > 65536) {
+		Jim_SetResultString(interp, "count must be between 1 and 65536", -1);
 		return JIM_ERR;
 	}
-	/* absurd transfer size? */
-	if (len > 65536) {
-		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-		Jim_AppendStrings(interp, Jim_GetResult(interp),
-				"array2mem: absurd > 64K item request", NULL);
+	if (address % width) {
+		Jim_SetResultFormatted(interp, "address is not aligned to %d bytes", (int)width);
 		return JIM_ERR;
 	}
 
-	if ((width == 1) ||
-		((width == 2) && ((addr & 1) == 0)) ||
-		((width == 4) && ((addr & 3) == 0))) {
-		/* all is well */
-	} else {
-		char buf[100];
-		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-		sprintf(buf, "array2mem address: 0x%08" PRIx32 " is not aligned for %" PRIu32 " byte reads",
-				addr,
-				width);
-		Jim_AppendStrings(interp, Jim_GetResult(interp), buf, NULL);
+	uint8_t *buffer = malloc(count * width);
+	if (buffer == NULL) {
+		LOG_ERROR("Failed to allocate memory");
+		return JIM_ERR;
+	}
+
+	int retval;
+	if (is_phys)
+		retval = target_read_phys_memory(target, address, width, count, buffer);
+	else
+		retval = target_read_memory(target, address, width, count, buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("read_memory: read at 0x%" TARGET_PRIxADDR " with width=%" PRIu32
+				" and count=%" PRId64 " failed", (target_addr_t)address, width, (int64_t)count);
+		free(buffer);
+		Jim_SetResultString(interp, "read_memory: failed to read memory", -1);
+		return JIM_ERR;
+	}
+
+	if (binary) {
+		Jim_SetResult(interp, Jim_NewStringObj(interp, (const char *)buffer, count * width));
+		free(buffer);
+		return JIM_OK;
+	}
+
+	Jim_Obj **items = malloc(count * sizeof(*items));
+	if (items == NULL) {
+		LOG_ERROR("Failed to allocate memory");
+		free(buffer);
 		return JIM_ERR;
 	}
+	for (jim_wide i = 0; i < count; i++)
+		items[i] = Jim_NewIntObj(interp, buffer_get_item(target, &buffer[i * width], width));
+	free(buffer);
 
-	/* Transfer loop */
+	Jim_SetResult(interp, Jim_NewListObj(interp, items, count));
+	free(items);
 
-	/* index counter */
-	n = 0;
-	/* assume ok */
-	e = JIM_OK;
+	return JIM_OK;
+}
 
-	size_t buffersize = 4096;
-	uint8_t *buffer = malloc(buffersize);
-	if (buffer == NULL)
+/* write_memory address width data ['phys'] ['-binary']
+ * data is a list of numbers, or with -binary a byte string
+ */
+static int target_jim_write_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	if (argc < 3 || argc > 5) {
+		Jim_WrongNumArgs(interp, 0, argv, "address width data ['phys'] ['-binary']");
 		return JIM_ERR;
+	}
 
-	while (len) {
-		/* Slurp... in buffer size chunks */
+	jim_wide address;
+	uint32_t width;
+	bool is_phys, binary;
+	int e = Jim_GetWide(interp, argv[0], &address);
+	if (e == JIM_OK)
+		e = target_memory_options(interp, argc, argv, &width, &is_phys, &binary);
+	if (e != JIM_OK)
+		return e;
 
-		count = len; /* in objects.. */
-		if (count > (buffersize / width))
-			count = (buffersize / width);
+	if (address % width) {
+		Jim_SetResultFormatted(interp, "address is not aligned to %d bytes", (int)width);
+		return JIM_ERR;
+	}
 
-		v = 0; /* shut up gcc */
-		for (i = 0; i < count; i++, n++) {
-			get_int_array_element(interp, varname, n, &v);
-			switch (width) {
-			case 4:
-				target_buffer_set_u32(target, &buffer[i * width], v);
-				break;
-			case 2:
-				target_buffer_set_u16(target, &buffer[i * width], v);
-				break;
-			case 1:
-				buffer[i] = v & 0x0ff;
-				break;
-			}
+	int len;
+	const char *data = NULL;
+	if (binary) {
+		data = Jim_GetString(argv[2], &len);
+		if (len % width) {
+			Jim_SetResultFormatted(interp, "data is not a multiple of %d bytes", (int)width);
+			return JIM_ERR;
 		}
-		len -= count;
+		len /= width;
+	} else {
+		len = Jim_ListLength(interp, argv[2]);
+	}
+	if (len == 0)
+		return JIM_OK;
 
-		if (is_phys)
-			retval = target_write_phys_memory(target, addr, width, count, buffer);
-		else
-			retval = target_write_memory(target, addr, width, count, buffer);
-		if (retval != ERROR_OK) {
-			/* BOO !*/
-			LOG_ERROR("array2mem: Write @ 0x%08" PRIx32 ", w=%" PRIu32 ", cnt=%" PRIu32 ", failed",
-					  addr,
-					  width,
-					  count);
-			Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
-			Jim_AppendStrings(interp, Jim_GetResult(interp), "array2mem: cannot read memory", NULL);
-			e = JIM_ERR;
-			break;
+	uint8_t *buffer = malloc(len * width);
+	if (buffer == NULL) {
+		LOG_ERROR("Failed to allocate memory");
+		return JIM_ERR;
+	}
+
+	if (binary) {
+		memcpy(buffer, data, len * width);
+	} else {
+		for (int i = 0; i < len; i++) {
+			jim_wide value;
+			e = Jim_GetWide(interp, Jim_ListGetIndex(interp, argv[2], i), &value);
+			if (e != JIM_OK) {
+				free(buffer);
+				return e;
+			}
+			buffer_set_item(target, &buffer[i * width], width, value);
 		}
-		addr += count * width;
 	}
 
+	int retval;
+	if (is_phys)
+		retval = target_write_phys_memory(target, address, width, len, buffer);
+	else
+		retval = target_write_memory(target, address, width, len, buffer);
 	free(buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("write_memory: write at 0x%" TARGET_PRIxADDR " with width=%" PRIu32
+				" and count=%d failed", (target_addr_t)address, width, len);
+		Jim_SetResultString(interp, "write_memory: failed to write memory", -1);
+		return JIM_ERR;
+	}
 
-	Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+	return JIM_OK;
+}
+
+static int jim_read_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct command_context *context = current_command_context(interp);
+	assert(context != NULL);
+
+	struct target *target = get_current_target(context);
+	if (target == NULL) {
+		LOG_ERROR("read_memory: no current target");
+		return JIM_ERR;
+	}
+
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_write_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct command_context *context = current_command_context(interp);
+	assert(context != NULL);
+
+	struct target *target = get_current_target(context);
+	if (target == NULL) {
+		LOG_ERROR("write_memory: no current target");
+		return JIM_ERR;
+	}
 
-	return e;
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
 }
 
 /* FIX? should we propagate errors here rather than printing them
@@ -4646,6 +6081,7 @@ enum target_cfg_param {
 	TCFG_RTOS,
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
+	TCFG_GDB_MAX_CONNECTIONS,
 };
 
 static Jim_Nvp nvp_config_opts[] = {
@@ -4662,6 +6098,7 @@ static Jim_Nvp nvp_config_opts[] = {
 	{ .name = "-rtos",             .value = TCFG_RTOS },
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
+	{ .name = "-gdb-max-connections", .value = TCFG_GDB_MAX_CONNECTIONS },
 	{ .name = NULL, .value = -1 }
 };
 
@@ -4843,16 +6280,26 @@ no_params:
 		case TCFG_WORK_AREA_BACKUP:
 			if (goi->isconfigure) {
 				target_free_all_working_areas(target);
-				e = Jim_GetOpt_Wide(goi, &w);
+				e = Jim_GetOpt_Obj(goi, &o);
 				if (e != JIM_OK)
 					return e;
-				/* make this exactly 1 or 0 */
-				target->backup_working_area = (!!w);
+				if (strcmp(Jim_GetString(o, NULL), "lazy") == 0) {
+					target->backup_working_area = TARGET_WORK_AREA_BACKUP_LAZY;
+				} else {
+					e = Jim_GetWide(goi->interp, o, &w);
+					if (e != JIM_OK)
+						return e;
+					/* make this exactly 1 or 0 */
+					target->backup_working_area = (!!w);
+				}
 			} else {
 				if (goi->argc != 0)
 					goto no_params;
 			}
-			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->backup_working_area));
+			if (target->backup_working_area == TARGET_WORK_AREA_BACKUP_LAZY)
+				Jim_SetResultString(goi->interp, "lazy", -1);
+			else
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->backup_working_area));
 			/* loop for more e*/
 			break;
 
@@ -4969,6 +6416,26 @@ no_params:
 			Jim_SetResultString(goi->interp, target->gdb_port_override ? : "undefined", -1);
 			/* loop for more */
 			break;
+
+		case TCFG_GDB_MAX_CONNECTIONS:
+			if (goi->isconfigure) {
+				struct command_context *cmd_ctx = current_command_context(goi->interp);
+				if (cmd_ctx->mode != COMMAND_CONFIG) {
+					Jim_SetResultString(goi->interp, "-gdb-max-connections must be configured before 'init'", -1);
+					return JIM_ERR;
+				}
+
+				e = Jim_GetOpt_Wide(goi, &w);
+				if (e != JIM_OK)
+					return e;
+				target->gdb_max_connections = (w < 0) ? -1 : (int)w;
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->gdb_max_connections));
+			/* loop for more */
+			break;
 		}
 	} /* while (goi->argc) */
 
@@ -5006,6 +6473,20 @@ static int jim_target_array2mem(Jim_Interp *interp,
 	return target_array2mem(interp, target, argc - 1, argv + 1);
 }
 
+static int jim_target_read_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_target_write_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
+}
+
 static int jim_target_tap_disabled(Jim_Interp *interp)
 {
 	Jim_SetResultFormatted(interp, "[TAP is disabled]");
@@ -5141,6 +6622,7 @@ static int jim_target_reset(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 	target->reset_halt = !!a;
 	/* When this happens - all workareas are invalid. */
 	target_free_all_working_areas_restore(target, 0);
+	target_mem_cache_written();
 
 	/* do the assert */
 	if (n->value == NVP_ASSERT)
@@ -5254,6 +6736,79 @@ static int jim_target_invoke_event(Jim_Interp *interp, int argc, Jim_Obj *const
 	return JIM_OK;
 }
 
+COMMAND_HANDLER(handle_target_mem_cache_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_mem_cache *cache = target->mem_cache;
+
+	if (CMD_ARGC == 0) {
+		if (!cache) {
+			command_print(CMD, "memory cache disabled");
+			return ERROR_OK;
+		}
+		command_print(CMD, "memory cache %s, %" PRIu64 " hits, %" PRIu64 " misses",
+				cache->enabled ? "enabled" : "shared", cache->hits, cache->misses);
+		for (unsigned int i = 0; i < cache->num_volatile; i++)
+			command_print(CMD, "volatile " TARGET_ADDR_FMT " size " TARGET_ADDR_FMT,
+					cache->volatile_regions[i].address, cache->volatile_regions[i].size);
+		return ERROR_OK;
+	}
+
+	if (strcmp(CMD_ARGV[0], "volatile") == 0) {
+		if (CMD_ARGC != 3)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (!cache) {
+			command_print(CMD, "memory cache disabled");
+			return ERROR_FAIL;
+		}
+
+		struct target_mem_cache_region region;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], region.address);
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[2], region.size);
+
+		struct target_mem_cache_region *regions = realloc(cache->volatile_regions,
+				(cache->num_volatile + 1) * sizeof(*regions));
+		if (!regions) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		regions[cache->num_volatile++] = region;
+		cache->volatile_regions = regions;
+		target_mem_cache_invalidate(target);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(CMD_ARGV[0], "flush") == 0) {
+		target_mem_cache_invalidate(target);
+		return ERROR_OK;
+	}
+
+	bool enable;
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+	if (enable && !cache) {
+		target->mem_cache = calloc(1, sizeof(*target->mem_cache));
+		if (!target->mem_cache) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		target->mem_cache->enabled = true;
+	} else if (enable) {
+		cache->enabled = true;
+	} else if (cache && cache->sharers) {
+		/* kept for its sharers */
+		cache->enabled = false;
+	} else if (cache) {
+		free(cache->volatile_regions);
+		free(cache);
+		target->mem_cache = NULL;
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration target_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -5269,6 +6824,16 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help  = "returns the specified target attribute",
 		.usage = "target_attribute",
 	},
+	{
+		.name = "mem_cache",
+		.handler = handle_target_mem_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "Enable, disable or flush the host side cache of target "
+			"memory used while the target is halted, or exclude a "
+			"volatile region from it. Without argument the state and "
+			"statistics are displayed.",
+		.usage = "['on'|'off'|'flush'|'volatile' address size]",
+	},
 	{
 		.name = "mwd",
 		.handler = handle_mw_command,
@@ -5341,6 +6906,22 @@ static const struct command_registration target_instance_command_handlers[] = {
 			"from target memory",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_read_memory,
+		.help = "Returns a list of 8/16/32/64 bit numbers, or a byte "
+			"string, read from target memory",
+		.usage = "address width count ['phys'] ['-binary']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_write_memory,
+		.help = "Writes a list of 8/16/32/64 bit numbers, or a byte "
+			"string, to target memory",
+		.usage = "address width data ['phys'] ['-binary']",
+	},
 	{
 		.name = "eventlist",
 		.handler = handle_target_event_list,
@@ -5410,6 +6991,9 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.chain = target_sample_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -5549,6 +7133,7 @@ static int target_create(Jim_GetOptInfo *goi)
 	target->rtos_auto_detect = false;
 
 	target->gdb_port_override = NULL;
+	target->gdb_max_connections = 1;
 
 	/* Do the rest as "configure" options */
 	goi->isconfigure = 1;
@@ -5810,6 +7395,9 @@ static const struct command_registration target_subcommand_handlers[] = {
 		.usage = "targetname1 targetname2 ...",
 		.help = "gather several target in a smp list"
 	},
+	{
+		.chain = target_sample_command_handlers,
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
@@ -5982,6 +7570,9 @@ static const struct command_registration target_command_handlers[] = {
 		.chain = target_subcommand_handlers,
 		.usage = "",
 	},
+	{
+		.chain = rtt_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -6217,7 +7808,65 @@ nextw:
 	return retval;
 }
 
+COMMAND_HANDLER(handle_working_area_stats_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	uint32_t used = 0, used_blocks = 0, free_bytes = 0, free_blocks = 0;
+
+	if (!target->working_areas) {
+		command_print(CMD, "no working area allocated, %" PRIu32 " bytes available",
+				target_get_working_area_avail(target));
+		return ERROR_OK;
+	}
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		command_print(CMD, "%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
+				c->free ? ' ' : '*', c->address, c->address + c->size - 1, c->size);
+		if (c->free) {
+			free_bytes += c->size;
+			free_blocks++;
+		} else {
+			used += c->size;
+			used_blocks++;
+		}
+	}
+
+	uint32_t largest = target_get_working_area_avail(target);
+	command_print(CMD, "%" PRIu32 " bytes in %" PRIu32 " allocations, %" PRIu32
+			" bytes free in %" PRIu32 " blocks, largest free block %" PRIu32
+			" bytes, fragmentation %" PRIu32 "%%",
+			used, used_blocks, free_bytes, free_blocks, largest,
+			free_bytes ? 100 - (uint32_t)((uint64_t)largest * 100 / free_bytes) : 0);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration working_area_command_handlers[] = {
+	{
+		.name = "stats",
+		.handler = handle_working_area_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display the working area layout of the current target, "
+			"its free space and fragmentation",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_exec_command_handlers[] = {
+	{
+		.name = "working_area",
+		.mode = COMMAND_EXEC,
+		.help = "working area command group",
+		.usage = "",
+		.chain = working_area_command_handlers,
+	},
+	{
+		.chain = rtos_command_handlers,
+	},
 	{
 		.name = "fast_load_image",
 		.handler = handle_fast_load_image_command,
@@ -6265,6 +7914,13 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "poll target state; or reconfigure background polling",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "poll_interval",
+		.handler = handle_poll_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "display or set the adaptive background polling interval",
+		.usage = "[min_ms [max_ms]]",
+	},
 	{
 		.name = "wait_halt",
 		.handler = handle_wait_halt_command,
@@ -6366,6 +8022,20 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.help = "write memory byte",
 		.usage = "['phys'] address value [count]",
 	},
+	{
+		.name = "mem_fill",
+		.handler = handle_mem_fill_command,
+		.mode = COMMAND_EXEC,
+		.help = "fill memory with a 32 bit value, on the target where possible",
+		.usage = "address size value",
+	},
+	{
+		.name = "mem_test",
+		.handler = handle_mem_test_command,
+		.mode = COMMAND_EXEC,
+		.help = "write and verify test patterns, on the target where possible",
+		.usage = "address size ['walking_ones'|'address'|'random'|'all' [seed]]",
+	},
 	{
 		.name = "bp",
 		.handler = handle_bp_command,
@@ -6401,11 +8071,19 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.usage = "filename address ['bin'|'ihex'|'elf'|'s19'] "
 			"[min_address] [max_length]",
 	},
+	{
+		.name = "load_image_multi",
+		.handler = handle_load_image_multi_command,
+		.mode = COMMAND_EXEC,
+		.help = "load the same image into several targets",
+		.usage = "'target ...' filename address ['bin'|'ihex'|'elf'|'s19'] "
+			"[min_address] [max_length]",
+	},
 	{
 		.name = "dump_image",
 		.handler = handle_dump_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "filename address size",
+		.usage = "filename address size ['sparse']",
 	},
 	{
 		.name = "verify_image_checksum",
@@ -6441,6 +8119,22 @@ static const struct command_registration target_exec_command_handlers[] = {
 			"and write the 8/16/32 bit values",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_read_memory,
+		.help = "read 8/16/32/64 bit memory and return it as a TCL list, "
+			"or as a byte string",
+		.usage = "address width count ['phys'] ['-binary']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_write_memory,
+		.help = "write a TCL list of 8/16/32/64 bit values, or a byte "
+			"string, to memory",
+		.usage = "address width data ['phys'] ['-binary']",
+	},
 	{
 		.name = "reset_nag",
 		.handler = handle_target_reset_nag,
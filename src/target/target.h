@@ -95,6 +95,9 @@ enum target_endianness {
 	TARGET_BIG_ENDIAN = 1, TARGET_LITTLE_ENDIAN = 2
 };
 
+/* backup_working_area value: back up on allocation, restore only on resume */
+#define TARGET_WORK_AREA_BACKUP_LAZY 2
+
 struct working_area {
 	target_addr_t address;
 	uint32_t size;
@@ -111,6 +114,10 @@ struct gdb_service {
 	/*  element 1 coreid to be displayed at next resume 1 till n 0 means resume
 	 *  all cores core displayed  */
 	int32_t core[2];
+	/* number of attached gdb connections */
+	int num_connections;
+	/* set while the connections share the memory cache of the target */
+	bool mem_cache_shared;
 };
 
 /* target back off timer */
@@ -165,6 +172,8 @@ struct target {
 	uint32_t working_area_size;			/* size in bytes */
 	uint32_t backup_working_area;		/* whether the content of the working area has to be preserved */
 	struct working_area *working_areas;/* list of allocated working areas */
+	uint8_t *working_area_shadow;		/* lazy backup of the whole working area */
+	uint32_t *working_area_saved;		/* bitmap of the words held by working_area_shadow */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
 	/* also see: target_state_name() */
@@ -172,9 +181,15 @@ struct target {
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
+	/* the lists above indexed by address, see breakpoints.c */
+#define TARGET_BREAKPOINT_HASH_SIZE 64
+	struct breakpoint *breakpoint_hash[TARGET_BREAKPOINT_HASH_SIZE];
+	struct watchpoint *watchpoint_hash[TARGET_BREAKPOINT_HASH_SIZE];
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
 	uint32_t dbg_msg_enabled;			/* debug message status */
+	unsigned int dbg_msg_poll_ms;		/* current interval of the debug message polls */
+	int64_t dbg_msg_next_poll;			/* timeval_ms() of the next debug message poll */
 	void *arch_info;					/* architecture specific information */
 	void *private_config;				/* pointer to target specific config data (for jim_configure hook) */
 	struct target *next;				/* next target in list */
@@ -198,7 +213,11 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	unsigned int poll_interval_ms;		/* current adaptive polling interval */
+	int64_t poll_next_ms;				/* time of the next poll, see handle_target() */
 	int smp;							/* add some target attributes for smp support */
+	bool smp_nonstop;					/* set while GDB runs in non-stop mode: the cores
+										 * of the SMP group halt, resume and step alone */
 	struct target_list *head;
 	/* the gdb service is there in case of smp, we have only one gdb server
 	 * for all smp target
@@ -210,9 +229,13 @@ struct target {
 	struct gdb_fileio_info *fileio_info;
 
 	char *gdb_port_override;			/* target-specific override for gdb_port */
+	int gdb_max_connections;			/* max number of simultaneous gdb connections, -1 unlimited */
 
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
+
+	/* Host side cache of target memory while halted, NULL if disabled */
+	struct target_mem_cache *mem_cache;
 };
 
 struct target_list {
@@ -331,7 +354,7 @@ struct target_timer_callback {
 	bool removed;
 	struct timeval when;
 	void *priv;
-	struct target_timer_callback *next;
+	unsigned int heap_index;	/* position in the deadline heap */
 };
 
 struct target_memory_check_block {
@@ -340,6 +363,30 @@ struct target_memory_check_block {
 	uint32_t result;
 };
 
+/* one block of target_read_buffer_batch() */
+struct target_read_request {
+	target_addr_t address;
+	uint32_t size;
+	uint8_t *buffer;
+	/* result of this block, set by target_read_buffer_batch() */
+	int retval;
+};
+
+/* word patterns of target_mem_pattern(), see "mem_fill" and "mem_test" */
+enum target_mem_pattern {
+	TARGET_MEM_FILL,			/* the given value, written only */
+	TARGET_MEM_WALKING_ONES,	/* 1 << (word index % 32) */
+	TARGET_MEM_ADDRESS,			/* the address of the word */
+	TARGET_MEM_RANDOM,			/* xorshift32 sequence from the given seed */
+};
+
+struct target_mem_test_result {
+	bool failed;
+	target_addr_t address;
+	uint32_t expected;
+	uint32_t actual;
+};
+
 int target_register_commands(struct command_context *cmd_ctx);
 int target_examine(void);
 
@@ -398,6 +445,18 @@ int target_register_timer_callback(int (*callback)(void *priv),
 		unsigned int time_ms, enum target_timer_type type, void *priv);
 int target_unregister_timer_callback(int (*callback)(void *priv), void *priv);
 int target_call_timer_callbacks(void);
+/* Ask the server loop to poll again instead of sleeping */
+void target_timer_callbacks_request_poll(void);
+bool target_timer_callbacks_poll_requested(void);
+/** @returns the number of ms until the next timer callback is due */
+int64_t target_timer_next_event(void);
+/**
+ * Poll @a target (or every target if NULL) at the next timer tick instead of
+ * waiting for its polling interval to expire. Meant for adapters which learn
+ * about a halt asynchronously, e.g. from a status endpoint, and for code which
+ * has just resumed or stepped a target.
+ */
+void target_poll_request(struct target *target);
 /**
  * Invoke this to ensure that e.g. polling timer callbacks happen before
  * a synchronous command completes.
@@ -516,6 +575,48 @@ int target_get_gdb_reg_list_noread(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Read the invalid registers of @a reg_list in one batch, where the target
+ * supports it. Registers left invalid must be read with their get() method.
+ *
+ * This routine is a wrapper for target->type->read_registers_batch.
+ */
+int target_read_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size);
+
+/**
+ * Write the dirty registers of @a reg_list in one batch, where the target
+ * supports it. Registers left dirty must be written one by one.
+ *
+ * This routine is a wrapper for target->type->write_registers_batch.
+ */
+int target_write_registers_batch(struct target *target,
+		struct reg **reg_list, int reg_list_size);
+
+/**
+ * Let one more (@a share true) or one less user read memory of @a target
+ * through its memory cache, e.g. several gdb connections asking for the
+ * same data during one halt. The cache exists while it is shared or
+ * enabled with "mem_cache on".
+ */
+int target_mem_cache_share(struct target *target, bool share);
+
+/**
+ * @returns a number which changes whenever the memory of any target may
+ * have changed through OpenOCD: target events like resume, step, halt and
+ * reset, memory writes and algorithm runs. Memory of running targets may
+ * change at any time regardless.
+ */
+unsigned int target_memory_generation(void);
+
+/**
+ * @returns a number which changes whenever the memory of any target may
+ * have changed through OpenOCD memory writes and algorithm runs, or when
+ * a target was resumed or reset. Unlike target_memory_generation() it does
+ * not change on single steps and halts.
+ */
+unsigned int target_memory_write_generation(void);
+
 /**
  * Check if @a target allows GDB connections.
  *
@@ -575,6 +676,31 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point,
 		void *arch_info);
 
+/**
+ * Accounting of target_run_flash_async_algorithm(), shown and reset by
+ * "flash stats". Times are in microseconds.
+ */
+struct async_algorithm_stats {
+	/** algorithm runs */
+	uint64_t runs;
+	/** bytes streamed through the fifo */
+	uint64_t bytes;
+	/** fifo writes, each filling the free space up to the wrap around */
+	uint64_t rounds;
+	/** fifo writes which found the fifo already drained by the target */
+	uint64_t empty;
+	/** time spent starting the algorithm */
+	uint64_t start_us;
+	/** time spent writing data and the write pointer to the fifo */
+	uint64_t transfer_us;
+	/** time blocked on a full fifo */
+	uint64_t full_us;
+	/** time waiting for the algorithm to finish after the last write */
+	uint64_t drain_us;
+};
+
+extern struct async_algorithm_stats async_algorithm_stats;
+
 /**
  * Read @a count items of @a size bytes from the memory of @a target at
  * the @a address given.
@@ -635,13 +761,52 @@ int target_write_buffer(struct target *target,
 		target_addr_t address, uint32_t size, const uint8_t *buffer);
 int target_read_buffer(struct target *target,
 		target_addr_t address, uint32_t size, uint8_t *buffer);
+
+/**
+ * Read several unrelated blocks, like target_read_buffer() does for each,
+ * with as few round trips to the adapter as the target allows, e.g. the
+ * TCBs and names found at one level of an RTOS thread list.
+ *
+ * The result of each block is stored in its retval field.
+ * @returns ERROR_OK if all the blocks were read, else the first failure.
+ */
+int target_read_buffer_batch(struct target *target,
+		struct target_read_request *reads, unsigned int count);
+
+/**
+ * Write the same data to several targets, like target_write_buffer() does
+ * for each, e.g. when programming several devices at once. Targets of one
+ * type on APs of one DAP get their writes in a single queue run.
+ *
+ * The result of each target is stored in @a retvals.
+ * @returns ERROR_OK if all the targets were written, else the first failure.
+ */
+int target_write_buffer_multi(struct target **targets, unsigned int count,
+		target_addr_t address, uint32_t size, const uint8_t *buffer, int *retvals);
 int target_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t *crc);
+int target_checksum_memory_blocks(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks);
+uint32_t target_mem_pattern_value(enum target_mem_pattern pattern,
+		uint32_t index, target_addr_t address, uint32_t value, uint32_t *state);
+int target_mem_pattern(struct target *target, target_addr_t address,
+		uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+		struct target_mem_test_result *result);
 int target_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks,
 		uint8_t erased_value);
+int target_stack_check_memory(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks,
+		uint8_t fill_value);
 int target_wait_state(struct target *target, enum target_state state, int ms);
 
+/**
+ * Sample the PC by halting and resuming the target as often as possible.
+ * This is the fallback for targets without non-intrusive PC sampling.
+ */
+int target_profiling_default(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+
 /**
  * Obtain file-I/O information from target for GDB to do syscall.
  *
@@ -702,6 +867,17 @@ int target_free_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
 uint32_t target_get_working_area_avail(struct target *target);
 
+/**
+ * Allocates the buffer for target_run_flash_async_algorithm() as large as
+ * the largest free working area allows, up to what @a count blocks of
+ * @a block_size bytes need. The fifo part is a multiple of the block size.
+ * Halves the size while the allocation fails.
+ * @returns ERROR_TARGET_RESOURCE_NOT_AVAILABLE below @a min_size bytes,
+ * unless that is enough for all the data.
+ */
+int target_alloc_async_fifo(struct target *target, uint32_t count,
+		uint32_t block_size, uint32_t min_size, struct working_area **area);
+
 /**
  * Free all the resources allocated by targets and the target layer
  */
@@ -727,6 +903,15 @@ void target_buffer_set_u16_array(struct target *target, uint8_t *buffer, uint32_
 
 int target_read_u64(struct target *target, target_addr_t address, uint64_t *value);
 int target_read_u32(struct target *target, target_addr_t address, uint32_t *value);
+/**
+ * Wait up to @a timeout_ms until (word at @a address & @a mask) == @a match.
+ * Where the adapter supports it the reads are repeated by the adapter
+ * without a round trip to the host for each of them.
+ * @returns ERROR_TIMEOUT_REACHED if the word did not match in time, in
+ * @a value (if not NULL) the last value read.
+ */
+int target_poll_u32(struct target *target, target_addr_t address,
+		uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms);
 int target_read_u16(struct target *target, target_addr_t address, uint16_t *value);
 int target_read_u8(struct target *target, target_addr_t address, uint8_t *value);
 int target_write_u64(struct target *target, target_addr_t address, uint64_t value);
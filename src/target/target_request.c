@@ -28,12 +28,20 @@
 
 #include <helper/log.h>
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 
 #include "target.h"
 #include "target_request.h"
 #include "target_type.h"
 #include "trace.h"
 
+/* bounds of the adaptive poll interval of the debug messages */
+#define TARGET_REQ_POLL_MIN_MS	1
+#define TARGET_REQ_POLL_MAX_MS	64
+
+/* largest text buffer accepted from a TARGET_REQ_DEBUGBUF request */
+#define TARGET_REQ_BUF_MAX		(64 * 1024)
+
 static bool got_message;
 
 bool target_got_message(void)
@@ -63,6 +71,57 @@ static int target_asciimsg(struct target *target, uint32_t length)
 	return ERROR_OK;
 }
 
+/* The request is followed by the address of a buffer in target memory,
+ * which holds the length of a text in bytes followed by the text. The text
+ * is read with a single memory access and the length is cleared, which
+ * tells the target that the buffer may be reused.
+ */
+static int target_bufmsg(struct target *target)
+{
+	struct debug_msg_receiver *c = target->dbgmsg;
+	uint8_t word[4];
+	uint32_t length;
+
+	int retval = target->type->target_request_data(target, 1, word);
+	if (retval != ERROR_OK)
+		return retval;
+	uint32_t address = le_to_h_u32(word);
+
+	retval = target_read_u32(target, address, &length);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("can't read the debug message buffer at 0x%8.8" PRIx32, address);
+		return retval;
+	}
+
+	if (length > TARGET_REQ_BUF_MAX) {
+		LOG_ERROR("debug message buffer at 0x%8.8" PRIx32 " too long (%" PRIu32 " bytes)",
+				address, length);
+		return ERROR_FAIL;
+	}
+
+	char *msg = malloc(length + 1);
+	if (msg == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = target_read_buffer(target, address + 4, length, (uint8_t *)msg);
+	if (retval == ERROR_OK) {
+		msg[length] = 0;
+		LOG_DEBUG("%s", msg);
+
+		while (c) {
+			command_output_text(c->cmd_ctx, msg);
+			c = c->next;
+		}
+
+		retval = target_write_u32(target, address, 0);
+	}
+
+	free(msg);
+	return retval;
+}
+
 static int target_charmsg(struct target *target, uint8_t msg)
 {
 	LOG_USER_N("%c", msg);
@@ -143,6 +202,8 @@ int target_request(struct target *target, uint32_t request)
 		case TARGET_REQ_DEBUGCHAR:
 			target_charmsg(target, (request & 0x00ff0000) >> 16);
 			break;
+		case TARGET_REQ_DEBUGBUF:
+			return target_bufmsg(target);
 /*		case TARGET_REQ_SEMIHOSTING:
  *			break;
  */
@@ -154,6 +215,21 @@ int target_request(struct target *target, uint32_t request)
 	return ERROR_OK;
 }
 
+bool target_request_poll_due(struct target *target)
+{
+	return timeval_ms() >= target->dbg_msg_next_poll;
+}
+
+void target_request_polled(struct target *target, bool got_request)
+{
+	if (got_request || target->dbg_msg_poll_ms == 0)
+		target->dbg_msg_poll_ms = TARGET_REQ_POLL_MIN_MS;
+	else
+		target->dbg_msg_poll_ms = MIN(2 * target->dbg_msg_poll_ms, TARGET_REQ_POLL_MAX_MS);
+
+	target->dbg_msg_next_poll = timeval_ms() + target->dbg_msg_poll_ms;
+}
+
 static int add_debug_msg_receiver(struct command_context *cmd_ctx, struct target *target)
 {
 	struct debug_msg_receiver **p = &target->dbgmsg;
@@ -33,6 +33,7 @@ typedef enum target_req_cmd {
 	TARGET_REQ_DEBUGMSG,
 	TARGET_REQ_DEBUGCHAR,
 /*	TARGET_REQ_SEMIHOSTING, */
+	TARGET_REQ_DEBUGBUF = 4,
 } target_req_cmd_t;
 
 struct debug_msg_receiver {
@@ -52,4 +53,15 @@ int target_request_register_commands(struct command_context *cmd_ctx);
  */
 bool target_got_message(void);
 
+/**
+ * The debug message channel is polled every millisecond while it has
+ * traffic, and less and less often while it is idle.
+ * @returns true when the debug message channel of @a target is due to be
+ * polled.
+ */
+bool target_request_poll_due(struct target *target);
+
+/** Adapt the poll interval of @a target to whether its poll got a request. */
+void target_request_polled(struct target *target, bool got_request);
+
 #endif /* OPENOCD_TARGET_TARGET_REQUEST_H */
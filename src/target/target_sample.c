@@ -0,0 +1,432 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Sample a set of target variables at a fixed rate without halting.
+ *
+ * Every tick of a periodic timer callback reads all configured locations
+ * with a single target_read_buffer_batch(), i.e. one DAP queue run on
+ * targets which implement it. Each tick produces one record:
+ *
+ *   u32 sequence, u64 microseconds since start, u8 status,
+ *   then every value in configuration order, width bytes each
+ *
+ * A sample file starts with the magic "OCDSMP", a version byte, a reserved
+ * byte, the u32 tick period in microseconds and the u16 number of entries,
+ * each stored as u64 address and u8 width. All numbers are little endian,
+ * values are converted from target byte order.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "target.h"
+#include "target_sample.h"
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+
+#define SAMPLE_MAGIC		"OCDSMP"
+#define SAMPLE_VERSION		1
+#define SAMPLE_MAX_ENTRIES	256
+
+#define SAMPLE_RECORD_HEADER	13
+
+/* status byte of a record */
+#define SAMPLE_OK			0
+#define SAMPLE_READ_FAILED	1	/* failed values are zero */
+#define SAMPLE_NOT_EXAMINED	2	/* nothing read */
+
+struct sample_entry {
+	target_addr_t address;
+	unsigned int width;
+};
+
+struct sample_callback {
+	struct list_head list;
+	void *priv;
+	int (*callback)(struct target *target, const uint8_t *record, size_t len, void *priv);
+};
+
+static struct sample_entry *sample_entries;
+static unsigned int sample_count;
+
+static struct target *sample_target;
+static FILE *sample_file;
+static unsigned int sample_period_ms;
+static int64_t sample_start_us;
+static int64_t sample_last_us;
+static uint32_t sample_sequence;
+static uint32_t sample_failed;
+static uint32_t sample_overruns;
+
+/* per tick buffers, sized when sampling starts */
+static struct target_read_request *sample_reads;
+static uint8_t *sample_record;
+static size_t sample_record_len;
+
+static LIST_HEAD(sample_callback_list);
+
+int target_register_sample_callback(int (*callback)(struct target *target,
+		const uint8_t *record, size_t len, void *priv), void *priv)
+{
+	struct sample_callback *entry;
+
+	if (callback == NULL)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	entry = malloc(sizeof(*entry));
+	if (entry == NULL) {
+		LOG_ERROR("error allocating buffer for sample callback entry");
+		return ERROR_FAIL;
+	}
+
+	entry->callback = callback;
+	entry->priv = priv;
+	list_add(&entry->list, &sample_callback_list);
+
+	return ERROR_OK;
+}
+
+int target_unregister_sample_callback(int (*callback)(struct target *target,
+		const uint8_t *record, size_t len, void *priv), void *priv)
+{
+	struct sample_callback *entry;
+
+	if (callback == NULL)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	list_for_each_entry(entry, &sample_callback_list, list) {
+		if (entry->callback == callback && entry->priv == priv) {
+			list_del(&entry->list);
+			free(entry);
+			break;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+static void sample_emit(void)
+{
+	struct sample_callback *callback;
+
+	if (sample_file) {
+		if (fwrite(sample_record, 1, sample_record_len, sample_file) != sample_record_len
+				|| fflush(sample_file) != 0) {
+			LOG_ERROR("write to sample file failed, closing it");
+			fclose(sample_file);
+			sample_file = NULL;
+		}
+	}
+
+	list_for_each_entry(callback, &sample_callback_list, list)
+		callback->callback(sample_target, sample_record, sample_record_len, callback->priv);
+}
+
+static int sample_timer_callback(void *priv)
+{
+	struct target *target = priv;
+	int64_t now = timeval_us();
+	uint8_t *values = sample_record + SAMPLE_RECORD_HEADER;
+	uint8_t status = SAMPLE_OK;
+
+	/* ticks the timer could not keep up with */
+	int64_t period_us = sample_period_ms * 1000;
+	if (sample_sequence && now - sample_last_us >= 2 * period_us)
+		sample_overruns += (now - sample_last_us) / period_us - 1;
+	sample_last_us = now;
+
+	memset(values, 0, sample_record_len - SAMPLE_RECORD_HEADER);
+
+	if (!target_was_examined(target)) {
+		status = SAMPLE_NOT_EXAMINED;
+	} else {
+		uint8_t *p = values;
+		for (unsigned int i = 0; i < sample_count; i++) {
+			sample_reads[i].address = sample_entries[i].address;
+			sample_reads[i].size = sample_entries[i].width;
+			sample_reads[i].buffer = p;
+			sample_reads[i].retval = ERROR_OK;
+			p += sample_entries[i].width;
+		}
+
+		int retval = target_read_buffer_batch(target, sample_reads, sample_count);
+
+		p = values;
+		for (unsigned int i = 0; i < sample_count; i++) {
+			unsigned int width = sample_entries[i].width;
+			if (retval != ERROR_OK || sample_reads[i].retval != ERROR_OK) {
+				memset(p, 0, width);
+				status = SAMPLE_READ_FAILED;
+			} else if (width == 4) {
+				h_u32_to_le(p, target_buffer_get_u32(target, p));
+			} else if (width == 2) {
+				h_u16_to_le(p, target_buffer_get_u16(target, p));
+			}
+			p += width;
+		}
+	}
+
+	if (status != SAMPLE_OK)
+		sample_failed++;
+
+	h_u32_to_le(sample_record, sample_sequence++);
+	h_u64_to_le(sample_record + 4, now - sample_start_us);
+	sample_record[12] = status;
+	sample_emit();
+
+	return ERROR_OK;
+}
+
+static int sample_write_header(void)
+{
+	uint8_t buf[16];
+
+	memcpy(buf, SAMPLE_MAGIC, 6);
+	buf[6] = SAMPLE_VERSION;
+	buf[7] = 0;
+	h_u32_to_le(buf + 8, sample_period_ms * 1000);
+	h_u16_to_le(buf + 12, sample_count);
+	if (fwrite(buf, 1, 14, sample_file) != 14)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < sample_count; i++) {
+		h_u64_to_le(buf, sample_entries[i].address);
+		buf[8] = sample_entries[i].width;
+		if (fwrite(buf, 1, 9, sample_file) != 9)
+			return ERROR_FAIL;
+	}
+
+	return fflush(sample_file) == 0 ? ERROR_OK : ERROR_FAIL;
+}
+
+void target_sample_stop(void)
+{
+	if (!sample_target)
+		return;
+
+	target_unregister_timer_callback(sample_timer_callback, sample_target);
+	if (sample_file)
+		fclose(sample_file);
+	sample_file = NULL;
+	sample_target = NULL;
+
+	free(sample_reads);
+	sample_reads = NULL;
+	free(sample_record);
+	sample_record = NULL;
+}
+
+static int sample_start(struct command_invocation *cmd, struct target *target,
+		unsigned int period_ms, const char *filename)
+{
+	size_t len = SAMPLE_RECORD_HEADER;
+
+	for (unsigned int i = 0; i < sample_count; i++)
+		len += sample_entries[i].width;
+
+	sample_target = target;
+	sample_reads = calloc(sample_count, sizeof(*sample_reads));
+	sample_record = malloc(len);
+	if (!sample_reads || !sample_record) {
+		LOG_ERROR("Out of memory");
+		goto fail;
+	}
+	sample_record_len = len;
+
+	sample_period_ms = period_ms;
+	sample_sequence = 0;
+	sample_failed = 0;
+	sample_overruns = 0;
+
+	if (filename) {
+		sample_file = fopen(filename, "wb");
+		if (!sample_file) {
+			command_print(cmd, "can't open %s: %s", filename, strerror(errno));
+			goto fail;
+		}
+		if (sample_write_header() != ERROR_OK) {
+			command_print(cmd, "write to %s failed", filename);
+			goto fail;
+		}
+	}
+
+	sample_start_us = timeval_us();
+	sample_last_us = sample_start_us;
+
+	int retval = target_register_timer_callback(sample_timer_callback, period_ms,
+			TARGET_TIMER_TYPE_PERIODIC, target);
+	if (retval != ERROR_OK)
+		goto fail;
+
+	return ERROR_OK;
+
+fail:
+	target_sample_stop();
+	return ERROR_FAIL;
+}
+
+COMMAND_HANDLER(handle_sample_add_command)
+{
+	target_addr_t address;
+	unsigned int width = 4;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], width);
+		if (width != 1 && width != 2 && width != 4)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (sample_target) {
+		command_print(CMD, "stop sampling before changing the sampled locations");
+		return ERROR_FAIL;
+	}
+	if (sample_count >= SAMPLE_MAX_ENTRIES) {
+		command_print(CMD, "at most %d locations can be sampled", SAMPLE_MAX_ENTRIES);
+		return ERROR_FAIL;
+	}
+	if (address & (width - 1)) {
+		command_print(CMD, "address " TARGET_ADDR_FMT " is not aligned to %u bytes",
+				address, width);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct sample_entry *entries = realloc(sample_entries,
+			(sample_count + 1) * sizeof(*entries));
+	if (!entries) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	sample_entries = entries;
+	sample_entries[sample_count].address = address;
+	sample_entries[sample_count].width = width;
+	sample_count++;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sample_clear_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sample_target) {
+		command_print(CMD, "stop sampling before changing the sampled locations");
+		return ERROR_FAIL;
+	}
+
+	free(sample_entries);
+	sample_entries = NULL;
+	sample_count = 0;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sample_start_command)
+{
+	unsigned int period_ms;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], period_ms);
+	if (period_ms == 0)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	if (sample_target) {
+		command_print(CMD, "sampling already runs on %s", target_name(sample_target));
+		return ERROR_FAIL;
+	}
+	if (sample_count == 0) {
+		command_print(CMD, "no locations to sample, see 'sample add'");
+		return ERROR_FAIL;
+	}
+
+	return sample_start(CMD, get_current_target(CMD_CTX), period_ms,
+			CMD_ARGC == 2 ? CMD_ARGV[1] : NULL);
+}
+
+COMMAND_HANDLER(handle_sample_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_sample_stop();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sample_status_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned int i = 0; i < sample_count; i++)
+		command_print(CMD, "%u: " TARGET_ADDR_FMT " width %u", i,
+				sample_entries[i].address, sample_entries[i].width);
+
+	if (sample_target)
+		command_print(CMD, "sampling %s every %u ms: %" PRIu32 " records, "
+				"%" PRIu32 " failed, %" PRIu32 " overruns",
+				target_name(sample_target), sample_period_ms,
+				sample_sequence, sample_failed, sample_overruns);
+	else
+		command_print(CMD, "sampling stopped");
+
+	return ERROR_OK;
+}
+
+static const struct command_registration target_sample_subcommand_handlers[] = {
+	{
+		.name = "add",
+		.handler = handle_sample_add_command,
+		.mode = COMMAND_ANY,
+		.help = "add a location to sample, width in bytes defaults to 4",
+		.usage = "address [1|2|4]",
+	},
+	{
+		.name = "clear",
+		.handler = handle_sample_clear_command,
+		.mode = COMMAND_ANY,
+		.help = "forget all sampled locations",
+		.usage = "",
+	},
+	{
+		.name = "start",
+		.handler = handle_sample_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "sample the current target every period_ms milliseconds, "
+			"optionally writing the records to a file",
+		.usage = "period_ms [filename]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_sample_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling and close the sample file",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_sample_status_command,
+		.mode = COMMAND_ANY,
+		.help = "list the sampled locations and the sampling statistics",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration target_sample_command_handlers[] = {
+	{
+		.name = "sample",
+		.mode = COMMAND_ANY,
+		.help = "periodic sampling of target memory without halting",
+		.usage = "",
+		.chain = target_sample_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
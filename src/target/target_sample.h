@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/**
+ * @file
+ * Periodic sampling of target memory while the target runs, see
+ * "target sample".
+ */
+
+#ifndef OPENOCD_TARGET_TARGET_SAMPLE_H
+#define OPENOCD_TARGET_TARGET_SAMPLE_H
+
+#include <helper/command.h>
+
+struct target;
+
+extern const struct command_registration target_sample_command_handlers[];
+
+/**
+ * Register @a callback to receive every sample record, as written to the
+ * sample file, while sampling runs.
+ */
+int target_register_sample_callback(int (*callback)(struct target *target,
+		const uint8_t *record, size_t len, void *priv), void *priv);
+int target_unregister_sample_callback(int (*callback)(struct target *target,
+		const uint8_t *record, size_t len, void *priv), void *priv);
+
+/** Stop sampling and close the sample file, if any. */
+void target_sample_stop(void);
+
+#endif /* OPENOCD_TARGET_TARGET_SAMPLE_H */
@@ -118,6 +118,24 @@ struct target_type {
 			struct reg **reg_list[], int *reg_list_size,
 			enum target_register_class reg_class);
 
+	/**
+	 * Optional. Read the values of the invalid registers of @a reg_list
+	 * with as few round trips to the adapter as possible, and mark them
+	 * valid. Registers the method can not handle are left invalid, for
+	 * their get() method to read; entries may be NULL.
+	 */
+	int (*read_registers_batch)(struct target *target,
+			struct reg **reg_list, int reg_list_size);
+
+	/**
+	 * Optional. Write the dirty registers of @a reg_list back to the core
+	 * with as few round trips to the adapter as possible, and mark them
+	 * clean. Registers the method can not handle are left dirty, for the
+	 * caller to write one by one; entries may be NULL.
+	 */
+	int (*write_registers_batch)(struct target *target,
+			struct reg **reg_list, int reg_list_size);
+
 	/* target memory access
 	* size: 1 = byte (8bit), 2 = half-word (16bit), 4 = word (32bit)
 	* count: number of items of <size>
@@ -144,11 +162,64 @@ struct target_type {
 	int (*write_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, const uint8_t *buffer);
 
+	/**
+	 * Optional. Read all the blocks of @a reads, none of which wraps, in
+	 * as few adapter round trips as possible and set their retval; empty
+	 * blocks are left alone. Do @b not call this function directly, use
+	 * target_read_buffer_batch() instead.
+	 */
+	int (*read_buffer_batch)(struct target *target,
+			struct target_read_request *reads, unsigned int count);
+
+	/**
+	 * Optional. Write the same @a buffer to @a address of all @a count
+	 * @a targets, each of this type, overlapping the transfers where the
+	 * targets share an adapter, and set the result of each in @a retvals.
+	 * Returns ERROR_TARGET_RESOURCE_NOT_AVAILABLE, with nothing written, if
+	 * it can't. Do @b not call this function directly, use
+	 * target_write_buffer_multi() instead.
+	 */
+	int (*write_buffer_multi)(struct target **targets, unsigned int count,
+			target_addr_t address, uint32_t size, const uint8_t *buffer,
+			int *retvals);
+
+	/**
+	 * Optional. Wait until the bits of @a mask of the word at @a address
+	 * read as @a match, letting the adapter repeat the reads. Returns
+	 * ERROR_NOT_IMPLEMENTED if the adapter can't. Do @b not call this
+	 * function directly, use target_poll_u32() instead.
+	 */
+	int (*poll_u32)(struct target *target, target_addr_t address,
+			uint32_t mask, uint32_t match, uint32_t *value, int timeout_ms);
+
 	int (*checksum_memory)(struct target *target, target_addr_t address,
 			uint32_t count, uint32_t *checksum);
+	/**
+	 * Optional. Store the checksum of each block in its result field, in
+	 * as few algorithm runs as possible. Returns the number of blocks
+	 * done, which may be less than @a num_blocks, or an error code.
+	 */
+	int (*checksum_memory_blocks)(struct target *target,
+			struct target_memory_check_block *blocks, int num_blocks);
+	/**
+	 * Optional. Write @a count words of @a pattern from @a address on and,
+	 * except for TARGET_MEM_FILL, read them back and compare, all on the
+	 * target. See target_mem_pattern().
+	 */
+	int (*mem_pattern)(struct target *target, target_addr_t address,
+			uint32_t count, enum target_mem_pattern pattern, uint32_t value,
+			struct target_mem_test_result *result);
 	int (*blank_check_memory)(struct target *target,
 			struct target_memory_check_block *blocks, int num_blocks,
 			uint8_t erased_value);
+	/**
+	 * Optional. Store in the result field of each block how many bytes
+	 * from its start still hold @a fill_value, on the target. Returns the
+	 * number of blocks done or an error code, see target_stack_check_memory().
+	 */
+	int (*stack_check_memory)(struct target *target,
+			struct target_memory_check_block *blocks, int num_blocks,
+			uint8_t fill_value);
 
 	/*
 	 * target break-/watchpoint control
@@ -76,6 +76,12 @@ static const uint8_t xscale_debug_handler[] = {
 #include "../../contrib/loaders/debug/xscale/debug_handler.inc"
 };
 
+/* The debug handler as host-endian mini-ICache lines, padded with
+ * "mov r8, r8"; built once as it is loaded after every reset. */
+#define XSCALE_HANDLER_LINES DIV_ROUND_UP(sizeof(xscale_debug_handler), 32)
+static uint32_t xscale_handler_lines[XSCALE_HANDLER_LINES][8];
+static bool xscale_handler_lines_built;
+
 static const char *const xscale_reg_list[] = {
 	"XSCALE_MAINID",		/* 0 */
 	"XSCALE_CACHETYPE",
@@ -642,7 +648,7 @@ static unsigned int parity(unsigned int v)
 	return (0x6996 >> v) & 1;
 }
 
-static int xscale_load_ic(struct target *target, uint32_t va, uint32_t buffer[8])
+static void xscale_queue_load_ic(struct target *target, uint32_t va, const uint32_t buffer[8])
 {
 	struct xscale_common *xscale = target_to_xscale(target);
 	uint8_t packet[4] = { 0 };
@@ -692,10 +698,69 @@ static int xscale_load_ic(struct target *target, uint32_t va, uint32_t buffer[8]
 
 		jtag_add_dr_scan(target->tap, 2, fields, TAP_IDLE);
 	}
+}
+
+static int xscale_load_ic(struct target *target, uint32_t va, const uint32_t buffer[8])
+{
+	xscale_queue_load_ic(target, va, buffer);
 
 	return jtag_execute_queue();
 }
 
+/* Load the debug handler and the exception vectors into the mini-ICache.
+ * All lines go out in one JTAG queue; only if that fails, they are loaded
+ * again one line per queue so the failing one is reported. */
+static int xscale_load_debug_handler(struct target *target)
+{
+	struct xscale_common *xscale = target_to_xscale(target);
+	uint32_t address;
+	unsigned int line;
+	int retval;
+
+	if (!xscale_handler_lines_built) {
+		for (unsigned int i = 0; i < XSCALE_HANDLER_LINES * 32; i += 4) {
+			/* convert LE buffer to host-endian uint32_t */
+			if (i < sizeof(xscale_debug_handler))
+				xscale_handler_lines[i / 32][(i % 32) / 4] =
+					le_to_h_u32(&xscale_debug_handler[i]);
+			else
+				xscale_handler_lines[i / 32][(i % 32) / 4] = 0xe1a08008;
+		}
+		xscale_handler_lines_built = true;
+	}
+
+	/* only load addresses other than the reset vectors */
+	address = xscale->handler_address;
+	for (line = 0; line < XSCALE_HANDLER_LINES; line++, address += 32)
+		if ((address % 0x400) != 0x0)
+			xscale_queue_load_ic(target, address, xscale_handler_lines[line]);
+
+	xscale_queue_load_ic(target, 0x0, xscale->low_vectors);
+	xscale_queue_load_ic(target, 0xffff0000, xscale->high_vectors);
+
+	retval = jtag_execute_queue();
+	if (retval == ERROR_OK)
+		return ERROR_OK;
+
+	LOG_WARNING("loading the debug handler failed, retrying line by line");
+
+	address = xscale->handler_address;
+	for (line = 0; line < XSCALE_HANDLER_LINES; line++, address += 32) {
+		if ((address % 0x400) != 0x0) {
+			retval = xscale_load_ic(target, address, xscale_handler_lines[line]);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("loading miniIC line at 0x%8.8" PRIx32 " failed", address);
+				return retval;
+			}
+		}
+	}
+
+	retval = xscale_load_ic(target, 0x0, xscale->low_vectors);
+	if (retval != ERROR_OK)
+		return retval;
+	return xscale_load_ic(target, 0xffff0000, xscale->high_vectors);
+}
+
 static int xscale_invalidate_ic_line(struct target *target, uint32_t va)
 {
 	struct xscale_common *xscale = target_to_xscale(target);
@@ -774,10 +839,10 @@ static int xscale_update_vectors(struct target *target)
 	xscale_invalidate_ic_line(target, 0x0);
 	xscale_invalidate_ic_line(target, 0xffff0000);
 
-	xscale_load_ic(target, 0x0, xscale->low_vectors);
-	xscale_load_ic(target, 0xffff0000, xscale->high_vectors);
+	xscale_queue_load_ic(target, 0x0, xscale->low_vectors);
+	xscale_queue_load_ic(target, 0xffff0000, xscale->high_vectors);
 
-	return ERROR_OK;
+	return jtag_execute_queue();
 }
 
 static int xscale_arch_state(struct target *target)
@@ -1525,9 +1590,6 @@ static int xscale_deassert_reset(struct target *target)
 	 * contents can't ever fail..
 	 */
 	{
-		uint32_t address;
-		unsigned buf_cnt;
-		const uint8_t *buffer = xscale_debug_handler;
 		int retval;
 
 		/* release SRST */
@@ -1549,42 +1611,7 @@ static int xscale_deassert_reset(struct target *target)
 		 * "Special Debug State" for access to registers, memory,
 		 * coprocessors, trace data, etc.
 		 */
-		address = xscale->handler_address;
-		for (unsigned binary_size = sizeof(xscale_debug_handler);
-			binary_size > 0;
-			binary_size -= buf_cnt, buffer += buf_cnt) {
-			uint32_t cache_line[8];
-			unsigned i;
-
-			buf_cnt = binary_size;
-			if (buf_cnt > 32)
-				buf_cnt = 32;
-
-			for (i = 0; i < buf_cnt; i += 4) {
-				/* convert LE buffer to host-endian uint32_t */
-				cache_line[i / 4] = le_to_h_u32(&buffer[i]);
-			}
-
-			for (; i < 32; i += 4)
-				cache_line[i / 4] = 0xe1a08008;
-
-			/* only load addresses other than the reset vectors */
-			if ((address % 0x400) != 0x0) {
-				retval = xscale_load_ic(target, address,
-						cache_line);
-				if (retval != ERROR_OK)
-					return retval;
-			}
-
-			address += buf_cnt;
-		}
-
-		retval = xscale_load_ic(target, 0x0,
-				xscale->low_vectors);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = xscale_load_ic(target, 0xffff0000,
-				xscale->high_vectors);
+		retval = xscale_load_debug_handler(target);
 		if (retval != ERROR_OK)
 			return retval;
 
@@ -40,7 +40,9 @@
 
 #include "xsvf.h"
 #include <jtag/jtag.h>
+#include <jtag/commands.h>
 #include <svf/svf.h>
+#include <helper/fileio.h>
 
 /* XSVF commands, from appendix B of xapp503.pdf  */
 #define XCOMPLETE			0x00
@@ -119,7 +121,27 @@ TDO  (1);
 
 #define XSTATE_MAX_PATH 12
 
-static int xsvf_fd;
+/* the whole file, mapped or read at once */
+static struct fileio *xsvf_fileio;
+static const uint8_t *xsvf_data;
+static uint8_t *xsvf_copy;
+static size_t xsvf_size, xsvf_pos;
+
+/* Scans which are not retried are not executed one at a time: they are
+ * queued along with the check of their TDO, and the queue runs once
+ * XSVF_BATCH_SCANS of them are pending or when a result is needed. */
+#define XSVF_BATCH_SCANS 256
+
+struct xsvf_check {
+	uint8_t *captured;
+	uint8_t *expected;
+	uint8_t *mask;
+	int num_bits;
+	long file_offset;
+};
+
+static int xsvf_batched;
+static long xsvf_mismatch_offset;
 
 /* map xsvf tap state to an openocd "tap_state_t" */
 static tap_state_t xsvf_to_tap(int xsvf_state)
@@ -183,19 +205,127 @@ static tap_state_t xsvf_to_tap(int xsvf_state)
 	return ret;
 }
 
-static int xsvf_read_buffer(int num_bits, int fd, uint8_t *buf)
+static int xsvf_open(const char *filename)
 {
-	int num_bytes;
+	int retval = fileio_open(&xsvf_fileio, filename, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_size(xsvf_fileio, &xsvf_size);
+	if (retval == ERROR_OK && fileio_map(xsvf_fileio, &xsvf_data) != ERROR_OK) {
+		/* compressed, or the host cannot map files */
+		size_t size_read;
+
+		xsvf_copy = malloc(xsvf_size + 1);
+		if (!xsvf_copy)
+			retval = ERROR_FAIL;
+		else
+			retval = fileio_read(xsvf_fileio, xsvf_size, xsvf_copy, &size_read);
+		if (retval == ERROR_OK && size_read != xsvf_size)
+			retval = ERROR_FILEIO_OPERATION_FAILED;
+		xsvf_data = xsvf_copy;
+	}
+
+	xsvf_pos = 0;
+	return retval;
+}
 
-	for (num_bytes = (num_bits + 7) / 8; num_bytes > 0; num_bytes--) {
-		/* reverse the order of bytes as they are read sequentially from file */
-		if (read(fd, buf + num_bytes - 1, 1) < 0)
-			return ERROR_XSVF_EOF;
+static void xsvf_close(void)
+{
+	free(xsvf_copy);
+	xsvf_copy = NULL;
+	xsvf_data = NULL;
+	if (xsvf_fileio)
+		fileio_close(xsvf_fileio);
+	xsvf_fileio = NULL;
+}
+
+/* @returns the number of bytes read, or -1 if the file ends first */
+static int xsvf_read(void *buf, size_t size)
+{
+	if (size > xsvf_size - xsvf_pos) {
+		xsvf_pos = xsvf_size;
+		return -1;
 	}
 
+	memcpy(buf, xsvf_data + xsvf_pos, size);
+	xsvf_pos += size;
+	return size;
+}
+
+static int xsvf_read_buffer(int num_bits, uint8_t *buf)
+{
+	size_t num_bytes = (num_bits + 7) / 8;
+
+	if (num_bytes > xsvf_size - xsvf_pos)
+		return ERROR_XSVF_EOF;
+
+	/* reverse the order of bytes as they are stored MSB first in the file */
+	const uint8_t *p = xsvf_data + xsvf_pos;
+	for (size_t i = 0; i < num_bytes; i++)
+		buf[num_bytes - 1 - i] = p[i];
+	xsvf_pos += num_bytes;
+
 	return ERROR_OK;
 }
 
+static bool xsvf_mask_used(const uint8_t *mask, int num_bits)
+{
+	for (int i = 0; i < num_bits / 8; i++)
+		if (mask[i])
+			return true;
+	return num_bits % 8 && (mask[num_bits / 8] & ((1 << (num_bits % 8)) - 1));
+}
+
+static int xsvf_check_callback(jtag_callback_data_t data0,
+	jtag_callback_data_t data1, jtag_callback_data_t data2,
+	jtag_callback_data_t data3)
+{
+	const struct xsvf_check *check = (const struct xsvf_check *)data0;
+
+	if (!buf_cmp_mask(check->captured, check->expected, check->mask,
+			check->num_bits))
+		return ERROR_OK;
+
+	if (xsvf_mismatch_offset < 0)
+		xsvf_mismatch_offset = check->file_offset;
+	return ERROR_JTAG_QUEUE_FAILED;
+}
+
+/* queue the check of a batched scan, with copies of what it compares */
+static void xsvf_add_check(uint8_t *captured, const uint8_t *expected,
+	const uint8_t *mask, int num_bits, long file_offset)
+{
+	size_t size = DIV_ROUND_UP(num_bits, 8);
+	struct xsvf_check *check = cmd_queue_alloc(sizeof(*check));
+
+	check->captured = captured;
+	check->expected = memcpy(cmd_queue_alloc(size), expected, size);
+	check->mask = memcpy(cmd_queue_alloc(size), mask, size);
+	check->num_bits = num_bits;
+	check->file_offset = file_offset;
+
+	jtag_add_callback4(xsvf_check_callback, (jtag_callback_data_t)check, 0, 0, 0);
+}
+
+/*
+ * Run the queue, including the batched scans and their checks.
+ * @returns ERROR_JTAG_QUEUE_FAILED for a mismatch of a batched scan, after
+ * pointing @a file_offset to it.
+ */
+static int xsvf_flush(long *file_offset)
+{
+	xsvf_batched = 0;
+	xsvf_mismatch_offset = -1;
+
+	int result = jtag_execute_queue();
+	if (result != ERROR_OK && xsvf_mismatch_offset >= 0) {
+		*file_offset = xsvf_mismatch_offset;
+		return ERROR_JTAG_QUEUE_FAILED;
+	}
+	return result;
+}
+
 COMMAND_HANDLER(handle_xsvf_command)
 {
 	uint8_t *dr_out_buf = NULL;				/* from host to device (TDI) */
@@ -254,11 +384,12 @@ COMMAND_HANDLER(handle_xsvf_command)
 		}
 	}
 
-	xsvf_fd = open(filename, O_RDONLY);
-	if (xsvf_fd < 0) {
+	if (xsvf_open(filename) != ERROR_OK) {
+		xsvf_close();
 		command_print(CMD, "file \"%s\" not found", filename);
 		return ERROR_FAIL;
 	}
+	xsvf_batched = 0;
 
 	/* if this argument is present, then interpret xruntest counts as TCK cycles rather than as
 	 *usecs */
@@ -274,9 +405,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 	LOG_WARNING("XSVF support in OpenOCD is limited. Consider using SVF instead");
 	LOG_USER("xsvf processing file: \"%s\"", filename);
 
-	while (read(xsvf_fd, &opcode, 1) > 0) {
+	while (xsvf_read(&opcode, 1) > 0) {
 		/* record the position of this opcode within the file */
-		file_offset = lseek(xsvf_fd, 0, SEEK_CUR) - 1;
+		file_offset = xsvf_pos - 1;
 
 		/* maybe collect another state for a pathmove();
 		 * or terminate a path.
@@ -296,7 +427,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 						break;
 					}
 
-					if (read(xsvf_fd, &uc, 1) < 0) {
+					if (xsvf_read(&uc, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -344,7 +475,11 @@ COMMAND_HANDLER(handle_xsvf_command)
 					else
 						jtag_add_pathmove(pathlen, path);
 
-					result = jtag_execute_queue();
+					result = xsvf_flush(&file_offset);
+					if (result == ERROR_JTAG_QUEUE_FAILED) {
+						tdo_mismatch = 1;
+						break;
+					}
 					if (result != ERROR_OK) {
 						LOG_ERROR("XSVF: pathmove error %d", result);
 						do_abort = 1;
@@ -358,7 +493,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			case XCOMPLETE:
 				LOG_DEBUG("XCOMPLETE");
 
-				result = jtag_execute_queue();
+				result = xsvf_flush(&file_offset);
 				if (result != ERROR_OK) {
 					tdo_mismatch = 1;
 					break;
@@ -368,7 +503,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			case XTDOMASK:
 				LOG_DEBUG("XTDOMASK");
 				if (dr_in_mask &&
-						(xsvf_read_buffer(xsdrsize, xsvf_fd, dr_in_mask) != ERROR_OK))
+						(xsvf_read_buffer(xsdrsize, dr_in_mask) != ERROR_OK))
 					do_abort = 1;
 				break;
 
@@ -376,7 +511,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t xruntest_buf[4];
 
-				if (read(xsvf_fd, xruntest_buf, 4) < 0) {
+				if (xsvf_read(xruntest_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -390,7 +525,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t myrepeat;
 
-				if (read(xsvf_fd, &myrepeat, 1) < 0)
+				if (xsvf_read(&myrepeat, 1) < 0)
 					do_abort = 1;
 				else {
 					xrepeat = myrepeat;
@@ -403,7 +538,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t xsdrsize_buf[4];
 
-				if (read(xsvf_fd, xsdrsize_buf, 4) < 0) {
+				if (xsvf_read(xsdrsize_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -426,17 +561,17 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				int limit = xrepeat;
 				int matched = 0;
-				int attempt;
+				int attempt = 0;
 
 				const char *op_name = (opcode == XSDR ? "XSDR" : "XSDRTDO");
 
-				if (xsvf_read_buffer(xsdrsize, xsvf_fd, dr_out_buf) != ERROR_OK) {
+				if (xsvf_read_buffer(xsdrsize, dr_out_buf) != ERROR_OK) {
 					do_abort = 1;
 					break;
 				}
 
 				if (opcode == XSDRTDO) {
-					if (xsvf_read_buffer(xsdrsize, xsvf_fd,
+					if (xsvf_read_buffer(xsdrsize,
 						dr_in_buf)  != ERROR_OK) {
 						do_abort = 1;
 						break;
@@ -448,7 +583,42 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				LOG_DEBUG("%s %d", op_name, xsdrsize);
 
-				for (attempt = 0; attempt < limit; ++attempt) {
+				if (limit == 1) {
+					/* no retry, so no need for the result now */
+					uint8_t *captured = cmd_queue_alloc(DIV_ROUND_UP(xsdrsize, 8));
+					struct scan_field field = {
+						.num_bits = xsdrsize,
+						.out_value = dr_out_buf,
+						.in_value = captured,
+					};
+
+					if (tap == NULL)
+						jtag_add_plain_dr_scan(field.num_bits,
+								field.out_value,
+								field.in_value,
+								TAP_DRPAUSE);
+					else
+						jtag_add_dr_scan(tap, 1, &field, TAP_DRPAUSE);
+
+					if (xsvf_mask_used(dr_in_mask, xsdrsize))
+						xsvf_add_check(captured, dr_in_buf, dr_in_mask,
+								xsdrsize, file_offset);
+
+					attempt = limit;
+					matched = 1;
+					if (++xsvf_batched >= XSVF_BATCH_SCANS) {
+						result = xsvf_flush(&file_offset);
+						if (result != ERROR_OK)
+							matched = 0;
+					}
+				} else if (xsvf_batched) {
+					/* the retries must see this scan alone fail */
+					result = xsvf_flush(&file_offset);
+					if (result != ERROR_OK)
+						attempt = limit;
+				}
+
+				for (; attempt < limit; ++attempt) {
 					struct scan_field field;
 
 					if (attempt > 0) {
@@ -575,7 +745,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				tap_state_t mystate;
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -618,7 +788,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 			case XENDIR:
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -639,7 +809,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 			case XENDDR:
 
-				if (read(xsvf_fd, &uc, 1) < 0) {
+				if (xsvf_read(&uc, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -668,14 +838,14 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				if (opcode == XSIR) {
 					/* one byte bitcount */
-					if (read(xsvf_fd, short_buf, 1) < 0) {
+					if (xsvf_read(short_buf, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
 					bitcount = short_buf[0];
 					LOG_DEBUG("XSIR %d", bitcount);
 				} else {
-					if (read(xsvf_fd, short_buf, 2) < 0) {
+					if (xsvf_read(short_buf, 2) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -685,7 +855,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				ir_buf = malloc((bitcount + 7) / 8);
 
-				if (xsvf_read_buffer(bitcount, xsvf_fd, ir_buf) != ERROR_OK)
+				if (xsvf_read_buffer(bitcount, ir_buf) != ERROR_OK)
 					do_abort = 1;
 				else {
 					struct scan_field field;
@@ -713,10 +883,11 @@ COMMAND_HANDLER(handle_xsvf_command)
 					 * around the problem.
 					 */
 
-					/* LOG_DEBUG("FLUSHING QUEUE"); */
-					result = jtag_execute_queue();
-					if (result != ERROR_OK)
-						tdo_mismatch = 1;
+					if (++xsvf_batched >= XSVF_BATCH_SCANS) {
+						result = xsvf_flush(&file_offset);
+						if (result != ERROR_OK)
+							tdo_mismatch = 1;
+					}
 				}
 				free(ir_buf);
 			}
@@ -728,7 +899,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 				char comment[128];
 
 				do {
-					if (read(xsvf_fd, &uc, 1) < 0) {
+					if (xsvf_read(&uc, 1) < 0) {
 						do_abort = 1;
 						break;
 					}
@@ -758,9 +929,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 				tap_state_t end_state;
 				int delay;
 
-				if (read(xsvf_fd, &wait_local, 1) < 0
-					|| read(xsvf_fd, &end, 1) < 0
-					|| read(xsvf_fd, delay_buf, 4) < 0) {
+				if (xsvf_read(&wait_local, 1) < 0
+					|| xsvf_read(&end, 1) < 0
+					|| xsvf_read(delay_buf, 4) < 0) {
 						do_abort = 1;
 						break;
 				}
@@ -803,10 +974,10 @@ COMMAND_HANDLER(handle_xsvf_command)
 				int clock_count;
 				int usecs;
 
-				if (read(xsvf_fd, &wait_local, 1) < 0
-						||  read(xsvf_fd, &end, 1) < 0
-						||  read(xsvf_fd, clock_buf, 4) < 0
-						||  read(xsvf_fd, usecs_buf, 4) < 0) {
+				if (xsvf_read(&wait_local, 1) < 0
+						||  xsvf_read(&end, 1) < 0
+						||  xsvf_read(clock_buf, 4) < 0
+						||  xsvf_read(usecs_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -855,7 +1026,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 				*/
 				uint8_t count_buf[4];
 
-				if (read(xsvf_fd, count_buf, 4) < 0) {
+				if (xsvf_read(count_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -874,9 +1045,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 				uint8_t clock_buf[4];
 				uint8_t usecs_buf[4];
 
-				if (read(xsvf_fd, &state, 1) < 0
-						|| read(xsvf_fd, clock_buf, 4) < 0
-						|| read(xsvf_fd, usecs_buf, 4) < 0) {
+				if (xsvf_read(&state, 1) < 0
+						|| xsvf_read(clock_buf, 4) < 0
+						|| xsvf_read(usecs_buf, 4) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -902,8 +1073,8 @@ COMMAND_HANDLER(handle_xsvf_command)
 
 				LOG_DEBUG("LSDR");
 
-				if (xsvf_read_buffer(xsdrsize, xsvf_fd, dr_out_buf) != ERROR_OK
-						|| xsvf_read_buffer(xsdrsize, xsvf_fd, dr_in_buf) != ERROR_OK) {
+				if (xsvf_read_buffer(xsdrsize, dr_out_buf) != ERROR_OK
+						|| xsvf_read_buffer(xsdrsize, dr_in_buf) != ERROR_OK) {
 					do_abort = 1;
 					break;
 				}
@@ -911,6 +1082,12 @@ COMMAND_HANDLER(handle_xsvf_command)
 				if (limit < 1)
 					limit = 1;
 
+				if (xsvf_batched && xsvf_flush(&file_offset) != ERROR_OK) {
+					LOG_USER("LSDR mismatch");
+					tdo_mismatch = 1;
+					break;
+				}
+
 				for (attempt = 0; attempt < limit; ++attempt) {
 					struct scan_field field;
 
@@ -962,7 +1139,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 			{
 				uint8_t trst_mode;
 
-				if (read(xsvf_fd, &trst_mode, 1) < 0) {
+				if (xsvf_read(&trst_mode, 1) < 0) {
 					do_abort = 1;
 					break;
 				}
@@ -1012,10 +1189,9 @@ COMMAND_HANDLER(handle_xsvf_command)
 	}
 
 	if (unsupported) {
-		off_t offset = lseek(xsvf_fd, 0, SEEK_CUR) - 1;
 		command_print(CMD,
-			"unsupported xsvf command (0x%02X) at offset %jd, aborting",
-			uc, (intmax_t)offset);
+			"unsupported xsvf command (0x%02X) at offset %zu, aborting",
+			uc, xsvf_pos - 1);
 		return ERROR_FAIL;
 	}
 
@@ -1028,7 +1204,7 @@ COMMAND_HANDLER(handle_xsvf_command)
 	free(dr_in_buf);
 	free(dr_in_mask);
 
-	close(xsvf_fd);
+	xsvf_close();
 
 	command_print(CMD, "XSVF file programmed successfully");
 
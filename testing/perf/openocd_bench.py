@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Performance benchmark of a running OpenOCD, see README.txt.
+
+Runs a set of scenarios through the Tcl RPC server (port 6666) and the GDB
+server (port 3333) and prints the results as JSON, so they can be compared
+across OpenOCD versions and adapters.
+"""
+
+import argparse
+import json
+import os
+import shlex
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+class TclRpc:
+    """Client of the OpenOCD Tcl RPC server."""
+    TOKEN = b'\x1a'
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+
+    def close(self):
+        self.sock.close()
+
+    def cmd(self, command):
+        self.sock.sendall(command.encode() + self.TOKEN)
+        data = b''
+        while not data.endswith(self.TOKEN):
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError('OpenOCD closed the Tcl connection')
+            data += chunk
+        return data[:-1].decode(errors='replace').strip()
+
+    def timed(self, command):
+        start = time.perf_counter()
+        result = self.cmd(command)
+        return time.perf_counter() - start, result
+
+    def flushes(self, command):
+        """JTAG queue flushes of a command, independent of the adapter speed."""
+        before = int(self.cmd('flush_count'))
+        self.cmd(command)
+        return int(self.cmd('flush_count')) - before
+
+
+class GdbRemote:
+    """Minimal GDB remote serial protocol client."""
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        self.ack = True
+        self.buf = b''
+        if self.packet('QStartNoAckMode') == 'OK':
+            self.ack = False
+
+    def close(self):
+        try:
+            self.sock.sendall(b'$D#44')
+        finally:
+            self.sock.close()
+
+    def _byte(self):
+        if not self.buf:
+            self.buf = self.sock.recv(65536)
+            if not self.buf:
+                raise ConnectionError('OpenOCD closed the GDB connection')
+        b, self.buf = self.buf[:1], self.buf[1:]
+        return b
+
+    def packet(self, payload):
+        data = payload.encode()
+        checksum = sum(data) & 0xff
+        self.sock.sendall(b'$' + data + b'#%02x' % checksum)
+        while True:
+            b = self._byte()
+            if b == b'$':
+                break
+            # acks and asynchronous notifications before the reply
+        reply = b''
+        while True:
+            b = self._byte()
+            if b == b'#':
+                break
+            reply += b
+        self._byte()
+        self._byte()
+        if self.ack:
+            self.sock.sendall(b'+')
+        return reply.decode(errors='replace')
+
+    def timed(self, payload):
+        start = time.perf_counter()
+        reply = self.packet(payload)
+        return time.perf_counter() - start, reply
+
+
+def summary(samples, unit, scale=1.0, **extra):
+    values = [s * scale for s in samples]
+    result = {
+        'unit': unit,
+        'samples': len(values),
+        'median': statistics.median(values),
+        'mean': statistics.mean(values),
+        'min': min(values),
+        'max': max(values),
+    }
+    result.update(extra)
+    return result
+
+
+def throughput(size, seconds):
+    return {'unit': 'KiB/s', 'bytes': size, 'seconds': seconds,
+            'value': size / 1024 / seconds if seconds else None}
+
+
+def bench_memory(tcl, args, tmpdir):
+    """Memory read and write throughput with dump_image and load_image."""
+    results = {}
+    path = os.path.join(tmpdir, 'bench_mem.bin')
+    with open(path, 'wb') as f:
+        f.write(os.urandom(args.mem_size))
+
+    tcl.cmd('halt')
+    seconds, out = tcl.timed('load_image {%s} 0x%x bin' % (path, args.mem_address))
+    results['mem_write'] = throughput(args.mem_size, seconds)
+    seconds, out = tcl.timed('dump_image {%s.read} 0x%x %d' %
+                             (path, args.mem_address, args.mem_size))
+    results['mem_read'] = throughput(args.mem_size, seconds)
+
+    with open(path, 'rb') as f, open(path + '.read', 'rb') as g:
+        results['mem_read']['match'] = f.read() == g.read()
+    return results
+
+
+def bench_flash(tcl, args, tmpdir):
+    """Flash program and verify of an image."""
+    results = {}
+    size = os.path.getsize(args.flash_image)
+    address = '' if args.flash_address is None else ' 0x%x' % args.flash_address
+
+    tcl.cmd('reset halt')
+    tcl.cmd('flash stats reset')
+    seconds, out = tcl.timed('flash write_image erase {%s}%s' % (args.flash_image, address))
+    results['flash_write'] = throughput(size, seconds)
+    results['flash_write']['output'] = out
+    seconds, out = tcl.timed('verify_image {%s}%s' % (args.flash_image, address))
+    results['flash_verify'] = throughput(size, seconds)
+    results['flash_verify']['output'] = out
+    results['flash_stats'] = tcl.cmd('capture {flash stats}')
+    return results
+
+
+def bench_run_control(tcl, args, tmpdir):
+    """Latency of halt, resume and single step."""
+    halt, resume, step = [], [], []
+
+    tcl.cmd('halt')
+    for _ in range(args.iterations):
+        step.append(tcl.timed('step')[0])
+    for _ in range(args.iterations):
+        resume.append(tcl.timed('resume')[0])
+        halt.append(tcl.timed('halt')[0])
+
+    return {
+        'halt': summary(halt, 'ms', 1e3),
+        'resume': summary(resume, 'ms', 1e3),
+        'step': summary(step, 'ms', 1e3, flushes=tcl.flushes('step')),
+    }
+
+
+def bench_gdb(tcl, args, tmpdir):
+    """GDB register and memory read response time, RTOS thread scan time."""
+    results = {}
+    gdb = GdbRemote(args.host, args.gdb_port)
+    try:
+        gdb.packet('?')
+        regs, mem = [], []
+        for _ in range(args.iterations):
+            regs.append(gdb.timed('g')[0])
+        for _ in range(args.iterations):
+            mem.append(gdb.timed('m%x,%x' % (args.mem_address, args.gdb_read_size))[0])
+        results['gdb_g'] = summary(regs, 'ms', 1e3)
+        results['gdb_m'] = summary(mem, 'ms', 1e3, bytes=args.gdb_read_size)
+
+        scans, threads = [], 0
+        for _ in range(args.iterations):
+            start = time.perf_counter()
+            reply = gdb.packet('qfThreadInfo')
+            threads = 0
+            while reply.startswith('m'):
+                threads += len(reply[1:].split(','))
+                reply = gdb.packet('qsThreadInfo')
+            scans.append(time.perf_counter() - start)
+        results['rtos_thread_scan'] = summary(scans, 'ms', 1e3, threads=threads)
+    finally:
+        gdb.close()
+    return results
+
+
+SCENARIOS = {
+    'memory': bench_memory,
+    'flash': bench_flash,
+    'run_control': bench_run_control,
+    'gdb': bench_gdb,
+}
+
+
+def wait_for_port(host, port, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection((host, port), timeout=1).close()
+            return
+        except OSError:
+            time.sleep(0.2)
+    raise TimeoutError('OpenOCD did not open port %d' % port)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--tcl-port', type=int, default=6666)
+    parser.add_argument('--gdb-port', type=int, default=3333)
+    parser.add_argument('--spawn', metavar='CMDLINE',
+                        help='start OpenOCD with this command line and stop it at the end')
+    parser.add_argument('--scenarios', default='memory,run_control,gdb',
+                        help='comma separated list of: ' + ', '.join(SCENARIOS))
+    parser.add_argument('--iterations', type=int, default=20)
+    parser.add_argument('--mem-address', type=lambda x: int(x, 0), default=0x20000000,
+                        help='RAM used by the memory and gdb scenarios')
+    parser.add_argument('--mem-size', type=lambda x: int(x, 0), default=0x4000)
+    parser.add_argument('--gdb-read-size', type=lambda x: int(x, 0), default=0x400)
+    parser.add_argument('--flash-image', help='image for the flash scenario')
+    parser.add_argument('--flash-address', type=lambda x: int(x, 0),
+                        help='load address of a binary flash image')
+    parser.add_argument('--output', help='write the JSON results to this file')
+    args = parser.parse_args()
+
+    names = [s for s in args.scenarios.split(',') if s]
+    for name in names:
+        if name not in SCENARIOS:
+            parser.error('unknown scenario ' + name)
+    if 'flash' in names and not args.flash_image:
+        parser.error('the flash scenario needs --flash-image')
+
+    openocd = None
+    if args.spawn:
+        openocd = subprocess.Popen(shlex.split(args.spawn),
+                                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        wait_for_port(args.host, args.tcl_port, 30)
+
+    report = {'timestamp': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+              'results': {}, 'errors': {}}
+    tcl = TclRpc(args.host, args.tcl_port)
+    try:
+        report['openocd_version'] = tcl.cmd('version')
+        report['adapter_speed'] = tcl.cmd('adapter speed')
+        report['target'] = tcl.cmd('target current')
+        with tempfile.TemporaryDirectory() as tmpdir:
+            for name in names:
+                try:
+                    report['results'].update(SCENARIOS[name](tcl, args, tmpdir))
+                except (OSError, ConnectionError, statistics.StatisticsError) as e:
+                    report['errors'][name] = str(e)
+    finally:
+        tcl.close()
+        if openocd:
+            openocd.terminate()
+            openocd.wait()
+
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+    return 1 if report['errors'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())